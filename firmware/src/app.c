@@ -47,20 +47,441 @@ static void appGreetings(AppData* app_data) {
   app_data->state = APP_STATE_RUN_SERVICES;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Scheduler glue.
+
+static void timerTasks(void* user_data) {
+  APP_Timer_Tasks((AppTimerWheel*)user_data);
+}
+
+static bool timerIsRunnable(void* user_data, uint64_t* next_deadline) {
+  *next_deadline = APP_Timer_NextExpiry((AppTimerWheel*)user_data);
+  return false;
+}
+
+static void eventTasks(void* user_data) {
+  APP_Event_Tasks((AppEventBus*)user_data);
+}
+
+static bool eventIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Event_HasPending((AppEventBus*)user_data);
+}
+
+static void networkTasks(void* user_data) {
+  APP_Network_Tasks((AppNetworkData*)user_data);
+}
+
+static bool networkIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Network_IsRunnable((AppNetworkData*)user_data);
+}
+
+static void usbHIDTasks(void* user_data) {
+  APP_USB_HID_Tasks((AppUSBHIDData*)user_data);
+}
+
+static bool usbHIDIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_USB_HID_IsRunnable((AppUSBHIDData*)user_data);
+}
+
+static void rtcTasks(void* user_data) {
+  APP_RTC_Tasks((AppRTCData*)user_data);
+}
+
+static bool rtcIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_RTC_IsRunnable((AppRTCData*)user_data, next_deadline);
+}
+
+static void timeSyncTasks(void* user_data) {
+  APP_TimeSync_Tasks((AppTimeSyncData*)user_data);
+}
+
+static bool timeSyncIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_TimeSync_IsRunnable((AppTimeSyncData*)user_data);
+}
+
+static void flashTasks(void* user_data) {
+  APP_Flash_Tasks((AppFlashData*)user_data);
+}
+
+static bool flashIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Flash_IsRunnable((AppFlashData*)user_data);
+}
+
+static void flashCacheTasks(void* user_data) {
+  APP_FlashCache_Tasks((AppFlashCacheData*)user_data);
+}
+
+static bool flashCacheIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_FlashCache_IsRunnable((AppFlashCacheData*)user_data,
+                                   next_deadline);
+}
+
+static void flashRawTasks(void* user_data) {
+  APP_FlashRaw_Tasks((AppFlashRawData*)user_data);
+}
+
+static bool flashRawIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_FlashRaw_IsRunnable((AppFlashRawData*)user_data);
+}
+
+static void settingsTasks(void* user_data) {
+  APP_Settings_Tasks((AppSettingsData*)user_data);
+}
+
+static bool settingsIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Settings_IsRunnable((AppSettingsData*)user_data);
+}
+
+static void historyTasks(void* user_data) {
+  APP_History_Tasks((AppHistoryData*)user_data);
+}
+
+static bool historyIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_History_IsRunnable((AppHistoryData*)user_data);
+}
+
+static void httpsClientTasks(void* user_data) {
+  APP_HTTPS_Client_Tasks((AppHTTPSClientData*)user_data);
+}
+
+static bool httpsClientIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_HTTPS_Client_IsBusy((AppHTTPSClientData*)user_data);
+}
+
+static void downloadTasks(void* user_data) {
+  APP_Download_Tasks((AppDownloadData*)user_data);
+}
+
+static bool downloadIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Download_IsRunnable((AppDownloadData*)user_data);
+}
+
+static void firmwareUpdateTasks(void* user_data) {
+  APP_FirmwareUpdate_Tasks((AppFirmwareUpdateData*)user_data);
+}
+
+static bool firmwareUpdateIsRunnable(void* user_data,
+                                     uint64_t* next_deadline) {
+  return APP_FirmwareUpdate_IsRunnable((AppFirmwareUpdateData*)user_data);
+}
+
+static void nixiePlayerTasks(void* user_data) {
+  APP_Nixie_PlayerTasks((AppNixieData*)user_data);
+}
+
+static bool nixiePlayerIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Nixie_PlayerIsRunnable((AppNixieData*)user_data, next_deadline);
+}
+
+static void shiftRegisterTasks(void* user_data) {
+  APP_ShiftRegister_Tasks((AppShiftRegisterData*)user_data);
+}
+
+static bool shiftRegisterIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_ShiftRegister_IsBusy((AppShiftRegisterData*)user_data);
+}
+
+static void nixieTasks(void* user_data) {
+  APP_Nixie_Tasks((AppNixieData*)user_data);
+}
+
+static bool nixieIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Nixie_IsRunnable((AppNixieData*)user_data);
+}
+
+static void commandTasks(void* user_data) {
+  APP_Command_Tasks((AppData*)user_data);
+}
+
+static bool commandIsRunnable(void* user_data, uint64_t* next_deadline) {
+  return APP_Command_IsRunnable((AppData*)user_data);
+}
+
+static void supervisorTasks(void* user_data) {
+  APP_Supervisor_Tasks((AppSupervisorData*)user_data);
+}
+
+static bool supervisorIsRunnable(void* user_data, uint64_t* next_deadline) {
+  *next_deadline = APP_Supervisor_NextDeadline((AppSupervisorData*)user_data);
+  return false;
+}
+
+// Register task in the scheduler.
+//
+// NOTE: Registration only fails when APP_CONFIG_NUM_SCHEDULER_TASKS is less
+// than the number of tasks registered below, which is a configuration error.
+static void schedulerRegister(AppSchedulerData* scheduler,
+                              const char* name,
+                              AppSchedulerTasksFunc tasks,
+                              AppSchedulerIsRunnableFunc is_runnable,
+                              void* user_data) {
+  if (!APP_Scheduler_Register(scheduler, name, tasks, is_runnable, user_data)) {
+    SYS_ASSERT(false, "\r\nNot enough scheduler task slots\r\n");
+  }
+}
+
+static void appSchedulerInitialize(AppData* app_data) {
+  AppSchedulerData* scheduler = &app_data->scheduler;
+  APP_Scheduler_Initialize(scheduler);
+  // NOTE: Timers go first, so modules see expired timers in the same pass.
+  schedulerRegister(scheduler, "timer",
+                    timerTasks, timerIsRunnable,
+                    &app_data->timer_wheel);
+  // NOTE: Events go right after timers, so consumers woken up by an event
+  // run in the same pass.
+  schedulerRegister(scheduler, "event",
+                    eventTasks, eventIsRunnable,
+                    &app_data->event_bus);
+  schedulerRegister(scheduler, "network",
+                    networkTasks, networkIsRunnable,
+                    &app_data->network);
+  schedulerRegister(scheduler, "usb_hid",
+                    usbHIDTasks, usbHIDIsRunnable,
+                    &app_data->usb_hid);
+  schedulerRegister(scheduler, "rtc",
+                    rtcTasks, rtcIsRunnable,
+                    &app_data->rtc);
+  schedulerRegister(scheduler, "time_sync",
+                    timeSyncTasks, timeSyncIsRunnable,
+                    &app_data->time_sync);
+  schedulerRegister(scheduler, "flash",
+                    flashTasks, flashIsRunnable,
+                    &app_data->flash);
+  schedulerRegister(scheduler, "flash_cache",
+                    flashCacheTasks, flashCacheIsRunnable,
+                    &app_data->flash_cache);
+  schedulerRegister(scheduler, "flash_raw",
+                    flashRawTasks, flashRawIsRunnable,
+                    &app_data->flash_raw);
+  schedulerRegister(scheduler, "settings",
+                    settingsTasks, settingsIsRunnable,
+                    &app_data->settings);
+  schedulerRegister(scheduler, "history",
+                    historyTasks, historyIsRunnable,
+                    &app_data->history);
+  schedulerRegister(scheduler, "https_client",
+                    httpsClientTasks, httpsClientIsRunnable,
+                    &app_data->https_client);
+  // NOTE: Download goes after HTTPS client, so pages it filled are written
+  // in the same pass.
+  schedulerRegister(scheduler, "download",
+                    downloadTasks, downloadIsRunnable,
+                    &app_data->download);
+  // NOTE: Firmware update goes after download, so finished download is
+  // picked up before anything else can start a new one.
+  schedulerRegister(scheduler, "firmware_update",
+                    firmwareUpdateTasks, firmwareUpdateIsRunnable,
+                    &app_data->firmware_update);
+  // NOTE: Player goes before shift register, so transmission of the frame
+  // starts in the same iteration as its deadline was reached.
+  schedulerRegister(scheduler, "nixie_player",
+                    nixiePlayerTasks, nixiePlayerIsRunnable,
+                    &app_data->nixie);
+  schedulerRegister(scheduler, "shift_register",
+                    shiftRegisterTasks, shiftRegisterIsRunnable,
+                    &app_data->shift_register);
+  schedulerRegister(scheduler, "nixie",
+                    nixieTasks, nixieIsRunnable,
+                    &app_data->nixie);
+  schedulerRegister(scheduler, "command",
+                    commandTasks, commandIsRunnable,
+                    app_data);
+  // NOTE: Supervisor goes last, so it sees states modules ended up in.
+  schedulerRegister(scheduler, "supervisor",
+                    supervisorTasks, supervisorIsRunnable,
+                    &app_data->supervisor);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Event bus glue.
+
+static void eventSubscribe(AppEventBus* event_bus,
+                           uint32_t mask,
+                           AppEventCallback callback,
+                           void* user_data) {
+  if (!APP_Event_Subscribe(event_bus, mask, callback, user_data)) {
+    SYS_ASSERT(false, "\r\nNot enough event bus subscriber slots\r\n");
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Settings glue.
+
+// Apply stored settings to the modules, if they changed since the last time.
+static void settingsApply(AppData* app_data) {
+  AppSettingsData* settings = &app_data->settings;
+  if (settings->generation == app_data->applied_settings_generation) {
+    return;
+  }
+  // NOTE: Request can't be changed while display is busy, will try again once
+  // it is done.
+  if (!APP_Nixie_RequestSet(
+          &app_data->nixie,
+          APP_Settings_Get(settings, APP_SETTINGS_KEY_NIXIE_URL),
+          APP_Settings_Get(settings, APP_SETTINGS_KEY_NIXIE_TOKEN))) {
+    return;
+  }
+  const int interval =
+      atoi(APP_Settings_Get(settings, APP_SETTINGS_KEY_NIXIE_INTERVAL));
+  if (interval > 0) {
+    APP_Nixie_PeriodicIntervalSet(&app_data->nixie, interval);
+  }
+  app_data->applied_settings_generation = settings->generation;
+}
+
+static void settingsEventCallback(const AppEvent* event, void* user_data) {
+  settingsApply((AppData*)user_data);
+}
+
+static void appSettingsInitialize(AppData* app_data) {
+  APP_FlashRaw_Initialize(&app_data->flash_raw, &app_data->timer_wheel);
+  APP_Settings_Initialize(&app_data->settings,
+                          &app_data->flash_raw,
+                          &app_data->event_bus);
+  app_data->applied_settings_generation = app_data->settings.generation;
+  eventSubscribe(&app_data->event_bus,
+                 APP_EVENT_MASK(APP_EVENT_SETTINGS_CHANGED) |
+                 APP_EVENT_MASK(APP_EVENT_NIXIE_DONE),
+                 settingsEventCallback,
+                 app_data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// History glue.
+
+// Convert display value to a number, unused digits are ignored.
+static int32_t displayValueToNumber(const char value[MAX_NIXIE_TUBES],
+                                    int num_nixies) {
+  int32_t number = 0;
+  int i;
+  for (i = num_nixies - 1; i >= 0; --i) {
+    if (value[i] != '\0') {
+      number = number * 10 + (value[i] - '0');
+    }
+  }
+  return number;
+}
+
+// Put value which was received from the server into the history.
+static void historyEventCallback(const AppEvent* event, void* user_data) {
+  AppData* app_data = (AppData*)user_data;
+  const AppNixieData* nixie = &app_data->nixie;
+  // NOTE: Value restored from the snapshot is already in the history, and
+  // values received while time is unknown can't be placed into it.
+  if (nixie->is_display_value_stale ||
+      nixie->display_value_timestamp == 0 ||
+      nixie->display_value_timestamp == app_data->recorded_value_timestamp) {
+    return;
+  }
+  app_data->recorded_value_timestamp = nixie->display_value_timestamp;
+  APP_History_Record(&app_data->history,
+                     nixie->display_value_timestamp,
+                     displayValueToNumber(nixie->display_value,
+                                          nixie->num_nixies));
+}
+
+static void appHistoryInitialize(AppData* app_data) {
+  APP_History_Initialize(&app_data->history,
+                         &app_data->flash_raw,
+                         &app_data->timer_wheel,
+                         &app_data->event_bus);
+  app_data->recorded_value_timestamp = 0;
+  eventSubscribe(&app_data->event_bus,
+                 APP_EVENT_MASK(APP_EVENT_NIXIE_DONE),
+                 historyEventCallback,
+                 app_data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Supervisor glue.
+
+static int httpsClientState(void* user_data) {
+  return ((AppHTTPSClientData*)user_data)->state;
+}
+
+static uint32_t httpsClientStateBudget(void* user_data, int state) {
+  return APP_HTTPS_Client_StateBudget((AppHTTPSClientState)state);
+}
+
+static void httpsClientRecover(void* user_data) {
+  APP_HTTPS_Client_Abort((AppHTTPSClientData*)user_data);
+}
+
+static int nixieState(void* user_data) {
+  return ((AppNixieData*)user_data)->state;
+}
+
+static uint32_t nixieStateBudget(void* user_data, int state) {
+  return APP_Nixie_StateBudget((AppNixieState)state);
+}
+
+static void appSupervisorInitialize(AppData* app_data) {
+  AppSupervisorData* supervisor = &app_data->supervisor;
+  APP_Supervisor_Initialize(supervisor);
+  APP_Supervisor_Register(supervisor, "https_client",
+                          httpsClientState, httpsClientStateBudget,
+                          httpsClientRecover,
+                          &app_data->https_client);
+  // NOTE: Nixie module has no recovery, if it hangs after the HTTP(S) client
+  // was aborted the whole system is reset by the watchdog.
+  APP_Supervisor_Register(supervisor, "nixie",
+                          nixieState, nixieStateBudget,
+                          NULL,
+                          &app_data->nixie);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
 void APP_Initialize_Real(AppData* app_data, SystemObjects* system_objects) {
   app_data->system_objects = system_objects;
   app_data->state = APP_STATE_GREETINGS;
+  APP_Timer_Initialize(&app_data->timer_wheel);
+  APP_Event_Initialize(&app_data->event_bus);
   APP_Command_Initialize(app_data);
-  APP_Network_Initialize(&app_data->network, app_data->system_objects);
-  APP_USB_HID_Initialize(&app_data->usb_hid);
-  APP_RTC_Initialize(&app_data->rtc);
-  APP_Flash_Initialize(&app_data->flash, app_data->system_objects);
-  APP_Power_Initialize();
-  APP_HTTPS_Client_Initialize(&app_data->https_client);
-  APP_ShiftRegister_Initialize(&app_data->shift_register);
+  APP_Network_Initialize(&app_data->network,
+                         app_data->system_objects,
+                         &app_data->timer_wheel);
+  APP_RTC_Initialize(&app_data->rtc, &app_data->event_bus);
+  APP_TimeSync_Initialize(&app_data->time_sync,
+                          &app_data->rtc,
+                          &app_data->timer_wheel);
+  APP_FlashCache_Initialize(&app_data->flash_cache, &app_data->event_bus);
+  APP_Flash_Initialize(&app_data->flash,
+                       app_data->system_objects,
+                       &app_data->flash_cache,
+                       &app_data->flash_raw,
+                       &app_data->timer_wheel,
+                       &app_data->event_bus);
+  appSettingsInitialize(app_data);
+  appHistoryInitialize(app_data);
+  APP_USB_HID_Initialize(&app_data->usb_hid, &app_data->history);
+  APP_Power_Initialize(&app_data->power);
+  APP_HTTPS_Client_Initialize(&app_data->https_client,
+                              &app_data->timer_wheel,
+                              &app_data->event_bus);
+  APP_Download_Initialize(&app_data->download,
+                          &app_data->https_client,
+                          &app_data->flash_raw,
+                          &app_data->timer_wheel,
+                          &app_data->event_bus);
+  APP_FirmwareUpdate_Initialize(&app_data->firmware_update,
+                                &app_data->flash_raw,
+                                &app_data->download,
+                                &app_data->event_bus);
+  APP_ShiftRegister_Initialize(&app_data->shift_register,
+                               &app_data->event_bus);
   APP_Nixie_Initialize(&app_data->nixie,
                        &app_data->https_client,
-                       &app_data->shift_register);
+                       &app_data->shift_register,
+                       &app_data->rtc,
+                       &app_data->timer_wheel,
+                       &app_data->event_bus);
+  appSchedulerInitialize(app_data);
+  appSupervisorInitialize(app_data);
+#ifdef APP_CONFIG_WITH_PROFILER
+  APP_Profiler_Reset(&app_data->profiler);
+#endif
 }
 
 void APP_Tasks_Real(AppData* app_data) {
@@ -69,18 +490,15 @@ void APP_Tasks_Real(AppData* app_data) {
       appGreetings(app_data);
       break;
     case APP_STATE_RUN_SERVICES:
-      // TODO(sergey): Shall we pixk some subset of tasks per iteration?
-      APP_Network_Tasks(&app_data->network);
-      APP_USB_HID_Tasks(&app_data->usb_hid);
-      APP_RTC_Tasks(&app_data->rtc);
-      APP_Flash_Tasks(&app_data->flash);
-      APP_HTTPS_Client_Tasks(&app_data->https_client);
-      APP_ShiftRegister_Tasks(&app_data->shift_register);
-      APP_Nixie_Tasks(&app_data->nixie);
-      APP_Command_Tasks(app_data);
-      if (!APP_Command_IsBusy(app_data)) {
+      APP_Scheduler_Tasks(&app_data->scheduler);
+      if (APP_Command_IsAcceptingCommands(app_data)) {
         SYS_CMD_READY_TO_READ();
       }
+      APP_PROFILER_ITERATION_END(&app_data->profiler);
+      if (APP_Scheduler_IsIdle(&app_data->scheduler)) {
+        APP_Power_Idle(&app_data->power,
+                       APP_Scheduler_NextDeadline(&app_data->scheduler));
+      }
       break;
     case APP_STATE_ERROR:
       // TODO(sergey): Do we need to do something here?
@@ -31,13 +31,25 @@
 
 // TODO(sergey): Think how we can reduce header hell dependency here.
 #include "app_command.h"
+#include "app_download.h"
+#include "app_event.h"
+#include "app_firmware_update.h"
 #include "app_flash.h"
+#include "app_flash_cache.h"
+#include "app_flash_raw.h"
+#include "app_history.h"
 #include "app_https_client.h"
 #include "app_network.h"
 #include "app_nixie.h"
 #include "app_power.h"
+#include "app_profiler.h"
 #include "app_rtc.h"
+#include "app_scheduler.h"
+#include "app_settings.h"
 #include "app_shift_register.h"
+#include "app_supervisor.h"
+#include "app_time_sync.h"
+#include "app_timer.h"
 #include "app_usb_hid.h"
 
 typedef enum {
@@ -57,15 +69,55 @@ typedef struct AppData {
 
   // Descriptors of all peripherials.
   AppFlashData flash;
+  // Cache of the file system sectors of the flash.
+  AppFlashCacheData flash_cache;
   AppHTTPSClientData https_client;
   AppNetworkData network;
   AppNixieData nixie;
+  AppPowerData power;
   AppRTCData rtc;
   AppShiftRegisterData shift_register;
   AppUSBHIDData usb_hid;
 
+  // Discipline of the RTC by the network time.
+  AppTimeSyncData time_sync;
+
+  // Persistent settings stored in the raw flash region.
+  AppFlashRawData flash_raw;
+  AppSettingsData settings;
+  // Generation of settings which were last applied to the modules.
+  uint32_t applied_settings_generation;
+
+  // History of values received from the server, stored in the raw flash.
+  AppHistoryData history;
+  // Time of the display value which was last put into the history.
+  uint32_t recorded_value_timestamp;
+
+  // Download of resources into the flash, streamed from the HTTPS client.
+  AppDownloadData download;
+
+  // Firmware update staged in the raw flash, downloaded by the module above.
+  AppFirmwareUpdateData firmware_update;
+
   // Internal state machine of sub-routines.
   AppCommandData command;
+
+  // Software timers used by all the modules above.
+  AppTimerWheel timer_wheel;
+
+  // Completion events posted by the modules above.
+  AppEventBus event_bus;
+
+  // Dispatcher of all the tasks above.
+  AppSchedulerData scheduler;
+
+  // Watchdog of the modules above.
+  AppSupervisorData supervisor;
+
+#ifdef APP_CONFIG_WITH_PROFILER
+  // Instrumentation of the main loop.
+  AppProfilerData profiler;
+#endif
 } AppData;
 
 // Stubs for default Harmony code.
@@ -28,9 +28,13 @@
 // TODO(sergey): Find a way to avoid this global thing.
 static AppData* g_app_data;
 
+static int cmdConfig(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdDebug(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
+static int cmdDownload(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdFetch(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
+static int cmdFirmware(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdFlash(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
+static int cmdHistory(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdIwsecurity(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdNixie(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdNTP(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
@@ -38,11 +42,16 @@ static int cmdPhy(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdPower(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdRTC(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 static int cmdShiftRegister(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
+static int cmdTask(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv);
 
 static const SYS_CMD_DESCRIPTOR commands[] = {
+  {"config", cmdConfig, ": Persistent settings"},
   {"debug", cmdDebug, ": Debug configuration"},
+  {"download", cmdDownload, ": Download HTTP(S) resource to the flash"},
   {"fetch", cmdFetch, ": fetch HTTP(S) page"},
+  {"firmware", cmdFirmware, ": Firmware update over the network"},
   {"flash", cmdFlash, ": Serial flash configuration"},
+  {"history", cmdHistory, ": History of displayed values"},
   // TODO(sergey): This should in theory be handled by iwconfig, but it is not.
   // So we work this around for particular Harmony version and device we use.
   {"iwsecurity", cmdIwsecurity, ": WiFi security configuration"},
@@ -52,20 +61,37 @@ static const SYS_CMD_DESCRIPTOR commands[] = {
   {"power", cmdPower, ": Power supply configuration"},
   {"rtc", cmdRTC, ": Real Time Clock configuration"},
   {"shift_register", cmdShiftRegister, ": Shift register manipulation"},
+  {"task", cmdTask, ": Main loop tasks statistics"},
 };
 
+static int cmdConfig(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
+  return APP_Command_Config(g_app_data, cmd_io, argc, argv);
+}
+
 static int cmdDebug(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
   return APP_Command_Debug(g_app_data, cmd_io, argc, argv);
 }
 
+static int cmdDownload(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
+  return APP_Command_Download(g_app_data, cmd_io, argc, argv);
+}
+
 static int cmdFetch(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
   return APP_Command_Fetch(g_app_data, cmd_io, argc, argv);
 }
 
+static int cmdFirmware(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
+  return APP_Command_Firmware(g_app_data, cmd_io, argc, argv);
+}
+
 static int cmdFlash(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
   return APP_Command_Flash(g_app_data, cmd_io, argc, argv);
 }
 
+static int cmdHistory(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
+  return APP_Command_History(g_app_data, cmd_io, argc, argv);
+}
+
 static int cmdIwsecurity(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
   return APP_Command_IwSecurity(g_app_data, cmd_io, argc, argv);
 }
@@ -95,17 +121,17 @@ static int cmdShiftRegister(SYS_CMD_DEVICE_NODE* cmd_io,
   return APP_Command_ShiftRegister(g_app_data, cmd_io, argc, argv);
 }
 
+static int cmdTask(SYS_CMD_DEVICE_NODE* cmd_io, int argc, char** argv) {
+  return APP_Command_Profiler(g_app_data, cmd_io, argc, argv);
+}
+
 void APP_Command_Initialize(AppData* app_data) {
   const int num_commands = sizeof(commands) / sizeof(*commands);
   if (SYS_CMD_ADDGRP(commands, num_commands, "app", ": app commands") == -1) {
     SYS_CONSOLE_MESSAGE("APP: Error initializing command processor\r\n");
   }
   g_app_data = app_data;
-  APP_Command_Task_Initialize(&app_data->command.task);
-  APP_Command_Fetch_Initialize(app_data);
-  APP_Command_Nixie_Initialize(app_data);
-  APP_Command_RTC_Initialize(app_data);
-  APP_Command_ShiftRegister_Initialize(app_data);
+  APP_Command_Task_Initialize(&app_data->command.task, &app_data->event_bus);
 }
 
 void APP_Command_Tasks(AppData* app_data) {
@@ -119,9 +145,17 @@ bool APP_Command_IsBusy(AppData* app_data) {
   return false;
 }
 
+bool APP_Command_IsRunnable(AppData* app_data) {
+  return APP_Command_Task_IsRunnable(&app_data->command.task);
+}
+
+bool APP_Command_IsAcceptingCommands(AppData* app_data) {
+  return !APP_Command_Task_IsFull(&app_data->command.task);
+}
+
 bool APP_Command_CheckAvailable(AppData* app_data,
                                 struct SYS_CMD_DEVICE_NODE* cmd_io) {
-  if (APP_Command_IsBusy(app_data)) {
+  if (!APP_Command_IsAcceptingCommands(app_data)) {
     COMMAND_MESSAGE("Command processor is busy, try again later.\r\n");
     return false;
   }
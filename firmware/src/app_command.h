@@ -26,15 +26,20 @@
 // Simple task scheduler implementation.
 #include "app_command_task.h"
 
+#include "app_command_config.h"
 #include "app_command_debug.h"
+#include "app_command_download.h"
 #include "app_command_fetch.h"
+#include "app_command_firmware.h"
 #include "app_command_flash.h"
+#include "app_command_history.h"
 #include "app_command_nixie.h"
 #include "app_command_ntp.h"
 #include "app_command_rtc.h"
 #include "app_command_shift_register.h"
 #include "app_command_phy.h"
 #include "app_command_power.h"
+#include "app_command_profiler.h"
 #include "app_command_wifi.h"
 
 #include <stdbool.h>
@@ -44,12 +49,9 @@ struct SYS_CMD_DEVICE_NODE;
 
 typedef struct AppCommandData {
   // Simple task scheduler.
+  //
+  // NOTE: Per-command data for the state machine is stored in the tasks.
   AppCommandTaskData task;
-  // Per-command data for the state machine.
-  AppCommandFetchData fetch;
-  AppCommandNixieData nixie;
-  AppCommandRTCData rtc;
-  AppCommandShiftRegisterData shift_register;
 } AppCommandData;
 
 void APP_Command_Initialize(struct AppData* app_data);
@@ -68,8 +70,15 @@ void APP_Command_Tasks(struct AppData* app_data);
 // Check whether command processor is busy with some command.
 bool APP_Command_IsBusy(struct AppData* app_data);
 
-// Check availability of command processor, if it's busy will
-// print message about this.
+// Check whether command processor has a task which is not waiting for an
+// event.
+bool APP_Command_IsRunnable(struct AppData* app_data);
+
+// Check whether command processor can accept new command.
+bool APP_Command_IsAcceptingCommands(struct AppData* app_data);
+
+// Check availability of command processor, if it has no room for new command
+// will print message about this.
 bool APP_Command_CheckAvailable(struct AppData* app_data,
                                 struct SYS_CMD_DEVICE_NODE* cmd_io);
 
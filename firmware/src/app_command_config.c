@@ -0,0 +1,210 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_command_config.h"
+
+#include "app.h"
+#include "app_settings.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#define LOG_PREFIX "APP CMD CONFIG: "
+#define DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static int appCmdConfigUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
+  COMMAND_PRINT("Usage: %s command arguments ...\r\n", argv0);
+  COMMAND_MESSAGE(
+"where 'command' is one of the following:\r\n"
+"\r\n"
+"    list\r\n"
+"        Print all settings and their values.\r\n"
+"    get <key>\r\n"
+"        Print value of the given setting.\r\n"
+"    set <key> <value>\r\n"
+"        Change value of the given setting and store it in the flash.\r\n"
+"    unset <key>\r\n"
+"        Remove value of the given setting, default is used instead.\r\n"
+"    compact\r\n"
+"        Rewrite current values into the next flash sector.\r\n"
+"    status\r\n"
+"        Print state of the settings storage.\r\n"
+    );
+  return true;
+}
+
+static bool appCmdConfigKeyFind(SYS_CMD_DEVICE_NODE* cmd_io,
+                                const char* name,
+                                AppSettingsKey* key) {
+  if (!APP_Settings_KeyFind(name, key)) {
+    COMMAND_PRINT("Unknown setting %s.\r\n", name);
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Commands implementation.
+
+// ============ List ============
+
+static int appCmdConfigList(AppData* app_data,
+                            SYS_CMD_DEVICE_NODE* cmd_io,
+                            int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdConfigUsage(cmd_io, argv[0]);
+  }
+  int key;
+  for (key = 0; key < APP_SETTINGS_NUM_KEYS; ++key) {
+    COMMAND_PRINT("%s = %s\r\n",
+                  APP_Settings_KeyName(key),
+                  APP_Settings_Get(&app_data->settings, key));
+  }
+  return true;
+}
+
+// ============ Get ============
+
+static int appCmdConfigGet(AppData* app_data,
+                           SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc, char** argv) {
+  if (argc != 3) {
+    return appCmdConfigUsage(cmd_io, argv[0]);
+  }
+  AppSettingsKey key;
+  if (!appCmdConfigKeyFind(cmd_io, argv[2], &key)) {
+    return true;
+  }
+  COMMAND_PRINT("%s\r\n", APP_Settings_Get(&app_data->settings, key));
+  return true;
+}
+
+// ============ Set / Unset ============
+
+static int appCmdConfigSet(AppData* app_data,
+                           SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc, char** argv) {
+  const bool is_unset = STREQ(argv[1], "unset");
+  if (argc != (is_unset ? 3 : 4)) {
+    return appCmdConfigUsage(cmd_io, argv[0]);
+  }
+  AppSettingsKey key;
+  if (!appCmdConfigKeyFind(cmd_io, argv[2], &key)) {
+    return true;
+  }
+  if (!APP_Settings_Set(&app_data->settings, key, is_unset ? "" : argv[3])) {
+    COMMAND_PRINT("Value is too long, at max %d characters allowed.\r\n",
+                  APP_SETTINGS_MAX_VALUE);
+    return true;
+  }
+  if (!APP_Settings_IsLoaded(&app_data->settings)) {
+    COMMAND_MESSAGE("Settings are not loaded yet, value will be stored "
+                    "once they are.\r\n");
+  }
+  return true;
+}
+
+// ============ Compact ============
+
+static int appCmdConfigCompact(AppData* app_data,
+                               SYS_CMD_DEVICE_NODE* cmd_io,
+                               int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdConfigUsage(cmd_io, argv[0]);
+  }
+  if (!APP_Settings_IsLoaded(&app_data->settings)) {
+    COMMAND_MESSAGE("Settings are not loaded.\r\n");
+    return true;
+  }
+  APP_Settings_Compact(&app_data->settings);
+  COMMAND_MESSAGE("Compaction has been requested.\r\n");
+  return true;
+}
+
+// ============ Status ============
+
+static int appCmdConfigStatus(AppData* app_data,
+                              SYS_CMD_DEVICE_NODE* cmd_io,
+                              int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdConfigUsage(cmd_io, argv[0]);
+  }
+  const AppSettingsData* settings = &app_data->settings;
+  const AppFlashRawData* flash_raw = &app_data->flash_raw;
+  const char* status = "loading";
+  if (APP_Settings_IsError(&app_data->settings)) {
+    status = "error";
+  } else if (APP_Settings_IsLoaded(&app_data->settings)) {
+    status = "loaded";
+  }
+  COMMAND_PRINT("Settings: %s%s\r\n",
+                status,
+                APP_Settings_IsDirty(&app_data->settings) ? ", dirty" : "");
+  COMMAND_PRINT("Sectors: %d of %u bytes\r\n",
+                settings->num_sectors, settings->sector_size);
+  COMMAND_PRINT("Active sector: %d, sequence %u, tail at %u\r\n",
+                settings->active_sector,
+                settings->active_sequence,
+                settings->tail_offset);
+  COMMAND_PRINT("Records loaded: %u, appends: %u, compactions: %u\r\n",
+                settings->num_records_loaded,
+                settings->num_appends,
+                settings->num_compactions);
+  COMMAND_PRINT("Raw flash: %u bytes read, %u bytes written, %u erases, "
+                "%u errors\r\n",
+                flash_raw->num_bytes_read,
+                flash_raw->num_bytes_written,
+                flash_raw->num_erases,
+                flash_raw->num_errors);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+int APP_Command_Config(AppData* app_data,
+                       SYS_CMD_DEVICE_NODE* cmd_io,
+                       int argc, char** argv) {
+  if (!APP_Command_CheckAvailable(app_data, cmd_io)) {
+    return true;
+  }
+  if (argc == 1) {
+    return appCmdConfigUsage(cmd_io, argv[0]);
+  }
+  if (STREQ(argv[1], "list")) {
+    return appCmdConfigList(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "get")) {
+    return appCmdConfigGet(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "set") || STREQ(argv[1], "unset")) {
+    return appCmdConfigSet(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "compact")) {
+    return appCmdConfigCompact(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "status")) {
+    return appCmdConfigStatus(app_data, cmd_io, argc, argv);
+  } else {
+    // For unknown command show usage.
+    return appCmdConfigUsage(cmd_io, argv[0]);
+  }
+  return true;
+}
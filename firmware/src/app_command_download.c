@@ -0,0 +1,219 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_command_download.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "app.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#include "util_string.h"
+
+#define LOG_PREFIX "APP CMD DOWNLOAD: "
+#define DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static int appCmdDownloadUsage(SYS_CMD_DEVICE_NODE* cmd_io,
+                               const char* argv0) {
+  COMMAND_PRINT("Usage: %s command arguments ...\r\n", argv0);
+  COMMAND_MESSAGE(
+"where 'command' is one of the following:\r\n"
+"\r\n"
+"    get <url> <file> [crc32]\r\n"
+"        Download resource into the file on the flash drive, overwriting\r\n"
+"        it. If CRC-32 is given in hex, stored data is checked against it.\r\n"
+"\r\n"
+"    resume <url> <file> [crc32]\r\n"
+"        Same as get, but only request the part which is not in the file.\r\n"
+"\r\n"
+"    status\r\n"
+"        Show progress of the download, or result of the last one.\r\n"
+"\r\n"
+"    abort\r\n"
+"        Abort download which is in progress.\r\n"
+    );
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Commands implementation.
+
+static void printStatistics(SYS_CMD_DEVICE_NODE* cmd_io,
+                            AppDownloadData* download) {
+  COMMAND_PRINT("Stored: %lu of %lu bytes, %lu bytes/s\r\n",
+                (unsigned long)download->num_bytes_stored,
+                (unsigned long)download->total_size,
+                (unsigned long)APP_Download_Throughput(download));
+  COMMAND_PRINT("Waiting for storage: %d%% of time, %lu times\r\n",
+                APP_Download_ThrottledPercent(download),
+                (unsigned long)download->num_throttles);
+  COMMAND_PRINT("Resumed: %lu times, first time after %lu bytes\r\n",
+                (unsigned long)download->num_resumes,
+                (unsigned long)download->num_bytes_resumed);
+}
+
+// ============ GET / RESUME ============
+
+static bool performDownloadCheckAvailable(AppData* app_data) {
+  return !APP_Download_IsBusy(&app_data->download);
+}
+
+static AppCommandTaskCallbackResult performDownload(
+    AppData* app_data,
+    SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
+    AppCommandTaskCallbackMode mode) {
+  AppDownloadData* download = &app_data->download;
+  AppCommandDownloadData* download_data = &storage->download;
+  switch (mode) {
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      if (!APP_Download_ToFile(download,
+                               download_data->url,
+                               download_data->path,
+                               download_data->resume,
+                               download_data->has_crc ? &download_data->crc
+                                                      : NULL,
+                               NULL)) {
+        COMMAND_MESSAGE("Download can not be started now.\r\n");
+        return APP_COMMAND_TASK_RESULT_FINISHED;
+      }
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+    case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
+      if (APP_Download_IsBusy(download)) {
+        return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+      }
+      if (APP_Download_Error(download) == APP_DOWNLOAD_ERROR_NONE) {
+        COMMAND_PRINT("Downloaded %s, CRC-32 %08lx.\r\n",
+                      download_data->path,
+                      (unsigned long)download->stored_crc);
+        printStatistics(cmd_io, download);
+      } else {
+        COMMAND_PRINT("Download failed: %s.\r\n",
+                      APP_Download_ErrorString(APP_Download_Error(download)));
+      }
+      return APP_COMMAND_TASK_RESULT_FINISHED;
+  }
+  return APP_COMMAND_TASK_RESULT_RUNNING;
+}
+
+static int appCmdDownloadGet(AppData* app_data,
+                             SYS_CMD_DEVICE_NODE* cmd_io,
+                             int argc, char** argv,
+                             bool resume) {
+  if (argc != 4 && argc != 5) {
+    return appCmdDownloadUsage(cmd_io, argv[0]);
+  }
+  if (strlen(argv[2]) >= MAX_URL) {
+    COMMAND_MESSAGE("URL is too long.\r\n");
+    return true;
+  }
+  unsigned long crc = 0;
+  if (argc == 5 && sscanf(argv[4], "%lx", &crc) != 1) {
+    return appCmdDownloadUsage(cmd_io, argv[0]);
+  }
+  char path[APP_DOWNLOAD_MAX_PATH];
+  if (snprintf(path, sizeof(path), "%s/%s",
+               APP_FLASH_MOUNT_POINT, argv[3]) >= (int)sizeof(path)) {
+    COMMAND_MESSAGE("File name is too long.\r\n");
+    return true;
+  }
+  AppCommandTaskStorage* storage =
+      APP_Command_Task_Schedule(&app_data->command.task,
+                                cmd_io,
+                                APP_COMMAND_TASK_RESOURCE_DOWNLOAD,
+                                performDownload,
+                                performDownloadCheckAvailable);
+  AppCommandDownloadData* download_data = &storage->download;
+  safe_strncpy(download_data->url, argv[2], sizeof(download_data->url));
+  safe_strncpy(download_data->path, path, sizeof(download_data->path));
+  download_data->resume = resume;
+  download_data->has_crc = (argc == 5);
+  download_data->crc = crc;
+  return true;
+}
+
+// ============ STATUS ============
+
+static int appCmdDownloadStatus(AppData* app_data,
+                                SYS_CMD_DEVICE_NODE* cmd_io,
+                                int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdDownloadUsage(cmd_io, argv[0]);
+  }
+  AppDownloadData* download = &app_data->download;
+  if (APP_Download_IsBusy(download)) {
+    COMMAND_PRINT("Downloading %s\r\n", download->url);
+  } else {
+    COMMAND_PRINT("Last download: %s\r\n",
+                  APP_Download_ErrorString(APP_Download_Error(download)));
+  }
+  printStatistics(cmd_io, download);
+  return true;
+}
+
+// ============ ABORT ============
+
+static int appCmdDownloadAbort(AppData* app_data,
+                               SYS_CMD_DEVICE_NODE* cmd_io,
+                               int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdDownloadUsage(cmd_io, argv[0]);
+  }
+  if (!APP_Download_IsBusy(&app_data->download)) {
+    COMMAND_MESSAGE("No download in progress.\r\n");
+    return true;
+  }
+  APP_Download_Abort(&app_data->download);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+int APP_Command_Download(AppData* app_data,
+                         SYS_CMD_DEVICE_NODE* cmd_io,
+                         int argc, char** argv) {
+  if (!APP_Command_CheckAvailable(app_data, cmd_io)) {
+    return true;
+  }
+  if (argc == 1) {
+    return appCmdDownloadUsage(cmd_io, argv[0]);
+  }
+  if (STREQ(argv[1], "get")) {
+    return appCmdDownloadGet(app_data, cmd_io, argc, argv, false);
+  } else if (STREQ(argv[1], "resume")) {
+    return appCmdDownloadGet(app_data, cmd_io, argc, argv, true);
+  } else if (STREQ(argv[1], "status")) {
+    return appCmdDownloadStatus(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "abort")) {
+    return appCmdDownloadAbort(app_data, cmd_io, argc, argv);
+  } else {
+    // For unknown command show usage.
+    return appCmdDownloadUsage(cmd_io, argv[0]);
+  }
+  return true;
+}
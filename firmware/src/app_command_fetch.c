@@ -45,9 +45,8 @@ static int appCmdFetchUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
 static void bufferReceivedCallback(const uint8_t* buffer,
                                   uint16_t num_bytes,
                                   void* user_data) {
-  AppData* app_data = (AppData*)user_data;
-  // TOFO(sergey): This doesn't look nice.
-  SYS_CMD_DEVICE_NODE* cmd_io = app_data->command.task.callback_cmd_io;
+  AppCommandFetchData* fetch_data = (AppCommandFetchData*)user_data;
+  SYS_CMD_DEVICE_NODE* cmd_io = fetch_data->cmd_io;
   uint16_t i;
   // TODO(sergey): This is because of some nasty defines in stdio which is
   // indirectly included via system_definitions.h -> tpcpip.h.
@@ -63,18 +62,19 @@ static void bufferReceivedCallback(const uint8_t* buffer,
 }
 
 static void requestHandledCallback(void* user_data) {
-  AppData* app_data = (AppData*)user_data;
-  app_data->command.fetch.request_active = false;
+  AppCommandFetchData* fetch_data = (AppCommandFetchData*)user_data;
+  fetch_data->request_active = false;
 }
 
 static void errorCallback(void* user_data) {
-  AppData* app_data = (AppData*)user_data;
-  app_data->command.fetch.request_active = false;
+  AppCommandFetchData* fetch_data = (AppCommandFetchData*)user_data;
+  fetch_data->request_active = false;
 }
 
 static AppCommandTaskCallbackResult performFetch(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE: {
@@ -82,20 +82,21 @@ static AppCommandTaskCallbackResult performFetch(
       callbacks.buffer_received = bufferReceivedCallback;
       callbacks.request_handled = requestHandledCallback;
       callbacks.error = errorCallback;
-      callbacks.user_data = app_data;
-      app_data->command.fetch.request_active = true;
+      callbacks.user_data = &storage->fetch;
+      storage->fetch.request_active = true;
+      storage->fetch.cmd_io = cmd_io;
       if (!APP_HTTPS_Client_Request(&app_data->https_client,
-                                    app_data->command.fetch.url,
+                                    storage->fetch.url,
                                     &callbacks)) {
         return APP_COMMAND_TASK_RESULT_FINISHED;
       }
-      break;
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     }
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      if (!app_data->command.fetch.request_active) {
+      if (!storage->fetch.request_active) {
         return APP_COMMAND_TASK_RESULT_FINISHED;
       }
-      break;
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -110,21 +111,16 @@ static int appCmdFetch(AppData* app_data,
   if (argc != 2) {
     return appCmdFetchUsage(cmd_io, argv[0]);
   }
-  safe_strncpy(app_data->command.fetch.url,
-               argv[1],
-               sizeof(app_data->command.fetch.url));
-  APP_Command_Task_Schedule(&app_data->command.task,
-                            cmd_io,
-                            performFetch,
-                            performFetchCheckAvailable);
+  AppCommandTaskStorage* storage =
+      APP_Command_Task_Schedule(&app_data->command.task,
+                                cmd_io,
+                                APP_COMMAND_TASK_RESOURCE_HTTPS_CLIENT,
+                                performFetch,
+                                performFetchCheckAvailable);
+  safe_strncpy(storage->fetch.url, argv[1], sizeof(storage->fetch.url));
   return true;
 }
 
-void APP_Command_Fetch_Initialize(AppData* app_data) {
-  // TODO(sergey): Ignore for release builds to save CPU ticks?
-  memset(&app_data->command.fetch, 0, sizeof(app_data->command.fetch));
-}
-
 int APP_Command_Fetch(AppData* app_data,
                       SYS_CMD_DEVICE_NODE* cmd_io,
                       int argc, char** argv) {
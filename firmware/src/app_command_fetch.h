@@ -36,10 +36,10 @@ typedef struct AppCommandFetchData {
 
   // Indicates whether request is still being fetched from server.
   bool request_active;
-} AppCommandFetchData;
 
-// Initialize fetch related command processor state and data.
-void APP_Command_Fetch_Initialize(struct AppData* app_data);
+  // Console to which received data is to be printed.
+  struct SYS_CMD_DEVICE_NODE* cmd_io;
+} AppCommandFetchData;
 
 // Handle `fetch` command line command.
 int APP_Command_Fetch(struct AppData* app_data,
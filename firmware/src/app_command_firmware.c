@@ -0,0 +1,328 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_command_firmware.h"
+
+#include <string.h>
+
+#include "app.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#include "util_string.h"
+
+#define LOG_PREFIX "APP CMD FIRMWARE: "
+#define DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static int appCmdFirmwareUsage(SYS_CMD_DEVICE_NODE* cmd_io,
+                               const char* argv0) {
+  COMMAND_PRINT("Usage: %s command arguments ...\r\n", argv0);
+  COMMAND_MESSAGE(
+"where 'command' is one of the following:\r\n"
+"\r\n"
+"    update <url> <sha256>\r\n"
+"        Download firmware image into the staging area of the flash and\r\n"
+"        check it against SHA-256 given in hex. Interrupted update of the\r\n"
+"        same image continues from the last checkpoint.\r\n"
+"\r\n"
+"    status\r\n"
+"        Show state of the staged image and progress of the download.\r\n"
+"\r\n"
+"    apply\r\n"
+"        Hand the staged image over to the bootloader and reset.\r\n"
+"\r\n"
+"    abort\r\n"
+"        Abort download of the image, it can be resumed later.\r\n"
+    );
+  return true;
+}
+
+static int hexDigitValue(char ch) {
+  if (ch >= '0' && ch <= '9') {
+    return ch - '0';
+  } else if (ch >= 'a' && ch <= 'f') {
+    return ch - 'a' + 10;
+  } else if (ch >= 'A' && ch <= 'F') {
+    return ch - 'A' + 10;
+  }
+  return -1;
+}
+
+// Parse SHA-256 given as 64 hex digits.
+static bool hashParse(const char* text,
+                      uint8_t hash[APP_FIRMWARE_UPDATE_HASH_SIZE]) {
+  int i;
+  if (strlen(text) != APP_FIRMWARE_UPDATE_HASH_SIZE * 2) {
+    return false;
+  }
+  for (i = 0; i < APP_FIRMWARE_UPDATE_HASH_SIZE; ++i) {
+    const int high = hexDigitValue(text[i * 2]);
+    const int low = hexDigitValue(text[i * 2 + 1]);
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    hash[i] = (high << 4) | low;
+  }
+  return true;
+}
+
+static void printProgress(SYS_CMD_DEVICE_NODE* cmd_io,
+                          AppDownloadData* download) {
+  COMMAND_PRINT("Downloaded: %lu of %lu bytes, %lu bytes/s "
+                "(limit %lu bytes/s)\r\n",
+                (unsigned long)download->num_bytes_stored,
+                (unsigned long)download->total_size,
+                (unsigned long)APP_Download_Throughput(download),
+                (unsigned long)APP_CONFIG_FIRMWARE_UPDATE_MAX_RATE);
+  COMMAND_PRINT("Waiting for storage: %d%% of time, resumed %lu times\r\n",
+                APP_Download_ThrottledPercent(download),
+                (unsigned long)download->num_resumes);
+}
+
+// ============ UPDATE ============
+
+static bool performUpdateCheckAvailable(AppData* app_data) {
+  return !APP_FirmwareUpdate_IsBusy(&app_data->firmware_update) &&
+         !APP_Download_IsBusy(&app_data->download);
+}
+
+static AppCommandTaskCallbackResult performUpdate(
+    AppData* app_data,
+    SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
+    AppCommandTaskCallbackMode mode) {
+  AppFirmwareUpdateData* firmware_update = &app_data->firmware_update;
+  AppCommandFirmwareData* firmware_data = &storage->firmware;
+  AppFirmwareUpdateError error;
+  switch (mode) {
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      if (!APP_FirmwareUpdate_Start(firmware_update,
+                                    firmware_data->url,
+                                    firmware_data->hash)) {
+        COMMAND_MESSAGE("Update can not be started now.\r\n");
+        return APP_COMMAND_TASK_RESULT_FINISHED;
+      }
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+    case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
+      if (APP_FirmwareUpdate_IsBusy(firmware_update)) {
+        return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+      }
+      error = APP_FirmwareUpdate_Error(firmware_update);
+      if (error == APP_FIRMWARE_UPDATE_ERROR_NONE) {
+        COMMAND_PRINT("Staged image of %lu bytes.\r\n",
+                      (unsigned long)firmware_update->image_size);
+      } else if (error == APP_FIRMWARE_UPDATE_ERROR_DOWNLOAD) {
+        COMMAND_PRINT("Update failed: %s, %lu bytes can be resumed.\r\n",
+                      APP_Download_ErrorString(
+                          APP_Download_Error(&app_data->download)),
+                      (unsigned long)firmware_update->num_bytes_stored);
+      } else {
+        COMMAND_PRINT("Update failed: %s.\r\n",
+                      APP_FirmwareUpdate_ErrorString(error));
+      }
+      printProgress(cmd_io, &app_data->download);
+      return APP_COMMAND_TASK_RESULT_FINISHED;
+  }
+  return APP_COMMAND_TASK_RESULT_RUNNING;
+}
+
+static int appCmdFirmwareUpdate(AppData* app_data,
+                                SYS_CMD_DEVICE_NODE* cmd_io,
+                                int argc, char** argv) {
+  if (argc != 4) {
+    return appCmdFirmwareUsage(cmd_io, argv[0]);
+  }
+  if (strlen(argv[2]) >= MAX_URL) {
+    COMMAND_MESSAGE("URL is too long.\r\n");
+    return true;
+  }
+  uint8_t hash[APP_FIRMWARE_UPDATE_HASH_SIZE];
+  if (!hashParse(argv[3], hash)) {
+    COMMAND_MESSAGE("SHA-256 is to be 64 hex digits.\r\n");
+    return true;
+  }
+  AppCommandTaskStorage* storage =
+      APP_Command_Task_Schedule(&app_data->command.task,
+                                cmd_io,
+                                APP_COMMAND_TASK_RESOURCE_FIRMWARE_UPDATE,
+                                performUpdate,
+                                performUpdateCheckAvailable);
+  AppCommandFirmwareData* firmware_data = &storage->firmware;
+  safe_strncpy(firmware_data->url, argv[2], sizeof(firmware_data->url));
+  memcpy(firmware_data->hash, hash, sizeof(hash));
+  return true;
+}
+
+// ============ STATUS ============
+
+static int appCmdFirmwareStatus(AppData* app_data,
+                                SYS_CMD_DEVICE_NODE* cmd_io,
+                                int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdFirmwareUsage(cmd_io, argv[0]);
+  }
+  AppFirmwareUpdateData* firmware_update = &app_data->firmware_update;
+  int i;
+  COMMAND_PRINT("Image: %s, %lu bytes stored\r\n",
+                APP_FirmwareUpdate_StatusString(firmware_update->status),
+                (unsigned long)firmware_update->num_bytes_stored);
+  if (firmware_update->status != APP_FIRMWARE_UPDATE_STATUS_NONE) {
+    COMMAND_PRINT("URL: %s\r\n", firmware_update->url);
+    COMMAND_MESSAGE("SHA-256: ");
+    for (i = 0; i < APP_FIRMWARE_UPDATE_HASH_SIZE; ++i) {
+      COMMAND_PRINT("%02x", firmware_update->hash[i]);
+    }
+    COMMAND_MESSAGE("\r\n");
+  }
+  COMMAND_PRINT("Last result: %s\r\n",
+                APP_FirmwareUpdate_ErrorString(
+                    APP_FirmwareUpdate_Error(firmware_update)));
+  if (firmware_update->state == APP_FIRMWARE_UPDATE_STATE_DOWNLOAD) {
+    printProgress(cmd_io, &app_data->download);
+  }
+  COMMAND_PRINT("Records: %lu loaded, %lu written, %lu checkpoints\r\n",
+                (unsigned long)firmware_update->num_records_loaded,
+                (unsigned long)firmware_update->num_records_written,
+                (unsigned long)firmware_update->num_checkpoints);
+  // NOTE: All buffers are static, usage does not grow with the image size.
+  COMMAND_PRINT("Memory: %u bytes (update %u, download %u)\r\n",
+                (unsigned)(sizeof(AppFirmwareUpdateData) +
+                           sizeof(AppDownloadData)),
+                (unsigned)sizeof(AppFirmwareUpdateData),
+                (unsigned)sizeof(AppDownloadData));
+  return true;
+}
+
+// ============ APPLY ============
+
+static bool performApplyCheckAvailable(AppData* app_data) {
+  return !APP_FirmwareUpdate_IsBusy(&app_data->firmware_update);
+}
+
+// Check whether everything which is kept in RAM is written to the flash.
+static bool isFlashSettled(AppData* app_data) {
+  return !APP_FlashCache_IsDirty(&app_data->flash_cache) &&
+         !APP_History_IsDirty(&app_data->history) &&
+         !APP_Settings_IsDirty(&app_data->settings) &&
+         !APP_FlashRaw_IsBusy(&app_data->flash_raw);
+}
+
+static AppCommandTaskCallbackResult performApply(
+    AppData* app_data,
+    SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
+    AppCommandTaskCallbackMode mode) {
+  AppFirmwareUpdateData* firmware_update = &app_data->firmware_update;
+  AppCommandFirmwareData* firmware_data = &storage->firmware;
+  switch (mode) {
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      if (!APP_FirmwareUpdate_Apply(firmware_update)) {
+        COMMAND_MESSAGE("There is no staged image.\r\n");
+        return APP_COMMAND_TASK_RESULT_FINISHED;
+      }
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+    case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
+      if (APP_FirmwareUpdate_IsBusy(firmware_update)) {
+        return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+      }
+      if (!firmware_data->is_flushing) {
+        if (APP_FirmwareUpdate_Error(firmware_update) !=
+            APP_FIRMWARE_UPDATE_ERROR_NONE) {
+          COMMAND_PRINT("Apply failed: %s.\r\n",
+                        APP_FirmwareUpdate_ErrorString(
+                            APP_FirmwareUpdate_Error(firmware_update)));
+          return APP_COMMAND_TASK_RESULT_FINISHED;
+        }
+        COMMAND_MESSAGE("Image is handed over to the bootloader, "
+                        "resetting.\r\n");
+        APP_FlashCache_Flush(&app_data->flash_cache);
+        APP_History_Flush(&app_data->history);
+        firmware_data->is_flushing = true;
+      }
+      if (!isFlashSettled(app_data)) {
+        return APP_COMMAND_TASK_RESULT_RUNNING;
+      }
+      SYS_RESET_SoftwareReset();
+      return APP_COMMAND_TASK_RESULT_FINISHED;
+  }
+  return APP_COMMAND_TASK_RESULT_RUNNING;
+}
+
+static int appCmdFirmwareApply(AppData* app_data,
+                               SYS_CMD_DEVICE_NODE* cmd_io,
+                               int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdFirmwareUsage(cmd_io, argv[0]);
+  }
+  APP_Command_Task_Schedule(&app_data->command.task,
+                            cmd_io,
+                            APP_COMMAND_TASK_RESOURCE_FIRMWARE_UPDATE,
+                            performApply,
+                            performApplyCheckAvailable);
+  return true;
+}
+
+// ============ ABORT ============
+
+static int appCmdFirmwareAbort(AppData* app_data,
+                               SYS_CMD_DEVICE_NODE* cmd_io,
+                               int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdFirmwareUsage(cmd_io, argv[0]);
+  }
+  if (app_data->firmware_update.state != APP_FIRMWARE_UPDATE_STATE_DOWNLOAD) {
+    COMMAND_MESSAGE("No update in progress.\r\n");
+    return true;
+  }
+  APP_FirmwareUpdate_Abort(&app_data->firmware_update);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+int APP_Command_Firmware(AppData* app_data,
+                         SYS_CMD_DEVICE_NODE* cmd_io,
+                         int argc, char** argv) {
+  if (!APP_Command_CheckAvailable(app_data, cmd_io)) {
+    return true;
+  }
+  if (argc == 1) {
+    return appCmdFirmwareUsage(cmd_io, argv[0]);
+  }
+  if (STREQ(argv[1], "update")) {
+    return appCmdFirmwareUpdate(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "status")) {
+    return appCmdFirmwareStatus(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "apply")) {
+    return appCmdFirmwareApply(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "abort")) {
+    return appCmdFirmwareAbort(app_data, cmd_io, argc, argv);
+  } else {
+    // For unknown command show usage.
+    return appCmdFirmwareUsage(cmd_io, argv[0]);
+  }
+  return true;
+}
@@ -37,11 +37,20 @@ static int appCmdFlashUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
   COMMAND_MESSAGE(
 "where 'command' is one of the following:\r\n"
 "\r\n"
+"    status\r\n"
+"        Show state of the flash drive and progress of its format.\r\n"
+"\r\n"
+"    cache\r\n"
+"        Show statistics of the sector cache.\r\n"
+"\r\n"
+"    sync\r\n"
+"        Write all sectors which are only in the cache to the flash.\r\n"
+"\r\n"
 "    sectors\r\n"
 "        Query information about number of total and free sectors.\r\n"
 "\r\n"
 "    format\r\n"
-"        Format the whole flash drive.\r\n"
+"        Format the whole flash drive, waits until format is finished.\r\n"
     );
   return true;
 }
@@ -53,11 +62,112 @@ static bool performFlashCheckAvailable(AppData* app_data) {
   return !APP_Flash_IsBusy(&app_data->flash);
 }
 
+// ============ STATUS ============
+
+static int appCmdFlashStatus(AppData* app_data,
+                             SYS_CMD_DEVICE_NODE* cmd_io,
+                             int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdFlashUsage(cmd_io, argv[0]);
+  }
+  AppFlashData* flash = &app_data->flash;
+  if (APP_Flash_IsError(flash)) {
+    COMMAND_MESSAGE("Flash: error\r\n");
+  } else if (APP_Flash_IsFormatting(flash)) {
+    COMMAND_PRINT("Flash: formatting, %d%% done\r\n",
+                  APP_Flash_FormatProgress(flash));
+  } else if (APP_Flash_IsBusy(flash)) {
+    COMMAND_MESSAGE("Flash: mounting\r\n");
+  } else {
+    COMMAND_MESSAGE("Flash: ready\r\n");
+  }
+  if (flash->num_mount_attempts != 0) {
+    COMMAND_PRINT("Failed mount attempts: %u, next retry in %u ms\r\n",
+                  flash->num_mount_attempts,
+                  flash->mount_retry_interval);
+  }
+  return true;
+}
+
+// ============ CACHE ============
+
+static int appCmdFlashCache(AppData* app_data,
+                            SYS_CMD_DEVICE_NODE* cmd_io,
+                            int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdFlashUsage(cmd_io, argv[0]);
+  }
+  AppFlashCacheData* cache = &app_data->flash_cache;
+  COMMAND_PRINT("Cache: %d lines of %d bytes, %d dirty%s\r\n",
+                APP_CONFIG_FLASH_CACHE_NUM_LINES,
+                APP_FLASH_CACHE_LINE_SIZE,
+                cache->num_dirty_lines,
+                (cache->has_geometry && !cache->is_enabled) ? ", bypassed"
+                                                             : "");
+  COMMAND_PRINT("Reads: %u hits, %u misses, %d%% hit rate\r\n",
+                cache->num_read_hits,
+                cache->num_read_misses,
+                APP_FlashCache_ReadHitRate(cache));
+  COMMAND_PRINT("Writes: %u cached, %u bypassed\r\n",
+                cache->num_write_hits,
+                cache->num_write_bypasses);
+  COMMAND_PRINT("Flushes: %u lines in %u erase blocks, %u errors\r\n",
+                cache->num_lines_flushed,
+                cache->num_flushes,
+                cache->num_errors);
+  return true;
+}
+
+// ============ SYNC ============
+
+static AppCommandTaskCallbackResult performFlashSync(
+    AppData* app_data,
+    SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
+    AppCommandTaskCallbackMode mode) {
+  AppFlashCacheData* cache = &app_data->flash_cache;
+  switch (mode) {
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      if (!APP_FlashCache_IsDirty(cache)) {
+        COMMAND_MESSAGE("Nothing to write.\r\n");
+        return APP_COMMAND_TASK_RESULT_FINISHED;
+      }
+      APP_FlashCache_Flush(cache);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+    case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
+      if (cache->is_flush_requested) {
+        return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+      }
+      if (APP_FlashCache_IsDirty(cache)) {
+        COMMAND_MESSAGE("Error writing cache to the flash.\r\n");
+      } else {
+        COMMAND_MESSAGE("Cache is written to the flash.\r\n");
+      }
+      return APP_COMMAND_TASK_RESULT_FINISHED;
+  }
+  return APP_COMMAND_TASK_RESULT_RUNNING;
+}
+
+static int appCmdFlashSync(AppData* app_data,
+                           SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdFlashUsage(cmd_io, argv[0]);
+  }
+  APP_Command_Task_Schedule(&app_data->command.task,
+                            cmd_io,
+                            APP_COMMAND_TASK_RESOURCE_FLASH,
+                            performFlashSync,
+                            performFlashCheckAvailable);
+  return true;
+}
+
 // ============ SECTORS ============
 
 static AppCommandTaskCallbackResult performFlashSectors(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE: {
@@ -84,6 +194,7 @@ static int appCmdFlashSectors(AppData* app_data,
   }
   APP_Command_Task_Schedule(&app_data->command.task,
                             cmd_io,
+                            APP_COMMAND_TASK_RESOURCE_FLASH,
                             performFlashSectors,
                             performFlashCheckAvailable);
   return true;
@@ -91,20 +202,35 @@ static int appCmdFlashSectors(AppData* app_data,
 
 // ============ FORMAT ============
 
+// Format is also allowed when the flash failed, so the broken drive can be
+// recovered.
+static bool performFlashFormatCheckAvailable(AppData* app_data) {
+  return !APP_Flash_IsBusy(&app_data->flash) ||
+         APP_Flash_IsError(&app_data->flash);
+}
+
 static AppCommandTaskCallbackResult performFlashFormat(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
+  AppFlashData* flash = &app_data->flash;
   switch (mode) {
-    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE: {
-      if (APP_Flash_DriveFormat()) {
-        COMMAND_MESSAGE("Drive is formatted.\r\n");
-      } else {
-        COMMAND_MESSAGE("Error formatting the drive.\r\n");
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      if (!APP_Flash_FormatRequest(flash)) {
+        COMMAND_MESSAGE("Flash drive can not be formatted now.\r\n");
+        return APP_COMMAND_TASK_RESULT_FINISHED;
       }
-      break;
-    }
+      COMMAND_MESSAGE("Formatting the drive...\r\n");
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
+      if (APP_Flash_IsError(flash)) {
+        COMMAND_MESSAGE("Error formatting the drive.\r\n");
+      } else if (APP_Flash_IsBusy(flash)) {
+        return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+      } else {
+        COMMAND_MESSAGE("Drive is formatted.\r\n");
+      }
       return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
@@ -118,8 +244,9 @@ static int appCmdFlashFormat(AppData* app_data,
   }
   APP_Command_Task_Schedule(&app_data->command.task,
                             cmd_io,
+                            APP_COMMAND_TASK_RESOURCE_FLASH,
                             performFlashFormat,
-                            performFlashCheckAvailable);
+                            performFlashFormatCheckAvailable);
   return true;
 }
 
@@ -135,7 +262,13 @@ int APP_Command_Flash(AppData* app_data,
   if (argc == 1) {
     return appCmdFlashUsage(cmd_io, argv[0]);
   }
-  if (STREQ(argv[1], "sectors")) {
+  if (STREQ(argv[1], "status")) {
+    return appCmdFlashStatus(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "cache")) {
+    return appCmdFlashCache(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "sync")) {
+    return appCmdFlashSync(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "sectors")) {
     return appCmdFlashSectors(app_data, cmd_io, argc, argv);
   } else if (STREQ(argv[1], "format")) {
     return appCmdFlashFormat(app_data, cmd_io, argc, argv);
@@ -0,0 +1,230 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_command_history.h"
+
+#include <stdlib.h>
+
+#include "app.h"
+#include "system_definitions.h"
+#include "util_time.h"
+#include "utildefines.h"
+
+#define LOG_PREFIX "APP CMD HISTORY: "
+#define DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+// Hours of history shown when no range is given.
+#define DEFAULT_SHOW_HOURS 24
+
+// Maximum number of samples printed in a single update, so the console
+// buffer is not overflown and other tasks are not starved.
+#define MAX_SAMPLES_PER_UPDATE 16
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static int appCmdHistoryUsage(SYS_CMD_DEVICE_NODE* cmd_io,
+                              const char* argv0) {
+  COMMAND_PRINT("Usage: %s command arguments ...\r\n", argv0);
+  COMMAND_MESSAGE(
+"where 'command' is one of the following:\r\n"
+"\r\n"
+"    status\r\n"
+"        Print state of the history storage.\r\n"
+"    show [<hours>]\r\n"
+"        Print values received during the given number of hours, 24 hours\r\n"
+"        by default. Zero shows all the stored values.\r\n"
+"    flush\r\n"
+"        Program values which are only kept in memory to the flash.\r\n"
+    );
+  return true;
+}
+
+static void appCmdHistoryPrintSample(SYS_CMD_DEVICE_NODE* cmd_io,
+                                     const AppHistorySample* sample) {
+  CalendarTime calendar_time;
+  calendar_time_from_seconds(sample->timestamp, &calendar_time);
+  COMMAND_PRINT("%04d-%02d-%02d %02d:%02d:%02d %d\r\n",
+                calendar_time.year,
+                calendar_time.month,
+                calendar_time.day,
+                calendar_time.hours,
+                calendar_time.minutes,
+                calendar_time.seconds,
+                sample->value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Commands implementation.
+
+static bool performHistoryCheckAvailable(AppData* app_data) {
+  return APP_History_IsLoaded(&app_data->history);
+}
+
+// ============ Status ============
+
+static int appCmdHistoryStatus(AppData* app_data,
+                               SYS_CMD_DEVICE_NODE* cmd_io,
+                               int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdHistoryUsage(cmd_io, argv[0]);
+  }
+  AppHistoryData* history = &app_data->history;
+  const char* status = "loading";
+  if (APP_History_IsError(history)) {
+    status = "error";
+  } else if (APP_History_IsLoaded(history)) {
+    status = "loaded";
+  }
+  COMMAND_PRINT("History: %s%s\r\n",
+                status,
+                APP_History_IsDirty(history) ? ", dirty" : "");
+  COMMAND_PRINT("Sectors: %d of %u bytes\r\n",
+                history->num_sectors, history->sector_size);
+  COMMAND_PRINT("Active sector: %d, sequence %u, page %u at %u\r\n",
+                history->active_sector,
+                history->active_sequence,
+                history->page_index,
+                history->page_used);
+  if (history->has_last) {
+    COMMAND_MESSAGE("Last sample: ");
+    appCmdHistoryPrintSample(cmd_io, &history->last);
+  }
+  COMMAND_PRINT("Samples: %u stored, %u dropped, %u bytes encoded\r\n",
+                history->num_samples,
+                history->num_samples_dropped,
+                history->num_bytes_encoded);
+  COMMAND_PRINT("Flash: %u page writes, %u erases\r\n",
+                history->num_page_writes,
+                history->num_erases);
+  return true;
+}
+
+// ============ Show ============
+
+static AppCommandTaskCallbackResult performHistoryShow(
+    AppData* app_data,
+    SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
+    AppCommandTaskCallbackMode mode) {
+  AppHistoryQuery* query = &storage->history.show.query;
+  if (mode == APP_COMMAND_TASK_MODE_CALLBACK_INVOKE) {
+    const uint32_t num_seconds = storage->history.show.num_hours * 60 * 60;
+    uint32_t now;
+    uint32_t from = 0;
+    if (num_seconds != 0 && APP_RTC_TimestampGet(&app_data->rtc, &now)) {
+      from = (now > num_seconds) ? now - num_seconds : 0;
+    }
+    APP_History_QueryBegin(&app_data->history, query, from, UINT32_MAX);
+  }
+  AppHistorySample sample;
+  int num_printed = 0;
+  while (num_printed < MAX_SAMPLES_PER_UPDATE &&
+         APP_History_QueryNext(query, &sample)) {
+    appCmdHistoryPrintSample(cmd_io, &sample);
+    ++num_printed;
+  }
+  storage->history.show.num_samples += num_printed;
+  if (num_printed == MAX_SAMPLES_PER_UPDATE) {
+    // Continue with the rest of the page in the next update.
+    return APP_COMMAND_TASK_RESULT_RUNNING;
+  }
+  if (!APP_History_QueryIsFinished(query)) {
+    APP_History_QueryFetch(query);
+    // NOTE: If the read could not be queued the query stays ready and the
+    // fetch is attempted again in the next update.
+    return APP_History_QueryIsPending(query)
+               ? APP_COMMAND_TASK_RESULT_WAIT_EVENT
+               : APP_COMMAND_TASK_RESULT_RUNNING;
+  }
+  if (query->is_error) {
+    COMMAND_MESSAGE("Error reading history from the flash.\r\n");
+  }
+  COMMAND_PRINT("%u samples.\r\n", storage->history.show.num_samples);
+  return APP_COMMAND_TASK_RESULT_FINISHED;
+}
+
+static int appCmdHistoryShow(AppData* app_data,
+                             SYS_CMD_DEVICE_NODE* cmd_io,
+                             int argc, char** argv) {
+  if (argc > 3) {
+    return appCmdHistoryUsage(cmd_io, argv[0]);
+  }
+  const int num_hours = (argc == 3) ? atoi(argv[2]) : DEFAULT_SHOW_HOURS;
+  if (num_hours < 0) {
+    return appCmdHistoryUsage(cmd_io, argv[0]);
+  }
+  if (APP_History_IsError(&app_data->history)) {
+    COMMAND_MESSAGE("History is not available.\r\n");
+    return true;
+  }
+  AppCommandTaskStorage* storage =
+      APP_Command_Task_Schedule(&app_data->command.task,
+                                cmd_io,
+                                APP_COMMAND_TASK_RESOURCE_HISTORY,
+                                performHistoryShow,
+                                performHistoryCheckAvailable);
+  storage->history.show.num_hours = num_hours;
+  return true;
+}
+
+// ============ Flush ============
+
+static int appCmdHistoryFlush(AppData* app_data,
+                              SYS_CMD_DEVICE_NODE* cmd_io,
+                              int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdHistoryUsage(cmd_io, argv[0]);
+  }
+  if (!APP_History_IsDirty(&app_data->history)) {
+    COMMAND_MESSAGE("All values are stored in the flash.\r\n");
+    return true;
+  }
+  APP_History_Flush(&app_data->history);
+  COMMAND_MESSAGE("Flush has been requested.\r\n");
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+int APP_Command_History(AppData* app_data,
+                        SYS_CMD_DEVICE_NODE* cmd_io,
+                        int argc, char** argv) {
+  if (!APP_Command_CheckAvailable(app_data, cmd_io)) {
+    return true;
+  }
+  if (argc == 1) {
+    return appCmdHistoryUsage(cmd_io, argv[0]);
+  }
+  if (STREQ(argv[1], "status")) {
+    return appCmdHistoryStatus(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "show")) {
+    return appCmdHistoryShow(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "flush")) {
+    return appCmdHistoryFlush(app_data, cmd_io, argc, argv);
+  } else {
+    // For unknown command show usage.
+    return appCmdHistoryUsage(cmd_io, argv[0]);
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_COMMAND_HISTORY_H
+#define _APP_COMMAND_HISTORY_H
+
+#include <stdbool.h>
+
+#include "app_history.h"
+
+struct AppData;
+struct SYS_CMD_DEVICE_NODE;
+
+typedef struct AppCommandHistoryData {
+  // Storage for `show` command.
+  struct {
+    // Number of hours before now to be shown, zero to show everything.
+    uint32_t num_hours;
+    // Query over the stored samples, pages are read one by one.
+    AppHistoryQuery query;
+    // Number of samples printed so far.
+    uint32_t num_samples;
+  } show;
+} AppCommandHistoryData;
+
+// Handle `history` command line command.
+int APP_Command_History(struct AppData* app_data,
+                        struct SYS_CMD_DEVICE_NODE* cmd_io,
+                        int argc, char** argv);
+
+#endif  // _APP_COMMAND_HISTORY_H
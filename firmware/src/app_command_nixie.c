@@ -26,6 +26,7 @@
 #include "system_definitions.h"
 #include "utildefines.h"
 #include "util_string.h"
+#include "util_time.h"
 
 #define LOG_PREFIX "APP CMD NIXIE: "
 #define DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
@@ -46,6 +47,20 @@ static int appCmdNixieUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
 "        Enable or disable periodic tasks.\r\n"
 "    fetch\r\n"
 "        Fetch value from server and show it in the console.\r\n"
+"    refresh\r\n"
+"        Re-send current frame to shift registers, even if it did not change.\r\n"
+"    stats\r\n"
+"        Print number of sent and suppressed (unchanged) frames, and\r\n"
+"        statistics of the animation player.\r\n"
+"    stats reset\r\n"
+"        Reset frame statistics.\r\n"
+"    value\r\n"
+"        Print displayed value, when it was received and whether it is\r\n"
+"        stale value restored from the RTC snapshot.\r\n"
+"    play cleanup [<loops> [<fps>]]\r\n"
+"        Cycle all digits to prevent cathode poisoning.\r\n"
+"    play roll <value> [<fps>]\r\n"
+"        Roll digits from current value to the given one.\r\n"
     );
   return true;
 }
@@ -62,11 +77,12 @@ static bool performNixieCheckAvailable(AppData* app_data) {
 static AppCommandTaskCallbackResult performNixieDisplay(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
       APP_Nixie_Display(&app_data->nixie,
-                        app_data->command.nixie._private.display.value);
+                        storage->nixie._private.display.value);
       break;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
       return APP_COMMAND_TASK_RESULT_FINISHED;
@@ -81,21 +97,21 @@ static int appCmdNixieDisplay(AppData* app_data,
     return appCmdNixieUsage(cmd_io, argv[0]);
   }
   const char* value = argv[2];
-  // Make sure all possibly unused digits are zeroed.
-  memset(app_data->command.nixie._private.display.value,
-         0,
-         sizeof(app_data->command.nixie._private.display.value));
+  AppCommandTaskStorage* storage =
+      APP_Command_Task_Schedule(&app_data->command.task,
+                                cmd_io,
+                                APP_COMMAND_TASK_RESOURCE_NIXIE,
+                                performNixieDisplay,
+                                performNixieCheckAvailable);
+  // NOTE: Storage is zeroed by the scheduler, so all possibly unused digits
+  // are zero.
   // Copy at max of display size digits.
-  strncpy(app_data->command.nixie._private.display.value,
+  strncpy(storage->nixie._private.display.value,
           value,
-          sizeof(app_data->command.nixie._private.display.value));
+          sizeof(storage->nixie._private.display.value));
   // Reverse array in memory to match layout in nixie module/
-  reverse_bytes(app_data->command.nixie._private.display.value,
-                sizeof(app_data->command.nixie._private.display.value));
-  APP_Command_Task_Schedule(&app_data->command.task,
-                            cmd_io,
-                            performNixieDisplay,
-                            performNixieCheckAvailable);
+  reverse_bytes(storage->nixie._private.display.value,
+                sizeof(storage->nixie._private.display.value));
   return true;
 }
 
@@ -128,27 +144,28 @@ static int appCmdNixiePeriodic(AppData* app_data,
 static AppCommandTaskCallbackResult performNixieFetch(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE: {
-      APP_Nixie_Fetch(&app_data->nixie,
-                      &app_data->command.nixie._private.fetch.is_fetched,
-                      app_data->command.nixie._private.fetch.value);
-      break;
+      if (!APP_Nixie_Fetch(&app_data->nixie,
+                           &storage->nixie._private.fetch.is_fetched,
+                           storage->nixie._private.fetch.value)) {
+        COMMAND_MESSAGE("Nixie module is busy.\r\n");
+        return APP_COMMAND_TASK_RESULT_FINISHED;
+      }
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     }
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if someone else made nixie module busy?
-      if (!APP_Nixie_IsBusy(&app_data->nixie)) {
-        if (app_data->command.nixie._private.fetch.is_fetched) {
-          COMMAND_PRINT("Value from server: " NIXIE_DISPLAY_FORMAT "\r\n",
-                        NIXIE_DISPLAY_VALUES(
-                            app_data->command.nixie._private.fetch.value));
-        } else {
-          COMMAND_MESSAGE("Error fetching value from server.\r\n");
-        }
-        return APP_COMMAND_TASK_RESULT_FINISHED;
+      if (storage->nixie._private.fetch.is_fetched) {
+        COMMAND_PRINT("Value from server: " NIXIE_DISPLAY_FORMAT "\r\n",
+                      NIXIE_DISPLAY_VALUES(
+                          &app_data->nixie,
+                          storage->nixie._private.fetch.value));
+      } else {
+        COMMAND_MESSAGE("Error fetching value from server.\r\n");
       }
-      break;
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -161,18 +178,138 @@ static int appCmdNixieFetch(AppData* app_data,
   }
   APP_Command_Task_Schedule(&app_data->command.task,
                             cmd_io,
+                            APP_COMMAND_TASK_RESOURCE_NIXIE,
                             performNixieFetch,
                             performNixieCheckAvailable);
   return true;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// Public API.
+// ============ Refresh ============
+
+static AppCommandTaskCallbackResult performNixieRefresh(
+    AppData* app_data,
+    SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
+    AppCommandTaskCallbackMode mode) {
+  switch (mode) {
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      APP_Nixie_Refresh(&app_data->nixie);
+      break;
+    case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
+      return APP_COMMAND_TASK_RESULT_FINISHED;
+  }
+  return APP_COMMAND_TASK_RESULT_RUNNING;
+}
 
-void APP_Command_Nixie_Initialize(AppData* app_data) {
-  // TODO(sergey): Memset to zero in debug mode?
+static int appCmdNixieRefresh(AppData* app_data,
+                              SYS_CMD_DEVICE_NODE* cmd_io,
+                              int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdNixieUsage(cmd_io, argv[0]);
+  }
+  APP_Command_Task_Schedule(&app_data->command.task,
+                            cmd_io,
+                            APP_COMMAND_TASK_RESOURCE_NIXIE,
+                            performNixieRefresh,
+                            performNixieCheckAvailable);
+  return true;
 }
 
+// ============ Stats ============
+
+static int appCmdNixieStats(AppData* app_data,
+                            SYS_CMD_DEVICE_NODE* cmd_io,
+                            int argc, char** argv) {
+  if (argc == 2) {
+    uint32_t num_frames_sent, num_frames_suppressed;
+    APP_Nixie_FrameStatisticsGet(&app_data->nixie,
+                                 &num_frames_sent,
+                                 &num_frames_suppressed);
+    uint32_t num_frames_played, num_missed_deadlines;
+    APP_Nixie_PlayerStatisticsGet(&app_data->nixie,
+                                  &num_frames_played,
+                                  &num_missed_deadlines);
+    COMMAND_PRINT("Frames sent: %u, suppressed: %u\r\n",
+                  num_frames_sent, num_frames_suppressed);
+    COMMAND_PRINT("Player frames played: %u, missed deadlines: %u\r\n",
+                  num_frames_played, num_missed_deadlines);
+    return true;
+  }
+  if (argc == 3 && STREQ(argv[2], "reset")) {
+    APP_Nixie_FrameStatisticsReset(&app_data->nixie);
+    return true;
+  }
+  return appCmdNixieUsage(cmd_io, argv[0]);
+}
+
+// ============ Value ============
+
+static int appCmdNixieValue(AppData* app_data,
+                            SYS_CMD_DEVICE_NODE* cmd_io,
+                            int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdNixieUsage(cmd_io, argv[0]);
+  }
+  const AppNixieData* app_nixie_data = &app_data->nixie;
+  COMMAND_PRINT("Value: " NIXIE_DISPLAY_FORMAT "%s\r\n",
+                NIXIE_DISPLAY_VALUES(app_nixie_data,
+                                     app_nixie_data->display_value),
+                app_nixie_data->is_display_value_stale ? " (stale)" : "");
+  if (app_nixie_data->display_value_timestamp != 0) {
+    CalendarTime calendar_time;
+    calendar_time_from_seconds(app_nixie_data->display_value_timestamp,
+                               &calendar_time);
+    COMMAND_PRINT("Received: %04d-%02d-%02d %02d:%02d:%02d\r\n",
+                  calendar_time.year,
+                  calendar_time.month,
+                  calendar_time.day,
+                  calendar_time.hours,
+                  calendar_time.minutes,
+                  calendar_time.seconds);
+  }
+  if (app_nixie_data->display_value_etag[0] != '\0') {
+    COMMAND_PRINT("ETag: %s\r\n", app_nixie_data->display_value_etag);
+  }
+  return true;
+}
+
+// ============ Play ============
+
+#define DEFAULT_PLAYER_FPS 50
+
+static int appCmdNixiePlay(AppData* app_data,
+                           SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc, char** argv) {
+  bool ok;
+  if (argc >= 3 && argc <= 5 && STREQ(argv[2], "cleanup")) {
+    const int num_loops = (argc >= 4) ? atoi(argv[3]) : 1;
+    const int fps = (argc >= 5) ? atoi(argv[4]) : DEFAULT_PLAYER_FPS;
+    if (num_loops <= 0 || fps <= 0) {
+      return appCmdNixieUsage(cmd_io, argv[0]);
+    }
+    ok = APP_Nixie_PlayerStartCathodeCleanup(&app_data->nixie, num_loops, fps);
+  } else if ((argc == 4 || argc == 5) && STREQ(argv[2], "roll")) {
+    char value[MAX_NIXIE_TUBES] = {0};
+    const int fps = (argc >= 5) ? atoi(argv[4]) : DEFAULT_PLAYER_FPS;
+    if (fps <= 0) {
+      return appCmdNixieUsage(cmd_io, argv[0]);
+    }
+    strncpy(value, argv[3], sizeof(value));
+    // Reverse array in memory to match layout in nixie module.
+    reverse_bytes(value, sizeof(value));
+    ok = APP_Nixie_PlayerStartRoll(&app_data->nixie, value, fps);
+  } else {
+    return appCmdNixieUsage(cmd_io, argv[0]);
+  }
+  if (!ok) {
+    COMMAND_MESSAGE("Nixie display is busy or invalid frame rate.\r\n");
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
 int APP_Command_Nixie(AppData* app_data,
                       SYS_CMD_DEVICE_NODE* cmd_io,
                       int argc, char** argv) {
@@ -188,6 +325,14 @@ int APP_Command_Nixie(AppData* app_data,
     return appCmdNixiePeriodic(app_data, cmd_io, argc, argv);
   } else if (STREQ(argv[1], "fetch")) {
     return appCmdNixieFetch(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "refresh")) {
+    return appCmdNixieRefresh(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "stats")) {
+    return appCmdNixieStats(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "value")) {
+    return appCmdNixieValue(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "play")) {
+    return appCmdNixiePlay(app_data, cmd_io, argc, argv);
   } else {
     // For unknown command show usage.
     return appCmdNixieUsage(cmd_io, argv[0]);
@@ -46,9 +46,6 @@ typedef struct AppCommandNixieData {
   } _private;
 } AppCommandNixieData;
 
-// Initialize nixie related command processor state and data.
-void APP_Command_Nixie_Initialize(struct AppData* app_data);
-
 // Handle `nixie` command line command.
 int APP_Command_Nixie(struct AppData* app_data,
                       struct SYS_CMD_DEVICE_NODE* cmd_io,
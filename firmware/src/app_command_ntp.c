@@ -27,6 +27,7 @@
 #include "app.h"
 #include "system_definitions.h"
 #include "utildefines.h"
+#include "util_time.h"
 
 #include <tcpip/sntp.h>
 
@@ -47,6 +48,28 @@
 ////////////////////////////////////////////////////////////////////////////////
 // Internal routines.
 
+static void appCmdNTPPrintTimestamp(SYS_CMD_DEVICE_NODE* cmd_io,
+                                    uint32_t timestamp) {
+  CalendarTime calendar_time;
+  calendar_time_from_seconds(timestamp, &calendar_time);
+  COMMAND_PRINT("%04d-%02d-%02d %02d:%02d:%02d",
+                calendar_time.year,
+                calendar_time.month,
+                calendar_time.day,
+                calendar_time.hours,
+                calendar_time.minutes,
+                calendar_time.seconds);
+}
+
+// Print value in parts per billion as parts per million.
+static void appCmdNTPPrintPPM(SYS_CMD_DEVICE_NODE* cmd_io, int32_t ppb) {
+  const uint32_t abs_ppb = (ppb < 0) ? -ppb : ppb;
+  COMMAND_PRINT("%s%u.%03u ppm",
+                (ppb < 0) ? "-" : "",
+                abs_ppb / 1000,
+                abs_ppb % 1000);
+}
+
 static int appCmdNTPUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
   COMMAND_PRINT("Usage: %s command arguments ...\r\n", argv0);
   COMMAND_MESSAGE(
@@ -54,6 +77,10 @@ static int appCmdNTPUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
 "\r\n"
 "    seconds <enable|disable>\r\n"
 "        Obtains the current time from the SNTP module.\r\n"
+"    status\r\n"
+"        Shows the RTC discipline state and recent corrections.\r\n"
+"    sync\r\n"
+"        Compares the RTC with the SNTP time as soon as possible.\r\n"
     );
   return true;
 }
@@ -73,6 +100,56 @@ static int appCmdNTPSeconds(AppData* app_data,
   return true;
 }
 
+static int appCmdNTPStatus(AppData* app_data,
+                           SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdNTPUsage(cmd_io, argv[0]);
+  }
+  const AppTimeSyncData* time_sync = &app_data->time_sync;
+  if (time_sync->last_sync_timestamp == 0) {
+    COMMAND_MESSAGE("Last sync: never\r\n");
+  } else {
+    COMMAND_MESSAGE("Last sync: ");
+    appCmdNTPPrintTimestamp(cmd_io, time_sync->last_sync_timestamp);
+    COMMAND_PRINT(", RTC offset %d s\r\n", time_sync->last_sync_offset);
+  }
+  COMMAND_PRINT("Sync interval: %u s\r\n", time_sync->interval);
+  COMMAND_MESSAGE("Estimated drift: ");
+  appCmdNTPPrintPPM(cmd_io, time_sync->drift_ppb);
+  COMMAND_MESSAGE("\r\n");
+  COMMAND_PRINT("Calibration: 0x%02x (", time_sync->calibration);
+  appCmdNTPPrintPPM(
+      cmd_io, RTC_MCP7940N_CalibrationToPPB(time_sync->calibration));
+  COMMAND_MESSAGE(")\r\n");
+  if (time_sync->num_corrections == 0) {
+    return true;
+  }
+  COMMAND_MESSAGE("Recent corrections:\r\n");
+  int i;
+  for (i = 0; i < time_sync->num_corrections; ++i) {
+    const AppTimeSyncCorrection* correction =
+        APP_TimeSync_CorrectionGet(time_sync, i);
+    COMMAND_MESSAGE("  ");
+    appCmdNTPPrintTimestamp(cmd_io, correction->timestamp);
+    COMMAND_PRINT(" offset %d s, drift ", correction->offset);
+    appCmdNTPPrintPPM(cmd_io, correction->drift_ppb);
+    COMMAND_PRINT(", calibration 0x%02x\r\n", correction->calibration);
+  }
+  return true;
+}
+
+static int appCmdNTPSync(AppData* app_data,
+                         SYS_CMD_DEVICE_NODE* cmd_io,
+                         int argc, char** argv) {
+  if (argc != 2) {
+    return appCmdNTPUsage(cmd_io, argv[0]);
+  }
+  APP_TimeSync_Request(&app_data->time_sync);
+  COMMAND_MESSAGE("RTC synchronization requested.\r\n");
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public API.
 
@@ -85,6 +162,10 @@ int APP_Command_NTP(struct AppData* app_data,
   }
   if (STREQ(argv[1], "seconds")) {
     return appCmdNTPSeconds(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "status")) {
+    return appCmdNTPStatus(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "sync")) {
+    return appCmdNTPSync(app_data, cmd_io, argc, argv);
   } else {
     // For unknown command show usage.
     return appCmdNTPUsage(cmd_io, argv[0]);
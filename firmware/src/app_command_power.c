@@ -40,6 +40,9 @@ static int appCmdPowerUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
 "\r\n"
 "    hv <enable|disable>\r\n"
 "        Enable or disable high voltage power supply.\r\n"
+"    idle [enable|disable|reset]\r\n"
+"        Show time CPU spent in idle mode, allow or disallow CPU to enter\r\n"
+"        idle mode when there is nothing to do, or reset the statistics.\r\n"
     );
   return true;
 }
@@ -67,6 +70,51 @@ static int appCmdPowerHV(AppData* app_data,
   return true;
 }
 
+// ============ IDLE ============
+
+static void appCmdPowerIdlePrintStatistics(AppData* app_data,
+                                           SYS_CMD_DEVICE_NODE* cmd_io) {
+  uint64_t running_time_us, idle_time_us;
+  uint32_t num_idle_entries;
+  APP_Power_IdleStatisticsGet(&app_data->power,
+                              &running_time_us,
+                              &idle_time_us,
+                              &num_idle_entries);
+  const uint64_t total_time_us = running_time_us + idle_time_us;
+  const uint32_t idle_percent =
+      (total_time_us != 0) ? (uint32_t)(idle_time_us * 100 / total_time_us)
+                           : 0;
+  COMMAND_PRINT("Idle mode: %s\r\n",
+                APP_Power_IdleEnabled(&app_data->power) ? "enabled"
+                                                        : "disabled");
+  COMMAND_PRINT("Running time: %u ms\r\n", (uint32_t)(running_time_us / 1000));
+  COMMAND_PRINT("Idle time: %u ms (%u%%)\r\n",
+                (uint32_t)(idle_time_us / 1000), idle_percent);
+  COMMAND_PRINT("Idle entries: %u\r\n", num_idle_entries);
+}
+
+static int appCmdPowerIdle(AppData* app_data,
+                           SYS_CMD_DEVICE_NODE* cmd_io,
+                           int argc, char** argv) {
+  if (argc == 2) {
+    appCmdPowerIdlePrintStatistics(app_data, cmd_io);
+  } else if (argc != 3) {
+    return appCmdPowerUsage(cmd_io, argv[0]);
+  } else if (STREQ(argv[2], "enable")) {
+    APP_Power_IdleSetEnabled(&app_data->power, true);
+    COMMAND_MESSAGE("Idle mode has been enabled.\r\n");
+  } else if (STREQ(argv[2], "disable")) {
+    APP_Power_IdleSetEnabled(&app_data->power, false);
+    COMMAND_MESSAGE("Idle mode has been disabled.\r\n");
+  } else if (STREQ(argv[2], "reset")) {
+    APP_Power_IdleStatisticsReset(&app_data->power);
+    COMMAND_MESSAGE("Idle statistics has been reset.\r\n");
+  } else {
+    return appCmdPowerUsage(cmd_io, argv[0]);
+  }
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public API.
 
@@ -81,6 +129,8 @@ int APP_Command_Power(AppData* app_data,
   }
   if (STREQ(argv[1], "hv")) {
     return appCmdPowerHV(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "idle")) {
+    return appCmdPowerIdle(app_data, cmd_io, argc, argv);
   } else {
     // For unknown command show usage.
     return appCmdPowerUsage(cmd_io, argv[0]);
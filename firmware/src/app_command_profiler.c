@@ -0,0 +1,184 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_command_profiler.h"
+
+#include "app.h"
+#include "app_profiler.h"
+#include "app_scheduler.h"
+#include "app_supervisor.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#define LOG_PREFIX "APP CMD PROFILER: "
+#define DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static int appCmdProfilerUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
+  COMMAND_PRINT("Usage: %s command arguments ...\r\n", argv0);
+  COMMAND_MESSAGE(
+"where 'command' is one of the following:\r\n"
+"\r\n"
+"    stats\r\n"
+"        Print how many times every task of the main loop was dispatched\r\n"
+"        and skipped. If the firmware is compiled with profiler, time spent\r\n"
+"        in every task is printed as well.\r\n"
+"    stats reset\r\n"
+"        Reset all the statistics.\r\n"
+"    stalls\r\n"
+"        Print state of the modules watched by the supervisor and the most\r\n"
+"        recent stalls of the modules.\r\n"
+    );
+  return true;
+}
+
+#ifdef APP_CONFIG_WITH_PROFILER
+static void appCmdProfilerPrintProfile(SYS_CMD_DEVICE_NODE* cmd_io,
+                                       const char* name,
+                                       const AppProfilerStatistics* profile) {
+  const uint32_t num_calls = profile->num_calls;
+  COMMAND_PRINT("  %s: %u calls, %u cycles average, %u cycles max\r\n",
+                name,
+                num_calls,
+                (num_calls != 0) ? (uint32_t)(profile->total_cycles / num_calls)
+                                 : 0,
+                profile->max_cycles);
+  // Histogram, only non-empty buckets.
+  COMMAND_MESSAGE("   ");
+  int bucket;
+  for (bucket = 0; bucket < PROFILER_NUM_HISTOGRAM_BUCKETS; ++bucket) {
+    if (profile->histogram[bucket] != 0) {
+      COMMAND_PRINT(" <2^%d:%u", bucket, profile->histogram[bucket]);
+    }
+  }
+  COMMAND_MESSAGE("\r\n");
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Commands implementation.
+
+// ============ STATS ============
+
+static int appCmdProfilerStats(AppData* app_data,
+                               SYS_CMD_DEVICE_NODE* cmd_io,
+                               int argc, char** argv) {
+  AppSchedulerData* scheduler = &app_data->scheduler;
+  if (argc == 3 && STREQ(argv[2], "reset")) {
+    APP_Scheduler_StatisticsReset(scheduler);
+#ifdef APP_CONFIG_WITH_PROFILER
+    APP_Profiler_Reset(&app_data->profiler);
+#endif
+    COMMAND_MESSAGE("Task statistics has been reset.\r\n");
+    return true;
+  } else if (argc != 2) {
+    return appCmdProfilerUsage(cmd_io, argv[0]);
+  }
+  COMMAND_PRINT("Main loop passes: %u (%u idle)\r\n",
+                scheduler->num_passes,
+                scheduler->num_idle_passes);
+  size_t i;
+  for (i = 0; i < scheduler->num_tasks; ++i) {
+    const AppSchedulerTask* task = &scheduler->tasks[i];
+    COMMAND_PRINT("%s: %u dispatches, %u skips\r\n",
+                  task->name,
+                  task->num_dispatches,
+                  task->num_skips);
+#ifdef APP_CONFIG_WITH_PROFILER
+    appCmdProfilerPrintProfile(cmd_io, "time", &task->profile);
+#endif
+  }
+#ifdef APP_CONFIG_WITH_PROFILER
+  COMMAND_MESSAGE("Main loop:\r\n");
+  appCmdProfilerPrintProfile(cmd_io, "SYS_Tasks", &app_data->profiler.sys_tasks);
+  appCmdProfilerPrintProfile(cmd_io, "iteration", &app_data->profiler.iteration);
+#else
+  COMMAND_MESSAGE("Profiler is not compiled in, "
+                  "define APP_CONFIG_WITH_PROFILER to enable it.\r\n");
+#endif
+  return true;
+}
+
+// ============ STALLS ============
+
+static int appCmdProfilerStalls(AppData* app_data,
+                                SYS_CMD_DEVICE_NODE* cmd_io,
+                                int argc, char** argv) {
+  AppSupervisorData* supervisor = &app_data->supervisor;
+  if (argc != 2) {
+    return appCmdProfilerUsage(cmd_io, argv[0]);
+  }
+  if (supervisor->is_watchdog_reset) {
+    COMMAND_MESSAGE("Last system reset was caused by the watchdog.\r\n");
+  }
+  COMMAND_PRINT("Watchdog is %s.\r\n", supervisor->is_watchdog_fed
+                                             ? "fed"
+                                             : "starving");
+  const uint64_t current_time_ms =
+      SYS_TMR_SystemCountGet() * 1000 / SYS_TMR_SystemCountFrequencyGet();
+  int i;
+  for (i = 0; i < supervisor->num_modules; ++i) {
+    const AppSupervisorModule* module = &supervisor->modules[i];
+    COMMAND_PRINT("%s: state %d for %u ms, %u stalls%s\r\n",
+                  module->name,
+                  module->current_state,
+                  (uint32_t)(current_time_ms - module->state_entered_ms),
+                  module->num_stalls,
+                  module->is_stalled ? " (STALLED)" : "");
+  }
+  COMMAND_PRINT("Total stalls: %u\r\n", supervisor->num_stalls);
+  const AppSupervisorStall* stall;
+  for (i = 0; (stall = APP_Supervisor_StallGet(supervisor, i)) != NULL; ++i) {
+    COMMAND_PRINT("  at %u s: %s in state %d for %u ms, %s\r\n",
+                  (uint32_t)(stall->detected_ms / 1000),
+                  stall->name,
+                  stall->state,
+                  stall->duration_ms,
+                  stall->is_recovered ? "recovered" : "not recovered");
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+int APP_Command_Profiler(AppData* app_data,
+                         SYS_CMD_DEVICE_NODE* cmd_io,
+                         int argc, char** argv) {
+  if (!APP_Command_CheckAvailable(app_data, cmd_io)) {
+    return true;
+  }
+  if (argc == 1) {
+    return appCmdProfilerUsage(cmd_io, argv[0]);
+  }
+  if (STREQ(argv[1], "stats")) {
+    return appCmdProfilerStats(app_data, cmd_io, argc, argv);
+  } else if (STREQ(argv[1], "stalls")) {
+    return appCmdProfilerStalls(app_data, cmd_io, argc, argv);
+  } else {
+    // For unknown command show usage.
+    return appCmdProfilerUsage(cmd_io, argv[0]);
+  }
+  return true;
+}
@@ -54,7 +54,8 @@ static int appCmdRTCUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
 "        This command will report current date and time.\r\n"
 "\r\n"
 "    date <date-time>\r\n"
-"        This command will set specified date and time to the RTC.\r\n"
+"        This command will set specified date and time to the RTC, start\r\n"
+"        its oscillator and enable backup battery.\r\n"
 "\r\n"
 "    battery <enable|disable>\r\n"
 "        Enable or disable backup battery.\r\n"
@@ -78,7 +79,7 @@ static int appCmdRTCUsage(SYS_CMD_DEVICE_NODE* cmd_io, const char* argv0) {
 // Commands implementation.
 
 static bool performRTCCheckAvailable(AppData* app_data) {
-  return !RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle);
+  return !RTC_MCP7940N_IsQueueFull(&app_data->rtc.rtc_handle);
 }
 
 // ============ OSCILLATOR START/STOP/STATUS ============
@@ -86,18 +87,15 @@ static bool performRTCCheckAvailable(AppData* app_data) {
 static AppCommandTaskCallbackResult performRTCOscillatorStart(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
-      RTC_MCP7940N_EnableOscillator(&app_data->rtc.rtc_handle, true);
-      break;
+      RTC_MCP7940N_EnableOscillator(
+          &app_data->rtc.rtc_handle, true, NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -105,18 +103,15 @@ static AppCommandTaskCallbackResult performRTCOscillatorStart(
 static AppCommandTaskCallbackResult performRTCOscillatorStop(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
-      RTC_MCP7940N_EnableOscillator(&app_data->rtc.rtc_handle, false);
-      break;
+      RTC_MCP7940N_EnableOscillator(
+          &app_data->rtc.rtc_handle, false, NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -124,24 +119,20 @@ static AppCommandTaskCallbackResult performRTCOscillatorStop(
 static AppCommandTaskCallbackResult performRTCOscillatorStatus(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
       RTC_MCP7940N_OscillatorStatus(
           &app_data->rtc.rtc_handle,
-          &app_data->command.rtc._private.oscillator.status);
-      break;
+          &storage->rtc._private.oscillator.status,
+          NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        COMMAND_PRINT(
-            "Oscillator status: %s\r\n",
-            app_data->command.rtc._private.oscillator.status ? "ENABLED"
-                                                             : "DISABLED");
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      COMMAND_PRINT(
+          "Oscillator status: %s\r\n",
+          storage->rtc._private.oscillator.status ? "ENABLED" : "DISABLED");
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -155,16 +146,19 @@ static int appCmdRTCOscillator(AppData* app_data,
   if (STREQ(argv[2], "start")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                                cmd_io,
+                               APP_COMMAND_TASK_RESOURCE_RTC,
                                performRTCOscillatorStart,
                                performRTCCheckAvailable);
   } else if (STREQ(argv[2], "stop")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_RTC,
                               performRTCOscillatorStop,
                               performRTCCheckAvailable);
   } else if (STREQ(argv[2], "status")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_RTC,
                               performRTCOscillatorStatus,
                               performRTCCheckAvailable);
   } else {
@@ -178,30 +172,32 @@ static int appCmdRTCOscillator(AppData* app_data,
 static AppCommandTaskCallbackResult performRTCDateShow(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
       RTC_MCP7940N_ReadDateAndTime(
           &app_data->rtc.rtc_handle,
-          &app_data->command.rtc._private.date.date_time);
-      break;
+          &storage->rtc._private.date.date_time,
+          NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        RTC_MCP7940N_DateTime* date_time = &app_data->command.rtc._private.date.date_time;
-        // TODO(sergey): Need to get rid of manual year offset here.
-        COMMAND_PRINT("%s %2d %s %d %2d:%02d:%02d\r\n",
-                      days_of_week[date_time->day_of_week],
-                      date_time->day,
-                      months[date_time->month],
-                      date_time->year + 2000,
-                      date_time->hours,
-                      date_time->minutes,
-                      date_time->seconds);
+      RTC_MCP7940N_DateTime* date_time = &storage->rtc._private.date.date_time;
+      if (date_time->day_of_week < 1 || date_time->day_of_week > 7 ||
+          date_time->month < 1 || date_time->month > 12) {
+        COMMAND_MESSAGE("RTC returned invalid date.\r\n");
         return APP_COMMAND_TASK_RESULT_FINISHED;
       }
-      break;
+      // TODO(sergey): Need to get rid of manual year offset here.
+      COMMAND_PRINT("%s %2d %s %d %2d:%02d:%02d\r\n",
+                    days_of_week[date_time->day_of_week - 1],
+                    date_time->day,
+                    months[date_time->month - 1],
+                    date_time->year + 2000,
+                    date_time->hours,
+                    date_time->minutes,
+                    date_time->seconds);
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -209,20 +205,25 @@ static AppCommandTaskCallbackResult performRTCDateShow(
 static AppCommandTaskCallbackResult performRTCDateSet(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
-    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
-      RTC_MCP7940N_WriteDateAndTime(
-          &app_data->rtc.rtc_handle,
-          &app_data->command.rtc._private.date.date_time);
-      break;
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE: {
+      // Time is only useful when it's running and survives power loss, so
+      // make sure of it in the same bus transactions.
+      RTC_MCP7940N_Batch batch;
+      RTC_MCP7940N_BatchInitialize(&batch);
+      RTC_MCP7940N_BatchSetDateAndTime(&batch,
+                                       &storage->rtc._private.date.date_time);
+      RTC_MCP7940N_BatchEnableOscillator(&batch, true);
+      RTC_MCP7940N_BatchEnableBatteryBackup(&batch, true);
+      RTC_MCP7940N_WriteBatch(
+          &app_data->rtc.rtc_handle, &batch, NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+    }
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      APP_RTC_TimeCacheInvalidate(&app_data->rtc);
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -281,9 +282,10 @@ static bool dateDecode(char** argv, RTC_MCP7940N_DateTime* date_time) {
   date_time->seconds = second;
   date_time->minutes = minute;
   date_time->hours = hour;
-  date_time->day_of_week = day_of_week;
+  // RTC counts both day of week and month starting from 1.
+  date_time->day_of_week = day_of_week + 1;
   date_time->day = day;
-  date_time->month = month;
+  date_time->month = month + 1;
   // TODO(sergey): Avoid hardware-related shifts.
   date_time->year = year - 2000;
   return true;
@@ -295,14 +297,19 @@ static int appCmdRTCDate(AppData* app_data,
   if (argc == 2) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_RTC,
                               performRTCDateShow,
                               performRTCCheckAvailable);
   } else if (argc == 7) {
-    if (dateDecode(argv, &app_data->command.rtc._private.date.date_time)) {
-    APP_Command_Task_Schedule(&app_data->command.task,
-                              cmd_io,
-                              performRTCDateSet,
-                              performRTCCheckAvailable);
+    RTC_MCP7940N_DateTime date_time;
+    if (dateDecode(argv, &date_time)) {
+      AppCommandTaskStorage* storage =
+          APP_Command_Task_Schedule(&app_data->command.task,
+                                    cmd_io,
+                                    APP_COMMAND_TASK_RESOURCE_RTC,
+                                    performRTCDateSet,
+                                    performRTCCheckAvailable);
+      storage->rtc._private.date.date_time = date_time;
     } else {
       COMMAND_MESSAGE("Failed to parse date.\r\n");
       COMMAND_MESSAGE("Expected format: ddd DD MMM YYYY HH:MM:SS.\r\n");
@@ -318,18 +325,15 @@ static int appCmdRTCDate(AppData* app_data,
 static AppCommandTaskCallbackResult performRTCBatteryEnable(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
-      RTC_MCP7940N_EnableBatteryBackup(&app_data->rtc.rtc_handle, true);
-      break;
+      RTC_MCP7940N_EnableBatteryBackup(
+          &app_data->rtc.rtc_handle, true, NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        return  APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -337,18 +341,15 @@ static AppCommandTaskCallbackResult performRTCBatteryEnable(
 static AppCommandTaskCallbackResult performRTCBatteryDisable(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
-      RTC_MCP7940N_EnableBatteryBackup(&app_data->rtc.rtc_handle, false);
-      break;
+      RTC_MCP7940N_EnableBatteryBackup(
+          &app_data->rtc.rtc_handle, false, NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -356,24 +357,20 @@ static AppCommandTaskCallbackResult performRTCBatteryDisable(
 static AppCommandTaskCallbackResult performRTCBatteryStatus(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
       RTC_MCP7940N_BatteryBackupStatus(
           &app_data->rtc.rtc_handle,
-          &app_data->command.rtc._private.battery.status);
-      break;
+          &storage->rtc._private.battery.status,
+          NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        COMMAND_PRINT(
-            "Battery status: %s\r\n",
-            app_data->command.rtc._private.battery.status ? "ENABLED"
-                                                          : "DISABLED");
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      COMMAND_PRINT(
+          "Battery status: %s\r\n",
+          storage->rtc._private.battery.status ? "ENABLED" : "DISABLED");
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -387,16 +384,19 @@ static int appCmdRTCBattery(AppData* app_data,
   if (STREQ(argv[2], "enable")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_RTC,
                               performRTCBatteryEnable,
                               performRTCCheckAvailable);
   } else if (STREQ(argv[2], "disable")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_RTC,
                               performRTCBatteryDisable,
                               performRTCCheckAvailable);
   } else if (STREQ(argv[2], "status")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_RTC,
                               performRTCBatteryStatus,
                               performRTCCheckAvailable);
   } else {
@@ -425,24 +425,21 @@ static void printRegisters(SYS_CMD_DEVICE_NODE* cmd_io,
 static AppCommandTaskCallbackResult performRTCDump(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
       RTC_MCP7940N_ReadNumRegisters(
           &app_data->rtc.rtc_handle,
-          app_data->command.rtc._private.dump.registers_storage,
-          RTC_MCP7940N_NUM_REGISTERS);
-      break;
+          storage->rtc._private.dump.registers_storage,
+          RTC_MCP7940N_NUM_REGISTERS,
+          NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        printRegisters(cmd_io,
-                        app_data->command.rtc._private.dump.registers_storage,
-                        RTC_MCP7940N_NUM_REGISTERS);
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      printRegisters(cmd_io,
+                      storage->rtc._private.dump.registers_storage,
+                      RTC_MCP7940N_NUM_REGISTERS);
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -455,6 +452,7 @@ static int appCmdRTCDump(AppData* app_data,
   }
   APP_Command_Task_Schedule(&app_data->command.task,
                             cmd_io,
+                            APP_COMMAND_TASK_RESOURCE_RTC,
                             performRTCDump,
                             performRTCCheckAvailable);
   return true;
@@ -465,23 +463,20 @@ static int appCmdRTCDump(AppData* app_data,
 static AppCommandTaskCallbackResult performRTCRegisterRead(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
       RTC_MCP7940N_ReadRegister(
           &app_data->rtc.rtc_handle,
-          app_data->command.rtc._private.reg.register_address,
-          &app_data->command.rtc._private.reg.register_value);
-      break;
+          storage->rtc._private.reg.register_address,
+          &storage->rtc._private.reg.register_value,
+          NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        COMMAND_PRINT("Register value: 0x%02x.\r\n",
-                      app_data->command.rtc._private.reg.register_value);
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      COMMAND_PRINT("Register value: 0x%02x.\r\n",
+                    storage->rtc._private.reg.register_value);
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -489,21 +484,18 @@ static AppCommandTaskCallbackResult performRTCRegisterRead(
 static AppCommandTaskCallbackResult performRTCRegisterWrite(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
       RTC_MCP7940N_WriteRegister(
           &app_data->rtc.rtc_handle,
-          app_data->command.rtc._private.reg.register_address,
-          app_data->command.rtc._private.reg.register_value);
-      break;
+          storage->rtc._private.reg.register_address,
+          storage->rtc._private.reg.register_value,
+          NULL, NULL);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
-      // TODO(sergey): What if other routine will start using RTC
-      // before this check?
-      if (!RTC_MCP7940N_IsBusy(&app_data->rtc.rtc_handle)) {
-        return APP_COMMAND_TASK_RESULT_FINISHED;
-      }
-      break;
+      return APP_COMMAND_TASK_RESULT_FINISHED;
   }
   return APP_COMMAND_TASK_RESULT_RUNNING;
 }
@@ -515,29 +507,28 @@ static int appCmdRTCRegister(AppData* app_data,
     return appCmdRTCUsage(cmd_io, argv[0]);
   }
   if (argc == 4 && STREQ(argv[2], "read")) {
-    app_data->command.rtc._private.reg.register_address = atoi(argv[3]);
-    APP_Command_Task_Schedule(&app_data->command.task,
-                              cmd_io,
-                              performRTCRegisterRead,
-                              performRTCCheckAvailable);
+    AppCommandTaskStorage* storage =
+        APP_Command_Task_Schedule(&app_data->command.task,
+                                  cmd_io,
+                                  APP_COMMAND_TASK_RESOURCE_RTC,
+                                  performRTCRegisterRead,
+                                  performRTCCheckAvailable);
+    storage->rtc._private.reg.register_address = atoi(argv[3]);
   } else if (argc == 5 && STREQ(argv[2], "write")) {
-    app_data->command.rtc._private.reg.register_address = atoi(argv[3]);
-    app_data->command.rtc._private.reg.register_value = atoi(argv[4]);
-    APP_Command_Task_Schedule(&app_data->command.task,
-                              cmd_io,
-                              performRTCRegisterWrite,
-                              performRTCCheckAvailable);
+    AppCommandTaskStorage* storage =
+        APP_Command_Task_Schedule(&app_data->command.task,
+                                  cmd_io,
+                                  APP_COMMAND_TASK_RESOURCE_RTC,
+                                  performRTCRegisterWrite,
+                                  performRTCCheckAvailable);
+    storage->rtc._private.reg.register_address = atoi(argv[3]);
+    storage->rtc._private.reg.register_value = atoi(argv[4]);
   } else {
     return appCmdRTCUsage(cmd_io, argv[0]);
   }
   return true;
 }
 
-void APP_Command_RTC_Initialize(AppData* app_data) {
-  // TODO(sergey): Ignore for release builds to save CPU ticks?
-  memset(&app_data->command.rtc, 0, sizeof(app_data->command.rtc));
-}
-
 int APP_Command_RTC(AppData* app_data,
                     SYS_CMD_DEVICE_NODE* cmd_io,
                     int argc, char** argv) {
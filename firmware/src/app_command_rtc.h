@@ -66,9 +66,6 @@ typedef struct AppCommandRTCData {
   } _private;
 } AppCommandRTCData;
 
-// Initialize RTC related command processor state and data.
-void APP_Command_RTC_Initialize(struct AppData* app_data);
-
 // Handle `rtc` command line command.
 int APP_Command_RTC(struct AppData* app_data,
                     struct SYS_CMD_DEVICE_NODE* cmd_io,
@@ -66,6 +66,7 @@ static bool performShiftRegisterCheckAvailable(AppData* app_data) {
 static AppCommandTaskCallbackResult performShiftRegisterSetEnabled(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
@@ -80,6 +81,7 @@ static AppCommandTaskCallbackResult performShiftRegisterSetEnabled(
 static AppCommandTaskCallbackResult performShiftRegisterSetDisabled(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
@@ -99,11 +101,13 @@ static int commandShiftRegisterSetEnabledOrDisabled(AppData* app_data,
   } else if (STREQ(argv[1], "enable")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_SHIFT_REGISTER,
                               performShiftRegisterSetEnabled,
                               performShiftRegisterCheckAvailable);
   } else if (STREQ(argv[1], "disable")) {
     APP_Command_Task_Schedule(&app_data->command.task,
                               cmd_io,
+                              APP_COMMAND_TASK_RESOURCE_SHIFT_REGISTER,
                               performShiftRegisterSetDisabled,
                               performShiftRegisterCheckAvailable);
   } else {
@@ -117,14 +121,17 @@ static int commandShiftRegisterSetEnabledOrDisabled(AppData* app_data,
 static AppCommandTaskCallbackResult performShiftRegisterSendData(
     AppData* app_data,
     SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode) {
   switch (mode) {
     case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      // Display does not know what is latched in the registers anymore.
+      APP_Nixie_LatchedStateInvalidate(&app_data->nixie);
       APP_ShiftRegister_SendData(
           &app_data->shift_register,
-          app_data->command.shift_register._private.send.data,
-          app_data->command.shift_register._private.send.num_bytes);
-      break;
+          storage->shift_register._private.send.data,
+          storage->shift_register._private.send.num_bytes);
+      return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
     case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE:
       return APP_COMMAND_TASK_RESULT_FINISHED;
   }
@@ -138,28 +145,22 @@ static int commandShiftRegisterSendData(AppData* app_data,
   if (argc < 3) {
     return appCmdShiftRegisterUsage(cmd_io, argv[0]);
   }
+  AppCommandTaskStorage* storage =
+      APP_Command_Task_Schedule(&app_data->command.task,
+                                cmd_io,
+                                APP_COMMAND_TASK_RESOURCE_SHIFT_REGISTER,
+                                performShiftRegisterSendData,
+                                performShiftRegisterCheckAvailable);
   const size_t num_bytes =
-    min_zz(argc - 2,
-           sizeof(app_data->command.shift_register._private.send.data));
+    min_zz(argc - 2, sizeof(storage->shift_register._private.send.data));
   size_t i;
   for (i = 0; i < num_bytes; ++i) {
-    app_data->command.shift_register._private.send.data[i] = atoi(argv[i + 2]);
+    storage->shift_register._private.send.data[i] = atoi(argv[i + 2]);
   }
-  app_data->command.shift_register._private.send.num_bytes = num_bytes;
-  APP_Command_Task_Schedule(&app_data->command.task,
-                            cmd_io,
-                            performShiftRegisterSendData,
-                            performShiftRegisterCheckAvailable);
+  storage->shift_register._private.send.num_bytes = num_bytes;
   return true;
 }
 
-void APP_Command_ShiftRegister_Initialize(AppData* app_data) {
-  // TODO(sergey): Ignore for release builds to save CPU ticks?
-  memset(&app_data->command.shift_register,
-         0,
-         sizeof(app_data->command.shift_register));
-}
-
 int APP_Command_ShiftRegister(AppData* app_data,
                               SYS_CMD_DEVICE_NODE* cmd_io,
                               int argc, char** argv) {
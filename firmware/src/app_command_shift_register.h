@@ -40,9 +40,6 @@ typedef struct AppCommandShiftRegisterData {
   } _private;
 } AppCommandShiftRegisterData;
 
-// Initialize shift register related command processor state and data.
-void APP_Command_ShiftRegister_Initialize(struct AppData* app_data);
-
 // Handle `shift_register` command line command.
 int APP_Command_ShiftRegister(struct AppData* app_data,
                               struct SYS_CMD_DEVICE_NODE* cmd_io,
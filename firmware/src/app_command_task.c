@@ -23,6 +23,7 @@
 #include "app_command_task.h"
 
 #include <stddef.h>
+#include <string.h>
 
 #include "system_definitions.h"
 #include "utildefines.h"
@@ -34,83 +35,258 @@
 // Internal routines.
 
 static void appCmdTaskSetCallback(
-    AppCommandTaskData* app_command_task_data,
+    AppCommandTask* task,
     SYS_CMD_DEVICE_NODE* cmd_io,
     AppCommandTaskCallback callback,
     AppCommandTaskCheckAvailableCallback callback_check_available) {
-  app_command_task_data->callback_cmd_io = cmd_io;
-  app_command_task_data->callback = callback;
-  app_command_task_data->callback_check_available = callback_check_available;
+  task->callback_cmd_io = cmd_io;
+  task->callback = callback;
+  task->callback_check_available = callback_check_available;
 }
 
-static void checkCallbackResult(AppCommandTaskData *app_command_task_data,
+static void checkCallbackResult(AppCommandTask* task,
                                 AppCommandTaskCallbackResult result) {
   switch (result) {
     case APP_COMMAND_TASK_RESULT_RUNNING:
-      app_command_task_data->state = APP_COMMAND_TASK_STATE_RUNNING;
+      task->state = APP_COMMAND_TASK_STATE_RUNNING;
       break;
     case APP_COMMAND_TASK_RESULT_FINISHED:
-      app_command_task_data->state = APP_COMMAND_TASK_STATE_NONE;
-      appCmdTaskSetCallback(app_command_task_data, NULL, NULL, NULL);
+      task->state = APP_COMMAND_TASK_STATE_NONE;
+      appCmdTaskSetCallback(task, NULL, NULL, NULL);
       break;
+    case APP_COMMAND_TASK_RESULT_WAIT_EVENT:
+      task->state = APP_COMMAND_TASK_STATE_WAIT_EVENT;
+      break;
+  }
+}
+
+// Mask of events which are posted when the resource finished its operation.
+static uint32_t resourceEventMask(AppCommandTaskResource resource) {
+  switch (resource) {
+    case APP_COMMAND_TASK_RESOURCE_DOWNLOAD:
+      return APP_EVENT_MASK(APP_EVENT_DOWNLOAD_DONE);
+    case APP_COMMAND_TASK_RESOURCE_FIRMWARE_UPDATE:
+      // NOTE: Firmware update needs the download module as well, which might
+      // be busy with the download started by other command.
+      return APP_EVENT_MASK(APP_EVENT_FIRMWARE_UPDATE_DONE) |
+             APP_EVENT_MASK(APP_EVENT_DOWNLOAD_DONE);
+    case APP_COMMAND_TASK_RESOURCE_FLASH:
+      return APP_EVENT_MASK(APP_EVENT_FLASH_DONE);
+    case APP_COMMAND_TASK_RESOURCE_HISTORY:
+      return APP_EVENT_MASK(APP_EVENT_HISTORY_DONE);
+    case APP_COMMAND_TASK_RESOURCE_HTTPS_CLIENT:
+      return APP_EVENT_MASK(APP_EVENT_HTTPS_CLIENT_DONE);
+    case APP_COMMAND_TASK_RESOURCE_NIXIE:
+      return APP_EVENT_MASK(APP_EVENT_NIXIE_DONE);
+    case APP_COMMAND_TASK_RESOURCE_RTC:
+      return APP_EVENT_MASK(APP_EVENT_RTC_DONE);
+    case APP_COMMAND_TASK_RESOURCE_SHIFT_REGISTER:
+      return APP_EVENT_MASK(APP_EVENT_SHIFT_REGISTER_DONE);
+    case APP_COMMAND_TASK_NUM_RESOURCES:
+      break;
+  }
+  SYS_ASSERT(false, "\r\nUnknown command task resource\r\n");
+  return 0;
+}
+
+static void resourceEventCallback(const AppEvent* event, void* user_data) {
+  AppCommandTaskData* app_command_task_data = (AppCommandTaskData*)user_data;
+  int i;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    AppCommandTask* task = &app_command_task_data->tasks[i];
+    if ((resourceEventMask(task->resource) &
+         APP_EVENT_MASK(event->type)) == 0 ||
+        !APP_Event_IsPostedSince(event, task->event_sequence)) {
+      continue;
+    }
+    switch (task->state) {
+      case APP_COMMAND_TASK_STATE_WAIT_RESOURCE:
+        task->state = APP_COMMAND_TASK_STATE_WAIT_AVAILABLE;
+        break;
+      case APP_COMMAND_TASK_STATE_WAIT_EVENT:
+        task->state = APP_COMMAND_TASK_STATE_RUNNING;
+        break;
+      default:
+        break;
+    }
   }
 }
 
+// Check whether there is a task which uses the same resource and which was
+// scheduled prior to the given one.
+static bool hasEarlierTask(AppCommandTaskData* app_command_task_data,
+                           const AppCommandTask* task) {
+  int i;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    const AppCommandTask* other_task = &app_command_task_data->tasks[i];
+    if (other_task == task ||
+        other_task->state == APP_COMMAND_TASK_STATE_NONE ||
+        other_task->resource != task->resource) {
+      continue;
+    }
+    // NOTE: Compare difference, so wrap around of the sequence is handled.
+    if ((int32_t)(other_task->sequence - task->sequence) < 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void taskWaitAvailable(AppCommandTaskData* app_command_task_data,
+                              AppCommandTask* task,
+                              struct AppData* app_data) {
+  if (hasEarlierTask(app_command_task_data, task)) {
+    // Keep order of commands which are using the same resource.
+    return;
+  }
+  // NOTE: Sequence is stored prior to the check and the callback, so the
+  // completion event of the operation is never missed.
+  task->event_sequence = APP_Event_NextSequence(
+      app_command_task_data->app_event_bus);
+  if (task->callback_check_available(app_data)) {
+    DEBUG_MESSAGE("Resource is free, invoking command.\r\n");
+    task->state = APP_COMMAND_TASK_STATE_RUNNING;
+    AppCommandTaskCallbackResult result =
+        task->callback(app_data,
+                       task->callback_cmd_io,
+                       &task->storage,
+                       APP_COMMAND_TASK_MODE_CALLBACK_INVOKE);
+    checkCallbackResult(task, result);
+  } else {
+    DEBUG_MESSAGE("Resource is busy, waiting.\r\n");
+    task->state = APP_COMMAND_TASK_STATE_WAIT_RESOURCE;
+  }
+}
+
+static void taskUpdate(AppCommandTaskData* app_command_task_data,
+                       AppCommandTask* task,
+                       struct AppData* app_data) {
+  task->event_sequence = APP_Event_NextSequence(
+      app_command_task_data->app_event_bus);
+  AppCommandTaskCallbackResult result =
+      task->callback(app_data,
+                     task->callback_cmd_io,
+                     &task->storage,
+                     APP_COMMAND_TASK_MODE_CALLBACK_UPDATE);
+  checkCallbackResult(task, result);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public API.
 
-void APP_Command_Task_Initialize(AppCommandTaskData *app_command_task_data) {
-  app_command_task_data->state = APP_COMMAND_TASK_STATE_NONE;
-  appCmdTaskSetCallback(app_command_task_data, NULL, NULL, NULL);
+void APP_Command_Task_Initialize(AppCommandTaskData *app_command_task_data,
+                                 AppEventBus* app_event_bus) {
+  int i;
+  app_command_task_data->app_event_bus = app_event_bus;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    AppCommandTask* task = &app_command_task_data->tasks[i];
+    task->state = APP_COMMAND_TASK_STATE_NONE;
+    task->resource = APP_COMMAND_TASK_RESOURCE_FLASH;
+    task->sequence = 0;
+    task->event_sequence = 0;
+    appCmdTaskSetCallback(task, NULL, NULL, NULL);
+  }
+  app_command_task_data->next_sequence = 0;
+  if (!APP_Event_Subscribe(app_event_bus,
+                        APP_EVENT_MASK(APP_EVENT_DOWNLOAD_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_FIRMWARE_UPDATE_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_FLASH_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_HISTORY_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_HTTPS_CLIENT_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_NIXIE_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_RTC_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_SHIFT_REGISTER_DONE),
+                        resourceEventCallback,
+                        app_command_task_data)) {
+    SYS_ASSERT(false, "\r\nNot enough event bus subscriber slots\r\n");
+  }
 }
 
 bool APP_Command_Task_IsBusy(AppCommandTaskData *app_command_task_data) {
-  return app_command_task_data->state != APP_COMMAND_TASK_STATE_NONE;
+  int i;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    if (app_command_task_data->tasks[i].state != APP_COMMAND_TASK_STATE_NONE) {
+      return true;
+    }
+  }
+  return false;
 }
 
-void APP_Command_Task_Schedule(
+bool APP_Command_Task_IsRunnable(AppCommandTaskData *app_command_task_data) {
+  int i;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    const AppCommandTask* task = &app_command_task_data->tasks[i];
+    switch (task->state) {
+      case APP_COMMAND_TASK_STATE_WAIT_AVAILABLE:
+        if (!hasEarlierTask(app_command_task_data, task)) {
+          return true;
+        }
+        break;
+      case APP_COMMAND_TASK_STATE_RUNNING:
+        return true;
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
+bool APP_Command_Task_IsFull(AppCommandTaskData *app_command_task_data) {
+  int i;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    if (app_command_task_data->tasks[i].state == APP_COMMAND_TASK_STATE_NONE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+AppCommandTaskStorage* APP_Command_Task_Schedule(
     AppCommandTaskData *app_command_task_data,
     struct SYS_CMD_DEVICE_NODE* callback_cmd_io,
+    AppCommandTaskResource resource,
     AppCommandTaskCallback callback,
     AppCommandTaskCheckAvailableCallback callback_check_available) {
-  SYS_ASSERT(
-      app_command_task_data->state == APP_COMMAND_TASK_STATE_NONE,
-      "\r\nAttempt to start task while another one is in process\r\n");
-  app_command_task_data->state = APP_COMMAND_TASK_STATE_WAIT_AVAILABLE;
-  appCmdTaskSetCallback(app_command_task_data,
+  AppCommandTask* task = NULL;
+  int i;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    if (app_command_task_data->tasks[i].state == APP_COMMAND_TASK_STATE_NONE) {
+      task = &app_command_task_data->tasks[i];
+      break;
+    }
+  }
+  SYS_ASSERT(task != NULL,
+             "\r\nAttempt to schedule task while all slots are in use\r\n");
+  task->state = APP_COMMAND_TASK_STATE_WAIT_AVAILABLE;
+  task->resource = resource;
+  task->sequence = app_command_task_data->next_sequence++;
+  appCmdTaskSetCallback(task,
                         callback_cmd_io,
                         callback,
                         callback_check_available);
+  memset(&task->storage, 0, sizeof(task->storage));
+  return &task->storage;
 }
 
 void APP_Command_Task_Tasks(AppCommandTaskData *app_command_task_data,
                             struct AppData* app_data) {
-  switch (app_command_task_data->state) {
-    case APP_COMMAND_TASK_STATE_NONE:
-      // Nothing to do.
-      break;
-    case APP_COMMAND_TASK_STATE_WAIT_AVAILABLE:
-      if (app_command_task_data->callback_check_available(app_data)) {
-        DEBUG_MESSAGE("Shift register is free, invoking command.\r\n");
-        app_command_task_data->state = APP_COMMAND_TASK_STATE_RUNNING;
-        AppCommandTaskCallbackResult result =
-            app_command_task_data->callback(
-                app_data,
-                app_command_task_data->callback_cmd_io,
-                APP_COMMAND_TASK_MODE_CALLBACK_INVOKE);
-        checkCallbackResult(app_command_task_data, result);
-      } else {
-        DEBUG_MESSAGE("Shift register is busy, waiting.\r\n");
-      }
-      break;
-    case APP_COMMAND_TASK_STATE_RUNNING: {
-      AppCommandTaskCallbackResult result =
-          app_command_task_data->callback(
-              app_data,
-              app_command_task_data->callback_cmd_io,
-              APP_COMMAND_TASK_MODE_CALLBACK_UPDATE);
-      checkCallbackResult(app_command_task_data, result);
-      break;
+  int i;
+  for (i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    AppCommandTask* task = &app_command_task_data->tasks[i];
+    switch (task->state) {
+      case APP_COMMAND_TASK_STATE_NONE:
+        // Nothing to do.
+        break;
+      case APP_COMMAND_TASK_STATE_WAIT_AVAILABLE:
+        taskWaitAvailable(app_command_task_data, task, app_data);
+        break;
+      case APP_COMMAND_TASK_STATE_WAIT_RESOURCE:
+      case APP_COMMAND_TASK_STATE_WAIT_EVENT:
+        // Woken up by the event callback.
+        break;
+      case APP_COMMAND_TASK_STATE_RUNNING:
+        taskUpdate(app_command_task_data, task, app_data);
+        break;
     }
   }
 }
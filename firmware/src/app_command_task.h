@@ -24,6 +24,19 @@
 #define _APP_COMMAND_TASK_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "app_event.h"
+
+// Per-command storage which is embedded into the task.
+#include "app_command_download.h"
+#include "app_command_fetch.h"
+#include "app_command_firmware.h"
+#include "app_command_history.h"
+#include "app_command_nixie.h"
+#include "app_command_rtc.h"
+#include "app_command_shift_register.h"
 
 struct AppData;
 struct SYS_CMD_DEVICE_NODE;
@@ -41,12 +54,48 @@ typedef enum {
   APP_COMMAND_TASK_RESULT_RUNNING,
   // Task is finished.
   APP_COMMAND_TASK_RESULT_FINISHED,
+  // Task started an operation on the resource, callback is to be updated once
+  // the resource posts its completion event.
+  APP_COMMAND_TASK_RESULT_WAIT_EVENT,
 } AppCommandTaskCallbackResult;
 
+// Resource which is used by the task.
+//
+// Tasks which are using different resources are run concurrently, tasks
+// which are using the same resource are run one after another in the order
+// they were scheduled.
+typedef enum {
+  APP_COMMAND_TASK_RESOURCE_DOWNLOAD,
+  APP_COMMAND_TASK_RESOURCE_FIRMWARE_UPDATE,
+  APP_COMMAND_TASK_RESOURCE_FLASH,
+  APP_COMMAND_TASK_RESOURCE_HISTORY,
+  APP_COMMAND_TASK_RESOURCE_HTTPS_CLIENT,
+  APP_COMMAND_TASK_RESOURCE_NIXIE,
+  APP_COMMAND_TASK_RESOURCE_RTC,
+  APP_COMMAND_TASK_RESOURCE_SHIFT_REGISTER,
+
+  APP_COMMAND_TASK_NUM_RESOURCES,
+} AppCommandTaskResource;
+
+// Storage of the command arguments and intermediate results.
+//
+// Every task has its own storage, so queued command does not overwrite
+// arguments of the one which is still running.
+typedef union AppCommandTaskStorage {
+  AppCommandDownloadData download;
+  AppCommandFetchData fetch;
+  AppCommandFirmwareData firmware;
+  AppCommandHistoryData history;
+  AppCommandNixieData nixie;
+  AppCommandRTCData rtc;
+  AppCommandShiftRegisterData shift_register;
+} AppCommandTaskStorage;
+
 // Callback implementing actual logic of the task.
 typedef AppCommandTaskCallbackResult (*AppCommandTaskCallback)(
     struct AppData* app_data,
     struct SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
     AppCommandTaskCallbackMode mode);
 
 // Callback which is run to check whether resource is available.
@@ -57,13 +106,26 @@ typedef enum {
   APP_COMMAND_TASK_STATE_NONE,
   // Wait for the resource to become available for the commands.
   APP_COMMAND_TASK_STATE_WAIT_AVAILABLE,
+  // Resource is used by someone else, wait for its completion event and
+  // check availability again.
+  APP_COMMAND_TASK_STATE_WAIT_RESOURCE,
   // There is a task running in background.
   APP_COMMAND_TASK_STATE_RUNNING,
+  // Wait for the completion event of the operation started by the callback.
+  APP_COMMAND_TASK_STATE_WAIT_EVENT,
 } AppCommandTaskState;
 
-typedef struct AppCommandTaskData {
+typedef struct AppCommandTask {
   // Current state of background task state machine.
   AppCommandTaskState state;
+  // Resource which is used by this task.
+  AppCommandTaskResource resource;
+  // Sequence number of the task, used to run tasks which are using the same
+  // resource in the order they were scheduled.
+  uint32_t sequence;
+  // Events posted prior to this sequence number are not related to the
+  // operation this task is waiting for.
+  uint32_t event_sequence;
   // Callback which is executed once resource is free.
   //
   // This is a way to avoid too many states of the state machine,
@@ -71,24 +133,46 @@ typedef struct AppCommandTaskData {
   //
   // - Command processor callback sets state to WAIT_AVAILABLE,
   //   additionally it sets which callback needs to be called.
-  // - State machine waits for resource handle to become free.
+  // - State machine waits for all earlier tasks which are using the same
+  //   resource to finish, and for the resource handle to become free.
   // - State machine calls the specified callback.
   AppCommandTaskCallback callback;
   struct SYS_CMD_DEVICE_NODE* callback_cmd_io;
   // Callback to check whether resource is available.
   AppCommandTaskCheckAvailableCallback callback_check_available;
+  // Arguments and results of the command.
+  AppCommandTaskStorage storage;
+} AppCommandTask;
+
+typedef struct AppCommandTaskData {
+  struct AppEventBus* app_event_bus;
+  AppCommandTask tasks[APP_CONFIG_NUM_COMMAND_TASKS];
+  // Sequence number which will be assigned to the next scheduled task.
+  uint32_t next_sequence;
 } AppCommandTaskData;
 
 // Initialize task routines.
-void APP_Command_Task_Initialize(AppCommandTaskData *app_command_task_data);
+void APP_Command_Task_Initialize(AppCommandTaskData *app_command_task_data,
+                                 struct AppEventBus* app_event_bus);
 
 // Check whether command task scheduler is busy with some stuff.
 bool APP_Command_Task_IsBusy(AppCommandTaskData *app_command_task_data);
 
+// Check whether any of the tasks can make progress without waiting for an
+// event.
+bool APP_Command_Task_IsRunnable(AppCommandTaskData *app_command_task_data);
+
+// Check whether there is no room for new task.
+bool APP_Command_Task_IsFull(AppCommandTaskData *app_command_task_data);
+
 // Schedule new task.
-void APP_Command_Task_Schedule(
+//
+// Returns storage of the task, which the caller is to fill in with the command
+// arguments. There must be free room for the task, see APP_Command_Task_IsFull.
+AppCommandTaskStorage* APP_Command_Task_Schedule(
     AppCommandTaskData *app_command_task_data,
     struct SYS_CMD_DEVICE_NODE* callback_cmd_io,
+    AppCommandTaskResource resource,
     AppCommandTaskCallback callback,
     AppCommandTaskCheckAvailableCallback callback_check_available);
 
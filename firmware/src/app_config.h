@@ -0,0 +1,224 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_CONFIG_H
+#define _APP_CONFIG_H
+
+// Compile-time configuration of the application.
+//
+// All the values here can be overridden from the compiler command line, so
+// the same sources can be used for boards of different size without wasting
+// RAM on the smaller ones.
+
+// Number of nixie tubes in the display.
+#ifndef APP_CONFIG_NUM_NIXIE_TUBES
+#  define APP_CONFIG_NUM_NIXIE_TUBES 4
+#endif
+
+// Number of daisy-chained shift registers which are driving cathodes of all
+// the tubes.
+#ifndef APP_CONFIG_NUM_SHIFT_REGISTERS
+#  define APP_CONFIG_NUM_SHIFT_REGISTERS 6
+#endif
+
+// Maximum number of frames in animation sequences generated by the nixie
+// module (digit roll, cathode poisoning cleanup).
+#ifndef APP_CONFIG_NUM_NIXIE_PLAYER_FRAMES
+#  define APP_CONFIG_NUM_NIXIE_PLAYER_FRAMES 32
+#endif
+
+// Maximum number of tasks which can be registered in the main loop scheduler.
+//
+// NOTE: Must be at least the number of tasks registered in app.c, which is
+// asserted during initialization.
+#ifndef APP_CONFIG_NUM_SCHEDULER_TASKS
+#  define APP_CONFIG_NUM_SCHEDULER_TASKS 19
+#endif
+
+// Maximum number of console command tasks which can be queued or running at
+// the same time. Tasks which use different resources run concurrently.
+#ifndef APP_CONFIG_NUM_COMMAND_TASKS
+#  define APP_CONFIG_NUM_COMMAND_TASKS 4
+#endif
+
+// Number of events which can be pending in the event bus. Must be power of two.
+#ifndef APP_CONFIG_EVENT_QUEUE_SIZE
+#  define APP_CONFIG_EVENT_QUEUE_SIZE 16
+#endif
+
+// Maximum number of subscribers of the event bus.
+#ifndef APP_CONFIG_NUM_EVENT_SUBSCRIBERS
+#  define APP_CONFIG_NUM_EVENT_SUBSCRIBERS 8
+#endif
+
+// Maximum number of state transitions a module performs in a single call of
+// its tasks routine. States which don't wait for anything are passed through
+// in the same main loop iteration, this limits latency of other modules.
+#ifndef APP_CONFIG_MAX_STATE_STEPS
+#  define APP_CONFIG_MAX_STATE_STEPS 8
+#endif
+
+// Maximum number of modules which are watched by the supervisor.
+#ifndef APP_CONFIG_NUM_SUPERVISOR_MODULES
+#  define APP_CONFIG_NUM_SUPERVISOR_MODULES 4
+#endif
+
+// Number of most recent stalls which are kept for the report.
+#ifndef APP_CONFIG_NUM_SUPERVISOR_STALLS
+#  define APP_CONFIG_NUM_SUPERVISOR_STALLS 8
+#endif
+
+// Interval in milliseconds between checks of the supervised modules. Must be
+// well below the hardware watchdog period (~32 seconds, see WDTPS).
+#ifndef APP_CONFIG_SUPERVISOR_CHECK_INTERVAL
+#  define APP_CONFIG_SUPERVISOR_CHECK_INTERVAL 100
+#endif
+
+// Interval in seconds between reads of the date and time from the RTC. Time is
+// extrapolated from the system timer in between.
+#ifndef APP_CONFIG_RTC_RESYNC_INTERVAL
+#  define APP_CONFIG_RTC_RESYNC_INTERVAL 60
+#endif
+
+// Interval in seconds between comparisons of the RTC with SNTP time when the
+// drift is not known yet. Interval doubles every time no drift is detected,
+// up to APP_CONFIG_TIME_SYNC_MAX_INTERVAL.
+#ifndef APP_CONFIG_TIME_SYNC_MIN_INTERVAL
+#  define APP_CONFIG_TIME_SYNC_MIN_INTERVAL 3600
+#endif
+
+#ifndef APP_CONFIG_TIME_SYNC_MAX_INTERVAL
+#  define APP_CONFIG_TIME_SYNC_MAX_INTERVAL (7 * 24 * 3600)
+#endif
+
+// Interval in seconds between attempts to synchronize time while SNTP did not
+// receive time from the server yet.
+#ifndef APP_CONFIG_TIME_SYNC_RETRY_INTERVAL
+#  define APP_CONFIG_TIME_SYNC_RETRY_INTERVAL 30
+#endif
+
+// Number of most recent RTC corrections which are kept for the report.
+#ifndef APP_CONFIG_NUM_TIME_SYNC_CORRECTIONS
+#  define APP_CONFIG_NUM_TIME_SYNC_CORRECTIONS 8
+#endif
+
+// Number of erase blocks at the end of the serial flash which are used by the
+// settings store. They are hidden from the file system. At least two blocks
+// are needed, every extra block spreads the wear further.
+#ifndef APP_CONFIG_FLASH_SETTINGS_NUM_BLOCKS
+#  define APP_CONFIG_FLASH_SETTINGS_NUM_BLOCKS 4
+#endif
+
+// Number of erase blocks at the end of the serial flash which are used by the
+// history of the displayed values, in front of the settings store. With 4 KB
+// blocks and a sample stored every few hours this holds over a year.
+#ifndef APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS
+#  define APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS 32
+#endif
+
+// Number of erase blocks of the serial flash which are used as a staging area
+// of the firmware update image, in front of the history. Has to fit the whole
+// image, which is no bigger than the program flash (512 KB) and the boot flash
+// (12 KB) of the PIC32MX795F512L, rounded up to 4 KB erase blocks.
+#ifndef APP_CONFIG_FLASH_FIRMWARE_NUM_BLOCKS
+#  define APP_CONFIG_FLASH_FIRMWARE_NUM_BLOCKS \
+    (((512 + 12) * 1024 + 4 * 1024 - 1) / (4 * 1024))
+#endif
+
+// Number of erase blocks which hold the log of the firmware update state,
+// right after the image. Blocks are used in turns, so at least two are
+// needed for the last record to survive the erase.
+#ifndef APP_CONFIG_FLASH_FIRMWARE_STATE_NUM_BLOCKS
+#  define APP_CONFIG_FLASH_FIRMWARE_STATE_NUM_BLOCKS 2
+#endif
+
+// Number of file system sectors which are cached in RAM, see
+// app_flash_cache.h. Every line takes a bit over 512 bytes.
+#ifndef APP_CONFIG_FLASH_CACHE_NUM_LINES
+#  define APP_CONFIG_FLASH_CACHE_NUM_LINES 16
+#endif
+
+// Time in milliseconds the file system is to stay idle before the sectors
+// which were written to the cache are written to the flash.
+#ifndef APP_CONFIG_FLASH_CACHE_FLUSH_DELAY
+#  define APP_CONFIG_FLASH_CACHE_FLUSH_DELAY 2000
+#endif
+
+// Maximum time in seconds a recorded history sample stays in RAM before it is
+// programmed into the flash.
+#ifndef APP_CONFIG_HISTORY_FLUSH_INTERVAL
+#  define APP_CONFIG_HISTORY_FLUSH_INTERVAL (15 * 60)
+#endif
+
+// Interval in seconds after which a history sample is stored even if the
+// value did not change.
+#ifndef APP_CONFIG_HISTORY_HEARTBEAT_INTERVAL
+#  define APP_CONFIG_HISTORY_HEARTBEAT_INTERVAL (60 * 60)
+#endif
+
+// Time in milliseconds HTTP(S) client waits for the next data from the
+// server before the request is considered failed.
+#ifndef APP_CONFIG_HTTPS_CLIENT_RESPONSE_TIMEOUT
+#  define APP_CONFIG_HTTPS_CLIENT_RESPONSE_TIMEOUT 15000
+#endif
+
+// Size of each of the two pages the downloaded data is collected into before
+// it is written to the flash, see app_download.h. Must be a multiple of the
+// write block of the flash and at least the size of the network buffer.
+#ifndef APP_CONFIG_DOWNLOAD_PAGE_SIZE
+#  define APP_CONFIG_DOWNLOAD_PAGE_SIZE 512
+#endif
+
+// Number of times interrupted download is resumed without any new data
+// received in between. Delay before the retry starts at
+// APP_CONFIG_DOWNLOAD_RETRY_DELAY milliseconds and doubles every time.
+#ifndef APP_CONFIG_DOWNLOAD_MAX_RETRIES
+#  define APP_CONFIG_DOWNLOAD_MAX_RETRIES 5
+#endif
+
+#ifndef APP_CONFIG_DOWNLOAD_RETRY_DELAY
+#  define APP_CONFIG_DOWNLOAD_RETRY_DELAY 1000
+#endif
+
+// Number of bytes of the firmware image after which download progress is
+// recorded, so update resumes from there after a reboot. Rounded down to the
+// erase block of the flash.
+#ifndef APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL
+#  define APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL (64 * 1024)
+#endif
+
+// Maximum rate in bytes per second at which the firmware image is downloaded,
+// so the update does not starve the rest of the application of the network
+// and the flash. Zero means no limit.
+#ifndef APP_CONFIG_FIRMWARE_UPDATE_MAX_RATE
+#  define APP_CONFIG_FIRMWARE_UPDATE_MAX_RATE (32 * 1024)
+#endif
+
+// Define APP_CONFIG_WITH_RTC_MFP when the MFP output of the RTC is wired to an
+// interrupt capable pin which calls APP_RTC_MFPEdge(). RTC is then configured
+// to output 1 Hz square wave, which keeps cached time aligned to the second.
+
+// Define APP_CONFIG_WITH_PROFILER to measure time spent in every task of the
+// main loop, see app_profiler.h. Disabled by default, since it adds overhead
+// to every dispatched task.
+
+#endif  // _APP_CONFIG_H
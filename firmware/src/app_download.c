@@ -0,0 +1,1008 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_download.h"
+
+#include <string.h>
+
+#include "app_event.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#include "util_crc.h"
+#include "util_math.h"
+#include "util_string.h"
+
+#define LOG_PREFIX "APP DOWNLOAD: "
+
+// Regular print / message.
+#define DOWNLOAD_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define DOWNLOAD_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Error print / message.
+#define DOWNLOAD_ERROR_PRINT(format, ...) \
+  APP_ERROR_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define DOWNLOAD_ERROR_MESSAGE(message) APP_ERROR_MESSAGE(LOG_PREFIX, message)
+// Debug print / message.
+#define DOWNLOAD_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define DOWNLOAD_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+#define PAGE_SIZE APP_CONFIG_DOWNLOAD_PAGE_SIZE
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal helpers.
+
+static bool isRawTarget(const AppDownloadData* app_download_data) {
+  return app_download_data->target == APP_DOWNLOAD_TARGET_FLASH_RAW;
+}
+
+static void fileClose(AppDownloadData* app_download_data) {
+  if (!app_download_data->is_file_open) {
+    return;
+  }
+  SYS_FS_FileClose((SYS_FS_HANDLE)app_download_data->file_handle);
+  app_download_data->is_file_open = false;
+}
+
+static bool fileOpen(AppDownloadData* app_download_data,
+                     SYS_FS_FILE_OPEN_ATTRIBUTES attributes) {
+  fileClose(app_download_data);
+  const SYS_FS_HANDLE handle = SYS_FS_FileOpen(app_download_data->path,
+                                               attributes);
+  if (handle == SYS_FS_HANDLE_INVALID) {
+    return false;
+  }
+  app_download_data->file_handle = (AppDownloadFileHandle)handle;
+  app_download_data->is_file_open = true;
+  return true;
+}
+
+static void dataStored(AppDownloadData* app_download_data,
+                       uint32_t offset,
+                       const uint8_t* data,
+                       uint32_t num_bytes) {
+  const AppDownloadCallbacks* callbacks = &app_download_data->callbacks;
+  if (callbacks->data_stored != NULL) {
+    callbacks->data_stored(offset, data, num_bytes, callbacks->user_data);
+  }
+}
+
+static void finish(AppDownloadData* app_download_data,
+                   AppDownloadError error) {
+  fileClose(app_download_data);
+  APP_Timer_Cancel(app_download_data->app_timer_wheel,
+                   &app_download_data->retry_timer);
+  app_download_data->error = error;
+  app_download_data->state = APP_DOWNLOAD_STATE_IDLE;
+  if (error == APP_DOWNLOAD_ERROR_NONE) {
+    DOWNLOAD_PRINT("Stored %lu bytes at %lu bytes/s, CRC-32 %08lx.\r\n",
+                   (unsigned long)app_download_data->num_bytes_stored,
+                   (unsigned long)APP_Download_Throughput(app_download_data),
+                   (unsigned long)app_download_data->stored_crc);
+  } else {
+    DOWNLOAD_ERROR_PRINT("Download failed: %s.\r\n",
+                         APP_Download_ErrorString(error));
+  }
+  APP_Event_Post(app_download_data->app_event_bus,
+                 APP_EVENT_DOWNLOAD_DONE,
+                 app_download_data);
+}
+
+// Abort the request, if any, and report the error once the flash is done
+// with the operations which refer to the pages.
+static void abortWithError(AppDownloadData* app_download_data,
+                           AppDownloadError error) {
+  app_download_data->error = error;
+  app_download_data->state = APP_DOWNLOAD_STATE_ABORT;
+  if (app_download_data->is_request_active) {
+    APP_HTTPS_Client_Abort(app_download_data->app_https_client);
+  }
+}
+
+static void throttleEnd(AppDownloadData* app_download_data) {
+  if (!app_download_data->is_throttled) {
+    return;
+  }
+  app_download_data->throttled_time +=
+      SYS_TMR_SystemCountGet() - app_download_data->throttle_start_time;
+  app_download_data->is_throttled = false;
+}
+
+////////////////////////////////////////
+// Pages.
+
+static void pagesReset(AppDownloadData* app_download_data) {
+  int i;
+  for (i = 0; i < 2; ++i) {
+    app_download_data->pages[i].state = APP_DOWNLOAD_PAGE_FREE;
+    app_download_data->pages[i].num_bytes = 0;
+  }
+  app_download_data->fill_page = 0;
+  app_download_data->write_page = 0;
+  app_download_data->num_bytes_received = app_download_data->num_bytes_stored;
+}
+
+static bool pagesAreIdle(const AppDownloadData* app_download_data) {
+  return app_download_data->num_flash_operations == 0 &&
+         app_download_data->pages[0].state == APP_DOWNLOAD_PAGE_FREE &&
+         app_download_data->pages[1].state == APP_DOWNLOAD_PAGE_FREE;
+}
+
+static bool hasPendingPage(const AppDownloadData* app_download_data) {
+  const AppDownloadPage* page =
+      &app_download_data->pages[app_download_data->write_page];
+  return page->state == APP_DOWNLOAD_PAGE_PENDING;
+}
+
+// Fill page is complete, it is to be written and the next received bytes go
+// to the other page.
+static void pageComplete(AppDownloadData* app_download_data) {
+  AppDownloadPage* page =
+      &app_download_data->pages[app_download_data->fill_page];
+  page->offset = app_download_data->num_bytes_received - page->num_bytes;
+  page->state = APP_DOWNLOAD_PAGE_PENDING;
+  app_download_data->fill_page ^= 1;
+}
+
+// Page at the head of the write order is written.
+static void pageWritten(AppDownloadData* app_download_data, bool success) {
+  AppDownloadPage* page =
+      &app_download_data->pages[app_download_data->write_page];
+  if (!success || app_download_data->is_storage_failed) {
+    DOWNLOAD_ERROR_PRINT("Error writing %lu bytes at offset %lu.\r\n",
+                         (unsigned long)page->num_bytes,
+                         (unsigned long)page->offset);
+    app_download_data->is_storage_failed = true;
+  } else {
+    app_download_data->stored_crc = crc32_update(app_download_data->stored_crc,
+                                                 page->data,
+                                                 page->num_bytes);
+    app_download_data->num_bytes_stored += page->num_bytes;
+    dataStored(app_download_data, page->offset, page->data, page->num_bytes);
+  }
+  app_download_data->end_time = SYS_TMR_SystemCountGet();
+  page->state = APP_DOWNLOAD_PAGE_FREE;
+  page->num_bytes = 0;
+  app_download_data->write_page ^= 1;
+}
+
+static void eraseCallback(bool success, void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  --app_download_data->num_flash_operations;
+  if (!success) {
+    DOWNLOAD_ERROR_MESSAGE("Error erasing flash.\r\n");
+    app_download_data->is_storage_failed = true;
+  }
+}
+
+static void pagesWrite(AppDownloadData* app_download_data);
+
+static void writeCallback(bool success, void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  --app_download_data->num_flash_operations;
+  pageWritten(app_download_data, success);
+  // Keep the flash busy, the other page might be complete already.
+  pagesWrite(app_download_data);
+}
+
+// Queue write of the page into the raw flash region, erasing blocks which
+// are entered by the page.
+static bool pageWriteRaw(AppDownloadData* app_download_data,
+                         AppDownloadPage* page) {
+  AppFlashRawData* app_flash_raw = app_download_data->app_flash_raw;
+  const uint32_t erase_block_size = app_flash_raw->erase_block_size;
+  const uint32_t end = page->offset + page->num_bytes;
+  uint32_t block_offset = (page->offset + erase_block_size - 1) /
+                          erase_block_size * erase_block_size;
+  for (; block_offset < end; block_offset += erase_block_size) {
+    if (!APP_FlashRaw_Erase(app_flash_raw,
+                            app_download_data->region,
+                            block_offset,
+                            erase_block_size,
+                            eraseCallback,
+                            app_download_data)) {
+      return false;
+    }
+    ++app_download_data->num_flash_operations;
+  }
+  if (!APP_FlashRaw_Write(app_flash_raw,
+                          app_download_data->region,
+                          page->offset,
+                          page->data,
+                          page->num_bytes,
+                          writeCallback,
+                          app_download_data)) {
+    return false;
+  }
+  ++app_download_data->num_flash_operations;
+  return true;
+}
+
+// Write the page into the file.
+//
+// NOTE: File system is blocking, but sectors are absorbed by the cache and
+// are programmed into the flash later on.
+static bool pageWriteFile(AppDownloadData* app_download_data,
+                          AppDownloadPage* page) {
+  const size_t num_bytes_written = SYS_FS_FileWrite(
+      (SYS_FS_HANDLE)app_download_data->file_handle,
+      page->data,
+      page->num_bytes);
+  pageWritten(app_download_data, num_bytes_written == page->num_bytes);
+  return true;
+}
+
+// Start writing all complete pages, in the order they were filled.
+static void pagesWrite(AppDownloadData* app_download_data) {
+  while (!app_download_data->is_storage_failed &&
+         hasPendingPage(app_download_data)) {
+    AppDownloadPage* page =
+        &app_download_data->pages[app_download_data->write_page];
+    page->state = APP_DOWNLOAD_PAGE_WRITE;
+    const bool success = isRawTarget(app_download_data)
+        ? pageWriteRaw(app_download_data, page)
+        : pageWriteFile(app_download_data, page);
+    if (!success) {
+      DOWNLOAD_ERROR_MESSAGE("Error queueing flash operation.\r\n");
+      app_download_data->is_storage_failed = true;
+    }
+  }
+}
+
+// Copy received body bytes into the pages.
+static void pagesFill(AppDownloadData* app_download_data,
+                      const uint8_t* buffer,
+                      size_t num_bytes) {
+  while (num_bytes != 0) {
+    AppDownloadPage* page =
+        &app_download_data->pages[app_download_data->fill_page];
+    if (page->state != APP_DOWNLOAD_PAGE_FREE) {
+      // Should not happen, HTTPS client checks whether we are ready.
+      DOWNLOAD_ERROR_MESSAGE("No room for the received data.\r\n");
+      app_download_data->is_overrun = true;
+      return;
+    }
+    const size_t num_copy_bytes = min_zz(num_bytes,
+                                         PAGE_SIZE - page->num_bytes);
+    memcpy(page->data + page->num_bytes, buffer, num_copy_bytes);
+    page->num_bytes += num_copy_bytes;
+    app_download_data->num_bytes_received += num_copy_bytes;
+    buffer += num_copy_bytes;
+    num_bytes -= num_copy_bytes;
+    if (page->num_bytes == PAGE_SIZE) {
+      pageComplete(app_download_data);
+    }
+  }
+}
+
+////////////////////////////////////////
+// Response.
+
+static void reject(AppDownloadData* app_download_data,
+                   AppDownloadError error) {
+  app_download_data->error = error;
+  app_download_data->is_rejected = true;
+}
+
+static void headerLineCallback(const char* line,
+                               size_t line_len,
+                               void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  const char* value;
+  size_t value_len;
+  if (app_download_data->status_code == 0) {
+    if (!http_parse_status_line(line, line_len,
+                                &app_download_data->status_code)) {
+      app_download_data->status_code = -1;
+    }
+    return;
+  }
+  if ((value = http_header_value(line, line_len,
+                                 "content-length", &value_len)) != NULL) {
+    app_download_data->has_content_length = http_parse_uint32(
+        value, value_len, &app_download_data->content_length);
+  } else if ((value = http_header_value(line, line_len,
+                                        "content-range",
+                                        &value_len)) != NULL) {
+    uint32_t last;
+    app_download_data->has_content_range = http_parse_content_range(
+        value, value_len,
+        &app_download_data->range_first,
+        &last,
+        &app_download_data->range_total);
+  } else if ((value = http_header_value(line, line_len,
+                                        "transfer-encoding",
+                                        &value_len)) != NULL ||
+             (value = http_header_value(line, line_len,
+                                        "content-encoding",
+                                        &value_len)) != NULL) {
+    // Chunked or compressed body is not the resource itself.
+    if (value_len != 8 || !STREQ_LEN(value, "identity", 8)) {
+      app_download_data->is_unsupported = true;
+    }
+  }
+}
+
+// Headers are received, check whether the body is what we've asked for.
+static void acceptResponse(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  if (data->is_unsupported) {
+    DOWNLOAD_ERROR_MESSAGE("Encoded response is not supported.\r\n");
+    reject(data, APP_DOWNLOAD_ERROR_RESPONSE);
+    return;
+  }
+  switch (data->status_code) {
+    case 200:
+      if (data->num_bytes_stored != 0) {
+        DOWNLOAD_MESSAGE("Server ignored range, "
+                         "downloading from the beginning.\r\n");
+        // Re-open the file so it is truncated.
+        if (!isRawTarget(data) && !fileOpen(data, SYS_FS_FILE_OPEN_WRITE)) {
+          reject(data, APP_DOWNLOAD_ERROR_STORAGE);
+          return;
+        }
+        data->num_bytes_stored = 0;
+        data->num_bytes_resumed = 0;
+        data->stored_crc = CRC32_INIT;
+      }
+      data->total_size = data->has_content_length ? data->content_length : 0;
+      break;
+    case 206:
+      if (!data->has_content_range ||
+          data->range_first != data->num_bytes_stored) {
+        DOWNLOAD_ERROR_MESSAGE("Unexpected range of partial content.\r\n");
+        reject(data, APP_DOWNLOAD_ERROR_RESPONSE);
+        return;
+      }
+      data->total_size = data->range_total;
+      break;
+    default:
+      DOWNLOAD_ERROR_PRINT("Unexpected HTTP status %d.\r\n",
+                           data->status_code);
+      reject(data, APP_DOWNLOAD_ERROR_RESPONSE);
+      return;
+  }
+  if (isRawTarget(data) &&
+      data->total_size > APP_FlashRaw_RegionSize(data->app_flash_raw,
+                                                 data->region)) {
+    reject(data, APP_DOWNLOAD_ERROR_TOO_LARGE);
+    return;
+  }
+  DOWNLOAD_DEBUG_PRINT("Receiving bytes from %lu of %lu.\r\n",
+                       (unsigned long)data->num_bytes_stored,
+                       (unsigned long)data->total_size);
+  pagesReset(data);
+  data->body_offset = data->num_bytes_received;
+  if (!data->has_start_time) {
+    data->start_time = SYS_TMR_SystemCountGet();
+    data->end_time = data->start_time;
+    data->has_start_time = true;
+  }
+  data->is_body_accepted = true;
+}
+
+static void bufferReceivedCallback(const uint8_t* buffer,
+                                   uint16_t num_bytes,
+                                   void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  if (app_download_data->is_rejected || app_download_data->is_overrun) {
+    return;
+  }
+  if (!app_download_data->scanner.is_body) {
+    const size_t num_header_bytes = http_response_scanner_feed(
+        &app_download_data->scanner,
+        buffer,
+        num_bytes,
+        headerLineCallback,
+        app_download_data);
+    if (!app_download_data->scanner.is_body) {
+      return;
+    }
+    buffer += num_header_bytes;
+    num_bytes -= num_header_bytes;
+    acceptResponse(app_download_data);
+    if (app_download_data->is_rejected) {
+      return;
+    }
+  }
+  const uint32_t end = app_download_data->num_bytes_received + num_bytes;
+  if (isRawTarget(app_download_data) &&
+      end > APP_FlashRaw_RegionSize(app_download_data->app_flash_raw,
+                                    app_download_data->region)) {
+    reject(app_download_data, APP_DOWNLOAD_ERROR_TOO_LARGE);
+    return;
+  }
+  if (app_download_data->total_size != 0 &&
+      end > app_download_data->total_size) {
+    DOWNLOAD_ERROR_MESSAGE("Server sent more data than announced.\r\n");
+    reject(app_download_data, APP_DOWNLOAD_ERROR_RESPONSE);
+    return;
+  }
+  pagesFill(app_download_data, buffer, num_bytes);
+}
+
+// Check whether the body was received faster than the rate limit allows.
+//
+// One network buffer worth of data is allowed on top, so the first buffer is
+// not held back.
+static bool isRateExceeded(const AppDownloadData* app_download_data) {
+  const AppDownloadData* data = app_download_data;
+  if (data->max_rate == 0 || !data->has_start_time) {
+    return false;
+  }
+  const uint64_t elapsed_time = SYS_TMR_SystemCountGet() - data->start_time;
+  const uint64_t num_bytes_allowed =
+      (uint64_t)data->max_rate * elapsed_time /
+          SYS_TMR_SystemCountFrequencyGet() +
+      HTTPS_CLIENT_NETWORK_BUFFER_SIZE;
+  return data->num_bytes_received - data->num_bytes_resumed >=
+         num_bytes_allowed;
+}
+
+static bool isReadyCallback(void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  if (!app_download_data->is_body_accepted ||
+      app_download_data->is_rejected) {
+    return true;
+  }
+  const AppDownloadPage* fill_page =
+      &app_download_data->pages[app_download_data->fill_page];
+  const AppDownloadPage* other_page =
+      &app_download_data->pages[app_download_data->fill_page ^ 1];
+  const bool is_ready =
+      fill_page->state == APP_DOWNLOAD_PAGE_FREE &&
+      (PAGE_SIZE - fill_page->num_bytes >= HTTPS_CLIENT_NETWORK_BUFFER_SIZE ||
+       other_page->state == APP_DOWNLOAD_PAGE_FREE);
+  if (is_ready) {
+    throttleEnd(app_download_data);
+  } else if (!app_download_data->is_throttled) {
+    app_download_data->throttle_start_time = SYS_TMR_SystemCountGet();
+    app_download_data->is_throttled = true;
+    ++app_download_data->num_throttles;
+  }
+  return is_ready && !isRateExceeded(app_download_data);
+}
+
+static void requestHandledCallback(void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  app_download_data->is_request_active = false;
+  app_download_data->is_response_finished = true;
+}
+
+static void errorCallback(void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  app_download_data->is_request_active = false;
+  app_download_data->is_response_failed = true;
+}
+
+////////////////////////////////////////
+// State machine.
+
+static void retryBegin(AppDownloadData* app_download_data) {
+  throttleEnd(app_download_data);
+  // Only requests which fail without making any progress are counted.
+  if (app_download_data->is_body_accepted &&
+      app_download_data->num_bytes_received != app_download_data->body_offset) {
+    app_download_data->num_retries = 0;
+  }
+  if (app_download_data->num_retries >= APP_CONFIG_DOWNLOAD_MAX_RETRIES) {
+    abortWithError(app_download_data, APP_DOWNLOAD_ERROR_NETWORK);
+    return;
+  }
+  // Whatever was received is stored, so it is not requested again.
+  AppDownloadPage* fill_page =
+      &app_download_data->pages[app_download_data->fill_page];
+  if (fill_page->state == APP_DOWNLOAD_PAGE_FREE &&
+      fill_page->num_bytes != 0) {
+    pageComplete(app_download_data);
+  }
+  const uint32_t delay =
+      APP_CONFIG_DOWNLOAD_RETRY_DELAY << app_download_data->num_retries;
+  ++app_download_data->num_retries;
+  DOWNLOAD_PRINT("Request failed, retrying in %lu ms.\r\n",
+                 (unsigned long)delay);
+  APP_Timer_Start(app_download_data->app_timer_wheel,
+                  &app_download_data->retry_timer,
+                  delay);
+  app_download_data->state = APP_DOWNLOAD_STATE_WAIT_RETRY;
+}
+
+// Begin reading back the stored data, chunk by chunk.
+static void readBackBegin(AppDownloadData* app_download_data,
+                          AppDownloadState state) {
+  app_download_data->num_bytes_verified = 0;
+  app_download_data->verify_crc = CRC32_INIT;
+  app_download_data->state = state;
+}
+
+// Chunk of the stored data is read into the first page.
+static void readBackChunk(AppDownloadData* app_download_data) {
+  AppDownloadPage* page = &app_download_data->pages[0];
+  if (app_download_data->state == APP_DOWNLOAD_STATE_READ_STORED ||
+      app_download_data->state == APP_DOWNLOAD_STATE_WAIT_READ_STORED) {
+    // Consumer catches up with the data stored by the earlier download.
+    dataStored(app_download_data,
+               app_download_data->num_bytes_verified,
+               page->data,
+               page->num_bytes);
+  }
+  app_download_data->verify_crc = crc32_update(
+      app_download_data->verify_crc, page->data, page->num_bytes);
+  app_download_data->num_bytes_verified += page->num_bytes;
+}
+
+static void readBackCallback(bool success, void* user_data) {
+  AppDownloadData* app_download_data = (AppDownloadData*)user_data;
+  --app_download_data->num_flash_operations;
+  if (!success) {
+    app_download_data->is_storage_failed = true;
+  } else {
+    readBackChunk(app_download_data);
+  }
+  app_download_data->state =
+      (app_download_data->state == APP_DOWNLOAD_STATE_WAIT_READ_STORED)
+          ? APP_DOWNLOAD_STATE_READ_STORED
+          : APP_DOWNLOAD_STATE_VERIFY;
+}
+
+// Read the next chunk of the stored data into the first page.
+//
+// Returns true once all the data is read.
+static bool readBackStep(AppDownloadData* app_download_data,
+                         AppDownloadState wait_state) {
+  AppDownloadPage* page = &app_download_data->pages[0];
+  if (app_download_data->is_storage_failed) {
+    abortWithError(app_download_data, APP_DOWNLOAD_ERROR_STORAGE);
+    return false;
+  }
+  page->num_bytes = min_zz(PAGE_SIZE,
+                           app_download_data->num_bytes_stored -
+                               app_download_data->num_bytes_verified);
+  if (page->num_bytes == 0) {
+    return true;
+  }
+  if (isRawTarget(app_download_data)) {
+    if (!APP_FlashRaw_Read(app_download_data->app_flash_raw,
+                           app_download_data->region,
+                           app_download_data->num_bytes_verified,
+                           page->data,
+                           page->num_bytes,
+                           readBackCallback,
+                           app_download_data)) {
+      abortWithError(app_download_data, APP_DOWNLOAD_ERROR_STORAGE);
+      return false;
+    }
+    ++app_download_data->num_flash_operations;
+    app_download_data->state = wait_state;
+    return false;
+  }
+  const size_t num_bytes_read = SYS_FS_FileRead(
+      (SYS_FS_HANDLE)app_download_data->file_handle,
+      page->data,
+      page->num_bytes);
+  if (num_bytes_read != page->num_bytes) {
+    abortWithError(app_download_data, APP_DOWNLOAD_ERROR_STORAGE);
+    return false;
+  }
+  readBackChunk(app_download_data);
+  return false;
+}
+
+static void openTarget(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  if (isRawTarget(data)) {
+    if (APP_FlashRaw_IsError(data->app_flash_raw)) {
+      abortWithError(data, APP_DOWNLOAD_ERROR_STORAGE);
+      return;
+    }
+    if (!APP_FlashRaw_IsReady(data->app_flash_raw)) {
+      return;
+    }
+    if (data->num_bytes_stored >
+        APP_FlashRaw_RegionSize(data->app_flash_raw, data->region)) {
+      abortWithError(data, APP_DOWNLOAD_ERROR_TOO_LARGE);
+      return;
+    }
+  } else if (data->is_resume && fileOpen(data, SYS_FS_FILE_OPEN_READ)) {
+    const int32_t size = SYS_FS_FileSize((SYS_FS_HANDLE)data->file_handle);
+    data->num_bytes_stored = (size > 0) ? size : 0;
+  } else {
+    data->num_bytes_stored = 0;
+    if (!fileOpen(data, SYS_FS_FILE_OPEN_WRITE)) {
+      DOWNLOAD_ERROR_PRINT("Error opening file %s.\r\n", data->path);
+      abortWithError(data, APP_DOWNLOAD_ERROR_STORAGE);
+      return;
+    }
+  }
+  data->num_bytes_resumed = data->num_bytes_stored;
+  if (data->num_bytes_stored != 0) {
+    DOWNLOAD_PRINT("Resuming download after %lu bytes.\r\n",
+                   (unsigned long)data->num_bytes_stored);
+    readBackBegin(data, APP_DOWNLOAD_STATE_READ_STORED);
+  } else {
+    data->state = APP_DOWNLOAD_STATE_REQUEST;
+  }
+}
+
+static void readStored(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  if (!readBackStep(data, APP_DOWNLOAD_STATE_WAIT_READ_STORED)) {
+    return;
+  }
+  data->stored_crc = data->verify_crc;
+  if (!isRawTarget(data) && !fileOpen(data, SYS_FS_FILE_OPEN_APPEND)) {
+    DOWNLOAD_ERROR_PRINT("Error opening file %s.\r\n", data->path);
+    abortWithError(data, APP_DOWNLOAD_ERROR_STORAGE);
+    return;
+  }
+  data->state = APP_DOWNLOAD_STATE_REQUEST;
+}
+
+static void sendRequest(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  if (APP_HTTPS_Client_IsBusy(data->app_https_client)) {
+    return;
+  }
+  http_response_scanner_reset(&data->scanner);
+  data->status_code = 0;
+  data->has_content_length = false;
+  data->has_content_range = false;
+  data->is_unsupported = false;
+  data->is_body_accepted = false;
+  data->is_rejected = false;
+  data->is_overrun = false;
+  data->is_response_finished = false;
+  data->is_response_failed = false;
+  AppHttpsClientCallbacks callbacks;
+  callbacks.buffer_received = bufferReceivedCallback;
+  callbacks.request_handled = requestHandledCallback;
+  callbacks.error = errorCallback;
+  callbacks.is_ready = isReadyCallback;
+  callbacks.user_data = data;
+  if (!APP_HTTPS_Client_RequestRange(data->app_https_client,
+                                     data->url,
+                                     data->num_bytes_stored,
+                                     &callbacks)) {
+    abortWithError(data, APP_DOWNLOAD_ERROR_NETWORK);
+    return;
+  }
+  data->is_request_active = true;
+  data->state = APP_DOWNLOAD_STATE_RECEIVE;
+}
+
+static void receive(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  pagesWrite(data);
+  if (data->is_storage_failed) {
+    abortWithError(data, APP_DOWNLOAD_ERROR_STORAGE);
+  } else if (data->is_rejected) {
+    abortWithError(data, data->error);
+  } else if (data->is_overrun && data->is_request_active) {
+    // Error callback is invoked, retry is handled below.
+    APP_HTTPS_Client_Abort(data->app_https_client);
+  }
+  if (data->state != APP_DOWNLOAD_STATE_RECEIVE) {
+    return;
+  }
+  if (data->is_response_failed) {
+    retryBegin(data);
+  } else if (data->is_response_finished) {
+    throttleEnd(data);
+    if (!data->is_body_accepted ||
+        (data->total_size != 0 &&
+         data->num_bytes_received != data->total_size)) {
+      DOWNLOAD_MESSAGE("Connection closed before the end of the body.\r\n");
+      retryBegin(data);
+    } else {
+      data->state = APP_DOWNLOAD_STATE_FLUSH;
+    }
+  }
+}
+
+static void waitRetry(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  pagesWrite(data);
+  if (data->is_storage_failed) {
+    abortWithError(data, APP_DOWNLOAD_ERROR_STORAGE);
+    return;
+  }
+  if (!pagesAreIdle(data) || !APP_Timer_IsExpired(&data->retry_timer)) {
+    return;
+  }
+  ++data->num_resumes;
+  data->state = APP_DOWNLOAD_STATE_REQUEST;
+}
+
+static void flush(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  AppDownloadPage* fill_page = &data->pages[data->fill_page];
+  if (fill_page->state == APP_DOWNLOAD_PAGE_FREE &&
+      fill_page->num_bytes != 0) {
+    pageComplete(data);
+  }
+  pagesWrite(data);
+  if (data->is_storage_failed) {
+    abortWithError(data, APP_DOWNLOAD_ERROR_STORAGE);
+    return;
+  }
+  if (!pagesAreIdle(data)) {
+    return;
+  }
+  if (!isRawTarget(data) && !fileOpen(data, SYS_FS_FILE_OPEN_READ)) {
+    abortWithError(data, APP_DOWNLOAD_ERROR_STORAGE);
+    return;
+  }
+  readBackBegin(data, APP_DOWNLOAD_STATE_VERIFY);
+}
+
+static void verify(AppDownloadData* app_download_data) {
+  AppDownloadData* data = app_download_data;
+  if (!readBackStep(data, APP_DOWNLOAD_STATE_WAIT_VERIFY)) {
+    return;
+  }
+  if (data->verify_crc != data->stored_crc) {
+    DOWNLOAD_ERROR_PRINT("Stored data has CRC-32 %08lx, "
+                         "received %08lx.\r\n",
+                         (unsigned long)data->verify_crc,
+                         (unsigned long)data->stored_crc);
+    finish(data, APP_DOWNLOAD_ERROR_INTEGRITY);
+    return;
+  }
+  if (data->has_expected_crc && data->expected_crc != data->stored_crc) {
+    DOWNLOAD_ERROR_PRINT("Received data has CRC-32 %08lx, "
+                         "expected %08lx.\r\n",
+                         (unsigned long)data->stored_crc,
+                         (unsigned long)data->expected_crc);
+    finish(data, APP_DOWNLOAD_ERROR_INTEGRITY);
+    return;
+  }
+  finish(data, APP_DOWNLOAD_ERROR_NONE);
+}
+
+static void performStep(AppDownloadData* app_download_data) {
+  switch (app_download_data->state) {
+    case APP_DOWNLOAD_STATE_IDLE:
+    case APP_DOWNLOAD_STATE_WAIT_READ_STORED:
+    case APP_DOWNLOAD_STATE_WAIT_VERIFY:
+      // Nothing to do.
+      break;
+    case APP_DOWNLOAD_STATE_OPEN:
+      openTarget(app_download_data);
+      break;
+    case APP_DOWNLOAD_STATE_READ_STORED:
+      readStored(app_download_data);
+      break;
+    case APP_DOWNLOAD_STATE_REQUEST:
+      sendRequest(app_download_data);
+      break;
+    case APP_DOWNLOAD_STATE_RECEIVE:
+      receive(app_download_data);
+      break;
+    case APP_DOWNLOAD_STATE_WAIT_RETRY:
+      waitRetry(app_download_data);
+      break;
+    case APP_DOWNLOAD_STATE_FLUSH:
+      flush(app_download_data);
+      break;
+    case APP_DOWNLOAD_STATE_VERIFY:
+      verify(app_download_data);
+      break;
+    case APP_DOWNLOAD_STATE_ABORT:
+      // Pages are referenced by the queued flash operations.
+      if (app_download_data->num_flash_operations == 0) {
+        finish(app_download_data, app_download_data->error);
+      }
+      break;
+  }
+}
+
+static bool start(AppDownloadData* app_download_data,
+                  const char* url,
+                  uint32_t num_bytes_stored,
+                  const uint32_t* crc,
+                  const AppDownloadCallbacks* callbacks) {
+  AppDownloadData* data = app_download_data;
+  safe_strncpy(data->url, url, sizeof(data->url));
+  if (callbacks != NULL) {
+    data->callbacks = *callbacks;
+  } else {
+    memset(&data->callbacks, 0, sizeof(data->callbacks));
+  }
+  data->has_expected_crc = (crc != NULL);
+  data->expected_crc = (crc != NULL) ? *crc : 0;
+  data->max_rate = 0;
+  data->error = APP_DOWNLOAD_ERROR_NONE;
+  data->num_bytes_stored = num_bytes_stored;
+  data->stored_crc = CRC32_INIT;
+  data->is_storage_failed = false;
+  data->is_request_active = false;
+  data->num_retries = 0;
+  data->has_start_time = false;
+  data->throttled_time = 0;
+  data->is_throttled = false;
+  data->num_throttles = 0;
+  data->num_resumes = 0;
+  pagesReset(data);
+  data->state = APP_DOWNLOAD_STATE_OPEN;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_Download_Initialize(AppDownloadData* app_download_data,
+                             AppHTTPSClientData* app_https_client,
+                             AppFlashRawData* app_flash_raw,
+                             AppTimerWheel* app_timer_wheel,
+                             AppEventBus* app_event_bus) {
+  memset(app_download_data, 0, sizeof(*app_download_data));
+  app_download_data->state = APP_DOWNLOAD_STATE_IDLE;
+  app_download_data->app_https_client = app_https_client;
+  app_download_data->app_flash_raw = app_flash_raw;
+  app_download_data->app_timer_wheel = app_timer_wheel;
+  app_download_data->app_event_bus = app_event_bus;
+  APP_Timer_Setup(&app_download_data->retry_timer, NULL, NULL);
+}
+
+void APP_Download_Tasks(AppDownloadData* app_download_data) {
+  AppDownloadState previous_state;
+  int num_steps = 0;
+  do {
+    previous_state = app_download_data->state;
+    performStep(app_download_data);
+  } while (app_download_data->state != previous_state &&
+           app_download_data->state != APP_DOWNLOAD_STATE_IDLE &&
+           ++num_steps < APP_CONFIG_MAX_STATE_STEPS);
+}
+
+bool APP_Download_IsRunnable(AppDownloadData* app_download_data) {
+  const AppDownloadData* data = app_download_data;
+  switch (data->state) {
+    case APP_DOWNLOAD_STATE_IDLE:
+    case APP_DOWNLOAD_STATE_WAIT_READ_STORED:
+    case APP_DOWNLOAD_STATE_WAIT_VERIFY:
+      return false;
+    case APP_DOWNLOAD_STATE_RECEIVE:
+      return hasPendingPage(data) ||
+             data->is_storage_failed ||
+             data->is_rejected ||
+             data->is_overrun ||
+             data->is_response_finished ||
+             data->is_response_failed;
+    case APP_DOWNLOAD_STATE_WAIT_RETRY:
+    case APP_DOWNLOAD_STATE_FLUSH:
+      return hasPendingPage(data) ||
+             data->is_storage_failed ||
+             (data->num_flash_operations == 0 &&
+              (data->state == APP_DOWNLOAD_STATE_FLUSH ||
+               APP_Timer_IsExpired(&data->retry_timer)));
+    case APP_DOWNLOAD_STATE_ABORT:
+      return data->num_flash_operations == 0;
+    default:
+      return true;
+  }
+}
+
+bool APP_Download_IsBusy(AppDownloadData* app_download_data) {
+  return app_download_data->state != APP_DOWNLOAD_STATE_IDLE;
+}
+
+bool APP_Download_ToFile(AppDownloadData* app_download_data,
+                         const char* url,
+                         const char* path,
+                         bool resume,
+                         const uint32_t* crc,
+                         const AppDownloadCallbacks* callbacks) {
+  if (APP_Download_IsBusy(app_download_data)) {
+    return false;
+  }
+  app_download_data->target = APP_DOWNLOAD_TARGET_FILE;
+  safe_strncpy(app_download_data->path, path, sizeof(app_download_data->path));
+  app_download_data->is_resume = resume;
+  // Amount of stored data is the size of the file, known once it is opened.
+  return start(app_download_data, url, 0, crc, callbacks);
+}
+
+bool APP_Download_ToFlashRaw(AppDownloadData* app_download_data,
+                             const char* url,
+                             AppFlashRawRegion region,
+                             uint32_t num_bytes_stored,
+                             const uint32_t* crc,
+                             const AppDownloadCallbacks* callbacks) {
+  if (APP_Download_IsBusy(app_download_data)) {
+    return false;
+  }
+  app_download_data->target = APP_DOWNLOAD_TARGET_FLASH_RAW;
+  app_download_data->region = region;
+  return start(app_download_data, url, num_bytes_stored, crc, callbacks);
+}
+
+void APP_Download_SetMaxRate(AppDownloadData* app_download_data,
+                             uint32_t bytes_per_second) {
+  app_download_data->max_rate = bytes_per_second;
+}
+
+void APP_Download_Abort(AppDownloadData* app_download_data) {
+  switch (app_download_data->state) {
+    case APP_DOWNLOAD_STATE_IDLE:
+    case APP_DOWNLOAD_STATE_ABORT:
+      return;
+    default:
+      abortWithError(app_download_data, APP_DOWNLOAD_ERROR_ABORTED);
+      break;
+  }
+}
+
+AppDownloadError APP_Download_Error(AppDownloadData* app_download_data) {
+  return app_download_data->error;
+}
+
+const char* APP_Download_ErrorString(AppDownloadError error) {
+  switch (error) {
+    case APP_DOWNLOAD_ERROR_NONE:
+      return "no error";
+    case APP_DOWNLOAD_ERROR_ABORTED:
+      return "aborted";
+    case APP_DOWNLOAD_ERROR_NETWORK:
+      return "network error";
+    case APP_DOWNLOAD_ERROR_RESPONSE:
+      return "unexpected response";
+    case APP_DOWNLOAD_ERROR_TOO_LARGE:
+      return "resource is too large";
+    case APP_DOWNLOAD_ERROR_STORAGE:
+      return "storage error";
+    case APP_DOWNLOAD_ERROR_INTEGRITY:
+      return "checksum mismatch";
+  }
+  return "unknown error";
+}
+
+uint32_t APP_Download_Throughput(AppDownloadData* app_download_data) {
+  const AppDownloadData* data = app_download_data;
+  if (!data->has_start_time) {
+    return 0;
+  }
+  const uint64_t end_time = APP_Download_IsBusy(app_download_data)
+      ? SYS_TMR_SystemCountGet()
+      : data->end_time;
+  if (end_time <= data->start_time) {
+    return 0;
+  }
+  return (uint64_t)(data->num_bytes_stored - data->num_bytes_resumed) *
+         SYS_TMR_SystemCountFrequencyGet() /
+         (end_time - data->start_time);
+}
+
+int APP_Download_ThrottledPercent(AppDownloadData* app_download_data) {
+  const AppDownloadData* data = app_download_data;
+  if (!data->has_start_time) {
+    return 0;
+  }
+  const uint64_t end_time = APP_Download_IsBusy(app_download_data)
+      ? SYS_TMR_SystemCountGet()
+      : data->end_time;
+  if (end_time <= data->start_time) {
+    return 0;
+  }
+  return data->throttled_time * 100 / (end_time - data->start_time);
+}
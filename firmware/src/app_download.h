@@ -0,0 +1,319 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_DOWNLOAD_H
+#define _APP_DOWNLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "app_flash_raw.h"
+#include "app_https_client.h"
+#include "app_timer.h"
+#include "util_http.h"
+
+// Download of HTTP(S) resources into the serial flash.
+//
+// Body of the response is streamed either into a file on the flash drive or
+// into a raw flash region, without the resource ever being in RAM as a whole.
+// Received bytes are collected into one of two pages: while the full page is
+// being written, the network keeps filling the other one. Once both pages
+// are busy the HTTPS client is asked to leave data in the socket, so the
+// server is throttled by the TCP window instead of bytes being dropped.
+//
+// Raw flash writes are queued and performed in the background, and erase
+// blocks of the region are erased right before the first page which goes
+// into them. File writes are performed from the tasks routine, they are
+// absorbed by the sector cache and programmed from it in the background, see
+// app_flash_cache.h.
+//
+// Interrupted transfer is resumed with a Range request starting at the first
+// byte which is not stored yet. Once the whole body is stored, it is read back
+// and its CRC-32 is compared against the CRC-32 of the received bytes and,
+// if it was given, the expected one.
+
+#define APP_DOWNLOAD_MAX_PATH 64
+
+#if APP_CONFIG_DOWNLOAD_PAGE_SIZE < HTTPS_CLIENT_NETWORK_BUFFER_SIZE
+#  error "Download page must fit the whole network buffer"
+#endif
+
+struct AppEventBus;
+
+typedef uintptr_t AppDownloadFileHandle;
+
+typedef enum {
+  APP_DOWNLOAD_TARGET_FILE,
+  APP_DOWNLOAD_TARGET_FLASH_RAW,
+} AppDownloadTarget;
+
+typedef enum {
+  // Nothing to do.
+  APP_DOWNLOAD_STATE_IDLE,
+  // Open the file, or wait for the raw flash access to become ready.
+  APP_DOWNLOAD_STATE_OPEN,
+  // Read back data which is already stored to get its checksum, when
+  // download is resumed.
+  APP_DOWNLOAD_STATE_READ_STORED,
+  APP_DOWNLOAD_STATE_WAIT_READ_STORED,
+  // Wait for the HTTPS client to become available and submit request.
+  APP_DOWNLOAD_STATE_REQUEST,
+  // Response is being received and stored.
+  APP_DOWNLOAD_STATE_RECEIVE,
+  // Wait for pages which are being written and for the delay before the
+  // request is sent again.
+  APP_DOWNLOAD_STATE_WAIT_RETRY,
+  // Write the last partial page and wait for all writes to finish.
+  APP_DOWNLOAD_STATE_FLUSH,
+  // Read back the stored data and compare its checksum.
+  APP_DOWNLOAD_STATE_VERIFY,
+  APP_DOWNLOAD_STATE_WAIT_VERIFY,
+  // Wait for the HTTPS client to abort the request before reporting the
+  // error.
+  APP_DOWNLOAD_STATE_ABORT,
+} AppDownloadState;
+
+typedef enum {
+  APP_DOWNLOAD_ERROR_NONE,
+  // Download was aborted by the user.
+  APP_DOWNLOAD_ERROR_ABORTED,
+  // Request kept failing without making progress.
+  APP_DOWNLOAD_ERROR_NETWORK,
+  // Server replied with an unexpected status, or the response can not be
+  // stored as a plain sequence of bytes.
+  APP_DOWNLOAD_ERROR_RESPONSE,
+  // Resource does not fit into the raw flash region.
+  APP_DOWNLOAD_ERROR_TOO_LARGE,
+  // Error opening, reading or writing the file or the flash.
+  APP_DOWNLOAD_ERROR_STORAGE,
+  // Data read back does not match the received or the expected checksum.
+  APP_DOWNLOAD_ERROR_INTEGRITY,
+} AppDownloadError;
+
+typedef enum {
+  // Page has room for more data.
+  APP_DOWNLOAD_PAGE_FREE,
+  // Page is complete and waits to be written.
+  APP_DOWNLOAD_PAGE_PENDING,
+  // Page is being written.
+  APP_DOWNLOAD_PAGE_WRITE,
+} AppDownloadPageState;
+
+// Callbacks of the consumer of the downloaded data.
+typedef struct AppDownloadCallbacks {
+  // Invoked with every chunk of the resource once it is stored, in order.
+  //
+  // When download is resumed, the part which is already stored is read back
+  // and passed to it first. Offset of zero means the resource is stored from
+  // the beginning again, for example because the server ignored the range.
+  void (*data_stored)(uint32_t offset,
+                      const uint8_t* data,
+                      uint32_t num_bytes,
+                      void* user_data);
+
+  // Generic storage, is passed to all callback types.
+  void* user_data;
+} AppDownloadCallbacks;
+
+typedef struct AppDownloadPage {
+  AppDownloadPageState state;
+  // Offset of the first byte of the page in the resource.
+  uint32_t offset;
+  uint32_t num_bytes;
+  uint8_t data[APP_CONFIG_DOWNLOAD_PAGE_SIZE];
+} AppDownloadPage;
+
+typedef struct AppDownloadData {
+  AppDownloadState state;
+  // Result of the last finished download.
+  AppDownloadError error;
+
+  AppHTTPSClientData* app_https_client;
+  AppFlashRawData* app_flash_raw;
+  struct AppTimerWheel* app_timer_wheel;
+  struct AppEventBus* app_event_bus;
+
+  // ======== Request ========
+
+  char url[MAX_URL];
+  AppDownloadTarget target;
+  // Full path of the file, for the file target.
+  char path[APP_DOWNLOAD_MAX_PATH];
+  // Continue the existing file instead of overwriting it.
+  bool is_resume;
+  // Region of the flash, for the raw flash target.
+  AppFlashRawRegion region;
+  // Checksum the resource is expected to have.
+  bool has_expected_crc;
+  uint32_t expected_crc;
+  // Maximum rate in bytes per second at which the body is received, zero
+  // if the rate is not limited.
+  uint32_t max_rate;
+
+  AppDownloadFileHandle file_handle;
+  bool is_file_open;
+
+  AppDownloadCallbacks callbacks;
+
+  // ======== Response ========
+
+  HttpResponseScanner scanner;
+  int status_code;
+  bool has_content_length;
+  uint32_t content_length;
+  bool has_content_range;
+  uint32_t range_first;
+  uint32_t range_total;
+  // Offset in the resource of the first byte of the body, and total size of
+  // the resource, zero if not known.
+  uint32_t body_offset;
+  uint32_t total_size;
+  // Response is not a plain sequence of bytes of the resource.
+  bool is_unsupported;
+  // Headers are checked and body is being stored.
+  bool is_body_accepted;
+  // Response is rejected, request is to be aborted.
+  bool is_rejected;
+  // Data was received while both pages were busy.
+  bool is_overrun;
+  // Request is submitted to the HTTPS client and is not finished yet.
+  bool is_request_active;
+  // Callbacks from the HTTPS client, request is over.
+  bool is_response_finished;
+  bool is_response_failed;
+
+  // ======== Progress ========
+
+  // Number of bytes at the beginning of the resource which are stored, and
+  // their checksum.
+  uint32_t num_bytes_stored;
+  uint32_t stored_crc;
+  // Offset in the resource of the next byte to be received.
+  uint32_t num_bytes_received;
+  // Double buffer, fill_page is being filled with received data. Pages are
+  // written in the order they are filled.
+  AppDownloadPage pages[2];
+  uint8_t fill_page;
+  uint8_t write_page;
+  // Storage failed, no more pages are written.
+  bool is_storage_failed;
+  // Number of queued raw flash operations which are not finished yet.
+  int num_flash_operations;
+  // Number of bytes read back by the verification, and their checksum.
+  uint32_t num_bytes_verified;
+  uint32_t verify_crc;
+
+  // Number of failed requests since a request delivered some data.
+  int num_retries;
+  AppTimer retry_timer;
+
+  // ======== Statistics ========
+
+  // Number of bytes stored at the beginning of the download, bytes which are
+  // stored after that are counted towards the throughput.
+  uint32_t num_bytes_resumed;
+  bool has_start_time;
+  // System timer counts when the first byte of the body was received and
+  // when the last page was written.
+  uint64_t start_time;
+  uint64_t end_time;
+  // Time during which the network was throttled because both pages were
+  // busy, in system timer counts.
+  uint64_t throttled_time;
+  uint64_t throttle_start_time;
+  bool is_throttled;
+  uint32_t num_throttles;
+  uint32_t num_resumes;
+} AppDownloadData;
+
+// Initialize download module.
+void APP_Download_Initialize(AppDownloadData* app_download_data,
+                             AppHTTPSClientData* app_https_client,
+                             AppFlashRawData* app_flash_raw,
+                             struct AppTimerWheel* app_timer_wheel,
+                             struct AppEventBus* app_event_bus);
+
+// Perform all download related tasks.
+void APP_Download_Tasks(AppDownloadData* app_download_data);
+
+// Check whether download tasks are to be performed.
+bool APP_Download_IsRunnable(AppDownloadData* app_download_data);
+
+// Check whether download is in progress.
+bool APP_Download_IsBusy(AppDownloadData* app_download_data);
+
+// Download resource into the file with the given full path.
+//
+// If resume is true and the file exists, it is assumed to contain the
+// beginning of the resource and only the rest of it is requested. Otherwise
+// the file is overwritten.
+//
+// Expected checksum is ignored if crc is NULL, callbacks can be NULL as well.
+// Returns false if download is already in progress. Once download is finished
+// APP_EVENT_DOWNLOAD_DONE is posted and the result is available from
+// APP_Download_Error().
+bool APP_Download_ToFile(AppDownloadData* app_download_data,
+                         const char* url,
+                         const char* path,
+                         bool resume,
+                         const uint32_t* crc,
+                         const AppDownloadCallbacks* callbacks);
+
+// Download resource into the raw flash region, starting at its beginning.
+//
+// The first num_bytes_stored bytes of the resource are assumed to be in the
+// region already, from an earlier interrupted download.
+bool APP_Download_ToFlashRaw(AppDownloadData* app_download_data,
+                             const char* url,
+                             AppFlashRawRegion region,
+                             uint32_t num_bytes_stored,
+                             const uint32_t* crc,
+                             const AppDownloadCallbacks* callbacks);
+
+// Limit the rate at which the body of the download in progress is received.
+//
+// Once the limit is reached the HTTPS client is asked to leave data in the
+// socket, same as when the storage is behind. Zero removes the limit, which
+// is the default for every new download.
+void APP_Download_SetMaxRate(AppDownloadData* app_download_data,
+                             uint32_t bytes_per_second);
+
+// Abort download, the error is reported once the request is aborted.
+void APP_Download_Abort(AppDownloadData* app_download_data);
+
+// Result of the last finished download.
+AppDownloadError APP_Download_Error(AppDownloadData* app_download_data);
+
+// Human readable description of the error.
+const char* APP_Download_ErrorString(AppDownloadError error);
+
+// Rate in bytes per second at which data was stored, since the first byte of
+// the body was received until the last page was written (or now, if download
+// is in progress).
+uint32_t APP_Download_Throughput(AppDownloadData* app_download_data);
+
+// Percentage of the download time during which the network was waiting for
+// the storage.
+int APP_Download_ThrottledPercent(AppDownloadData* app_download_data);
+
+#endif  // _APP_DOWNLOAD_H
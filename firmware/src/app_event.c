@@ -0,0 +1,156 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_event.h"
+
+#include <stddef.h>
+
+#include "system_definitions.h"
+
+#define EVENT_QUEUE_MASK (APP_CONFIG_EVENT_QUEUE_SIZE - 1)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+// Get type of the oldest overflowed event.
+//
+// NOTE: Overflow mask is expected to be non-zero.
+static AppEventType oldestOverflowType(const AppEventBus* app_event_bus) {
+  const AppEvent* overflow = app_event_bus->overflow;
+  AppEventType oldest_type = APP_EVENT_NUM_TYPES;
+  int type;
+  for (type = 0; type < APP_EVENT_NUM_TYPES; ++type) {
+    if ((app_event_bus->overflow_mask & APP_EVENT_MASK(type)) == 0) {
+      continue;
+    }
+    if (oldest_type == APP_EVENT_NUM_TYPES ||
+        !APP_Event_IsPostedSince(&overflow[type],
+                                 overflow[oldest_type].sequence)) {
+      oldest_type = (AppEventType)type;
+    }
+  }
+  return oldest_type;
+}
+
+// Pop the oldest event from the queue, followed by the events which did not
+// fit into the queue. Returns false if there are no pending events.
+static bool eventPop(AppEventBus* app_event_bus, AppEvent* event) {
+  bool has_event = false;
+  // NOTE: Interrupts are disabled for the copy, so the slot is not overwritten
+  // by an event posted from the interrupt handler.
+  const SYS_INT_PROCESSOR_STATUS status = SYS_INT_StatusGetAndDisable();
+  if (app_event_bus->tail != app_event_bus->head) {
+    *event = app_event_bus->queue[app_event_bus->tail & EVENT_QUEUE_MASK];
+    ++app_event_bus->tail;
+    has_event = true;
+  } else if (app_event_bus->overflow_mask != 0) {
+    const AppEventType type = oldestOverflowType(app_event_bus);
+    *event = app_event_bus->overflow[type];
+    app_event_bus->overflow_mask &= ~APP_EVENT_MASK(type);
+    has_event = true;
+  }
+  SYS_INT_StatusRestore(status);
+  return has_event;
+}
+
+static void eventDeliver(AppEventBus* app_event_bus, const AppEvent* event) {
+  const uint32_t mask = APP_EVENT_MASK(event->type);
+  int i;
+  for (i = 0; i < app_event_bus->num_subscribers; ++i) {
+    const AppEventSubscriber* subscriber = &app_event_bus->subscribers[i];
+    if (subscriber->mask & mask) {
+      subscriber->callback(event, subscriber->user_data);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_Event_Initialize(AppEventBus* app_event_bus) {
+  app_event_bus->head = 0;
+  app_event_bus->tail = 0;
+  app_event_bus->next_sequence = 0;
+  app_event_bus->overflow_mask = 0;
+  app_event_bus->num_subscribers = 0;
+  app_event_bus->num_coalesced = 0;
+}
+
+void APP_Event_Tasks(AppEventBus* app_event_bus) {
+  AppEvent event;
+  // NOTE: Events posted by the subscribers are delivered in the same call.
+  while (eventPop(app_event_bus, &event)) {
+    eventDeliver(app_event_bus, &event);
+  }
+}
+
+bool APP_Event_HasPending(AppEventBus* app_event_bus) {
+  return app_event_bus->tail != app_event_bus->head ||
+         app_event_bus->overflow_mask != 0;
+}
+
+bool APP_Event_Subscribe(AppEventBus* app_event_bus,
+                         uint32_t mask,
+                         AppEventCallback callback,
+                         void* user_data) {
+  if (app_event_bus->num_subscribers == APP_CONFIG_NUM_EVENT_SUBSCRIBERS) {
+    return false;
+  }
+  AppEventSubscriber* subscriber =
+      &app_event_bus->subscribers[app_event_bus->num_subscribers++];
+  subscriber->mask = mask;
+  subscriber->callback = callback;
+  subscriber->user_data = user_data;
+  return true;
+}
+
+bool APP_Event_Post(AppEventBus* app_event_bus,
+                    AppEventType type,
+                    void* source) {
+  bool is_queued = false;
+  AppEvent* event;
+  const SYS_INT_PROCESSOR_STATUS status = SYS_INT_StatusGetAndDisable();
+  if (app_event_bus->head - app_event_bus->tail < APP_CONFIG_EVENT_QUEUE_SIZE) {
+    event = &app_event_bus->queue[app_event_bus->head & EVENT_QUEUE_MASK];
+    ++app_event_bus->head;
+    is_queued = true;
+  } else {
+    // Replace previously overflowed event of the same type, if any.
+    event = &app_event_bus->overflow[type];
+    app_event_bus->overflow_mask |= APP_EVENT_MASK(type);
+    ++app_event_bus->num_coalesced;
+  }
+  event->type = type;
+  event->source = source;
+  event->sequence = app_event_bus->next_sequence++;
+  SYS_INT_StatusRestore(status);
+  return is_queued;
+}
+
+uint32_t APP_Event_NextSequence(AppEventBus* app_event_bus) {
+  return app_event_bus->next_sequence;
+}
+
+bool APP_Event_IsPostedSince(const AppEvent* event, uint32_t sequence) {
+  // NOTE: Compare difference, so wrap around of the sequence is handled.
+  return (int32_t)(event->sequence - sequence) >= 0;
+}
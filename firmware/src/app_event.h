@@ -0,0 +1,145 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_EVENT_H
+#define _APP_EVENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// Publish/subscribe bus of the completion events.
+//
+// Modules post an event when they are done with the operation, consumers
+// subscribe to the events they are interested in instead of polling busy
+// state of the modules from every main loop iteration.
+//
+// Posting is safe from the interrupt handlers, events are delivered to the
+// subscribers from the main loop in the order they were posted.
+//
+// Events which do not fit into the queue are never dropped, since consumers
+// might be waiting for them and are not woken up otherwise. Instead they are
+// coalesced by type, keeping the source and sequence number of the latest
+// one, and delivered after the events from the queue.
+
+#if (APP_CONFIG_EVENT_QUEUE_SIZE & (APP_CONFIG_EVENT_QUEUE_SIZE - 1)) != 0
+#  error "Event queue size must be power of two"
+#endif
+
+typedef enum {
+  // Download finished, successfully or not.
+  APP_EVENT_DOWNLOAD_DONE,
+  // Firmware update finished downloading the image or applying it,
+  // successfully or not.
+  APP_EVENT_FIRMWARE_UPDATE_DONE,
+  // Flash drive is mounted and ready for use.
+  APP_EVENT_FLASH_DONE,
+  // History finished loading from the flash or reading a page of a query.
+  APP_EVENT_HISTORY_DONE,
+  // HTTP(S) client finished request and is ready for the next one.
+  APP_EVENT_HTTPS_CLIENT_DONE,
+  // Nixie module finished its sequence and is idle.
+  APP_EVENT_NIXIE_DONE,
+  // RTC finished communication over I2C bus.
+  APP_EVENT_RTC_DONE,
+  // Settings were loaded from the flash or changed.
+  APP_EVENT_SETTINGS_CHANGED,
+  // Shift registers finished data transmission.
+  APP_EVENT_SHIFT_REGISTER_DONE,
+
+  APP_EVENT_NUM_TYPES,
+} AppEventType;
+
+// Mask of the events to subscribe to.
+#define APP_EVENT_MASK(type) (1u << (type))
+
+typedef struct AppEvent {
+  AppEventType type;
+  // Descriptor of the module which posted the event.
+  void* source;
+  // Sequence number assigned by the bus, increases with every posted event.
+  uint32_t sequence;
+} AppEvent;
+
+typedef void (*AppEventCallback)(const AppEvent* event, void* user_data);
+
+typedef struct AppEventSubscriber {
+  uint32_t mask;
+  AppEventCallback callback;
+  void* user_data;
+} AppEventSubscriber;
+
+typedef struct AppEventBus {
+  // Queue of events which are not yet delivered.
+  //
+  // NOTE: Indices are free running and are wrapped when accessing the queue.
+  AppEvent queue[APP_CONFIG_EVENT_QUEUE_SIZE];
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t next_sequence;
+
+  // Events which did not fit into the queue, at max one per type.
+  volatile uint32_t overflow_mask;
+  AppEvent overflow[APP_EVENT_NUM_TYPES];
+
+  AppEventSubscriber subscribers[APP_CONFIG_NUM_EVENT_SUBSCRIBERS];
+  int num_subscribers;
+
+  // Number of events which did not fit into the queue.
+  uint32_t num_coalesced;
+} AppEventBus;
+
+// Initialize bus with no subscribers and no pending events.
+void APP_Event_Initialize(AppEventBus* app_event_bus);
+
+// Deliver all pending events to the subscribers.
+void APP_Event_Tasks(AppEventBus* app_event_bus);
+
+// Check whether there are events which are not delivered yet.
+bool APP_Event_HasPending(AppEventBus* app_event_bus);
+
+// Subscribe to events from the given mask.
+//
+// Returns false if there is no room for the new subscriber.
+bool APP_Event_Subscribe(AppEventBus* app_event_bus,
+                         uint32_t mask,
+                         AppEventCallback callback,
+                         void* user_data);
+
+// Post new event, can be called from an interrupt handler.
+//
+// Returns false if the event queue is full and event was coalesced with other
+// events of the same type. It is still delivered to the subscribers.
+bool APP_Event_Post(AppEventBus* app_event_bus,
+                    AppEventType type,
+                    void* source);
+
+// Sequence number which will be assigned to the next posted event.
+//
+// Can be used to ignore events which were posted prior to some operation.
+uint32_t APP_Event_NextSequence(AppEventBus* app_event_bus);
+
+// Check whether event was posted at or after the given sequence number.
+bool APP_Event_IsPostedSince(const AppEvent* event, uint32_t sequence);
+
+#endif  // _APP_EVENT_H
@@ -0,0 +1,581 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_firmware_update.h"
+
+#include <string.h>
+
+#include "app_download.h"
+#include "app_event.h"
+#include "app_flash_raw.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#include "util_crc.h"
+#include "util_string.h"
+
+#define LOG_PREFIX "APP FIRMWARE UPDATE: "
+
+// Regular print / message.
+#define FIRMWARE_UPDATE_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FIRMWARE_UPDATE_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Error print / message.
+#define FIRMWARE_UPDATE_ERROR_PRINT(format, ...) \
+  APP_ERROR_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FIRMWARE_UPDATE_ERROR_MESSAGE(message) \
+  APP_ERROR_MESSAGE(LOG_PREFIX, message)
+// Debug print / message.
+#define FIRMWARE_UPDATE_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FIRMWARE_UPDATE_DEBUG_MESSAGE(message) \
+  APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+// Record magic "NTFW" and offsets of its fields, see the layout in the header.
+#define RECORD_MAGIC 0x5746544eu
+#define RECORD_OFFSET_SEQUENCE 4
+#define RECORD_OFFSET_STATUS 8
+#define RECORD_OFFSET_IMAGE_SIZE 12
+#define RECORD_OFFSET_NUM_BYTES_STORED 16
+#define RECORD_OFFSET_HASH 20
+#define RECORD_OFFSET_URL (RECORD_OFFSET_HASH + APP_FIRMWARE_UPDATE_HASH_SIZE)
+#define RECORD_OFFSET_CRC (RECORD_OFFSET_URL + MAX_URL)
+
+#if RECORD_OFFSET_CRC + 4 > APP_FIRMWARE_UPDATE_RECORD_SIZE
+#  error "Firmware update record does not fit its slot"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static void uint32Encode(uint8_t* data, uint32_t value) {
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t uint32Decode(const uint8_t* data) {
+  return (uint32_t)data[0] |
+         ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) |
+         ((uint32_t)data[3] << 24);
+}
+
+// Round number of bytes down to the erase block of the flash.
+static uint32_t blockRoundDown(AppFirmwareUpdateData* app_firmware_update_data,
+                               uint32_t num_bytes) {
+  const uint32_t erase_block_size =
+      app_firmware_update_data->app_flash_raw->erase_block_size;
+  return num_bytes / erase_block_size * erase_block_size;
+}
+
+////////////////////////////////////////
+// Records.
+
+// Encode current state into the record buffer, with the given sequence.
+static void recordEncode(AppFirmwareUpdateData* app_firmware_update_data,
+                         uint32_t sequence) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  uint8_t* record = data->record;
+  memset(record, 0xff, sizeof(data->record));
+  uint32Encode(record, RECORD_MAGIC);
+  uint32Encode(record + RECORD_OFFSET_SEQUENCE, sequence);
+  uint32Encode(record + RECORD_OFFSET_STATUS, data->status);
+  uint32Encode(record + RECORD_OFFSET_IMAGE_SIZE, data->image_size);
+  uint32Encode(record + RECORD_OFFSET_NUM_BYTES_STORED,
+               data->num_bytes_stored);
+  memcpy(record + RECORD_OFFSET_HASH, data->hash, sizeof(data->hash));
+  memset(record + RECORD_OFFSET_URL, 0, MAX_URL);
+  memcpy(record + RECORD_OFFSET_URL, data->url, strlen(data->url));
+  uint32Encode(record + RECORD_OFFSET_CRC,
+               crc32_update(CRC32_INIT, record, RECORD_OFFSET_CRC));
+}
+
+// Returns false if the slot does not hold a valid record, it's either erased
+// or the write did not finish.
+static bool recordDecode(const uint8_t* record, uint32_t* sequence) {
+  if (uint32Decode(record) != RECORD_MAGIC) {
+    return false;
+  }
+  if (uint32Decode(record + RECORD_OFFSET_CRC) !=
+      crc32_update(CRC32_INIT, record, RECORD_OFFSET_CRC)) {
+    return false;
+  }
+  if (uint32Decode(record + RECORD_OFFSET_STATUS) >
+          APP_FIRMWARE_UPDATE_STATUS_APPLY ||
+      record[RECORD_OFFSET_URL + MAX_URL - 1] != '\0') {
+    return false;
+  }
+  *sequence = uint32Decode(record + RECORD_OFFSET_SEQUENCE);
+  return true;
+}
+
+// Make the record in the buffer the current state.
+static void recordApply(AppFirmwareUpdateData* app_firmware_update_data,
+                        uint32_t sequence) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  const uint8_t* record = data->record;
+  data->sequence = sequence;
+  data->status = uint32Decode(record + RECORD_OFFSET_STATUS);
+  data->image_size = uint32Decode(record + RECORD_OFFSET_IMAGE_SIZE);
+  data->num_bytes_stored =
+      uint32Decode(record + RECORD_OFFSET_NUM_BYTES_STORED);
+  memcpy(data->hash, record + RECORD_OFFSET_HASH, sizeof(data->hash));
+  memcpy(data->url, record + RECORD_OFFSET_URL, MAX_URL);
+}
+
+static void eraseCallback(bool success, void* user_data) {
+  AppFirmwareUpdateData* data = (AppFirmwareUpdateData*)user_data;
+  if (!success) {
+    data->is_write_failed = true;
+  }
+}
+
+static void writeCallback(bool success, void* user_data) {
+  AppFirmwareUpdateData* data = (AppFirmwareUpdateData*)user_data;
+  data->is_writing = false;
+  if (!success || data->is_write_failed) {
+    FIRMWARE_UPDATE_ERROR_PRINT("Error writing record to slot %lu.\r\n",
+                                (unsigned long)data->current_slot);
+    data->is_write_failed = true;
+    // Slot might be partially programmed, continue in the next block.
+    data->current_slot = (data->current_slot / data->slots_per_block + 1) *
+                         data->slots_per_block % data->num_slots;
+    data->is_erase_needed = true;
+    return;
+  }
+  ++data->num_records_written;
+  data->current_slot = (data->current_slot + 1) % data->num_slots;
+  data->is_erase_needed = (data->current_slot % data->slots_per_block == 0);
+}
+
+// Write current state as a new record, if it differs from the last written
+// one. Only one record is written at a time, changes which happen meanwhile
+// are written once it is done.
+static void recordWrite(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  if (!data->is_dirty || data->is_writing) {
+    return;
+  }
+  const uint32_t offset =
+      data->current_slot * APP_FIRMWARE_UPDATE_RECORD_SIZE;
+  data->is_write_failed = false;
+  if (data->is_erase_needed) {
+    const uint32_t erase_block_size = data->app_flash_raw->erase_block_size;
+    if (!APP_FlashRaw_Erase(data->app_flash_raw,
+                            APP_FLASH_RAW_REGION_FIRMWARE_STATE,
+                            offset / erase_block_size * erase_block_size,
+                            erase_block_size,
+                            eraseCallback,
+                            data)) {
+      // Queue is full, try again later.
+      return;
+    }
+    data->is_erase_needed = false;
+  }
+  recordEncode(data, data->sequence + 1);
+  if (!APP_FlashRaw_Write(data->app_flash_raw,
+                          APP_FLASH_RAW_REGION_FIRMWARE_STATE,
+                          offset,
+                          data->record,
+                          sizeof(data->record),
+                          writeCallback,
+                          data)) {
+    // Queue is full, try again later. Block might be erased again, which is
+    // harmless.
+    data->is_erase_needed = true;
+    return;
+  }
+  ++data->sequence;
+  data->is_dirty = false;
+  data->is_writing = true;
+}
+
+////////////////////////////////////////
+// Loading.
+
+static void readCallback(bool success, void* user_data) {
+  AppFirmwareUpdateData* data = (AppFirmwareUpdateData*)user_data;
+  uint32_t sequence;
+  if (!success) {
+    FIRMWARE_UPDATE_ERROR_MESSAGE("Error reading state.\r\n");
+    data->state = APP_FIRMWARE_UPDATE_STATE_ERROR;
+    return;
+  }
+  if (recordDecode(data->record, &sequence)) {
+    if (data->num_records_loaded == 0 || sequence > data->sequence) {
+      recordApply(data, sequence);
+      data->record_slot = data->current_slot;
+    }
+    ++data->num_records_loaded;
+  }
+  ++data->current_slot;
+  data->state = APP_FIRMWARE_UPDATE_STATE_READ_RECORD;
+}
+
+static void waitFlash(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  AppFlashRawData* app_flash_raw = data->app_flash_raw;
+  if (APP_FlashRaw_IsError(app_flash_raw)) {
+    data->state = APP_FIRMWARE_UPDATE_STATE_ERROR;
+    return;
+  }
+  if (!APP_FlashRaw_IsReady(app_flash_raw)) {
+    return;
+  }
+  const uint32_t num_blocks =
+      APP_FlashRaw_RegionSize(app_flash_raw,
+                              APP_FLASH_RAW_REGION_FIRMWARE_STATE) /
+      app_flash_raw->erase_block_size;
+  data->slots_per_block =
+      app_flash_raw->erase_block_size / APP_FIRMWARE_UPDATE_RECORD_SIZE;
+  data->num_slots = num_blocks * data->slots_per_block;
+  if (num_blocks < 2 || data->slots_per_block == 0) {
+    FIRMWARE_UPDATE_ERROR_MESSAGE("State region is too small.\r\n");
+    data->state = APP_FIRMWARE_UPDATE_STATE_ERROR;
+    return;
+  }
+  data->current_slot = 0;
+  data->state = APP_FIRMWARE_UPDATE_STATE_READ_RECORD;
+}
+
+static void readRecord(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  if (data->current_slot == data->num_slots) {
+    // Record after the current one might be torn, so the log continues in
+    // the next block.
+    if (data->num_records_loaded == 0) {
+      data->current_slot = 0;
+    } else {
+      data->current_slot =
+          (data->record_slot / data->slots_per_block + 1) *
+          data->slots_per_block % data->num_slots;
+    }
+    data->is_erase_needed = true;
+    FIRMWARE_UPDATE_PRINT("Firmware image %s, %lu bytes stored.\r\n",
+                          APP_FirmwareUpdate_StatusString(data->status),
+                          (unsigned long)data->num_bytes_stored);
+    data->state = APP_FIRMWARE_UPDATE_STATE_IDLE;
+    return;
+  }
+  if (!APP_FlashRaw_Read(data->app_flash_raw,
+                         APP_FLASH_RAW_REGION_FIRMWARE_STATE,
+                         data->current_slot * APP_FIRMWARE_UPDATE_RECORD_SIZE,
+                         data->record,
+                         sizeof(data->record),
+                         readCallback,
+                         data)) {
+    // Queue is full, try again later.
+    return;
+  }
+  data->state = APP_FIRMWARE_UPDATE_STATE_WAIT_READ_RECORD;
+}
+
+////////////////////////////////////////
+// Download.
+
+static void hashReset(AppFirmwareUpdateData* app_firmware_update_data) {
+  CRYPT_SHA256_Initialize(&app_firmware_update_data->hash_context);
+  app_firmware_update_data->num_bytes_hashed = 0;
+  app_firmware_update_data->is_hash_broken = false;
+}
+
+// Stored chunk of the image, invoked by the download module in order. When
+// download is resumed the stored part is passed first.
+static void dataStoredCallback(uint32_t offset,
+                               const uint8_t* buffer,
+                               uint32_t num_bytes,
+                               void* user_data) {
+  AppFirmwareUpdateData* data = (AppFirmwareUpdateData*)user_data;
+  if (offset == 0 && data->num_bytes_hashed != 0) {
+    // Image is stored from the beginning again, blocks of the checkpoint are
+    // being overwritten.
+    FIRMWARE_UPDATE_DEBUG_MESSAGE("Image is stored from the beginning.\r\n");
+    hashReset(data);
+    if (data->num_bytes_stored != 0) {
+      data->num_bytes_stored = 0;
+      data->is_dirty = true;
+    }
+  }
+  if (offset != data->num_bytes_hashed) {
+    data->is_hash_broken = true;
+    return;
+  }
+  CRYPT_SHA256_DataAdd(&data->hash_context, buffer, num_bytes);
+  data->num_bytes_hashed += num_bytes;
+  const uint32_t checkpoint = blockRoundDown(data, data->num_bytes_hashed);
+  if (checkpoint >= data->num_bytes_stored +
+                    APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL) {
+    data->num_bytes_stored = checkpoint;
+    data->is_dirty = true;
+    ++data->num_checkpoints;
+  }
+}
+
+// Download is finished, check the hash and update the state accordingly.
+static void downloadFinished(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  AppDownloadData* app_download = data->app_download;
+  const AppDownloadError download_error = APP_Download_Error(app_download);
+  data->is_dirty = true;
+  data->state = APP_FIRMWARE_UPDATE_STATE_COMMIT;
+  if (download_error == APP_DOWNLOAD_ERROR_NONE) {
+    uint8_t hash[APP_FIRMWARE_UPDATE_HASH_SIZE];
+    CRYPT_SHA256_Finalize(&data->hash_context, hash);
+    if (data->is_hash_broken ||
+        data->num_bytes_hashed != app_download->num_bytes_stored ||
+        memcmp(hash, data->hash, sizeof(hash)) != 0) {
+      FIRMWARE_UPDATE_ERROR_MESSAGE("Image hash does not match.\r\n");
+      data->error = APP_FIRMWARE_UPDATE_ERROR_HASH;
+      data->status = APP_FIRMWARE_UPDATE_STATUS_NONE;
+      data->num_bytes_stored = 0;
+      return;
+    }
+    FIRMWARE_UPDATE_PRINT("Staged image of %lu bytes.\r\n",
+                          (unsigned long)data->num_bytes_hashed);
+    data->status = APP_FIRMWARE_UPDATE_STATUS_STAGED;
+    data->image_size = data->num_bytes_hashed;
+    data->num_bytes_stored = data->num_bytes_hashed;
+    return;
+  }
+  data->error = APP_FIRMWARE_UPDATE_ERROR_DOWNLOAD;
+  if (download_error == APP_DOWNLOAD_ERROR_INTEGRITY ||
+      data->is_hash_broken) {
+    // Stored data can't be trusted, nothing to resume from.
+    data->num_bytes_stored = 0;
+    return;
+  }
+  // Keep everything which is stored for the next attempt.
+  const uint32_t checkpoint = blockRoundDown(data, data->num_bytes_hashed);
+  if (checkpoint > data->num_bytes_stored) {
+    data->num_bytes_stored = checkpoint;
+    ++data->num_checkpoints;
+  }
+  FIRMWARE_UPDATE_PRINT("Update can be resumed after %lu bytes.\r\n",
+                        (unsigned long)data->num_bytes_stored);
+}
+
+static void download(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  if (!APP_Download_IsBusy(data->app_download)) {
+    downloadFinished(data);
+  }
+  recordWrite(data);
+}
+
+static void commit(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  recordWrite(data);
+  if (data->is_dirty || data->is_writing) {
+    return;
+  }
+  if (data->is_write_failed && data->error == APP_FIRMWARE_UPDATE_ERROR_NONE) {
+    data->error = APP_FIRMWARE_UPDATE_ERROR_STORAGE;
+  }
+  data->state = APP_FIRMWARE_UPDATE_STATE_IDLE;
+  APP_Event_Post(data->app_event_bus,
+                 APP_EVENT_FIRMWARE_UPDATE_DONE,
+                 data);
+}
+
+static void performStep(AppFirmwareUpdateData* app_firmware_update_data) {
+  switch (app_firmware_update_data->state) {
+    case APP_FIRMWARE_UPDATE_STATE_WAIT_READ_RECORD:
+    case APP_FIRMWARE_UPDATE_STATE_ERROR:
+      // Nothing to do.
+      break;
+    case APP_FIRMWARE_UPDATE_STATE_WAIT_FLASH:
+      waitFlash(app_firmware_update_data);
+      break;
+    case APP_FIRMWARE_UPDATE_STATE_READ_RECORD:
+      readRecord(app_firmware_update_data);
+      break;
+    case APP_FIRMWARE_UPDATE_STATE_IDLE:
+      recordWrite(app_firmware_update_data);
+      break;
+    case APP_FIRMWARE_UPDATE_STATE_DOWNLOAD:
+      download(app_firmware_update_data);
+      break;
+    case APP_FIRMWARE_UPDATE_STATE_COMMIT:
+      commit(app_firmware_update_data);
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_FirmwareUpdate_Initialize(
+    AppFirmwareUpdateData* app_firmware_update_data,
+    AppFlashRawData* app_flash_raw,
+    AppDownloadData* app_download,
+    AppEventBus* app_event_bus) {
+  memset(app_firmware_update_data, 0, sizeof(*app_firmware_update_data));
+  app_firmware_update_data->state = APP_FIRMWARE_UPDATE_STATE_WAIT_FLASH;
+  app_firmware_update_data->status = APP_FIRMWARE_UPDATE_STATUS_NONE;
+  app_firmware_update_data->app_flash_raw = app_flash_raw;
+  app_firmware_update_data->app_download = app_download;
+  app_firmware_update_data->app_event_bus = app_event_bus;
+}
+
+void APP_FirmwareUpdate_Tasks(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateState previous_state;
+  int num_steps = 0;
+  do {
+    previous_state = app_firmware_update_data->state;
+    performStep(app_firmware_update_data);
+  } while (app_firmware_update_data->state != previous_state &&
+           ++num_steps < APP_CONFIG_MAX_STATE_STEPS);
+}
+
+bool APP_FirmwareUpdate_IsRunnable(
+    AppFirmwareUpdateData* app_firmware_update_data) {
+  const AppFirmwareUpdateData* data = app_firmware_update_data;
+  const bool is_write_pending = data->is_dirty && !data->is_writing;
+  switch (data->state) {
+    case APP_FIRMWARE_UPDATE_STATE_WAIT_FLASH:
+      return APP_FlashRaw_IsReady(data->app_flash_raw) ||
+             APP_FlashRaw_IsError(data->app_flash_raw);
+    case APP_FIRMWARE_UPDATE_STATE_READ_RECORD:
+      return true;
+    case APP_FIRMWARE_UPDATE_STATE_WAIT_READ_RECORD:
+    case APP_FIRMWARE_UPDATE_STATE_ERROR:
+      return false;
+    case APP_FIRMWARE_UPDATE_STATE_IDLE:
+      return is_write_pending;
+    case APP_FIRMWARE_UPDATE_STATE_DOWNLOAD:
+      return is_write_pending || !APP_Download_IsBusy(data->app_download);
+    case APP_FIRMWARE_UPDATE_STATE_COMMIT:
+      return !data->is_writing;
+  }
+  return false;
+}
+
+bool APP_FirmwareUpdate_IsBusy(
+    AppFirmwareUpdateData* app_firmware_update_data) {
+  const AppFirmwareUpdateData* data = app_firmware_update_data;
+  switch (data->state) {
+    case APP_FIRMWARE_UPDATE_STATE_IDLE:
+      return data->is_dirty || data->is_writing;
+    case APP_FIRMWARE_UPDATE_STATE_ERROR:
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool APP_FirmwareUpdate_Start(
+    AppFirmwareUpdateData* app_firmware_update_data,
+    const char* url,
+    const uint8_t hash[APP_FIRMWARE_UPDATE_HASH_SIZE]) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  if (data->state != APP_FIRMWARE_UPDATE_STATE_IDLE ||
+      APP_Download_IsBusy(data->app_download)) {
+    return false;
+  }
+  const bool is_resume =
+      data->status == APP_FIRMWARE_UPDATE_STATUS_DOWNLOADING &&
+      STREQ(data->url, url) &&
+      memcmp(data->hash, hash, sizeof(data->hash)) == 0;
+  if (!is_resume) {
+    data->status = APP_FIRMWARE_UPDATE_STATUS_DOWNLOADING;
+    data->image_size = 0;
+    data->num_bytes_stored = 0;
+    memcpy(data->hash, hash, sizeof(data->hash));
+    safe_strncpy(data->url, url, sizeof(data->url));
+    data->is_dirty = true;
+  }
+  hashReset(data);
+  AppDownloadCallbacks callbacks;
+  callbacks.data_stored = dataStoredCallback;
+  callbacks.user_data = data;
+  if (!APP_Download_ToFlashRaw(data->app_download,
+                               data->url,
+                               APP_FLASH_RAW_REGION_FIRMWARE,
+                               data->num_bytes_stored,
+                               NULL,
+                               &callbacks)) {
+    return false;
+  }
+  APP_Download_SetMaxRate(data->app_download,
+                          APP_CONFIG_FIRMWARE_UPDATE_MAX_RATE);
+  if (is_resume) {
+    FIRMWARE_UPDATE_PRINT("Resuming update after %lu bytes.\r\n",
+                          (unsigned long)data->num_bytes_stored);
+  }
+  data->error = APP_FIRMWARE_UPDATE_ERROR_NONE;
+  data->state = APP_FIRMWARE_UPDATE_STATE_DOWNLOAD;
+  return true;
+}
+
+bool APP_FirmwareUpdate_Apply(AppFirmwareUpdateData* app_firmware_update_data) {
+  AppFirmwareUpdateData* data = app_firmware_update_data;
+  if (data->state != APP_FIRMWARE_UPDATE_STATE_IDLE ||
+      data->status != APP_FIRMWARE_UPDATE_STATUS_STAGED) {
+    return false;
+  }
+  data->status = APP_FIRMWARE_UPDATE_STATUS_APPLY;
+  data->is_dirty = true;
+  data->error = APP_FIRMWARE_UPDATE_ERROR_NONE;
+  data->state = APP_FIRMWARE_UPDATE_STATE_COMMIT;
+  return true;
+}
+
+void APP_FirmwareUpdate_Abort(AppFirmwareUpdateData* app_firmware_update_data) {
+  if (app_firmware_update_data->state == APP_FIRMWARE_UPDATE_STATE_DOWNLOAD) {
+    APP_Download_Abort(app_firmware_update_data->app_download);
+  }
+}
+
+AppFirmwareUpdateError APP_FirmwareUpdate_Error(
+    AppFirmwareUpdateData* app_firmware_update_data) {
+  return app_firmware_update_data->error;
+}
+
+const char* APP_FirmwareUpdate_ErrorString(AppFirmwareUpdateError error) {
+  switch (error) {
+    case APP_FIRMWARE_UPDATE_ERROR_NONE:
+      return "no error";
+    case APP_FIRMWARE_UPDATE_ERROR_DOWNLOAD:
+      return "download failed";
+    case APP_FIRMWARE_UPDATE_ERROR_HASH:
+      return "hash mismatch";
+    case APP_FIRMWARE_UPDATE_ERROR_STORAGE:
+      return "storage error";
+  }
+  return "unknown error";
+}
+
+const char* APP_FirmwareUpdate_StatusString(AppFirmwareUpdateStatus status) {
+  switch (status) {
+    case APP_FIRMWARE_UPDATE_STATUS_NONE:
+      return "none";
+    case APP_FIRMWARE_UPDATE_STATUS_DOWNLOADING:
+      return "downloading";
+    case APP_FIRMWARE_UPDATE_STATUS_STAGED:
+      return "staged";
+    case APP_FIRMWARE_UPDATE_STATUS_APPLY:
+      return "apply";
+  }
+  return "unknown";
+}
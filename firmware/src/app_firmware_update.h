@@ -0,0 +1,217 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_FIRMWARE_UPDATE_H
+#define _APP_FIRMWARE_UPDATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "app_https_client.h"
+#include "crypto/crypto.h"
+
+// Firmware update over the network.
+//
+// Image is streamed by the download module into the firmware region of the
+// serial flash, see app_flash_raw.h, and never is in RAM as a whole. SHA-256
+// of the image is computed incrementally from every page once it is stored,
+// and is compared against the expected one when the download is finished.
+//
+// Progress is recorded in the firmware state region as a log of fixed size
+// records, the valid record with the highest sequence number is the current
+// state. While the image is being downloaded a checkpoint record is written
+// every APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL bytes, so update of
+// the same image which is started after a reboot only requests the part
+// which is not stored yet. The stored part is read back to restore the hash.
+//
+// Hand-off to the bootloader: once the image is staged and applied, the
+// current record has APP_FIRMWARE_UPDATE_STATUS_APPLY status. On the next
+// boot the bootloader copies image_size bytes of the firmware region into
+// the program flash, checks their SHA-256 against the record and appends a
+// record with APP_FIRMWARE_UPDATE_STATUS_NONE status.
+//
+// Record layout, little endian:
+//
+//   0   magic "NTFW"
+//   4   sequence number
+//   8   status, AppFirmwareUpdateStatus
+//   12  image size, zero until the image is staged
+//   16  number of bytes of the image which are stored
+//   20  SHA-256 of the image
+//   52  URL of the image, null-padded
+//   180 CRC-32 of all the preceding bytes
+//
+// Records never cross erase block boundary. Log continues after the last
+// record in the same block only if the record was written since the boot,
+// otherwise the next block is erased first, so the record which might have
+// been torn by a power loss is never programmed over.
+
+#define APP_FIRMWARE_UPDATE_RECORD_SIZE 256
+
+#define APP_FIRMWARE_UPDATE_HASH_SIZE CRYPT_SHA256_DIGEST_SIZE
+
+struct AppDownloadData;
+struct AppEventBus;
+struct AppFlashRawData;
+
+typedef enum {
+  // There is no image in the staging area.
+  APP_FIRMWARE_UPDATE_STATUS_NONE,
+  // Image is being downloaded, stored part of it is valid.
+  APP_FIRMWARE_UPDATE_STATUS_DOWNLOADING,
+  // Whole image is stored and its hash matches.
+  APP_FIRMWARE_UPDATE_STATUS_STAGED,
+  // Image is to be programmed by the bootloader on the next boot.
+  APP_FIRMWARE_UPDATE_STATUS_APPLY,
+} AppFirmwareUpdateStatus;
+
+typedef enum {
+  // Wait for the raw flash access to become ready.
+  APP_FIRMWARE_UPDATE_STATE_WAIT_FLASH,
+  // Read all records of the log to find the current one.
+  APP_FIRMWARE_UPDATE_STATE_READ_RECORD,
+  APP_FIRMWARE_UPDATE_STATE_WAIT_READ_RECORD,
+  // Nothing to do.
+  APP_FIRMWARE_UPDATE_STATE_IDLE,
+  // Image is being downloaded.
+  APP_FIRMWARE_UPDATE_STATE_DOWNLOAD,
+  // Wait for the record with the result to be written.
+  APP_FIRMWARE_UPDATE_STATE_COMMIT,
+  // Flash is not usable.
+  APP_FIRMWARE_UPDATE_STATE_ERROR,
+} AppFirmwareUpdateState;
+
+typedef enum {
+  APP_FIRMWARE_UPDATE_ERROR_NONE,
+  // Download of the image failed, see APP_Download_Error().
+  APP_FIRMWARE_UPDATE_ERROR_DOWNLOAD,
+  // Hash of the image does not match the expected one.
+  APP_FIRMWARE_UPDATE_ERROR_HASH,
+  // Error reading or writing the state records.
+  APP_FIRMWARE_UPDATE_ERROR_STORAGE,
+} AppFirmwareUpdateError;
+
+typedef struct AppFirmwareUpdateData {
+  AppFirmwareUpdateState state;
+  // Result of the last finished operation.
+  AppFirmwareUpdateError error;
+
+  struct AppFlashRawData* app_flash_raw;
+  struct AppDownloadData* app_download;
+  struct AppEventBus* app_event_bus;
+
+  // ======== Current state ========
+
+  AppFirmwareUpdateStatus status;
+  uint32_t sequence;
+  uint32_t image_size;
+  // Number of bytes of the image which are stored according to the last
+  // checkpoint, always a multiple of the erase block size, except for the
+  // staged image.
+  uint32_t num_bytes_stored;
+  uint8_t hash[APP_FIRMWARE_UPDATE_HASH_SIZE];
+  char url[MAX_URL];
+
+  // ======== Log ========
+
+  // Geometry of the log, in records.
+  uint32_t num_slots;
+  uint32_t slots_per_block;
+  // Slot which is being read, or where the next record is written.
+  uint32_t current_slot;
+  // Slot of the current record, valid once at least one record is loaded.
+  uint32_t record_slot;
+  // Block of the next slot is to be erased before it is written.
+  bool is_erase_needed;
+  // Current state differs from the last record which is written.
+  bool is_dirty;
+  // Record is being written.
+  bool is_writing;
+  bool is_write_failed;
+  // Record which is being read or written.
+  uint8_t record[APP_FIRMWARE_UPDATE_RECORD_SIZE];
+
+  // ======== Download ========
+
+  // Incremental hash of the stored part of the image.
+  CRYPT_SHA256_CTX hash_context;
+  uint32_t num_bytes_hashed;
+  // Stored data did not arrive in order, hash is not usable.
+  bool is_hash_broken;
+
+  // ======== Statistics ========
+
+  uint32_t num_records_loaded;
+  uint32_t num_records_written;
+  uint32_t num_checkpoints;
+} AppFirmwareUpdateData;
+
+// Initialize firmware update, state is loaded as soon as the flash is ready.
+void APP_FirmwareUpdate_Initialize(
+    AppFirmwareUpdateData* app_firmware_update_data,
+    struct AppFlashRawData* app_flash_raw,
+    struct AppDownloadData* app_download,
+    struct AppEventBus* app_event_bus);
+
+// Perform all firmware update related tasks.
+void APP_FirmwareUpdate_Tasks(AppFirmwareUpdateData* app_firmware_update_data);
+
+// Check whether firmware update tasks are to be performed.
+bool APP_FirmwareUpdate_IsRunnable(
+    AppFirmwareUpdateData* app_firmware_update_data);
+
+// Check whether state is being loaded, image is being downloaded or the
+// record is being written.
+bool APP_FirmwareUpdate_IsBusy(AppFirmwareUpdateData* app_firmware_update_data);
+
+// Download the image with the given expected SHA-256 into the staging area.
+//
+// If the current record is a checkpoint of the same image, download resumes
+// from it. Download rate is limited to APP_CONFIG_FIRMWARE_UPDATE_MAX_RATE.
+// Returns false if the module or the download module is busy. Once the image
+// is staged or the update fails and the resulting record is written,
+// APP_EVENT_FIRMWARE_UPDATE_DONE is posted.
+bool APP_FirmwareUpdate_Start(
+    AppFirmwareUpdateData* app_firmware_update_data,
+    const char* url,
+    const uint8_t hash[APP_FIRMWARE_UPDATE_HASH_SIZE]);
+
+// Mark the staged image to be programmed by the bootloader.
+//
+// Returns false if there is no staged image. APP_EVENT_FIRMWARE_UPDATE_DONE
+// is posted once the record is written, after that the device is to be
+// reset.
+bool APP_FirmwareUpdate_Apply(AppFirmwareUpdateData* app_firmware_update_data);
+
+// Abort the download, the checkpoint is kept so it can be resumed later.
+void APP_FirmwareUpdate_Abort(AppFirmwareUpdateData* app_firmware_update_data);
+
+// Result of the last finished operation.
+AppFirmwareUpdateError APP_FirmwareUpdate_Error(
+    AppFirmwareUpdateData* app_firmware_update_data);
+
+// Human readable description of the error and of the status.
+const char* APP_FirmwareUpdate_ErrorString(AppFirmwareUpdateError error);
+const char* APP_FirmwareUpdate_StatusString(AppFirmwareUpdateStatus status);
+
+#endif  // _APP_FIRMWARE_UPDATE_H
@@ -22,6 +22,9 @@
 
 #include "app_flash.h"
 
+#include "app_event.h"
+#include "app_flash_cache.h"
+#include "app_flash_raw.h"
 #include "system_objects.h"
 #include "utildefines.h"
 
@@ -40,7 +43,14 @@
 #define FLASH_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
 
 #define FLASH_DEVICE_NAME  "/dev/mtda1"
-#define FLASH_MOUNT_POINT  "/mnt/sst25_drive"
+
+// Delay in milliseconds before the mount is attempted again. It is doubled
+// after every failure, up to the maximum.
+#define MOUNT_RETRY_INTERVAL_MIN 100
+#define MOUNT_RETRY_INTERVAL_MAX (10 * 1000)
+
+// Step of the format progress in percents which is reported to the log.
+#define FORMAT_PROGRESS_REPORT_STEP 10
 
 // Get driver handle from the application data.
 //
@@ -50,27 +60,266 @@ static SYS_MODULE_OBJ flash_driver_get(AppFlashData* app_flash_data) {
   return app_flash_data->system_objects->global_objects->drvSst25Obj0;
 }
 
+// Maximum number of regions in the geometry table: read, write and erase.
+#define MAX_GEOMETRY_REGIONS 3
+
+// Geometry of the flash as it is seen by the file system.
+static SYS_FS_MEDIA_GEOMETRY fs_geometry;
+static SYS_FS_MEDIA_REGION_GEOMETRY fs_geometry_table[MAX_GEOMETRY_REGIONS];
+
+// Wrapper around driver's geometry query which hides erase blocks at the end
+// of the flash which are reserved for raw access (see app_flash_raw.h), so
+// the file system never touches them.
+static SYS_FS_MEDIA_GEOMETRY* sst25GeometryGet(const DRV_HANDLE handle) {
+  const SYS_FS_MEDIA_GEOMETRY* geometry = DRV_SST25_GeometryGet(handle);
+  if (geometry == NULL) {
+    return NULL;
+  }
+  const uint32_t num_regions = geometry->numReadRegions +
+                               geometry->numWriteRegions +
+                               geometry->numEraseRegions;
+  if (num_regions != MAX_GEOMETRY_REGIONS) {
+    FLASH_ERROR_PRINT("Unexpected number of geometry regions %u.\r\n",
+                      num_regions);
+    return NULL;
+  }
+  fs_geometry = *geometry;
+  fs_geometry.geometryTable = fs_geometry_table;
+  // Erase region goes last, its block size defines reserved size.
+  const uint32_t reserved_size =
+      APP_FLASH_RAW_NUM_RESERVED_BLOCKS *
+      geometry->geometryTable[num_regions - 1].blockSize;
+  uint32_t i;
+  for (i = 0; i < num_regions; ++i) {
+    const SYS_FS_MEDIA_REGION_GEOMETRY* region = &geometry->geometryTable[i];
+    const uint32_t num_reserved_blocks = reserved_size / region->blockSize;
+    fs_geometry_table[i].blockSize = region->blockSize;
+    fs_geometry_table[i].numBlocks =
+        (region->numBlocks > num_reserved_blocks)
+            ? region->numBlocks - num_reserved_blocks
+            : 0;
+  }
+  return &fs_geometry;
+}
+
+// Reads, writes and erases go through the sector cache, see
+// app_flash_cache.h.
 static const SYS_FS_MEDIA_FUNCTIONS sst25_media_functions = {
   .mediaStatusGet     = DRV_SST25_MediaIsAttached,
-  .mediaGeometryGet   = DRV_SST25_GeometryGet,
-  .sectorRead         = DRV_SST25_BlockRead,
-  .sectorWrite        = DRV_SST25_BlockEraseWrite,
-  .eventHandlerset    = DRV_SST25_BlockEventHandlerSet,
-  .commandStatusGet   = (void *)DRV_SST25_CommandStatus,
-  .Read               = DRV_SST25_BlockRead,
-  .erase              = DRV_SST25_BlockErase,
+  .mediaGeometryGet   = sst25GeometryGet,
+  .sectorRead         = APP_FlashCache_MediaRead,
+  .sectorWrite        = APP_FlashCache_MediaWrite,
+  .eventHandlerset    = APP_FlashCache_MediaEventHandlerSet,
+  .commandStatusGet   = (void *)APP_FlashCache_MediaCommandStatus,
+  .Read               = APP_FlashCache_MediaRead,
+  .erase              = APP_FlashCache_MediaErase,
   .addressGet         = DRV_SST25_AddressGet,
   .open               = DRV_SST25_Open,
   .close              = DRV_SST25_Close,
-  .tasks              = DRV_SST25_Tasks,
+  .tasks              = APP_FlashCache_MediaTasks,
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static void failed(AppFlashData* app_flash_data) {
+  app_flash_data->state = APP_FLASH_STATE_ERROR;
+  // Let command tasks which are waiting for the flash know it gave up.
+  APP_Event_Post(app_flash_data->app_event_bus,
+                 APP_EVENT_FLASH_DONE,
+                 app_flash_data);
+}
+
+////////////////////////////////////////
+// Mount.
+
+static void mountDisk(AppFlashData* app_flash_data) {
+  if (APP_Timer_IsArmed(&app_flash_data->mount_timer)) {
+    return;
+  }
+  ++app_flash_data->num_mount_attempts;
+  if (SYS_FS_Mount(FLASH_DEVICE_NAME, APP_FLASH_MOUNT_POINT,
+                   FAT, 0, NULL) != SYS_FS_RES_SUCCESS) {
+    FLASH_DEBUG_PRINT("Mount failed, will try again in %u ms.\r\n",
+                      app_flash_data->mount_retry_interval);
+    // The disk could not be mounted. Try mounting again until the operation
+    // succeeds, without hammering the media manager.
+    APP_Timer_Start(app_flash_data->app_timer_wheel,
+                    &app_flash_data->mount_timer,
+                    app_flash_data->mount_retry_interval);
+    app_flash_data->mount_retry_interval *= 2;
+    if (app_flash_data->mount_retry_interval > MOUNT_RETRY_INTERVAL_MAX) {
+      app_flash_data->mount_retry_interval = MOUNT_RETRY_INTERVAL_MAX;
+    }
+    return;
+  }
+  FLASH_PRINT("Disk %s mounted on %s after %u attempt(s).\r\n",
+              FLASH_DEVICE_NAME, APP_FLASH_MOUNT_POINT,
+              app_flash_data->num_mount_attempts);
+  app_flash_data->mount_retry_interval = MOUNT_RETRY_INTERVAL_MIN;
+  app_flash_data->num_mount_attempts = 0;
+  app_flash_data->state = APP_FLASH_STATE_ENSURE_FORMATTED;
+}
+
+////////////////////////////////////////
+// Format.
+
+// Number of sectors of the media which are available to the file system.
+static uint32_t fsNumMediaSectors(void) {
+  // Read region goes first.
+  const SYS_FS_MEDIA_REGION_GEOMETRY* region = &fs_geometry_table[0];
+  return region->numBlocks * region->blockSize / FAT_SECTOR_SIZE;
+}
+
+// Schedule format of the drive, unless it was already attempted.
+static void formatRequired(AppFlashData* app_flash_data) {
+  if (app_flash_data->format_attempted) {
+    FLASH_ERROR_MESSAGE("Drive formate was already attempted but "
+                        "failed, will not try again.\r\n");
+    failed(app_flash_data);
+    return;
+  }
+  FLASH_MESSAGE("Will perform drive format.\r\n");
+  app_flash_data->format_attempted = true;
+  app_flash_data->state = APP_FLASH_STATE_FORMAT;
+}
+
+static uint32_t formatNumSteps(const AppFlashData* app_flash_data) {
+  return app_flash_data->format_num_blocks + app_flash_data->format_num_pages;
+}
+
+static void formatReportProgress(AppFlashData* app_flash_data) {
+  const int progress = APP_Flash_FormatProgress(app_flash_data);
+  if (progress - app_flash_data->format_reported_progress >=
+      FORMAT_PROGRESS_REPORT_STEP) {
+    FLASH_PRINT("Format progress: %d%%.\r\n", progress);
+    app_flash_data->format_reported_progress = progress;
+  }
+}
+
+static void formatBegin(AppFlashData* app_flash_data) {
+  AppFlashRawData* app_flash_raw = app_flash_data->app_flash_raw;
+  if (APP_FlashRaw_IsError(app_flash_raw)) {
+    FLASH_ERROR_MESSAGE("Raw flash is not usable, can not format.\r\n");
+    failed(app_flash_data);
+    return;
+  }
+  if (!APP_FlashRaw_IsReady(app_flash_raw) ||
+      APP_FlashCache_IsBusy(app_flash_data->app_flash_cache)) {
+    return;
+  }
+  // NOTE: Unmount fails if the drive is not mounted, which is fine.
+  SYS_FS_Unmount(APP_FLASH_MOUNT_POINT);
+  // Format goes around the file system, whatever is cached belongs to the
+  // old volume.
+  APP_FlashCache_Invalidate(app_flash_data->app_flash_cache);
+  const uint32_t region_size =
+      APP_FlashRaw_RegionSize(app_flash_raw, APP_FLASH_RAW_REGION_FILE_SYSTEM);
+  const uint32_t erase_block_size = app_flash_raw->erase_block_size;
+  const uint32_t write_block_size = app_flash_raw->write_block_size;
+  if (FAT_SECTOR_SIZE % write_block_size != 0 ||
+      !fat_volume_layout(region_size / FAT_SECTOR_SIZE,
+                         (uint32_t)SYS_TMR_SystemCountGet(),
+                         &app_flash_data->format_volume)) {
+    FLASH_ERROR_MESSAGE("Flash geometry is not supported by format.\r\n");
+    failed(app_flash_data);
+    return;
+  }
+  const uint32_t num_system_bytes =
+      fat_volume_num_system_sectors(&app_flash_data->format_volume) *
+      FAT_SECTOR_SIZE;
+  app_flash_data->format_num_blocks =
+      (num_system_bytes + erase_block_size - 1) / erase_block_size;
+  app_flash_data->format_num_pages = num_system_bytes / write_block_size;
+  app_flash_data->format_step = 0;
+  app_flash_data->format_reported_progress = 0;
+  FLASH_PRINT("Formatting %u sectors as FAT%d, %u erases and %u writes.\r\n",
+              app_flash_data->format_volume.num_sectors,
+              app_flash_data->format_volume.fat_bits,
+              app_flash_data->format_num_blocks,
+              app_flash_data->format_num_pages);
+  app_flash_data->state = APP_FLASH_STATE_FORMAT_ERASE;
+}
+
+static void formatCallback(bool success, void* user_data) {
+  AppFlashData* app_flash_data = (AppFlashData*)user_data;
+  if (!success) {
+    FLASH_ERROR_MESSAGE("Error formatting the drive.\r\n");
+    failed(app_flash_data);
+    return;
+  }
+  ++app_flash_data->format_step;
+  formatReportProgress(app_flash_data);
+  if (app_flash_data->format_step < app_flash_data->format_num_blocks) {
+    app_flash_data->state = APP_FLASH_STATE_FORMAT_ERASE;
+  } else if (app_flash_data->format_step < formatNumSteps(app_flash_data)) {
+    app_flash_data->state = APP_FLASH_STATE_FORMAT_WRITE;
+  } else {
+    FLASH_MESSAGE("Drive is formatted, verifying...\r\n");
+    app_flash_data->state = APP_FLASH_STATE_MOUNT_DISK;
+  }
+}
+
+static void formatErase(AppFlashData* app_flash_data) {
+  AppFlashRawData* app_flash_raw = app_flash_data->app_flash_raw;
+  const uint32_t erase_block_size = app_flash_raw->erase_block_size;
+  if (APP_FlashRaw_Erase(app_flash_raw,
+                         APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                         app_flash_data->format_step * erase_block_size,
+                         erase_block_size,
+                         formatCallback,
+                         app_flash_data)) {
+    app_flash_data->state = APP_FLASH_STATE_FORMAT_WAIT_ERASE;
+  }
+}
+
+static void formatWrite(AppFlashData* app_flash_data) {
+  AppFlashRawData* app_flash_raw = app_flash_data->app_flash_raw;
+  const uint32_t write_block_size = app_flash_raw->write_block_size;
+  const uint32_t page =
+      app_flash_data->format_step - app_flash_data->format_num_blocks;
+  const uint32_t offset = page * write_block_size;
+  if (offset % FAT_SECTOR_SIZE == 0) {
+    fat_volume_system_sector(&app_flash_data->format_volume,
+                             offset / FAT_SECTOR_SIZE,
+                             app_flash_data->format_sector);
+  }
+  if (APP_FlashRaw_Write(app_flash_raw,
+                         APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                         offset,
+                         app_flash_data->format_sector +
+                             offset % FAT_SECTOR_SIZE,
+                         write_block_size,
+                         formatCallback,
+                         app_flash_data)) {
+    app_flash_data->state = APP_FLASH_STATE_FORMAT_WAIT_WRITE;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
 void APP_Flash_Initialize(AppFlashData* app_flash_data,
-                          SystemObjects* system_objects) {
+                          SystemObjects* system_objects,
+                          AppFlashCacheData* app_flash_cache,
+                          AppFlashRawData* app_flash_raw,
+                          AppTimerWheel* app_timer_wheel,
+                          AppEventBus* app_event_bus) {
   // TODO(sergey): Think about passing explicit flash handle.
   app_flash_data->system_objects = system_objects;
+  app_flash_data->app_flash_cache = app_flash_cache;
+  app_flash_data->app_flash_raw = app_flash_raw;
+  app_flash_data->app_timer_wheel = app_timer_wheel;
+  app_flash_data->app_event_bus = app_event_bus;
   app_flash_data->state = APP_FLASH_STATE_REGISTER_MEDIA;
   app_flash_data->format_attempted = false;
+  app_flash_data->is_media_registered = false;
+  APP_Timer_Setup(&app_flash_data->mount_timer, NULL, NULL);
+  app_flash_data->mount_retry_interval = MOUNT_RETRY_INTERVAL_MIN;
+  app_flash_data->num_mount_attempts = 0;
+  app_flash_data->format_num_blocks = 0;
+  app_flash_data->format_num_pages = 0;
+  app_flash_data->format_step = 0;
 }
 
 void APP_Flash_Tasks(AppFlashData* app_flash_data) {
@@ -85,76 +334,68 @@ void APP_Flash_Tasks(AppFlashData* app_flash_data) {
             SYS_FS_MEDIA_TYPE_SPIFLASH) != SYS_FS_MEDIA_HANDLE_INVALID) {
           FLASH_MESSAGE("Registered SST25 flash in file system "
                         "media manager.\r\n");
+          app_flash_data->is_media_registered = true;
           app_flash_data->state = APP_FLASH_STATE_MOUNT_DISK;
         } else {
           FLASH_MESSAGE("Failure registering SST25 flash in "
                         "file system media manager!\r\n");
-          app_flash_data->state = APP_FLASH_STATE_ERROR;
+          failed(app_flash_data);
         }
       }
       break;
     }
 
-    case APP_FLASH_STATE_MOUNT_DISK: {
-      if (SYS_FS_Mount(FLASH_DEVICE_NAME, FLASH_MOUNT_POINT, 
-                       FAT, 0, NULL) != SYS_FS_RES_SUCCESS) {
-        FLASH_DEBUG_MESSAGE("Mount failed, will try again later.\r\n");
-        // The disk could not be mounted. Try mounting again until
-        // the operation succeeds.
-        app_flash_data->state = APP_FLASH_STATE_MOUNT_DISK;
-      } else {
-        // Mount was successful. Format the disk. */
-        FLASH_PRINT("Disk %s mounted on %s.\r\n",
-                    FLASH_DEVICE_NAME, FLASH_MOUNT_POINT);
-        app_flash_data->state = APP_FLASH_STATE_ENSURE_FORMATTED;
-      }
+    case APP_FLASH_STATE_MOUNT_DISK:
+      mountDisk(app_flash_data);
       break;
-    }
 
     case APP_FLASH_STATE_ENSURE_FORMATTED: {
-      // SYS_MODULE_OBJ flash = flash_driver_get(app_flash_data);
       uint32_t total_sectors, free_sectors;
-      if (SYS_FS_DriveSectorGet(FLASH_MOUNT_POINT,
+      if (SYS_FS_DriveSectorGet(APP_FLASH_MOUNT_POINT,
                                 &total_sectors,
                                 &free_sectors) != SYS_FS_RES_SUCCESS) {
         FLASH_ERROR_MESSAGE("Failed to query drive sector information.\r\n");
-        app_flash_data->state = APP_FLASH_STATE_ERROR;
+        failed(app_flash_data);
       } else {
         FLASH_PRINT("Drive has %d total sectors, %d free sectors.\r\n",
                     total_sectors, free_sectors);
         if (total_sectors == 0) {
           FLASH_MESSAGE("Drive does not seems to be formatted.\r\n");
-          if (app_flash_data->format_attempted) {
-            FLASH_ERROR_MESSAGE("Drive formate was already attempted but "
-                                "failed, will not try again.\r\n");
-            app_flash_data->state = APP_FLASH_STATE_ERROR;
-          } else {
-            FLASH_MESSAGE("Will perform drive format.\r\n");
-            app_flash_data->state = APP_FLASH_STATE_FORMAT;
-          }
+          formatRequired(app_flash_data);
+        } else if (total_sectors > fsNumMediaSectors()) {
+          // Volume was created before the raw regions were reserved, and
+          // it would be corrupted by writes to them.
+          FLASH_PRINT("Drive is bigger than %u sectors available to the file "
+                      "system.\r\n",
+                      fsNumMediaSectors());
+          formatRequired(app_flash_data);
         } else {
           FLASH_MESSAGE("Drive appears to be properly formatted.\r\n");
           app_flash_data->state = APP_FLASH_STATE_IDLE;
+          APP_Event_Post(app_flash_data->app_event_bus,
+                         APP_EVENT_FLASH_DONE,
+                         app_flash_data);
         }
       }
       break;
     }
 
-    case APP_FLASH_STATE_FORMAT: {
-      FLASH_MESSAGE("Formatting the drive.\r\n");
-      app_flash_data->format_attempted = 1;
-      if (SYS_FS_DriveFormat(FLASH_MOUNT_POINT,
-                             SYS_FS_FORMAT_SFD,
-                             0) != SYS_FS_RES_SUCCESS) {
-        /* Format of the disk failed. */
-        FLASH_ERROR_MESSAGE("Error formatting the drive.\r\n");
-        app_flash_data->state = APP_FLASH_STATE_ERROR;
-      } else {
-        app_flash_data->state = APP_FLASH_STATE_ENSURE_FORMATTED;
-        FLASH_MESSAGE("Drive is formatted, verifying...\r\n");
-      }
+    case APP_FLASH_STATE_FORMAT:
+      formatBegin(app_flash_data);
+      break;
+
+    case APP_FLASH_STATE_FORMAT_ERASE:
+      formatErase(app_flash_data);
+      break;
+
+    case APP_FLASH_STATE_FORMAT_WRITE:
+      formatWrite(app_flash_data);
+      break;
+
+    case APP_FLASH_STATE_FORMAT_WAIT_ERASE:
+    case APP_FLASH_STATE_FORMAT_WAIT_WRITE:
+      // Waiting for the raw flash callback.
       break;
-    }
 
     case APP_FLASH_STATE_IDLE:
       // Nothing to do.
@@ -162,11 +403,30 @@ void APP_Flash_Tasks(AppFlashData* app_flash_data) {
 
     case APP_FLASH_STATE_ERROR:
       //TODO(sergey): Report error in some way?
-      //TODO(sergey): Go back to the idle state so we can recover somehow?
       break;
   }
 }
 
+bool APP_Flash_IsRunnable(AppFlashData* app_flash_data) {
+  switch (app_flash_data->state) {
+    case APP_FLASH_STATE_MOUNT_DISK:
+      return !APP_Timer_IsArmed(&app_flash_data->mount_timer);
+    case APP_FLASH_STATE_FORMAT: {
+      AppFlashRawData* app_flash_raw = app_flash_data->app_flash_raw;
+      return APP_FlashRaw_IsError(app_flash_raw) ||
+             (APP_FlashRaw_IsReady(app_flash_raw) &&
+              !APP_FlashCache_IsBusy(app_flash_data->app_flash_cache));
+    }
+    case APP_FLASH_STATE_FORMAT_WAIT_ERASE:
+    case APP_FLASH_STATE_FORMAT_WAIT_WRITE:
+    case APP_FLASH_STATE_IDLE:
+    case APP_FLASH_STATE_ERROR:
+      return false;
+    default:
+      return true;
+  }
+}
+
 bool APP_Flash_IsBusy(AppFlashData* app_flash_data) {
   return (app_flash_data->state != APP_FLASH_STATE_IDLE);
 }
@@ -175,14 +435,44 @@ bool APP_Flash_IsError(AppFlashData* app_flash_data) {
   return (app_flash_data->state == APP_FLASH_STATE_ERROR);
 }
 
+bool APP_Flash_IsFormatting(AppFlashData* app_flash_data) {
+  switch (app_flash_data->state) {
+    case APP_FLASH_STATE_FORMAT:
+    case APP_FLASH_STATE_FORMAT_ERASE:
+    case APP_FLASH_STATE_FORMAT_WAIT_ERASE:
+    case APP_FLASH_STATE_FORMAT_WRITE:
+    case APP_FLASH_STATE_FORMAT_WAIT_WRITE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int APP_Flash_FormatProgress(AppFlashData* app_flash_data) {
+  const uint32_t num_steps = formatNumSteps(app_flash_data);
+  if (num_steps == 0) {
+    return 0;
+  }
+  return app_flash_data->format_step * 100 / num_steps;
+}
+
 bool APP_Flash_DriveSectorGet(uint32_t* total_sectors, uint32_t* free_sectors) {
-  return (SYS_FS_DriveSectorGet(FLASH_MOUNT_POINT,
+  return (SYS_FS_DriveSectorGet(APP_FLASH_MOUNT_POINT,
                                 total_sectors,
                                 free_sectors) == SYS_FS_RES_SUCCESS);
 }
 
-bool APP_Flash_DriveFormat(void) {
-  return (SYS_FS_DriveFormat(FLASH_MOUNT_POINT,
-                             SYS_FS_FORMAT_SFD,
-                             0) == SYS_FS_RES_SUCCESS);
+bool APP_Flash_FormatRequest(AppFlashData* app_flash_data) {
+  if (app_flash_data->state != APP_FLASH_STATE_IDLE &&
+      !(app_flash_data->state == APP_FLASH_STATE_ERROR &&
+        app_flash_data->is_media_registered)) {
+    return false;
+  }
+  FLASH_MESSAGE("Format of the drive is requested.\r\n");
+  // Progress of the previous format is not to be reported.
+  app_flash_data->format_num_blocks = 0;
+  app_flash_data->format_num_pages = 0;
+  app_flash_data->format_step = 0;
+  app_flash_data->state = APP_FLASH_STATE_FORMAT;
+  return true;
 }
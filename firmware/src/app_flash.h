@@ -26,6 +26,15 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "app_timer.h"
+#include "util_fat.h"
+
+// Directory at which the flash drive is mounted.
+#define APP_FLASH_MOUNT_POINT "/mnt/sst25_drive"
+
+struct AppEventBus;
+struct AppFlashCacheData;
+struct AppFlashRawData;
 struct SystemObjects;
 
 typedef enum {
@@ -35,8 +44,14 @@ typedef enum {
   APP_FLASH_STATE_MOUNT_DISK,
   // Ensure flash drive is properly formatted and ready for use.
   APP_FLASH_STATE_ENSURE_FORMATTED,
-  // Perform drive format.
+  // Unmount the drive and calculate layout of the new volume.
   APP_FLASH_STATE_FORMAT,
+  // Erase blocks which are covering system area of the volume, one at a time.
+  APP_FLASH_STATE_FORMAT_ERASE,
+  APP_FLASH_STATE_FORMAT_WAIT_ERASE,
+  // Program system area of the volume, one write block at a time.
+  APP_FLASH_STATE_FORMAT_WRITE,
+  APP_FLASH_STATE_FORMAT_WAIT_WRITE,
   // No tasks to be performed.
   APP_FLASH_STATE_IDLE,
   // Error occurred in flash module.
@@ -45,32 +60,80 @@ typedef enum {
 
 typedef struct AppFlashData {
   struct SystemObjects* system_objects;
+  struct AppFlashCacheData* app_flash_cache;
+  struct AppFlashRawData* app_flash_raw;
+  AppTimerWheel* app_timer_wheel;
+  struct AppEventBus* app_event_bus;
   AppFlashState state;
   // Initial format attempted, do not try it again if format fails.
   bool format_attempted;
+  // Media is registered in the file system, so format can be retried after
+  // an error.
+  bool is_media_registered;
+
+  // ======== Mount ========
+  // Delay before the next mount attempt, doubled after every failure.
+  AppTimer mount_timer;
+  uint32_t mount_retry_interval;
+  uint32_t num_mount_attempts;
+
+  // ======== Format ========
+  // Format does not go through the file system, which would block the main
+  // loop for the whole format. Instead system area of the volume is written
+  // with raw flash operations, and the main loop keeps running while they
+  // are performed.
+  FatVolume format_volume;
+  // Content of the system sector which is being programmed.
+  uint8_t format_sector[FAT_SECTOR_SIZE];
+  // Progress of the format, erases go first and writes follow.
+  uint32_t format_num_blocks;
+  uint32_t format_num_pages;
+  uint32_t format_step;
+  // Progress in percents which was reported the last time.
+  int format_reported_progress;
 } AppFlashData;
 
 // Initialize flash related application routines.
 void APP_Flash_Initialize(AppFlashData* app_flash_data,
-                          struct SystemObjects* system_objects);
+                          struct SystemObjects* system_objects,
+                          struct AppFlashCacheData* app_flash_cache,
+                          struct AppFlashRawData* app_flash_raw,
+                          AppTimerWheel* app_timer_wheel,
+                          struct AppEventBus* app_event_bus);
 
 // Perform all flash related tasks.
 void APP_Flash_Tasks(AppFlashData* app_flash_data);
 
+// Check whether flash tasks are to be performed.
+//
+// Module is not runnable while it waits for the mount retry timer or for the
+// raw flash operation.
+bool APP_Flash_IsRunnable(AppFlashData* app_flash_data);
+
 // Check whether flash module is busy with any tasks.
 bool APP_Flash_IsBusy(AppFlashData* app_flash_data);
 
 // Check whether flash module is in error state.
 bool APP_Flash_IsError(AppFlashData* app_flash_data);
 
+// Check whether format of the drive is in progress.
+bool APP_Flash_IsFormatting(AppFlashData* app_flash_data);
+
+// Progress of the format in percents.
+int APP_Flash_FormatProgress(AppFlashData* app_flash_data);
+
 // Query number of total and free sectors.
 //
 // Return true on success.
 bool APP_Flash_DriveSectorGet(uint32_t* total_sectors, uint32_t* free_sectors);
 
-// Format the flash drive.
+// Start format of the flash drive, drive is mounted again once it is done and
+// APP_EVENT_FLASH_DONE is posted.
 //
-// Return true on success.
-bool APP_Flash_DriveFormat(void);
+// Format is allowed when the module is idle, or when it failed after the
+// media was registered, so a damaged drive can be recovered.
+//
+// Returns false if the format can not be started.
+bool APP_Flash_FormatRequest(AppFlashData* app_flash_data);
 
 #endif  // _APP_FLASH_H
@@ -0,0 +1,822 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_flash_cache.h"
+
+#include <string.h>
+
+#include "app_event.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+#include "util_math.h"
+
+#define LOG_PREFIX "APP FLASH CACHE: "
+
+// Regular print / message.
+#define FLASH_CACHE_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FLASH_CACHE_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Error print / message.
+#define FLASH_CACHE_ERROR_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FLASH_CACHE_ERROR_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Debug print / message.
+#define FLASH_CACHE_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FLASH_CACHE_DEBUG_MESSAGE(message) \
+  APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+// Indices of the regions in the media geometry table.
+#define GEOMETRY_READ   0
+#define GEOMETRY_WRITE  1
+#define GEOMETRY_ERASE  2
+
+// Dirty lines are flushed right away once more than this number of lines is
+// dirty, so there are clean lines left to be evicted.
+#define MAX_DIRTY_LINES (APP_CONFIG_FLASH_CACHE_NUM_LINES / 2)
+
+// Media functions are called by the file system through SYS_FS_MEDIA_FUNCTIONS
+// which only passes the driver handle around, so the cache they belong to is
+// stored here. There is only one serial flash in the system.
+static AppFlashCacheData* g_flash_cache;
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static void geometryEnsure(AppFlashCacheData* cache,
+                           AppFlashCacheDriverHandle handle) {
+  cache->handle = handle;
+  if (cache->has_geometry) {
+    return;
+  }
+  SYS_FS_MEDIA_GEOMETRY* geometry = DRV_SST25_GeometryGet((DRV_HANDLE)handle);
+  if (geometry == NULL) {
+    return;
+  }
+  const SYS_FS_MEDIA_REGION_GEOMETRY* table = geometry->geometryTable;
+  cache->read_block_size = table[GEOMETRY_READ].blockSize;
+  cache->write_block_size = table[GEOMETRY_WRITE].blockSize;
+  cache->erase_block_size = table[GEOMETRY_ERASE].blockSize;
+  cache->has_geometry = true;
+  cache->is_enabled =
+      (APP_FLASH_CACHE_LINE_SIZE % cache->read_block_size == 0 &&
+       APP_FLASH_CACHE_LINE_SIZE % cache->write_block_size == 0 &&
+       cache->erase_block_size % APP_FLASH_CACHE_LINE_SIZE == 0 &&
+       cache->erase_block_size <= APP_FLASH_CACHE_FLUSH_BUFFER_SIZE);
+  if (!cache->is_enabled) {
+    FLASH_CACHE_ERROR_PRINT("Erase block of %u bytes is not supported, "
+                            "cache is bypassed.\r\n",
+                            cache->erase_block_size);
+  }
+}
+
+static uint64_t flushDeadlineGet(void) {
+  return SYS_TMR_SystemCountGet() +
+         (uint64_t)APP_CONFIG_FLASH_CACHE_FLUSH_DELAY *
+             SYS_TMR_SystemCountFrequencyGet() / 1000;
+}
+
+////////////////////////////////////////
+// Lines.
+
+static AppFlashCacheLine* lineFind(AppFlashCacheData* cache,
+                                   uint32_t address) {
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    AppFlashCacheLine* line = &cache->lines[i];
+    if (line->is_valid && line->address == address) {
+      return line;
+    }
+  }
+  return NULL;
+}
+
+static void lineTouch(AppFlashCacheData* cache, AppFlashCacheLine* line) {
+  line->last_access = ++cache->access_counter;
+}
+
+static bool lineIsEvictable(const AppFlashCacheLine* line) {
+  return !line->is_valid || (!line->is_dirty && !line->is_flushing);
+}
+
+// Get line which is to be used for the given address: either unused or the
+// least recently used clean one. Returns NULL if all lines are dirty.
+static AppFlashCacheLine* lineAllocate(AppFlashCacheData* cache,
+                                       uint32_t address) {
+  AppFlashCacheLine* victim = NULL;
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    AppFlashCacheLine* line = &cache->lines[i];
+    if (!lineIsEvictable(line)) {
+      continue;
+    }
+    if (!line->is_valid) {
+      victim = line;
+      break;
+    }
+    if (victim == NULL || line->last_access < victim->last_access) {
+      victim = line;
+    }
+  }
+  if (victim == NULL) {
+    return NULL;
+  }
+  victim->address = address;
+  victim->is_valid = true;
+  victim->is_dirty = false;
+  victim->is_flushing = false;
+  lineTouch(cache, victim);
+  return victim;
+}
+
+static void lineMarkDirty(AppFlashCacheData* cache, AppFlashCacheLine* line) {
+  if (!line->is_dirty) {
+    line->is_dirty = true;
+    ++cache->num_dirty_lines;
+  }
+}
+
+static void lineMarkClean(AppFlashCacheData* cache, AppFlashCacheLine* line) {
+  if (line->is_dirty) {
+    line->is_dirty = false;
+    --cache->num_dirty_lines;
+  }
+}
+
+// Copy data of all cached lines which are intersecting the given range into
+// the buffer of the range, so the buffer matches what the file system wrote.
+static void linesOverlay(AppFlashCacheData* cache,
+                         uint8_t* buffer,
+                         uint32_t address,
+                         uint32_t num_bytes) {
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    const AppFlashCacheLine* line = &cache->lines[i];
+    if (!line->is_valid) {
+      continue;
+    }
+    const uint32_t begin = max_zz(line->address, address);
+    const uint32_t end = min_zz(line->address + APP_FLASH_CACHE_LINE_SIZE,
+                                address + num_bytes);
+    if (begin < end) {
+      memcpy(buffer + (begin - address),
+             line->data + (begin - line->address),
+             end - begin);
+    }
+  }
+}
+
+// Copy data from the buffer of the range into the cached lines which are
+// intersecting it, dirty state of the lines is kept.
+static void linesPatch(AppFlashCacheData* cache,
+                       const uint8_t* buffer,
+                       uint32_t address,
+                       uint32_t num_bytes) {
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    AppFlashCacheLine* line = &cache->lines[i];
+    if (!line->is_valid) {
+      continue;
+    }
+    const uint32_t begin = max_zz(line->address, address);
+    const uint32_t end = min_zz(line->address + APP_FLASH_CACHE_LINE_SIZE,
+                                address + num_bytes);
+    if (begin < end) {
+      memcpy(line->data + (begin - line->address),
+             buffer + (begin - address),
+             end - begin);
+    }
+  }
+}
+
+static bool rangeIsAligned(const AppFlashCacheData* cache,
+                           uint32_t address,
+                           uint32_t num_bytes) {
+  return cache->is_enabled &&
+         num_bytes != 0 &&
+         address % APP_FLASH_CACHE_LINE_SIZE == 0 &&
+         num_bytes % APP_FLASH_CACHE_LINE_SIZE == 0;
+}
+
+////////////////////////////////////////
+// Driver commands.
+
+static bool commandCheckSubmitted(AppFlashCacheData* cache,
+                                  DRV_SST25_BLOCK_COMMAND_HANDLE handle,
+                                  AppFlashCacheState state) {
+  if (handle == DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID) {
+    FLASH_CACHE_ERROR_MESSAGE("Failed to submit flash command.\r\n");
+    ++cache->num_errors;
+    return false;
+  }
+  cache->command_handle = (AppFlashCacheCommandHandle)handle;
+  cache->state = state;
+  return true;
+}
+
+static bool commandRead(AppFlashCacheData* cache,
+                        uint8_t* buffer,
+                        uint32_t address,
+                        uint32_t num_bytes,
+                        AppFlashCacheState state) {
+  DRV_SST25_BLOCK_COMMAND_HANDLE handle = DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  DRV_SST25_BlockRead((DRV_HANDLE)cache->handle, &handle, buffer,
+                      address / cache->read_block_size,
+                      num_bytes / cache->read_block_size);
+  return commandCheckSubmitted(cache, handle, state);
+}
+
+static bool commandEraseWrite(AppFlashCacheData* cache,
+                              uint8_t* buffer,
+                              uint32_t block_start,
+                              uint32_t num_blocks,
+                              AppFlashCacheState state) {
+  DRV_SST25_BLOCK_COMMAND_HANDLE handle = DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  DRV_SST25_BlockEraseWrite((DRV_HANDLE)cache->handle, &handle, buffer,
+                            block_start, num_blocks);
+  return commandCheckSubmitted(cache, handle, state);
+}
+
+static bool commandErase(AppFlashCacheData* cache,
+                         uint32_t block_start,
+                         uint32_t num_blocks,
+                         AppFlashCacheState state) {
+  DRV_SST25_BLOCK_COMMAND_HANDLE handle = DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  DRV_SST25_BlockErase((DRV_HANDLE)cache->handle, &handle,
+                       block_start, num_blocks);
+  return commandCheckSubmitted(cache, handle, state);
+}
+
+////////////////////////////////////////
+// Requests of the media manager.
+
+static bool requestIsActive(const AppFlashCacheData* cache) {
+  return cache->request.type != APP_FLASH_CACHE_REQUEST_NONE &&
+         !cache->request.is_notified;
+}
+
+static void requestFinish(AppFlashCacheData* cache, bool success) {
+  cache->request.status = success ? APP_FLASH_CACHE_REQUEST_STATUS_COMPLETED
+                                  : APP_FLASH_CACHE_REQUEST_STATUS_ERROR;
+}
+
+// Try to serve read from the cache, returns true if all lines were there.
+static bool requestReadFromCache(AppFlashCacheData* cache) {
+  AppFlashCacheRequest* request = &cache->request;
+  if (!rangeIsAligned(cache, request->address, request->num_bytes)) {
+    return false;
+  }
+  uint32_t offset;
+  for (offset = 0;
+       offset < request->num_bytes;
+       offset += APP_FLASH_CACHE_LINE_SIZE) {
+    AppFlashCacheLine* line = lineFind(cache, request->address + offset);
+    if (line == NULL) {
+      // NOTE: Whole buffer is read from the flash in this case, so it is fine
+      // to leave lines which were already copied there.
+      return false;
+    }
+    memcpy(request->buffer + offset, line->data, APP_FLASH_CACHE_LINE_SIZE);
+    lineTouch(cache, line);
+  }
+  cache->num_read_hits += request->num_bytes / APP_FLASH_CACHE_LINE_SIZE;
+  return true;
+}
+
+// Put lines which were read from the flash into the cache.
+static void requestReadFinish(AppFlashCacheData* cache) {
+  AppFlashCacheRequest* request = &cache->request;
+  // Cached lines are newer than the flash.
+  linesOverlay(cache, request->buffer, request->address, request->num_bytes);
+  if (!rangeIsAligned(cache, request->address, request->num_bytes)) {
+    return;
+  }
+  uint32_t offset;
+  for (offset = 0;
+       offset < request->num_bytes;
+       offset += APP_FLASH_CACHE_LINE_SIZE) {
+    const uint32_t address = request->address + offset;
+    AppFlashCacheLine* line = lineFind(cache, address);
+    if (line != NULL) {
+      lineTouch(cache, line);
+      ++cache->num_read_hits;
+      continue;
+    }
+    ++cache->num_read_misses;
+    line = lineAllocate(cache, address);
+    if (line != NULL) {
+      memcpy(line->data, request->buffer + offset, APP_FLASH_CACHE_LINE_SIZE);
+    }
+  }
+}
+
+// Try to keep written data in the cache, returns true if there was room for
+// all the lines.
+static bool requestWriteToCache(AppFlashCacheData* cache) {
+  AppFlashCacheRequest* request = &cache->request;
+  if (!rangeIsAligned(cache, request->address, request->num_bytes)) {
+    return false;
+  }
+  const uint32_t end_address = request->address + request->num_bytes;
+  int num_missing_lines = 0, num_free_lines = 0;
+  uint32_t offset;
+  for (offset = 0;
+       offset < request->num_bytes;
+       offset += APP_FLASH_CACHE_LINE_SIZE) {
+    if (lineFind(cache, request->address + offset) == NULL) {
+      ++num_missing_lines;
+    }
+  }
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    const AppFlashCacheLine* line = &cache->lines[i];
+    if (lineIsEvictable(line) &&
+        (!line->is_valid ||
+         line->address < request->address ||
+         line->address >= end_address)) {
+      ++num_free_lines;
+    }
+  }
+  if (num_missing_lines > num_free_lines) {
+    return false;
+  }
+  for (offset = 0;
+       offset < request->num_bytes;
+       offset += APP_FLASH_CACHE_LINE_SIZE) {
+    const uint32_t address = request->address + offset;
+    AppFlashCacheLine* line = lineFind(cache, address);
+    if (line == NULL) {
+      line = lineAllocate(cache, address);
+    } else {
+      lineTouch(cache, line);
+    }
+    if (line == NULL) {
+      // Is not expected to happen since there was room for all the missing
+      // lines. Request is written to the flash then, and since it patches
+      // cached lines, already written lines stay consistent with it.
+      return false;
+    }
+    memcpy(line->data, request->buffer + offset, APP_FLASH_CACHE_LINE_SIZE);
+    lineMarkDirty(cache, line);
+  }
+  cache->num_write_hits += request->num_bytes / APP_FLASH_CACHE_LINE_SIZE;
+  cache->flush_deadline = flushDeadlineGet();
+  return true;
+}
+
+// Start the request, either serving it from the cache or submitting command
+// to the driver. Requests which need the driver wait for it to be idle.
+static void requestStart(AppFlashCacheData* cache) {
+  AppFlashCacheRequest* request = &cache->request;
+  switch (request->type) {
+    case APP_FLASH_CACHE_REQUEST_NONE:
+      return;
+    case APP_FLASH_CACHE_REQUEST_READ:
+      if (requestReadFromCache(cache)) {
+        requestFinish(cache, true);
+        return;
+      }
+      if (cache->state != APP_FLASH_CACHE_STATE_IDLE) {
+        return;
+      }
+      if (!commandRead(cache, request->buffer,
+                       request->address, request->num_bytes,
+                       APP_FLASH_CACHE_STATE_REQUEST_READ)) {
+        requestFinish(cache, false);
+        return;
+      }
+      break;
+    case APP_FLASH_CACHE_REQUEST_WRITE:
+      if (requestWriteToCache(cache)) {
+        requestFinish(cache, true);
+        return;
+      }
+      if (cache->state != APP_FLASH_CACHE_STATE_IDLE) {
+        return;
+      }
+      // Keep cached lines up to date, the flash gets the same data.
+      linesPatch(cache, request->buffer, request->address, request->num_bytes);
+      cache->num_write_bypasses +=
+          (request->num_bytes + APP_FLASH_CACHE_LINE_SIZE - 1) /
+          APP_FLASH_CACHE_LINE_SIZE;
+      if (!commandEraseWrite(cache, request->buffer,
+                             request->block_start, request->num_blocks,
+                             APP_FLASH_CACHE_STATE_REQUEST_BYPASS)) {
+        requestFinish(cache, false);
+        return;
+      }
+      break;
+    case APP_FLASH_CACHE_REQUEST_ERASE: {
+      if (cache->state != APP_FLASH_CACHE_STATE_IDLE) {
+        return;
+      }
+      // Erased data supersedes whatever is cached for it.
+      const uint32_t end_address = request->address + request->num_bytes;
+      int i;
+      for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+        AppFlashCacheLine* line = &cache->lines[i];
+        if (line->is_valid && !line->is_flushing &&
+            line->address >= request->address &&
+            line->address < end_address) {
+          lineMarkClean(cache, line);
+          line->is_valid = false;
+        }
+      }
+      if (!commandErase(cache, request->block_start, request->num_blocks,
+                        APP_FLASH_CACHE_STATE_REQUEST_BYPASS)) {
+        requestFinish(cache, false);
+        return;
+      }
+      break;
+    }
+  }
+  request->status = APP_FLASH_CACHE_REQUEST_STATUS_IN_PROGRESS;
+}
+
+static void requestSubmit(AppFlashCacheData* cache,
+                          AppFlashCacheCommandHandle* command_handle,
+                          AppFlashCacheRequestType type,
+                          uint8_t* buffer,
+                          uint32_t block_size,
+                          uint32_t block_start,
+                          uint32_t num_blocks) {
+  *command_handle = (AppFlashCacheCommandHandle)
+      SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE_INVALID;
+  if (!cache->has_geometry || requestIsActive(cache)) {
+    FLASH_CACHE_ERROR_MESSAGE("Unable to accept request.\r\n");
+    ++cache->num_errors;
+    return;
+  }
+  AppFlashCacheRequest* request = &cache->request;
+  request->type = type;
+  request->status = APP_FLASH_CACHE_REQUEST_STATUS_QUEUED;
+  request->handle = cache->next_handle;
+  request->is_notified = false;
+  request->buffer = buffer;
+  request->address = block_start * block_size;
+  request->num_bytes = num_blocks * block_size;
+  request->block_start = block_start;
+  request->num_blocks = num_blocks;
+  // Handles are never zero, and never match invalid one.
+  if (++cache->next_handle ==
+      (AppFlashCacheCommandHandle)SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE_INVALID) {
+    cache->next_handle = 1;
+  }
+  *command_handle = request->handle;
+  requestStart(cache);
+}
+
+// Let the media manager know the request is finished.
+//
+// NOTE: This is never done from the function which submitted the request,
+// since the media manager does not know the command handle yet.
+static void requestNotify(AppFlashCacheData* cache) {
+  AppFlashCacheRequest* request = &cache->request;
+  if (request->type == APP_FLASH_CACHE_REQUEST_NONE ||
+      request->is_notified) {
+    return;
+  }
+  if (request->status != APP_FLASH_CACHE_REQUEST_STATUS_COMPLETED &&
+      request->status != APP_FLASH_CACHE_REQUEST_STATUS_ERROR) {
+    return;
+  }
+  // Media manager might submit the next request from the handler.
+  request->is_notified = true;
+  if (cache->event_handler != NULL) {
+    SYS_FS_MEDIA_EVENT_HANDLER handler =
+        (SYS_FS_MEDIA_EVENT_HANDLER)cache->event_handler;
+    handler((request->status == APP_FLASH_CACHE_REQUEST_STATUS_COMPLETED)
+                ? SYS_FS_MEDIA_EVENT_BLOCK_COMMAND_COMPLETE
+                : SYS_FS_MEDIA_EVENT_BLOCK_COMMAND_ERROR,
+            (SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE)request->handle,
+            cache->event_context);
+  }
+}
+
+////////////////////////////////////////
+// Flush.
+
+static bool flushIsNeeded(AppFlashCacheData* cache) {
+  if (cache->num_dirty_lines == 0) {
+    return false;
+  }
+  if (SYS_TMR_SystemCountGet() >= cache->flush_deadline) {
+    return true;
+  }
+  // After a failure only the deadline is followed, so the broken flash is
+  // not hammered with retries.
+  return !cache->is_flush_failed &&
+         (cache->is_flush_requested ||
+          cache->num_dirty_lines > MAX_DIRTY_LINES);
+}
+
+// Finish flush of the lines, if flush failed lines stay dirty.
+static void flushFinish(AppFlashCacheData* cache, bool success) {
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    AppFlashCacheLine* line = &cache->lines[i];
+    if (!line->is_flushing) {
+      continue;
+    }
+    line->is_flushing = false;
+    if (!success) {
+      lineMarkDirty(cache, line);
+    }
+  }
+  cache->is_flush_failed = !success;
+  if (success) {
+    ++cache->num_flushes;
+  } else if (cache->is_flush_requested) {
+    // Give the flash some time before trying again, and let the requester
+    // know the flush did not succeed.
+    cache->is_flush_requested = false;
+    cache->flush_deadline = flushDeadlineGet();
+    APP_Event_Post(cache->app_event_bus, APP_EVENT_FLASH_DONE, cache);
+  } else {
+    cache->flush_deadline = flushDeadlineGet();
+  }
+}
+
+// Start flush of the erase block with the oldest dirty line.
+static void flushBegin(AppFlashCacheData* cache) {
+  const AppFlashCacheLine* oldest_line = NULL;
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    const AppFlashCacheLine* line = &cache->lines[i];
+    if (line->is_valid && line->is_dirty &&
+        (oldest_line == NULL ||
+         line->last_access < oldest_line->last_access)) {
+      oldest_line = line;
+    }
+  }
+  cache->flush_address =
+      oldest_line->address - oldest_line->address % cache->erase_block_size;
+  // Lines only cover part of the erase block, the rest is kept as it is.
+  if (!commandRead(cache, cache->flush_buffer,
+                   cache->flush_address, cache->erase_block_size,
+                   APP_FLASH_CACHE_STATE_FLUSH_READ)) {
+    flushFinish(cache, false);
+  }
+}
+
+static void flushWrite(AppFlashCacheData* cache) {
+  linesOverlay(cache, cache->flush_buffer,
+               cache->flush_address, cache->erase_block_size);
+  const uint32_t end_address = cache->flush_address + cache->erase_block_size;
+  int num_lines = 0;
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    AppFlashCacheLine* line = &cache->lines[i];
+    if (line->is_valid && line->is_dirty &&
+        line->address >= cache->flush_address &&
+        line->address < end_address) {
+      // NOTE: Line which is written again while it is flushed becomes dirty
+      // again, and is flushed once more.
+      lineMarkClean(cache, line);
+      line->is_flushing = true;
+      ++num_lines;
+    }
+  }
+  FLASH_CACHE_DEBUG_PRINT("Flushing %d lines at 0x%06x.\r\n",
+                          num_lines, cache->flush_address);
+  cache->num_lines_flushed += num_lines;
+  if (!commandEraseWrite(cache, cache->flush_buffer,
+                         cache->flush_address / cache->write_block_size,
+                         cache->erase_block_size / cache->write_block_size,
+                         APP_FLASH_CACHE_STATE_FLUSH_WRITE)) {
+    flushFinish(cache, false);
+  }
+}
+
+////////////////////////////////////////
+// State machine.
+
+static void commandFinish(AppFlashCacheData* cache, bool success) {
+  const AppFlashCacheState state = cache->state;
+  cache->state = APP_FLASH_CACHE_STATE_IDLE;
+  if (!success) {
+    ++cache->num_errors;
+  }
+  switch (state) {
+    case APP_FLASH_CACHE_STATE_IDLE:
+      break;
+    case APP_FLASH_CACHE_STATE_REQUEST_READ:
+      if (success) {
+        requestReadFinish(cache);
+      }
+      requestFinish(cache, success);
+      break;
+    case APP_FLASH_CACHE_STATE_REQUEST_BYPASS:
+      requestFinish(cache, success);
+      break;
+    case APP_FLASH_CACHE_STATE_FLUSH_READ:
+      if (success) {
+        flushWrite(cache);
+      } else {
+        flushFinish(cache, false);
+      }
+      break;
+    case APP_FLASH_CACHE_STATE_FLUSH_WRITE:
+      flushFinish(cache, success);
+      break;
+  }
+}
+
+static void commandCheckStatus(AppFlashCacheData* cache) {
+  const DRV_SST25_COMMAND_STATUS status = DRV_SST25_CommandStatus(
+      (DRV_HANDLE)cache->handle,
+      (DRV_SST25_BLOCK_COMMAND_HANDLE)cache->command_handle);
+  switch (status) {
+    case DRV_SST25_COMMAND_COMPLETED:
+      commandFinish(cache, true);
+      break;
+    case DRV_SST25_COMMAND_ERROR_UNKNOWN:
+      FLASH_CACHE_ERROR_MESSAGE("Error detected during flash command.\r\n");
+      commandFinish(cache, false);
+      break;
+    default:
+      // Nothing to do.
+      break;
+  }
+}
+
+static void cacheProcess(AppFlashCacheData* cache) {
+  if (cache->state != APP_FLASH_CACHE_STATE_IDLE) {
+    commandCheckStatus(cache);
+  }
+  if (cache->state == APP_FLASH_CACHE_STATE_IDLE &&
+      cache->request.status == APP_FLASH_CACHE_REQUEST_STATUS_QUEUED) {
+    requestStart(cache);
+  }
+  requestNotify(cache);
+  // NOTE: Flush waits for the media manager requests, so it never delays
+  // the file system.
+  if (cache->state == APP_FLASH_CACHE_STATE_IDLE &&
+      !requestIsActive(cache)) {
+    if (flushIsNeeded(cache)) {
+      flushBegin(cache);
+    } else if (cache->is_flush_requested && cache->num_dirty_lines == 0) {
+      cache->is_flush_requested = false;
+      APP_Event_Post(cache->app_event_bus, APP_EVENT_FLASH_DONE, cache);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_FlashCache_Initialize(AppFlashCacheData* app_flash_cache_data,
+                               struct AppEventBus* app_event_bus) {
+  memset(app_flash_cache_data, 0, sizeof(*app_flash_cache_data));
+  app_flash_cache_data->state = APP_FLASH_CACHE_STATE_IDLE;
+  app_flash_cache_data->app_event_bus = app_event_bus;
+  app_flash_cache_data->request.type = APP_FLASH_CACHE_REQUEST_NONE;
+  app_flash_cache_data->next_handle = 1;
+  g_flash_cache = app_flash_cache_data;
+}
+
+void APP_FlashCache_Tasks(AppFlashCacheData* app_flash_cache_data) {
+  cacheProcess(app_flash_cache_data);
+}
+
+bool APP_FlashCache_IsRunnable(AppFlashCacheData* app_flash_cache_data,
+                               uint64_t* next_deadline) {
+  if (APP_FlashCache_IsBusy(app_flash_cache_data) ||
+      app_flash_cache_data->is_flush_requested) {
+    return true;
+  }
+  if (app_flash_cache_data->num_dirty_lines == 0) {
+    return false;
+  }
+  if (SYS_TMR_SystemCountGet() >= app_flash_cache_data->flush_deadline) {
+    return true;
+  }
+  if (app_flash_cache_data->flush_deadline < *next_deadline) {
+    *next_deadline = app_flash_cache_data->flush_deadline;
+  }
+  return false;
+}
+
+bool APP_FlashCache_IsBusy(AppFlashCacheData* app_flash_cache_data) {
+  return app_flash_cache_data->state != APP_FLASH_CACHE_STATE_IDLE ||
+         requestIsActive(app_flash_cache_data);
+}
+
+bool APP_FlashCache_IsDirty(AppFlashCacheData* app_flash_cache_data) {
+  return app_flash_cache_data->num_dirty_lines != 0;
+}
+
+void APP_FlashCache_Flush(AppFlashCacheData* app_flash_cache_data) {
+  app_flash_cache_data->is_flush_requested = true;
+}
+
+void APP_FlashCache_Invalidate(AppFlashCacheData* app_flash_cache_data) {
+  SYS_ASSERT(!APP_FlashCache_IsBusy(app_flash_cache_data),
+             "Invalidate of busy cache");
+  int i;
+  for (i = 0; i < APP_CONFIG_FLASH_CACHE_NUM_LINES; ++i) {
+    AppFlashCacheLine* line = &app_flash_cache_data->lines[i];
+    line->is_valid = false;
+    line->is_dirty = false;
+    line->is_flushing = false;
+  }
+  app_flash_cache_data->num_dirty_lines = 0;
+}
+
+int APP_FlashCache_ReadHitRate(AppFlashCacheData* app_flash_cache_data) {
+  const uint32_t num_reads = app_flash_cache_data->num_read_hits +
+                             app_flash_cache_data->num_read_misses;
+  if (num_reads == 0) {
+    return 0;
+  }
+  return (uint64_t)app_flash_cache_data->num_read_hits * 100 / num_reads;
+}
+
+void APP_FlashCache_MediaRead(AppFlashCacheDriverHandle handle,
+                              AppFlashCacheCommandHandle* command_handle,
+                              void* buffer,
+                              uint32_t block_start,
+                              uint32_t num_blocks) {
+  AppFlashCacheData* cache = g_flash_cache;
+  geometryEnsure(cache, handle);
+  requestSubmit(cache, command_handle,
+                APP_FLASH_CACHE_REQUEST_READ, buffer,
+                cache->read_block_size, block_start, num_blocks);
+}
+
+void APP_FlashCache_MediaWrite(AppFlashCacheDriverHandle handle,
+                               AppFlashCacheCommandHandle* command_handle,
+                               void* buffer,
+                               uint32_t block_start,
+                               uint32_t num_blocks) {
+  AppFlashCacheData* cache = g_flash_cache;
+  geometryEnsure(cache, handle);
+  requestSubmit(cache, command_handle,
+                APP_FLASH_CACHE_REQUEST_WRITE, buffer,
+                cache->write_block_size, block_start, num_blocks);
+}
+
+void APP_FlashCache_MediaErase(AppFlashCacheDriverHandle handle,
+                               AppFlashCacheCommandHandle* command_handle,
+                               uint32_t block_start,
+                               uint32_t num_blocks) {
+  AppFlashCacheData* cache = g_flash_cache;
+  geometryEnsure(cache, handle);
+  requestSubmit(cache, command_handle,
+                APP_FLASH_CACHE_REQUEST_ERASE, NULL,
+                cache->erase_block_size, block_start, num_blocks);
+}
+
+void APP_FlashCache_MediaEventHandlerSet(AppFlashCacheDriverHandle handle,
+                                         const void* event_handler,
+                                         const uintptr_t context) {
+  AppFlashCacheData* cache = g_flash_cache;
+  cache->event_handler = event_handler;
+  cache->event_context = context;
+}
+
+int APP_FlashCache_MediaCommandStatus(
+    AppFlashCacheDriverHandle handle,
+    AppFlashCacheCommandHandle command_handle) {
+  const AppFlashCacheRequest* request = &g_flash_cache->request;
+  if (request->type == APP_FLASH_CACHE_REQUEST_NONE ||
+      request->handle != command_handle) {
+    // Requests before the current one are all finished.
+    return SYS_FS_MEDIA_COMMAND_COMPLETED;
+  }
+  switch (request->status) {
+    case APP_FLASH_CACHE_REQUEST_STATUS_QUEUED:
+      return SYS_FS_MEDIA_COMMAND_QUEUED;
+    case APP_FLASH_CACHE_REQUEST_STATUS_IN_PROGRESS:
+      return SYS_FS_MEDIA_COMMAND_IN_PROGRESS;
+    case APP_FLASH_CACHE_REQUEST_STATUS_COMPLETED:
+      return SYS_FS_MEDIA_COMMAND_COMPLETED;
+    case APP_FLASH_CACHE_REQUEST_STATUS_ERROR:
+      break;
+  }
+  return SYS_FS_MEDIA_COMMAND_UNKNOWN;
+}
+
+void APP_FlashCache_MediaTasks(uintptr_t object) {
+  DRV_SST25_Tasks((SYS_MODULE_OBJ)object);
+  cacheProcess(g_flash_cache);
+}
@@ -0,0 +1,243 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_FLASH_CACHE_H
+#define _APP_FLASH_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// Write-back cache of the file system sectors in RAM, which sits between the
+// file system media manager and the SST25 driver.
+//
+// FAT keeps reading the same FAT and directory sectors, and every sector
+// write of the driver erases and programs the whole erase block around it.
+// The cache serves repeated reads from RAM, keeps written sectors in RAM and
+// writes all dirty sectors of an erase block with a single erase once the
+// file system is idle for a while, or once it is explicitly asked to.
+//
+// The cache is hooked into the media functions which are registered in the
+// media manager, see app_flash.c. File system operations are blocking, and
+// while they are performed only the tasks of the media are called, so the
+// cache progresses from those as well as from the main loop.
+
+// Size of a cache line, matches the sector of the file system.
+#define APP_FLASH_CACHE_LINE_SIZE 512
+
+// Largest erase block which can be flushed, the cache is bypassed for flash
+// with bigger erase blocks.
+#define APP_FLASH_CACHE_FLUSH_BUFFER_SIZE 4096
+
+typedef uintptr_t AppFlashCacheDriverHandle;
+typedef uintptr_t AppFlashCacheCommandHandle;
+
+struct AppEventBus;
+
+typedef enum {
+  // Driver is not used by the cache.
+  APP_FLASH_CACHE_STATE_IDLE,
+  // Missing lines of the request are read from the flash.
+  APP_FLASH_CACHE_STATE_REQUEST_READ,
+  // Write or erase of the request goes to the flash, bypassing the cache.
+  APP_FLASH_CACHE_STATE_REQUEST_BYPASS,
+  // Current content of the erase block which is flushed is read into the
+  // flush buffer.
+  APP_FLASH_CACHE_STATE_FLUSH_READ,
+  // Erase block is erased and programmed from the flush buffer.
+  APP_FLASH_CACHE_STATE_FLUSH_WRITE,
+} AppFlashCacheState;
+
+typedef enum {
+  APP_FLASH_CACHE_REQUEST_NONE,
+  APP_FLASH_CACHE_REQUEST_READ,
+  APP_FLASH_CACHE_REQUEST_WRITE,
+  APP_FLASH_CACHE_REQUEST_ERASE,
+} AppFlashCacheRequestType;
+
+typedef enum {
+  // Request waits for the driver to be available.
+  APP_FLASH_CACHE_REQUEST_STATUS_QUEUED,
+  // Driver command of the request is in progress.
+  APP_FLASH_CACHE_REQUEST_STATUS_IN_PROGRESS,
+  // Request is finished, media manager is to be notified.
+  APP_FLASH_CACHE_REQUEST_STATUS_COMPLETED,
+  APP_FLASH_CACHE_REQUEST_STATUS_ERROR,
+} AppFlashCacheRequestStatus;
+
+// Request of the media manager.
+//
+// Media manager waits for every command to finish before it issues the next
+// one, so there is only one request at a time.
+typedef struct AppFlashCacheRequest {
+  AppFlashCacheRequestType type;
+  AppFlashCacheRequestStatus status;
+  // Handle which was given to the media manager.
+  AppFlashCacheCommandHandle handle;
+  // Media manager is notified about the finished request.
+  bool is_notified;
+  // NOTE: This is a pointer to the memory of the media manager. Not used by
+  // erase.
+  uint8_t* buffer;
+  // Range of the request in bytes, and in the blocks of the driver.
+  uint32_t address;
+  uint32_t num_bytes;
+  uint32_t block_start;
+  uint32_t num_blocks;
+} AppFlashCacheRequest;
+
+typedef struct AppFlashCacheLine {
+  // Address of the cached data in the flash, in bytes.
+  uint32_t address;
+  // Value of the access counter at the last access of the line, the line
+  // with the lowest value is the least recently used one.
+  uint32_t last_access;
+  bool is_valid;
+  // Data of the line differs from the flash.
+  bool is_dirty;
+  // Line is being written to the flash by the flush.
+  bool is_flushing;
+  uint8_t data[APP_FLASH_CACHE_LINE_SIZE];
+} AppFlashCacheLine;
+
+typedef struct AppFlashCacheData {
+  AppFlashCacheState state;
+  struct AppEventBus* app_event_bus;
+
+  // Driver client of the media manager, commands of the cache go through it.
+  AppFlashCacheDriverHandle handle;
+  AppFlashCacheCommandHandle command_handle;
+  // Geometry of the flash is known.
+  bool has_geometry;
+  // Geometry of the flash is supported by the cache. Otherwise all requests
+  // go directly to the flash.
+  bool is_enabled;
+  uint32_t read_block_size;
+  uint32_t write_block_size;
+  uint32_t erase_block_size;
+
+  // Event handler of the media manager.
+  const void* event_handler;
+  uintptr_t event_context;
+
+  AppFlashCacheRequest request;
+  // Handle to be given to the next request.
+  AppFlashCacheCommandHandle next_handle;
+
+  AppFlashCacheLine lines[APP_CONFIG_FLASH_CACHE_NUM_LINES];
+  uint32_t access_counter;
+  int num_dirty_lines;
+
+  // ======== Flush ========
+  // System timer count at which dirty lines are flushed, pushed further with
+  // every write.
+  uint64_t flush_deadline;
+  // Flush of all dirty lines is requested.
+  bool is_flush_requested;
+  // The last flush failed, next one waits for the deadline.
+  bool is_flush_failed;
+  // Address of the erase block which is flushed.
+  uint32_t flush_address;
+  uint8_t flush_buffer[APP_FLASH_CACHE_FLUSH_BUFFER_SIZE];
+
+  // Statistics since the boot, in lines.
+  uint32_t num_read_hits;
+  uint32_t num_read_misses;
+  uint32_t num_write_hits;
+  uint32_t num_write_bypasses;
+  uint32_t num_lines_flushed;
+  // Number of erase blocks written by the flushes.
+  uint32_t num_flushes;
+  uint32_t num_errors;
+} AppFlashCacheData;
+
+// Initialize the cache.
+//
+// NOTE: Media functions have no user data, so there is only one cache which
+// they are using.
+void APP_FlashCache_Initialize(AppFlashCacheData* app_flash_cache_data,
+                               struct AppEventBus* app_event_bus);
+
+// Perform all cache related tasks from the main loop.
+void APP_FlashCache_Tasks(AppFlashCacheData* app_flash_cache_data);
+
+// Check whether cache tasks are to be performed, dirty lines are waited to
+// be flushed using the deadline.
+bool APP_FlashCache_IsRunnable(AppFlashCacheData* app_flash_cache_data,
+                               uint64_t* next_deadline);
+
+// Check whether cache uses the driver or has a request in progress.
+bool APP_FlashCache_IsBusy(AppFlashCacheData* app_flash_cache_data);
+
+// Check whether cache has data which is not written to the flash yet.
+bool APP_FlashCache_IsDirty(AppFlashCacheData* app_flash_cache_data);
+
+// Write all dirty lines to the flash as soon as possible.
+//
+// APP_EVENT_FLASH_DONE is posted once there are no dirty lines left.
+void APP_FlashCache_Flush(AppFlashCacheData* app_flash_cache_data);
+
+// Drop all the lines, including dirty ones.
+//
+// Used when the flash is modified bypassing the file system, such as its
+// format. Is only to be called while the cache is not busy.
+void APP_FlashCache_Invalidate(AppFlashCacheData* app_flash_cache_data);
+
+// Percentage of the line reads which were served from the cache.
+int APP_FlashCache_ReadHitRate(AppFlashCacheData* app_flash_cache_data);
+
+// Media functions, to be registered in the file system media manager in place
+// of the corresponding SST25 driver functions.
+//
+// Handles and blocks are the same as in the driver functions.
+
+void APP_FlashCache_MediaRead(AppFlashCacheDriverHandle handle,
+                              AppFlashCacheCommandHandle* command_handle,
+                              void* buffer,
+                              uint32_t block_start,
+                              uint32_t num_blocks);
+
+void APP_FlashCache_MediaWrite(AppFlashCacheDriverHandle handle,
+                               AppFlashCacheCommandHandle* command_handle,
+                               void* buffer,
+                               uint32_t block_start,
+                               uint32_t num_blocks);
+
+void APP_FlashCache_MediaErase(AppFlashCacheDriverHandle handle,
+                               AppFlashCacheCommandHandle* command_handle,
+                               uint32_t block_start,
+                               uint32_t num_blocks);
+
+void APP_FlashCache_MediaEventHandlerSet(AppFlashCacheDriverHandle handle,
+                                         const void* event_handler,
+                                         const uintptr_t context);
+
+// Returns one of the SYS_FS_MEDIA_COMMAND_STATUS values.
+int APP_FlashCache_MediaCommandStatus(
+    AppFlashCacheDriverHandle handle,
+    AppFlashCacheCommandHandle command_handle);
+
+// Performs tasks of the driver as well.
+void APP_FlashCache_MediaTasks(uintptr_t object);
+
+#endif  // _APP_FLASH_CACHE_H
@@ -0,0 +1,453 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_flash_raw.h"
+
+#include <string.h>
+
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#define LOG_PREFIX "APP FLASH RAW: "
+
+// Regular print / message.
+#define FLASH_RAW_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FLASH_RAW_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Error print / message.
+#define FLASH_RAW_ERROR_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FLASH_RAW_ERROR_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Debug print / message.
+#define FLASH_RAW_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define FLASH_RAW_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+// Delay in milliseconds between attempts to open the driver.
+#define OPEN_RETRY_INTERVAL 100
+
+// Indices of the regions in the media geometry table.
+#define GEOMETRY_READ   0
+#define GEOMETRY_WRITE  1
+#define GEOMETRY_ERASE  2
+
+static const uint32_t region_num_blocks[APP_FLASH_RAW_NUM_REGIONS] = {
+  // File system takes all the blocks which are not reserved.
+  0,
+  APP_CONFIG_FLASH_FIRMWARE_NUM_BLOCKS,
+  APP_CONFIG_FLASH_FIRMWARE_STATE_NUM_BLOCKS,
+  APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS,
+  APP_CONFIG_FLASH_SETTINGS_NUM_BLOCKS,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static bool geometryFetch(AppFlashRawData* app_flash_raw_data) {
+  SYS_FS_MEDIA_GEOMETRY* geometry =
+      DRV_SST25_GeometryGet((DRV_HANDLE)app_flash_raw_data->handle);
+  if (geometry == NULL || geometry->numReadRegions == 0 ||
+      geometry->numWriteRegions == 0 || geometry->numEraseRegions == 0) {
+    FLASH_RAW_ERROR_MESSAGE("Unable to query flash geometry.\r\n");
+    return false;
+  }
+  const SYS_FS_MEDIA_REGION_GEOMETRY* table = geometry->geometryTable;
+  app_flash_raw_data->read_block_size = table[GEOMETRY_READ].blockSize;
+  app_flash_raw_data->write_block_size = table[GEOMETRY_WRITE].blockSize;
+  app_flash_raw_data->erase_block_size = table[GEOMETRY_ERASE].blockSize;
+  app_flash_raw_data->size = table[GEOMETRY_ERASE].blockSize *
+                             table[GEOMETRY_ERASE].numBlocks;
+  const uint32_t reserved_size =
+      APP_FLASH_RAW_NUM_RESERVED_BLOCKS * app_flash_raw_data->erase_block_size;
+  if (reserved_size >= app_flash_raw_data->size) {
+    FLASH_RAW_ERROR_PRINT("Flash of %u bytes is too small for reserved "
+                          "regions.\r\n", app_flash_raw_data->size);
+    return false;
+  }
+  uint32_t address = 0;
+  int region;
+  for (region = 0; region < APP_FLASH_RAW_NUM_REGIONS; ++region) {
+    app_flash_raw_data->region_address[region] = address;
+    app_flash_raw_data->region_size[region] =
+        (region == APP_FLASH_RAW_REGION_FILE_SYSTEM)
+            ? app_flash_raw_data->size - reserved_size
+            : region_num_blocks[region] * app_flash_raw_data->erase_block_size;
+    address += app_flash_raw_data->region_size[region];
+  }
+  FLASH_RAW_PRINT("Flash of %u bytes, %u bytes reserved at 0x%06x.\r\n",
+                  app_flash_raw_data->size,
+                  reserved_size,
+                  app_flash_raw_data->size - reserved_size);
+  return true;
+}
+
+static void driverOpen(AppFlashRawData* app_flash_raw_data) {
+  if (APP_Timer_IsArmed(&app_flash_raw_data->open_timer)) {
+    return;
+  }
+  const DRV_HANDLE handle = DRV_SST25_Open(DRV_SST25_INDEX_0,
+                                           DRV_IO_INTENT_READWRITE);
+  if (handle == DRV_HANDLE_INVALID) {
+    // Driver is not ready yet.
+    APP_Timer_Start(app_flash_raw_data->app_timer_wheel,
+                    &app_flash_raw_data->open_timer,
+                    OPEN_RETRY_INTERVAL);
+    return;
+  }
+  app_flash_raw_data->handle = (AppFlashRawDriverHandle)handle;
+  if (!geometryFetch(app_flash_raw_data)) {
+    app_flash_raw_data->state = APP_FLASH_RAW_STATE_ERROR;
+    return;
+  }
+  app_flash_raw_data->state = APP_FLASH_RAW_STATE_IDLE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Operations queue.
+
+static AppFlashRawOperation* queue_head(AppFlashRawData* app_flash_raw_data) {
+  SYS_ASSERT(app_flash_raw_data->queue_length != 0, "Queue is empty");
+  return &app_flash_raw_data->queue[app_flash_raw_data->queue_head];
+}
+
+// Get storage for a new operation, or NULL if the queue is full.
+//
+// Operation is not considered queued until queue_submit() is called.
+static AppFlashRawOperation* queue_allocate(
+    AppFlashRawData* app_flash_raw_data,
+    AppFlashRawOperationType type,
+    AppFlashRawRegion region,
+    uint32_t offset,
+    uint32_t num_bytes,
+    AppFlashRawCallback callback,
+    void* user_data) {
+  if (app_flash_raw_data->state == APP_FLASH_RAW_STATE_ERROR) {
+    return NULL;
+  }
+  if (app_flash_raw_data->queue_length == APP_FLASH_RAW_QUEUE_SIZE) {
+    FLASH_RAW_ERROR_MESSAGE("Operation queue is full.\r\n");
+    return NULL;
+  }
+  AppFlashRawOperation* op =
+      &app_flash_raw_data->queue[(app_flash_raw_data->queue_head +
+                                  app_flash_raw_data->queue_length) %
+                                 APP_FLASH_RAW_QUEUE_SIZE];
+  op->type = type;
+  op->region = region;
+  op->offset = offset;
+  op->num_bytes = num_bytes;
+  op->buffer = NULL;
+  op->callback = callback;
+  op->callback_user_data = user_data;
+  return op;
+}
+
+// Resolve address of the operation and check it is aligned to the given
+// block size.
+//
+// Returns false if the operation is not valid.
+static bool operation_address(AppFlashRawData* app_flash_raw_data,
+                              const AppFlashRawOperation* op,
+                              uint32_t block_size,
+                              uint32_t* address) {
+  if (op->region >= APP_FLASH_RAW_NUM_REGIONS) {
+    FLASH_RAW_ERROR_PRINT("Invalid region %d.\r\n", op->region);
+    return false;
+  }
+  const uint32_t region_size = app_flash_raw_data->region_size[op->region];
+  if (op->num_bytes == 0 ||
+      op->offset >= region_size ||
+      op->num_bytes > region_size - op->offset) {
+    FLASH_RAW_ERROR_PRINT("Access of %u bytes at %u is outside of region "
+                          "%d.\r\n", op->num_bytes, op->offset, op->region);
+    return false;
+  }
+  if (op->offset % block_size != 0 || op->num_bytes % block_size != 0) {
+    FLASH_RAW_ERROR_PRINT("Access of %u bytes at %u is not aligned to "
+                          "%u bytes.\r\n",
+                          op->num_bytes, op->offset, block_size);
+    return false;
+  }
+  *address = app_flash_raw_data->region_address[op->region] + op->offset;
+  return true;
+}
+
+// Submit driver command of the operation.
+//
+// Returns false if the command failed to start.
+static bool operation_start(AppFlashRawData* app_flash_raw_data,
+                            AppFlashRawOperation* op) {
+  const DRV_HANDLE handle = (DRV_HANDLE)app_flash_raw_data->handle;
+  DRV_SST25_BLOCK_COMMAND_HANDLE command_handle =
+      DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  uint32_t address;
+  switch (op->type) {
+    case APP_FLASH_RAW_OPERATION_READ: {
+      const uint32_t block_size = app_flash_raw_data->read_block_size;
+      if (!operation_address(app_flash_raw_data, op, block_size, &address)) {
+        return false;
+      }
+      DRV_SST25_BlockRead(handle, &command_handle, op->buffer,
+                          address / block_size, op->num_bytes / block_size);
+      app_flash_raw_data->num_bytes_read += op->num_bytes;
+      break;
+    }
+    case APP_FLASH_RAW_OPERATION_WRITE: {
+      const uint32_t block_size = app_flash_raw_data->write_block_size;
+      if (!operation_address(app_flash_raw_data, op, block_size, &address)) {
+        return false;
+      }
+      DRV_SST25_BlockWrite(handle, &command_handle, op->buffer,
+                           address / block_size, op->num_bytes / block_size);
+      app_flash_raw_data->num_bytes_written += op->num_bytes;
+      break;
+    }
+    case APP_FLASH_RAW_OPERATION_ERASE: {
+      const uint32_t block_size = app_flash_raw_data->erase_block_size;
+      if (!operation_address(app_flash_raw_data, op, block_size, &address)) {
+        return false;
+      }
+      DRV_SST25_BlockErase(handle, &command_handle,
+                           address / block_size, op->num_bytes / block_size);
+      app_flash_raw_data->num_erases += op->num_bytes / block_size;
+      break;
+    }
+  }
+  if (command_handle == DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID) {
+    FLASH_RAW_ERROR_MESSAGE("Failed to submit flash command.\r\n");
+    return false;
+  }
+  app_flash_raw_data->command_handle =
+      (AppFlashRawCommandHandle)command_handle;
+  app_flash_raw_data->state = APP_FLASH_RAW_STATE_WAIT_COMMAND;
+  return true;
+}
+
+// Remove finished operation from the queue and start the following ones
+// until one of them waits for the driver.
+//
+// NOTE: State is kept at WAIT_COMMAND while callbacks are invoked, so
+// operations queued from them are only appended to the queue.
+static void queue_finishHead(AppFlashRawData* app_flash_raw_data,
+                             bool success) {
+  for (;;) {
+    AppFlashRawOperation* op = queue_head(app_flash_raw_data);
+    AppFlashRawCallback callback = op->callback;
+    void* user_data = op->callback_user_data;
+    app_flash_raw_data->queue_head =
+        (app_flash_raw_data->queue_head + 1) % APP_FLASH_RAW_QUEUE_SIZE;
+    --app_flash_raw_data->queue_length;
+    if (!success) {
+      ++app_flash_raw_data->num_errors;
+    }
+    app_flash_raw_data->state = APP_FLASH_RAW_STATE_WAIT_COMMAND;
+    if (callback != NULL) {
+      callback(success, user_data);
+    }
+    if (app_flash_raw_data->queue_length == 0) {
+      app_flash_raw_data->state = APP_FLASH_RAW_STATE_IDLE;
+      return;
+    }
+    if (operation_start(app_flash_raw_data, queue_head(app_flash_raw_data))) {
+      return;
+    }
+    success = false;
+  }
+}
+
+// Make allocated operation queued, start it if nothing else is queued.
+static bool queue_submit(AppFlashRawData* app_flash_raw_data) {
+  ++app_flash_raw_data->queue_length;
+  if (app_flash_raw_data->state != APP_FLASH_RAW_STATE_IDLE) {
+    // Will be started once the driver is opened or previous operations are
+    // finished.
+    return true;
+  }
+  if (!operation_start(app_flash_raw_data, queue_head(app_flash_raw_data))) {
+    queue_finishHead(app_flash_raw_data, false);
+  }
+  return true;
+}
+
+// Check status of the driver command and finish the operation once it's done.
+static void commandCheckStatus(AppFlashRawData* app_flash_raw_data) {
+  const DRV_SST25_COMMAND_STATUS status = DRV_SST25_CommandStatus(
+      (DRV_HANDLE)app_flash_raw_data->handle,
+      (DRV_SST25_BLOCK_COMMAND_HANDLE)app_flash_raw_data->command_handle);
+  switch (status) {
+    case DRV_SST25_COMMAND_COMPLETED:
+      queue_finishHead(app_flash_raw_data, true);
+      break;
+    case DRV_SST25_COMMAND_ERROR_UNKNOWN:
+      FLASH_RAW_ERROR_MESSAGE("Error detected during flash command.\r\n");
+      queue_finishHead(app_flash_raw_data, false);
+      break;
+    default:
+      // Nothing to do.
+      break;
+  }
+}
+
+// Start operations which were queued while the driver was not opened yet.
+static void queue_startPending(AppFlashRawData* app_flash_raw_data) {
+  if (app_flash_raw_data->queue_length == 0) {
+    return;
+  }
+  if (!operation_start(app_flash_raw_data, queue_head(app_flash_raw_data))) {
+    queue_finishHead(app_flash_raw_data, false);
+  }
+}
+
+// Fail all queued operations, used when the flash turned out to be unusable.
+static void queue_failAll(AppFlashRawData* app_flash_raw_data) {
+  while (app_flash_raw_data->queue_length != 0) {
+    AppFlashRawOperation* op = queue_head(app_flash_raw_data);
+    AppFlashRawCallback callback = op->callback;
+    void* user_data = op->callback_user_data;
+    app_flash_raw_data->queue_head =
+        (app_flash_raw_data->queue_head + 1) % APP_FLASH_RAW_QUEUE_SIZE;
+    --app_flash_raw_data->queue_length;
+    ++app_flash_raw_data->num_errors;
+    if (callback != NULL) {
+      callback(false, user_data);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_FlashRaw_Initialize(AppFlashRawData* app_flash_raw_data,
+                             AppTimerWheel* app_timer_wheel) {
+  memset(app_flash_raw_data, 0, sizeof(*app_flash_raw_data));
+  app_flash_raw_data->state = APP_FLASH_RAW_STATE_OPEN;
+  app_flash_raw_data->app_timer_wheel = app_timer_wheel;
+  app_flash_raw_data->handle = (AppFlashRawDriverHandle)DRV_HANDLE_INVALID;
+  APP_Timer_Setup(&app_flash_raw_data->open_timer, NULL, NULL);
+}
+
+void APP_FlashRaw_Tasks(AppFlashRawData* app_flash_raw_data) {
+  switch (app_flash_raw_data->state) {
+    case APP_FLASH_RAW_STATE_OPEN:
+      driverOpen(app_flash_raw_data);
+      if (app_flash_raw_data->state == APP_FLASH_RAW_STATE_IDLE) {
+        queue_startPending(app_flash_raw_data);
+      } else if (app_flash_raw_data->state == APP_FLASH_RAW_STATE_ERROR) {
+        queue_failAll(app_flash_raw_data);
+      }
+      break;
+    case APP_FLASH_RAW_STATE_WAIT_COMMAND:
+      commandCheckStatus(app_flash_raw_data);
+      break;
+    case APP_FLASH_RAW_STATE_IDLE:
+    case APP_FLASH_RAW_STATE_ERROR:
+      // Nothing to do.
+      break;
+  }
+}
+
+bool APP_FlashRaw_IsRunnable(AppFlashRawData* app_flash_raw_data) {
+  switch (app_flash_raw_data->state) {
+    case APP_FLASH_RAW_STATE_OPEN:
+      return !APP_Timer_IsArmed(&app_flash_raw_data->open_timer);
+    case APP_FLASH_RAW_STATE_WAIT_COMMAND:
+      return true;
+    case APP_FLASH_RAW_STATE_IDLE:
+    case APP_FLASH_RAW_STATE_ERROR:
+      return false;
+  }
+  return false;
+}
+
+bool APP_FlashRaw_IsBusy(AppFlashRawData* app_flash_raw_data) {
+  return app_flash_raw_data->queue_length != 0;
+}
+
+bool APP_FlashRaw_IsReady(AppFlashRawData* app_flash_raw_data) {
+  return app_flash_raw_data->state == APP_FLASH_RAW_STATE_IDLE ||
+         app_flash_raw_data->state == APP_FLASH_RAW_STATE_WAIT_COMMAND;
+}
+
+bool APP_FlashRaw_IsError(AppFlashRawData* app_flash_raw_data) {
+  return app_flash_raw_data->state == APP_FLASH_RAW_STATE_ERROR;
+}
+
+uint32_t APP_FlashRaw_RegionSize(AppFlashRawData* app_flash_raw_data,
+                                 AppFlashRawRegion region) {
+  if (region >= APP_FLASH_RAW_NUM_REGIONS) {
+    return 0;
+  }
+  return app_flash_raw_data->region_size[region];
+}
+
+bool APP_FlashRaw_Read(AppFlashRawData* app_flash_raw_data,
+                       AppFlashRawRegion region,
+                       uint32_t offset,
+                       uint8_t* buffer,
+                       uint32_t num_bytes,
+                       AppFlashRawCallback callback,
+                       void* user_data) {
+  AppFlashRawOperation* op = queue_allocate(app_flash_raw_data,
+                                            APP_FLASH_RAW_OPERATION_READ,
+                                            region, offset, num_bytes,
+                                            callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->buffer = buffer;
+  return queue_submit(app_flash_raw_data);
+}
+
+bool APP_FlashRaw_Write(AppFlashRawData* app_flash_raw_data,
+                        AppFlashRawRegion region,
+                        uint32_t offset,
+                        const uint8_t* buffer,
+                        uint32_t num_bytes,
+                        AppFlashRawCallback callback,
+                        void* user_data) {
+  AppFlashRawOperation* op = queue_allocate(app_flash_raw_data,
+                                            APP_FLASH_RAW_OPERATION_WRITE,
+                                            region, offset, num_bytes,
+                                            callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  // NOTE: Driver API takes non-const buffer, but never modifies it.
+  op->buffer = (uint8_t*)buffer;
+  return queue_submit(app_flash_raw_data);
+}
+
+bool APP_FlashRaw_Erase(AppFlashRawData* app_flash_raw_data,
+                        AppFlashRawRegion region,
+                        uint32_t offset,
+                        uint32_t num_bytes,
+                        AppFlashRawCallback callback,
+                        void* user_data) {
+  AppFlashRawOperation* op = queue_allocate(app_flash_raw_data,
+                                            APP_FLASH_RAW_OPERATION_ERASE,
+                                            region, offset, num_bytes,
+                                            callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  return queue_submit(app_flash_raw_data);
+}
@@ -0,0 +1,205 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_FLASH_RAW_H
+#define _APP_FLASH_RAW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "app_timer.h"
+
+// Raw access to the regions of the SST25 serial flash which are reserved for
+// the application.
+//
+// Reserved regions occupy erase blocks at the end of the flash and are hidden
+// from the file system, so they are available right after the driver is up,
+// without waiting for the file system to be mounted. Access goes through a
+// separate driver client, operations are queued and performed one after
+// another.
+
+// Regions of the flash, in the order they are placed in it.
+typedef enum {
+  // Area of the file system, all the blocks which are not reserved. It is
+  // only to be accessed while the file system is not mounted, see the format
+  // in app_flash.c.
+  APP_FLASH_RAW_REGION_FILE_SYSTEM,
+  // Staging area of the firmware update image, see app_firmware_update.h.
+  APP_FLASH_RAW_REGION_FIRMWARE,
+  // Log of the firmware update state records, read by the bootloader.
+  APP_FLASH_RAW_REGION_FIRMWARE_STATE,
+  // Ring buffer of the displayed values, see app_history.h.
+  APP_FLASH_RAW_REGION_HISTORY,
+  // Log-structured store of the settings, see app_settings.h.
+  APP_FLASH_RAW_REGION_SETTINGS,
+
+  APP_FLASH_RAW_NUM_REGIONS,
+} AppFlashRawRegion;
+
+// Total number of erase blocks which are hidden from the file system.
+#define APP_FLASH_RAW_NUM_RESERVED_BLOCKS       \
+  (APP_CONFIG_FLASH_FIRMWARE_NUM_BLOCKS +       \
+   APP_CONFIG_FLASH_FIRMWARE_STATE_NUM_BLOCKS + \
+   APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS +        \
+   APP_CONFIG_FLASH_SETTINGS_NUM_BLOCKS)
+
+// Maximum number of operations which can be queued at a time.
+#ifndef APP_FLASH_RAW_QUEUE_SIZE
+#  define APP_FLASH_RAW_QUEUE_SIZE 8
+#endif
+
+typedef enum {
+  // Wait for the driver to become ready and open a client of it.
+  APP_FLASH_RAW_STATE_OPEN,
+  // No operation is in progress.
+  APP_FLASH_RAW_STATE_IDLE,
+  // Wait for the driver to finish the command of the head operation.
+  APP_FLASH_RAW_STATE_WAIT_COMMAND,
+  // Flash is not usable.
+  APP_FLASH_RAW_STATE_ERROR,
+} AppFlashRawState;
+
+typedef enum {
+  APP_FLASH_RAW_OPERATION_READ,
+  APP_FLASH_RAW_OPERATION_WRITE,
+  APP_FLASH_RAW_OPERATION_ERASE,
+} AppFlashRawOperationType;
+
+typedef uintptr_t AppFlashRawDriverHandle;
+typedef uintptr_t AppFlashRawCommandHandle;
+
+// Callback which is invoked once queued operation is finished.
+//
+// It is allowed to queue new operations from the callback.
+typedef void (*AppFlashRawCallback)(bool success, void* user_data);
+
+typedef struct AppFlashRawOperation {
+  AppFlashRawOperationType type;
+  // Region and offset in bytes from its beginning. Resolved to the address
+  // once the operation is started, since geometry of the flash might be
+  // unknown at the time the operation is queued.
+  AppFlashRawRegion region;
+  uint32_t offset;
+  uint32_t num_bytes;
+  // NOTE: This is a pointer to an external memory, which is to stay valid
+  // until the operation is finished. Not used by erase.
+  uint8_t* buffer;
+  AppFlashRawCallback callback;
+  void* callback_user_data;
+} AppFlashRawOperation;
+
+typedef struct AppFlashRawData {
+  AppFlashRawState state;
+
+  AppTimerWheel* app_timer_wheel;
+  // Delay between attempts to open the driver.
+  AppTimer open_timer;
+
+  AppFlashRawDriverHandle handle;
+  AppFlashRawCommandHandle command_handle;
+
+  // Geometry of the flash, in bytes.
+  uint32_t size;
+  uint32_t read_block_size;
+  uint32_t write_block_size;
+  uint32_t erase_block_size;
+
+  // Address and size of every region, in bytes.
+  uint32_t region_address[APP_FLASH_RAW_NUM_REGIONS];
+  uint32_t region_size[APP_FLASH_RAW_NUM_REGIONS];
+
+  // Ring buffer of queued operations, the first one is being performed.
+  AppFlashRawOperation queue[APP_FLASH_RAW_QUEUE_SIZE];
+  uint8_t queue_head;
+  uint8_t queue_length;
+
+  // Statistics since the boot.
+  uint32_t num_bytes_read;
+  uint32_t num_bytes_written;
+  uint32_t num_erases;
+  uint32_t num_errors;
+} AppFlashRawData;
+
+// Initialize raw flash access, driver is opened once it is ready.
+void APP_FlashRaw_Initialize(AppFlashRawData* app_flash_raw_data,
+                             AppTimerWheel* app_timer_wheel);
+
+// Perform all raw flash related tasks.
+void APP_FlashRaw_Tasks(AppFlashRawData* app_flash_raw_data);
+
+// Check whether raw flash tasks are to be performed.
+bool APP_FlashRaw_IsRunnable(AppFlashRawData* app_flash_raw_data);
+
+// Check whether any operation is queued or in progress.
+bool APP_FlashRaw_IsBusy(AppFlashRawData* app_flash_raw_data);
+
+// Check whether driver is opened and geometry of the regions is known.
+bool APP_FlashRaw_IsReady(AppFlashRawData* app_flash_raw_data);
+
+// Check whether flash is not usable.
+bool APP_FlashRaw_IsError(AppFlashRawData* app_flash_raw_data);
+
+// Size of the region in bytes, zero until the flash is ready.
+uint32_t APP_FlashRaw_RegionSize(AppFlashRawData* app_flash_raw_data,
+                                 AppFlashRawRegion region);
+
+// All the functions below queue an operation on the given region, offset is
+// counted from the beginning of the region. Operations can be queued before
+// the flash is ready, they are started once the driver is opened. Callback is
+// allowed to be NULL.
+//
+// Offset and size are to be multiple of the corresponding block size of the
+// flash, operation outside of the region fails. Returns false if the queue is
+// full or the flash is not usable, and operation was not queued.
+
+// Read data from the flash.
+bool APP_FlashRaw_Read(AppFlashRawData* app_flash_raw_data,
+                       AppFlashRawRegion region,
+                       uint32_t offset,
+                       uint8_t* buffer,
+                       uint32_t num_bytes,
+                       AppFlashRawCallback callback,
+                       void* user_data);
+
+// Program data into the flash.
+//
+// Programming only clears bits, so the area is to be erased beforehand.
+// Programming the same data again is harmless, so a partially used write
+// block can be written again with new data appended to it.
+bool APP_FlashRaw_Write(AppFlashRawData* app_flash_raw_data,
+                        AppFlashRawRegion region,
+                        uint32_t offset,
+                        const uint8_t* buffer,
+                        uint32_t num_bytes,
+                        AppFlashRawCallback callback,
+                        void* user_data);
+
+// Erase blocks of the flash, all their bytes become 0xff.
+bool APP_FlashRaw_Erase(AppFlashRawData* app_flash_raw_data,
+                        AppFlashRawRegion region,
+                        uint32_t offset,
+                        uint32_t num_bytes,
+                        AppFlashRawCallback callback,
+                        void* user_data);
+
+#endif  // _APP_FLASH_RAW_H
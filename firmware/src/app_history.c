@@ -0,0 +1,830 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_history.h"
+
+#include <string.h>
+
+#include "app_event.h"
+#include "app_flash_raw.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+#include "util_crc.h"
+
+#define LOG_PREFIX "APP HISTORY: "
+
+// Regular print / message.
+#define HISTORY_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define HISTORY_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Error print / message.
+#define HISTORY_ERROR_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define HISTORY_ERROR_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Debug print / message.
+#define HISTORY_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define HISTORY_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+// Sector header: magic "NTHS", sequence number and checksum, little endian.
+// Samples of the first page follow the header.
+#define HEADER_MAGIC 0x5348544eu
+#define HEADER_SIZE 10
+
+// Masks the variable-length numbers of a record are stored with. Time
+// difference is stored inverted, so the record never starts with an erased
+// byte. Value difference is stored as is, so an erased byte continues the
+// number and a record which was not programmed completely is never decoded.
+#define TIME_MASK  0xff
+#define VALUE_MASK 0x00
+
+// Maximum size of an encoded variable-length 32 bit number.
+#define VARINT_MAX_SIZE 5
+// Maximum size of an encoded record: time and value differences.
+#define RECORD_MAX_SIZE (2 * VARINT_MAX_SIZE)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static uint32_t pagesPerSector(const AppHistoryData* app_history_data) {
+  return app_history_data->sector_size / APP_HISTORY_PAGE_SIZE;
+}
+
+static uint32_t pageAddress(const AppHistoryData* app_history_data,
+                            int sector,
+                            uint32_t page_index) {
+  return (uint32_t)sector * app_history_data->sector_size +
+         page_index * APP_HISTORY_PAGE_SIZE;
+}
+
+// Offset of the first record in the page.
+static uint32_t pageFirstRecord(uint32_t page_index) {
+  return (page_index == 0) ? HEADER_SIZE : 0;
+}
+
+////////////////////////////////////////
+// Encoding.
+
+static void uint32Encode(uint8_t* data, uint32_t value) {
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t uint32Decode(const uint8_t* data) {
+  return (uint32_t)data[0] |
+         ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) |
+         ((uint32_t)data[3] << 24);
+}
+
+static void headerEncode(uint8_t* data, uint32_t sequence) {
+  uint32Encode(data, HEADER_MAGIC);
+  uint32Encode(data + 4, sequence);
+  const uint16_t checksum = crc16_ccitt_update(CRC16_CCITT_INIT, data, 8);
+  data[8] = checksum & 0xff;
+  data[9] = checksum >> 8;
+}
+
+// Returns false if there is no valid header, sector is erased.
+static bool headerDecode(const uint8_t* data, uint32_t* sequence) {
+  if (uint32Decode(data) != HEADER_MAGIC) {
+    return false;
+  }
+  const uint16_t checksum = crc16_ccitt_update(CRC16_CCITT_INIT, data, 8);
+  if (data[8] != (checksum & 0xff) || data[9] != (checksum >> 8)) {
+    return false;
+  }
+  *sequence = uint32Decode(data + 4);
+  return true;
+}
+
+// Map signed difference to unsigned number, so small differences of either
+// sign are encoded with few bytes.
+static uint32_t zigzagEncode(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t zigzagDecode(uint32_t value) {
+  return (int32_t)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// Encode 7 bits per byte, lowest bits first, the highest bit is set on all
+// bytes but the last one. Bytes are XOR-ed with the given mask.
+//
+// Returns number of bytes written.
+static uint32_t varintEncode(uint8_t* data, uint32_t value, uint8_t mask) {
+  uint32_t num_bytes = 0;
+  while (value >= 0x80) {
+    data[num_bytes++] = ((value & 0x7f) | 0x80) ^ mask;
+    value >>= 7;
+  }
+  data[num_bytes++] = value ^ mask;
+  return num_bytes;
+}
+
+// Returns false if the number is truncated or is too long.
+static bool varintDecode(const uint8_t* data,
+                         uint32_t size,
+                         uint8_t mask,
+                         uint32_t* position,
+                         uint32_t* value) {
+  uint32_t result = 0;
+  int i;
+  for (i = 0; i < VARINT_MAX_SIZE && *position < size; ++i) {
+    const uint8_t byte = data[(*position)++] ^ mask;
+    result |= (uint32_t)(byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Encode the sample as a difference from the previous one.
+//
+// Returns number of bytes written.
+static uint32_t recordEncode(uint8_t* data,
+                             const AppHistorySample* previous,
+                             const AppHistorySample* sample) {
+  // NOTE: Difference is calculated with wrap around, which is undone by the
+  // decoder, so the whole range of values is supported.
+  const int32_t value_delta =
+      (int32_t)((uint32_t)sample->value - (uint32_t)previous->value);
+  uint32_t num_bytes = varintEncode(data,
+                                    sample->timestamp - previous->timestamp,
+                                    TIME_MASK);
+  num_bytes += varintEncode(data + num_bytes,
+                            zigzagEncode(value_delta),
+                            VALUE_MASK);
+  return num_bytes;
+}
+
+// Decode the sample which follows the previous one, which is updated.
+//
+// Returns false at the end of the page, or if the record is damaged.
+static bool recordDecode(const uint8_t* page,
+                         uint32_t* position,
+                         AppHistorySample* previous) {
+  // Time difference is never zero, so its first byte is never erased.
+  if (*position >= APP_HISTORY_PAGE_SIZE || page[*position] == 0xff) {
+    return false;
+  }
+  uint32_t time_delta, value_delta;
+  if (!varintDecode(page, APP_HISTORY_PAGE_SIZE, TIME_MASK,
+                    position, &time_delta) ||
+      !varintDecode(page, APP_HISTORY_PAGE_SIZE, VALUE_MASK,
+                    position, &value_delta)) {
+    return false;
+  }
+  previous->timestamp += time_delta;
+  previous->value =
+      (int32_t)((uint32_t)previous->value +
+                (uint32_t)zigzagDecode(value_delta));
+  return true;
+}
+
+////////////////////////////////////////
+// Tail page.
+
+// Start new empty page in the active sector.
+static void pageReset(AppHistoryData* app_history_data, uint32_t page_index) {
+  memset(app_history_data->page, 0xff, sizeof(app_history_data->page));
+  app_history_data->page_index = page_index;
+  app_history_data->page_used = 0;
+  app_history_data->page_programmed = 0;
+  app_history_data->is_page_full = false;
+  app_history_data->page_last.timestamp = 0;
+  app_history_data->page_last.value = 0;
+}
+
+// Decode page which was read from the flash to continue appending to it.
+static void pageLoad(AppHistoryData* app_history_data) {
+  AppHistorySample last = {0, 0};
+  uint32_t position = pageFirstRecord(app_history_data->page_index);
+  uint32_t end = position;
+  while (recordDecode(app_history_data->page, &position, &last)) {
+    end = position;
+    app_history_data->page_last = last;
+    app_history_data->last = last;
+    app_history_data->has_last = true;
+  }
+  if (end != APP_HISTORY_PAGE_SIZE &&
+      app_history_data->page[end] != 0xff) {
+    // Power was lost while the page was programmed. Samples are not to be
+    // appended after the damaged record, they go to the next page instead.
+    HISTORY_ERROR_PRINT("Damaged record in sector %d page %u.\r\n",
+                        app_history_data->active_sector,
+                        app_history_data->page_index);
+    app_history_data->is_page_full = true;
+  }
+  app_history_data->page_used = end;
+  app_history_data->page_programmed = end;
+}
+
+static void notifyDone(AppHistoryData* app_history_data) {
+  APP_Event_Post(app_history_data->app_event_bus,
+                 APP_EVENT_HISTORY_DONE,
+                 app_history_data);
+}
+
+static void failed(AppHistoryData* app_history_data) {
+  HISTORY_ERROR_MESSAGE("Flash is not usable, history is not stored.\r\n");
+  app_history_data->state = APP_HISTORY_STATE_ERROR;
+  APP_Timer_Cancel(app_history_data->app_timer_wheel,
+                   &app_history_data->flush_timer);
+  notifyDone(app_history_data);
+}
+
+////////////////////////////////////////
+// Loading.
+
+static void loadFinish(AppHistoryData* app_history_data) {
+  if (app_history_data->active_sector == -1) {
+    HISTORY_MESSAGE("No stored history found.\r\n");
+    // New sector is started with the first sample.
+    app_history_data->page_index = pagesPerSector(app_history_data);
+  } else {
+    HISTORY_PRINT("Continue sector %d, sequence %u, page %u at %u.\r\n",
+                  app_history_data->active_sector,
+                  app_history_data->active_sequence,
+                  app_history_data->page_index,
+                  app_history_data->page_used);
+  }
+  app_history_data->state = APP_HISTORY_STATE_IDLE;
+  notifyDone(app_history_data);
+}
+
+static bool geometryCheck(AppHistoryData* app_history_data) {
+  AppFlashRawData* app_flash_raw = app_history_data->app_flash_raw;
+  const uint32_t sector_size = app_flash_raw->erase_block_size;
+  const uint32_t region_size =
+      APP_FlashRaw_RegionSize(app_flash_raw, APP_FLASH_RAW_REGION_HISTORY);
+  if (sector_size == 0 ||
+      sector_size % APP_HISTORY_PAGE_SIZE != 0 ||
+      APP_HISTORY_PAGE_SIZE % app_flash_raw->read_block_size != 0 ||
+      APP_HISTORY_PAGE_SIZE % app_flash_raw->write_block_size != 0) {
+    HISTORY_ERROR_MESSAGE("Flash geometry is not supported.\r\n");
+    return false;
+  }
+  if (region_size / sector_size < 2 ||
+      region_size / sector_size > APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS) {
+    HISTORY_ERROR_MESSAGE("History region size is not supported.\r\n");
+    return false;
+  }
+  app_history_data->sector_size = sector_size;
+  app_history_data->num_sectors = region_size / sector_size;
+  return true;
+}
+
+static void waitFlash(AppHistoryData* app_history_data) {
+  AppFlashRawData* app_flash_raw = app_history_data->app_flash_raw;
+  if (APP_FlashRaw_IsError(app_flash_raw)) {
+    failed(app_history_data);
+    return;
+  }
+  if (!APP_FlashRaw_IsReady(app_flash_raw)) {
+    return;
+  }
+  if (!geometryCheck(app_history_data)) {
+    failed(app_history_data);
+    return;
+  }
+  app_history_data->current_sector = 0;
+  app_history_data->state = APP_HISTORY_STATE_READ_HEADER;
+}
+
+static void readHeaderCallback(bool success, void* user_data) {
+  AppHistoryData* app_history_data = (AppHistoryData*)user_data;
+  if (!success) {
+    failed(app_history_data);
+    return;
+  }
+  const int sector = app_history_data->current_sector;
+  uint32_t sequence;
+  if (headerDecode(app_history_data->page, &sequence)) {
+    AppHistorySample first = {0, 0};
+    uint32_t position = HEADER_SIZE;
+    if (recordDecode(app_history_data->page, &position, &first)) {
+      app_history_data->sector_first_timestamp[sector] = first.timestamp;
+    }
+    if (app_history_data->active_sector == -1 ||
+        sequence > app_history_data->active_sequence) {
+      app_history_data->active_sector = sector;
+      app_history_data->active_sequence = sequence;
+    }
+  }
+  ++app_history_data->current_sector;
+  if (app_history_data->current_sector < app_history_data->num_sectors) {
+    app_history_data->state = APP_HISTORY_STATE_READ_HEADER;
+    return;
+  }
+  if (app_history_data->active_sector == -1) {
+    loadFinish(app_history_data);
+    return;
+  }
+  // Pages are filled in order, so the last used one is found with a binary
+  // search. The first page always has the header.
+  app_history_data->search_first_page = 0;
+  app_history_data->search_last_page = pagesPerSector(app_history_data) - 1;
+  app_history_data->state = APP_HISTORY_STATE_FIND_TAIL;
+}
+
+static void readHeader(AppHistoryData* app_history_data) {
+  if (APP_FlashRaw_Read(app_history_data->app_flash_raw,
+                        APP_FLASH_RAW_REGION_HISTORY,
+                        pageAddress(app_history_data,
+                                    app_history_data->current_sector,
+                                    0),
+                        app_history_data->page,
+                        APP_HISTORY_PAGE_SIZE,
+                        readHeaderCallback,
+                        app_history_data)) {
+    app_history_data->state = APP_HISTORY_STATE_WAIT_READ_HEADER;
+  }
+}
+
+// Page which is probed by the binary search, rounded up so the search always
+// makes progress.
+static uint32_t searchMiddle(const AppHistoryData* app_history_data) {
+  return (app_history_data->search_first_page +
+          app_history_data->search_last_page + 1) / 2;
+}
+
+static void findTailCallback(bool success, void* user_data) {
+  AppHistoryData* app_history_data = (AppHistoryData*)user_data;
+  if (!success) {
+    failed(app_history_data);
+    return;
+  }
+  if (app_history_data->search_first_page ==
+      app_history_data->search_last_page) {
+    // This is the last used page.
+    app_history_data->page_index = app_history_data->search_first_page;
+    pageLoad(app_history_data);
+    loadFinish(app_history_data);
+    return;
+  }
+  const uint32_t middle = searchMiddle(app_history_data);
+  if (app_history_data->page[0] != 0xff) {
+    app_history_data->search_first_page = middle;
+  } else {
+    app_history_data->search_last_page = middle - 1;
+  }
+  app_history_data->state = APP_HISTORY_STATE_FIND_TAIL;
+}
+
+static void findTail(AppHistoryData* app_history_data) {
+  const uint32_t page_index =
+      (app_history_data->search_first_page ==
+       app_history_data->search_last_page)
+          ? app_history_data->search_first_page
+          : searchMiddle(app_history_data);
+  if (APP_FlashRaw_Read(app_history_data->app_flash_raw,
+                        APP_FLASH_RAW_REGION_HISTORY,
+                        pageAddress(app_history_data,
+                                    app_history_data->active_sector,
+                                    page_index),
+                        app_history_data->page,
+                        APP_HISTORY_PAGE_SIZE,
+                        findTailCallback,
+                        app_history_data)) {
+    app_history_data->state = APP_HISTORY_STATE_WAIT_FIND_TAIL;
+  }
+}
+
+////////////////////////////////////////
+// Appending.
+
+static void eraseCallback(bool success, void* user_data) {
+  AppHistoryData* app_history_data = (AppHistoryData*)user_data;
+  if (!success) {
+    failed(app_history_data);
+    return;
+  }
+  const int sector = (app_history_data->active_sector + 1) %
+                     app_history_data->num_sectors;
+  ++app_history_data->num_erases;
+  app_history_data->active_sector = sector;
+  ++app_history_data->active_sequence;
+  app_history_data->sector_first_timestamp[sector] = 0;
+  // Header is programmed together with the first samples.
+  pageReset(app_history_data, 0);
+  headerEncode(app_history_data->page, app_history_data->active_sequence);
+  app_history_data->page_used = HEADER_SIZE;
+  app_history_data->state = APP_HISTORY_STATE_IDLE;
+}
+
+// Erase the oldest sector, it becomes the newest one.
+static void eraseNext(AppHistoryData* app_history_data) {
+  const int sector = (app_history_data->active_sector + 1) %
+                     app_history_data->num_sectors;
+  if (APP_FlashRaw_Erase(app_history_data->app_flash_raw,
+                         APP_FLASH_RAW_REGION_HISTORY,
+                         pageAddress(app_history_data, sector, 0),
+                         app_history_data->sector_size,
+                         eraseCallback,
+                         app_history_data)) {
+    app_history_data->state = APP_HISTORY_STATE_WAIT_ERASE;
+  }
+}
+
+static void writeCallback(bool success, void* user_data) {
+  AppHistoryData* app_history_data = (AppHistoryData*)user_data;
+  if (!success) {
+    failed(app_history_data);
+    return;
+  }
+  ++app_history_data->num_page_writes;
+  app_history_data->page_programmed = app_history_data->write_used;
+  app_history_data->is_flush_requested = false;
+  APP_Timer_Cancel(app_history_data->app_timer_wheel,
+                   &app_history_data->flush_timer);
+  app_history_data->state = APP_HISTORY_STATE_IDLE;
+}
+
+static void writePage(AppHistoryData* app_history_data) {
+  if (APP_FlashRaw_Write(app_history_data->app_flash_raw,
+                         APP_FLASH_RAW_REGION_HISTORY,
+                         pageAddress(app_history_data,
+                                     app_history_data->active_sector,
+                                     app_history_data->page_index),
+                         app_history_data->page,
+                         APP_HISTORY_PAGE_SIZE,
+                         writeCallback,
+                         app_history_data)) {
+    app_history_data->write_used = app_history_data->page_used;
+    app_history_data->state = APP_HISTORY_STATE_WAIT_WRITE;
+  }
+}
+
+static AppHistorySample* queueHead(AppHistoryData* app_history_data) {
+  return &app_history_data->queue[app_history_data->queue_head];
+}
+
+static void queuePop(AppHistoryData* app_history_data) {
+  app_history_data->queue_head =
+      (app_history_data->queue_head + 1) % APP_HISTORY_QUEUE_SIZE;
+  --app_history_data->queue_length;
+}
+
+// Check whether the sample is to be stored.
+static bool sampleIsStored(AppHistoryData* app_history_data,
+                           const AppHistorySample* sample) {
+  if (!app_history_data->has_last) {
+    return true;
+  }
+  const AppHistorySample* last = &app_history_data->last;
+  if (sample->timestamp <= last->timestamp) {
+    HISTORY_DEBUG_PRINT("Dropping sample at %u, it is older than %u.\r\n",
+                        sample->timestamp, last->timestamp);
+    ++app_history_data->num_samples_dropped;
+    return false;
+  }
+  return sample->value != last->value ||
+         sample->timestamp - last->timestamp >=
+             APP_CONFIG_HISTORY_HEARTBEAT_INTERVAL;
+}
+
+// Encode the first queued sample into the page.
+static void encodeSample(AppHistoryData* app_history_data) {
+  const AppHistorySample* sample = queueHead(app_history_data);
+  if (!sampleIsStored(app_history_data, sample)) {
+    queuePop(app_history_data);
+    return;
+  }
+  uint8_t record[RECORD_MAX_SIZE];
+  const uint32_t num_bytes = recordEncode(record,
+                                          &app_history_data->page_last,
+                                          sample);
+  if (app_history_data->page_used + num_bytes > APP_HISTORY_PAGE_SIZE) {
+    app_history_data->is_page_full = true;
+    return;
+  }
+  if (app_history_data->page_index == 0 &&
+      app_history_data->page_used == HEADER_SIZE) {
+    app_history_data->sector_first_timestamp[
+        app_history_data->active_sector] = sample->timestamp;
+  }
+  memcpy(app_history_data->page + app_history_data->page_used,
+         record,
+         num_bytes);
+  app_history_data->page_used += num_bytes;
+  app_history_data->page_last = *sample;
+  app_history_data->last = *sample;
+  app_history_data->has_last = true;
+  ++app_history_data->num_samples;
+  app_history_data->num_bytes_encoded += num_bytes;
+  queuePop(app_history_data);
+  if (!APP_Timer_IsArmed(&app_history_data->flush_timer)) {
+    APP_Timer_Start(app_history_data->app_timer_wheel,
+                    &app_history_data->flush_timer,
+                    APP_CONFIG_HISTORY_FLUSH_INTERVAL * 1000);
+  }
+}
+
+static bool isDirty(const AppHistoryData* app_history_data) {
+  return app_history_data->page_programmed < app_history_data->page_used;
+}
+
+static bool isFlushNeeded(const AppHistoryData* app_history_data) {
+  return isDirty(app_history_data) &&
+         (app_history_data->is_page_full ||
+          app_history_data->is_flush_requested ||
+          APP_Timer_IsExpired(&app_history_data->flush_timer));
+}
+
+static void idleTasks(AppHistoryData* app_history_data) {
+  if (isFlushNeeded(app_history_data)) {
+    writePage(app_history_data);
+  } else if (app_history_data->is_page_full) {
+    // Page is programmed, continue with the next one.
+    pageReset(app_history_data, app_history_data->page_index + 1);
+  } else if (app_history_data->queue_length != 0) {
+    if (app_history_data->page_index == pagesPerSector(app_history_data)) {
+      eraseNext(app_history_data);
+    } else {
+      encodeSample(app_history_data);
+    }
+  } else if (app_history_data->is_flush_requested) {
+    // Nothing to be programmed.
+    app_history_data->is_flush_requested = false;
+  }
+}
+
+////////////////////////////////////////
+// Queries.
+
+static void queryReadCallback(bool success, void* user_data) {
+  AppHistoryQuery* query = (AppHistoryQuery*)user_data;
+  if (success) {
+    query->state = APP_HISTORY_QUERY_STATE_READY;
+  } else {
+    query->is_error = true;
+    query->state = APP_HISTORY_QUERY_STATE_FINISHED;
+  }
+  notifyDone(query->app_history);
+}
+
+// Advance query to the next sector.
+static void queryNextSector(AppHistoryQuery* query) {
+  query->sector = (query->sector + 1) % query->app_history->num_sectors;
+  query->page_index = 0;
+  --query->num_sectors_left;
+}
+
+// Check whether the sector is empty or all its samples are before the
+// queried range.
+static bool querySectorIsBefore(const AppHistoryQuery* query) {
+  AppHistoryData* app_history_data = query->app_history;
+  if (query->sector == app_history_data->active_sector) {
+    return false;
+  }
+  if (app_history_data->sector_first_timestamp[query->sector] == 0) {
+    return true;
+  }
+  const int next_sector = (query->sector + 1) % app_history_data->num_sectors;
+  const uint32_t next_first_timestamp =
+      app_history_data->sector_first_timestamp[next_sector];
+  return next_first_timestamp != 0 && next_first_timestamp <= query->from;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_History_Initialize(AppHistoryData* app_history_data,
+                            AppFlashRawData* app_flash_raw,
+                            AppTimerWheel* app_timer_wheel,
+                            AppEventBus* app_event_bus) {
+  memset(app_history_data, 0, sizeof(*app_history_data));
+  app_history_data->state = APP_HISTORY_STATE_WAIT_FLASH;
+  app_history_data->app_flash_raw = app_flash_raw;
+  app_history_data->app_timer_wheel = app_timer_wheel;
+  app_history_data->app_event_bus = app_event_bus;
+  app_history_data->active_sector = -1;
+  pageReset(app_history_data, 0);
+  APP_Timer_Setup(&app_history_data->flush_timer, NULL, NULL);
+  SYS_MESSAGE("History subsystem initialized.\r\n");
+}
+
+void APP_History_Tasks(AppHistoryData* app_history_data) {
+  AppHistoryState previous_state;
+  int num_steps = 0;
+  do {
+    previous_state = app_history_data->state;
+    switch (app_history_data->state) {
+      case APP_HISTORY_STATE_WAIT_FLASH:
+        waitFlash(app_history_data);
+        break;
+      case APP_HISTORY_STATE_READ_HEADER:
+        readHeader(app_history_data);
+        break;
+      case APP_HISTORY_STATE_FIND_TAIL:
+        findTail(app_history_data);
+        break;
+      case APP_HISTORY_STATE_IDLE:
+        idleTasks(app_history_data);
+        break;
+      case APP_HISTORY_STATE_WAIT_READ_HEADER:
+      case APP_HISTORY_STATE_WAIT_FIND_TAIL:
+      case APP_HISTORY_STATE_WAIT_ERASE:
+      case APP_HISTORY_STATE_WAIT_WRITE:
+        // Waiting for the flash callback.
+        break;
+      case APP_HISTORY_STATE_ERROR:
+        // Nothing to do.
+        break;
+    }
+  } while (app_history_data->state != previous_state &&
+           ++num_steps < APP_CONFIG_MAX_STATE_STEPS);
+}
+
+bool APP_History_IsRunnable(AppHistoryData* app_history_data) {
+  switch (app_history_data->state) {
+    case APP_HISTORY_STATE_WAIT_FLASH: {
+      AppFlashRawData* app_flash_raw = app_history_data->app_flash_raw;
+      return APP_FlashRaw_IsReady(app_flash_raw) ||
+             APP_FlashRaw_IsError(app_flash_raw);
+    }
+    case APP_HISTORY_STATE_READ_HEADER:
+    case APP_HISTORY_STATE_FIND_TAIL:
+      return true;
+    case APP_HISTORY_STATE_IDLE:
+      return app_history_data->queue_length != 0 ||
+             app_history_data->is_page_full ||
+             app_history_data->is_flush_requested ||
+             isFlushNeeded(app_history_data);
+    case APP_HISTORY_STATE_WAIT_READ_HEADER:
+    case APP_HISTORY_STATE_WAIT_FIND_TAIL:
+    case APP_HISTORY_STATE_WAIT_ERASE:
+    case APP_HISTORY_STATE_WAIT_WRITE:
+    case APP_HISTORY_STATE_ERROR:
+      return false;
+  }
+  return false;
+}
+
+bool APP_History_IsLoaded(AppHistoryData* app_history_data) {
+  switch (app_history_data->state) {
+    case APP_HISTORY_STATE_WAIT_FLASH:
+    case APP_HISTORY_STATE_READ_HEADER:
+    case APP_HISTORY_STATE_WAIT_READ_HEADER:
+    case APP_HISTORY_STATE_FIND_TAIL:
+    case APP_HISTORY_STATE_WAIT_FIND_TAIL:
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool APP_History_IsError(AppHistoryData* app_history_data) {
+  return app_history_data->state == APP_HISTORY_STATE_ERROR;
+}
+
+bool APP_History_Record(AppHistoryData* app_history_data,
+                        uint32_t timestamp,
+                        int32_t value) {
+  if (app_history_data->state == APP_HISTORY_STATE_ERROR ||
+      app_history_data->queue_length == APP_HISTORY_QUEUE_SIZE) {
+    ++app_history_data->num_samples_dropped;
+    return false;
+  }
+  AppHistorySample* sample =
+      &app_history_data->queue[(app_history_data->queue_head +
+                                app_history_data->queue_length) %
+                               APP_HISTORY_QUEUE_SIZE];
+  sample->timestamp = timestamp;
+  sample->value = value;
+  ++app_history_data->queue_length;
+  return true;
+}
+
+void APP_History_Flush(AppHistoryData* app_history_data) {
+  app_history_data->is_flush_requested = true;
+}
+
+bool APP_History_IsDirty(AppHistoryData* app_history_data) {
+  return app_history_data->queue_length != 0 || isDirty(app_history_data);
+}
+
+void APP_History_QueryBegin(AppHistoryData* app_history_data,
+                            AppHistoryQuery* query,
+                            uint32_t from,
+                            uint32_t to) {
+  query->app_history = app_history_data;
+  query->from = from;
+  query->to = to;
+  query->position = APP_HISTORY_PAGE_SIZE;
+  query->is_error = false;
+  if (!APP_History_IsLoaded(app_history_data) ||
+      app_history_data->active_sector == -1 ||
+      from > to) {
+    query->state = APP_HISTORY_QUERY_STATE_FINISHED;
+    return;
+  }
+  query->state = APP_HISTORY_QUERY_STATE_READY;
+  // Start with the oldest sector, which follows the active one in the ring.
+  query->sector = app_history_data->active_sector;
+  query->num_sectors_left = app_history_data->num_sectors + 1;
+  queryNextSector(query);
+  while (query->num_sectors_left > 1 && querySectorIsBefore(query)) {
+    queryNextSector(query);
+  }
+}
+
+bool APP_History_QueryFetch(AppHistoryQuery* query) {
+  if (query->state != APP_HISTORY_QUERY_STATE_READY) {
+    return false;
+  }
+  AppHistoryData* app_history_data = query->app_history;
+  const uint32_t pages_per_sector = pagesPerSector(app_history_data);
+  while (query->num_sectors_left > 0) {
+    const int sector = query->sector;
+    const bool is_active = (sector == app_history_data->active_sector);
+    const uint32_t first_timestamp =
+        app_history_data->sector_first_timestamp[sector];
+    if (first_timestamp > query->to) {
+      // All the following samples are newer.
+      break;
+    }
+    if ((first_timestamp == 0 && !is_active) ||
+        query->page_index == pages_per_sector ||
+        (is_active && query->page_index > app_history_data->page_index)) {
+      queryNextSector(query);
+      continue;
+    }
+    const uint32_t page_index = query->page_index++;
+    query->position = pageFirstRecord(page_index);
+    query->last.timestamp = 0;
+    query->last.value = 0;
+    if (is_active && page_index == app_history_data->page_index) {
+      // Page is in RAM and might have samples which are not programmed yet.
+      memcpy(query->page, app_history_data->page, APP_HISTORY_PAGE_SIZE);
+      return true;
+    }
+    if (!APP_FlashRaw_Read(app_history_data->app_flash_raw,
+                           APP_FLASH_RAW_REGION_HISTORY,
+                           pageAddress(app_history_data, sector, page_index),
+                           query->page,
+                           APP_HISTORY_PAGE_SIZE,
+                           queryReadCallback,
+                           query)) {
+      // Try again later.
+      --query->page_index;
+      query->position = APP_HISTORY_PAGE_SIZE;
+      return false;
+    }
+    query->state = APP_HISTORY_QUERY_STATE_PENDING;
+    return true;
+  }
+  query->state = APP_HISTORY_QUERY_STATE_FINISHED;
+  return false;
+}
+
+bool APP_History_QueryNext(AppHistoryQuery* query, AppHistorySample* sample) {
+  if (query->state != APP_HISTORY_QUERY_STATE_READY) {
+    return false;
+  }
+  while (recordDecode(query->page, &query->position, &query->last)) {
+    if (query->last.timestamp > query->to) {
+      query->state = APP_HISTORY_QUERY_STATE_FINISHED;
+      return false;
+    }
+    if (query->last.timestamp >= query->from) {
+      *sample = query->last;
+      return true;
+    }
+  }
+  // Nothing more in this page.
+  query->position = APP_HISTORY_PAGE_SIZE;
+  return false;
+}
+
+bool APP_History_QueryIsFinished(const AppHistoryQuery* query) {
+  return query->state == APP_HISTORY_QUERY_STATE_FINISHED;
+}
+
+bool APP_History_QueryIsPending(const AppHistoryQuery* query) {
+  return query->state == APP_HISTORY_QUERY_STATE_PENDING;
+}
@@ -0,0 +1,249 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_HISTORY_H
+#define _APP_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "app_timer.h"
+
+// History of the values shown on the display.
+//
+// Samples of (timestamp, value) are stored in the reserved region of the
+// serial flash, see app_flash_raw.h, which is used as a ring of sectors (erase
+// blocks). Every sector starts with a header with the sequence number, the
+// oldest sector is erased once the newest one is full.
+//
+// Sectors are split into pages which are decoded independently: the first
+// sample of a page is stored as is, the following ones as a difference from
+// the previous sample. Both numbers of the record are variable-length encoded,
+// so a sample which comes a minute after the previous one and has the same
+// value takes two bytes. Timestamps are strictly increasing, which is used to
+// tell the end of the page from a record.
+//
+// The page which samples are appended to is kept in RAM and is programmed
+// once it is full, or once the oldest sample in it waited for long enough.
+// Programming only clears bits, so the same page is programmed again when new
+// samples are appended to it, and the flash is only erased once per sector
+// worth of samples. Samples in RAM which are not programmed yet are lost on
+// power loss.
+
+// Size of the page samples are decoded from.
+#define APP_HISTORY_PAGE_SIZE 256
+
+// Number of samples which can wait to be encoded into the page.
+#define APP_HISTORY_QUEUE_SIZE 8
+
+struct AppEventBus;
+struct AppFlashRawData;
+
+typedef struct AppHistorySample {
+  // Seconds since 2000-01-01, see util_time.h.
+  uint32_t timestamp;
+  int32_t value;
+} AppHistorySample;
+
+typedef enum {
+  // Wait for the raw flash access to become ready.
+  APP_HISTORY_STATE_WAIT_FLASH,
+  // Read headers of all sectors to find the most recent one.
+  APP_HISTORY_STATE_READ_HEADER,
+  APP_HISTORY_STATE_WAIT_READ_HEADER,
+  // Binary search of the last used page of the most recent sector.
+  APP_HISTORY_STATE_FIND_TAIL,
+  APP_HISTORY_STATE_WAIT_FIND_TAIL,
+  // History is loaded, samples are appended once they are recorded.
+  APP_HISTORY_STATE_IDLE,
+  // Wait for the oldest sector to be erased to become the newest one.
+  APP_HISTORY_STATE_WAIT_ERASE,
+  // Wait for the tail page to be programmed.
+  APP_HISTORY_STATE_WAIT_WRITE,
+  // Flash is not usable, samples are dropped.
+  APP_HISTORY_STATE_ERROR,
+} AppHistoryState;
+
+typedef struct AppHistoryData {
+  AppHistoryState state;
+
+  struct AppFlashRawData* app_flash_raw;
+  struct AppTimerWheel* app_timer_wheel;
+  struct AppEventBus* app_event_bus;
+
+  // Geometry of the store.
+  int num_sectors;
+  uint32_t sector_size;
+
+  // Sector samples are appended to and its sequence number, -1 if there is
+  // no valid sector in the flash.
+  int active_sector;
+  uint32_t active_sequence;
+  // Timestamp of the first sample of every sector, zero if the sector has no
+  // samples. Used to skip sectors which are outside of the queried range.
+  uint32_t sector_first_timestamp[APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS];
+
+  // Sector which is being read while loading, and the range of pages the
+  // tail is searched in.
+  int current_sector;
+  uint32_t search_first_page;
+  uint32_t search_last_page;
+
+  // Page of the active sector samples are appended to, its image with all
+  // the samples encoded so far, number of bytes used and number of bytes
+  // which are programmed into the flash.
+  uint32_t page_index;
+  uint8_t page[APP_HISTORY_PAGE_SIZE];
+  uint32_t page_used;
+  uint32_t page_programmed;
+  // Page ran out of space, samples go to the next page once this one is
+  // programmed.
+  bool is_page_full;
+  // The last sample of the page, the next one is encoded relative to it.
+  AppHistorySample page_last;
+  // Number of bytes used in the page when the write was started.
+  uint32_t write_used;
+
+  // The last recorded sample, used to drop the repeated values.
+  AppHistorySample last;
+  bool has_last;
+
+  // Samples which are recorded but not encoded into the page yet.
+  AppHistorySample queue[APP_HISTORY_QUEUE_SIZE];
+  uint8_t queue_head;
+  uint8_t queue_length;
+
+  // Expires when the page is to be programmed even though it is not full.
+  AppTimer flush_timer;
+  bool is_flush_requested;
+
+  // Statistics since the boot.
+  uint32_t num_samples;
+  uint32_t num_samples_dropped;
+  uint32_t num_bytes_encoded;
+  uint32_t num_page_writes;
+  uint32_t num_erases;
+} AppHistoryData;
+
+typedef enum {
+  // Page is loaded, samples are to be taken with APP_History_QueryNext().
+  APP_HISTORY_QUERY_STATE_READY,
+  // Page is being read from the flash.
+  APP_HISTORY_QUERY_STATE_PENDING,
+  // There are no more samples in the range.
+  APP_HISTORY_QUERY_STATE_FINISHED,
+} AppHistoryQueryState;
+
+// Iterator over the samples of the given time range.
+//
+// Query reads one page at a time into its own buffer, so any number of
+// queries can run concurrently.
+typedef struct AppHistoryQuery {
+  AppHistoryQueryState state;
+  struct AppHistoryData* app_history;
+
+  // Range of the timestamps, inclusive.
+  uint32_t from;
+  uint32_t to;
+
+  // Sector and page which are to be read next, and number of sectors which
+  // are left to be visited including the current one.
+  int sector;
+  uint32_t page_index;
+  int num_sectors_left;
+
+  // Page which is being decoded, position in it and the last decoded sample.
+  uint8_t page[APP_HISTORY_PAGE_SIZE];
+  uint32_t position;
+  AppHistorySample last;
+  // Page was read with an error.
+  bool is_error;
+} AppHistoryQuery;
+
+// Initialize history, it is loaded as soon as the flash is ready.
+void APP_History_Initialize(AppHistoryData* app_history_data,
+                            struct AppFlashRawData* app_flash_raw,
+                            struct AppTimerWheel* app_timer_wheel,
+                            struct AppEventBus* app_event_bus);
+
+// Perform all history related tasks.
+void APP_History_Tasks(AppHistoryData* app_history_data);
+
+// Check whether history tasks are to be performed.
+bool APP_History_IsRunnable(AppHistoryData* app_history_data);
+
+// Check whether history is loaded from the flash, or flash is not usable.
+bool APP_History_IsLoaded(AppHistoryData* app_history_data);
+
+// Check whether flash is not usable.
+bool APP_History_IsError(AppHistoryData* app_history_data);
+
+// Record new sample.
+//
+// Samples are queued and encoded once the history is loaded. Sample which has
+// the same value as the previous one is only stored if
+// APP_CONFIG_HISTORY_HEARTBEAT_INTERVAL seconds passed since the previous
+// stored sample, so gaps in the history are told apart from periods with no
+// changes. Samples which are not newer than the previous one are dropped.
+//
+// Returns false if the queue is full or the flash is not usable.
+bool APP_History_Record(AppHistoryData* app_history_data,
+                        uint32_t timestamp,
+                        int32_t value);
+
+// Program samples from RAM into the flash as soon as possible.
+void APP_History_Flush(AppHistoryData* app_history_data);
+
+// Check whether there are samples which are not programmed yet.
+bool APP_History_IsDirty(AppHistoryData* app_history_data);
+
+// Begin query of the samples from the given time range, inclusive.
+//
+// Query starts with no page loaded, use APP_History_QueryFetch() to load the
+// first one.
+void APP_History_QueryBegin(AppHistoryData* app_history_data,
+                            AppHistoryQuery* query,
+                            uint32_t from,
+                            uint32_t to);
+
+// Load the next page of the query.
+//
+// APP_EVENT_HISTORY_DONE is posted once the page is loaded, page which is
+// kept in RAM is loaded immediately. Returns false if there are no more pages
+// in the range or read can't be queued now, in the latter case the query
+// stays in the ready state and fetch is to be tried again later.
+bool APP_History_QueryFetch(AppHistoryQuery* query);
+
+// Get the next sample of the loaded page.
+//
+// Returns false once the page has no more samples in the range, query is then
+// either to be fetched again or it is finished.
+bool APP_History_QueryNext(AppHistoryQuery* query, AppHistorySample* sample);
+
+// Check whether there are no more samples in the range.
+bool APP_History_QueryIsFinished(const AppHistoryQuery* query);
+
+// Check whether query waits for its page to be read.
+bool APP_History_QueryIsPending(const AppHistoryQuery* query);
+
+#endif  // _APP_HISTORY_H
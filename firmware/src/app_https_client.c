@@ -56,6 +56,8 @@
 #include <wolfssl/ssl.h>
 #include <wolfssl/wolfcrypt/logging.h>
 
+#include "app_config.h"
+#include "app_supervisor.h"
 #include "system_definitions.h"
 #include "utildefines.h"
 
@@ -113,8 +115,10 @@ static bool checkNetworkIsAvailable(AppHTTPSClientData* app_https_client_data) {
 static void waitForNetworkAvailable(AppHTTPSClientData* app_https_client_data) {
   if (checkNetworkIsAvailable(app_https_client_data)) {
     HTTPS_DEBUG_MESSAGE("Network is available.\r\n");
+    APP_Timer_Cancel(app_https_client_data->app_timer_wheel,
+                     &app_https_client_data->timeout_timer);
     app_https_client_data->state = APP_HTTPS_CLIENT_STATE_PARSE_REQUEST_URL;
-  } else if (SYS_TMR_SystemCountGet() > app_https_client_data->timeout) {
+  } else if (APP_Timer_IsExpired(&app_https_client_data->timeout_timer)) {
     HTTPS_ERROR_MESSAGE("Timeout waiting for network connection.\r\n");
     enterErrorState(app_https_client_data);
   }
@@ -325,7 +329,8 @@ static void startNetworkConnection(AppHTTPSClientData* app_https_client_data) {
 static void waitNetworkConnection(AppHTTPSClientData* app_https_client_data) {
   AppHTTPSClientData* data = app_https_client_data;
   if (!NET_PRES_SocketIsConnected(data->socket)) {
-    // TODO(sergey): Check for timeout?
+    // NOTE: Hanging connection is aborted by the supervisor, see
+    // APP_HTTPS_Client_StateBudget().
     return;
   }
   if (STREQ_LEN(data->request_url, "https://", 8)) {
@@ -343,17 +348,25 @@ static void waitNetworkConnection(AppHTTPSClientData* app_https_client_data) {
   }
 }
 
+// Go back to an idle state and let subscribers know client is free.
+static void finishSequence(AppHTTPSClientData* app_https_client_data) {
+  app_https_client_data->state = APP_HTTPS_CLIENT_STATE_IDLE;
+  APP_Event_Post(app_https_client_data->app_event_bus,
+                 APP_EVENT_HTTPS_CLIENT_DONE,
+                 app_https_client_data);
+}
+
 static void closeNetworkConnection(AppHTTPSClientData* app_https_client_data) {
   AppHTTPSClientData* data = app_https_client_data;
   NET_PRES_SocketClose(data->socket);
   HTTPS_DEBUG_MESSAGE("Network connection closed.\r\n");
-  data->state = APP_HTTPS_CLIENT_STATE_IDLE;
+  finishSequence(data);
 }
 
 static void waitForSSLConnect(AppHTTPSClientData* app_https_client_data) {
   AppHTTPSClientData* data = app_https_client_data;
   if (NET_PRES_SocketIsNegotiatingEncryption(data->socket)) {
-    // TODO(sergey): Check on timeout?
+    // NOTE: Hanging negotiation is aborted by the supervisor.
     return;
   }
   if (!NET_PRES_SocketIsSecure(data->socket)) {
@@ -375,12 +388,21 @@ static void sendRequest(AppHTTPSClientData* app_https_client_data) {
     return;
   }
   // TODO(sergey): Ensure null terminator?
-  const uint16_t len = safe_snprintf(data->network_buffer,
-                                     sizeof(data->network_buffer),
-                                     "GET %s HTTP/1.1\r\n"
-                                     "Host: %s\r\n"
-                                     "Connection: close\r\n\r\n",
-                                     data->path, data->host);
+  uint16_t len = safe_snprintf(data->network_buffer,
+                               sizeof(data->network_buffer),
+                               "GET %s HTTP/1.1\r\n"
+                               "Host: %s\r\n"
+                               "Connection: close\r\n",
+                               data->path, data->host);
+  if (data->range_begin != 0) {
+    len += safe_snprintf(data->network_buffer + len,
+                         sizeof(data->network_buffer) - len,
+                         "Range: bytes=%lu-\r\n",
+                         (unsigned long)data->range_begin);
+  }
+  len += safe_snprintf(data->network_buffer + len,
+                       sizeof(data->network_buffer) - len,
+                       "\r\n");
   uint16_t num_bytes_written = NET_PRES_SocketWrite(
       data->socket,
       data->network_buffer,
@@ -391,6 +413,9 @@ static void sendRequest(AppHTTPSClientData* app_https_client_data) {
     enterErrorState(data);
     return;
   }
+  APP_Timer_Start(data->app_timer_wheel,
+                  &data->timeout_timer,
+                  APP_CONFIG_HTTPS_CLIENT_RESPONSE_TIMEOUT);
   data->state = APP_HTTPS_CLIENT_STATE_WAIT_FOR_RESPONSE;
 }
 
@@ -399,13 +424,27 @@ static void waitForResponse(AppHTTPSClientData* app_https_client_data) {
   if (NET_PRES_SocketReadIsReady(data->socket) == 0) {
     if (NET_PRES_SocketWasReset(data->socket)) {
       // TODO(sergey): Check whether connection was aborted?
+      APP_Timer_Cancel(data->app_timer_wheel, &data->timeout_timer);
       if (data->callbacks.request_handled != NULL) {
         data->callbacks.request_handled(data->callbacks.user_data);
       }
       data->state = APP_HTTPS_CLIENT_STATE_CLOSE_CONNECTION;
+    } else if (APP_Timer_IsExpired(&data->timeout_timer)) {
+      HTTPS_ERROR_MESSAGE("Timeout waiting for data from server.\r\n");
+      NET_PRES_SocketClose(data->socket);
+      enterErrorState(data);
     }
     return;
   }
+  // Time spent waiting for the receiver is not counted as server being
+  // silent.
+  APP_Timer_Start(data->app_timer_wheel,
+                  &data->timeout_timer,
+                  APP_CONFIG_HTTPS_CLIENT_RESPONSE_TIMEOUT);
+  if (data->callbacks.is_ready != NULL &&
+      !data->callbacks.is_ready(data->callbacks.user_data)) {
+    return;
+  }
   uint16_t num_bytes_read = NET_PRES_SocketRead(data->socket,
                                                 data->network_buffer,
                                                 sizeof(data->network_buffer));
@@ -422,22 +461,10 @@ static void handleError(AppHTTPSClientData* app_https_client_data) {
     data->callbacks.error(data->callbacks.user_data);
   }
   // We go back to an idle state to wait for further commands.
-  app_https_client_data->state = APP_HTTPS_CLIENT_STATE_IDLE;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-// Public API.
-
-void APP_HTTPS_Client_Initialize(AppHTTPSClientData* app_https_client_data) {
-#ifdef WITH_WOLFSSL_DEBUG
-  wolfSSL_SetLoggingCb(wolfssl_logging_cb);
-  wolfSSL_Debugging_ON();
-#endif
-  app_https_client_data->state = APP_HTTPS_CLIENT_STATE_IDLE;
-  app_https_client_data->ip_mode_config = APP_HTTPS_CLIENT_IP_MODE_IPV4;
+  finishSequence(app_https_client_data);
 }
 
-void APP_HTTPS_Client_Tasks(AppHTTPSClientData* app_https_client_data) {
+static void performStep(AppHTTPSClientData* app_https_client_data) {
   switch (app_https_client_data->state) {
     case APP_HTTPS_CLIENT_STATE_IDLE:
       // Nothing to do.
@@ -446,8 +473,9 @@ void APP_HTTPS_Client_Tasks(AppHTTPSClientData* app_https_client_data) {
       HTTPS_DEBUG_PRINT("Begin HTTPS client sequence for URL %s.\r\n",
                         app_https_client_data->request_url);
       app_https_client_data->state = APP_HTTPS_CLIENT_STATE_WAIT_FOR_NETWORK;
-      app_https_client_data->timeout =
-          SYS_TMR_SystemCountGet() + SYS_TMR_SystemCountFrequencyGet();
+      APP_Timer_Start(app_https_client_data->app_timer_wheel,
+                      &app_https_client_data->timeout_timer,
+                      1000);
       break;
     case APP_HTTPS_CLIENT_STATE_WAIT_FOR_NETWORK:
       waitForNetworkAvailable(app_https_client_data);
@@ -485,6 +513,37 @@ void APP_HTTPS_Client_Tasks(AppHTTPSClientData* app_https_client_data) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_HTTPS_Client_Initialize(AppHTTPSClientData* app_https_client_data,
+                                 AppTimerWheel* app_timer_wheel,
+                                 AppEventBus* app_event_bus) {
+#ifdef WITH_WOLFSSL_DEBUG
+  wolfSSL_SetLoggingCb(wolfssl_logging_cb);
+  wolfSSL_Debugging_ON();
+#endif
+  app_https_client_data->state = APP_HTTPS_CLIENT_STATE_IDLE;
+  app_https_client_data->ip_mode_config = APP_HTTPS_CLIENT_IP_MODE_IPV4;
+  app_https_client_data->app_timer_wheel = app_timer_wheel;
+  app_https_client_data->app_event_bus = app_event_bus;
+  APP_Timer_Setup(&app_https_client_data->timeout_timer, NULL, NULL);
+}
+
+void APP_HTTPS_Client_Tasks(AppHTTPSClientData* app_https_client_data) {
+  // Go through all the states which are not waiting for the network stack
+  // within a single call, so the request does not pay a main loop iteration
+  // for each of the transitions.
+  AppHTTPSClientState previous_state;
+  int num_steps = 0;
+  do {
+    previous_state = app_https_client_data->state;
+    performStep(app_https_client_data);
+  } while (app_https_client_data->state != previous_state &&
+           app_https_client_data->state != APP_HTTPS_CLIENT_STATE_IDLE &&
+           ++num_steps < APP_CONFIG_MAX_STATE_STEPS);
+}
+
 bool APP_HTTPS_Client_IsBusy(AppHTTPSClientData* app_https_client_data) {
   return (app_https_client_data->state != APP_HTTPS_CLIENT_STATE_IDLE);
 }
@@ -492,6 +551,16 @@ bool APP_HTTPS_Client_IsBusy(AppHTTPSClientData* app_https_client_data) {
 bool APP_HTTPS_Client_Request(AppHTTPSClientData* app_https_client_data,
                               const char url[MAX_URL],
                               const AppHttpsClientCallbacks* callbacks) {
+  return APP_HTTPS_Client_RequestRange(app_https_client_data,
+                                       url,
+                                       0,
+                                       callbacks);
+}
+
+bool APP_HTTPS_Client_RequestRange(AppHTTPSClientData* app_https_client_data,
+                                   const char url[MAX_URL],
+                                   uint32_t range_begin,
+                                   const AppHttpsClientCallbacks* callbacks) {
   // Check we are ready for the next request.
   if (APP_HTTPS_Client_IsBusy(app_https_client_data)) {
     return false;
@@ -500,12 +569,59 @@ bool APP_HTTPS_Client_Request(AppHTTPSClientData* app_https_client_data,
   safe_strncpy(app_https_client_data->request_url,
                url,
                sizeof(app_https_client_data->request_url));
+  app_https_client_data->range_begin = range_begin;
   app_https_client_data->callbacks = *callbacks;
   // Enter the request routines.
   app_https_client_data->state = APP_HTTPS_CLIENT_STATE_BEGIN_SEQUENCE;
   return true;
 }
 
+void APP_HTTPS_Client_Abort(AppHTTPSClientData* app_https_client_data) {
+  AppHTTPSClientData* data = app_https_client_data;
+  switch (data->state) {
+    case APP_HTTPS_CLIENT_STATE_IDLE:
+      return;
+    case APP_HTTPS_CLIENT_STATE_WAIT_FOR_CONNECTION:
+    case APP_HTTPS_CLIENT_STATE_CLOSE_CONNECTION:
+    case APP_HTTPS_CLIENT_STATE_WAIT_FOR_SSL_CONNECT:
+    case APP_HTTPS_CLIENT_STATE_SEND_REQUEST:
+    case APP_HTTPS_CLIENT_STATE_WAIT_FOR_RESPONSE:
+      // Socket is open in these states.
+      NET_PRES_SocketClose(data->socket);
+      break;
+    default:
+      break;
+  }
+  HTTPS_ERROR_MESSAGE("Request aborted.\r\n");
+  APP_Timer_Cancel(data->app_timer_wheel, &data->timeout_timer);
+  handleError(data);
+}
+
+uint32_t APP_HTTPS_Client_StateBudget(AppHTTPSClientState state) {
+  switch (state) {
+    case APP_HTTPS_CLIENT_STATE_IDLE:
+      return APP_SUPERVISOR_NO_BUDGET;
+    case APP_HTTPS_CLIENT_STATE_WAIT_FOR_NETWORK:
+      // Has its own timeout, this is only a safety net.
+      return 5000;
+    case APP_HTTPS_CLIENT_STATE_WAIT_ON_DNS:
+    case APP_HTTPS_CLIENT_STATE_WAIT_FOR_CONNECTION:
+      return 10000;
+    case APP_HTTPS_CLIENT_STATE_WAIT_FOR_SSL_CONNECT:
+      // Handshake is rather slow on this CPU.
+      return 20000;
+    case APP_HTTPS_CLIENT_STATE_SEND_REQUEST:
+      return 5000;
+    case APP_HTTPS_CLIENT_STATE_WAIT_FOR_RESPONSE:
+      // Large resources are received for as long as server keeps sending
+      // data, silent server is detected by the response timeout.
+      return APP_SUPERVISOR_NO_BUDGET;
+    default:
+      // The rest of the states are passed within a single tasks call.
+      return 1000;
+  }
+}
+
 void APP_HTTPS_Client_SetWolfSSLDebug(bool enabled)
 {
   g_wolfssl_debug = enabled;
@@ -28,6 +28,9 @@
 
 #include <tcpip/tcpip.h>
 
+#include "app_event.h"
+#include "app_timer.h"
+
 #define MAX_URL         128
 #define MAX_URL_SCHEME  6
 #define MAX_URL_HOST    32
@@ -51,6 +54,12 @@ typedef struct AppHttpsClientCallbacks {
   // TODO(sergey): Add error code of some sort here.
   void (*error)(void* user_data);
 
+  // Check whether receiver is ready to take the next buffer.
+  //
+  // While it is not, received data is kept in the socket, so the server is
+  // throttled by the TCP window. Can be NULL, then receiver is always ready.
+  bool (*is_ready)(void* user_data);
+
   // Generic storage, is passed to all callback types.
   void* user_data;
 } AppHttpsClientCallbacks;
@@ -112,12 +121,23 @@ typedef struct AppHTTPSClientData {
   // This is an URL which user requested us to fetch.
   char request_url[MAX_URL];
 
+  // Offset of the first byte of the resource to be requested, zero requests
+  // the whole resource.
+  uint32_t range_begin;
+
   // ======== Fields shared across multiple tasks ========
 
+  // Wheel which all the timers of the client are running on.
+  struct AppTimerWheel* app_timer_wheel;
+
+  // Bus to which completion of the request is posted.
+  struct AppEventBus* app_event_bus;
+
   // Timeout for the current state to be finished.
   // Used or:
   //   - Timeout waiting for network configuration to become active.
-  uint64_t timeout;
+  //   - Timeout waiting for the next data from the server.
+  AppTimer timeout_timer;
 
   // ======== Task or step specific fields ========
 
@@ -158,7 +178,9 @@ typedef struct AppHTTPSClientData {
 } AppHTTPSClientData;
 
 // Initialize HTTPS client related application routines.
-void APP_HTTPS_Client_Initialize(AppHTTPSClientData* app_https_client_data);
+void APP_HTTPS_Client_Initialize(AppHTTPSClientData* app_https_client_data,
+                                 struct AppTimerWheel* app_timer_wheel,
+                                 struct AppEventBus* app_event_bus);
 
 // Perform all HTTPS client related tasks.
 void APP_HTTPS_Client_Tasks(AppHTTPSClientData* app_https_client_data);
@@ -171,6 +193,26 @@ bool APP_HTTPS_Client_Request(AppHTTPSClientData* app_https_client_data,
                               const char url[MAX_URL],
                               const AppHttpsClientCallbacks* callbacks);
 
+// Same as above, but only requests part of the resource starting at the
+// given offset, using Range header.
+//
+// NOTE: Server is free to ignore the range and reply with the whole
+// resource, so the caller is to check the status of the response.
+bool APP_HTTPS_Client_RequestRange(AppHTTPSClientData* app_https_client_data,
+                                   const char url[MAX_URL],
+                                   uint32_t range_begin,
+                                   const AppHttpsClientCallbacks* callbacks);
+
+// Abort current request.
+//
+// Error callback of the request is invoked and client goes back to an idle
+// state. Does nothing if there is no active request.
+void APP_HTTPS_Client_Abort(AppHTTPSClientData* app_https_client_data);
+
+// Get time in milliseconds client is allowed to spend in the given state,
+// used by the supervisor to detect hanging requests.
+uint32_t APP_HTTPS_Client_StateBudget(AppHTTPSClientState state);
+
 // Set enabled flag on WolfSSL library.
 void APP_HTTPS_Client_SetWolfSSLDebug(bool enabled);
 
@@ -26,6 +26,15 @@
 #include "app_network_utils.h"
 #include "system_objects.h"
 
+// Interval in milliseconds between polls of the connection status, once the
+// interfaces are configured. The TCP/IP stack itself runs from SYS_Tasks(),
+// so this only affects how fast reconnection and IP address change are
+// handled.
+#define POLL_INTERVAL_MS 50
+
+// Interval in milliseconds between checks of the DHCP server response.
+#define IP_WAIT_INTERVAL_MS 500
+
 static bool appNetworkTCPIPInitWait(AppNetworkData* app_network_data) {
   SYS_STATUS tcpip_status =
       TCPIP_STACK_Status(
@@ -92,7 +101,6 @@ static void appNetworkRun(AppNetworkData* app_network_data) {
   static bool is_wifi_power_save_configured = false;
   static bool was_net_up[2] = {true, true};
   static uint32_t reconn_retries = 0;
-  static uint32_t start_tick = 0;
   static IPV4_ADDR last_ip[2] = { {-1}, {-1} };
   int i, num_nets;
   TCPIP_NET_HANDLE wifi_net_handle = app_network_data->wifi_net_handle;
@@ -175,9 +183,7 @@ static void appNetworkRun(AppNetworkData* app_network_data) {
     }
   }
 
-  const uint32_t time_delta = SYS_TMR_TickCountGet() - start_tick;
-  const uint32_t time_threshold = SYS_TMR_TickCounterFrequencyGet() / 2ul;
-  if (time_delta >= time_threshold) {
+  if (APP_Timer_IsExpired(&app_network_data->ip_wait_timer)) {
     if (app_network_data->ip_wait &&
         ++app_network_data->ip_wait > WIFI_DHCP_WAIT_THRESHOLD) {
       app_network_data->ip_wait = 0;
@@ -187,16 +193,22 @@ static void appNetworkRun(AppNetworkData* app_network_data) {
             "If WEP security is used, double-check if the key is valid\r\n");
       }
     }
-    start_tick = SYS_TMR_TickCountGet();
+    APP_Timer_Start(app_network_data->app_timer_wheel,
+                    &app_network_data->ip_wait_timer,
+                    IP_WAIT_INTERVAL_MS);
   }
 }
 
 void APP_Network_Initialize(AppNetworkData* app_network_data,
-                            SystemObjects* system_objects) {
+                            SystemObjects* system_objects,
+                            AppTimerWheel* app_timer_wheel) {
   app_network_data->system_objects = system_objects;
+  app_network_data->app_timer_wheel = app_timer_wheel;
 
   app_network_data->state = APP_NETWORK_TCPIP_WAIT_INIT;
   app_network_data->ip_wait = 0;
+  APP_Timer_Setup(&app_network_data->poll_timer, NULL, NULL);
+  APP_Timer_Setup(&app_network_data->ip_wait_timer, NULL, NULL);
   // Initialize WiFi networking.
   app_network_data->wifi_default_ip.Val = -1;
   app_network_data->wifi_net_handle = NULL;
@@ -218,9 +230,15 @@ void APP_Network_Tasks(AppNetworkData* app_network_data) {
     case APP_NETWORK_TCPIP_MODULES_ENABLE:
       appNetworkTCPIPModuleEnable(app_network_data);
       timestamp_dhcp_kickin(app_network_data->ip_wait);
+      APP_Timer_Start(app_network_data->app_timer_wheel,
+                      &app_network_data->ip_wait_timer,
+                      IP_WAIT_INTERVAL_MS);
       break;
     case APP_NETWORK_TCPIP_TRANSACT:
       appNetworkRun(app_network_data);
+      APP_Timer_Start(app_network_data->app_timer_wheel,
+                      &app_network_data->poll_timer,
+                      POLL_INTERVAL_MS);
       break;
     case APP_NETWORK_TCPIP_ERROR:
       // TODO(sergey): Do we need to do something here?
@@ -228,6 +246,18 @@ void APP_Network_Tasks(AppNetworkData* app_network_data) {
   }
 }
 
+bool APP_Network_IsRunnable(AppNetworkData* app_network_data) {
+  switch (app_network_data->state) {
+    case APP_NETWORK_TCPIP_TRANSACT:
+      return !APP_Timer_IsArmed(&app_network_data->poll_timer);
+    case APP_NETWORK_TCPIP_ERROR:
+      return false;
+    default:
+      break;
+  }
+  return true;
+}
+
 void APP_Network_PHY_Reset(const struct DRV_ETHPHY_OBJECT_BASE_TYPE* pBaseObj) {
   // TODO(sergey): Check whether it's LAN8720 PHY.
   ETH_NRSTOff();
@@ -29,6 +29,9 @@
 #include "driver/wifi/mrf24w/src/drv_wifi_config_data.h"
 #include "driver/wifi/mrf24w/src/drv_wifi_iwpriv.h"
 
+#include "app_timer.h"
+
+struct AppTimerWheel;
 struct SystemObjects;
 struct DRV_ETHPHY_OBJECT_BASE_TYPE;
 
@@ -51,11 +54,17 @@ typedef enum {
 
 typedef struct {
   struct SystemObjects* system_objects;
+  struct AppTimerWheel* app_timer_wheel;
 
   AppNetworkState state;
 
   int16_t ip_wait;
 
+  // Expires when connection status is to be polled.
+  AppTimer poll_timer;
+  // Expires when it's time to check whether DHCP server responded.
+  AppTimer ip_wait_timer;
+
   // WiFi-related fields.
   IPV4_ADDR wifi_default_ip;
   TCPIP_NET_HANDLE wifi_net_handle;
@@ -65,11 +74,18 @@ typedef struct {
 
 // Initialize networking-related application routines.
 void APP_Network_Initialize(AppNetworkData* app_network_data,
-                            struct SystemObjects* system_objects);
+                            struct SystemObjects* system_objects,
+                            struct AppTimerWheel* app_timer_wheel);
 
 // Perform all networking related tasks.
 void APP_Network_Tasks(AppNetworkData* app_network_data);
 
+// Check whether networking tasks are to be performed right now.
+//
+// Once the interfaces are configured the connection status is only polled
+// periodically.
+bool APP_Network_IsRunnable(AppNetworkData* app_network_data);
+
 // Reset LAN8720 Eth PHY when it's requested.
 void APP_Network_PHY_Reset(const struct DRV_ETHPHY_OBJECT_BASE_TYPE* pBaseObj);
 
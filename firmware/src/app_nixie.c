@@ -30,7 +30,9 @@
 #include "util_string.h"
 
 #include "app_network.h"
+#include "app_rtc.h"
 #include "app_shift_register.h"
+#include "app_supervisor.h"
 
 #define LOG_PREFIX "APP NIXIE: "
 
@@ -50,6 +52,29 @@
 #define PERIODIC_INTERVAL_FAST    5
 #define PERIODIC_INTERVAL_NORMAL  30
 
+// Snapshot is stored at the beginning of the RTC SRAM.
+#define SNAPSHOT_SRAM_OFFSET 0
+#define SNAPSHOT_MAGIC_0 'N'
+#define SNAPSHOT_MAGIC_1 'T'
+
+#if SNAPSHOT_SRAM_OFFSET + NIXIE_SNAPSHOT_SIZE > MCP7940N_SRAM_SIZE
+#  error "Snapshot does not fit into the RTC SRAM"
+#endif
+
+// Bigger displays are made of daisy-chained identical boards, each of them
+// has 4 tubes driven by 6 shift registers.
+#define NIXIE_BOARD_NUM_TUBES 4
+#define NIXIE_BOARD_NUM_SHIFT_REGISTERS 6
+#define NIXIE_NUM_BOARDS (MAX_NIXIE_TUBES / NIXIE_BOARD_NUM_TUBES)
+
+#if MAX_NIXIE_TUBES % NIXIE_BOARD_NUM_TUBES != 0
+#  error "Number of tubes must be a multiple of tubes on a single board"
+#endif
+#if NUM_NIXIE_SHIFT_REGISTERS < NIXIE_NUM_BOARDS * \
+                                NIXIE_BOARD_NUM_SHIFT_REGISTERS
+#  error "Not enough shift registers to drive all the boards"
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 // Nixie tube specific routines.
 //
@@ -78,9 +103,131 @@ static int8_t IN12B_SymbolToCathodeIndex(char symbol) {
 ////////////////////////////////////////////////////////////////////////////////
 // Internal routines.
 
+////////////////////////////////////////
+// Resources and events.
+
+// Go back to an idle state and let subscribers know display is free.
+static void finishSequence(AppNixieData* app_nixie_data) {
+  app_nixie_data->state = APP_NIXIE_STATE_IDLE;
+  APP_Event_Post(app_nixie_data->app_event_bus,
+                 APP_EVENT_NIXIE_DONE,
+                 app_nixie_data);
+}
+
+static bool isHttpsClientBusy(AppNixieData* app_nixie_data) {
+  if (APP_HTTPS_Client_IsBusy(app_nixie_data->app_https_client_data)) {
+    app_nixie_data->is_waiting_https_client = true;
+    return true;
+  }
+  return false;
+}
+
+static bool isShiftRegisterBusy(AppNixieData* app_nixie_data) {
+  if (APP_ShiftRegister_IsBusy(app_nixie_data->app_shift_register_data)) {
+    app_nixie_data->is_waiting_shift_register = true;
+    return true;
+  }
+  return false;
+}
+
+static void resourceEventCallback(const AppEvent* event, void* user_data) {
+  AppNixieData* app_nixie_data = (AppNixieData*)user_data;
+  switch (event->type) {
+    case APP_EVENT_HTTPS_CLIENT_DONE:
+      app_nixie_data->is_waiting_https_client = false;
+      break;
+    case APP_EVENT_SHIFT_REGISTER_DONE:
+      app_nixie_data->is_waiting_shift_register = false;
+      break;
+    default:
+      break;
+  }
+}
+
 ////////////////////////////////////////
 // submit HTTP(S) request.
 
+// Case-insensitive check whether line starts with the given lower case
+// prefix.
+static bool headerLineHasPrefix(const char* line,
+                                size_t line_len,
+                                const char* prefix) {
+  size_t i;
+  for (i = 0; prefix[i] != '\0'; ++i) {
+    if (i >= line_len) {
+      return false;
+    }
+    char ch = line[i];
+    if (ch >= 'A' && ch <= 'Z') {
+      ch += 'a' - 'A';
+    }
+    if (ch != prefix[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void headerLineFinished(AppNixieData* app_nixie_data) {
+  const char* line = app_nixie_data->header_line;
+  size_t line_len = app_nixie_data->header_line_len;
+  if (line_len == 0) {
+    app_nixie_data->is_in_headers = false;
+    return;
+  }
+  if (line_len > sizeof(app_nixie_data->header_line)) {
+    // Line was truncated, nothing useful in there.
+    return;
+  }
+  if (!headerLineHasPrefix(line, line_len, "etag:")) {
+    return;
+  }
+  line += 5;
+  line_len -= 5;
+  while (line_len != 0 && (*line == ' ' || *line == '\t')) {
+    ++line;
+    --line_len;
+  }
+  if (line_len >= sizeof(app_nixie_data->response_etag)) {
+    NIXIE_DEBUG_MESSAGE("ETag is too long, ignoring.\r\n");
+    return;
+  }
+  safe_strncpy_len(app_nixie_data->response_etag,
+                   line,
+                   line_len,
+                   sizeof(app_nixie_data->response_etag));
+  NIXIE_DEBUG_PRINT("Response ETag %s\r\n", app_nixie_data->response_etag);
+}
+
+// Scan response headers for ETag.
+//
+// Headers are only looked at, so the body lookup still sees the whole
+// buffer.
+static void scanResponseHeaders(AppNixieData* app_nixie_data,
+                                const uint8_t* buffer,
+                                uint16_t num_bytes) {
+  uint16_t i;
+  for (i = 0; i < num_bytes && app_nixie_data->is_in_headers; ++i) {
+    const char ch = buffer[i];
+    if (ch == '\r') {
+      continue;
+    }
+    if (ch == '\n') {
+      headerLineFinished(app_nixie_data);
+      app_nixie_data->header_line_len = 0;
+      continue;
+    }
+    // NOTE: Length goes one past the buffer size for the truncated lines.
+    if (app_nixie_data->header_line_len <
+        sizeof(app_nixie_data->header_line)) {
+      app_nixie_data->header_line[app_nixie_data->header_line_len++] = ch;
+    } else {
+      app_nixie_data->header_line_len =
+          sizeof(app_nixie_data->header_line) + 1;
+    }
+  }
+}
+
 // Get value from buffer pointing to the beginning of the value.
 static void parseValueFromBuffer(AppNixieData* app_nixie_data,
                                  const char* buffer,
@@ -99,11 +246,12 @@ static void parseValueFromBuffer(AppNixieData* app_nixie_data,
   }
   // Zero out all unused digits.
   // TODO(sergey): Shift to the right, and set MSB to 0?
-  while (index < sizeof(app_nixie_data->display_value)) {
+  while (index < (size_t)app_nixie_data->num_nixies) {
     app_nixie_data->display_value[app_nixie_data->num_nixies - index++ - 1] = '\0';
   }
   NIXIE_DEBUG_PRINT("Parsed value " NIXIE_DISPLAY_FORMAT "\r\n",
-                    NIXIE_DISPLAY_VALUES(app_nixie_data->display_value));
+                    NIXIE_DISPLAY_VALUES(app_nixie_data,
+                                         app_nixie_data->display_value));
   app_nixie_data->is_value_parsed = true;
 }
 
@@ -112,6 +260,9 @@ static void bufferReceivedCallback(const uint8_t* buffer,
                                    void* user_data) {
   AppNixieData* app_nixie_data = (AppNixieData*)user_data;
   const char* found;
+  if (app_nixie_data->is_in_headers) {
+    scanResponseHeaders(app_nixie_data, buffer, num_bytes);
+  }
   if (app_nixie_data->is_value_parsed) {
     // Value is already parsed, no need to waste time trying to find token
     // and such here now.
@@ -236,7 +387,7 @@ static void requestHandledCallback(void* user_data) {
     app_nixie_data->state = APP_NIXIE_STATE_SHUFFLE_SERVER_VALUE;
   } else {
     NIXIE_ERROR_PRINT("Value was not found in the server response.\r\n");
-    app_nixie_data->state = APP_NIXIE_STATE_IDLE;
+    finishSequence(app_nixie_data);
   }
 }
 
@@ -247,17 +398,21 @@ static void errorCallback(void* user_data) {
 }
 
 static void waitHttpsClientAndSendRequest(AppNixieData* app_nixie_data) {
-  if (APP_HTTPS_Client_IsBusy(app_nixie_data->app_https_client_data)) {
+  if (isHttpsClientBusy(app_nixie_data)) {
     return;
   }
   // Reset some values form previous run.
   app_nixie_data->is_value_parsed = false;
   app_nixie_data->cyclic_buffer_len = 0;
+  app_nixie_data->is_in_headers = true;
+  app_nixie_data->header_line_len = 0;
+  app_nixie_data->response_etag[0] = '\0';
   // Prepare callbacks for HTTP(S) module.
   AppHttpsClientCallbacks callbacks;
   callbacks.buffer_received = bufferReceivedCallback;
   callbacks.request_handled = requestHandledCallback;
   callbacks.error = errorCallback;
+  callbacks.is_ready = NULL;
   callbacks.user_data = app_nixie_data;
   // NOTE: It is important to submit request now, because HTTP(s) client might
   // become busy at the next state machine iteration.
@@ -275,6 +430,134 @@ static void waitHttpsClientAndSendRequest(AppNixieData* app_nixie_data) {
   app_nixie_data->state = APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE;
 }
 
+////////////////////////////////////////
+// Snapshot of the display value.
+
+static uint8_t snapshotChecksum(const uint8_t* data, size_t num_bytes) {
+  uint8_t checksum = 0;
+  size_t i;
+  for (i = 0; i < num_bytes; ++i) {
+    checksum = (uint8_t)((checksum << 1) | (checksum >> 7)) ^ data[i];
+  }
+  // Inverted, so SRAM filled with zeros is not a valid snapshot.
+  return ~checksum;
+}
+
+static void snapshotEncode(const AppNixieData* app_nixie_data,
+                           uint8_t snapshot[NIXIE_SNAPSHOT_SIZE]) {
+  const uint32_t timestamp = app_nixie_data->display_value_timestamp;
+  const size_t etag_len = strlen(app_nixie_data->display_value_etag);
+  uint8_t* ptr = snapshot;
+  memset(snapshot, 0, NIXIE_SNAPSHOT_SIZE);
+  *ptr++ = SNAPSHOT_MAGIC_0;
+  *ptr++ = SNAPSHOT_MAGIC_1;
+  *ptr++ = timestamp & 0xff;
+  *ptr++ = (timestamp >> 8) & 0xff;
+  *ptr++ = (timestamp >> 16) & 0xff;
+  *ptr++ = (timestamp >> 24) & 0xff;
+  memcpy(ptr, app_nixie_data->display_value, MAX_NIXIE_TUBES);
+  ptr += MAX_NIXIE_TUBES;
+  *ptr++ = etag_len;
+  memcpy(ptr, app_nixie_data->display_value_etag, etag_len);
+  snapshot[NIXIE_SNAPSHOT_SIZE - 1] =
+      snapshotChecksum(snapshot, NIXIE_SNAPSHOT_SIZE - 1);
+}
+
+// Returns false if the snapshot is not valid.
+static bool snapshotDecode(AppNixieData* app_nixie_data,
+                           const uint8_t snapshot[NIXIE_SNAPSHOT_SIZE]) {
+  const uint8_t* ptr = snapshot;
+  if (ptr[0] != SNAPSHOT_MAGIC_0 || ptr[1] != SNAPSHOT_MAGIC_1 ||
+      snapshot[NIXIE_SNAPSHOT_SIZE - 1] !=
+          snapshotChecksum(snapshot, NIXIE_SNAPSHOT_SIZE - 1)) {
+    return false;
+  }
+  ptr += 2;
+  const uint32_t timestamp = (uint32_t)ptr[0] |
+                             ((uint32_t)ptr[1] << 8) |
+                             ((uint32_t)ptr[2] << 16) |
+                             ((uint32_t)ptr[3] << 24);
+  ptr += 4;
+  const char* value = (const char*)ptr;
+  ptr += MAX_NIXIE_TUBES;
+  const uint8_t etag_len = *ptr++;
+  if (etag_len >= MAX_NIXIE_ETAG) {
+    return false;
+  }
+  if (!APP_Nixie_Display(app_nixie_data, value)) {
+    return false;
+  }
+  app_nixie_data->is_display_value_stale = true;
+  app_nixie_data->display_value_timestamp = timestamp;
+  memcpy(app_nixie_data->display_value_etag, ptr, etag_len);
+  app_nixie_data->display_value_etag[etag_len] = '\0';
+  return true;
+}
+
+static void snapshotReadCallback(RTC_MCP7940N* rtc,
+                                 bool success,
+                                 void* user_data) {
+  AppNixieData* app_nixie_data = (AppNixieData*)user_data;
+  if (!success) {
+    NIXIE_ERROR_MESSAGE("Error reading snapshot from RTC.\r\n");
+    return;
+  }
+  if (!app_nixie_data->is_snapshot_read_pending) {
+    // Fresh value was received from server already.
+    return;
+  }
+  app_nixie_data->is_snapshot_read_pending = false;
+  if (!snapshotDecode(app_nixie_data, app_nixie_data->snapshot_storage)) {
+    NIXIE_DEBUG_MESSAGE("No valid snapshot in RTC SRAM.\r\n");
+    return;
+  }
+  NIXIE_PRINT("Will display " NIXIE_DISPLAY_FORMAT " from snapshot\r\n",
+              NIXIE_DISPLAY_VALUES(app_nixie_data,
+                                   app_nixie_data->display_value));
+}
+
+// Queue read of the snapshot, value is displayed once it is read.
+static void snapshotRestore(AppNixieData* app_nixie_data) {
+  if (!RTC_MCP7940N_ReadSRAM(&app_nixie_data->app_rtc_data->rtc_handle,
+                             SNAPSHOT_SRAM_OFFSET,
+                             app_nixie_data->snapshot_storage,
+                             NIXIE_SNAPSHOT_SIZE,
+                             snapshotReadCallback,
+                             app_nixie_data)) {
+    NIXIE_ERROR_MESSAGE("Unable to queue snapshot read.\r\n");
+    return;
+  }
+  app_nixie_data->is_snapshot_read_pending = true;
+}
+
+// Mark display value as received from server and store it in the SRAM.
+static void snapshotSave(AppNixieData* app_nixie_data) {
+  app_nixie_data->is_snapshot_read_pending = false;
+  app_nixie_data->is_display_value_stale = false;
+  if (!APP_RTC_TimestampGet(app_nixie_data->app_rtc_data,
+                            &app_nixie_data->display_value_timestamp)) {
+    app_nixie_data->display_value_timestamp = 0;
+  }
+  safe_strncpy(app_nixie_data->display_value_etag,
+               app_nixie_data->response_etag,
+               sizeof(app_nixie_data->display_value_etag));
+  // NOTE: Snapshot read might still be queued, so a separate buffer is used
+  // here, it is copied by the driver.
+  uint8_t snapshot[NIXIE_SNAPSHOT_SIZE];
+  snapshotEncode(app_nixie_data, snapshot);
+  if (!RTC_MCP7940N_WriteSRAM(&app_nixie_data->app_rtc_data->rtc_handle,
+                              SNAPSHOT_SRAM_OFFSET,
+                              snapshot,
+                              NIXIE_SNAPSHOT_SIZE,
+                              NULL,
+                              NULL)) {
+    NIXIE_DEBUG_MESSAGE("RTC is busy, snapshot is not updated.\r\n");
+  }
+}
+
+////////////////////////////////////////
+// Server value post-processing.
+
 static void shuffleServerValueDigits(AppNixieData* app_nixie_data) {
   int a;
   int num_leading_null = 0;
@@ -294,10 +577,11 @@ static void shuffleServerValueDigits(AppNixieData* app_nixie_data) {
       app_nixie_data->display_value[app_nixie_data->num_nixies - a - 1] = '0';
     }
     NIXIE_DEBUG_PRINT("Value after shuffle " NIXIE_DISPLAY_FORMAT "\r\n",
-                      NIXIE_DISPLAY_VALUES(app_nixie_data->display_value));
+                      NIXIE_DISPLAY_VALUES(app_nixie_data,
+                                           app_nixie_data->display_value));
   }
   if (app_nixie_data->display_value_out != NULL) {
-    app_nixie_data->state = APP_NIXIE_STATE_IDLE;
+    finishSequence(app_nixie_data);
     memcpy(app_nixie_data->display_value_out,
            app_nixie_data->display_value,
            sizeof(app_nixie_data->display_value));
@@ -307,9 +591,11 @@ static void shuffleServerValueDigits(AppNixieData* app_nixie_data) {
     app_nixie_data->is_fetched_out = NULL;
   } else {
     app_nixie_data->state = APP_NIXIE_STATE_BEGIN_DISPLAY_SEQUENCE;
+    snapshotSave(app_nixie_data);
     NIXIE_MESSAGE("Sending HTTP request.\r\n");
     NIXIE_PRINT("Will display " NIXIE_DISPLAY_FORMAT "\r\n",
-                NIXIE_DISPLAY_VALUES(app_nixie_data->display_value));
+                NIXIE_DISPLAY_VALUES(app_nixie_data,
+                                     app_nixie_data->display_value));
   }
 }
 
@@ -341,39 +627,31 @@ static int8_t nixieSymbolToCathodeIndex(NixieType type, char symbol) {
   return -1;
 }
 
-// Decode display value into cathode indices.
-static void decodeDisplayValue(AppNixieData* app_nixie_data) {
+// Decode given value into per-tube cathode indices.
+static void decodeValue(AppNixieData* app_nixie_data,
+                        const char value[MAX_NIXIE_TUBES],
+                        int8_t cathodes[MAX_NIXIE_TUBES]) {
   int8_t i;
   for (i = 0; i < app_nixie_data->num_nixies; ++i) {
     const int8_t nixie_index = app_nixie_data->num_nixies - i - 1;
-    app_nixie_data->cathodes[i] = nixieSymbolToCathodeIndex(
+    cathodes[i] = nixieSymbolToCathodeIndex(
         app_nixie_data->nixie_types[nixie_index],
-        app_nixie_data->display_value[nixie_index]);
+        value[nixie_index]);
   }
-  app_nixie_data->state = APP_NIXIE_STATE_ENCODE_SHIFT_REGISTER;
-#ifdef SYS_CMD_REMAP_SYS_DEBUG_MESSAGE
-  {
-    NIXIE_DEBUG_MESSAGE("Cathode indices:");
-    for (i = 0; i < app_nixie_data->num_nixies; ++i) {
-      SYS_DEBUG_PRINT(SYS_ERROR_DEBUG, " %d", app_nixie_data->cathodes[i]);
-    }
-    SYS_DEBUG_MESSAGE(SYS_ERROR_DEBUG, "\r\n");
-  }
-#endif
 }
 
-// Encode requested cathode indices to sift register states, taking actual
-// wiring into account.
-static void encodeShiftRegister(AppNixieData* app_nixie_data) {
+// Encode given cathode indices to shift register states, taking actual wiring
+// into account.
+static void encodeFrame(AppNixieData* app_nixie_data,
+                        const int8_t cathodes[MAX_NIXIE_TUBES],
+                        uint8_t frame[NUM_NIXIE_SHIFT_REGISTERS]) {
   int8_t i;
   // Reset all the registers.
-  memset(app_nixie_data->register_shift_state,
-         0,
-         sizeof(app_nixie_data->register_shift_state));
+  memset(frame, 0, NUM_NIXIE_SHIFT_REGISTERS);
   // Now iterate over all requested cathodes and set corresponding bits of
   // the shift register.
   for (i = 0; i < app_nixie_data->num_nixies; ++i) {
-    const int8_t cathode = app_nixie_data->cathodes[i];
+    const int8_t cathode = cathodes[i];
     if (cathode == -1) {
       // TODO(sergey): Need to set corresponding enabled input of shift
       // register to OFF, but it's not possible with current hardware version.
@@ -385,11 +663,38 @@ static void encodeShiftRegister(AppNixieData* app_nixie_data) {
                "\r\nInvalid shift register index");
     SYS_ASSERT(bit <= 8, "\r\nInvalid shift register bit");
     const int num_byte = app_nixie_data->num_shift_registers - byte - 1;
-    app_nixie_data->register_shift_state[num_byte] |= (1 << bit);
+    frame[num_byte] |= (1 << bit);
   }
+}
+
+// Decode display value into cathode indices.
+static void decodeDisplayValue(AppNixieData* app_nixie_data) {
+  decodeValue(app_nixie_data,
+              app_nixie_data->display_value,
+              app_nixie_data->cathodes);
+  app_nixie_data->state = APP_NIXIE_STATE_ENCODE_SHIFT_REGISTER;
+#ifdef SYS_CMD_REMAP_SYS_DEBUG_MESSAGE
+  {
+    int8_t i;
+    NIXIE_DEBUG_MESSAGE("Cathode indices:");
+    for (i = 0; i < app_nixie_data->num_nixies; ++i) {
+      SYS_DEBUG_PRINT(SYS_ERROR_DEBUG, " %d", app_nixie_data->cathodes[i]);
+    }
+    SYS_DEBUG_MESSAGE(SYS_ERROR_DEBUG, "\r\n");
+  }
+#endif
+}
+
+// Encode requested cathode indices to sift register states, taking actual
+// wiring into account.
+static void encodeShiftRegister(AppNixieData* app_nixie_data) {
+  encodeFrame(app_nixie_data,
+              app_nixie_data->cathodes,
+              app_nixie_data->register_shift_state);
   app_nixie_data->state = APP_NIXIE_STATE_WRITE_SHIFT_REGISTER;
 #ifdef SYS_CMD_REMAP_SYS_DEBUG_MESSAGE
   {
+    int8_t i;
     NIXIE_DEBUG_MESSAGE("Shift registers:");
     for (i = 0; i < app_nixie_data->num_shift_registers; ++i) {
       SYS_DEBUG_PRINT(SYS_ERROR_DEBUG, " %x",
@@ -400,16 +705,111 @@ static void encodeShiftRegister(AppNixieData* app_nixie_data) {
 #endif
 }
 
-static void writeShiftRegister(AppNixieData* app_nixie_data) {
-  if (APP_ShiftRegister_IsBusy(app_nixie_data->app_shift_register_data)) {
+// Send given frame to the shift registers, unless it is the same as the one
+// which was latched by the previous transmission.
+static void sendFrame(AppNixieData* app_nixie_data, const uint8_t* frame) {
+  const size_t frame_size = app_nixie_data->num_shift_registers;
+  if (!app_nixie_data->force_refresh &&
+      app_nixie_data->is_latched_shift_state_valid &&
+      memcmp(app_nixie_data->latched_shift_state, frame, frame_size) == 0) {
+    NIXIE_DEBUG_MESSAGE("Frame is unchanged, skipping transmission.\r\n");
+    ++app_nixie_data->num_frames_suppressed;
     return;
   }
   APP_ShiftRegister_SendData(app_nixie_data->app_shift_register_data,
-                             app_nixie_data->register_shift_state,
-                             app_nixie_data->num_shift_registers);
+                             frame,
+                             frame_size);
+  memcpy(app_nixie_data->latched_shift_state, frame, frame_size);
+  app_nixie_data->is_latched_shift_state_valid = true;
+  app_nixie_data->force_refresh = false;
+  ++app_nixie_data->num_frames_sent;
+}
+
+static void writeShiftRegister(AppNixieData* app_nixie_data) {
+  if (isShiftRegisterBusy(app_nixie_data)) {
+    return;
+  }
+  if (APP_Nixie_PlayerIsActive(app_nixie_data)) {
+    // Player owns the shift registers, it will restore the frame when it is
+    // done.
+    finishSequence(app_nixie_data);
+    return;
+  }
+  sendFrame(app_nixie_data, app_nixie_data->register_shift_state);
   // TODO(sergey): Shall we wait for communication to be over before going idle?
   // TODO(sergey): Shall we enable shift registers here?
-  app_nixie_data->state = APP_NIXIE_STATE_IDLE;
+  finishSequence(app_nixie_data);
+}
+
+////////////////////////////////////////
+// Frame sequence player.
+
+#if MAX_NIXIE_PLAYER_FRAMES < 10
+#  error "Too few player frames to cycle all the digits"
+#endif
+
+// Get digit which corresponds to the given cathode of the given tube type.
+// Returns '0' for cathodes which do not correspond to a digit.
+static char nixieCathodeIndexToDigit(NixieType type, int8_t cathode) {
+  char digit;
+  for (digit = '0'; digit <= '9'; ++digit) {
+    if (nixieSymbolToCathodeIndex(type, digit) == cathode) {
+      return digit;
+    }
+  }
+  return '0';
+}
+
+// Deadline of the given frame, in system timer counts.
+static uint64_t playerFrameDeadline(const AppNixiePlayer* player,
+                                    size_t frame) {
+  return player->start_time +
+         (uint64_t)frame * SYS_TMR_SystemCountFrequencyGet() / player->fps;
+}
+
+static void playerPlayFrame(AppNixieData* app_nixie_data) {
+  AppNixiePlayer* player = &app_nixie_data->player;
+  const size_t total_num_frames = player->num_frames * player->num_loops;
+  const uint64_t current_time = SYS_TMR_SystemCountGet();
+  size_t frame = player->next_frame;
+  if (current_time < playerFrameDeadline(player, frame)) {
+    return;
+  }
+  if (isShiftRegisterBusy(app_nixie_data)) {
+    // Previous frame is still being transmitted. If this takes longer than
+    // the frame interval, the deadline will be counted as missed below.
+    return;
+  }
+  // Skip all frames which are already late, but always show the last one.
+  while (frame + 1 < total_num_frames &&
+         current_time >= playerFrameDeadline(player, frame + 1)) {
+    ++frame;
+    ++player->num_missed_deadlines;
+  }
+  sendFrame(app_nixie_data,
+            player->frames +
+                (frame % player->num_frames) * NUM_NIXIE_SHIFT_REGISTERS);
+  ++player->num_frames_played;
+  player->next_frame = frame + 1;
+  if (player->next_frame == total_num_frames) {
+    player->state = APP_NIXIE_PLAYER_STATE_RESTORE;
+  }
+}
+
+static void playerRestoreFrame(AppNixieData* app_nixie_data) {
+  const AppNixiePlayer* player = &app_nixie_data->player;
+  const size_t total_num_frames = player->num_frames * player->num_loops;
+  // Let the last frame to be shown for the whole frame interval.
+  if (SYS_TMR_SystemCountGet() <
+      playerFrameDeadline(player, total_num_frames)) {
+    return;
+  }
+  if (isShiftRegisterBusy(app_nixie_data)) {
+    return;
+  }
+  NIXIE_DEBUG_MESSAGE("Sequence finished, restoring display frame.\r\n");
+  sendFrame(app_nixie_data, app_nixie_data->register_shift_state);
+  app_nixie_data->player.state = APP_NIXIE_PLAYER_STATE_IDLE;
 }
 
 ////////////////////////////////////////
@@ -422,17 +822,18 @@ typedef enum PeriodicTime {
 
 static void schedulePeriodicTask(AppNixieData* app_nixie_data,
                                  PeriodicTime time) {
-  uint64_t interval;
+  uint32_t interval;
   switch (time) {
     case PERIODIC_TIME_FAST:
       interval = PERIODIC_INTERVAL_FAST;
       break;
     case PERIODIC_TIME_NORMAL:
-      interval = PERIODIC_INTERVAL_NORMAL;
+      interval = app_nixie_data->periodic_interval;
       break;
   }
-  app_nixie_data->periodic_next_time =
-      SYS_TMR_SystemCountGet() + SYS_TMR_SystemCountFrequencyGet() * interval;
+  APP_Timer_Start(app_nixie_data->app_timer_wheel,
+                  &app_nixie_data->periodic_timer,
+                  interval * 1000);
 }
 
 static void performPeriodicTasks(AppNixieData* app_nixie_data) {
@@ -440,7 +841,7 @@ static void performPeriodicTasks(AppNixieData* app_nixie_data) {
     // Periodic tasks are not enabled, so we shouldn't be doing anything here.
     return;
   }
-  if (SYS_TMR_SystemCountGet() < app_nixie_data->periodic_next_time) {
+  if (!APP_Timer_IsExpired(&app_nixie_data->periodic_timer)) {
     // The time for next periodic tasks did not come yet.
     return;
   }
@@ -459,16 +860,69 @@ static void performPeriodicTasks(AppNixieData* app_nixie_data) {
   schedulePeriodicTask(app_nixie_data, PERIODIC_TIME_NORMAL);
 }
 
+////////////////////////////////////////
+// State machine.
+
+static void performStep(AppNixieData* app_nixie_data) {
+  switch (app_nixie_data->state) {
+    case APP_NIXIE_STATE_IDLE:
+      app_nixie_data->task_from_periodic = false;
+      performPeriodicTasks(app_nixie_data);
+      break;
+
+    case APP_NIXIE_STATE_ERROR:
+      // TODO(sergey): Check whether it was a recoverable error.
+      finishSequence(app_nixie_data);
+      // If error happened from periodic, schedule next update as soon as
+      // possible.
+      if (app_nixie_data->task_from_periodic) {
+          schedulePeriodicTask(app_nixie_data, PERIODIC_TIME_FAST);
+      }
+      break;
+
+    case APP_NIXIE_STATE_BEGIN_HTTP_REQUEST:
+      app_nixie_data->state = APP_NIXIE_STATE_WAIT_HTTPS_CLIENT;
+      break;
+    case APP_NIXIE_STATE_WAIT_HTTPS_CLIENT:
+      waitHttpsClientAndSendRequest(app_nixie_data);
+      break;
+    case APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE:
+      // NOTE: Nothing to do, all interaction is done via HTTP(S) callbacks.
+      break;
+    case APP_NIXIE_STATE_SHUFFLE_SERVER_VALUE:
+      shuffleServerValueDigits(app_nixie_data);
+      break;
+
+    case APP_NIXIE_STATE_BEGIN_DISPLAY_SEQUENCE:
+      app_nixie_data->state = APP_NIXIE_STATE_DECODE_DISPLAY_VALUE;
+      break;
+    case APP_NIXIE_STATE_DECODE_DISPLAY_VALUE:
+      decodeDisplayValue(app_nixie_data);
+      break;
+    case APP_NIXIE_STATE_ENCODE_SHIFT_REGISTER:
+      encodeShiftRegister(app_nixie_data);
+      break;
+    case APP_NIXIE_STATE_WRITE_SHIFT_REGISTER:
+      writeShiftRegister(app_nixie_data);
+      break;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public API.
 
 void APP_Nixie_Initialize(AppNixieData* app_nixie_data,
                           AppHTTPSClientData* app_https_client_data,
-                          AppShiftRegisterData* app_shift_register_data) {
+                          AppShiftRegisterData* app_shift_register_data,
+                          AppRTCData* app_rtc_data,
+                          AppTimerWheel* app_timer_wheel,
+                          AppEventBus* app_event_bus) {
+  int board;
 #define NIXIE_REGISTER_BEGIN(app_nixie_data)                           \
   do {                                                                 \
     AppNixieData* data = app_nixie_data;                               \
     data->num_nixies = 0;                                              \
+    data->num_shift_registers = 0;                                     \
     (void) 0
 #define NIXIE_TUBE_BEGIN(type)                                         \
   do {                                                                 \
@@ -476,167 +930,218 @@ void APP_Nixie_Initialize(AppNixieData* app_nixie_data,
       NIXIE_DEBUG_PRINT("Adding %s to display.\r\n",                   \
                         nixieTypeStringify(type));                     \
       (void) 0
+#define NIXIE_BOARD_BEGIN(board_index)                                 \
+  do {                                                                 \
+    const int first_shift_byte =                                       \
+        (board_index) * NIXIE_BOARD_NUM_SHIFT_REGISTERS;               \
+    (void) 0
 #define NIXIE_CATHODE(symbol, cathode_index, shift_byte, shift_bit)    \
   do {                                                                 \
-    data->cathode_mapping[data->num_nixies][cathode_index].byte = shift_byte;  \
-    data->cathode_mapping[data->num_nixies][cathode_index].bit = shift_bit;    \
+    const int byte = first_shift_byte + (shift_byte);                  \
+    data->cathode_mapping[data->num_nixies][cathode_index].byte = byte; \
+    data->cathode_mapping[data->num_nixies][cathode_index].bit = shift_bit; \
+    if (byte >= data->num_shift_registers) {                           \
+      data->num_shift_registers = byte + 1;                            \
+    }                                                                  \
   } while (false)
 #define NIXIE_TUBE_END()                                               \
     ++data->num_nixies;                                                \
   } while (false)
+#define NIXIE_BOARD_END()                                              \
+  } while (false)
 #define NIXIE_REGISTER_END()                                           \
-    NIXIE_DEBUG_PRINT("Registered display of %d tubes.\r\n",           \
-                      data->num_nixies);                               \
+    SYS_ASSERT(data->num_nixies == MAX_NIXIE_TUBES,                    \
+               "\r\nWiring does not match number of nixie tubes");       \
+    SYS_ASSERT(data->num_shift_registers <= NUM_NIXIE_SHIFT_REGISTERS, \
+               "\r\nToo many shift registers in the display");          \
+    NIXIE_DEBUG_PRINT("Registered display of %d tubes "                \
+                      "on %d shift registers.\r\n",                    \
+                      data->num_nixies, data->num_shift_registers);    \
   } while (false)
 
   app_nixie_data->state = APP_NIXIE_STATE_IDLE;
   app_nixie_data->app_https_client_data = app_https_client_data;
   app_nixie_data->app_shift_register_data = app_shift_register_data;
+  app_nixie_data->app_rtc_data = app_rtc_data;
+  app_nixie_data->app_timer_wheel = app_timer_wheel;
+  app_nixie_data->app_event_bus = app_event_bus;
+  app_nixie_data->is_waiting_https_client = false;
+  app_nixie_data->is_waiting_shift_register = false;
+  if (!APP_Event_Subscribe(app_event_bus,
+                        APP_EVENT_MASK(APP_EVENT_HTTPS_CLIENT_DONE) |
+                        APP_EVENT_MASK(APP_EVENT_SHIFT_REGISTER_DONE),
+                        resourceEventCallback,
+                        app_nixie_data)) {
+    SYS_ASSERT(false, "\r\nNot enough event bus subscriber slots\r\n");
+  }
   app_nixie_data->display_value_out = NULL;
 
   // Set up periodic tasks to fire up as soon as possible.
   app_nixie_data->periodic_tasks_enabled = true;
-  app_nixie_data->periodic_next_time = 0;
+  APP_Timer_Setup(&app_nixie_data->periodic_timer, NULL, NULL);
+  APP_Timer_Start(app_timer_wheel, &app_nixie_data->periodic_timer, 0);
   app_nixie_data->task_from_periodic = false;
+  app_nixie_data->periodic_interval = PERIODIC_INTERVAL_NORMAL;
 
   // ======== Nixie display information =======
   // Fill in nixies information.
+  // Every board has the same wiring, shifted by the number of registers of the
+  // boards which are preceding it in the chain.
   // TODO(sergey): Make it some sort of runtime configuration?
   // TODO(sergey): Make it a proper wiring diagram here.
   NIXIE_REGISTER_BEGIN(app_nixie_data);
-    NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J2 */
-      // NIXIE_CATHODE('.', 12, 3, 2);  /* 2 */
-      NIXIE_CATHODE('0', 2,  3, 3);  /* 1 */
-      NIXIE_CATHODE('9', 3,  3, 1);  /* 4 */
-      NIXIE_CATHODE('8', 4,  3, 4);  /* 3 */
-      NIXIE_CATHODE('7', 5,  3, 0);  /* 6 */
-      NIXIE_CATHODE('6', 6,  3, 5);  /* 5 */
-      NIXIE_CATHODE('5', 7,  2, 7);  /* 8 */
-      NIXIE_CATHODE('4', 8,  3, 6);  /* 7 */
-      NIXIE_CATHODE('3', 9,  2, 6);  /* 10 */
-      NIXIE_CATHODE('2', 10, 3, 7);  /* 9 */
-      NIXIE_CATHODE('1', 11, 2, 5);  /* 12 */
-    NIXIE_TUBE_END();
-    NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J3 */
-      // NIXIE_CATHODE('.', 12, 1, 7);  /* 2 */
-      NIXIE_CATHODE('0', 2,  2, 0);  /* 1 */
-      NIXIE_CATHODE('9', 3,  1, 6);  /* 4 */
-      NIXIE_CATHODE('8', 4,  2, 1);  /* 3 */
-      NIXIE_CATHODE('7', 5,  1, 5);  /* 6 */
-      NIXIE_CATHODE('6', 6,  2, 2);  /* 5 */
-      NIXIE_CATHODE('5', 7,  1, 4);  /* 8 */
-      NIXIE_CATHODE('4', 8,  2, 3);  /* 7 */
-      NIXIE_CATHODE('3', 9,  1, 0);  /* 10 */
-      NIXIE_CATHODE('2', 10, 2, 4);  /* 9 */
-      NIXIE_CATHODE('1', 11, 1, 1);  /* 12 */
-    NIXIE_TUBE_END();
-    NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J4 */
-      // NIXIE_CATHODE('.', 12, 0, 4);  /* 2 */
-      NIXIE_CATHODE('0', 2,  1, 2);  /* 1 */
-      NIXIE_CATHODE('9', 3,  0, 0);  /* 4 */
-      NIXIE_CATHODE('8', 4,  1, 3);  /* 3 */
-      NIXIE_CATHODE('7', 5,  0, 1);  /* 6 */
-      NIXIE_CATHODE('6', 6,  0, 7);  /* 5 */
-      NIXIE_CATHODE('5', 7,  0, 2);  /* 8 */
-      NIXIE_CATHODE('4', 8,  0, 6);  /* 7 */
-      NIXIE_CATHODE('3', 9,  0, 3);  /* 10 */
-      NIXIE_CATHODE('2', 10, 0, 5);  /* 9 */
-      NIXIE_CATHODE('1', 11, 5, 3);  /* 12 */
-    NIXIE_TUBE_END();
-    NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J5 */
-      // NIXIE_CATHODE('.', 12, 4, 7);  /* 2 */
-      NIXIE_CATHODE('0', 2,  4, 5);  /* 1 */
-      NIXIE_CATHODE('9', 3,  4, 6);  /* 4 */
-      NIXIE_CATHODE('8', 4,  4, 4);  /* 3 */
-      NIXIE_CATHODE('7', 5,  5, 7);  /* 6 */
-      NIXIE_CATHODE('6', 6,  5, 0);  /* 5 */
-      NIXIE_CATHODE('5', 7,  5, 6);  /* 8 */
-      NIXIE_CATHODE('4', 8,  5, 1);  /* 7 */
-      NIXIE_CATHODE('3', 9,  5, 5);  /* 10 */
-      NIXIE_CATHODE('2', 10, 5, 2);  /* 9 */
-      NIXIE_CATHODE('1', 11, 5, 4);  /* 12 */
-    NIXIE_TUBE_END();
+  for (board = 0; board < NIXIE_NUM_BOARDS; ++board) {
+    NIXIE_BOARD_BEGIN(board);
+      NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J2 */
+        // NIXIE_CATHODE('.', 12, 3, 2);  /* 2 */
+        NIXIE_CATHODE('0', 2,  3, 3);  /* 1 */
+        NIXIE_CATHODE('9', 3,  3, 1);  /* 4 */
+        NIXIE_CATHODE('8', 4,  3, 4);  /* 3 */
+        NIXIE_CATHODE('7', 5,  3, 0);  /* 6 */
+        NIXIE_CATHODE('6', 6,  3, 5);  /* 5 */
+        NIXIE_CATHODE('5', 7,  2, 7);  /* 8 */
+        NIXIE_CATHODE('4', 8,  3, 6);  /* 7 */
+        NIXIE_CATHODE('3', 9,  2, 6);  /* 10 */
+        NIXIE_CATHODE('2', 10, 3, 7);  /* 9 */
+        NIXIE_CATHODE('1', 11, 2, 5);  /* 12 */
+      NIXIE_TUBE_END();
+      NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J3 */
+        // NIXIE_CATHODE('.', 12, 1, 7);  /* 2 */
+        NIXIE_CATHODE('0', 2,  2, 0);  /* 1 */
+        NIXIE_CATHODE('9', 3,  1, 6);  /* 4 */
+        NIXIE_CATHODE('8', 4,  2, 1);  /* 3 */
+        NIXIE_CATHODE('7', 5,  1, 5);  /* 6 */
+        NIXIE_CATHODE('6', 6,  2, 2);  /* 5 */
+        NIXIE_CATHODE('5', 7,  1, 4);  /* 8 */
+        NIXIE_CATHODE('4', 8,  2, 3);  /* 7 */
+        NIXIE_CATHODE('3', 9,  1, 0);  /* 10 */
+        NIXIE_CATHODE('2', 10, 2, 4);  /* 9 */
+        NIXIE_CATHODE('1', 11, 1, 1);  /* 12 */
+      NIXIE_TUBE_END();
+      NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J4 */
+        // NIXIE_CATHODE('.', 12, 0, 4);  /* 2 */
+        NIXIE_CATHODE('0', 2,  1, 2);  /* 1 */
+        NIXIE_CATHODE('9', 3,  0, 0);  /* 4 */
+        NIXIE_CATHODE('8', 4,  1, 3);  /* 3 */
+        NIXIE_CATHODE('7', 5,  0, 1);  /* 6 */
+        NIXIE_CATHODE('6', 6,  0, 7);  /* 5 */
+        NIXIE_CATHODE('5', 7,  0, 2);  /* 8 */
+        NIXIE_CATHODE('4', 8,  0, 6);  /* 7 */
+        NIXIE_CATHODE('3', 9,  0, 3);  /* 10 */
+        NIXIE_CATHODE('2', 10, 0, 5);  /* 9 */
+        NIXIE_CATHODE('1', 11, 5, 3);  /* 12 */
+      NIXIE_TUBE_END();
+      NIXIE_TUBE_BEGIN(NIXIE_TYPE_IN12A);  /* J5 */
+        // NIXIE_CATHODE('.', 12, 4, 7);  /* 2 */
+        NIXIE_CATHODE('0', 2,  4, 5);  /* 1 */
+        NIXIE_CATHODE('9', 3,  4, 6);  /* 4 */
+        NIXIE_CATHODE('8', 4,  4, 4);  /* 3 */
+        NIXIE_CATHODE('7', 5,  5, 7);  /* 6 */
+        NIXIE_CATHODE('6', 6,  5, 0);  /* 5 */
+        NIXIE_CATHODE('5', 7,  5, 6);  /* 8 */
+        NIXIE_CATHODE('4', 8,  5, 1);  /* 7 */
+        NIXIE_CATHODE('3', 9,  5, 5);  /* 10 */
+        NIXIE_CATHODE('2', 10, 5, 2);  /* 9 */
+        NIXIE_CATHODE('1', 11, 5, 4);  /* 12 */
+      NIXIE_TUBE_END();
+    NIXIE_BOARD_END();
+  }
   NIXIE_REGISTER_END();
 
   // ======== HTTP(S) server information.
 
-  // TODO(sergey)L Make it some sort of stored configuration.
-  safe_strncpy(app_nixie_data->request_url,
-               "https://developer.blender.org/maniphest/project/2/type/Bug/query/open/",  // NOLINT
-               sizeof(app_nixie_data->request_url));
-  safe_strncpy(app_nixie_data->token,
-               ">Open Tasks (",
-               sizeof(app_nixie_data->token));
-  app_nixie_data->token_len = strlen(app_nixie_data->token);
-  app_nixie_data->max_cyclic_buffer_len =
-    2 * (app_nixie_data->token_len + app_nixie_data->num_nixies);
+  // NOTE: These are defaults, stored settings are applied once they are
+  // loaded, see APP_Nixie_RequestSet().
+  app_nixie_data->request_url[0] = '\0';
+  app_nixie_data->token[0] = '\0';
+  APP_Nixie_RequestSet(
+      app_nixie_data,
+      "https://developer.blender.org/maniphest/project/2/type/Bug/query/open/",  // NOLINT
+      ">Open Tasks (");
 
   // ======== Support components information ========
-  app_nixie_data->num_shift_registers = 6;
+  app_nixie_data->player.state = APP_NIXIE_PLAYER_STATE_IDLE;
+  app_nixie_data->player.num_frames_played = 0;
+  app_nixie_data->player.num_missed_deadlines = 0;
+  app_nixie_data->is_latched_shift_state_valid = false;
+  app_nixie_data->force_refresh = false;
+  app_nixie_data->num_frames_sent = 0;
+  app_nixie_data->num_frames_suppressed = 0;
   // Cleanup shift registers from previous run.
   memset(app_nixie_data->register_shift_state,
          0,
          sizeof(app_nixie_data->register_shift_state));
-  APP_ShiftRegister_SendData(app_shift_register_data,
-                             app_nixie_data->register_shift_state,
-                             app_nixie_data->num_shift_registers);
+  sendFrame(app_nixie_data, app_nixie_data->register_shift_state);
+
+  // ======== Snapshot ========
+  app_nixie_data->is_display_value_stale = false;
+  app_nixie_data->display_value_timestamp = 0;
+  app_nixie_data->display_value_etag[0] = '\0';
+  app_nixie_data->response_etag[0] = '\0';
+  app_nixie_data->is_in_headers = false;
+  app_nixie_data->is_snapshot_read_pending = false;
+  snapshotRestore(app_nixie_data);
 
   // Everything is done.
   SYS_MESSAGE("Nixie tubes subsystem initialized.\r\n");
 
 #undef NIXIE_REGISTER_BEGIN
+#undef NIXIE_BOARD_BEGIN
 #undef NIXIE_TUBE_BEGIN
+#undef NIXIE_CATHODE
 #undef NIXIE_TUBE_END
+#undef NIXIE_BOARD_END
 #undef NIXIE_REGISTER_END
 }
 
 void APP_Nixie_Tasks(AppNixieData* app_nixie_data) {
-  switch (app_nixie_data->state) {
-    case APP_NIXIE_STATE_IDLE:
-      app_nixie_data->task_from_periodic = false;
-      performPeriodicTasks(app_nixie_data);
-      break;
+  // Pass through all the states which don't wait for anything, so every
+  // transition does not cost a whole main loop iteration.
+  AppNixieState previous_state;
+  int num_steps = 0;
+  do {
+    previous_state = app_nixie_data->state;
+    performStep(app_nixie_data);
+  } while (app_nixie_data->state != previous_state &&
+           app_nixie_data->state != APP_NIXIE_STATE_IDLE &&
+           ++num_steps < APP_CONFIG_MAX_STATE_STEPS);
+}
 
-    case APP_NIXIE_STATE_ERROR:
-      // TODO(sergey): Check whether it was a recoverable error.
-      app_nixie_data->state = APP_NIXIE_STATE_IDLE;
-      // If error happened from periodic, schedule next update as soon as
-      // possible.
-      if (app_nixie_data->task_from_periodic) {
-          schedulePeriodicTask(app_nixie_data, PERIODIC_TIME_FAST);
-      }
-      break;
+bool APP_Nixie_IsBusy(AppNixieData* app_nixie_data) {
+  return app_nixie_data->state != APP_NIXIE_STATE_IDLE;
+}
 
-    case APP_NIXIE_STATE_BEGIN_HTTP_REQUEST:
-      app_nixie_data->state = APP_NIXIE_STATE_WAIT_HTTPS_CLIENT;
-      break;
+bool APP_Nixie_IsRunnable(AppNixieData* app_nixie_data) {
+  switch (app_nixie_data->state) {
+    case APP_NIXIE_STATE_IDLE:
+      return app_nixie_data->periodic_tasks_enabled &&
+             APP_Timer_IsExpired(&app_nixie_data->periodic_timer);
     case APP_NIXIE_STATE_WAIT_HTTPS_CLIENT:
-      waitHttpsClientAndSendRequest(app_nixie_data);
-      break;
+      return !app_nixie_data->is_waiting_https_client;
     case APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE:
-      // NOTE: Nothing to do, all interaction is done via HTTP(S) callbacks.
-      break;
-    case APP_NIXIE_STATE_SHUFFLE_SERVER_VALUE:
-      shuffleServerValueDigits(app_nixie_data);
-      break;
-
-    case APP_NIXIE_STATE_BEGIN_DISPLAY_SEQUENCE:
-      app_nixie_data->state = APP_NIXIE_STATE_DECODE_DISPLAY_VALUE;
-      break;
-    case APP_NIXIE_STATE_DECODE_DISPLAY_VALUE:
-      decodeDisplayValue(app_nixie_data);
-      break;
-    case APP_NIXIE_STATE_ENCODE_SHIFT_REGISTER:
-      encodeShiftRegister(app_nixie_data);
-      break;
+      // State is changed from the HTTP(S) client callbacks.
+      return false;
     case APP_NIXIE_STATE_WRITE_SHIFT_REGISTER:
-      writeShiftRegister(app_nixie_data);
+      return !app_nixie_data->is_waiting_shift_register;
+    default:
       break;
   }
+  return true;
 }
 
-bool APP_Nixie_IsBusy(AppNixieData* app_nixie_data) {
-  return app_nixie_data->state != APP_NIXIE_STATE_IDLE;
+uint32_t APP_Nixie_StateBudget(AppNixieState state) {
+  switch (state) {
+    case APP_NIXIE_STATE_IDLE:
+      return APP_SUPERVISOR_NO_BUDGET;
+    case APP_NIXIE_STATE_WAIT_HTTPS_CLIENT:
+    case APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE:
+      // HTTP(S) client is supervised on its own: it might be busy with a long
+      // download for minutes, and aborted request is reported back via error
+      // callback.
+      return APP_SUPERVISOR_NO_BUDGET;
+    default:
+      return 1000;
+  }
 }
 
 bool APP_Nixie_Display(AppNixieData* app_nixie_data,
@@ -645,19 +1150,206 @@ bool APP_Nixie_Display(AppNixieData* app_nixie_data,
     return false;
   }
   NIXIE_DEBUG_PRINT("Requested to display " NIXIE_DISPLAY_FORMAT "\r\n",
-                    NIXIE_DISPLAY_VALUES(value));
+                    NIXIE_DISPLAY_VALUES(app_nixie_data, value));
   // Make sure all possibly unused digits are zeroed.
   memset(app_nixie_data->display_value,
          0,
          sizeof(app_nixie_data->display_value));
   // Copy at max of display size digits.
-  strncpy(app_nixie_data->display_value,
-          value,
-          sizeof(app_nixie_data->display_value));
+  strncpy(app_nixie_data->display_value, value, app_nixie_data->num_nixies);
   app_nixie_data->state = APP_NIXIE_STATE_BEGIN_DISPLAY_SEQUENCE;
   return true;
 }
 
+bool APP_Nixie_Refresh(AppNixieData* app_nixie_data) {
+  if (APP_Nixie_IsBusy(app_nixie_data)) {
+    return false;
+  }
+  NIXIE_DEBUG_MESSAGE("Requested to refresh display.\r\n");
+  // NOTE: When the module is idle register_shift_state contains the frame
+  // which was encoded last, so we simply re-send it.
+  app_nixie_data->force_refresh = true;
+  app_nixie_data->state = APP_NIXIE_STATE_WRITE_SHIFT_REGISTER;
+  return true;
+}
+
+void APP_Nixie_LatchedStateInvalidate(AppNixieData* app_nixie_data) {
+  app_nixie_data->is_latched_shift_state_valid = false;
+}
+
+void APP_Nixie_FrameStatisticsGet(AppNixieData* app_nixie_data,
+                                  uint32_t* num_frames_sent,
+                                  uint32_t* num_frames_suppressed) {
+  *num_frames_sent = app_nixie_data->num_frames_sent;
+  *num_frames_suppressed = app_nixie_data->num_frames_suppressed;
+}
+
+void APP_Nixie_FrameStatisticsReset(AppNixieData* app_nixie_data) {
+  app_nixie_data->num_frames_sent = 0;
+  app_nixie_data->num_frames_suppressed = 0;
+  app_nixie_data->player.num_frames_played = 0;
+  app_nixie_data->player.num_missed_deadlines = 0;
+}
+
+bool APP_Nixie_PlayerStart(AppNixieData* app_nixie_data,
+                           const uint8_t* frames,
+                           size_t num_frames,
+                           size_t num_loops,
+                           uint16_t fps) {
+  AppNixiePlayer* player = &app_nixie_data->player;
+  if (APP_Nixie_PlayerIsActive(app_nixie_data)) {
+    return false;
+  }
+  if (num_frames == 0 || num_loops == 0 || fps == 0 ||
+      fps > SYS_TMR_SystemCountFrequencyGet()) {
+    return false;
+  }
+  NIXIE_DEBUG_PRINT("Playing %d frames %d times at %d fps.\r\n",
+                    num_frames, num_loops, fps);
+  player->frames = frames;
+  player->num_frames = num_frames;
+  player->num_loops = num_loops;
+  player->next_frame = 0;
+  player->fps = fps;
+  player->start_time = SYS_TMR_SystemCountGet();
+  player->state = APP_NIXIE_PLAYER_STATE_PLAYING;
+  return true;
+}
+
+bool APP_Nixie_PlayerStartCathodeCleanup(AppNixieData* app_nixie_data,
+                                         size_t num_loops,
+                                         uint16_t fps) {
+  AppNixiePlayer* player = &app_nixie_data->player;
+  int8_t cathodes[MAX_NIXIE_TUBES];
+  char digit;
+  int8_t i;
+  if (APP_Nixie_PlayerIsActive(app_nixie_data)) {
+    return false;
+  }
+  for (digit = '0'; digit <= '9'; ++digit) {
+    for (i = 0; i < app_nixie_data->num_nixies; ++i) {
+      const int8_t nixie_index = app_nixie_data->num_nixies - i - 1;
+      cathodes[i] = nixieSymbolToCathodeIndex(
+          app_nixie_data->nixie_types[nixie_index], digit);
+    }
+    encodeFrame(app_nixie_data, cathodes, player->frame_storage[digit - '0']);
+  }
+  return APP_Nixie_PlayerStart(app_nixie_data,
+                               &player->frame_storage[0][0],
+                               10,
+                               num_loops,
+                               fps);
+}
+
+bool APP_Nixie_PlayerStartRoll(AppNixieData* app_nixie_data,
+                               const char value[MAX_NIXIE_TUBES],
+                               uint16_t fps) {
+  AppNixiePlayer* player = &app_nixie_data->player;
+  int8_t target_cathodes[MAX_NIXIE_TUBES];
+  char start_digits[MAX_NIXIE_TUBES];
+  int8_t num_steps[MAX_NIXIE_TUBES];
+  int8_t cathodes[MAX_NIXIE_TUBES];
+  size_t num_frames = 0, frame;
+  int8_t i;
+  if (APP_Nixie_IsBusy(app_nixie_data) ||
+      APP_Nixie_PlayerIsActive(app_nixie_data)) {
+    return false;
+  }
+  decodeValue(app_nixie_data, value, target_cathodes);
+  // Every tube rolls from its current digit to the target one, making one
+  // extra revolution if there is enough frames for that.
+  for (i = 0; i < app_nixie_data->num_nixies; ++i) {
+    const int8_t nixie_index = app_nixie_data->num_nixies - i - 1;
+    const NixieType type = app_nixie_data->nixie_types[nixie_index];
+    const char target_digit =
+        nixieCathodeIndexToDigit(type, target_cathodes[i]);
+    start_digits[i] =
+        nixieCathodeIndexToDigit(type, app_nixie_data->cathodes[i]);
+    num_steps[i] = (target_digit - start_digits[i] + 10) % 10;
+  }
+  for (i = 0; i < app_nixie_data->num_nixies; ++i) {
+    if (MAX_NIXIE_PLAYER_FRAMES >= 20) {
+      num_steps[i] += 10;
+    }
+    if ((size_t)num_steps[i] + 1 > num_frames) {
+      num_frames = num_steps[i] + 1;
+    }
+  }
+  for (frame = 0; frame < num_frames; ++frame) {
+    for (i = 0; i < app_nixie_data->num_nixies; ++i) {
+      const int8_t nixie_index = app_nixie_data->num_nixies - i - 1;
+      if (frame >= (size_t)num_steps[i]) {
+        cathodes[i] = target_cathodes[i];
+      } else {
+        const char digit = '0' + (start_digits[i] - '0' + frame) % 10;
+        cathodes[i] = nixieSymbolToCathodeIndex(
+            app_nixie_data->nixie_types[nixie_index], digit);
+      }
+    }
+    encodeFrame(app_nixie_data, cathodes, player->frame_storage[frame]);
+  }
+  // Roll ends up showing the new value, so make it current one.
+  memcpy(app_nixie_data->display_value,
+         value,
+         sizeof(app_nixie_data->display_value));
+  memcpy(app_nixie_data->cathodes,
+         target_cathodes,
+         sizeof(app_nixie_data->cathodes));
+  encodeFrame(app_nixie_data,
+              app_nixie_data->cathodes,
+              app_nixie_data->register_shift_state);
+  return APP_Nixie_PlayerStart(app_nixie_data,
+                               &player->frame_storage[0][0],
+                               num_frames,
+                               1,
+                               fps);
+}
+
+void APP_Nixie_PlayerTasks(AppNixieData* app_nixie_data) {
+  switch (app_nixie_data->player.state) {
+    case APP_NIXIE_PLAYER_STATE_IDLE:
+      break;
+    case APP_NIXIE_PLAYER_STATE_PLAYING:
+      playerPlayFrame(app_nixie_data);
+      break;
+    case APP_NIXIE_PLAYER_STATE_RESTORE:
+      playerRestoreFrame(app_nixie_data);
+      break;
+  }
+}
+
+bool APP_Nixie_PlayerIsActive(AppNixieData* app_nixie_data) {
+  return app_nixie_data->player.state != APP_NIXIE_PLAYER_STATE_IDLE;
+}
+
+bool APP_Nixie_PlayerIsRunnable(AppNixieData* app_nixie_data,
+                                uint64_t* next_deadline) {
+  const AppNixiePlayer* player = &app_nixie_data->player;
+  switch (player->state) {
+    case APP_NIXIE_PLAYER_STATE_IDLE:
+      break;
+    case APP_NIXIE_PLAYER_STATE_PLAYING:
+    case APP_NIXIE_PLAYER_STATE_RESTORE:
+      if (app_nixie_data->is_waiting_shift_register) {
+        // Deadline is re-evaluated once transmission of the previous frame
+        // is over.
+        break;
+      }
+      // NOTE: In the restore state next_frame points past the last frame, so
+      // this is the moment when the last frame finished being shown.
+      *next_deadline = playerFrameDeadline(player, player->next_frame);
+      break;
+  }
+  return false;
+}
+
+void APP_Nixie_PlayerStatisticsGet(AppNixieData* app_nixie_data,
+                                   uint32_t* num_frames_played,
+                                   uint32_t* num_missed_deadlines) {
+  *num_frames_played = app_nixie_data->player.num_frames_played;
+  *num_missed_deadlines = app_nixie_data->player.num_missed_deadlines;
+}
+
 bool APP_Nixie_Fetch(AppNixieData* app_nixie_data,
                      bool* is_fetched,
                      char value[MAX_NIXIE_TUBES]) {
@@ -672,6 +1364,18 @@ bool APP_Nixie_Fetch(AppNixieData* app_nixie_data,
   return true;
 }
 
+const char* APP_Nixie_DisplayValueToString(const char value[MAX_NIXIE_TUBES],
+                                           int num_nixies,
+                                           char str[MAX_NIXIE_TUBES + 1]) {
+  int i;
+  for (i = 0; i < num_nixies; ++i) {
+    const char ch = value[num_nixies - i - 1];
+    str[i] = ch ? ch : '_';
+  }
+  str[num_nixies] = '\0';
+  return str;
+}
+
 bool APP_Nixie_PeriodicTasksEnabled(AppNixieData* app_nixie_data) {
   return app_nixie_data->periodic_tasks_enabled;
 }
@@ -680,3 +1384,38 @@ void APP_Nixie_PeriodicTasksSetEnabled(AppNixieData* app_nixie_data,
                                        bool enabled) {
   app_nixie_data->periodic_tasks_enabled = enabled;
 }
+
+void APP_Nixie_PeriodicIntervalSet(AppNixieData* app_nixie_data,
+                                   uint32_t interval) {
+  app_nixie_data->periodic_interval = interval;
+}
+
+bool APP_Nixie_RequestSet(AppNixieData* app_nixie_data,
+                          const char* url,
+                          const char* token) {
+  if (APP_Nixie_IsBusy(app_nixie_data)) {
+    // Token is used by the response parser, can't change it in the middle.
+    return false;
+  }
+  const size_t url_len = strlen(url);
+  if (url_len >= sizeof(app_nixie_data->request_url)) {
+    NIXIE_ERROR_PRINT("URL of %d characters is too long.\r\n", (int)url_len);
+  } else if (url_len != 0) {
+    safe_strncpy(app_nixie_data->request_url,
+                 url,
+                 sizeof(app_nixie_data->request_url));
+  }
+  const size_t token_len = strlen(token);
+  if (token_len >= sizeof(app_nixie_data->token)) {
+    NIXIE_ERROR_PRINT("Token of %d characters is too long.\r\n",
+                      (int)token_len);
+  } else if (token_len != 0) {
+    safe_strncpy(app_nixie_data->token,
+                 token,
+                 sizeof(app_nixie_data->token));
+    app_nixie_data->token_len = token_len;
+    app_nixie_data->max_cyclic_buffer_len =
+      2 * (app_nixie_data->token_len + app_nixie_data->num_nixies);
+  }
+  return true;
+}
@@ -27,26 +27,46 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "app_config.h"
 #include "app_https_client.h"
+#include "app_timer.h"
 
 struct AppHTTPSClientData;
+struct AppRTCData;
 struct AppShiftRegisterData;
+struct AppTimerWheel;
 
 // Maximum number of nixie tubes in the display.
-#define MAX_NIXIE_TUBES 4
+#define MAX_NIXIE_TUBES APP_CONFIG_NUM_NIXIE_TUBES
 // Maximum number of shift registers guarding all the tubes.
-#define NUM_NIXIE_SHIFT_REGISTERS 6
+#define NUM_NIXIE_SHIFT_REGISTERS APP_CONFIG_NUM_SHIFT_REGISTERS
 // Maximum number of cathodes in supported nixie tube type.
 #define MAX_NIXIE_CATHODE 12
+// Maximum number of frames in sequences generated by the nixie module itself.
+#define MAX_NIXIE_PLAYER_FRAMES APP_CONFIG_NUM_NIXIE_PLAYER_FRAMES
 // Maximal length of token used for parsing HTML page.
 #define MAX_NIXIE_TOKEN 64
+// Maximal length of ETag of the server response, including null-terminator.
+// Longer tags are ignored.
+#define MAX_NIXIE_ETAG 40
+// Maximal length of the response header line which is inspected for ETag.
+#define MAX_NIXIE_HEADER_LINE (MAX_NIXIE_ETAG + 16)
+// Size of the snapshot of the displayed value in the RTC SRAM: magic, time
+// stamp, value, ETag length, ETag and checksum.
+#define NIXIE_SNAPSHOT_SIZE (2 + 4 + MAX_NIXIE_TUBES + 1 + MAX_NIXIE_ETAG + 1)
 
-#define NIXIE_DISPLAY_FORMAT "%c%c%c%c"
-#define NIXIE_DISPLAY_VALUES(value)  \
-  value[3] ? value[3] : '_',         \
-  value[2] ? value[2] : '_',         \
-  value[1] ? value[1] : '_',         \
-  value[0] ? value[0] : '_'
+// Helpers to print display value using printf-like functions:
+//
+//   printf("Value " NIXIE_DISPLAY_FORMAT "\n",
+//          NIXIE_DISPLAY_VALUES(app_nixie_data, value));
+//
+// NOTE: Uses temporary storage which only lives until the end of the enclosing
+// block.
+#define NIXIE_DISPLAY_FORMAT "%s"
+#define NIXIE_DISPLAY_VALUES(app_nixie_data, value)                     \
+  APP_Nixie_DisplayValueToString(value,                                 \
+                                 (app_nixie_data)->num_nixies,          \
+                                 (char[MAX_NIXIE_TUBES + 1]){0})
 
 typedef enum {
   NIXIE_TYPE_IN12A,
@@ -81,6 +101,40 @@ typedef enum {
   APP_NIXIE_STATE_WRITE_SHIFT_REGISTER,
 } AppNixieState;
 
+typedef enum {
+  // No sequence is being played.
+  APP_NIXIE_PLAYER_STATE_IDLE,
+  // Frames are being streamed to the shift registers.
+  APP_NIXIE_PLAYER_STATE_PLAYING,
+  // Sequence is over, bring frame of the current display value back.
+  APP_NIXIE_PLAYER_STATE_RESTORE,
+} AppNixiePlayerState;
+
+// Player of pre-computed sequence of shift register frames.
+//
+// Frames are sent at a fixed rate, at the deadlines calculated from the time
+// when sequence started. If the transport does not keep up, late frames are
+// skipped and counted as missed deadlines.
+typedef struct AppNixiePlayer {
+  AppNixiePlayerState state;
+  // Frames to be played, each of them is NUM_NIXIE_SHIFT_REGISTERS bytes.
+  const uint8_t* frames;
+  size_t num_frames;
+  // Number of times the sequence is to be played.
+  size_t num_loops;
+  // Index of the next frame to be sent, counting frames of all loops.
+  size_t next_frame;
+  // Frame rate of the sequence.
+  uint16_t fps;
+  // Time when sequence started, in system timer counts.
+  uint64_t start_time;
+  // Statistics.
+  uint32_t num_frames_played;
+  uint32_t num_missed_deadlines;
+  // Storage for sequences generated by the nixie module.
+  uint8_t frame_storage[MAX_NIXIE_PLAYER_FRAMES][NUM_NIXIE_SHIFT_REGISTERS];
+} AppNixiePlayer;
+
 // Correspondence between cathode and shift register bit.
 //
 // Shift register bit is denoted by the byte (aka, shift register index) and
@@ -93,15 +147,26 @@ typedef struct NixieCathodeBit {
 typedef struct AppNixieData {
   struct AppHTTPSClientData* app_https_client_data;
   struct AppShiftRegisterData* app_shift_register_data;
+  struct AppRTCData* app_rtc_data;
+  struct AppTimerWheel* app_timer_wheel;
+  struct AppEventBus* app_event_bus;
 
   AppNixieState state;
 
+  // ======== Resources ========
+  // Set when the resource was found busy, cleared when the resource posts its
+  // completion event. Module is not runnable while it waits for a resource.
+  bool is_waiting_https_client;
+  bool is_waiting_shift_register;
+
   // ======== Periodic tasks ========
   // Denotes whether periodic tasks are enabled.
   bool periodic_tasks_enabled;
-  // Next time when periodic tasks will take place.
-  uint64_t periodic_next_time;
+  // Expires when it's time for periodic tasks to take place.
+  AppTimer periodic_timer;
   bool task_from_periodic;
+  // Interval in seconds between periodic tasks once the display has a value.
+  uint32_t periodic_interval;
 
   // ======== Static information about display ========
   // Number of nixie tubes in the display.
@@ -133,6 +198,13 @@ typedef struct AppNixieData {
   // We only store actually required number of bytes, so we don't waste extra
   // time on substring search and memory shift.
   size_t max_cyclic_buffer_len;
+  // Response headers are scanned line by line for ETag, until the empty line
+  // which separates them from the body.
+  bool is_in_headers;
+  char header_line[MAX_NIXIE_HEADER_LINE];
+  size_t header_line_len;
+  // ETag of the current response, empty if server did not send it.
+  char response_etag[MAX_NIXIE_ETAG];
 
   // ======== Display routines ========
   // Value requested to be displayed.
@@ -147,6 +219,39 @@ typedef struct AppNixieData {
   // `app_*_data` names, since this array is kind of a data.
   uint8_t register_shift_state[NUM_NIXIE_SHIFT_REGISTERS];
 
+  // ======== Frame diffing ========
+  // State of shift registers which was sent to the hardware the last time.
+  // Used to avoid re-transmission of frames which will not change anything.
+  uint8_t latched_shift_state[NUM_NIXIE_SHIFT_REGISTERS];
+  // Denotes whether latched_shift_state matches the hardware.
+  bool is_latched_shift_state_valid;
+  // When truth, next frame will be sent to the shift registers even if it is
+  // the same as the latched one.
+  bool force_refresh;
+  // Statistics about frames which were passed to the shift registers.
+  uint32_t num_frames_sent;
+  uint32_t num_frames_suppressed;
+
+  // ======== Animation ========
+  AppNixiePlayer player;
+
+  // ======== Snapshot ========
+  // Last value received from server is kept in the battery-backed SRAM of
+  // the RTC, so it is shown right after power up, without waiting for the
+  // network.
+  //
+  // Denotes that display value comes from the snapshot and was not confirmed
+  // by the server since power up.
+  bool is_display_value_stale;
+  // Time when display value was received from server, in seconds since
+  // 2000-01-01. Zero if time was not known.
+  uint32_t display_value_timestamp;
+  // ETag of the response display value was received with.
+  char display_value_etag[MAX_NIXIE_ETAG];
+  // Storage for the snapshot which is being read from SRAM.
+  uint8_t snapshot_storage[NIXIE_SNAPSHOT_SIZE];
+  bool is_snapshot_read_pending;
+
   // ======== Fetch routines ========
   // Pointer to store fetched value to.
   char* display_value_out;
@@ -154,9 +259,15 @@ typedef struct AppNixieData {
 } AppNixieData;
 
 // Initialize nixie types and state machine.
+//
+// Reading of the snapshot from the RTC SRAM is queued, so the last known
+// value is displayed as soon as the RTC replies.
 void APP_Nixie_Initialize(AppNixieData* app_nixie_data,
                           struct AppHTTPSClientData* app_https_client_data,
-                          struct AppShiftRegisterData* app_shift_register_data);
+                          struct AppShiftRegisterData* app_shift_register_data,
+                          struct AppRTCData* app_rtc_data,
+                          struct AppTimerWheel* app_timer_wheel,
+                          struct AppEventBus* app_event_bus);
 
 // Perform periodic tasks related on nixie types.
 void APP_Nixie_Tasks(AppNixieData* app_nixie_data);
@@ -164,17 +275,99 @@ void APP_Nixie_Tasks(AppNixieData* app_nixie_data);
 // Check whether nixie module is busy with any tasks.
 bool APP_Nixie_IsBusy(AppNixieData* app_nixie_data);
 
+// Check whether nixie tasks are to be performed right now.
+bool APP_Nixie_IsRunnable(AppNixieData* app_nixie_data);
+
+// Get time in milliseconds nixie module is allowed to spend in the given
+// state, used by the supervisor.
+uint32_t APP_Nixie_StateBudget(AppNixieState state);
+
 // Show given string on display.
 //
 // Returns truth on success.
 bool APP_Nixie_Display(AppNixieData* app_nixie_data,
                        const char value[MAX_NIXIE_TUBES]);
 
+// Re-send currently displayed frame to the shift registers, even if it did
+// not change since the previous transmission. Allows to recover from glitches
+// on the shift register lines.
+//
+// Returns truth on success.
+bool APP_Nixie_Refresh(AppNixieData* app_nixie_data);
+
+// Forget which frame is latched in the shift registers, so the next frame is
+// sent even if it matches the previous one.
+//
+// Must be called by anyone who sends data to the shift registers bypassing
+// the nixie module.
+void APP_Nixie_LatchedStateInvalidate(AppNixieData* app_nixie_data);
+
+// Get number of frames which were sent to the shift registers and number of
+// frames which were suppressed because they did not change anything.
+void APP_Nixie_FrameStatisticsGet(AppNixieData* app_nixie_data,
+                                  uint32_t* num_frames_sent,
+                                  uint32_t* num_frames_suppressed);
+
+// Reset frame statistics counters, including statistics of the player.
+void APP_Nixie_FrameStatisticsReset(AppNixieData* app_nixie_data);
+
+// Stream frames to the shift registers at the given frame rate.
+//
+// Each frame is NUM_NIXIE_SHIFT_REGISTERS bytes, frames memory is to be valid
+// until the player is done. Sequence is played num_loops times, after which
+// frame of the current display value is restored.
+//
+// Returns truth on success.
+bool APP_Nixie_PlayerStart(AppNixieData* app_nixie_data,
+                           const uint8_t* frames,
+                           size_t num_frames,
+                           size_t num_loops,
+                           uint16_t fps);
+
+// Cycle all digits on all tubes to prevent cathode poisoning.
+bool APP_Nixie_PlayerStartCathodeCleanup(AppNixieData* app_nixie_data,
+                                         size_t num_loops,
+                                         uint16_t fps);
+
+// Slot-machine style roll of the digits from currently displayed value to
+// the given one.
+bool APP_Nixie_PlayerStartRoll(AppNixieData* app_nixie_data,
+                               const char value[MAX_NIXIE_TUBES],
+                               uint16_t fps);
+
+// Perform frame streaming tasks. Is to be invoked from the main loop, does
+// nothing until the deadline of the next frame is reached.
+void APP_Nixie_PlayerTasks(AppNixieData* app_nixie_data);
+
+// Check whether the player is streaming frames.
+bool APP_Nixie_PlayerIsActive(AppNixieData* app_nixie_data);
+
+// Player never has anything to do before the deadline of the next frame, so
+// it is never runnable by itself: next_deadline is set to the deadline of the
+// next frame while the player is active.
+bool APP_Nixie_PlayerIsRunnable(AppNixieData* app_nixie_data,
+                                uint64_t* next_deadline);
+
+// Get number of played frames and number of frames which were skipped because
+// their deadline was missed.
+void APP_Nixie_PlayerStatisticsGet(AppNixieData* app_nixie_data,
+                                   uint32_t* num_frames_played,
+                                   uint32_t* num_missed_deadlines);
+
 // Fetch value form server and store in in given buffer.
 bool APP_Nixie_Fetch(AppNixieData* app_nixie_data,
                      bool* is_fetched,
                      char value[MAX_NIXIE_TUBES]);
 
+// Convert display value to a null-terminated string, with the most
+// significant digit first. Only num_nixies digits are converted, unused
+// digits are shown as '_'.
+//
+// Returns pointer to the given string buffer.
+const char* APP_Nixie_DisplayValueToString(const char value[MAX_NIXIE_TUBES],
+                                           int num_nixies,
+                                           char str[MAX_NIXIE_TUBES + 1]);
+
 // Check whether periodic tasks are enabled.
 bool APP_Nixie_PeriodicTasksEnabled(AppNixieData* app_nixie_data);
 
@@ -182,4 +375,18 @@ bool APP_Nixie_PeriodicTasksEnabled(AppNixieData* app_nixie_data);
 void APP_Nixie_PeriodicTasksSetEnabled(AppNixieData* app_nixie_data,
                                        bool enabled);
 
+// Set interval in seconds between periodic tasks, takes effect once the
+// current interval is over.
+void APP_Nixie_PeriodicIntervalSet(AppNixieData* app_nixie_data,
+                                   uint32_t interval);
+
+// Configure request which is used to obtain value for the display.
+//
+// Empty URL or token keep the current one, as well as the ones which are too
+// long. Returns false if the request can't be changed now because the display
+// is busy, try again once it posts APP_EVENT_NIXIE_DONE.
+bool APP_Nixie_RequestSet(AppNixieData* app_nixie_data,
+                          const char* url,
+                          const char* token);
+
 #endif  // _APP_NIXIE_H
@@ -22,6 +22,8 @@
 
 #include "app_power.h"
 
+#include <xc.h>
+
 #include "system_definitions.h"
 
 #define LOG_PREFIX "APP POWER: "
@@ -38,8 +40,31 @@
   APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
 #define POWER_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
 
-void APP_Power_Initialize(void) {
+// Frequency of the core timer, it runs at half of the system clock.
+#define CORE_TIMER_FREQUENCY (SYS_CLK_FREQ / 2)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+// Account time passed since the last accounting as running time.
+//
+// NOTE: Core timer overflows every ~107 seconds, main loop is expected to
+// come here much more often.
+static uint32_t accountRunningTime(AppPowerData* app_power_data) {
+  const uint32_t current_timestamp = _CP0_GET_COUNT();
+  app_power_data->num_running_ticks +=
+      current_timestamp - app_power_data->last_timestamp;
+  app_power_data->last_timestamp = current_timestamp;
+  return current_timestamp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_Power_Initialize(AppPowerData* app_power_data) {
   // TODO(sergey): Read power supply state from EEPROM and restore the state.
+  app_power_data->is_idle_enabled = true;
+  APP_Power_IdleStatisticsReset(app_power_data);
   SYS_MESSAGE("Power supply subsystem initialized.\r\n");
 }
 
@@ -50,3 +75,49 @@ void APP_Power_Enable(AppPowerSupply power_supply, bool enabled) {
       break;
   }
 }
+
+void APP_Power_Idle(AppPowerData* app_power_data, uint64_t deadline) {
+  const uint32_t idle_start = accountRunningTime(app_power_data);
+  if (!app_power_data->is_idle_enabled) {
+    return;
+  }
+  // Some module is due already, don't wait for the next tick to handle it.
+  if (SYS_TMR_SystemCountGet() >= deadline) {
+    return;
+  }
+  // NOTE: Interrupt might happen between the last check of modules state and
+  // entering idle mode. Its event will be handled after the next interrupt,
+  // which is at most one system timer tick away.
+  SYS_DEVCON_PowerModeEnter(SYS_POWER_MODE_IDLE);
+  const uint32_t idle_end = _CP0_GET_COUNT();
+  app_power_data->num_idle_ticks += idle_end - idle_start;
+  app_power_data->last_timestamp = idle_end;
+  ++app_power_data->num_idle_entries;
+}
+
+bool APP_Power_IdleEnabled(AppPowerData* app_power_data) {
+  return app_power_data->is_idle_enabled;
+}
+
+void APP_Power_IdleSetEnabled(AppPowerData* app_power_data, bool enabled) {
+  app_power_data->is_idle_enabled = enabled;
+}
+
+void APP_Power_IdleStatisticsGet(AppPowerData* app_power_data,
+                                 uint64_t* running_time_us,
+                                 uint64_t* idle_time_us,
+                                 uint32_t* num_idle_entries) {
+  accountRunningTime(app_power_data);
+  *running_time_us = app_power_data->num_running_ticks /
+                     (CORE_TIMER_FREQUENCY / 1000000);
+  *idle_time_us = app_power_data->num_idle_ticks /
+                  (CORE_TIMER_FREQUENCY / 1000000);
+  *num_idle_entries = app_power_data->num_idle_entries;
+}
+
+void APP_Power_IdleStatisticsReset(AppPowerData* app_power_data) {
+  app_power_data->last_timestamp = _CP0_GET_COUNT();
+  app_power_data->num_running_ticks = 0;
+  app_power_data->num_idle_ticks = 0;
+  app_power_data->num_idle_entries = 0;
+}
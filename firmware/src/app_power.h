@@ -24,16 +24,59 @@
 #define _APP_POWER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum {
   // High-voltage power supply.
   APP_POWER_SUPPLY_HV,
 } AppPowerSupply;
 
+typedef struct AppPowerData {
+  // Allow CPU to enter idle mode when there is nothing to do.
+  bool is_idle_enabled;
+
+  // Core timer value at the moment of the last accounting.
+  uint32_t last_timestamp;
+
+  // Residency statistics, in core timer ticks.
+  uint64_t num_running_ticks;
+  uint64_t num_idle_ticks;
+  // Number of times CPU entered idle mode.
+  uint32_t num_idle_entries;
+} AppPowerData;
+
 // Initialize power supplies.
-void APP_Power_Initialize(void);
+void APP_Power_Initialize(AppPowerData* app_power_data);
 
 // Set enabled state of the given power supply.
 void APP_Power_Enable(AppPowerSupply power_supply, bool enabled);
 
+// Put CPU into idle mode until the next interrupt.
+//
+// Is to be called from the main loop when none of the modules is runnable.
+// Peripherals keep running in idle mode, so network, USB, UART and I2C
+// interrupts wake the CPU up.
+//
+// The deadline (in system timer counts) is only a guard: idle mode is not
+// entered at all if the deadline has already passed. No wake-up timer is
+// programmed from it, the CPU relies on the system timer tick interrupt,
+// so it never stays in idle mode for longer than a single tick and deadlines
+// are met with a tick resolution.
+void APP_Power_Idle(AppPowerData* app_power_data, uint64_t deadline);
+
+// Check whether idle mode is allowed.
+bool APP_Power_IdleEnabled(AppPowerData* app_power_data);
+
+// Allow or disallow CPU to enter idle mode.
+void APP_Power_IdleSetEnabled(AppPowerData* app_power_data, bool enabled);
+
+// Get time spent in running and idle modes, in microseconds.
+void APP_Power_IdleStatisticsGet(AppPowerData* app_power_data,
+                                 uint64_t* running_time_us,
+                                 uint64_t* idle_time_us,
+                                 uint32_t* num_idle_entries);
+
+// Reset idle residency statistics.
+void APP_Power_IdleStatisticsReset(AppPowerData* app_power_data);
+
 #endif  // _APP_POWER_H
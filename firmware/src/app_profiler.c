@@ -0,0 +1,62 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_profiler.h"
+
+#ifdef APP_CONFIG_WITH_PROFILER
+
+#include <string.h>
+#include <xc.h>
+
+uint32_t APP_Profiler_TimestampGet(void) {
+  return _CP0_GET_COUNT();
+}
+
+void APP_Profiler_StatisticsAccount(AppProfilerStatistics* statistics,
+                                    uint32_t num_cycles) {
+  ++statistics->num_calls;
+  statistics->total_cycles += num_cycles;
+  if (num_cycles > statistics->max_cycles) {
+    statistics->max_cycles = num_cycles;
+  }
+  ++statistics->histogram[APP_Profiler_HistogramBucket(num_cycles)];
+}
+
+void APP_Profiler_StatisticsReset(AppProfilerStatistics* statistics) {
+  memset(statistics, 0, sizeof(*statistics));
+}
+
+int APP_Profiler_HistogramBucket(uint32_t num_cycles) {
+  int bucket = 0;
+  while (num_cycles != 0 && bucket < PROFILER_NUM_HISTOGRAM_BUCKETS - 1) {
+    num_cycles >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void APP_Profiler_Reset(AppProfilerData* app_profiler_data) {
+  APP_Profiler_StatisticsReset(&app_profiler_data->sys_tasks);
+  APP_Profiler_StatisticsReset(&app_profiler_data->iteration);
+}
+
+#endif  // APP_CONFIG_WITH_PROFILER
@@ -0,0 +1,102 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_PROFILER_H
+#define _APP_PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// Instrumentation of the main loop.
+//
+// Time is measured using the core timer, which runs at half of the system
+// clock. All the numbers are reported in CPU cycles.
+//
+// Everything here is only compiled in when APP_CONFIG_WITH_PROFILER is
+// defined. Otherwise all the macros expand to nothing and no memory is used.
+
+#ifdef APP_CONFIG_WITH_PROFILER
+
+// Number of CPU cycles per tick of the core timer.
+#define PROFILER_CYCLES_PER_TICK 2
+
+// Bucket N of the histogram counts calls which took [2^(N-1), 2^N) cycles,
+// bucket 0 counts calls which were too fast to be measured. The last bucket
+// also counts all the longer calls.
+#define PROFILER_NUM_HISTOGRAM_BUCKETS 28
+
+typedef struct AppProfilerStatistics {
+  uint32_t num_calls;
+  uint64_t total_cycles;
+  uint32_t max_cycles;
+  uint32_t histogram[PROFILER_NUM_HISTOGRAM_BUCKETS];
+} AppProfilerStatistics;
+
+typedef struct AppProfilerData {
+  // Time spent in the Harmony modules.
+  AppProfilerStatistics sys_tasks;
+  // Whole main loop iteration, not including time spent in idle mode.
+  AppProfilerStatistics iteration;
+  // Core timer value at which current iteration started.
+  uint32_t iteration_start;
+} AppProfilerData;
+
+// Get current value of the core timer.
+uint32_t APP_Profiler_TimestampGet(void);
+
+// Account single call which took given number of cycles.
+void APP_Profiler_StatisticsAccount(AppProfilerStatistics* statistics,
+                                    uint32_t num_cycles);
+
+// Reset all the accumulated statistics.
+void APP_Profiler_StatisticsReset(AppProfilerStatistics* statistics);
+
+// Get index of the histogram bucket for the given number of cycles.
+int APP_Profiler_HistogramBucket(uint32_t num_cycles);
+
+// Reset statistics of the main loop itself.
+void APP_Profiler_Reset(AppProfilerData* app_profiler_data);
+
+#  define APP_PROFILER_BEGIN(timestamp) \
+  const uint32_t timestamp = APP_Profiler_TimestampGet()
+#  define APP_PROFILER_END(timestamp, statistics) \
+  APP_Profiler_StatisticsAccount( \
+      (statistics), \
+      (APP_Profiler_TimestampGet() - (timestamp)) * PROFILER_CYCLES_PER_TICK)
+#  define APP_PROFILER_RESET(statistics) \
+  APP_Profiler_StatisticsReset(statistics)
+#  define APP_PROFILER_ITERATION_BEGIN(app_profiler_data) \
+  (app_profiler_data)->iteration_start = APP_Profiler_TimestampGet()
+#  define APP_PROFILER_ITERATION_END(app_profiler_data) \
+  APP_PROFILER_END((app_profiler_data)->iteration_start, \
+                   &(app_profiler_data)->iteration)
+#else
+#  define APP_PROFILER_BEGIN(timestamp)
+#  define APP_PROFILER_END(timestamp, statistics)
+#  define APP_PROFILER_RESET(statistics)
+#  define APP_PROFILER_ITERATION_BEGIN(app_profiler_data)
+#  define APP_PROFILER_ITERATION_END(app_profiler_data)
+#endif
+
+#endif  // _APP_PROFILER_H
@@ -22,13 +22,242 @@
 
 #include "app_rtc.h"
 
+#include <string.h>
+
+#include "app_config.h"
+#include "app_event.h"
 #include "system_definitions.h"
+#include "utildefines.h"
+
+#define LOG_PREFIX "APP RTC: "
+
+// Debug print / message.
+#define RTC_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define RTC_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static void dateTimeToCalendarTime(const RTC_MCP7940N_DateTime* date_time,
+                                   CalendarTime* calendar_time) {
+  calendar_time->year = date_time->year + 2000;
+  calendar_time->month = date_time->month;
+  calendar_time->day = date_time->day;
+  calendar_time->day_of_week = date_time->day_of_week;
+  calendar_time->hours = date_time->hours;
+  calendar_time->minutes = date_time->minutes;
+  calendar_time->seconds = date_time->seconds;
+}
+
+// Get number of whole seconds passed since the anchor at the given time.
+static uint32_t timeCacheSecondsAt(const AppRTCTimeCache* time_cache,
+                                   uint64_t count) {
+  if (count < time_cache->anchor_count) {
+    return time_cache->anchor_seconds;
+  }
+  return time_cache->anchor_seconds +
+         (uint32_t)((count - time_cache->anchor_count) /
+                    SYS_TMR_SystemCountFrequencyGet());
+}
+
+static void timeCacheScheduleResync(AppRTCTimeCache* time_cache) {
+  time_cache->next_resync_count =
+      SYS_TMR_SystemCountGet() +
+      (uint64_t)APP_CONFIG_RTC_RESYNC_INTERVAL *
+          SYS_TMR_SystemCountFrequencyGet();
+}
+
+// Anchor cached time to the date and time which was just read from the RTC.
+//
+// Invoked by the RTC driver right after the read transfer is complete.
+static void timeCacheReadCallback(RTC_MCP7940N* rtc,
+                                  bool success,
+                                  void* user_data) {
+  AppRTCTimeCache* time_cache = (AppRTCTimeCache*)user_data;
+  time_cache->is_reading = false;
+  if (!success) {
+    // Keep extrapolating, next attempt happens after the regular interval.
+    RTC_DEBUG_MESSAGE("Failed to read time for the cache.\r\n");
+    return;
+  }
+  uint32_t seconds;
+  if (!APP_RTC_DateTimeToSeconds(&time_cache->read_date_time, &seconds)) {
+    RTC_DEBUG_MESSAGE("RTC returned invalid date and time.\r\n");
+    return;
+  }
+  const uint64_t current_count = SYS_TMR_SystemCountGet();
+  // Read only tells which second is current, not when it did start. Keep the
+  // old anchor while it agrees with the RTC, so the sub-second phase which is
+  // known from it (or from the MFP edge) is not lost.
+  if (!time_cache->is_valid ||
+      timeCacheSecondsAt(time_cache, current_count) != seconds) {
+    RTC_DEBUG_PRINT("Time cache anchored at %u.\r\n", seconds);
+    time_cache->anchor_seconds = seconds;
+    time_cache->anchor_count = current_count;
+    time_cache->is_valid = true;
+  }
+}
+
+// Align anchor to the beginning of a second signalled by the MFP output.
+static void timeCacheHandleMFPEdge(AppRTCTimeCache* time_cache) {
+  const uint64_t edge_count = time_cache->mfp_edge_count;
+  time_cache->has_mfp_edge = false;
+  if (!time_cache->is_valid || edge_count < time_cache->anchor_count) {
+    return;
+  }
+  // Round to the nearest second, the edge is where the second starts.
+  const uint32_t frequency = SYS_TMR_SystemCountFrequencyGet();
+  time_cache->anchor_seconds =
+      timeCacheSecondsAt(time_cache, edge_count + frequency / 2);
+  time_cache->anchor_count = edge_count;
+}
+
+#ifdef APP_CONFIG_WITH_RTC_MFP
+static void timeCacheConfigureMFP(AppRTCData* app_rtc_data) {
+  RTC_DEBUG_MESSAGE("Configuring 1 Hz output on MFP.\r\n");
+  RTC_MCP7940N_Batch batch;
+  RTC_MCP7940N_BatchInitialize(&batch);
+  RTC_MCP7940N_BatchSetBits(&batch,
+                            MCP7940N_REG_ADDR_CONTROL,
+                            MCP7940N_FLAG_SQWE | MCP7940N_MASK_MFP_RATE,
+                            MCP7940N_FLAG_SQWE | MCP7940N_FLAG_MFP_1HZ);
+  if (RTC_MCP7940N_WriteBatch(&app_rtc_data->rtc_handle,
+                              &batch,
+                              NULL, NULL)) {
+    app_rtc_data->time_cache.is_mfp_configured = true;
+  }
+}
+#endif
+
+// Start new communication with the RTC if the cache needs it.
+static void timeCacheTasks(AppRTCData* app_rtc_data) {
+  AppRTCTimeCache* time_cache = &app_rtc_data->time_cache;
+  if (time_cache->is_reading ||
+      RTC_MCP7940N_IsQueueFull(&app_rtc_data->rtc_handle)) {
+    return;
+  }
+#ifdef APP_CONFIG_WITH_RTC_MFP
+  if (!time_cache->is_mfp_configured) {
+    timeCacheConfigureMFP(app_rtc_data);
+    return;
+  }
+#endif
+  if (SYS_TMR_SystemCountGet() < time_cache->next_resync_count) {
+    return;
+  }
+  RTC_DEBUG_MESSAGE("Re-synchronizing time cache.\r\n");
+  timeCacheScheduleResync(time_cache);
+  time_cache->is_reading = true;
+  if (!RTC_MCP7940N_ReadDateAndTime(&app_rtc_data->rtc_handle,
+                                    &time_cache->read_date_time,
+                                    timeCacheReadCallback,
+                                    time_cache)) {
+    time_cache->is_reading = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
 
-void APP_RTC_Initialize(AppRTCData* app_rtc_data) {
+void APP_RTC_Initialize(AppRTCData* app_rtc_data,
+                        AppEventBus* app_event_bus) {
   RTC_MCP7940N_Initialize(&app_rtc_data->rtc_handle, DRV_I2C_INDEX_0);
+  app_rtc_data->app_event_bus = app_event_bus;
+  memset(&app_rtc_data->time_cache, 0, sizeof(app_rtc_data->time_cache));
   SYS_MESSAGE("RTC subsystem initialized.\r\n");
 }
 
 void APP_RTC_Tasks(AppRTCData* app_rtc_data) {
+  AppRTCTimeCache* time_cache = &app_rtc_data->time_cache;
+  const bool was_busy = RTC_MCP7940N_IsBusy(&app_rtc_data->rtc_handle);
   RTC_MCP7940N_Tasks(&app_rtc_data->rtc_handle);
+  if (was_busy && !RTC_MCP7940N_IsBusy(&app_rtc_data->rtc_handle)) {
+    APP_Event_Post(app_rtc_data->app_event_bus,
+                   APP_EVENT_RTC_DONE,
+                   app_rtc_data);
+  }
+  if (time_cache->has_mfp_edge) {
+    timeCacheHandleMFPEdge(time_cache);
+  }
+  timeCacheTasks(app_rtc_data);
+}
+
+bool APP_RTC_IsBusy(AppRTCData* app_rtc_data) {
+  return RTC_MCP7940N_IsBusy(&app_rtc_data->rtc_handle);
+}
+
+bool APP_RTC_IsRunnable(AppRTCData* app_rtc_data, uint64_t* next_deadline) {
+  const AppRTCTimeCache* time_cache = &app_rtc_data->time_cache;
+  if (RTC_MCP7940N_IsBusy(&app_rtc_data->rtc_handle) ||
+      time_cache->has_mfp_edge) {
+    return true;
+  }
+#ifdef APP_CONFIG_WITH_RTC_MFP
+  if (!time_cache->is_mfp_configured) {
+    return true;
+  }
+#endif
+  if (SYS_TMR_SystemCountGet() >= time_cache->next_resync_count) {
+    return true;
+  }
+  if (time_cache->next_resync_count < *next_deadline) {
+    *next_deadline = time_cache->next_resync_count;
+  }
+  return false;
+}
+
+bool APP_RTC_TimestampGet(AppRTCData* app_rtc_data, uint32_t* seconds) {
+  const AppRTCTimeCache* time_cache = &app_rtc_data->time_cache;
+  if (!time_cache->is_valid) {
+    return false;
+  }
+  *seconds = timeCacheSecondsAt(time_cache, SYS_TMR_SystemCountGet());
+  return true;
+}
+
+bool APP_RTC_CalendarTimeGet(AppRTCData* app_rtc_data,
+                             CalendarTime* calendar_time) {
+  uint32_t seconds;
+  if (!APP_RTC_TimestampGet(app_rtc_data, &seconds)) {
+    return false;
+  }
+  calendar_time_from_seconds(seconds, calendar_time);
+  return true;
+}
+
+void APP_RTC_TimeCacheInvalidate(AppRTCData* app_rtc_data) {
+  AppRTCTimeCache* time_cache = &app_rtc_data->time_cache;
+  time_cache->is_valid = false;
+  time_cache->next_resync_count = 0;
+}
+
+bool APP_RTC_DateTimeToSeconds(const RTC_MCP7940N_DateTime* date_time,
+                               uint32_t* seconds) {
+  CalendarTime calendar_time;
+  dateTimeToCalendarTime(date_time, &calendar_time);
+  if (!calendar_time_is_valid(&calendar_time)) {
+    return false;
+  }
+  *seconds = calendar_time_to_seconds(&calendar_time);
+  return true;
+}
+
+void APP_RTC_DateTimeFromSeconds(uint32_t seconds,
+                                 RTC_MCP7940N_DateTime* date_time) {
+  CalendarTime calendar_time;
+  calendar_time_from_seconds(seconds, &calendar_time);
+  date_time->year = calendar_time.year - 2000;
+  date_time->month = calendar_time.month;
+  date_time->day = calendar_time.day;
+  date_time->day_of_week = calendar_time.day_of_week;
+  date_time->hours = calendar_time.hours;
+  date_time->minutes = calendar_time.minutes;
+  date_time->seconds = calendar_time.seconds;
+}
+
+void APP_RTC_MFPEdge(AppRTCData* app_rtc_data) {
+  AppRTCTimeCache* time_cache = &app_rtc_data->time_cache;
+  time_cache->mfp_edge_count = SYS_TMR_SystemCountGet();
+  time_cache->has_mfp_edge = true;
 }
@@ -23,16 +23,92 @@
 #ifndef _APP_RTC_H
 #define _APP_RTC_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "rtc_mcp7940n.h"
+#include "util_time.h"
+
+struct AppEventBus;
+
+// Calendar time which is kept in sync with the RTC.
+//
+// Time is read from the RTC once per APP_CONFIG_RTC_RESYNC_INTERVAL and is
+// extrapolated from the system timer in between, so time queries do not
+// cause any I2C traffic.
+typedef struct AppRTCTimeCache {
+  // Cache was synchronized with the RTC at least once.
+  bool is_valid;
+  // Seconds since 2000-01-01 at the anchor, and system timer count at which
+  // that second has started.
+  uint32_t anchor_seconds;
+  uint64_t anchor_count;
+  // System timer count at which cache is to be synchronized with the RTC.
+  uint64_t next_resync_count;
+  // Read of the date and time is in progress.
+  bool is_reading;
+  RTC_MCP7940N_DateTime read_date_time;
+
+  // Edge of the 1 Hz MFP output, set from an interrupt handler.
+  volatile bool has_mfp_edge;
+  volatile uint64_t mfp_edge_count;
+  // Control register is configured to output 1 Hz on MFP.
+  bool is_mfp_configured;
+} AppRTCTimeCache;
 
 typedef struct AppRTCData {
   RTC_MCP7940N rtc_handle;
+  // Bus to post completion event to once RTC finished communication.
+  struct AppEventBus* app_event_bus;
+  AppRTCTimeCache time_cache;
 } AppRTCData;
 
 // Initialize RTC related application routines.
-void APP_RTC_Initialize(AppRTCData* app_rtc_data);
+void APP_RTC_Initialize(AppRTCData* app_rtc_data,
+                        struct AppEventBus* app_event_bus);
 
 // Perform all RTC related tasks.
 void APP_RTC_Tasks(AppRTCData* app_rtc_data);
 
+// Check whether RTC is busy with communication.
+bool APP_RTC_IsBusy(AppRTCData* app_rtc_data);
+
+// Check whether RTC tasks are to be performed right now, next_deadline is set
+// to the time of the next synchronization of the time cache.
+bool APP_RTC_IsRunnable(AppRTCData* app_rtc_data, uint64_t* next_deadline);
+
+// Get current time from the cache, in seconds since 2000-01-01.
+//
+// Returns false if the cache was never synchronized with the RTC.
+bool APP_RTC_TimestampGet(AppRTCData* app_rtc_data, uint32_t* seconds);
+
+// Get current calendar time from the cache.
+//
+// Returns false if the cache was never synchronized with the RTC.
+bool APP_RTC_CalendarTimeGet(AppRTCData* app_rtc_data,
+                             CalendarTime* calendar_time);
+
+// Mark cached time as outdated, must be called after the time in the RTC was
+// modified. Cache is re-synchronized with the RTC as soon as possible.
+void APP_RTC_TimeCacheInvalidate(AppRTCData* app_rtc_data);
+
+// Convert date and time as it is stored in the RTC to a number of seconds
+// since 2000-01-01.
+//
+// Returns false if the date and time is not valid.
+bool APP_RTC_DateTimeToSeconds(const RTC_MCP7940N_DateTime* date_time,
+                               uint32_t* seconds);
+
+// Convert number of seconds since 2000-01-01 to date and time as it is
+// stored in the RTC.
+void APP_RTC_DateTimeFromSeconds(uint32_t seconds,
+                                 RTC_MCP7940N_DateTime* date_time);
+
+// Handle rising edge of the 1 Hz MFP output, is to be called from the
+// interrupt handler of the pin MFP is wired to.
+//
+// Edge marks beginning of a second, which is used to align cached time
+// without reading it from the RTC.
+void APP_RTC_MFPEdge(AppRTCData* app_rtc_data);
+
 #endif  // _APP_RTC_H
@@ -0,0 +1,130 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_scheduler.h"
+
+#include "utildefines.h"
+#include "system_definitions.h"
+
+#define LOG_PREFIX "APP SCHEDULER: "
+
+// Error print / message.
+#define SCHEDULER_ERROR_PRINT(format, ...) \
+  APP_ERROR_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static bool isTaskRunnable(AppSchedulerTask* task,
+                           uint64_t current_time,
+                           uint64_t* next_deadline) {
+  if (task->is_runnable == NULL) {
+    return true;
+  }
+  uint64_t deadline = APP_SCHEDULER_NO_DEADLINE;
+  if (task->is_runnable(task->user_data, &deadline)) {
+    return true;
+  }
+  if (deadline <= current_time) {
+    return true;
+  }
+  if (deadline < *next_deadline) {
+    *next_deadline = deadline;
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_Scheduler_Initialize(AppSchedulerData* app_scheduler_data) {
+  app_scheduler_data->num_tasks = 0;
+  app_scheduler_data->next_deadline = APP_SCHEDULER_NO_DEADLINE;
+  app_scheduler_data->num_last_dispatches = 0;
+  APP_Scheduler_StatisticsReset(app_scheduler_data);
+}
+
+bool APP_Scheduler_Register(AppSchedulerData* app_scheduler_data,
+                            const char* name,
+                            AppSchedulerTasksFunc tasks,
+                            AppSchedulerIsRunnableFunc is_runnable,
+                            void* user_data) {
+  SYS_ASSERT(tasks != NULL, "Tasks callback is required");
+  if (app_scheduler_data->num_tasks == MAX_SCHEDULER_TASKS) {
+    SCHEDULER_ERROR_PRINT("No free slots to register %s\r\n", name);
+    return false;
+  }
+  AppSchedulerTask* task =
+      &app_scheduler_data->tasks[app_scheduler_data->num_tasks++];
+  task->name = name;
+  task->tasks = tasks;
+  task->is_runnable = is_runnable;
+  task->user_data = user_data;
+  task->num_dispatches = 0;
+  task->num_skips = 0;
+  APP_PROFILER_RESET(&task->profile);
+  return true;
+}
+
+void APP_Scheduler_Tasks(AppSchedulerData* app_scheduler_data) {
+  const uint64_t current_time = SYS_TMR_SystemCountGet();
+  uint64_t next_deadline = APP_SCHEDULER_NO_DEADLINE;
+  size_t num_dispatches = 0;
+  size_t i;
+  for (i = 0; i < app_scheduler_data->num_tasks; ++i) {
+    AppSchedulerTask* task = &app_scheduler_data->tasks[i];
+    if (!isTaskRunnable(task, current_time, &next_deadline)) {
+      ++task->num_skips;
+      continue;
+    }
+    APP_PROFILER_BEGIN(task_start);
+    task->tasks(task->user_data);
+    APP_PROFILER_END(task_start, &task->profile);
+    ++task->num_dispatches;
+    ++num_dispatches;
+  }
+  app_scheduler_data->next_deadline = next_deadline;
+  app_scheduler_data->num_last_dispatches = num_dispatches;
+  ++app_scheduler_data->num_passes;
+  if (num_dispatches == 0) {
+    ++app_scheduler_data->num_idle_passes;
+  }
+}
+
+bool APP_Scheduler_IsIdle(AppSchedulerData* app_scheduler_data) {
+  return app_scheduler_data->num_last_dispatches == 0;
+}
+
+uint64_t APP_Scheduler_NextDeadline(AppSchedulerData* app_scheduler_data) {
+  return app_scheduler_data->next_deadline;
+}
+
+void APP_Scheduler_StatisticsReset(AppSchedulerData* app_scheduler_data) {
+  size_t i;
+  for (i = 0; i < app_scheduler_data->num_tasks; ++i) {
+    app_scheduler_data->tasks[i].num_dispatches = 0;
+    app_scheduler_data->tasks[i].num_skips = 0;
+    APP_PROFILER_RESET(&app_scheduler_data->tasks[i].profile);
+  }
+  app_scheduler_data->num_passes = 0;
+  app_scheduler_data->num_idle_passes = 0;
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_SCHEDULER_H
+#define _APP_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "app_profiler.h"
+
+// Cooperative scheduler of the main loop.
+//
+// Every module registers its tasks callback together with a predicate which
+// tells whether the module has anything to do right now. Modules which are
+// waiting for something (an event coming from an interrupt or callback, or
+// a moment in time) are not dispatched, which saves cycles on polling state
+// machines which would return immediately anyway.
+
+#define MAX_SCHEDULER_TASKS APP_CONFIG_NUM_SCHEDULER_TASKS
+
+// Deadline used by tasks which do not need to be woken up by time.
+#define APP_SCHEDULER_NO_DEADLINE UINT64_MAX
+
+// Perform tasks of the module.
+typedef void (*AppSchedulerTasksFunc)(void* user_data);
+
+// Check whether module has work to do right now.
+//
+// If the module is waiting for some moment in time it is to return false and
+// set next_deadline to the system timer count at which it is to be dispatched.
+// When deadline is reached the tasks are dispatched even if the predicate
+// still returns false, so predicates don't need to check the time.
+//
+// Events coming from interrupts and callbacks are expected to be reflected in
+// the module state, so the predicate picks them up on the next pass.
+typedef bool (*AppSchedulerIsRunnableFunc)(void* user_data,
+                                           uint64_t* next_deadline);
+
+typedef struct AppSchedulerTask {
+  // Human readable name, used for statistics.
+  const char* name;
+  AppSchedulerTasksFunc tasks;
+  // If NULL, tasks are dispatched on every pass.
+  AppSchedulerIsRunnableFunc is_runnable;
+  void* user_data;
+
+  // Statistics.
+  uint32_t num_dispatches;
+  uint32_t num_skips;
+#ifdef APP_CONFIG_WITH_PROFILER
+  AppProfilerStatistics profile;
+#endif
+} AppSchedulerTask;
+
+typedef struct AppSchedulerData {
+  AppSchedulerTask tasks[MAX_SCHEDULER_TASKS];
+  size_t num_tasks;
+
+  // Earliest deadline of the tasks which were skipped on the last pass.
+  uint64_t next_deadline;
+  // Number of tasks which were dispatched on the last pass.
+  size_t num_last_dispatches;
+
+  // Statistics.
+  uint32_t num_passes;
+  uint32_t num_idle_passes;
+} AppSchedulerData;
+
+// Initialize scheduler with an empty list of tasks.
+void APP_Scheduler_Initialize(AppSchedulerData* app_scheduler_data);
+
+// Register new task. Tasks are dispatched in the order of registration.
+//
+// Returns truth on success.
+bool APP_Scheduler_Register(AppSchedulerData* app_scheduler_data,
+                            const char* name,
+                            AppSchedulerTasksFunc tasks,
+                            AppSchedulerIsRunnableFunc is_runnable,
+                            void* user_data);
+
+// Perform single pass over all registered tasks, dispatching the runnable
+// ones.
+void APP_Scheduler_Tasks(AppSchedulerData* app_scheduler_data);
+
+// Check whether nothing was dispatched on the last pass.
+bool APP_Scheduler_IsIdle(AppSchedulerData* app_scheduler_data);
+
+// Get earliest deadline of the tasks which were not dispatched on the last
+// pass, APP_SCHEDULER_NO_DEADLINE if none of them is waiting for time.
+uint64_t APP_Scheduler_NextDeadline(AppSchedulerData* app_scheduler_data);
+
+// Reset dispatch statistics of the scheduler and all its tasks.
+void APP_Scheduler_StatisticsReset(AppSchedulerData* app_scheduler_data);
+
+#endif  // _APP_SCHEDULER_H
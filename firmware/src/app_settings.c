@@ -0,0 +1,723 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_settings.h"
+
+#include <string.h>
+
+#include "app_event.h"
+#include "app_flash_raw.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+#include "util_crc.h"
+
+#define LOG_PREFIX "APP SETTINGS: "
+
+// Regular print / message.
+#define SETTINGS_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define SETTINGS_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Error print / message.
+#define SETTINGS_ERROR_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define SETTINGS_ERROR_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Debug print / message.
+#define SETTINGS_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define SETTINGS_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+// Sector header: magic "NTST", sequence number and checksum, little endian.
+#define HEADER_MAGIC 0x5453544eu
+#define HEADER_SIZE 10
+
+// Record: key, value length, value and checksum of all the preceding bytes.
+#define RECORD_OVERHEAD 4
+
+// Key byte of the erased flash, there are no more records in the page.
+#define KEY_FREE 0xff
+
+static const char* key_names[APP_SETTINGS_NUM_KEYS] = {
+  "nixie.url",
+  "nixie.token",
+  "nixie.interval",
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static void pageClear(AppSettingsData* app_settings_data) {
+  memset(app_settings_data->page, 0xff, sizeof(app_settings_data->page));
+}
+
+static uint32_t sectorAddress(AppSettingsData* app_settings_data, int sector) {
+  return (uint32_t)sector * app_settings_data->sector_size;
+}
+
+static void uint32Encode(uint8_t* data, uint32_t value) {
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t uint32Decode(const uint8_t* data) {
+  return (uint32_t)data[0] |
+         ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) |
+         ((uint32_t)data[3] << 24);
+}
+
+static void headerEncode(uint8_t* data, uint32_t sequence) {
+  uint32Encode(data, HEADER_MAGIC);
+  uint32Encode(data + 4, sequence);
+  const uint16_t checksum = crc16_ccitt_update(CRC16_CCITT_INIT, data, 8);
+  data[8] = checksum & 0xff;
+  data[9] = checksum >> 8;
+}
+
+// Returns false if there is no valid header, sector is either erased or its
+// compaction did not finish.
+static bool headerDecode(const uint8_t* data, uint32_t* sequence) {
+  if (uint32Decode(data) != HEADER_MAGIC) {
+    return false;
+  }
+  const uint16_t checksum = crc16_ccitt_update(CRC16_CCITT_INIT, data, 8);
+  if (data[8] != (checksum & 0xff) || data[9] != (checksum >> 8)) {
+    return false;
+  }
+  *sequence = uint32Decode(data + 4);
+  return true;
+}
+
+// Encode record of the current value of the key.
+//
+// Returns number of bytes written to the data.
+static uint32_t recordEncode(AppSettingsData* app_settings_data,
+                             AppSettingsKey key,
+                             uint8_t* data) {
+  const uint8_t len = app_settings_data->value_len[key];
+  data[0] = key;
+  data[1] = len;
+  memcpy(data + 2, app_settings_data->values[key], len);
+  const uint16_t checksum =
+      crc16_ccitt_update(CRC16_CCITT_INIT, data, len + 2);
+  data[len + 2] = checksum & 0xff;
+  data[len + 3] = checksum >> 8;
+  return len + RECORD_OVERHEAD;
+}
+
+static uint32_t recordSize(AppSettingsData* app_settings_data,
+                           AppSettingsKey key) {
+  return app_settings_data->value_len[key] + RECORD_OVERHEAD;
+}
+
+static void valueStore(AppSettingsData* app_settings_data,
+                       AppSettingsKey key,
+                       const char* value,
+                       uint8_t len) {
+  memcpy(app_settings_data->values[key], value, len);
+  app_settings_data->values[key][len] = '\0';
+  app_settings_data->value_len[key] = len;
+}
+
+// Apply all records of the page buffer.
+//
+// End is set to the offset in the page right after the last valid record.
+// Returns false if the page has a damaged record.
+static bool pageParse(AppSettingsData* app_settings_data, uint32_t* end) {
+  const uint8_t* page = app_settings_data->page;
+  uint32_t offset = 0;
+  *end = 0;
+  while (offset + RECORD_OVERHEAD <= APP_SETTINGS_PAGE_SIZE &&
+         page[offset] != KEY_FREE) {
+    const uint8_t key = page[offset];
+    const uint8_t len = page[offset + 1];
+    if (offset + len + RECORD_OVERHEAD > APP_SETTINGS_PAGE_SIZE) {
+      return false;
+    }
+    const uint16_t checksum =
+        crc16_ccitt_update(CRC16_CCITT_INIT, page + offset, len + 2);
+    if (page[offset + len + 2] != (checksum & 0xff) ||
+        page[offset + len + 3] != (checksum >> 8)) {
+      return false;
+    }
+    // NOTE: Keys which were set before the settings got loaded keep their new
+    // value, and unknown keys or too long values are dropped.
+    if (key < APP_SETTINGS_NUM_KEYS &&
+        len <= APP_SETTINGS_MAX_VALUE &&
+        (app_settings_data->dirty_mask & (1u << key)) == 0) {
+      valueStore(app_settings_data, key, (const char*)page + offset + 2, len);
+    }
+    ++app_settings_data->num_records_loaded;
+    offset += len + RECORD_OVERHEAD;
+    *end = offset;
+  }
+  return true;
+}
+
+static void notifyChanged(AppSettingsData* app_settings_data) {
+  ++app_settings_data->generation;
+  APP_Event_Post(app_settings_data->app_event_bus,
+                 APP_EVENT_SETTINGS_CHANGED,
+                 app_settings_data);
+}
+
+////////////////////////////////////////
+// Loading.
+
+static void loadFinish(AppSettingsData* app_settings_data) {
+  if (app_settings_data->active_sector == -1) {
+    SETTINGS_MESSAGE("No stored settings found, using defaults.\r\n");
+  } else {
+    SETTINGS_PRINT("Loaded %u records from sector %d, sequence %u.\r\n",
+                   app_settings_data->num_records_loaded,
+                   app_settings_data->active_sector,
+                   app_settings_data->active_sequence);
+  }
+  app_settings_data->state = APP_SETTINGS_STATE_IDLE;
+  notifyChanged(app_settings_data);
+}
+
+static void loadFailed(AppSettingsData* app_settings_data) {
+  SETTINGS_ERROR_MESSAGE("Flash is not usable, settings are not stored.\r\n");
+  app_settings_data->state = APP_SETTINGS_STATE_ERROR;
+  notifyChanged(app_settings_data);
+}
+
+static bool geometryCheck(AppSettingsData* app_settings_data) {
+  AppFlashRawData* app_flash_raw = app_settings_data->app_flash_raw;
+  const uint32_t sector_size = app_flash_raw->erase_block_size;
+  const uint32_t region_size =
+      APP_FlashRaw_RegionSize(app_flash_raw, APP_FLASH_RAW_REGION_SETTINGS);
+  if (sector_size == 0 ||
+      sector_size % APP_SETTINGS_PAGE_SIZE != 0 ||
+      APP_SETTINGS_PAGE_SIZE % app_flash_raw->read_block_size != 0 ||
+      APP_SETTINGS_PAGE_SIZE % app_flash_raw->write_block_size != 0) {
+    SETTINGS_ERROR_MESSAGE("Flash geometry is not supported.\r\n");
+    return false;
+  }
+  // Every value is to fit into the sector after compaction, even if each of
+  // them takes the whole page.
+  if (sector_size / APP_SETTINGS_PAGE_SIZE < APP_SETTINGS_NUM_KEYS + 1 ||
+      region_size / sector_size < 2) {
+    SETTINGS_ERROR_MESSAGE("Settings region is too small.\r\n");
+    return false;
+  }
+  app_settings_data->sector_size = sector_size;
+  app_settings_data->num_sectors = region_size / sector_size;
+  return true;
+}
+
+static void waitFlash(AppSettingsData* app_settings_data) {
+  AppFlashRawData* app_flash_raw = app_settings_data->app_flash_raw;
+  if (APP_FlashRaw_IsError(app_flash_raw)) {
+    loadFailed(app_settings_data);
+    return;
+  }
+  if (!APP_FlashRaw_IsReady(app_flash_raw)) {
+    return;
+  }
+  if (!geometryCheck(app_settings_data)) {
+    loadFailed(app_settings_data);
+    return;
+  }
+  app_settings_data->current_sector = 0;
+  app_settings_data->state = APP_SETTINGS_STATE_READ_HEADER;
+}
+
+static void readHeaderCallback(bool success, void* user_data) {
+  AppSettingsData* app_settings_data = (AppSettingsData*)user_data;
+  if (!success) {
+    loadFailed(app_settings_data);
+    return;
+  }
+  uint32_t sequence;
+  if (headerDecode(app_settings_data->page, &sequence) &&
+      (app_settings_data->active_sector == -1 ||
+       sequence > app_settings_data->active_sequence)) {
+    app_settings_data->active_sector = app_settings_data->current_sector;
+    app_settings_data->active_sequence = sequence;
+  }
+  ++app_settings_data->current_sector;
+  if (app_settings_data->current_sector < app_settings_data->num_sectors) {
+    app_settings_data->state = APP_SETTINGS_STATE_READ_HEADER;
+    return;
+  }
+  if (app_settings_data->active_sector == -1) {
+    loadFinish(app_settings_data);
+    return;
+  }
+  // Records start at the second page.
+  app_settings_data->current_offset = APP_SETTINGS_PAGE_SIZE;
+  app_settings_data->tail_offset = APP_SETTINGS_PAGE_SIZE;
+  app_settings_data->state = APP_SETTINGS_STATE_READ_PAGE;
+}
+
+static void readHeader(AppSettingsData* app_settings_data) {
+  if (APP_FlashRaw_Read(app_settings_data->app_flash_raw,
+                        APP_FLASH_RAW_REGION_SETTINGS,
+                        sectorAddress(app_settings_data,
+                                      app_settings_data->current_sector),
+                        app_settings_data->page,
+                        APP_SETTINGS_PAGE_SIZE,
+                        readHeaderCallback,
+                        app_settings_data)) {
+    app_settings_data->state = APP_SETTINGS_STATE_WAIT_READ_HEADER;
+  }
+}
+
+static void readPageCallback(bool success, void* user_data) {
+  AppSettingsData* app_settings_data = (AppSettingsData*)user_data;
+  if (!success) {
+    loadFailed(app_settings_data);
+    return;
+  }
+  const uint32_t offset = app_settings_data->current_offset;
+  if (app_settings_data->page[0] == KEY_FREE) {
+    // End of the log. The erased page is only useful if the log ends right at
+    // its beginning.
+    app_settings_data->page_offset =
+        (app_settings_data->tail_offset == offset) ? offset : 0;
+    loadFinish(app_settings_data);
+    return;
+  }
+  uint32_t end;
+  const bool is_valid = pageParse(app_settings_data, &end);
+  app_settings_data->page_offset = offset;
+  app_settings_data->tail_offset = offset + end;
+  if (!is_valid) {
+    // Most likely power was lost while the record was being written. Records
+    // before it are fine, but nothing is to be appended after the damaged one.
+    SETTINGS_ERROR_PRINT("Damaged record in sector %d at %u.\r\n",
+                         app_settings_data->active_sector,
+                         app_settings_data->tail_offset);
+    app_settings_data->is_compaction_needed = true;
+    loadFinish(app_settings_data);
+    return;
+  }
+  app_settings_data->current_offset += APP_SETTINGS_PAGE_SIZE;
+  if (app_settings_data->current_offset >= app_settings_data->sector_size) {
+    loadFinish(app_settings_data);
+    return;
+  }
+  app_settings_data->state = APP_SETTINGS_STATE_READ_PAGE;
+}
+
+static void readPage(AppSettingsData* app_settings_data) {
+  if (APP_FlashRaw_Read(app_settings_data->app_flash_raw,
+                        APP_FLASH_RAW_REGION_SETTINGS,
+                        sectorAddress(app_settings_data,
+                                      app_settings_data->active_sector) +
+                            app_settings_data->current_offset,
+                        app_settings_data->page,
+                        APP_SETTINGS_PAGE_SIZE,
+                        readPageCallback,
+                        app_settings_data)) {
+    app_settings_data->state = APP_SETTINGS_STATE_WAIT_READ_PAGE;
+  }
+}
+
+////////////////////////////////////////
+// Appending.
+
+static void readTailCallback(bool success, void* user_data) {
+  AppSettingsData* app_settings_data = (AppSettingsData*)user_data;
+  if (success) {
+    app_settings_data->page_offset = app_settings_data->current_offset;
+  } else {
+    app_settings_data->is_compaction_needed = true;
+  }
+  app_settings_data->state = APP_SETTINGS_STATE_IDLE;
+}
+
+static void appendCallback(bool success, void* user_data) {
+  AppSettingsData* app_settings_data = (AppSettingsData*)user_data;
+  if (success) {
+    app_settings_data->tail_offset = app_settings_data->write_end;
+    ++app_settings_data->num_appends;
+  } else {
+    // Page might be partially written, continue in the next sector.
+    app_settings_data->dirty_mask |= app_settings_data->write_mask;
+    app_settings_data->page_offset = 0;
+    app_settings_data->is_compaction_needed = true;
+  }
+  app_settings_data->write_mask = 0;
+  app_settings_data->state = APP_SETTINGS_STATE_IDLE;
+}
+
+// Append records of the dirty values to the page of the log tail.
+//
+// NOTE: The whole page is written, bytes before the tail are programmed with
+// the same values as they already have, which doesn't change them.
+static void appendDirty(AppSettingsData* app_settings_data) {
+  const uint32_t page_size = APP_SETTINGS_PAGE_SIZE;
+  uint32_t tail = app_settings_data->tail_offset;
+  uint32_t page_start = tail - tail % page_size;
+  int key;
+  for (key = 0; key < APP_SETTINGS_NUM_KEYS; ++key) {
+    if (app_settings_data->dirty_mask & (1u << key)) {
+      break;
+    }
+  }
+  if (tail - page_start + recordSize(app_settings_data, key) > page_size) {
+    // Record does not fit, continue at the next page.
+    page_start += page_size;
+    tail = page_start;
+  }
+  if (page_start >= app_settings_data->sector_size) {
+    app_settings_data->is_compaction_needed = true;
+    return;
+  }
+  if (app_settings_data->page_offset != page_start) {
+    if (tail == page_start) {
+      // Nothing is written to the page yet.
+      pageClear(app_settings_data);
+      app_settings_data->page_offset = page_start;
+    } else {
+      app_settings_data->current_offset = page_start;
+      if (APP_FlashRaw_Read(app_settings_data->app_flash_raw,
+                            APP_FLASH_RAW_REGION_SETTINGS,
+                            sectorAddress(app_settings_data,
+                                          app_settings_data->active_sector) +
+                                page_start,
+                            app_settings_data->page,
+                            page_size,
+                            readTailCallback,
+                            app_settings_data)) {
+        app_settings_data->state = APP_SETTINGS_STATE_WAIT_READ_TAIL;
+      }
+      return;
+    }
+  }
+  // Pack as many dirty values into the page as fit.
+  uint32_t write_mask = 0;
+  for (; key < APP_SETTINGS_NUM_KEYS; ++key) {
+    if ((app_settings_data->dirty_mask & (1u << key)) == 0) {
+      continue;
+    }
+    if (tail - page_start + recordSize(app_settings_data, key) > page_size) {
+      break;
+    }
+    tail += recordEncode(app_settings_data,
+                         key,
+                         app_settings_data->page + (tail - page_start));
+    write_mask |= (1u << key);
+  }
+  if (!APP_FlashRaw_Write(app_settings_data->app_flash_raw,
+                          APP_FLASH_RAW_REGION_SETTINGS,
+                          sectorAddress(app_settings_data,
+                                        app_settings_data->active_sector) +
+                              page_start,
+                          app_settings_data->page,
+                          page_size,
+                          appendCallback,
+                          app_settings_data)) {
+    // Page buffer has records which are not written, get it from the flash
+    // again on the next attempt.
+    app_settings_data->page_offset = 0;
+    return;
+  }
+  app_settings_data->write_end = tail;
+  app_settings_data->write_mask = write_mask;
+  app_settings_data->dirty_mask &= ~write_mask;
+  app_settings_data->state = APP_SETTINGS_STATE_WAIT_APPEND;
+}
+
+////////////////////////////////////////
+// Compaction.
+
+static void compactFailed(AppSettingsData* app_settings_data) {
+  SETTINGS_ERROR_PRINT("Compaction into sector %d failed, settings are no "
+                       "longer stored.\r\n",
+                       app_settings_data->current_sector);
+  app_settings_data->state = APP_SETTINGS_STATE_ERROR;
+}
+
+static void compactEraseCallback(bool success, void* user_data) {
+  AppSettingsData* app_settings_data = (AppSettingsData*)user_data;
+  if (!success) {
+    compactFailed(app_settings_data);
+    return;
+  }
+  // All the values are written below, changes which happen from now on are
+  // appended after the compaction.
+  app_settings_data->dirty_mask = 0;
+  app_settings_data->current_key = 0;
+  app_settings_data->current_offset = APP_SETTINGS_PAGE_SIZE;
+  app_settings_data->write_end = APP_SETTINGS_PAGE_SIZE;
+  app_settings_data->state = APP_SETTINGS_STATE_COMPACT_WRITE;
+}
+
+static void compactStart(AppSettingsData* app_settings_data) {
+  const int sector = (app_settings_data->active_sector + 1) %
+                     app_settings_data->num_sectors;
+  if (!APP_FlashRaw_Erase(app_settings_data->app_flash_raw,
+                          APP_FLASH_RAW_REGION_SETTINGS,
+                          sectorAddress(app_settings_data, sector),
+                          app_settings_data->sector_size,
+                          compactEraseCallback,
+                          app_settings_data)) {
+    return;
+  }
+  SETTINGS_DEBUG_PRINT("Compacting settings into sector %d.\r\n", sector);
+  app_settings_data->current_sector = sector;
+  app_settings_data->is_compaction_requested = false;
+  // Page buffer is used for the new sector from now on.
+  app_settings_data->page_offset = 0;
+  app_settings_data->state = APP_SETTINGS_STATE_WAIT_COMPACT_ERASE;
+}
+
+static void compactCommitCallback(bool success, void* user_data) {
+  AppSettingsData* app_settings_data = (AppSettingsData*)user_data;
+  if (!success) {
+    compactFailed(app_settings_data);
+    return;
+  }
+  app_settings_data->active_sector = app_settings_data->current_sector;
+  ++app_settings_data->active_sequence;
+  app_settings_data->tail_offset = app_settings_data->write_end;
+  app_settings_data->is_compaction_needed = false;
+  ++app_settings_data->num_compactions;
+  app_settings_data->state = APP_SETTINGS_STATE_IDLE;
+  SETTINGS_DEBUG_PRINT("Settings compacted, sequence %u.\r\n",
+                       app_settings_data->active_sequence);
+}
+
+static void compactWriteCallback(bool success, void* user_data) {
+  AppSettingsData* app_settings_data = (AppSettingsData*)user_data;
+  if (!success) {
+    compactFailed(app_settings_data);
+    return;
+  }
+  app_settings_data->current_offset += APP_SETTINGS_PAGE_SIZE;
+  app_settings_data->state = APP_SETTINGS_STATE_COMPACT_WRITE;
+}
+
+// Write the next page of values, or the header once all values are written.
+static void compactWrite(AppSettingsData* app_settings_data) {
+  const uint32_t sector_address =
+      sectorAddress(app_settings_data, app_settings_data->current_sector);
+  uint32_t num_bytes = 0;
+  int key = app_settings_data->current_key;
+  pageClear(app_settings_data);
+  for (; key < APP_SETTINGS_NUM_KEYS; ++key) {
+    if (app_settings_data->value_len[key] == 0) {
+      continue;
+    }
+    if (num_bytes + recordSize(app_settings_data, key) >
+        APP_SETTINGS_PAGE_SIZE) {
+      break;
+    }
+    num_bytes += recordEncode(app_settings_data,
+                              key,
+                              app_settings_data->page + num_bytes);
+  }
+  if (num_bytes == 0) {
+    // All values are written, commit the sector.
+    headerEncode(app_settings_data->page,
+                 app_settings_data->active_sequence + 1);
+    if (APP_FlashRaw_Write(app_settings_data->app_flash_raw,
+                           APP_FLASH_RAW_REGION_SETTINGS,
+                           sector_address,
+                           app_settings_data->page,
+                           APP_SETTINGS_PAGE_SIZE,
+                           compactCommitCallback,
+                           app_settings_data)) {
+      app_settings_data->state = APP_SETTINGS_STATE_WAIT_COMPACT_COMMIT;
+    }
+    return;
+  }
+  if (APP_FlashRaw_Write(app_settings_data->app_flash_raw,
+                         APP_FLASH_RAW_REGION_SETTINGS,
+                         sector_address + app_settings_data->current_offset,
+                         app_settings_data->page,
+                         APP_SETTINGS_PAGE_SIZE,
+                         compactWriteCallback,
+                         app_settings_data)) {
+    app_settings_data->current_key = key;
+    app_settings_data->write_end =
+        app_settings_data->current_offset + num_bytes;
+    app_settings_data->state = APP_SETTINGS_STATE_WAIT_COMPACT_WRITE;
+  }
+}
+
+static void idleTasks(AppSettingsData* app_settings_data) {
+  const bool is_dirty = (app_settings_data->dirty_mask != 0);
+  if (app_settings_data->is_compaction_requested ||
+      (is_dirty && (app_settings_data->active_sector == -1 ||
+                    app_settings_data->is_compaction_needed))) {
+    compactStart(app_settings_data);
+  } else if (is_dirty) {
+    appendDirty(app_settings_data);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_Settings_Initialize(AppSettingsData* app_settings_data,
+                             AppFlashRawData* app_flash_raw,
+                             AppEventBus* app_event_bus) {
+  memset(app_settings_data, 0, sizeof(*app_settings_data));
+  app_settings_data->state = APP_SETTINGS_STATE_WAIT_FLASH;
+  app_settings_data->app_flash_raw = app_flash_raw;
+  app_settings_data->app_event_bus = app_event_bus;
+  app_settings_data->active_sector = -1;
+  SYS_MESSAGE("Settings subsystem initialized.\r\n");
+}
+
+void APP_Settings_Tasks(AppSettingsData* app_settings_data) {
+  AppSettingsState previous_state;
+  int num_steps = 0;
+  do {
+    previous_state = app_settings_data->state;
+    switch (app_settings_data->state) {
+      case APP_SETTINGS_STATE_WAIT_FLASH:
+        waitFlash(app_settings_data);
+        break;
+      case APP_SETTINGS_STATE_READ_HEADER:
+        readHeader(app_settings_data);
+        break;
+      case APP_SETTINGS_STATE_READ_PAGE:
+        readPage(app_settings_data);
+        break;
+      case APP_SETTINGS_STATE_IDLE:
+        idleTasks(app_settings_data);
+        break;
+      case APP_SETTINGS_STATE_COMPACT_WRITE:
+        compactWrite(app_settings_data);
+        break;
+      case APP_SETTINGS_STATE_WAIT_READ_HEADER:
+      case APP_SETTINGS_STATE_WAIT_READ_PAGE:
+      case APP_SETTINGS_STATE_WAIT_READ_TAIL:
+      case APP_SETTINGS_STATE_WAIT_APPEND:
+      case APP_SETTINGS_STATE_WAIT_COMPACT_ERASE:
+      case APP_SETTINGS_STATE_WAIT_COMPACT_WRITE:
+      case APP_SETTINGS_STATE_WAIT_COMPACT_COMMIT:
+        // Waiting for the flash callback.
+        break;
+      case APP_SETTINGS_STATE_ERROR:
+        // Nothing to do.
+        break;
+    }
+  } while (app_settings_data->state != previous_state &&
+           ++num_steps < APP_CONFIG_MAX_STATE_STEPS);
+}
+
+bool APP_Settings_IsRunnable(AppSettingsData* app_settings_data) {
+  switch (app_settings_data->state) {
+    case APP_SETTINGS_STATE_WAIT_FLASH: {
+      AppFlashRawData* app_flash_raw = app_settings_data->app_flash_raw;
+      return APP_FlashRaw_IsReady(app_flash_raw) ||
+             APP_FlashRaw_IsError(app_flash_raw);
+    }
+    case APP_SETTINGS_STATE_READ_HEADER:
+    case APP_SETTINGS_STATE_READ_PAGE:
+    case APP_SETTINGS_STATE_COMPACT_WRITE:
+      return true;
+    case APP_SETTINGS_STATE_IDLE:
+      return app_settings_data->dirty_mask != 0 ||
+             app_settings_data->is_compaction_requested;
+    case APP_SETTINGS_STATE_WAIT_READ_HEADER:
+    case APP_SETTINGS_STATE_WAIT_READ_PAGE:
+    case APP_SETTINGS_STATE_WAIT_READ_TAIL:
+    case APP_SETTINGS_STATE_WAIT_APPEND:
+    case APP_SETTINGS_STATE_WAIT_COMPACT_ERASE:
+    case APP_SETTINGS_STATE_WAIT_COMPACT_WRITE:
+    case APP_SETTINGS_STATE_WAIT_COMPACT_COMMIT:
+    case APP_SETTINGS_STATE_ERROR:
+      return false;
+  }
+  return false;
+}
+
+bool APP_Settings_IsLoaded(AppSettingsData* app_settings_data) {
+  switch (app_settings_data->state) {
+    case APP_SETTINGS_STATE_WAIT_FLASH:
+    case APP_SETTINGS_STATE_READ_HEADER:
+    case APP_SETTINGS_STATE_WAIT_READ_HEADER:
+    case APP_SETTINGS_STATE_READ_PAGE:
+    case APP_SETTINGS_STATE_WAIT_READ_PAGE:
+      return false;
+    default:
+      return true;
+  }
+}
+
+bool APP_Settings_IsError(AppSettingsData* app_settings_data) {
+  return app_settings_data->state == APP_SETTINGS_STATE_ERROR;
+}
+
+const char* APP_Settings_KeyName(AppSettingsKey key) {
+  if (key >= APP_SETTINGS_NUM_KEYS) {
+    return NULL;
+  }
+  return key_names[key];
+}
+
+bool APP_Settings_KeyFind(const char* name, AppSettingsKey* key) {
+  int i;
+  for (i = 0; i < APP_SETTINGS_NUM_KEYS; ++i) {
+    if (STREQ(key_names[i], name)) {
+      *key = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* APP_Settings_Get(AppSettingsData* app_settings_data,
+                             AppSettingsKey key) {
+  if (key >= APP_SETTINGS_NUM_KEYS) {
+    return "";
+  }
+  return app_settings_data->values[key];
+}
+
+bool APP_Settings_Set(AppSettingsData* app_settings_data,
+                      AppSettingsKey key,
+                      const char* value) {
+  if (key >= APP_SETTINGS_NUM_KEYS) {
+    return false;
+  }
+  const size_t len = strlen(value);
+  if (len > APP_SETTINGS_MAX_VALUE) {
+    return false;
+  }
+  if (len == app_settings_data->value_len[key] &&
+      memcmp(app_settings_data->values[key], value, len) == 0) {
+    return true;
+  }
+  valueStore(app_settings_data, key, value, len);
+  app_settings_data->dirty_mask |= (1u << key);
+  notifyChanged(app_settings_data);
+  return true;
+}
+
+bool APP_Settings_IsDirty(AppSettingsData* app_settings_data) {
+  return app_settings_data->dirty_mask != 0 ||
+         app_settings_data->write_mask != 0;
+}
+
+void APP_Settings_Compact(AppSettingsData* app_settings_data) {
+  app_settings_data->is_compaction_requested = true;
+}
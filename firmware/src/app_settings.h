@@ -0,0 +1,187 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_SETTINGS_H
+#define _APP_SETTINGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Persistent settings of the application.
+//
+// Settings are kept in RAM and stored as an append-only log of records in the
+// reserved region of the serial flash, see app_flash_raw.h. Every erase block
+// of the region is a sector: the first page of the sector holds the header
+// with the sequence number, the following pages hold records of the changed
+// values. Records never cross page boundary and are protected by a checksum.
+//
+// At boot only the headers and the sector with the highest sequence number
+// are read. Once the sector is full, the current values are compacted into
+// the next sector in the ring and its header is written last, so the previous
+// sector stays valid until the new one is complete. This way any power loss
+// loses at most the record which was being written, and every sector is
+// erased equally often.
+
+// Maximum length of a value in bytes, not counting the null terminator.
+#define APP_SETTINGS_MAX_VALUE 127
+
+// Size of the page the log is read and written with.
+#define APP_SETTINGS_PAGE_SIZE 256
+
+struct AppEventBus;
+struct AppFlashRawData;
+
+typedef enum {
+  // URL which is requested to obtain the value for the display.
+  APP_SETTINGS_KEY_NIXIE_URL,
+  // Text which precedes the value in the response.
+  APP_SETTINGS_KEY_NIXIE_TOKEN,
+  // Interval between requests in seconds, decimal.
+  APP_SETTINGS_KEY_NIXIE_INTERVAL,
+
+  APP_SETTINGS_NUM_KEYS,
+} AppSettingsKey;
+
+typedef enum {
+  // Wait for the raw flash access to become ready.
+  APP_SETTINGS_STATE_WAIT_FLASH,
+  // Read headers of all sectors to find the most recent one.
+  APP_SETTINGS_STATE_READ_HEADER,
+  APP_SETTINGS_STATE_WAIT_READ_HEADER,
+  // Read pages of the most recent sector and apply their records.
+  APP_SETTINGS_STATE_READ_PAGE,
+  APP_SETTINGS_STATE_WAIT_READ_PAGE,
+  // Settings are loaded, changes are written once they happen.
+  APP_SETTINGS_STATE_IDLE,
+  // Read the page which new records are appended to.
+  APP_SETTINGS_STATE_WAIT_READ_TAIL,
+  // Wait for the page with the new record to be written.
+  APP_SETTINGS_STATE_WAIT_APPEND,
+  // Compaction: erase the next sector, write all the values to it and commit
+  // it by writing its header.
+  APP_SETTINGS_STATE_WAIT_COMPACT_ERASE,
+  APP_SETTINGS_STATE_COMPACT_WRITE,
+  APP_SETTINGS_STATE_WAIT_COMPACT_WRITE,
+  APP_SETTINGS_STATE_WAIT_COMPACT_COMMIT,
+  // Flash is not usable, settings are only kept in RAM.
+  APP_SETTINGS_STATE_ERROR,
+} AppSettingsState;
+
+typedef struct AppSettingsData {
+  AppSettingsState state;
+
+  struct AppFlashRawData* app_flash_raw;
+  struct AppEventBus* app_event_bus;
+
+  // Geometry of the store.
+  int num_sectors;
+  uint32_t sector_size;
+
+  // Sector the log is appended to and its sequence number, -1 if there is no
+  // valid sector in the flash.
+  int active_sector;
+  uint32_t active_sequence;
+  // Offset in the active sector where the next record is written.
+  uint32_t tail_offset;
+  // Records can't be appended to the active sector anymore, it's either full
+  // or its tail is damaged.
+  bool is_compaction_needed;
+  // Compaction was explicitly requested.
+  bool is_compaction_requested;
+
+  // Sector and offset of the page which is being read or written.
+  int current_sector;
+  uint32_t current_offset;
+  // Key which is to be written next during compaction.
+  int current_key;
+  // Offset where the log ends once the page being written is stored.
+  uint32_t write_end;
+  // Keys which are being appended, restored as dirty if the write fails.
+  uint32_t write_mask;
+
+  // Page which is being read or written, and its offset in the active sector.
+  // Offset is zero if the buffer does not hold any page of the log.
+  uint8_t page[APP_SETTINGS_PAGE_SIZE];
+  uint32_t page_offset;
+
+  // Current values, null-terminated. Empty value means it is not set.
+  char values[APP_SETTINGS_NUM_KEYS][APP_SETTINGS_MAX_VALUE + 1];
+  uint8_t value_len[APP_SETTINGS_NUM_KEYS];
+  // Bit mask of the keys whose values are not written to the flash yet.
+  uint32_t dirty_mask;
+  // Incremented every time values are loaded or changed.
+  uint32_t generation;
+
+  // Statistics since the boot.
+  uint32_t num_records_loaded;
+  uint32_t num_appends;
+  uint32_t num_compactions;
+} AppSettingsData;
+
+// Initialize settings, they are loaded as soon as the flash is ready.
+//
+// APP_EVENT_SETTINGS_CHANGED is posted once settings are loaded and every time
+// they are changed.
+void APP_Settings_Initialize(AppSettingsData* app_settings_data,
+                             struct AppFlashRawData* app_flash_raw,
+                             struct AppEventBus* app_event_bus);
+
+// Perform all settings related tasks.
+void APP_Settings_Tasks(AppSettingsData* app_settings_data);
+
+// Check whether settings tasks are to be performed.
+bool APP_Settings_IsRunnable(AppSettingsData* app_settings_data);
+
+// Check whether settings are loaded from the flash, or flash is not usable
+// and settings are kept in RAM only.
+bool APP_Settings_IsLoaded(AppSettingsData* app_settings_data);
+
+// Check whether flash is not usable for the settings.
+bool APP_Settings_IsError(AppSettingsData* app_settings_data);
+
+// Get name of the key as it is shown in the console, or NULL for invalid key.
+const char* APP_Settings_KeyName(AppSettingsKey key);
+
+// Find key by its name.
+//
+// Returns false if there is no such key.
+bool APP_Settings_KeyFind(const char* name, AppSettingsKey* key);
+
+// Get current value, empty string if the value is not set.
+const char* APP_Settings_Get(AppSettingsData* app_settings_data,
+                             AppSettingsKey key);
+
+// Set new value, empty value unsets it.
+//
+// Value is applied immediately and is written to the flash in background.
+// Returns false if the value is too long.
+bool APP_Settings_Set(AppSettingsData* app_settings_data,
+                      AppSettingsKey key,
+                      const char* value);
+
+// Check whether there are values which are not written to the flash yet.
+bool APP_Settings_IsDirty(AppSettingsData* app_settings_data);
+
+// Request current values to be compacted into the next sector.
+void APP_Settings_Compact(AppSettingsData* app_settings_data);
+
+#endif  // _APP_SETTINGS_H
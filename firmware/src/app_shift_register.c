@@ -22,6 +22,8 @@
 
 #include "app_shift_register.h"
 
+#include <string.h>
+
 #include "utildefines.h"
 #include "system_definitions.h"
 
@@ -132,6 +134,9 @@ static void transmitFinish(AppShiftRegisterData* app_shift_register_data) {
     SHIFT_RCK_PULL_DOWN();
     SHIFT_EN_PULL_DOWN();
     app_shift_register_data->state = APP_SHIFT_REGISTER_STATE_IDLE;
+    APP_Event_Post(app_shift_register_data->app_event_bus,
+                   APP_EVENT_SHIFT_REGISTER_DONE,
+                   app_shift_register_data);
     return;
   }
   // Toggle RCK to copy data from shift register to storage.
@@ -150,8 +155,10 @@ static void transmitPause(AppShiftRegisterData* app_shift_register_data) {
 }
 
 void APP_ShiftRegister_Initialize(
-    AppShiftRegisterData* app_shift_register_data) {
+    AppShiftRegisterData* app_shift_register_data,
+    AppEventBus* app_event_bus) {
   app_shift_register_data->state = APP_SHIFT_REGISTER_STATE_IDLE;
+  app_shift_register_data->app_event_bus = app_event_bus;
   SHIFT_EN_PULL_DOWN();
   SHIFT_DATA_PULL_DOWN();
   SHIFT_RCK_PULL_DOWN();
@@ -194,14 +201,16 @@ void APP_ShiftRegister_SetEnabled(
 
 void APP_ShiftRegister_SendData(
     AppShiftRegisterData* app_shift_register_data,
-    uint8_t* data,
+    const uint8_t* data,
     size_t num_bytes) {
   // TODO(sergey): Check shift registers are ready for data transmit.
   SHIFT_REGISTER_DEBUG_PRINT("Begin transmittance of %d bytes.\r\n", num_bytes);
-  memcpy(app_shift_register_data->_private.send.data,
-         data,
-         sizeof(app_shift_register_data->_private.send.data));
-  // TODO(sergey): Clip num_bytes here.
+  SYS_ASSERT(num_bytes <= SHIFT_REGISTER_MAX_DATA,
+             "\r\nToo many bytes for shift registers chain");
+  if (num_bytes > SHIFT_REGISTER_MAX_DATA) {
+    num_bytes = SHIFT_REGISTER_MAX_DATA;
+  }
+  memcpy(app_shift_register_data->_private.send.data, data, num_bytes);
   app_shift_register_data->_private.send.num_bytes = num_bytes;
   // Begin transmittance.
   app_shift_register_data->state = APP_SHIFT_REGISTER_STATE_TRANSMIT_BEGIN;
@@ -27,8 +27,14 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "app_config.h"
+#include "app_event.h"
+
 // Maximum number of bytes to be sent to shift registers.
-#define SHIFT_REGISTER_MAX_DATA 6
+//
+// Matches the length of the daisy-chain, so transfer buffer does not waste
+// memory on boards with shorter chains.
+#define SHIFT_REGISTER_MAX_DATA APP_CONFIG_NUM_SHIFT_REGISTERS
 
 typedef enum {
   // No tasks to be performed.
@@ -45,6 +51,8 @@ typedef enum {
 
 typedef struct AppShiftRegisterData {
   AppShiftRegisterState state;
+  // Bus to which completion of data transmission is posted.
+  AppEventBus* app_event_bus;
   // Per-task storage.
   union {
     struct {
@@ -64,7 +72,8 @@ typedef struct AppShiftRegisterData {
 
 // Initialize shift register related application routines.
 void APP_ShiftRegister_Initialize(
-    AppShiftRegisterData* app_shift_register_data);
+    AppShiftRegisterData* app_shift_register_data,
+    AppEventBus* app_event_bus);
 
 // Perform all shift register related tasks.
 void APP_ShiftRegister_Tasks(AppShiftRegisterData* app_shift_register_data);
@@ -79,9 +88,11 @@ void APP_ShiftRegister_SetEnabled(
 
 // Send data to shift registers. Assumes all shift registers are daisy-chained.
 // Starts with least significant bit of data[0].
+//
+// NOTE: At max of SHIFT_REGISTER_MAX_DATA bytes will be sent.
 void APP_ShiftRegister_SendData(
     AppShiftRegisterData* app_shift_register_data,
-    uint8_t* data,
+    const uint8_t* data,
     size_t num_bytes);
 
 #endif  // _APP_SHIFT_REGISTER_H
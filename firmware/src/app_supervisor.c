@@ -0,0 +1,195 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_supervisor.h"
+
+#include <stddef.h>
+#include <xc.h>
+
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#define LOG_PREFIX "APP SUPERVISOR: "
+
+// Regular print / message.
+#define SUPERVISOR_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define SUPERVISOR_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Error print / message.
+#define SUPERVISOR_ERROR_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define SUPERVISOR_ERROR_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+static uint64_t currentTimeMs(void) {
+  return SYS_TMR_SystemCountGet() * 1000 / SYS_TMR_SystemCountFrequencyGet();
+}
+
+// NOTE: Watchdog period is configured by the WDTPS configuration bit, the
+// watchdog itself is disabled by FWDTEN so it is only enabled once the
+// supervisor is up and running.
+static void watchdogEnable(void) {
+  WDTCONSET = _WDTCON_ON_MASK;
+}
+
+static void watchdogFeed(void) {
+  WDTCONSET = _WDTCON_WDTCLR_MASK;
+}
+
+static void recordStall(AppSupervisorData* app_supervisor_data,
+                        const AppSupervisorModule* module,
+                        uint64_t current_time_ms) {
+  AppSupervisorStall* stall =
+      &app_supervisor_data->stalls[app_supervisor_data->num_stalls %
+                                   APP_CONFIG_NUM_SUPERVISOR_STALLS];
+  stall->name = module->name;
+  stall->state = module->current_state;
+  stall->duration_ms = current_time_ms - module->state_entered_ms;
+  stall->detected_ms = current_time_ms;
+  stall->is_recovered = (module->recover != NULL);
+  ++app_supervisor_data->num_stalls;
+}
+
+// Check the module, returns false if it is stalled.
+static bool checkModule(AppSupervisorData* app_supervisor_data,
+                        AppSupervisorModule* module,
+                        uint64_t current_time_ms) {
+  const int state = module->state(module->user_data);
+  if (state != module->current_state) {
+    module->current_state = state;
+    module->state_entered_ms = current_time_ms;
+    module->is_stalled = false;
+    return true;
+  }
+  if (module->is_stalled) {
+    // Stall was already reported, keep starving the watchdog.
+    return false;
+  }
+  const uint32_t budget = module->budget(module->user_data, state);
+  if (budget == APP_SUPERVISOR_NO_BUDGET ||
+      current_time_ms - module->state_entered_ms <= budget) {
+    return true;
+  }
+  SUPERVISOR_ERROR_PRINT("Module %s stalled in state %d for %u ms.\r\n",
+                         module->name,
+                         state,
+                         (uint32_t)(current_time_ms -
+                                    module->state_entered_ms));
+  recordStall(app_supervisor_data, module, current_time_ms);
+  ++module->num_stalls;
+  if (module->recover == NULL) {
+    module->is_stalled = true;
+    return false;
+  }
+  module->recover(module->user_data);
+  // Start counting from scratch, even if recovery kept the state.
+  module->current_state = module->state(module->user_data);
+  module->state_entered_ms = current_time_ms;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_Supervisor_Initialize(AppSupervisorData* app_supervisor_data) {
+  app_supervisor_data->num_modules = 0;
+  app_supervisor_data->num_stalls = 0;
+  app_supervisor_data->next_check_ms = 0;
+  app_supervisor_data->is_watchdog_reset = (RCON & _RCON_WDTO_MASK) != 0;
+  app_supervisor_data->is_watchdog_fed = true;
+  RCONCLR = _RCON_WDTO_MASK;
+  if (app_supervisor_data->is_watchdog_reset) {
+    SUPERVISOR_ERROR_MESSAGE("System was reset by the watchdog.\r\n");
+  }
+  watchdogFeed();
+  watchdogEnable();
+  SYS_MESSAGE("Supervisor subsystem initialized.\r\n");
+}
+
+bool APP_Supervisor_Register(AppSupervisorData* app_supervisor_data,
+                             const char* name,
+                             AppSupervisorStateFunc state,
+                             AppSupervisorBudgetFunc budget,
+                             AppSupervisorRecoverFunc recover,
+                             void* user_data) {
+  SYS_ASSERT(app_supervisor_data->num_modules <
+                 APP_CONFIG_NUM_SUPERVISOR_MODULES,
+             "\r\nToo many supervised modules\r\n");
+  if (app_supervisor_data->num_modules >= APP_CONFIG_NUM_SUPERVISOR_MODULES) {
+    return false;
+  }
+  AppSupervisorModule* module =
+      &app_supervisor_data->modules[app_supervisor_data->num_modules++];
+  module->name = name;
+  module->state = state;
+  module->budget = budget;
+  module->recover = recover;
+  module->user_data = user_data;
+  module->current_state = state(user_data);
+  module->state_entered_ms = currentTimeMs();
+  module->is_stalled = false;
+  module->num_stalls = 0;
+  return true;
+}
+
+void APP_Supervisor_Tasks(AppSupervisorData* app_supervisor_data) {
+  const uint64_t current_time_ms = currentTimeMs();
+  if (current_time_ms < app_supervisor_data->next_check_ms) {
+    return;
+  }
+  app_supervisor_data->next_check_ms =
+      current_time_ms + APP_CONFIG_SUPERVISOR_CHECK_INTERVAL;
+  bool is_progressing = true;
+  int i;
+  for (i = 0; i < app_supervisor_data->num_modules; ++i) {
+    if (!checkModule(app_supervisor_data,
+                     &app_supervisor_data->modules[i],
+                     current_time_ms)) {
+      is_progressing = false;
+    }
+  }
+  if (is_progressing) {
+    watchdogFeed();
+  } else if (app_supervisor_data->is_watchdog_fed) {
+    SUPERVISOR_ERROR_MESSAGE("Stopped feeding the watchdog.\r\n");
+  }
+  app_supervisor_data->is_watchdog_fed = is_progressing;
+}
+
+uint64_t APP_Supervisor_NextDeadline(AppSupervisorData* app_supervisor_data) {
+  // NOTE: Round up, so the check is not skipped when deadline is reached.
+  const uint32_t frequency = SYS_TMR_SystemCountFrequencyGet();
+  return (app_supervisor_data->next_check_ms * frequency + 999) / 1000;
+}
+
+const AppSupervisorStall* APP_Supervisor_StallGet(
+    AppSupervisorData* app_supervisor_data, int index) {
+  if (index < 0 || (uint32_t)index >= app_supervisor_data->num_stalls ||
+      index >= APP_CONFIG_NUM_SUPERVISOR_STALLS) {
+    return NULL;
+  }
+  const uint32_t stall_index = app_supervisor_data->num_stalls - 1 - index;
+  return &app_supervisor_data->stalls[stall_index %
+                                      APP_CONFIG_NUM_SUPERVISOR_STALLS];
+}
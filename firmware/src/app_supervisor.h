@@ -0,0 +1,132 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_SUPERVISOR_H
+#define _APP_SUPERVISOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// Supervisor of the module state machines.
+//
+// Every supervised module reports its current state and a time budget for
+// every state. Module which stays in the same state for longer than the
+// budget is considered stalled: the stall is logged and the module is asked
+// to recover (which usually means aborting current operation and going back
+// to an idle state).
+//
+// Supervisor also feeds the hardware watchdog. It keeps doing so while all
+// the modules are progressing or were recovered, so a stall of the module
+// which can not be recovered (or a hang of the main loop itself) resets the
+// whole system.
+
+// Budget of a state in which module can stay for as long as it wants.
+#define APP_SUPERVISOR_NO_BUDGET UINT32_MAX
+
+// Get current state of the module.
+typedef int (*AppSupervisorStateFunc)(void* user_data);
+
+// Get time in milliseconds the module is allowed to spend in the given state.
+typedef uint32_t (*AppSupervisorBudgetFunc)(void* user_data, int state);
+
+// Bring stalled module back to a sane state.
+typedef void (*AppSupervisorRecoverFunc)(void* user_data);
+
+typedef struct AppSupervisorModule {
+  // Human readable name, used for reports.
+  const char* name;
+  AppSupervisorStateFunc state;
+  AppSupervisorBudgetFunc budget;
+  // If NULL, the stall is not recovered and watchdog is not fed anymore.
+  AppSupervisorRecoverFunc recover;
+  void* user_data;
+
+  // State observed on the last check and time it was first observed at, in
+  // milliseconds.
+  int current_state;
+  uint64_t state_entered_ms;
+  // Module exceeded budget of its current state and was not recovered.
+  bool is_stalled;
+
+  // Statistics.
+  uint32_t num_stalls;
+} AppSupervisorModule;
+
+// Record of a detected stall.
+typedef struct AppSupervisorStall {
+  const char* name;
+  int state;
+  // Time module spent in the state before stall was detected.
+  uint32_t duration_ms;
+  // Time at which stall was detected, in milliseconds since boot.
+  uint64_t detected_ms;
+  bool is_recovered;
+} AppSupervisorStall;
+
+typedef struct AppSupervisorData {
+  AppSupervisorModule modules[APP_CONFIG_NUM_SUPERVISOR_MODULES];
+  int num_modules;
+
+  // Ring buffer of the most recent stalls.
+  AppSupervisorStall stalls[APP_CONFIG_NUM_SUPERVISOR_STALLS];
+  // Total number of detected stalls, the newest one is stored at
+  // (num_stalls - 1) % APP_CONFIG_NUM_SUPERVISOR_STALLS.
+  uint32_t num_stalls;
+
+  // Time at which the modules are to be checked next time, in milliseconds.
+  uint64_t next_check_ms;
+
+  // Previous reset of the system was caused by the watchdog.
+  bool is_watchdog_reset;
+  // Watchdog was fed on the last check.
+  bool is_watchdog_fed;
+} AppSupervisorData;
+
+// Initialize supervisor with no modules and enable hardware watchdog.
+void APP_Supervisor_Initialize(AppSupervisorData* app_supervisor_data);
+
+// Register new module to be supervised.
+//
+// Returns truth on success.
+bool APP_Supervisor_Register(AppSupervisorData* app_supervisor_data,
+                             const char* name,
+                             AppSupervisorStateFunc state,
+                             AppSupervisorBudgetFunc budget,
+                             AppSupervisorRecoverFunc recover,
+                             void* user_data);
+
+// Check all the modules if it is time to, and feed the watchdog if none of
+// them is stalled.
+void APP_Supervisor_Tasks(AppSupervisorData* app_supervisor_data);
+
+// Get system timer count at which supervisor tasks are to be invoked next.
+uint64_t APP_Supervisor_NextDeadline(AppSupervisorData* app_supervisor_data);
+
+// Get stall record, index 0 is the most recent one.
+//
+// Returns NULL if there is no such record.
+const AppSupervisorStall* APP_Supervisor_StallGet(
+    AppSupervisorData* app_supervisor_data, int index);
+
+#endif  // _APP_SUPERVISOR_H
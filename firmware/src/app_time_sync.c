@@ -0,0 +1,333 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_time_sync.h"
+
+#include <string.h>
+
+#include "app_rtc.h"
+#include "system_definitions.h"
+#include "utildefines.h"
+
+#include <tcpip/sntp.h>
+
+#define LOG_PREFIX "APP TIME SYNC: "
+
+// Regular print / message.
+#define TIME_SYNC_PRINT(format, ...) \
+  APP_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define TIME_SYNC_MESSAGE(message) APP_MESSAGE(LOG_PREFIX, message)
+// Debug print / message.
+#define TIME_SYNC_DEBUG_PRINT(format, ...) \
+  APP_DEBUG_PRINT(LOG_PREFIX, format, ##__VA_ARGS__)
+#define TIME_SYNC_DEBUG_MESSAGE(message) APP_DEBUG_MESSAGE(LOG_PREFIX, message)
+
+// Offset from the Unix epoch to 2000-01-01, in seconds.
+#define UNIX_TIME_2000 946684800u
+
+// SNTP reports time since the boot until it got reply from the server, so
+// anything before 2017-01-01 is considered to be not synchronized.
+#define MIN_VALID_TIMESTAMP (1483228800u - UNIX_TIME_2000)
+
+// Offset in seconds at which the RTC is stepped to the SNTP time. Smaller
+// offsets are not trusted since both clocks only report whole seconds.
+#define STEP_THRESHOLD 2
+
+// Drift in parts per billion below which the trim is considered converged.
+#define CONVERGED_DRIFT_PPB (2 * RTC_MCP7940N_CALIBRATION_STEP_PPB)
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+// Get SNTP time in seconds since 2000-01-01.
+//
+// Returns false if SNTP did not receive time from the server yet.
+static bool sntpTimestampGet(uint32_t* timestamp) {
+  const uint32_t utc_seconds = TCPIP_SNTP_UTCSecondsGet();
+  if (utc_seconds < UNIX_TIME_2000 + MIN_VALID_TIMESTAMP) {
+    return false;
+  }
+  *timestamp = utc_seconds - UNIX_TIME_2000;
+  return true;
+}
+
+static void scheduleNextSync(AppTimeSyncData* app_time_sync_data,
+                             uint32_t interval) {
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_IDLE;
+  APP_Timer_Start(app_time_sync_data->app_timer_wheel,
+                  &app_time_sync_data->interval_timer,
+                  interval * 1000);
+}
+
+static void correctionAdd(AppTimeSyncData* app_time_sync_data,
+                          int32_t offset,
+                          int32_t drift_ppb) {
+  app_time_sync_data->corrections_head =
+      (app_time_sync_data->corrections_head + 1) %
+      APP_CONFIG_NUM_TIME_SYNC_CORRECTIONS;
+  if (app_time_sync_data->num_corrections <
+      APP_CONFIG_NUM_TIME_SYNC_CORRECTIONS) {
+    ++app_time_sync_data->num_corrections;
+  }
+  AppTimeSyncCorrection* correction =
+      &app_time_sync_data->corrections[app_time_sync_data->corrections_head];
+  correction->timestamp = app_time_sync_data->sntp_timestamp;
+  correction->offset = offset;
+  correction->drift_ppb = drift_ppb;
+  correction->calibration = app_time_sync_data->calibration;
+}
+
+static void calibrationReadCallback(RTC_MCP7940N* rtc,
+                                    bool success,
+                                    void* user_data) {
+  AppTimeSyncData* app_time_sync_data = (AppTimeSyncData*)user_data;
+  if (!success) {
+    TIME_SYNC_MESSAGE("Failed to read calibration register.\r\n");
+    app_time_sync_data->state = APP_TIME_SYNC_STATE_READ_CALIBRATION;
+    return;
+  }
+  TIME_SYNC_DEBUG_PRINT("Current calibration: 0x%02x.\r\n",
+                        app_time_sync_data->calibration);
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_READ_RTC;
+}
+
+static void rtcReadCallback(RTC_MCP7940N* rtc,
+                            bool success,
+                            void* user_data) {
+  AppTimeSyncData* app_time_sync_data = (AppTimeSyncData*)user_data;
+  if (!success) {
+    TIME_SYNC_MESSAGE("Failed to read time from RTC.\r\n");
+    scheduleNextSync(app_time_sync_data, APP_CONFIG_TIME_SYNC_RETRY_INTERVAL);
+    return;
+  }
+  // Sample SNTP time as close to the RTC read as possible.
+  if (!sntpTimestampGet(&app_time_sync_data->sntp_timestamp)) {
+    scheduleNextSync(app_time_sync_data, APP_CONFIG_TIME_SYNC_RETRY_INTERVAL);
+    return;
+  }
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_COMPARE;
+}
+
+static void rtcWriteCallback(RTC_MCP7940N* rtc,
+                             bool success,
+                             void* user_data) {
+  AppTimeSyncData* app_time_sync_data = (AppTimeSyncData*)user_data;
+  if (!success) {
+    // Baseline does not match the RTC anymore.
+    TIME_SYNC_MESSAGE("Failed to write correction to RTC.\r\n");
+    app_time_sync_data->has_baseline = false;
+    scheduleNextSync(app_time_sync_data, APP_CONFIG_TIME_SYNC_RETRY_INTERVAL);
+    return;
+  }
+  APP_RTC_TimeCacheInvalidate(app_time_sync_data->app_rtc);
+  scheduleNextSync(app_time_sync_data, app_time_sync_data->interval);
+}
+
+static void readCalibration(AppTimeSyncData* app_time_sync_data) {
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_WAIT_CALIBRATION;
+  if (!RTC_MCP7940N_ReadRegister(&app_time_sync_data->app_rtc->rtc_handle,
+                                 MCP7940N_REG_ADDR_CALIB,
+                                 &app_time_sync_data->calibration,
+                                 calibrationReadCallback,
+                                 app_time_sync_data)) {
+    // Queue is full, try again on the next pass.
+    app_time_sync_data->state = APP_TIME_SYNC_STATE_READ_CALIBRATION;
+  }
+}
+
+static void readRTC(AppTimeSyncData* app_time_sync_data) {
+  uint32_t sntp_timestamp;
+  if (!sntpTimestampGet(&sntp_timestamp)) {
+    TIME_SYNC_DEBUG_MESSAGE("SNTP has no time yet.\r\n");
+    scheduleNextSync(app_time_sync_data, APP_CONFIG_TIME_SYNC_RETRY_INTERVAL);
+    return;
+  }
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_WAIT_READ_RTC;
+  if (!RTC_MCP7940N_ReadDateAndTime(&app_time_sync_data->app_rtc->rtc_handle,
+                                    &app_time_sync_data->rtc_date_time,
+                                    rtcReadCallback,
+                                    app_time_sync_data)) {
+    app_time_sync_data->state = APP_TIME_SYNC_STATE_READ_RTC;
+  }
+}
+
+// Step the RTC to the SNTP time and program current calibration.
+static void writeCorrection(AppTimeSyncData* app_time_sync_data) {
+  RTC_MCP7940N_Batch* batch = &app_time_sync_data->correction_batch;
+  RTC_MCP7940N_DateTime date_time;
+  APP_RTC_DateTimeFromSeconds(app_time_sync_data->sntp_timestamp, &date_time);
+  RTC_MCP7940N_BatchInitialize(batch);
+  RTC_MCP7940N_BatchSetDateAndTime(batch, &date_time);
+  RTC_MCP7940N_BatchSetBits(batch,
+                            MCP7940N_REG_ADDR_CALIB,
+                            0xff,
+                            app_time_sync_data->calibration);
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_WAIT_WRITE_RTC;
+  if (!RTC_MCP7940N_WriteBatch(&app_time_sync_data->app_rtc->rtc_handle,
+                               batch,
+                               rtcWriteCallback,
+                               app_time_sync_data)) {
+    // Queue is full, compare again on the next pass.
+    app_time_sync_data->state = APP_TIME_SYNC_STATE_READ_RTC;
+  }
+}
+
+static void compareWithSNTP(AppTimeSyncData* app_time_sync_data) {
+  const uint32_t sntp_timestamp = app_time_sync_data->sntp_timestamp;
+  uint32_t rtc_timestamp;
+  if (!APP_RTC_DateTimeToSeconds(&app_time_sync_data->rtc_date_time,
+                                 &rtc_timestamp)) {
+    // RTC lost its time, nothing to estimate from.
+    TIME_SYNC_MESSAGE("RTC has invalid time, setting it.\r\n");
+    app_time_sync_data->has_baseline = false;
+    rtc_timestamp = 0;
+  }
+  const int32_t offset = (int32_t)(rtc_timestamp - sntp_timestamp);
+  app_time_sync_data->last_sync_timestamp = sntp_timestamp;
+  app_time_sync_data->last_sync_offset = offset;
+  TIME_SYNC_DEBUG_PRINT("RTC offset from SNTP: %d seconds.\r\n", offset);
+  const bool need_step = (offset >= STEP_THRESHOLD ||
+                          offset <= -STEP_THRESHOLD);
+  if (!app_time_sync_data->has_baseline ||
+      sntp_timestamp <= app_time_sync_data->baseline_timestamp) {
+    // Nothing to estimate drift from, only start new baseline.
+    app_time_sync_data->has_baseline = true;
+    app_time_sync_data->baseline_timestamp = sntp_timestamp;
+    app_time_sync_data->interval = APP_CONFIG_TIME_SYNC_MIN_INTERVAL;
+    if (need_step) {
+      app_time_sync_data->baseline_offset = 0;
+      correctionAdd(app_time_sync_data, offset, 0);
+      writeCorrection(app_time_sync_data);
+    } else {
+      app_time_sync_data->baseline_offset = offset;
+      scheduleNextSync(app_time_sync_data, app_time_sync_data->interval);
+    }
+    return;
+  }
+  const int32_t delta = offset - app_time_sync_data->baseline_offset;
+  if (delta < STEP_THRESHOLD && delta > -STEP_THRESHOLD && !need_step) {
+    // No drift is detectable yet, check less often.
+    app_time_sync_data->interval *= 2;
+    if (app_time_sync_data->interval > APP_CONFIG_TIME_SYNC_MAX_INTERVAL) {
+      app_time_sync_data->interval = APP_CONFIG_TIME_SYNC_MAX_INTERVAL;
+    }
+    scheduleNextSync(app_time_sync_data, app_time_sync_data->interval);
+    return;
+  }
+  // RTC has drifted away since the baseline, which is reliable once it went
+  // off by more than the whole second resolution.
+  const uint32_t elapsed =
+      sntp_timestamp - app_time_sync_data->baseline_timestamp;
+  const int32_t drift_ppb = (int32_t)((int64_t)delta * 1000000000 / elapsed);
+  const int32_t correction_ppb =
+      RTC_MCP7940N_CalibrationToPPB(app_time_sync_data->calibration) -
+      drift_ppb;
+  app_time_sync_data->drift_ppb = drift_ppb;
+  app_time_sync_data->calibration =
+      RTC_MCP7940N_CalibrationFromPPB(correction_ppb);
+  TIME_SYNC_PRINT("Drift of %d ppb over %u seconds, calibration 0x%02x.\r\n",
+                  drift_ppb, elapsed, app_time_sync_data->calibration);
+  if (drift_ppb > CONVERGED_DRIFT_PPB || drift_ppb < -CONVERGED_DRIFT_PPB) {
+    app_time_sync_data->interval = APP_CONFIG_TIME_SYNC_MIN_INTERVAL;
+  }
+  app_time_sync_data->baseline_timestamp = sntp_timestamp;
+  app_time_sync_data->baseline_offset = 0;
+  correctionAdd(app_time_sync_data, offset, drift_ppb);
+  writeCorrection(app_time_sync_data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_TimeSync_Initialize(AppTimeSyncData* app_time_sync_data,
+                             AppRTCData* app_rtc,
+                             AppTimerWheel* app_timer_wheel) {
+  memset(app_time_sync_data, 0, sizeof(*app_time_sync_data));
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_READ_CALIBRATION;
+  app_time_sync_data->app_rtc = app_rtc;
+  app_time_sync_data->app_timer_wheel = app_timer_wheel;
+  app_time_sync_data->interval = APP_CONFIG_TIME_SYNC_MIN_INTERVAL;
+  app_time_sync_data->corrections_head = -1;
+  APP_Timer_Setup(&app_time_sync_data->interval_timer, NULL, NULL);
+  SYS_MESSAGE("Time synchronization subsystem initialized.\r\n");
+}
+
+void APP_TimeSync_Tasks(AppTimeSyncData* app_time_sync_data) {
+  switch (app_time_sync_data->state) {
+    case APP_TIME_SYNC_STATE_READ_CALIBRATION:
+      readCalibration(app_time_sync_data);
+      break;
+    case APP_TIME_SYNC_STATE_IDLE:
+      if (APP_Timer_IsExpired(&app_time_sync_data->interval_timer)) {
+        readRTC(app_time_sync_data);
+      }
+      break;
+    case APP_TIME_SYNC_STATE_READ_RTC:
+      readRTC(app_time_sync_data);
+      break;
+    case APP_TIME_SYNC_STATE_COMPARE:
+      compareWithSNTP(app_time_sync_data);
+      break;
+    case APP_TIME_SYNC_STATE_WAIT_CALIBRATION:
+    case APP_TIME_SYNC_STATE_WAIT_READ_RTC:
+    case APP_TIME_SYNC_STATE_WAIT_WRITE_RTC:
+      // Waiting for the RTC callback.
+      break;
+  }
+}
+
+bool APP_TimeSync_IsRunnable(AppTimeSyncData* app_time_sync_data) {
+  switch (app_time_sync_data->state) {
+    case APP_TIME_SYNC_STATE_READ_CALIBRATION:
+    case APP_TIME_SYNC_STATE_READ_RTC:
+    case APP_TIME_SYNC_STATE_COMPARE:
+      return true;
+    case APP_TIME_SYNC_STATE_IDLE:
+      return APP_Timer_IsExpired(&app_time_sync_data->interval_timer);
+    case APP_TIME_SYNC_STATE_WAIT_CALIBRATION:
+    case APP_TIME_SYNC_STATE_WAIT_READ_RTC:
+    case APP_TIME_SYNC_STATE_WAIT_WRITE_RTC:
+      return false;
+  }
+  return false;
+}
+
+void APP_TimeSync_Request(AppTimeSyncData* app_time_sync_data) {
+  if (app_time_sync_data->state != APP_TIME_SYNC_STATE_IDLE) {
+    // Comparison is already in progress or is about to happen.
+    return;
+  }
+  APP_Timer_Cancel(app_time_sync_data->app_timer_wheel,
+                   &app_time_sync_data->interval_timer);
+  app_time_sync_data->state = APP_TIME_SYNC_STATE_READ_RTC;
+}
+
+const AppTimeSyncCorrection* APP_TimeSync_CorrectionGet(
+    const AppTimeSyncData* app_time_sync_data, int index) {
+  if (index < 0 || index >= app_time_sync_data->num_corrections) {
+    return NULL;
+  }
+  const int slot = (app_time_sync_data->corrections_head - index +
+                    APP_CONFIG_NUM_TIME_SYNC_CORRECTIONS) %
+                   APP_CONFIG_NUM_TIME_SYNC_CORRECTIONS;
+  return &app_time_sync_data->corrections[slot];
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_TIME_SYNC_H
+#define _APP_TIME_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "app_timer.h"
+#include "rtc_mcp7940n.h"
+
+struct AppRTCData;
+
+// Discipline of the RTC by the SNTP time.
+//
+// Time of the RTC is periodically compared with the SNTP time. Once the RTC
+// went off by more than a second since the last correction, its frequency
+// drift is estimated from the offset and time passed, the calibration
+// register is trimmed to compensate the drift and the time is stepped to the
+// SNTP time. Every comparison which shows no drift doubles the interval until
+// the next one, so network is used rarely once the trim has converged.
+
+typedef enum AppTimeSyncState {
+  // Read current value of the calibration register.
+  APP_TIME_SYNC_STATE_READ_CALIBRATION,
+  APP_TIME_SYNC_STATE_WAIT_CALIBRATION,
+  // Wait for the interval timer to expire.
+  APP_TIME_SYNC_STATE_IDLE,
+  // Read time from the RTC to be compared with the SNTP time.
+  APP_TIME_SYNC_STATE_READ_RTC,
+  APP_TIME_SYNC_STATE_WAIT_READ_RTC,
+  // Compare time which was read with the SNTP time.
+  APP_TIME_SYNC_STATE_COMPARE,
+  // Wait for the correction of the RTC to be written.
+  APP_TIME_SYNC_STATE_WAIT_WRITE_RTC,
+} AppTimeSyncState;
+
+// Correction which was applied to the RTC.
+typedef struct AppTimeSyncCorrection {
+  // SNTP time at which correction was applied, seconds since 2000-01-01.
+  uint32_t timestamp;
+  // Offset of the RTC from the SNTP time in seconds, positive if the RTC was
+  // ahead.
+  int32_t offset;
+  // Estimated drift of the RTC in parts per billion, positive if the RTC was
+  // running fast. Zero if drift was not estimated.
+  int32_t drift_ppb;
+  // New value of the calibration register.
+  uint8_t calibration;
+} AppTimeSyncCorrection;
+
+typedef struct AppTimeSyncData {
+  AppTimeSyncState state;
+
+  struct AppRTCData* app_rtc;
+  AppTimerWheel* app_timer_wheel;
+  AppTimer interval_timer;
+
+  // Current interval between comparisons, in seconds.
+  uint32_t interval;
+
+  // Current value of the calibration register.
+  uint8_t calibration;
+
+  // Offset of the RTC at the baseline SNTP time. Drift is estimated from
+  // the change of the offset since the baseline.
+  bool has_baseline;
+  uint32_t baseline_timestamp;
+  int32_t baseline_offset;
+
+  // Last estimated drift, in parts per billion. The drift is estimated with
+  // the trim which was active at that time.
+  int32_t drift_ppb;
+
+  // SNTP time of the last comparison, zero if there was none yet.
+  uint32_t last_sync_timestamp;
+  int32_t last_sync_offset;
+
+  // Values for the comparison which is in progress.
+  RTC_MCP7940N_DateTime rtc_date_time;
+  uint32_t sntp_timestamp;
+  RTC_MCP7940N_Batch correction_batch;
+
+  // Ring buffer of the most recent corrections.
+  AppTimeSyncCorrection corrections[APP_CONFIG_NUM_TIME_SYNC_CORRECTIONS];
+  int num_corrections;
+  int corrections_head;
+} AppTimeSyncData;
+
+// Initialize time discipline, first comparison happens once SNTP has time.
+void APP_TimeSync_Initialize(AppTimeSyncData* app_time_sync_data,
+                             struct AppRTCData* app_rtc,
+                             AppTimerWheel* app_timer_wheel);
+
+// Perform all time discipline related tasks.
+void APP_TimeSync_Tasks(AppTimeSyncData* app_time_sync_data);
+
+// Check whether time discipline tasks are to be performed.
+bool APP_TimeSync_IsRunnable(AppTimeSyncData* app_time_sync_data);
+
+// Compare the RTC with SNTP time as soon as possible.
+void APP_TimeSync_Request(AppTimeSyncData* app_time_sync_data);
+
+// Get correction with the given index, 0 is the most recent one.
+//
+// Returns NULL if there is no such correction.
+const AppTimeSyncCorrection* APP_TimeSync_CorrectionGet(
+    const AppTimeSyncData* app_time_sync_data, int index);
+
+#endif  // _APP_TIME_SYNC_H
@@ -0,0 +1,215 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "app_timer.h"
+
+#include "system_definitions.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Internal routines.
+
+// Current time in milliseconds.
+static uint64_t currentTick(void) {
+  return SYS_TMR_SystemCountGet() * 1000 / SYS_TMR_SystemCountFrequencyGet();
+}
+
+static void listInsert(AppTimer** head, AppTimer* timer) {
+  timer->next = *head;
+  if (*head != NULL) {
+    (*head)->pprev = &timer->next;
+  }
+  *head = timer;
+  timer->pprev = head;
+}
+
+static void listRemove(AppTimer* timer) {
+  *timer->pprev = timer->next;
+  if (timer->next != NULL) {
+    timer->next->pprev = timer->pprev;
+  }
+  timer->next = NULL;
+  timer->pprev = NULL;
+}
+
+// Get slot list which will be processed at the tick the timer expires at,
+// or when it is to be moved to a lower level of the wheel.
+static AppTimer** timerSlot(AppTimerWheel* app_timer_wheel,
+                            uint64_t expires) {
+  const uint64_t delta = expires - app_timer_wheel->tick;
+  int level;
+  for (level = 0; level < TIMER_WHEEL_NUM_LEVELS; ++level) {
+    const int shift = level * TIMER_WHEEL_BITS;
+    if ((delta >> shift) < TIMER_WHEEL_SIZE) {
+      return &app_timer_wheel->slots[level][(expires >> shift) &
+                                            TIMER_WHEEL_MASK];
+    }
+  }
+  // Timeout is too long, put timer to the furthest slot, it will be put
+  // to a proper place when reached.
+  const int shift = (TIMER_WHEEL_NUM_LEVELS - 1) * TIMER_WHEEL_BITS;
+  const uint64_t furthest_tick = app_timer_wheel->tick +
+      ((uint64_t)TIMER_WHEEL_SIZE << shift) - 1;
+  return &app_timer_wheel->slots[TIMER_WHEEL_NUM_LEVELS - 1]
+                                [(furthest_tick >> shift) & TIMER_WHEEL_MASK];
+}
+
+static void timerInsert(AppTimerWheel* app_timer_wheel, AppTimer* timer) {
+  if (timer->expires < app_timer_wheel->tick) {
+    timer->expires = app_timer_wheel->tick;
+  }
+  listInsert(timerSlot(app_timer_wheel, timer->expires), timer);
+}
+
+// Move all timers from the given slot of the upper level to the lower ones.
+static void cascadeSlot(AppTimerWheel* app_timer_wheel, int level) {
+  const int shift = level * TIMER_WHEEL_BITS;
+  AppTimer** head = &app_timer_wheel->slots[level][
+      (app_timer_wheel->tick >> shift) & TIMER_WHEEL_MASK];
+  AppTimer* timer = *head;
+  *head = NULL;
+  while (timer != NULL) {
+    AppTimer* next = timer->next;
+    timerInsert(app_timer_wheel, timer);
+    timer = next;
+  }
+}
+
+static void processTick(AppTimerWheel* app_timer_wheel) {
+  // Move timers from upper levels when lower level wraps around.
+  int level;
+  for (level = TIMER_WHEEL_NUM_LEVELS - 1; level > 0; --level) {
+    const uint64_t mask = ((uint64_t)1 << (level * TIMER_WHEEL_BITS)) - 1;
+    if ((app_timer_wheel->tick & mask) == 0) {
+      cascadeSlot(app_timer_wheel, level);
+    }
+  }
+  // Detach expired timers from the slot and move on to the next tick before
+  // invoking callbacks, so timers which are re-started from a callback with
+  // zero timeout expire on the next tick instead of the current one.
+  AppTimer** head =
+      &app_timer_wheel->slots[0][app_timer_wheel->tick & TIMER_WHEEL_MASK];
+  AppTimer* expired = *head;
+  *head = NULL;
+  if (expired != NULL) {
+    expired->pprev = &expired;
+  }
+  ++app_timer_wheel->tick;
+  while (expired != NULL) {
+    AppTimer* timer = expired;
+    listRemove(timer);
+    timer->is_armed = false;
+    timer->is_expired = true;
+    --app_timer_wheel->num_armed;
+    // NOTE: Callback is allowed to re-start or cancel any timer, including
+    // the ones which are yet to be expired in this tick.
+    if (timer->callback != NULL) {
+      timer->callback(timer->user_data);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_Timer_Initialize(AppTimerWheel* app_timer_wheel) {
+  int level, slot;
+  for (level = 0; level < TIMER_WHEEL_NUM_LEVELS; ++level) {
+    for (slot = 0; slot < TIMER_WHEEL_SIZE; ++slot) {
+      app_timer_wheel->slots[level][slot] = NULL;
+    }
+  }
+  app_timer_wheel->tick = currentTick();
+  app_timer_wheel->num_armed = 0;
+}
+
+void APP_Timer_Tasks(AppTimerWheel* app_timer_wheel) {
+  const uint64_t current_tick = currentTick();
+  while (app_timer_wheel->tick <= current_tick) {
+    if (app_timer_wheel->num_armed == 0) {
+      // Nothing to expire, skip all the ticks.
+      app_timer_wheel->tick = current_tick + 1;
+      break;
+    }
+    processTick(app_timer_wheel);
+  }
+}
+
+uint64_t APP_Timer_NextExpiry(AppTimerWheel* app_timer_wheel) {
+  if (app_timer_wheel->num_armed == 0) {
+    return UINT64_MAX;
+  }
+  // Look for the closest timer on the lowest level, otherwise wake up when
+  // timers from the upper level are to be moved down.
+  uint64_t tick = app_timer_wheel->tick;
+  int i;
+  for (i = 0; i < TIMER_WHEEL_SIZE; ++i, ++tick) {
+    if (app_timer_wheel->slots[0][tick & TIMER_WHEEL_MASK] != NULL) {
+      break;
+    }
+    if ((tick & TIMER_WHEEL_MASK) == 0) {
+      break;
+    }
+  }
+  // Round up, so timer tasks are not invoked before the tick comes.
+  const uint32_t frequency = SYS_TMR_SystemCountFrequencyGet();
+  return (tick * frequency + 999) / 1000;
+}
+
+void APP_Timer_Setup(AppTimer* timer,
+                     AppTimerCallback callback,
+                     void* user_data) {
+  timer->next = NULL;
+  timer->pprev = NULL;
+  timer->expires = 0;
+  timer->callback = callback;
+  timer->user_data = user_data;
+  timer->is_armed = false;
+  timer->is_expired = false;
+}
+
+void APP_Timer_Start(AppTimerWheel* app_timer_wheel,
+                     AppTimer* timer,
+                     uint32_t timeout_ms) {
+  APP_Timer_Cancel(app_timer_wheel, timer);
+  timer->expires = currentTick() + timeout_ms;
+  timer->is_armed = true;
+  timer->is_expired = false;
+  timerInsert(app_timer_wheel, timer);
+  ++app_timer_wheel->num_armed;
+}
+
+void APP_Timer_Cancel(AppTimerWheel* app_timer_wheel, AppTimer* timer) {
+  if (!timer->is_armed) {
+    return;
+  }
+  listRemove(timer);
+  timer->is_armed = false;
+  --app_timer_wheel->num_armed;
+}
+
+bool APP_Timer_IsArmed(const AppTimer* timer) {
+  return timer->is_armed;
+}
+
+bool APP_Timer_IsExpired(const AppTimer* timer) {
+  return timer->is_expired;
+}
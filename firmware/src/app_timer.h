@@ -0,0 +1,110 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _APP_TIMER_H
+#define _APP_TIMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Software timers of the application.
+//
+// All timers are kept in a hierarchical timer wheel with millisecond
+// resolution, so starting, cancelling and expiring a timer is O(1) no matter
+// how many timers are active.
+//
+// Expiration is delivered from the main loop: timer gets its expired flag
+// set and its callback (if any) is invoked. Modules either check the flag
+// from their tasks routine or use the callback to update their state.
+
+// Every level of the wheel has 2^TIMER_WHEEL_BITS slots.
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+// With 3 levels timeouts of up to 2^18 milliseconds (~4 minutes) are handled
+// directly, longer timeouts are re-scheduled when they reach the last level.
+#define TIMER_WHEEL_NUM_LEVELS 3
+
+typedef void (*AppTimerCallback)(void* user_data);
+
+typedef struct AppTimer {
+  // Links in the wheel slot list. pprev points to the next field of the
+  // previous timer, or to the slot itself for the first timer, so the timer
+  // can be removed without knowing which slot it is in.
+  struct AppTimer* next;
+  struct AppTimer** pprev;
+
+  // Tick at which the timer expires, in milliseconds.
+  uint64_t expires;
+
+  // Invoked from the main loop when timer expires, can be NULL.
+  AppTimerCallback callback;
+  void* user_data;
+
+  bool is_armed;
+  bool is_expired;
+} AppTimer;
+
+typedef struct AppTimerWheel {
+  AppTimer* slots[TIMER_WHEEL_NUM_LEVELS][TIMER_WHEEL_SIZE];
+  // Next tick to be processed.
+  uint64_t tick;
+  // Number of armed timers.
+  size_t num_armed;
+} AppTimerWheel;
+
+// Initialize timer wheel with no timers.
+void APP_Timer_Initialize(AppTimerWheel* app_timer_wheel);
+
+// Expire all timers which are due.
+void APP_Timer_Tasks(AppTimerWheel* app_timer_wheel);
+
+// Get system timer count at which timer tasks are to be invoked next time,
+// UINT64_MAX if there are no armed timers.
+//
+// Might be earlier than the actual expiration of the earliest timer, when
+// the timers are to be moved between levels of the wheel.
+uint64_t APP_Timer_NextExpiry(AppTimerWheel* app_timer_wheel);
+
+// Set up timer, must be called before any other operation on the timer.
+void APP_Timer_Setup(AppTimer* timer,
+                     AppTimerCallback callback,
+                     void* user_data);
+
+// Start timer which expires after the given number of milliseconds.
+//
+// If the timer is already armed, it is re-started.
+void APP_Timer_Start(AppTimerWheel* app_timer_wheel,
+                     AppTimer* timer,
+                     uint32_t timeout_ms);
+
+// Cancel timer, does nothing if the timer is not armed.
+void APP_Timer_Cancel(AppTimerWheel* app_timer_wheel, AppTimer* timer);
+
+// Check whether timer is armed and did not expire yet.
+bool APP_Timer_IsArmed(const AppTimer* timer);
+
+// Check whether timer expired since it was started last time.
+bool APP_Timer_IsExpired(const AppTimer* timer);
+
+#endif  // _APP_TIMER_H
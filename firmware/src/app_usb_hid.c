@@ -30,10 +30,101 @@
 
 AppUSBHIDData* g_app_usb_hid_data;
 
-static uint8_t receiveDataBuffer[64] BUFFER_DMA_READY;
-static uint8_t transmitDataBuffer[64] BUFFER_DMA_READY;
+static uint8_t receiveDataBuffer[APP_USB_HID_REPORT_SIZE] BUFFER_DMA_READY;
+static uint8_t transmitDataBuffer[APP_USB_HID_REPORT_SIZE] BUFFER_DMA_READY;
 
-void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data) {
+////////////////////////////////////////////////////////////////////////////////
+// History export.
+
+static void uint32Encode(uint8_t* data, uint32_t value) {
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t uint32Decode(const uint8_t* data) {
+  return (uint32_t)data[0] |
+         ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) |
+         ((uint32_t)data[3] << 24);
+}
+
+static void historyExportBegin(AppUSBHIDData* app_usb_hid_data) {
+  const uint8_t* request = app_usb_hid_data->receive_data_buffer;
+  if (app_usb_hid_data->is_history_export_active) {
+    SYS_CONSOLE_MESSAGE("APP USB: History export is already running\r\n");
+    return;
+  }
+  // NOTE: Query is started even if history is not loaded yet, it finishes
+  // right away and host gets an empty reply.
+  APP_History_QueryBegin(app_usb_hid_data->app_history_data,
+                         &app_usb_hid_data->history_query,
+                         uint32Decode(request + 1),
+                         uint32Decode(request + 5));
+  app_usb_hid_data->is_history_export_active = true;
+  app_usb_hid_data->num_history_samples = 0;
+}
+
+static void historyExportSend(AppUSBHIDData* app_usb_hid_data) {
+  AppHistoryQuery* query = &app_usb_hid_data->history_query;
+  uint8_t* report = app_usb_hid_data->transmit_data_buffer;
+  uint8_t flags = 0;
+  if (APP_History_QueryIsFinished(query)) {
+    flags |= APP_USB_HID_HISTORY_FLAG_LAST;
+    if (query->is_error) {
+      flags |= APP_USB_HID_HISTORY_FLAG_ERROR;
+    }
+    app_usb_hid_data->is_history_export_active = false;
+  }
+  report[0] = APP_USB_HID_REPORT_HISTORY;
+  report[1] = app_usb_hid_data->num_history_samples;
+  report[2] = flags;
+  app_usb_hid_data->num_history_samples = 0;
+  app_usb_hid_data->is_hid_data_transmitted = false;
+  USB_DEVICE_HID_ReportSend(USB_DEVICE_HID_INDEX_0,
+                            &app_usb_hid_data->tx_transfer_handle,
+                            report,
+                            APP_USB_HID_REPORT_SIZE);
+}
+
+// Fill in transmit buffer with samples, and send it once it is full.
+static void historyExportTasks(AppUSBHIDData* app_usb_hid_data) {
+  AppHistoryQuery* query = &app_usb_hid_data->history_query;
+  AppHistorySample sample;
+  while (app_usb_hid_data->num_history_samples <
+             APP_USB_HID_HISTORY_MAX_SAMPLES &&
+         APP_History_QueryNext(query, &sample)) {
+    uint8_t* data = app_usb_hid_data->transmit_data_buffer +
+                    APP_USB_HID_HISTORY_HEADER_SIZE +
+                    app_usb_hid_data->num_history_samples *
+                        APP_USB_HID_HISTORY_SAMPLE_SIZE;
+    uint32Encode(data, sample.timestamp);
+    uint32Encode(data + 4, (uint32_t)sample.value);
+    ++app_usb_hid_data->num_history_samples;
+  }
+  if (app_usb_hid_data->num_history_samples ==
+          APP_USB_HID_HISTORY_MAX_SAMPLES ||
+      APP_History_QueryIsFinished(query)) {
+    historyExportSend(app_usb_hid_data);
+    return;
+  }
+  // NOTE: If the read could not be queued, it is attempted again on the next
+  // iteration.
+  APP_History_QueryFetch(query);
+}
+
+static bool historyExportIsRunnable(AppUSBHIDData* app_usb_hid_data) {
+  return app_usb_hid_data->is_history_export_active &&
+         app_usb_hid_data->is_hid_data_transmitted &&
+         !APP_History_QueryIsPending(&app_usb_hid_data->history_query);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data,
+                            AppHistoryData* app_history_data) {
   app_usb_hid_data->state = APP_USB_HID_STATE_INIT;
 
   app_usb_hid_data->us_handle = USB_DEVICE_HANDLE_INVALID;
@@ -44,6 +135,9 @@ void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data) {
   app_usb_hid_data->is_hid_data_transmitted = true;
   app_usb_hid_data->receive_data_buffer = &receiveDataBuffer[0];
   app_usb_hid_data->transmit_data_buffer = &transmitDataBuffer[0];
+  app_usb_hid_data->app_history_data = app_history_data;
+  app_usb_hid_data->is_history_export_active = false;
+  app_usb_hid_data->num_history_samples = 0;
 
   g_app_usb_hid_data = app_usb_hid_data;
 }
@@ -78,24 +172,51 @@ void APP_USB_HID_Tasks(AppUSBHIDData* app_usb_hid_data) {
         USB_DEVICE_HID_ReportReceive(USB_DEVICE_HID_INDEX_0,
                                      &app_usb_hid_data->rx_transfer_handle,
                                      app_usb_hid_data->receive_data_buffer,
-                                     64);
+                                     APP_USB_HID_REPORT_SIZE);
       }
       break;
     case APP_USB_HID_STATE_MAIN_TASK:
       if (!app_usb_hid_data->is_device_configured) {
         SYS_CONSOLE_MESSAGE("APP USB: Waiting for configuration\r\n");
+        // Host is gone, so is the export it requested.
+        app_usb_hid_data->is_history_export_active = false;
         app_usb_hid_data->state = APP_USB_HID_STATE_WAIT_FOR_CONFIGURATION;
-      } else if (app_usb_hid_data->is_hid_data_received) {
+        break;
+      }
+      if (app_usb_hid_data->is_hid_data_received) {
         SYS_CONSOLE_MESSAGE("APP USB: Got received data\r\n");
         app_usb_hid_data->is_hid_data_received = false;
+        if (app_usb_hid_data->receive_data_buffer[0] ==
+                APP_USB_HID_REPORT_HISTORY) {
+          historyExportBegin(app_usb_hid_data);
+        }
         // Place a new read request.
         USB_DEVICE_HID_ReportReceive(USB_DEVICE_HID_INDEX_0,
                                      &app_usb_hid_data->rx_transfer_handle,
                                      app_usb_hid_data->receive_data_buffer,
-                                     64);
+                                     APP_USB_HID_REPORT_SIZE);
+      }
+      if (historyExportIsRunnable(app_usb_hid_data)) {
+        historyExportTasks(app_usb_hid_data);
       }
       break;
     case APP_USB_HID_STATE_ERROR:
       break;
   }
 }
+
+bool APP_USB_HID_IsRunnable(AppUSBHIDData* app_usb_hid_data) {
+  switch (app_usb_hid_data->state) {
+    case APP_USB_HID_STATE_INIT:
+      return true;
+    case APP_USB_HID_STATE_WAIT_FOR_CONFIGURATION:
+      return app_usb_hid_data->is_device_configured;
+    case APP_USB_HID_STATE_MAIN_TASK:
+      return !app_usb_hid_data->is_device_configured ||
+             app_usb_hid_data->is_hid_data_received ||
+             historyExportIsRunnable(app_usb_hid_data);
+    case APP_USB_HID_STATE_ERROR:
+      return false;
+  }
+  return true;
+}
@@ -27,6 +27,31 @@
 #include <stdint.h>
 #include <usb/usb_device_hid.h>
 
+#include "app_history.h"
+
+// Size of the reports sent and received over the interrupt endpoints.
+#define APP_USB_HID_REPORT_SIZE 64
+
+// Report which requests export of the history.
+//
+// Byte 0 is APP_USB_HID_REPORT_HISTORY, followed by the first and the last
+// timestamp of the requested range as little-endian 32 bit numbers.
+//
+// Device replies with a stream of reports with the same first byte, followed
+// by the number of samples in the report and flags. Samples follow as pairs
+// of little-endian 32 bit timestamp and signed value.
+#define APP_USB_HID_REPORT_HISTORY 'H'
+// Flag of the last report of the history export.
+#define APP_USB_HID_HISTORY_FLAG_LAST (1 << 0)
+// Flag which is set when history could not be read from the flash.
+#define APP_USB_HID_HISTORY_FLAG_ERROR (1 << 1)
+// Size of the history report header and of a single sample in it.
+#define APP_USB_HID_HISTORY_HEADER_SIZE 3
+#define APP_USB_HID_HISTORY_SAMPLE_SIZE 8
+#define APP_USB_HID_HISTORY_MAX_SAMPLES                     \
+  ((APP_USB_HID_REPORT_SIZE - APP_USB_HID_HISTORY_HEADER_SIZE) / \
+   APP_USB_HID_HISTORY_SAMPLE_SIZE)
+
 typedef enum {
   // USB HID is initializing.
   APP_USB_HID_STATE_INIT,
@@ -57,9 +82,25 @@ typedef struct {
   bool is_hid_data_transmitted;
 
   uint8_t idle_rate;
+
+  // ======== History export ========
+  AppHistoryData* app_history_data;
+  // Query of the history which is being exported.
+  AppHistoryQuery history_query;
+  bool is_history_export_active;
+  // Number of samples put into the transmit buffer, it is sent when it is
+  // full or when query is finished.
+  int num_history_samples;
 } AppUSBHIDData;
 
-void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data);
+void APP_USB_HID_Initialize(AppUSBHIDData* app_usb_hid_data,
+                            AppHistoryData* app_history_data);
 void APP_USB_HID_Tasks(AppUSBHIDData* app_usb_hid_data);
 
+// Check whether there is anything to be handled by the tasks routine.
+//
+// All the USB traffic is handled by the device layer, the flags checked here
+// are set from its event handler.
+bool APP_USB_HID_IsRunnable(AppUSBHIDData* app_usb_hid_data);
+
 #endif  // _APP_USB_HID_H
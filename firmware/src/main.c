@@ -37,8 +37,11 @@ int main(void) {
   system_objects.global_objects = &sysObj;
   APP_Initialize_Real(&app_data, &system_objects);
   while (true) {
+    APP_PROFILER_ITERATION_BEGIN(&app_data.profiler);
     // Maintain state machines of all polled MPLAB Harmony modules.
+    APP_PROFILER_BEGIN(sys_tasks_start);
     SYS_Tasks();
+    APP_PROFILER_END(sys_tasks_start, &app_data.profiler.sys_tasks);
     // Maintain the application's state machine.
     APP_Tasks_Real(&app_data);
   }
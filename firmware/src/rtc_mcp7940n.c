@@ -22,6 +22,8 @@
 
 #include "rtc_mcp7940n.h"
 
+#include <string.h>
+
 #include "system_definitions.h"
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -91,7 +93,7 @@ static inline DRV_I2C_BUFFER_EVENT i2c_transferStatusGet(RTC_MCP7940N* rtc) {
 
 // Check whether we are ready to transmit data to RTC.
 static bool i2c_checkReadyForTransmit(RTC_MCP7940N* rtc) {
-  if (rtc->i2c_buffer_handle == NULL) {
+  if (rtc->i2c_buffer_handle == (RTC_MCP7940N_BufferHandle)NULL) {
     return true;
   }
   const DRV_I2C_BUFFER_EVENT status = i2c_transferStatusGet(rtc);
@@ -105,7 +107,6 @@ static bool i2c_transmit(RTC_MCP7940N* rtc,
                          size_t num_bytes) {
   if (!i2c_checkReadyForTransmit(rtc)) {
     ERROR_MESSAGE("Unable to perform I2C transmittance.\r\n");
-    rtc->state = RTC_MCP7940N_STATE_ERROR;
     return false;
   }
   DEBUG_PRINT("Transmitting %d bytes.\r\n", num_bytes);
@@ -115,12 +116,10 @@ static bool i2c_transmit(RTC_MCP7940N* rtc,
                                             transmit_buffer,
                                             num_bytes,
                                             NULL);
-  if (rtc->i2c_buffer_handle == NULL) {
+  if (rtc->i2c_buffer_handle == (RTC_MCP7940N_BufferHandle)NULL) {
     ERROR_MESSAGE("I2C Transmit returned invalid handle.\r\n");
-    rtc->state = RTC_MCP7940N_STATE_ERROR;
     return false;
   }
-  rtc->state = RTC_MCP7940N_STATE_I2C_STAUS_CHECK;
   return true;
 }
 
@@ -133,7 +132,6 @@ static bool i2c_transmitThenReceive(RTC_MCP7940N* rtc,
                                     size_t num_bytes_receive) {
   if (!i2c_checkReadyForTransmit(rtc)) {
     ERROR_MESSAGE("Unable to perform I2C transmittance.\r\n");
-    rtc->state = RTC_MCP7940N_STATE_ERROR;
     return false;
   }
   DEBUG_PRINT("Transmitting %d bytes, then receiving %d bytes.\r\n",
@@ -145,19 +143,17 @@ static bool i2c_transmitThenReceive(RTC_MCP7940N* rtc,
       transmit_buffer, num_bytes_transmit,
       receive_buffer, num_bytes_receive,
       NULL);
-  if (rtc->i2c_buffer_handle == NULL) {
+  if (rtc->i2c_buffer_handle == (RTC_MCP7940N_BufferHandle)NULL) {
     ERROR_MESSAGE("I2C TransmitThenReceive returned invalid handle.\r\n");
-    rtc->state = RTC_MCP7940N_STATE_ERROR;
     return false;
   }
-  rtc->state = RTC_MCP7940N_STATE_I2C_STAUS_CHECK;
   return true;
 }
 
-// Helper function to receive value of a single register.
+// Helper function to receive value of a number of registers.
 //
 // The buffer is supposed to be 1 byte:
-// - First byte is the address of the register.
+// - First byte is the address of the first register.
 static bool i2c_transmitReadRegister(RTC_MCP7940N* rtc,
                                      uint8_t* transmit_buffer,
                                      uint8_t* receive_buffer,
@@ -169,159 +165,234 @@ static bool i2c_transmitReadRegister(RTC_MCP7940N* rtc,
                                  receive_buffer, num_bytes_receive);
 }
 
-// Helper function to update value of a single register.
-//
-// The buffer is supposed to be 2 bytes:
-// - First byte is the address of the register.
-// - Second byte is the new register value.
-static bool i2c_transmitUpdateSingleRegister(RTC_MCP7940N* rtc,
-                                             uint8_t* transmit_buffer) {
-  DEBUG_PRINT("Updating value of register 0x%02x to value of 0x%02x.\r\n",
-               transmit_buffer[0], transmit_buffer[1]);
-  return i2c_transmit(rtc, transmit_buffer, 2);
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 // Task-related callbacks.
 //
 // Those functions are used as next-task, which are being invoked after initial
 // data transfer is over.
+//
+// They return truth if the operation is finished, and false if they have
+// started another I2C transfer.
 
-// Invoked after oscillator status register is read. Updates the register value
-// based on the task type: will either enable or disable oscillator.
-static void task_oscillator_enableOrDisable(RTC_MCP7940N* rtc) {
-  uint8_t register_value = rtc->_private.oscillator_bits.current_register_value;
-  DEBUG_PRINT("Register value before updating oscillator: 0x%02x.\r\n",
-              register_value);
-  // Update register value based on the next task.
-  if (rtc->next_task == RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_ENABLE) {
-    register_value |= MCP7940N_FLAG_START_OSCILLATOR;
-  } else {
-    SYS_ASSERT(rtc->next_task == RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_DISABLE,
-               "Unexpected value of rtc->next_task");
-    register_value &= ~MCP7940N_FLAG_START_OSCILLATOR;
-  }
-  // Transmit new register value to the RTC.
-  uint8_t* transmit_buffer = rtc->_private.oscillator_bits.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
-  transmit_buffer[1] = register_value;
-  i2c_transmitUpdateSingleRegister(rtc, transmit_buffer);
-  // Clear state machine.
-  rtc->next_task = RTC_MCP7940N_TASK_NONE;
-}
-
-static void task_oscillator_postStatusReceive(RTC_MCP7940N* rtc) {
-  const uint8_t register_value =
-      rtc->_private.oscillator_status.current_register_value;
+static bool task_oscillator_postStatusReceive(RTC_MCP7940N_Operation* op) {
+  const uint8_t register_value = op->_private.status.current_register_value;
   DEBUG_PRINT("Fetched register value: 0x%02x.\r\n", register_value);
   const bool enabled = (register_value & MCP7940N_FLAG_START_OSCILLATOR) != 0;
-  *rtc->_private.oscillator_status.return_status_ptr = enabled;
-  // Clear state machine.
-  rtc->next_task = RTC_MCP7940N_TASK_NONE;
-}
-
-static void task_battery_enableOrDisable(RTC_MCP7940N* rtc) {
-  uint8_t register_value = rtc->_private.battery_bits.current_register_value;
-  DEBUG_PRINT("Register value before updating battery: 0x%02x.\r\n",
-              register_value);
-  // Update register value based on the next task.
-  if (rtc->next_task == RTC_MCP7940N_TASK_BATTERY_UPDATE_ENABLE) {
-    register_value |= MCP7940N_FLAG_BATTERY_ENABLE;
-  } else {
-    SYS_ASSERT(rtc->next_task == RTC_MCP7940N_TASK_BATTERY_UPDATE_DISABLE,
-               "Unexpected value of rtc->next_task");
-    register_value &= ~MCP7940N_FLAG_BATTERY_ENABLE;
-  }
-  // Transmit new register value to the RTC.
-  uint8_t* transmit_buffer = rtc->_private.battery_bits.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_DAY_OF_WEEK;
-  transmit_buffer[1] = register_value;
-  i2c_transmitUpdateSingleRegister(rtc, transmit_buffer);
-  // Clear state machine.
-  rtc->next_task = RTC_MCP7940N_TASK_NONE;
-}
-
-static void task_battery_postStatusReceive(RTC_MCP7940N* rtc) {
-  const uint8_t register_value =
-      rtc->_private.battery_status.current_register_value;
+  *op->_private.status.return_status_ptr = enabled;
+  return true;
+}
+
+static bool task_battery_postStatusReceive(RTC_MCP7940N_Operation* op) {
+  const uint8_t register_value = op->_private.status.current_register_value;
   DEBUG_PRINT("Fetched register value: 0x%02x.\r\n", register_value);
   const bool enabled = (register_value & MCP7940N_FLAG_BATTERY_ENABLE) != 0;
-  *rtc->_private.battery_status.return_status_ptr = enabled;
-  // Clear state machine.
-  rtc->next_task = RTC_MCP7940N_TASK_NONE;
+  *op->_private.status.return_status_ptr = enabled;
+  return true;
 }
 
-static void task_datetime_convertToBCDAndTransmit(RTC_MCP7940N* rtc) {
-  const uint8_t num_registers = sizeof(RTC_MCP7940N_DateTime);
-  const RTC_MCP7940N_DateTime *date_time = &rtc->_private.date_time_write.date_time;
-  uint8_t *reg = rtc->_private.date_time_write.register_storage;
+// Invoked after all batch registers are read. Applies modifications of the
+// batch and transmits modified registers back to the RTC.
+static bool task_batch_updateAndTransmit(RTC_MCP7940N* rtc,
+                                         RTC_MCP7940N_Operation* op,
+                                         bool* success) {
+  const RTC_MCP7940N_Batch* batch = &op->_private.batch_update.batch;
+  uint8_t* reg = op->_private.batch_update.register_storage;
 #ifdef SYS_CMD_REMAP_SYS_DEBUG_MESSAGE
   DEBUG_MESSAGE("Fetched register values before updating:\r\n");
-  debugPrintRegisters(reg + 1, num_registers);
+  debugPrintRegisters(reg + 1, RTC_MCP7940N_BATCH_NUM_REGISTERS);
 #endif
-  reg[0] = MCP7940N_REG_ADDR_SECONDS;
-  reg[1] = (reg[1] & ~0x7f) | convertToBCD(date_time->seconds);
-  reg[2] = (reg[2] & ~0x7f) | convertToBCD(date_time->minutes);
-  reg[3] = (reg[3] & ~0x3f) | convertToBCD(date_time->hours);
-  reg[4] = (reg[4] & ~0x7) | convertToBCD(date_time->day_of_week);
-  reg[5] = (reg[5] & ~0x3f) | convertToBCD(date_time->day);
-  reg[6] = (reg[6] & ~0xf) | convertToBCD(date_time->month);
-  reg[7] = (reg[7] & ~0xff) | convertToBCD(date_time->year);
-  i2c_transmit(rtc, reg, num_registers + 1);
-  // Clear state machine.
-  rtc->next_task = RTC_MCP7940N_TASK_NONE;
-}
-
-static void task_datetime_convertFromBCD(RTC_MCP7940N* rtc) {
-  RTC_MCP7940N_DateTime* date_time = rtc->_private.date_time_read.date_time_ptr;
+  uint8_t first_register = RTC_MCP7940N_BATCH_NUM_REGISTERS;
+  uint8_t last_register = 0;
+  uint8_t i;
+  for (i = 0; i < RTC_MCP7940N_BATCH_NUM_REGISTERS; ++i) {
+    if (batch->mask[i] == 0) {
+      continue;
+    }
+    reg[i + 1] = (reg[i + 1] & ~batch->mask[i]) |
+                 (batch->value[i] & batch->mask[i]);
+    if (first_register == RTC_MCP7940N_BATCH_NUM_REGISTERS) {
+      first_register = i;
+    }
+    last_register = i;
+  }
+  SYS_ASSERT(first_register != RTC_MCP7940N_BATCH_NUM_REGISTERS,
+             "Empty batches are not to be read");
+  // Register preceding the first modified one is not written, so its slot
+  // is used for the address.
+  reg[first_register] = first_register;
+  op->next_task = RTC_MCP7940N_TASK_NONE;
+  if (!i2c_transmit(rtc,
+                    &reg[first_register],
+                    last_register - first_register + 2)) {
+    *success = false;
+    return true;
+  }
+  return false;
+}
+
+static bool task_datetime_convertFromBCD(RTC_MCP7940N_Operation* op) {
+  RTC_MCP7940N_DateTime* date_time = op->_private.date_time_read.date_time_ptr;
   date_time->seconds = convertFromBCD(date_time->seconds & 0x7f);
   date_time->minutes = convertFromBCD(date_time->minutes & 0x7f);
   date_time->hours = convertFromBCD(date_time->hours & 0x3f);
   date_time->day_of_week = convertFromBCD(date_time->day_of_week & 0x7);
   date_time->day = convertFromBCD(date_time->day & 0x3f);
-  date_time->month = convertFromBCD(date_time->month & 0xf);
+  date_time->month = convertFromBCD(date_time->month & 0x1f);
   date_time->year = convertFromBCD(date_time->year & 0xff);
-  // Clear state machine.
-  rtc->state = RTC_MCP7940N_STATE_NONE;
-  rtc->next_task = RTC_MCP7940N_TASK_NONE;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Operations queue.
+
+static RTC_MCP7940N_Operation* queue_head(RTC_MCP7940N* rtc) {
+  SYS_ASSERT(rtc->queue_length != 0, "Queue is empty");
+  return &rtc->queue[rtc->queue_head];
+}
+
+// Get storage for a new operation, or NULL if the queue is full.
+//
+// Operation is not considered queued until queue_submit() is called.
+static RTC_MCP7940N_Operation* queue_allocate(
+    RTC_MCP7940N* rtc,
+    RTC_MCP7940N_OperationType type,
+    RTC_MCP7940N_CompletionCallback callback,
+    void* user_data) {
+  if (rtc->queue_length == RTC_MCP7940N_QUEUE_SIZE) {
+    ERROR_MESSAGE("Operation queue is full.\r\n");
+    return NULL;
+  }
+  RTC_MCP7940N_Operation* op =
+      &rtc->queue[(rtc->queue_head + rtc->queue_length) %
+                  RTC_MCP7940N_QUEUE_SIZE];
+  op->type = type;
+  op->next_task = RTC_MCP7940N_TASK_NONE;
+  op->callback = callback;
+  op->callback_user_data = user_data;
+  return op;
+}
+
+// Start first I2C transfer of the operation.
+//
+// Returns false if the transfer failed to start.
+static bool operation_start(RTC_MCP7940N* rtc, RTC_MCP7940N_Operation* op) {
+  switch (op->type) {
+    case RTC_MCP7940N_OPERATION_READ_DATE_TIME:
+      op->next_task = RTC_MCP7940N_TASK_DATE_TIME_CONVERT_BCD;
+      return i2c_transmitReadRegister(
+          rtc,
+          op->_private.date_time_read.transmit_buffer,
+          (uint8_t*)op->_private.date_time_read.date_time_ptr,
+          sizeof(RTC_MCP7940N_DateTime));
+    case RTC_MCP7940N_OPERATION_READ_REGISTERS:
+      return i2c_transmitReadRegister(
+          rtc,
+          op->_private.register_read.transmit_buffer,
+          op->_private.register_read.register_storage,
+          op->_private.register_read.num_registers);
+    case RTC_MCP7940N_OPERATION_WRITE_REGISTERS:
+      return i2c_transmit(rtc,
+                          op->_private.register_write.transmit_buffer,
+                          op->_private.register_write.num_registers + 1);
+    case RTC_MCP7940N_OPERATION_WRITE_BATCH:
+      op->next_task = RTC_MCP7940N_TASK_BATCH_UPDATE_AND_TRANSMIT;
+      return i2c_transmitReadRegister(
+          rtc,
+          op->_private.batch_update.transmit_buffer,
+          op->_private.batch_update.register_storage + 1,
+          RTC_MCP7940N_BATCH_NUM_REGISTERS);
+    case RTC_MCP7940N_OPERATION_OSCILLATOR_STATUS:
+    case RTC_MCP7940N_OPERATION_BATTERY_STATUS:
+      op->next_task = (op->type == RTC_MCP7940N_OPERATION_OSCILLATOR_STATUS)
+                          ? RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_STATUS
+                          : RTC_MCP7940N_TASK_BATTERY_UPDATE_STATUS;
+      return i2c_transmitReadRegister(
+          rtc,
+          op->_private.status.transmit_buffer,
+          &op->_private.status.current_register_value, 1);
+  }
+  return false;
+}
+
+// Invoke next task of the operation after I2C transfer is complete.
+//
+// Returns truth if the operation is finished, success tells whether it
+// succeeded.
+static bool operation_continue(RTC_MCP7940N* rtc,
+                               RTC_MCP7940N_Operation* op,
+                               bool* success) {
+  *success = true;
+  switch (op->next_task) {
+    case RTC_MCP7940N_TASK_NONE:
+      return true;
+    case RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_STATUS:
+      return task_oscillator_postStatusReceive(op);
+    case RTC_MCP7940N_TASK_BATTERY_UPDATE_STATUS:
+      return task_battery_postStatusReceive(op);
+    case RTC_MCP7940N_TASK_DATE_TIME_CONVERT_BCD:
+      return task_datetime_convertFromBCD(op);
+    case RTC_MCP7940N_TASK_BATCH_UPDATE_AND_TRANSMIT:
+      return task_batch_updateAndTransmit(rtc, op, success);
+  }
+  return true;
+}
+
+// Remove finished operation from the queue and start the following ones
+// until one of them waits for an I2C transfer.
+//
+// NOTE: State is kept at I2C_STAUS_CHECK while callbacks are invoked, so
+// operations queued from them are only appended to the queue.
+static void queue_finishHead(RTC_MCP7940N* rtc, bool success) {
+  for (;;) {
+    RTC_MCP7940N_Operation* op = queue_head(rtc);
+    RTC_MCP7940N_CompletionCallback callback = op->callback;
+    void* user_data = op->callback_user_data;
+    rtc->queue_head = (rtc->queue_head + 1) % RTC_MCP7940N_QUEUE_SIZE;
+    --rtc->queue_length;
+    if (callback != NULL) {
+      callback(rtc, success, user_data);
+    }
+    if (rtc->queue_length == 0) {
+      rtc->state = success ? RTC_MCP7940N_STATE_NONE
+                           : RTC_MCP7940N_STATE_ERROR;
+      return;
+    }
+    if (operation_start(rtc, queue_head(rtc))) {
+      return;
+    }
+    ERROR_MESSAGE("Failed to start queued operation.\r\n");
+    success = false;
+  }
+}
+
+// Make allocated operation queued, start it if nothing else is queued.
+static bool queue_submit(RTC_MCP7940N* rtc) {
+  ++rtc->queue_length;
+  if (rtc->state == RTC_MCP7940N_STATE_I2C_STAUS_CHECK) {
+    // Will be started once previous operations are finished.
+    return true;
+  }
+  rtc->state = RTC_MCP7940N_STATE_I2C_STAUS_CHECK;
+  if (!operation_start(rtc, queue_head(rtc))) {
+    queue_finishHead(rtc, false);
+  }
+  return true;
 }
 
 // Check status of I2C bus and invoke next tasks when needed.
 static void i2c_taskCheckStatus(RTC_MCP7940N* rtc) {
   const DRV_I2C_BUFFER_EVENT status = i2c_transferStatusGet(rtc);
+  bool success;
   switch (status) {
     case DRV_I2C_BUFFER_EVENT_COMPLETE:
       DEBUG_MESSAGE("I2C transaction finished.\r\n");
-      switch (rtc->next_task) {
-        case RTC_MCP7940N_TASK_NONE:
-          rtc->state = RTC_MCP7940N_STATE_NONE;
-          break;
-        case RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_ENABLE:
-        case RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_DISABLE:
-          task_oscillator_enableOrDisable(rtc);
-          break;
-        case RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_STATUS:
-          task_oscillator_postStatusReceive(rtc);
-          break;
-        case RTC_MCP7940N_TASK_BATTERY_UPDATE_ENABLE:
-        case RTC_MCP7940N_TASK_BATTERY_UPDATE_DISABLE:
-          task_battery_enableOrDisable(rtc);
-          break;
-        case RTC_MCP7940N_TASK_BATTERY_UPDATE_STATUS:
-          rtc->next_task = RTC_MCP7940N_TASK_NONE;
-          task_battery_postStatusReceive(rtc);
-          break;
-        case RTC_MCP7940N_TASK_DATE_TIME_CONVERT_BCD:
-          task_datetime_convertFromBCD(rtc);
-          break;
-        case RTC_MCP7940N_TASK_DATE_TIME_UPDATE_AND_TRANSMIT:
-          task_datetime_convertToBCDAndTransmit(rtc);
-          break;
+      if (operation_continue(rtc, queue_head(rtc), &success)) {
+        queue_finishHead(rtc, success);
       }
       break;
     case DRV_I2C_BUFFER_EVENT_ERROR:
       ERROR_MESSAGE("Error detected during I2C transaction.\r\n");
-      rtc->state = RTC_MCP7940N_STATE_ERROR;
+      queue_finishHead(rtc, false);
       break;
     default:
       // Nothing to do.
@@ -343,8 +414,9 @@ bool RTC_MCP7940N_Initialize(RTC_MCP7940N* rtc,
     return false;
   }
   rtc->state = RTC_MCP7940N_STATE_NONE;
-  rtc->next_task = RTC_MCP7940N_TASK_NONE;
-  rtc->i2c_buffer_handle = NULL;
+  rtc->i2c_buffer_handle = (RTC_MCP7940N_BufferHandle)NULL;
+  rtc->queue_head = 0;
+  rtc->queue_length = 0;
   DEBUG_MESSAGE("New RTC handle is initialized.\r\n");
   return true;
 }
@@ -368,139 +440,306 @@ bool RTC_MCP7940N_IsBusy(RTC_MCP7940N* rtc) {
            rtc->state == RTC_MCP7940N_STATE_ERROR);
 }
 
-void RTC_MCP7940N_WriteDateAndTime(RTC_MCP7940N* rtc,
-                                   const RTC_MCP7940N_DateTime* date_time) {
+bool RTC_MCP7940N_IsQueueFull(RTC_MCP7940N* rtc) {
+  return rtc->queue_length == RTC_MCP7940N_QUEUE_SIZE;
+}
+
+bool RTC_MCP7940N_WriteDateAndTime(RTC_MCP7940N* rtc,
+                                   const RTC_MCP7940N_DateTime* date_time,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data) {
   DEBUG_MESSAGE("Begin transmitting date and time to RTC.\r\n");
-  // We should preserve non-date-time bits intact, so we first read old state
-  // and then write an updated one.
-  rtc->next_task = RTC_MCP7940N_TASK_DATE_TIME_UPDATE_AND_TRANSMIT;
-  // Make a copy of date time to be sent to RTC.
-  memcpy(&rtc->_private.date_time_write.date_time,
-         date_time,
-         sizeof(rtc->_private.date_time_write.date_time));
-  RTC_MCP7940N_ReadNumRegisters(
-      rtc,
-      rtc->_private.date_time_write.register_storage + 1,
-      sizeof(rtc->_private.date_time_write.date_time));
-}
-
-void RTC_MCP7940N_ReadDateAndTime(RTC_MCP7940N* rtc,
-                                  RTC_MCP7940N_DateTime* date_time) {
+  RTC_MCP7940N_Batch batch;
+  RTC_MCP7940N_BatchInitialize(&batch);
+  RTC_MCP7940N_BatchSetDateAndTime(&batch, date_time);
+  return RTC_MCP7940N_WriteBatch(rtc, &batch, callback, user_data);
+}
+
+bool RTC_MCP7940N_ReadDateAndTime(RTC_MCP7940N* rtc,
+                                  RTC_MCP7940N_DateTime* date_time,
+                                  RTC_MCP7940N_CompletionCallback callback,
+                                  void* user_data) {
   DEBUG_PRINT("Begin sequence to read current date and time\r\n");
-  // Prepare transmittance buffer.
-  uint8_t* transmit_buffer = rtc->_private.date_time_read.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
-  // Schedule receive.
-  rtc->next_task = RTC_MCP7940N_TASK_DATE_TIME_CONVERT_BCD;
-  rtc->_private.date_time_read.date_time_ptr = date_time;
-  i2c_transmitReadRegister(rtc,
-                           transmit_buffer,
-                           (uint8_t*)date_time, sizeof(*date_time));
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_READ_DATE_TIME, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->_private.date_time_read.transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
+  op->_private.date_time_read.date_time_ptr = date_time;
+  return queue_submit(rtc);
 }
 
-void RTC_MCP7940N_ReadRegister(RTC_MCP7940N* rtc,
+bool RTC_MCP7940N_ReadRegister(RTC_MCP7940N* rtc,
                                uint8_t register_address,
-                               uint8_t* register_value) {
+                               uint8_t* register_value,
+                               RTC_MCP7940N_CompletionCallback callback,
+                               void* user_data) {
   DEBUG_PRINT("Begin receiving register 0x%02x from RTC.\r\n", register_address);
-  // Prepare transmittance buffer.
-  uint8_t* transmit_buffer = rtc->_private.register_read.transmit_buffer;
-  transmit_buffer[0] = register_address;
-  // Schedule receive.
-  i2c_transmitReadRegister(rtc, transmit_buffer, register_value, 1);
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_READ_REGISTERS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->_private.register_read.transmit_buffer[0] = register_address;
+  op->_private.register_read.register_storage = register_value;
+  op->_private.register_read.num_registers = 1;
+  return queue_submit(rtc);
 }
 
-void RTC_MCP7940N_WriteRegister(RTC_MCP7940N* rtc,
+bool RTC_MCP7940N_WriteRegister(RTC_MCP7940N* rtc,
                                 uint8_t register_address,
-                                uint8_t register_value) {
+                                uint8_t register_value,
+                                RTC_MCP7940N_CompletionCallback callback,
+                                void* user_data) {
   DEBUG_PRINT("Begin writing register 0x%02x to RTC with value 0x%02x.\r\n", 
               register_address, register_value);
-  // Prepare transmittance buffer.
-  uint8_t* transmit_buffer = rtc->_private.register_write.transmit_buffer;
-  transmit_buffer[0] = register_address;
-  transmit_buffer[1] = register_value;
-  // Schedule transmit.
-  i2c_transmitUpdateSingleRegister(rtc, transmit_buffer);
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_WRITE_REGISTERS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->_private.register_write.transmit_buffer[0] = register_address;
+  op->_private.register_write.transmit_buffer[1] = register_value;
+  op->_private.register_write.num_registers = 1;
+  return queue_submit(rtc);
 }
 
-void RTC_MCP7940N_ReadNumRegisters(RTC_MCP7940N* rtc,
+bool RTC_MCP7940N_ReadNumRegisters(RTC_MCP7940N* rtc,
                                    uint8_t* register_storage,
-                                   uint8_t num_registers) {
+                                   uint8_t num_registers,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data) {
   SYS_ASSERT(num_registers <= RTC_MCP7940N_NUM_REGISTERS,
              "Attempt to read too many registers");
   DEBUG_PRINT("Begin reading %d registers.\r\n", num_registers);
-  uint8_t* transmit_buffer = rtc->_private.register_num_read.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
-  // Schedule receive.
-  i2c_transmitReadRegister(rtc,
-                           transmit_buffer,
-                           register_storage, num_registers);
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_READ_REGISTERS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->_private.register_read.transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
+  op->_private.register_read.register_storage = register_storage;
+  op->_private.register_read.num_registers = num_registers;
+  return queue_submit(rtc);
 }
 
-void RTC_MCP7940N_WriteNumRegisters(RTC_MCP7940N* rtc,
+bool RTC_MCP7940N_WriteNumRegisters(RTC_MCP7940N* rtc,
                                     const uint8_t* register_storage,
-                                    uint8_t num_registers) {
+                                    uint8_t num_registers,
+                                    RTC_MCP7940N_CompletionCallback callback,
+                                    void* user_data) {
   SYS_ASSERT(num_registers <= RTC_MCP7940N_NUM_REGISTERS,
-             "Attempt to read too many registers");
+             "Attempt to write too many registers");
   DEBUG_PRINT("Begin writing %d registers.\r\n", num_registers);
-  uint8_t* transmit_buffer = rtc->_private.register_num_write.transmit_buffer;
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_WRITE_REGISTERS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  uint8_t* transmit_buffer = op->_private.register_write.transmit_buffer;
   transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
   memcpy(&transmit_buffer[1], register_storage, num_registers);
-  i2c_transmit(rtc, transmit_buffer, (num_registers + 1));
+  op->_private.register_write.num_registers = num_registers;
+  return queue_submit(rtc);
+}
+
+bool RTC_MCP7940N_ReadSRAM(RTC_MCP7940N* rtc,
+                           uint8_t offset,
+                           uint8_t* data,
+                           uint8_t num_bytes,
+                           RTC_MCP7940N_CompletionCallback callback,
+                           void* user_data) {
+  SYS_ASSERT(offset + num_bytes <= MCP7940N_SRAM_SIZE,
+             "Attempt to read past the end of SRAM");
+  DEBUG_PRINT("Begin reading %d bytes of SRAM at offset %d.\r\n",
+              num_bytes, offset);
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_READ_REGISTERS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->_private.register_read.transmit_buffer[0] = MCP7940N_SRAM_ADDR + offset;
+  op->_private.register_read.register_storage = data;
+  op->_private.register_read.num_registers = num_bytes;
+  return queue_submit(rtc);
 }
 
-void RTC_MCP7940N_EnableOscillator(RTC_MCP7940N* rtc, bool enable) {
+bool RTC_MCP7940N_WriteSRAM(RTC_MCP7940N* rtc,
+                            uint8_t offset,
+                            const uint8_t* data,
+                            uint8_t num_bytes,
+                            RTC_MCP7940N_CompletionCallback callback,
+                            void* user_data) {
+  SYS_ASSERT(offset + num_bytes <= MCP7940N_SRAM_SIZE,
+             "Attempt to write past the end of SRAM");
+  DEBUG_PRINT("Begin writing %d bytes of SRAM at offset %d.\r\n",
+              num_bytes, offset);
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_WRITE_REGISTERS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  uint8_t* transmit_buffer = op->_private.register_write.transmit_buffer;
+  transmit_buffer[0] = MCP7940N_SRAM_ADDR + offset;
+  memcpy(&transmit_buffer[1], data, num_bytes);
+  op->_private.register_write.num_registers = num_bytes;
+  return queue_submit(rtc);
+}
+
+bool RTC_MCP7940N_EnableOscillator(RTC_MCP7940N* rtc,
+                                   bool enable,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data) {
   DEBUG_PRINT("Begin sequence to set oscillator status to %s.\r\n",
               enable ? "ENABLED" : "DISABLED");
-  // Prepare transmittance buffer.
-  uint8_t* transmit_buffer = rtc->_private.oscillator_bits.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
-  rtc->next_task = enable ? RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_ENABLE
-                          : RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_DISABLE;
-  // Schedule receive.
-  i2c_transmitReadRegister(
-      rtc,
-      transmit_buffer,
-      &rtc->_private.oscillator_bits.current_register_value, 1);
+  RTC_MCP7940N_Batch batch;
+  RTC_MCP7940N_BatchInitialize(&batch);
+  RTC_MCP7940N_BatchEnableOscillator(&batch, enable);
+  return RTC_MCP7940N_WriteBatch(rtc, &batch, callback, user_data);
 }
 
-void RTC_MCP7940N_OscillatorStatus(RTC_MCP7940N* rtc, bool* enabled) {
+bool RTC_MCP7940N_OscillatorStatus(RTC_MCP7940N* rtc,
+                                   bool* enabled,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data) {
   DEBUG_MESSAGE("Begin sequence to check whether oscillator is enabled.\r\n");
-  uint8_t* transmit_buffer = rtc->_private.oscillator_status.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
-  rtc->next_task = RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_STATUS;
-  rtc->_private.oscillator_status.return_status_ptr = enabled;
-  // Schedule receive.
-  i2c_transmitReadRegister(
-      rtc,
-      transmit_buffer,
-      &rtc->_private.oscillator_status.current_register_value, 1);
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_OSCILLATOR_STATUS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->_private.status.transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
+  op->_private.status.return_status_ptr = enabled;
+  return queue_submit(rtc);
 }
 
-void RTC_MCP7940N_EnableBatteryBackup(RTC_MCP7940N* rtc, bool enable) {
+bool RTC_MCP7940N_EnableBatteryBackup(RTC_MCP7940N* rtc,
+                                      bool enable,
+                                      RTC_MCP7940N_CompletionCallback callback,
+                                      void* user_data) {
   DEBUG_PRINT("Begin sequence to set battery backup to %s.\r\n",
               enable ? "ENABLED" : "DISABLED");
-  // Prepare transmittance buffer.
-  uint8_t* transmit_buffer = rtc->_private.battery_bits.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_DAY_OF_WEEK;
-  rtc->next_task = enable ? RTC_MCP7940N_TASK_BATTERY_UPDATE_ENABLE
-                          : RTC_MCP7940N_TASK_BATTERY_UPDATE_DISABLE;
-  // Schedule receive.
-  i2c_transmitReadRegister(
-      rtc,
-      transmit_buffer,
-      &rtc->_private.battery_bits.current_register_value, 1);
-}
-
-void RTC_MCP7940N_BatteryBackupStatus(RTC_MCP7940N* rtc, bool* enabled) {
+  RTC_MCP7940N_Batch batch;
+  RTC_MCP7940N_BatchInitialize(&batch);
+  RTC_MCP7940N_BatchEnableBatteryBackup(&batch, enable);
+  return RTC_MCP7940N_WriteBatch(rtc, &batch, callback, user_data);
+}
+
+bool RTC_MCP7940N_BatteryBackupStatus(RTC_MCP7940N* rtc,
+                                      bool* enabled,
+                                      RTC_MCP7940N_CompletionCallback callback,
+                                      void* user_data) {
   DEBUG_MESSAGE("Begin sequence to check whether battery backup "
                 "is enabled.\r\n");
-  uint8_t* transmit_buffer = rtc->_private.battery_status.transmit_buffer;
-  transmit_buffer[0] = MCP7940N_REG_ADDR_DAY_OF_WEEK;
-  rtc->next_task = RTC_MCP7940N_TASK_BATTERY_UPDATE_STATUS;
-  rtc->_private.battery_status.return_status_ptr = enabled;
-  // Schedule receive.
-  i2c_transmitReadRegister(
-      rtc,
-      transmit_buffer,
-      &rtc->_private.battery_status.current_register_value, 1);
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_BATTERY_STATUS, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  op->_private.status.transmit_buffer[0] = MCP7940N_REG_ADDR_DAY_OF_WEEK;
+  op->_private.status.return_status_ptr = enabled;
+  return queue_submit(rtc);
+}
+
+uint8_t RTC_MCP7940N_CalibrationFromPPB(int32_t correction_ppb) {
+  const bool is_positive = (correction_ppb >= 0);
+  const uint32_t magnitude_ppb = is_positive ? correction_ppb
+                                             : -correction_ppb;
+  uint32_t trim = (magnitude_ppb + RTC_MCP7940N_CALIBRATION_STEP_PPB / 2) /
+                  RTC_MCP7940N_CALIBRATION_STEP_PPB;
+  if (trim > MCP7940N_MASK_CALIB_TRIM) {
+    trim = MCP7940N_MASK_CALIB_TRIM;
+  }
+  if (trim == 0) {
+    return 0;
+  }
+  return (is_positive ? MCP7940N_FLAG_CALIB_SIGN : 0) | trim;
+}
+
+int32_t RTC_MCP7940N_CalibrationToPPB(uint8_t calibration) {
+  const int32_t correction_ppb =
+      (int32_t)(calibration & MCP7940N_MASK_CALIB_TRIM) *
+      RTC_MCP7940N_CALIBRATION_STEP_PPB;
+  return (calibration & MCP7940N_FLAG_CALIB_SIGN) ? correction_ppb
+                                                  : -correction_ppb;
+}
+
+void RTC_MCP7940N_BatchInitialize(RTC_MCP7940N_Batch* batch) {
+  memset(batch, 0, sizeof(*batch));
+}
+
+void RTC_MCP7940N_BatchSetBits(RTC_MCP7940N_Batch* batch,
+                               uint8_t register_address,
+                               uint8_t mask,
+                               uint8_t value) {
+  SYS_ASSERT(register_address < RTC_MCP7940N_BATCH_NUM_REGISTERS,
+             "Register is not covered by batch");
+  batch->mask[register_address] |= mask;
+  batch->value[register_address] =
+      (batch->value[register_address] & ~mask) | (value & mask);
+}
+
+void RTC_MCP7940N_BatchSetDateAndTime(RTC_MCP7940N_Batch* batch,
+                                      const RTC_MCP7940N_DateTime* date_time) {
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_SECONDS,
+                            0x7f, convertToBCD(date_time->seconds));
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_MINUNTES,
+                            0x7f, convertToBCD(date_time->minutes));
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_HOURS,
+                            0x3f, convertToBCD(date_time->hours));
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_DAY_OF_WEEK,
+                            0x07, convertToBCD(date_time->day_of_week));
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_DATE,
+                            0x3f, convertToBCD(date_time->day));
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_MONTH,
+                            0x1f, convertToBCD(date_time->month));
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_YEAR,
+                            0xff, convertToBCD(date_time->year));
+}
+
+void RTC_MCP7940N_BatchEnableOscillator(RTC_MCP7940N_Batch* batch,
+                                        bool enable) {
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_SECONDS,
+                            MCP7940N_FLAG_START_OSCILLATOR,
+                            enable ? MCP7940N_FLAG_START_OSCILLATOR : 0);
+}
+
+void RTC_MCP7940N_BatchEnableBatteryBackup(RTC_MCP7940N_Batch* batch,
+                                           bool enable) {
+  RTC_MCP7940N_BatchSetBits(batch, MCP7940N_REG_ADDR_DAY_OF_WEEK,
+                            MCP7940N_FLAG_BATTERY_ENABLE,
+                            enable ? MCP7940N_FLAG_BATTERY_ENABLE : 0);
+}
+
+bool RTC_MCP7940N_WriteBatch(RTC_MCP7940N* rtc,
+                             const RTC_MCP7940N_Batch* batch,
+                             RTC_MCP7940N_CompletionCallback callback,
+                             void* user_data) {
+  DEBUG_MESSAGE("Begin batched update of registers.\r\n");
+  uint8_t i;
+  for (i = 0; i < RTC_MCP7940N_BATCH_NUM_REGISTERS; ++i) {
+    if (batch->mask[i] != 0) {
+      break;
+    }
+  }
+  if (i == RTC_MCP7940N_BATCH_NUM_REGISTERS) {
+    DEBUG_MESSAGE("Batch is empty, nothing to do.\r\n");
+    if (callback != NULL) {
+      callback(rtc, true, user_data);
+    }
+    return true;
+  }
+  RTC_MCP7940N_Operation* op = queue_allocate(
+      rtc, RTC_MCP7940N_OPERATION_WRITE_BATCH, callback, user_data);
+  if (op == NULL) {
+    return false;
+  }
+  // Make a copy of the batch, so caller does not need to keep it.
+  memcpy(&op->_private.batch_update.batch,
+         batch,
+         sizeof(op->_private.batch_update.batch));
+  // Read all batch registers, modifications are applied once they arrive.
+  op->_private.batch_update.transmit_buffer[0] = MCP7940N_REG_ADDR_SECONDS;
+  return queue_submit(rtc);
 }
@@ -52,6 +52,10 @@ extern "C" {
 #define MCP7940N_REG_ADDR_CALIB        0x08
 #define MCP7940N_REG_ADDR_UNLOCK_ID    0x09
 
+// Battery-backed general purpose SRAM.
+#define MCP7940N_SRAM_ADDR             0x20
+#define MCP7940N_SRAM_SIZE             64
+
 /////////////////////////////////////////////////////////////////////////////////
 // Various flags.
 
@@ -90,6 +94,13 @@ extern "C" {
 #define MCP7940N_FLAG_MFP_04KHZ    0x01  /*  MFP is running at 4 KHz */
 #define MCP7940N_FLAG_MFP_8KHZ     0x02  /*  MFP is running at 8 KHz */
 #define MCP7940N_FLAG_MFP_32KHZ    0x03  /*  MFP is running at 32 KHz */
+#define MCP7940N_MASK_MFP_RATE     0x07  /*  Mask of the square wave rate */
+
+////////////////////////////////////////////////
+// Flags for MCP7940N_REG_ADDR_CALIB register.
+
+#define MCP7940N_FLAG_CALIB_SIGN   0x80  /* Add clocks, for slow oscillator */
+#define MCP7940N_MASK_CALIB_TRIM   0x7f  /* Mask of the trim value */
 
 ////////////////////////////////////
 // Flags for alarm control register.
@@ -114,6 +125,24 @@ extern "C" {
 // Total number of addressable registers.
 #define RTC_MCP7940N_NUM_REGISTERS 31
 
+// Maximum number of bytes which can be written by a single operation: the
+// whole SRAM can be written at once.
+#define RTC_MCP7940N_MAX_WRITE_SIZE MCP7940N_SRAM_SIZE
+
+// Number of registers covered by the batched update: time keeping, control
+// and calibration registers.
+#define RTC_MCP7940N_BATCH_NUM_REGISTERS (MCP7940N_REG_ADDR_CALIB + 1)
+
+// Frequency correction of a single step of the calibration register, in parts
+// per billion: every step adds or removes 2 clock cycles of 32768 Hz crystal
+// once per minute.
+#define RTC_MCP7940N_CALIBRATION_STEP_PPB 1017
+
+// Maximum number of operations which can be queued at a time.
+#ifndef RTC_MCP7940N_QUEUE_SIZE
+#  define RTC_MCP7940N_QUEUE_SIZE 4
+#endif
+
 ///////////////////////////
 // Descriptor of RTC itself.
 
@@ -123,22 +152,27 @@ typedef uintptr_t RTC_MCP7940N_BufferHandle;
 typedef enum RTC_MCP7940N_State {
   // No tasks needs to be performed.
   RTC_MCP7940N_STATE_NONE = 0,
-  // RTC encountered an error.
+  // Last operation failed, no tasks needs to be performed.
   RTC_MCP7940N_STATE_ERROR,
   // Check status after I2C communication was requested.
   RTC_MCP7940N_STATE_I2C_STAUS_CHECK,
 } RTC_MCP7940N_State;
 
+typedef enum RTC_MCP7940N_OperationType {
+  RTC_MCP7940N_OPERATION_READ_DATE_TIME,
+  RTC_MCP7940N_OPERATION_READ_REGISTERS,
+  RTC_MCP7940N_OPERATION_WRITE_REGISTERS,
+  RTC_MCP7940N_OPERATION_WRITE_BATCH,
+  RTC_MCP7940N_OPERATION_OSCILLATOR_STATUS,
+  RTC_MCP7940N_OPERATION_BATTERY_STATUS,
+} RTC_MCP7940N_OperationType;
+
 typedef enum RTC_MCP7940N_NextTask {
   RTC_MCP7940N_TASK_NONE = 0,
-  RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_ENABLE,
-  RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_DISABLE,
   RTC_MCP7940N_TASK_OSCILLATOR_UPDATE_STATUS,
-  RTC_MCP7940N_TASK_BATTERY_UPDATE_ENABLE,
-  RTC_MCP7940N_TASK_BATTERY_UPDATE_DISABLE,
   RTC_MCP7940N_TASK_BATTERY_UPDATE_STATUS,
   RTC_MCP7940N_TASK_DATE_TIME_CONVERT_BCD,
-  RTC_MCP7940N_TASK_DATE_TIME_UPDATE_AND_TRANSMIT,
+  RTC_MCP7940N_TASK_BATCH_UPDATE_AND_TRANSMIT,
 } RTC_MCP7940N_NextTask;
 
 typedef struct RTC_MCP7940N_DateTime {
@@ -151,16 +185,38 @@ typedef struct RTC_MCP7940N_DateTime {
   uint8_t year;
 } RTC_MCP7940N_DateTime;
 
-typedef struct RTC_MCP7940N {
-  // Current state of state machine.
-  RTC_MCP7940N_State state;
+// Set of masked modifications of the registers, which are applied with a
+// single burst read of all batch registers followed by a single burst write.
+//
+// Only registers between the first and the last modified ones are written
+// back, so time keeping registers are not touched by a batch which only
+// modifies control bits.
+typedef struct RTC_MCP7940N_Batch {
+  // Bits of the register which are modified by the batch.
+  uint8_t mask[RTC_MCP7940N_BATCH_NUM_REGISTERS];
+  // New values of the modified bits.
+  uint8_t value[RTC_MCP7940N_BATCH_NUM_REGISTERS];
+} RTC_MCP7940N_Batch;
+
+struct RTC_MCP7940N;
+
+// Callback which is invoked once queued operation is finished.
+//
+// Output of the operation is available at this point. It is allowed to queue
+// new operations from the callback.
+typedef void (*RTC_MCP7940N_CompletionCallback)(struct RTC_MCP7940N* rtc,
+                                                bool success,
+                                                void* user_data);
+
+// Single queued operation, together with all the buffers it needs.
+typedef struct RTC_MCP7940N_Operation {
+  RTC_MCP7940N_OperationType type;
 
-  // Next task to be performed instead of going to a free state.
+  // Next task to be performed after current I2C transfer is over.
   RTC_MCP7940N_NextTask next_task;
 
-  // I2C bus related handles.
-  RTC_MCP7940N_DriverHandle i2c_handle;
-  RTC_MCP7940N_BufferHandle i2c_buffer_handle;
+  RTC_MCP7940N_CompletionCallback callback;
+  void* callback_user_data;
 
   union {
     ////////////////////////////////////////////////////////////////////////////
@@ -177,53 +233,27 @@ typedef struct RTC_MCP7940N {
       uint8_t transmit_buffer[1];
     } date_time_read;
 
-    // Storage related on date-time writing from RTC routines.
+    ////////////////////////////////////////////////////////////////////////////
+    // Batched update of registers.
+
+    // Storage related on batched read-modify-write of registers.
     struct {
-      // Previous state of all registers which are going to be overwritten.
+      // Previous state of all registers which are covered by the batch.
       //
       // NOTE: We do the following trick here: we read previous registers value
       // starting st address of 1. This way we can prepend register address for
       // transmittance and re-use the buffer more easily.
-      uint8_t register_storage[sizeof(RTC_MCP7940N_DateTime) + 1];
-      // Date and time to be written to the RTC.
-      RTC_MCP7940N_DateTime date_time;
-    } date_time_write;
-
-    ////////////////////////////////////////////////////////////////////////////
-    // Oscillator.
-
-    // Storage related on oscillator enable/disable.
-    struct {
-      // Current value of register coming from RTC.
-      uint8_t current_register_value;
-      // Buffer is used for both receiving current register value and sending
-      // the new one.
-      uint8_t transmit_buffer[2];
-    } oscillator_bits;
-
-    // Storage related on oscillator status fetch.
-    struct {
-      // Current value of register coming from RTC.
-      uint8_t current_register_value;
-      // This is where status will be written to.
-      bool* return_status_ptr;
-      // Buffer is used for to transmit read operation from RTC.
+      uint8_t register_storage[RTC_MCP7940N_BATCH_NUM_REGISTERS + 1];
+      // Buffer used to send query for the registers.
       uint8_t transmit_buffer[1];
-    } oscillator_status;
+      // Modifications to be applied.
+      RTC_MCP7940N_Batch batch;
+    } batch_update;
 
     ////////////////////////////////////////////////////////////////////////////
-    // Battery backup.
-
-    // Storage related on battery backup enable/disable.
-    struct {
-      // Current value of register coming from RTC.
-      uint8_t current_register_value;
-      // Buffer is used for both receiving current register value and sending
-      // the new one.
-      uint8_t transmit_buffer[2];
-    } battery_bits;
+    // Oscillator and battery backup.
 
-    // Storage related on battery backup status fetch.
+    // Storage related on oscillator or battery backup status fetch.
     struct {
       // Current value of register coming from RTC.
       uint8_t current_register_value;
@@ -231,31 +261,42 @@ typedef struct RTC_MCP7940N {
       bool* return_status_ptr;
       // Buffer is used for to transmit read operation from RTC.
       uint8_t transmit_buffer[1];
-    } battery_status;
+    } status;
 
     ////////////////////////////////////////////////////////////////////////////
     // Register read/write.
 
-    // Storage related on ReadRegister command.
+    // Storage related on ReadRegister and ReadNumRegisters commands.
     struct {
+      // NOTE: This is a pointer to an external memory.
+      uint8_t* register_storage;
+      uint8_t num_registers;
+      // Buffer used to send address of the first register.
       uint8_t transmit_buffer[1];
     } register_read;
 
-    // Storage related on WriteRegister command.
+    // Storage related on WriteRegister, WriteNumRegisters and WriteSRAM
+    // commands.
     struct {
-      uint8_t transmit_buffer[2];
+      uint8_t num_registers;
+      // Address of the first register followed by the new values.
+      uint8_t transmit_buffer[RTC_MCP7940N_MAX_WRITE_SIZE + 1];
     } register_write;
+  } _private;
+} RTC_MCP7940N_Operation;
 
-    // Storage related on ReadNumRegisters command.
-    struct {
-      uint8_t transmit_buffer[1];
-    } register_num_read;
+typedef struct RTC_MCP7940N {
+  // Current state of state machine.
+  RTC_MCP7940N_State state;
 
-    // Storage related on WriteNumRegisters command.
-    struct {
-      uint8_t transmit_buffer[RTC_MCP7940N_NUM_REGISTERS];
-    } register_num_write;
-  } _private;
+  // I2C bus related handles.
+  RTC_MCP7940N_DriverHandle i2c_handle;
+  RTC_MCP7940N_BufferHandle i2c_buffer_handle;
+
+  // Ring buffer of queued operations, the first one is being performed.
+  RTC_MCP7940N_Operation queue[RTC_MCP7940N_QUEUE_SIZE];
+  uint8_t queue_head;
+  uint8_t queue_length;
 } RTC_MCP7940N;
 
 // Initialize MCP7940N RTC descriptor at the given I2C module index.
@@ -267,56 +308,158 @@ bool RTC_MCP7940N_Initialize(RTC_MCP7940N* rtc,
                              SYS_MODULE_INDEX i2c_module_index);
 
 // Perform all MCP7940N related tasks.
+//
+// Once an I2C transfer is over, the transfer for the next step of operation
+// or for the next queued operation is started right away.
 void RTC_MCP7940N_Tasks(RTC_MCP7940N* rtc);
 
 // Check whether RTC module is busy with any tasks.
 bool RTC_MCP7940N_IsBusy(RTC_MCP7940N* rtc);
 
-// Set current date and time.
+// Check whether no more operations can be queued.
+bool RTC_MCP7940N_IsQueueFull(RTC_MCP7940N* rtc);
+
+// All the functions below queue an operation, which is started as soon as
+// all previously queued operations are finished. Their callback is invoked
+// once operation is finished, callback is allowed to be NULL.
 //
-// NOTE: date_time->day_of_week is ignored.
-void RTC_MCP7940N_WriteDateAndTime(RTC_MCP7940N* rtc,
-                                   const RTC_MCP7940N_DateTime* date_time);
+// Returns false if the queue is full and operation was not queued.
+
+// Set current date and time.
+bool RTC_MCP7940N_WriteDateAndTime(RTC_MCP7940N* rtc,
+                                   const RTC_MCP7940N_DateTime* date_time,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data);
 
 // Read current date and time.
 //
 // The result is stored in date_time and can be accessed after
-// RTC becomes free from tasks.
-void RTC_MCP7940N_ReadDateAndTime(RTC_MCP7940N* rtc,
-                                  RTC_MCP7940N_DateTime* date_time);
+// the operation is finished.
+bool RTC_MCP7940N_ReadDateAndTime(RTC_MCP7940N* rtc,
+                                  RTC_MCP7940N_DateTime* date_time,
+                                  RTC_MCP7940N_CompletionCallback callback,
+                                  void* user_data);
 
 // Schedule task for reading given register value.
 //
 // The value will be stored in register_value and available after
-// RTC becomes free from tasks.
-void RTC_MCP7940N_ReadRegister(RTC_MCP7940N* rtc,
+// the operation is finished.
+bool RTC_MCP7940N_ReadRegister(RTC_MCP7940N* rtc,
                                uint8_t register_address,
-                               uint8_t* register_value);
+                               uint8_t* register_value,
+                               RTC_MCP7940N_CompletionCallback callback,
+                               void* user_data);
 
 // Write single register value.
-void RTC_MCP7940N_WriteRegister(RTC_MCP7940N* rtc,
+bool RTC_MCP7940N_WriteRegister(RTC_MCP7940N* rtc,
                                 uint8_t register_address,
-                                uint8_t register_value);
+                                uint8_t register_value,
+                                RTC_MCP7940N_CompletionCallback callback,
+                                void* user_data);
 
 // Similar to above, but operates with given number of registers.
-void RTC_MCP7940N_ReadNumRegisters(RTC_MCP7940N* rtc,
+bool RTC_MCP7940N_ReadNumRegisters(RTC_MCP7940N* rtc,
                                    uint8_t* register_storage,
-                                   uint8_t num_registers);
-void RTC_MCP7940N_WriteNumRegisters(RTC_MCP7940N* rtc,
+                                   uint8_t num_registers,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data);
+bool RTC_MCP7940N_WriteNumRegisters(RTC_MCP7940N* rtc,
                                     const uint8_t* register_storage,
-                                    uint8_t num_registers);
+                                    uint8_t num_registers,
+                                    RTC_MCP7940N_CompletionCallback callback,
+                                    void* user_data);
+
+// Read bytes from the SRAM, starting at the given offset from its beginning.
+//
+// Data is stored in the given memory, which is to be kept alive until
+// the operation is finished.
+//
+// NOTE: SRAM keeps its content on the main power loss only if the battery
+// backup is enabled, content is undefined after the battery was removed.
+bool RTC_MCP7940N_ReadSRAM(RTC_MCP7940N* rtc,
+                           uint8_t offset,
+                           uint8_t* data,
+                           uint8_t num_bytes,
+                           RTC_MCP7940N_CompletionCallback callback,
+                           void* user_data);
+
+// Write bytes to the SRAM, starting at the given offset from its beginning.
+//
+// Data is copied, so it does not need to be kept alive by the caller.
+bool RTC_MCP7940N_WriteSRAM(RTC_MCP7940N* rtc,
+                            uint8_t offset,
+                            const uint8_t* data,
+                            uint8_t num_bytes,
+                            RTC_MCP7940N_CompletionCallback callback,
+                            void* user_data);
 
 // Set enabled bit on the oscillator.
-void RTC_MCP7940N_EnableOscillator(RTC_MCP7940N* rtc, bool enable);
+bool RTC_MCP7940N_EnableOscillator(RTC_MCP7940N* rtc,
+                                   bool enable,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data);
 
 // Check whether oscillator is enabled.
-void RTC_MCP7940N_OscillatorStatus(RTC_MCP7940N* rtc, bool* enabled);
+bool RTC_MCP7940N_OscillatorStatus(RTC_MCP7940N* rtc,
+                                   bool* enabled,
+                                   RTC_MCP7940N_CompletionCallback callback,
+                                   void* user_data);
 
 // Set enabled bit on the battery backup.
-void RTC_MCP7940N_EnableBatteryBackup(RTC_MCP7940N* rtc, bool enable);
+bool RTC_MCP7940N_EnableBatteryBackup(RTC_MCP7940N* rtc,
+                                      bool enable,
+                                      RTC_MCP7940N_CompletionCallback callback,
+                                      void* user_data);
 
 // Check whether battery backup is enabled.
-void RTC_MCP7940N_BatteryBackupStatus(RTC_MCP7940N* rtc, bool* enabled);
+bool RTC_MCP7940N_BatteryBackupStatus(RTC_MCP7940N* rtc,
+                                      bool* enabled,
+                                      RTC_MCP7940N_CompletionCallback callback,
+                                      void* user_data);
+
+// Convert frequency correction in parts per billion to the value of the
+// calibration register. Positive correction speeds the clock up, correction
+// is clamped to the range which calibration register can represent.
+uint8_t RTC_MCP7940N_CalibrationFromPPB(int32_t correction_ppb);
+
+// Convert value of the calibration register to frequency correction in parts
+// per billion.
+int32_t RTC_MCP7940N_CalibrationToPPB(uint8_t calibration);
+
+// Batched register updates.
+//
+// Allows to combine several modifications (for example, set date and time,
+// start oscillator and enable battery backup) into two bus transactions.
+
+// Initialize batch which does not modify anything.
+void RTC_MCP7940N_BatchInitialize(RTC_MCP7940N_Batch* batch);
+
+// Set bits of the given register which are in the mask to the given value.
+void RTC_MCP7940N_BatchSetBits(RTC_MCP7940N_Batch* batch,
+                               uint8_t register_address,
+                               uint8_t mask,
+                               uint8_t value);
+
+// Add modifications of the time keeping registers.
+void RTC_MCP7940N_BatchSetDateAndTime(RTC_MCP7940N_Batch* batch,
+                                      const RTC_MCP7940N_DateTime* date_time);
+
+// Add modification of the oscillator start bit.
+void RTC_MCP7940N_BatchEnableOscillator(RTC_MCP7940N_Batch* batch,
+                                        bool enable);
+
+// Add modification of the battery backup enable bit.
+void RTC_MCP7940N_BatchEnableBatteryBackup(RTC_MCP7940N_Batch* batch,
+                                           bool enable);
+
+// Apply all modifications of the batch.
+//
+// Batch is copied, so it does not need to be kept alive by the caller.
+// Empty batch finishes right away, without any bus transactions.
+bool RTC_MCP7940N_WriteBatch(RTC_MCP7940N* rtc,
+                             const RTC_MCP7940N_Batch* batch,
+                             RTC_MCP7940N_CompletionCallback callback,
+                             void* user_data);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -0,0 +1,51 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "util_crc.h"
+
+uint16_t crc16_ccitt_update(uint16_t crc, const void* data, size_t num_bytes) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  size_t i;
+  for (i = 0; i < num_bytes; ++i) {
+    int bit;
+    crc ^= (uint16_t)bytes[i] << 8;
+    for (bit = 0; bit < 8; ++bit) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021)
+                           : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t num_bytes) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  size_t i;
+  crc = ~crc;
+  for (i = 0; i < num_bytes; ++i) {
+    int bit;
+    crc ^= bytes[i];
+    for (bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1) ? ((crc >> 1) ^ 0xedb88320) : (crc >> 1);
+    }
+  }
+  return ~crc;
+}
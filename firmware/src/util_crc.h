@@ -0,0 +1,48 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _UTIL_CRC_H
+#define _UTIL_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Initial value of the CRC-16/CCITT-FALSE checksum.
+#define CRC16_CCITT_INIT 0xffff
+
+// Update CRC-16/CCITT checksum (polynomial 0x1021) with the given bytes.
+//
+// Checksum of the data split into several chunks is the same as checksum of
+// the whole data, if the result of the previous chunk is passed as crc.
+uint16_t crc16_ccitt_update(uint16_t crc, const void* data, size_t num_bytes);
+
+// Initial value of the CRC-32 checksum.
+#define CRC32_INIT 0
+
+// Update CRC-32 checksum (reflected polynomial 0xedb88320, the one used by
+// zlib and the crc32 command line utility) with the given bytes.
+//
+// Unlike CRC-16 above, the inversion is done internally, so the result is
+// the final checksum and can be passed back as crc for the next chunk.
+uint32_t crc32_update(uint32_t crc, const void* data, size_t num_bytes);
+
+#endif  // _UTIL_CRC_H
@@ -0,0 +1,184 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "util_fat.h"
+
+#include <string.h>
+
+// Values FatFs uses for the volumes it formats.
+#define NUM_RESERVED_SECTORS 1
+#define NUM_FATS 1
+#define NUM_ROOT_ENTRIES 512
+#define DIRECTORY_ENTRY_SIZE 32
+#define MEDIA_DESCRIPTOR 0xf0
+
+// Maximum number of clusters of each type of the table, this is what readers
+// use to tell the type.
+#define MAX_FAT12_CLUSTERS 4084
+#define MAX_FAT16_CLUSTERS 65524
+
+// Minimum number of clusters, anything smaller is not worth a file system.
+#define MIN_CLUSTERS 16
+
+#define MAX_SECTORS_PER_CLUSTER 128
+
+static void uint16Encode(uint8_t* data, uint32_t value) {
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+}
+
+static void uint32Encode(uint8_t* data, uint32_t value) {
+  data[0] = value & 0xff;
+  data[1] = (value >> 8) & 0xff;
+  data[2] = (value >> 16) & 0xff;
+  data[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t rootDirectorySectors(const FatVolume* volume) {
+  return volume->num_root_entries * DIRECTORY_ENTRY_SIZE / FAT_SECTOR_SIZE;
+}
+
+// Number of sectors in the table covering the given number of clusters.
+static uint32_t fatSectors(uint32_t num_clusters, int fat_bits) {
+  // NOTE: First two entries of the table are reserved.
+  const uint32_t num_entries = num_clusters + 2;
+  const uint32_t num_bytes = (fat_bits == 12)
+                                 ? (num_entries * 3 + 1) / 2
+                                 : num_entries * 2;
+  return (num_bytes + FAT_SECTOR_SIZE - 1) / FAT_SECTOR_SIZE;
+}
+
+static int fatBits(uint32_t num_clusters) {
+  return (num_clusters <= MAX_FAT12_CLUSTERS) ? 12 : 16;
+}
+
+// Calculate size of the table and number of clusters for the given cluster
+// size.
+static bool layoutCalculate(FatVolume* volume) {
+  const uint32_t num_fixed_sectors =
+      volume->num_reserved_sectors + rootDirectorySectors(volume);
+  if (volume->num_sectors <= num_fixed_sectors) {
+    return false;
+  }
+  // Table is sized to cover the whole volume, so it is big enough for the
+  // clusters which are left once the table itself is placed. Those might
+  // need a smaller type of the table, it is fine for it to have unused
+  // sectors.
+  const uint32_t max_clusters =
+      (volume->num_sectors - num_fixed_sectors) /
+      volume->sectors_per_cluster;
+  volume->sectors_per_fat = fatSectors(max_clusters, fatBits(max_clusters));
+  const uint32_t num_system_sectors =
+      num_fixed_sectors + volume->num_fats * volume->sectors_per_fat;
+  if (volume->num_sectors <= num_system_sectors) {
+    return false;
+  }
+  volume->num_clusters = (volume->num_sectors - num_system_sectors) /
+                         volume->sectors_per_cluster;
+  volume->fat_bits = fatBits(volume->num_clusters);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public API.
+
+bool fat_volume_layout(uint32_t num_sectors,
+                       uint32_t volume_id,
+                       FatVolume* volume) {
+  memset(volume, 0, sizeof(*volume));
+  volume->num_sectors = num_sectors;
+  volume->num_reserved_sectors = NUM_RESERVED_SECTORS;
+  volume->num_fats = NUM_FATS;
+  volume->num_root_entries = NUM_ROOT_ENTRIES;
+  volume->volume_id = volume_id;
+  // Use the smallest cluster which keeps table within FAT16 limits, space is
+  // precious on a small flash.
+  for (volume->sectors_per_cluster = 1;
+       volume->sectors_per_cluster <= MAX_SECTORS_PER_CLUSTER;
+       volume->sectors_per_cluster *= 2) {
+    if (!layoutCalculate(volume)) {
+      return false;
+    }
+    if (volume->num_clusters <= MAX_FAT16_CLUSTERS) {
+      return volume->num_clusters >= MIN_CLUSTERS;
+    }
+  }
+  return false;
+}
+
+uint32_t fat_volume_num_system_sectors(const FatVolume* volume) {
+  return volume->num_reserved_sectors +
+         volume->num_fats * volume->sectors_per_fat +
+         rootDirectorySectors(volume);
+}
+
+void fat_volume_system_sector(const FatVolume* volume,
+                              uint32_t sector,
+                              uint8_t data[FAT_SECTOR_SIZE]) {
+  memset(data, 0, FAT_SECTOR_SIZE);
+  if (sector == 0) {
+    // Boot sector with BIOS parameter block.
+    const bool is_small = (volume->num_sectors < 0x10000);
+    data[0] = 0xeb;
+    data[1] = 0xfe;
+    data[2] = 0x90;
+    memcpy(data + 3, "MSDOS5.0", 8);
+    uint16Encode(data + 11, FAT_SECTOR_SIZE);
+    data[13] = volume->sectors_per_cluster;
+    uint16Encode(data + 14, volume->num_reserved_sectors);
+    data[16] = volume->num_fats;
+    uint16Encode(data + 17, volume->num_root_entries);
+    uint16Encode(data + 19, is_small ? volume->num_sectors : 0);
+    data[21] = MEDIA_DESCRIPTOR;
+    uint16Encode(data + 22, volume->sectors_per_fat);
+    // Sectors per track and number of heads, not used by anyone.
+    uint16Encode(data + 24, 63);
+    uint16Encode(data + 26, 255);
+    uint32Encode(data + 32, is_small ? 0 : volume->num_sectors);
+    // Drive number and extended boot signature.
+    data[36] = 0x80;
+    data[38] = 0x29;
+    uint32Encode(data + 39, volume->volume_id);
+    memcpy(data + 43, "NO NAME    ", 11);
+    memcpy(data + 54, (volume->fat_bits == 12) ? "FAT12   " : "FAT16   ", 8);
+    data[510] = 0x55;
+    data[511] = 0xaa;
+    return;
+  }
+  uint32_t fat_sector = volume->num_reserved_sectors;
+  uint32_t i;
+  for (i = 0; i < volume->num_fats; ++i) {
+    if (sector == fat_sector) {
+      // Entries of the two reserved clusters: media descriptor and end of
+      // chain marker. All the rest are free.
+      data[0] = MEDIA_DESCRIPTOR;
+      data[1] = 0xff;
+      data[2] = 0xff;
+      if (volume->fat_bits == 16) {
+        data[3] = 0xff;
+      }
+      return;
+    }
+    fat_sector += volume->sectors_per_fat;
+  }
+  // Other sectors of the tables and the root directory are all zeros.
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _UTIL_FAT_H
+#define _UTIL_FAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Layout of a FAT12/FAT16 volume without a partition table, the same as
+// FatFs creates with SFD format.
+//
+// Format only writes the system area of the volume: boot sector, allocation
+// table and root directory. Data area is not touched, all its clusters are
+// marked as free. This allows format to be done a sector at a time, without
+// calling into the file system, which does the whole format in one go.
+
+// Size of the logical sector of the volume, as used by the file system.
+#define FAT_SECTOR_SIZE 512
+
+typedef struct FatVolume {
+  // Total number of sectors of the volume.
+  uint32_t num_sectors;
+  uint32_t sectors_per_cluster;
+  uint32_t num_reserved_sectors;
+  uint32_t num_fats;
+  uint32_t num_root_entries;
+  uint32_t sectors_per_fat;
+  // Number of clusters in the data area, defines type of the table.
+  uint32_t num_clusters;
+  // 12 or 16.
+  int fat_bits;
+  // Serial number of the volume.
+  uint32_t volume_id;
+} FatVolume;
+
+// Calculate layout of the volume of the given number of sectors.
+//
+// Returns false if the volume is too small or too big for FAT12/FAT16.
+bool fat_volume_layout(uint32_t num_sectors,
+                       uint32_t volume_id,
+                       FatVolume* volume);
+
+// Number of sectors at the beginning of the volume which are written by the
+// format: reserved sectors, allocation tables and root directory.
+uint32_t fat_volume_num_system_sectors(const FatVolume* volume);
+
+// Fill in content of the given system sector of a freshly formatted volume.
+void fat_volume_system_sector(const FatVolume* volume,
+                              uint32_t sector,
+                              uint8_t data[FAT_SECTOR_SIZE]);
+
+#endif  // _UTIL_FAT_H
@@ -0,0 +1,185 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "util_http.h"
+
+#include <string.h>
+
+static bool isWhitespace(char ch) {
+  return ch == ' ' || ch == '\t';
+}
+
+static char toLower(char ch) {
+  if (ch >= 'A' && ch <= 'Z') {
+    return ch - 'A' + 'a';
+  }
+  return ch;
+}
+
+// Find character in the string of the given length, returns its index or
+// len if there is no such character.
+static size_t findChar(const char* str, size_t len, char ch) {
+  size_t i;
+  for (i = 0; i < len; ++i) {
+    if (str[i] == ch) {
+      break;
+    }
+  }
+  return i;
+}
+
+void http_response_scanner_reset(HttpResponseScanner* scanner) {
+  scanner->line_len = 0;
+  scanner->is_body = false;
+}
+
+size_t http_response_scanner_feed(HttpResponseScanner* scanner,
+                                  const uint8_t* buffer,
+                                  size_t num_bytes,
+                                  HttpHeaderLineCallback callback,
+                                  void* user_data) {
+  size_t i;
+  if (scanner->is_body) {
+    return 0;
+  }
+  for (i = 0; i < num_bytes && !scanner->is_body; ++i) {
+    const char ch = buffer[i];
+    if (ch == '\r') {
+      continue;
+    }
+    if (ch == '\n') {
+      if (scanner->line_len == 0) {
+        scanner->is_body = true;
+      } else if (scanner->line_len <= sizeof(scanner->line)) {
+        callback(scanner->line, scanner->line_len, user_data);
+      }
+      scanner->line_len = 0;
+      continue;
+    }
+    if (scanner->line_len < sizeof(scanner->line)) {
+      scanner->line[scanner->line_len++] = ch;
+    } else {
+      scanner->line_len = sizeof(scanner->line) + 1;
+    }
+  }
+  return i;
+}
+
+bool http_parse_status_line(const char* line,
+                            size_t line_len,
+                            int* status_code) {
+  if (line_len < 5 || memcmp(line, "HTTP/", 5) != 0) {
+    return false;
+  }
+  // Skip protocol version.
+  size_t i = findChar(line, line_len, ' ');
+  while (i < line_len && isWhitespace(line[i])) {
+    ++i;
+  }
+  if (line_len - i < 3) {
+    return false;
+  }
+  const size_t code_len = findChar(line + i, line_len - i, ' ');
+  uint32_t code;
+  if (code_len != 3 || !http_parse_uint32(line + i, code_len, &code)) {
+    return false;
+  }
+  *status_code = code;
+  return true;
+}
+
+const char* http_header_value(const char* line,
+                              size_t line_len,
+                              const char* name,
+                              size_t* value_len) {
+  const size_t name_len = strlen(name);
+  size_t i;
+  if (line_len <= name_len || line[name_len] != ':') {
+    return NULL;
+  }
+  for (i = 0; i < name_len; ++i) {
+    if (toLower(line[i]) != name[i]) {
+      return NULL;
+    }
+  }
+  const char* value = line + name_len + 1;
+  size_t len = line_len - name_len - 1;
+  while (len != 0 && isWhitespace(*value)) {
+    ++value;
+    --len;
+  }
+  while (len != 0 && isWhitespace(value[len - 1])) {
+    --len;
+  }
+  *value_len = len;
+  return value;
+}
+
+bool http_parse_uint32(const char* str, size_t len, uint32_t* value) {
+  uint32_t result = 0;
+  size_t i;
+  if (len == 0) {
+    return false;
+  }
+  for (i = 0; i < len; ++i) {
+    const char ch = str[i];
+    if (ch < '0' || ch > '9') {
+      return false;
+    }
+    const uint32_t digit = ch - '0';
+    if (result > (UINT32_MAX - digit) / 10) {
+      return false;
+    }
+    result = result * 10 + digit;
+  }
+  *value = result;
+  return true;
+}
+
+bool http_parse_content_range(const char* value,
+                              size_t value_len,
+                              uint32_t* first,
+                              uint32_t* last,
+                              uint32_t* total) {
+  if (value_len < 6 || memcmp(value, "bytes ", 6) != 0) {
+    return false;
+  }
+  value += 6;
+  value_len -= 6;
+  const size_t dash = findChar(value, value_len, '-');
+  const size_t slash = findChar(value, value_len, '/');
+  if (dash >= slash || slash == value_len) {
+    return false;
+  }
+  if (!http_parse_uint32(value, dash, first) ||
+      !http_parse_uint32(value + dash + 1, slash - dash - 1, last) ||
+      *last < *first) {
+    return false;
+  }
+  const char* total_str = value + slash + 1;
+  const size_t total_len = value_len - slash - 1;
+  if (total_len == 1 && total_str[0] == '*') {
+    *total = 0;
+    return true;
+  }
+  return http_parse_uint32(total_str, total_len, total) && *last < *total;
+}
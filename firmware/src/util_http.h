@@ -0,0 +1,90 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _UTIL_HTTP_H
+#define _UTIL_HTTP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers to parse HTTP response which arrives in chunks of arbitrary size.
+
+// Maximum length of the header line which is passed to the callback, longer
+// lines are skipped.
+#define HTTP_MAX_HEADER_LINE 128
+
+// Invoked for every complete line of the response headers, with the line
+// terminator stripped. The first line is the status line.
+typedef void (*HttpHeaderLineCallback)(const char* line,
+                                       size_t line_len,
+                                       void* user_data);
+
+typedef struct HttpResponseScanner {
+  char line[HTTP_MAX_HEADER_LINE];
+  // NOTE: Goes one past the buffer size for the truncated lines.
+  size_t line_len;
+  // Empty line which terminates headers was seen.
+  bool is_body;
+} HttpResponseScanner;
+
+// Prepare scanner for a new response.
+void http_response_scanner_reset(HttpResponseScanner* scanner);
+
+// Feed bytes of the response into the scanner.
+//
+// Returns number of bytes at the beginning of the buffer which belong to the
+// headers, the rest of the buffer is the body. Once headers are over, all
+// bytes are the body and zero is returned.
+size_t http_response_scanner_feed(HttpResponseScanner* scanner,
+                                  const uint8_t* buffer,
+                                  size_t num_bytes,
+                                  HttpHeaderLineCallback callback,
+                                  void* user_data);
+
+// Parse status line of the response, like "HTTP/1.1 206 Partial Content".
+bool http_parse_status_line(const char* line,
+                            size_t line_len,
+                            int* status_code);
+
+// Check whether the line is a header with the given name, which is expected
+// to be lower case and to not have the colon.
+//
+// Returns value of the header with the surrounding whitespace stripped, or
+// NULL if the line is a different header.
+const char* http_header_value(const char* line,
+                              size_t line_len,
+                              const char* name,
+                              size_t* value_len);
+
+// Parse decimal number which takes the whole string.
+bool http_parse_uint32(const char* str, size_t len, uint32_t* value);
+
+// Parse value of Content-Range header: "bytes first-last/total". Total is
+// zero if it is not known to the server ("bytes first-last/*").
+bool http_parse_content_range(const char* value,
+                              size_t value_len,
+                              uint32_t* first,
+                              uint32_t* last,
+                              uint32_t* total);
+
+#endif  // _UTIL_HTTP_H
@@ -25,3 +25,7 @@
 size_t min_zz(size_t a, size_t b) {
   return a < b ? a : b;
 }
+
+size_t max_zz(size_t a, size_t b) {
+  return a > b ? a : b;
+}
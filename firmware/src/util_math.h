@@ -26,5 +26,6 @@
 #include <stddef.h>
 
 size_t min_zz(size_t a, size_t b);
+size_t max_zz(size_t a, size_t b);
 
 #endif  // _UTIL_MATH_H
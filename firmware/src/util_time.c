@@ -0,0 +1,98 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "util_time.h"
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+#define EPOCH_YEAR 2000
+
+// Day of week of 2000-01-01, which was Saturday.
+#define EPOCH_DAY_OF_WEEK 6
+
+static int daysInYear(int year) {
+  return is_leap_year(year) ? 366 : 365;
+}
+
+bool is_leap_year(int year) {
+  return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
+}
+
+int days_in_month(int year, int month) {
+  static const int num_days[12] = {31, 28, 31, 30, 31, 30,
+                                   31, 31, 30, 31, 30, 31};
+  if (month == 2 && is_leap_year(year)) {
+    return 29;
+  }
+  return num_days[month - 1];
+}
+
+bool calendar_time_is_valid(const CalendarTime* calendar_time) {
+  const CalendarTime* t = calendar_time;
+  if (t->year < EPOCH_YEAR || t->month < 1 || t->month > 12) {
+    return false;
+  }
+  if (t->day < 1 || t->day > days_in_month(t->year, t->month)) {
+    return false;
+  }
+  return t->hours >= 0 && t->hours < 24 &&
+         t->minutes >= 0 && t->minutes < 60 &&
+         t->seconds >= 0 && t->seconds < 60;
+}
+
+uint32_t calendar_time_to_seconds(const CalendarTime* calendar_time) {
+  uint32_t num_days = 0;
+  int year, month;
+  for (year = EPOCH_YEAR; year < calendar_time->year; ++year) {
+    num_days += daysInYear(year);
+  }
+  for (month = 1; month < calendar_time->month; ++month) {
+    num_days += days_in_month(calendar_time->year, month);
+  }
+  num_days += calendar_time->day - 1;
+  return num_days * SECONDS_PER_DAY +
+         calendar_time->hours * 60 * 60 +
+         calendar_time->minutes * 60 +
+         calendar_time->seconds;
+}
+
+void calendar_time_from_seconds(uint32_t seconds,
+                                CalendarTime* calendar_time) {
+  uint32_t num_days = seconds / SECONDS_PER_DAY;
+  uint32_t day_seconds = seconds % SECONDS_PER_DAY;
+  calendar_time->day_of_week = (num_days + EPOCH_DAY_OF_WEEK - 1) % 7 + 1;
+  calendar_time->hours = day_seconds / (60 * 60);
+  calendar_time->minutes = (day_seconds / 60) % 60;
+  calendar_time->seconds = day_seconds % 60;
+  int year = EPOCH_YEAR;
+  while (num_days >= (uint32_t)daysInYear(year)) {
+    num_days -= daysInYear(year);
+    ++year;
+  }
+  int month = 1;
+  while (num_days >= (uint32_t)days_in_month(year, month)) {
+    num_days -= days_in_month(year, month);
+    ++month;
+  }
+  calendar_time->year = year;
+  calendar_time->month = month;
+  calendar_time->day = num_days + 1;
+}
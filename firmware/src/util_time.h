@@ -0,0 +1,68 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _UTIL_TIME_H
+#define _UTIL_TIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Calendar time utilities.
+//
+// Time is counted in seconds since the beginning of 2000-01-01 (the earliest
+// date MCP7940N can keep), which fits into 32 bits for way longer than this
+// device will be alive.
+
+typedef struct CalendarTime {
+  // Full year, 2000 and later.
+  int year;
+  // Month, 1 for January.
+  int month;
+  // Day of month, starting from 1.
+  int day;
+  // Day of week, 1 for Monday and 7 for Sunday.
+  int day_of_week;
+  int hours;
+  int minutes;
+  int seconds;
+} CalendarTime;
+
+bool is_leap_year(int year);
+
+// Number of days in the given month of the given year.
+int days_in_month(int year, int month);
+
+// Check all fields of the calendar time are within valid range.
+//
+// NOTE: Day of week is not checked against the date.
+bool calendar_time_is_valid(const CalendarTime* calendar_time);
+
+// Convert calendar time to a number of seconds since 2000-01-01.
+//
+// NOTE: Day of week is ignored.
+uint32_t calendar_time_to_seconds(const CalendarTime* calendar_time);
+
+// Convert number of seconds since 2000-01-01 to calendar time.
+void calendar_time_from_seconds(uint32_t seconds,
+                                CalendarTime* calendar_time);
+
+#endif  // _UTIL_TIME_H
@@ -0,0 +1,316 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "app_command_task.h"
+}
+
+namespace NixieTracker {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Simulated state of the resource and log of the callback invocations.
+struct TestContext {
+  bool is_resource_available = true;
+  // Number of update calls after which task with the given name finishes.
+  // Tasks which are not in this map are finished on the first update.
+  map<string, int> num_updates_to_finish;
+  map<string, int> num_updates;
+  // Tasks which wait for completion event of the resource after invoke.
+  set<string> wait_event;
+  // Log of the tasks in the form of `<name>@<console>`.
+  vector<string> invoked;
+  vector<string> finished;
+  int num_running = 0;
+  int max_num_running = 0;
+};
+
+TestContext* g_context = nullptr;
+
+// Test consoles are only identified by their addresses.
+char g_consoles[4];
+
+SYS_CMD_DEVICE_NODE* testConsole(int index) {
+  return reinterpret_cast<SYS_CMD_DEVICE_NODE*>(&g_consoles[index]);
+}
+
+string taskName(SYS_CMD_DEVICE_NODE* cmd_io,
+                AppCommandTaskStorage* storage) {
+  const int console = reinterpret_cast<char*>(cmd_io) - g_consoles;
+  return string(storage->fetch.url) + "@" + std::to_string(console);
+}
+
+AppCommandTaskCallbackResult testTaskCallback(
+    struct AppData* /*app_data*/,
+    SYS_CMD_DEVICE_NODE* cmd_io,
+    AppCommandTaskStorage* storage,
+    AppCommandTaskCallbackMode mode) {
+  const string name = taskName(cmd_io, storage);
+  switch (mode) {
+    case APP_COMMAND_TASK_MODE_CALLBACK_INVOKE:
+      g_context->invoked.push_back(name);
+      ++g_context->num_running;
+      g_context->max_num_running = std::max(g_context->max_num_running,
+                                            g_context->num_running);
+      if (g_context->wait_event.count(storage->fetch.url)) {
+        return APP_COMMAND_TASK_RESULT_WAIT_EVENT;
+      }
+      break;
+    case APP_COMMAND_TASK_MODE_CALLBACK_UPDATE: {
+      const auto it = g_context->num_updates_to_finish.find(storage->fetch.url);
+      const int num_updates_to_finish =
+          (it != g_context->num_updates_to_finish.end()) ? it->second : 1;
+      if (++g_context->num_updates[name] >= num_updates_to_finish) {
+        g_context->finished.push_back(name);
+        --g_context->num_running;
+        return APP_COMMAND_TASK_RESULT_FINISHED;
+      }
+      break;
+    }
+  }
+  return APP_COMMAND_TASK_RESULT_RUNNING;
+}
+
+bool testTaskCheckAvailable(struct AppData* /*app_data*/) {
+  return g_context->is_resource_available;
+}
+
+void scheduleTestTask(AppCommandTaskData* task_data,
+                      int console,
+                      AppCommandTaskResource resource,
+                      const char* name) {
+  ASSERT_FALSE(APP_Command_Task_IsFull(task_data));
+  AppCommandTaskStorage* storage =
+      APP_Command_Task_Schedule(task_data,
+                                testConsole(console),
+                                resource,
+                                testTaskCallback,
+                                testTaskCheckAvailable);
+  ASSERT_NE(storage, nullptr);
+  strncpy(storage->fetch.url, name, sizeof(storage->fetch.url) - 1);
+}
+
+void runUntilIdle(AppCommandTaskData* task_data) {
+  for (int i = 0; i < 100 && APP_Command_Task_IsBusy(task_data); ++i) {
+    APP_Event_Tasks(task_data->app_event_bus);
+    APP_Command_Task_Tasks(task_data, nullptr);
+  }
+}
+
+}  // namespace
+
+TEST(AppCommandTask, Empty) {
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  EXPECT_FALSE(APP_Command_Task_IsBusy(&task_data));
+  EXPECT_FALSE(APP_Command_Task_IsFull(&task_data));
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_FALSE(APP_Command_Task_IsBusy(&task_data));
+}
+
+TEST(AppCommandTask, DifferentResourcesRunConcurrently) {
+  TestContext context;
+  context.num_updates_to_finish = {{"a", 3}, {"b", 3}, {"c", 3}};
+  g_context = &context;
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_HTTPS_CLIENT, "a");
+  scheduleTestTask(&task_data, 1, APP_COMMAND_TASK_RESOURCE_RTC, "b");
+  scheduleTestTask(&task_data, 1, APP_COMMAND_TASK_RESOURCE_FLASH, "c");
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_EQ(context.invoked, (vector<string>{"a@0", "b@1", "c@1"}));
+  runUntilIdle(&task_data);
+  EXPECT_EQ(context.max_num_running, 3);
+  EXPECT_EQ(context.finished, (vector<string>{"a@0", "b@1", "c@1"}));
+  EXPECT_FALSE(APP_Command_Task_IsBusy(&task_data));
+  g_context = nullptr;
+}
+
+TEST(AppCommandTask, SameResourceRunsInOrder) {
+  TestContext context;
+  context.num_updates_to_finish = {{"a", 2}, {"b", 2}};
+  g_context = &context;
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_RTC, "a");
+  scheduleTestTask(&task_data, 1, APP_COMMAND_TASK_RESOURCE_RTC, "b");
+  scheduleTestTask(&task_data, 2, APP_COMMAND_TASK_RESOURCE_RTC, "c");
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_EQ(context.invoked, (vector<string>{"a@0"}));
+  runUntilIdle(&task_data);
+  EXPECT_EQ(context.max_num_running, 1);
+  EXPECT_EQ(context.invoked, (vector<string>{"a@0", "b@1", "c@2"}));
+  EXPECT_EQ(context.finished, (vector<string>{"a@0", "b@1", "c@2"}));
+  g_context = nullptr;
+}
+
+TEST(AppCommandTask, OrderIsKeptWhenSlotsAreReused) {
+  TestContext context;
+  context.num_updates_to_finish = {{"a", 3}};
+  g_context = &context;
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_RTC, "a");
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_FLASH, "b");
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_RTC, "c");
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_EQ(context.finished, (vector<string>{"b@0"}));
+  // Slot of the finished task is reused, so the new task is stored prior to
+  // the one which is still waiting for the resource.
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_RTC, "d");
+  runUntilIdle(&task_data);
+  EXPECT_EQ(context.invoked, (vector<string>{"a@0", "b@0", "c@0", "d@0"}));
+  EXPECT_EQ(context.finished, (vector<string>{"b@0", "a@0", "c@0", "d@0"}));
+  g_context = nullptr;
+}
+
+TEST(AppCommandTask, WaitsForResource) {
+  TestContext context;
+  context.is_resource_available = false;
+  g_context = &context;
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_RTC, "a");
+  for (int i = 0; i < 10; ++i) {
+    APP_Command_Task_Tasks(&task_data, nullptr);
+  }
+  EXPECT_TRUE(context.invoked.empty());
+  EXPECT_TRUE(APP_Command_Task_IsBusy(&task_data));
+  EXPECT_FALSE(APP_Command_Task_IsRunnable(&task_data));
+  // Availability is only checked again once resource reported it is done.
+  context.is_resource_available = true;
+  runUntilIdle(&task_data);
+  EXPECT_TRUE(context.invoked.empty());
+  APP_Event_Post(&event_bus, APP_EVENT_RTC_DONE, nullptr);
+  runUntilIdle(&task_data);
+  EXPECT_EQ(context.finished, (vector<string>{"a@0"}));
+  g_context = nullptr;
+}
+
+TEST(AppCommandTask, WaitsForCompletionEvent) {
+  TestContext context;
+  context.wait_event = {"a"};
+  g_context = &context;
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  // Event of an operation which happened before the task is started.
+  APP_Event_Post(&event_bus, APP_EVENT_RTC_DONE, nullptr);
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_RTC, "a");
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_EQ(context.invoked, (vector<string>{"a@0"}));
+  // Neither the stale event nor event of other resource finish the task.
+  APP_Event_Post(&event_bus, APP_EVENT_FLASH_DONE, nullptr);
+  for (int i = 0; i < 10; ++i) {
+    APP_Event_Tasks(&event_bus);
+    APP_Command_Task_Tasks(&task_data, nullptr);
+  }
+  EXPECT_TRUE(context.finished.empty());
+  EXPECT_FALSE(APP_Command_Task_IsRunnable(&task_data));
+  APP_Event_Post(&event_bus, APP_EVENT_RTC_DONE, nullptr);
+  APP_Event_Tasks(&event_bus);
+  EXPECT_TRUE(APP_Command_Task_IsRunnable(&task_data));
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_EQ(context.finished, (vector<string>{"a@0"}));
+  EXPECT_FALSE(APP_Command_Task_IsBusy(&task_data));
+  g_context = nullptr;
+}
+
+TEST(AppCommandTask, FirmwareUpdateWaitsForDownload) {
+  TestContext context;
+  context.wait_event = {"download"};
+  g_context = &context;
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_DOWNLOAD,
+                   "download");
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_EQ(context.invoked, (vector<string>{"download@0"}));
+  // Update can not start while the download module is busy.
+  context.is_resource_available = false;
+  scheduleTestTask(&task_data, 1, APP_COMMAND_TASK_RESOURCE_FIRMWARE_UPDATE,
+                   "update");
+  for (int i = 0; i < 10; ++i) {
+    APP_Event_Tasks(&event_bus);
+    APP_Command_Task_Tasks(&task_data, nullptr);
+  }
+  EXPECT_EQ(context.invoked, (vector<string>{"download@0"}));
+  // Only the download posts completion event, which is to wake up the update.
+  context.is_resource_available = true;
+  APP_Event_Post(&event_bus, APP_EVENT_DOWNLOAD_DONE, nullptr);
+  runUntilIdle(&task_data);
+  EXPECT_EQ(context.invoked, (vector<string>{"download@0", "update@1"}));
+  EXPECT_EQ(context.finished, (vector<string>{"download@0", "update@1"}));
+  EXPECT_FALSE(APP_Command_Task_IsBusy(&task_data));
+  g_context = nullptr;
+}
+
+TEST(AppCommandTask, Full) {
+  TestContext context;
+  context.is_resource_available = false;
+  g_context = &context;
+  AppEventBus event_bus;
+  APP_Event_Initialize(&event_bus);
+  AppCommandTaskData task_data;
+  APP_Command_Task_Initialize(&task_data, &event_bus);
+  for (int i = 0; i < APP_CONFIG_NUM_COMMAND_TASKS; ++i) {
+    scheduleTestTask(&task_data, 0, APP_COMMAND_TASK_RESOURCE_RTC, "a");
+  }
+  EXPECT_TRUE(APP_Command_Task_IsFull(&task_data));
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  context.is_resource_available = true;
+  APP_Event_Post(&event_bus, APP_EVENT_RTC_DONE, nullptr);
+  APP_Event_Tasks(&event_bus);
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  APP_Command_Task_Tasks(&task_data, nullptr);
+  EXPECT_FALSE(APP_Command_Task_IsFull(&task_data));
+  g_context = nullptr;
+}
+
+}  // namespace NixieTracker
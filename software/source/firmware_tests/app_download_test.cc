@@ -0,0 +1,605 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sst25_emulator.h"
+
+extern "C" {
+#include "app_download.h"
+#include "app_event.h"
+#include "app_flash_raw.h"
+#include "app_https_client.h"
+#include "app_timer.h"
+#include "util_crc.h"
+}
+
+namespace NixieTracker {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+SST25Emulator* g_emulator = nullptr;
+
+// Server which replies to the requests of the download module, serving one
+// resource.
+class FakeServer {
+ public:
+  FakeServer()
+      : supports_range(true),
+        chunk_time_ns(2560 * 1000),
+        is_active_(false),
+        position_(0),
+        end_position_(0) {
+    memset(&callbacks_, 0, sizeof(callbacks_));
+  }
+
+  void request(uint32_t range_begin, const AppHttpsClientCallbacks* callbacks) {
+    range_begins.push_back(range_begin);
+    callbacks_ = *callbacks;
+    const uint32_t size = resource.size();
+    char headers[256];
+    uint32_t body_begin = 0;
+    if (range_begin != 0 && supports_range) {
+      snprintf(headers, sizeof(headers),
+               "HTTP/1.1 206 Partial Content\r\n"
+               "Content-Range: bytes %u-%u/%u\r\n"
+               "Content-Length: %u\r\n"
+               "\r\n",
+               range_begin, size - 1, size, size - range_begin);
+      body_begin = range_begin;
+    } else {
+      snprintf(headers, sizeof(headers),
+               "HTTP/1.1 200 OK\r\n"
+               "Content-Length: %u\r\n"
+               "\r\n",
+               size);
+    }
+    response_.assign(headers, headers + strlen(headers));
+    const size_t num_header_bytes = response_.size();
+    response_.insert(response_.end(),
+                     resource.begin() + body_begin,
+                     resource.end());
+    position_ = 0;
+    end_position_ = response_.size();
+    // Connection is dropped after the given number of body bytes.
+    if (!drop_after.empty()) {
+      end_position_ = std::min(end_position_,
+                               num_header_bytes + drop_after.front());
+      drop_after.erase(drop_after.begin());
+    }
+    is_active_ = true;
+  }
+
+  // Deliver the next buffer to the receiver, if it is ready for it.
+  //
+  // Returns false if nothing was delivered.
+  bool step() {
+    if (!is_active_) {
+      return false;
+    }
+    if (callbacks_.is_ready != nullptr &&
+        !callbacks_.is_ready(callbacks_.user_data)) {
+      return false;
+    }
+    const size_t num_bytes = std::min<size_t>(
+        HTTPS_CLIENT_NETWORK_BUFFER_SIZE, end_position_ - position_);
+    if (num_bytes != 0) {
+      g_emulator->advanceTime(chunk_time_ns * num_bytes /
+                              HTTPS_CLIENT_NETWORK_BUFFER_SIZE);
+      callbacks_.buffer_received(&response_[position_],
+                                 num_bytes,
+                                 callbacks_.user_data);
+      position_ += num_bytes;
+    }
+    if (position_ == response_.size()) {
+      is_active_ = false;
+      callbacks_.request_handled(callbacks_.user_data);
+    } else if (position_ == end_position_) {
+      abort();
+    }
+    return true;
+  }
+
+  void abort() {
+    if (!is_active_) {
+      return;
+    }
+    is_active_ = false;
+    callbacks_.error(callbacks_.user_data);
+  }
+
+  bool isActive() const {
+    return is_active_;
+  }
+
+  vector<uint8_t> resource;
+  bool supports_range;
+  // Time it takes the network to deliver the full buffer.
+  uint64_t chunk_time_ns;
+  // Number of body bytes after which every following request is dropped.
+  vector<size_t> drop_after;
+  // Range of every received request.
+  vector<uint32_t> range_begins;
+
+ private:
+  AppHttpsClientCallbacks callbacks_;
+  bool is_active_;
+  vector<uint8_t> response_;
+  size_t position_;
+  size_t end_position_;
+};
+
+FakeServer* g_server = nullptr;
+
+// In-memory file system, handle is an index of the open file.
+struct FakeFile {
+  string path;
+  size_t position;
+};
+
+map<string, vector<uint8_t>> g_files;
+vector<FakeFile> g_open_files;
+
+}  // namespace
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+// System timer follows time of the emulated flash, in microseconds.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  if (NixieTracker::g_emulator == nullptr) {
+    return 0;
+  }
+  return NixieTracker::g_emulator->time() / 1000;
+}
+
+bool APP_HTTPS_Client_RequestRange(
+    AppHTTPSClientData* /*app_https_client_data*/,
+    const char /*url*/[MAX_URL],
+    uint32_t range_begin,
+    const AppHttpsClientCallbacks* callbacks) {
+  NixieTracker::g_server->request(range_begin, callbacks);
+  return true;
+}
+
+bool APP_HTTPS_Client_IsBusy(AppHTTPSClientData* /*app_https_client_data*/) {
+  return NixieTracker::g_server->isActive();
+}
+
+void APP_HTTPS_Client_Abort(AppHTTPSClientData* /*app_https_client_data*/) {
+  NixieTracker::g_server->abort();
+}
+
+SYS_FS_HANDLE SYS_FS_FileOpen(const char* fname,
+                              SYS_FS_FILE_OPEN_ATTRIBUTES attributes) {
+  using NixieTracker::g_files;
+  using NixieTracker::g_open_files;
+  NixieTracker::FakeFile file = {fname, 0};
+  switch (attributes) {
+    case SYS_FS_FILE_OPEN_READ:
+      if (g_files.find(fname) == g_files.end()) {
+        return SYS_FS_HANDLE_INVALID;
+      }
+      break;
+    case SYS_FS_FILE_OPEN_WRITE:
+      g_files[fname].clear();
+      break;
+    case SYS_FS_FILE_OPEN_APPEND:
+      file.position = g_files[fname].size();
+      break;
+  }
+  g_open_files.push_back(file);
+  return g_open_files.size() - 1;
+}
+
+size_t SYS_FS_FileRead(SYS_FS_HANDLE handle, void* buf, size_t nbyte) {
+  NixieTracker::FakeFile& file = NixieTracker::g_open_files[handle];
+  const std::vector<uint8_t>& data = NixieTracker::g_files[file.path];
+  const size_t num_bytes = std::min(nbyte, data.size() - file.position);
+  memcpy(buf, data.data() + file.position, num_bytes);
+  file.position += num_bytes;
+  return num_bytes;
+}
+
+size_t SYS_FS_FileWrite(SYS_FS_HANDLE handle, const void* buf, size_t nbyte) {
+  NixieTracker::FakeFile& file = NixieTracker::g_open_files[handle];
+  std::vector<uint8_t>& data = NixieTracker::g_files[file.path];
+  data.resize(std::max(data.size(), file.position + nbyte));
+  memcpy(data.data() + file.position, buf, nbyte);
+  file.position += nbyte;
+  return nbyte;
+}
+
+int32_t SYS_FS_FileSize(SYS_FS_HANDLE handle) {
+  const NixieTracker::FakeFile& file = NixieTracker::g_open_files[handle];
+  return NixieTracker::g_files[file.path].size();
+}
+
+SYS_FS_RESULT SYS_FS_FileClose(SYS_FS_HANDLE /*handle*/) {
+  return SYS_FS_RES_SUCCESS;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+namespace {
+
+const uint32_t kResourceSize = 64 * 1024;
+
+class DownloadTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(emulator_.open());
+    emulator_.activate();
+    g_emulator = &emulator_;
+    g_server = &server_;
+    g_files.clear();
+    g_open_files.clear();
+    APP_Timer_Initialize(&timer_wheel_);
+    APP_Event_Initialize(&event_bus_);
+    APP_FlashRaw_Initialize(&flash_raw_, &timer_wheel_);
+    APP_Download_Initialize(&download_,
+                            nullptr,
+                            &flash_raw_,
+                            &timer_wheel_,
+                            &event_bus_);
+    server_.resource = makeResource(kResourceSize);
+  }
+
+  void TearDown() override {
+    g_server = nullptr;
+    g_emulator = nullptr;
+    emulator_.deactivate();
+  }
+
+  static vector<uint8_t> makeResource(size_t size) {
+    vector<uint8_t> resource(size);
+    uint32_t state = 12345;
+    for (size_t i = 0; i < size; ++i) {
+      state = state * 1103515245 + 12345;
+      resource[i] = state >> 16;
+    }
+    return resource;
+  }
+
+  static uint32_t crc(const vector<uint8_t>& data) {
+    return crc32_update(CRC32_INIT, data.data(), data.size());
+  }
+
+  // Run the main loop until the download is finished.
+  //
+  // Time advances while the network delivers data, and skips to the next
+  // completion of the flash command when nothing else can happen.
+  void runUntilDone() {
+    for (int i = 0; i < 1000000; ++i) {
+      APP_Timer_Tasks(&timer_wheel_);
+      APP_Event_Tasks(&event_bus_);
+      const bool is_delivered = server_.step();
+      if (APP_Download_IsRunnable(&download_)) {
+        APP_Download_Tasks(&download_);
+      }
+      if (APP_FlashRaw_IsRunnable(&flash_raw_)) {
+        APP_FlashRaw_Tasks(&flash_raw_);
+      }
+      if (!APP_Download_IsBusy(&download_) &&
+          !APP_FlashRaw_IsBusy(&flash_raw_)) {
+        return;
+      }
+      if (!is_delivered) {
+        if (emulator_.isBusy()) {
+          emulator_.advanceToNextCompletion();
+        } else {
+          emulator_.advanceTime(100 * 1000);
+        }
+      }
+    }
+    ADD_FAILURE() << "Download did not finish";
+  }
+
+  vector<uint8_t> regionContent(AppFlashRawRegion region, size_t size) {
+    const uint8_t* data = emulator_.data() + flash_raw_.region_address[region];
+    return vector<uint8_t>(data, data + size);
+  }
+
+  SST25Emulator emulator_;
+  FakeServer server_;
+  AppTimerWheel timer_wheel_;
+  AppEventBus event_bus_;
+  AppFlashRawData flash_raw_;
+  AppDownloadData download_;
+};
+
+}  // namespace
+
+TEST_F(DownloadTest, DownloadsIntoRegion) {
+  const uint32_t expected_crc = crc(server_.resource);
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      &expected_crc,
+                                      nullptr));
+  EXPECT_FALSE(APP_Download_ToFlashRaw(&download_,
+                                       "https://example.com/resource",
+                                       APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                       0,
+                                       nullptr,
+                                       nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  EXPECT_EQ(download_.num_bytes_stored, kResourceSize);
+  EXPECT_EQ(download_.stored_crc, expected_crc);
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({0}));
+  EXPECT_EQ(regionContent(APP_FLASH_RAW_REGION_FILE_SYSTEM, kResourceSize),
+            server_.resource);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+  EXPECT_EQ(emulator_.statistics().num_erases, kResourceSize / 4096);
+}
+
+TEST_F(DownloadTest, ResumesAfterDroppedConnection) {
+  server_.drop_after = {10000, 20000};
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  // Everything which was received is stored, and is not requested again.
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({0, 10000, 30000}));
+  EXPECT_EQ(download_.num_resumes, 2u);
+  EXPECT_EQ(download_.stored_crc, crc(server_.resource));
+  EXPECT_EQ(regionContent(APP_FLASH_RAW_REGION_FILE_SYSTEM, kResourceSize),
+            server_.resource);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+}
+
+TEST_F(DownloadTest, RestartsWhenRangeIsIgnored) {
+  server_.supports_range = false;
+  server_.drop_after = {10000};
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({0, 10000}));
+  EXPECT_EQ(download_.stored_crc, crc(server_.resource));
+  EXPECT_EQ(regionContent(APP_FLASH_RAW_REGION_FILE_SYSTEM, kResourceSize),
+            server_.resource);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+}
+
+TEST_F(DownloadTest, ContinuesEarlierDownload) {
+  // NOTE: Connection is dropped at the page boundary, so the first request
+  // does not make progress once it failed.
+  server_.drop_after = vector<size_t>(1 + APP_CONFIG_DOWNLOAD_MAX_RETRIES, 0);
+  server_.drop_after[0] = 40 * APP_CONFIG_DOWNLOAD_PAGE_SIZE;
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  runUntilDone();
+  // No progress is made after the first request, module gives up.
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NETWORK);
+  EXPECT_EQ(server_.range_begins.size(),
+            1u + APP_CONFIG_DOWNLOAD_MAX_RETRIES);
+  const uint32_t num_bytes_stored = download_.num_bytes_stored;
+  EXPECT_EQ(num_bytes_stored, 40u * APP_CONFIG_DOWNLOAD_PAGE_SIZE);
+  // Checksum of the stored part is calculated from the flash.
+  const uint32_t expected_crc = crc(server_.resource);
+  server_.range_begins.clear();
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      num_bytes_stored,
+                                      &expected_crc,
+                                      nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({num_bytes_stored}));
+  EXPECT_EQ(download_.num_bytes_resumed, num_bytes_stored);
+  EXPECT_EQ(regionContent(APP_FLASH_RAW_REGION_FILE_SYSTEM, kResourceSize),
+            server_.resource);
+}
+
+TEST_F(DownloadTest, ChecksExpectedCRC) {
+  const uint32_t expected_crc = crc(server_.resource) ^ 1;
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      &expected_crc,
+                                      nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_INTEGRITY);
+}
+
+TEST_F(DownloadTest, DetectsCorruptedFlash) {
+  runUntilDone();
+  // Earlier download stored the beginning of the resource, but the rest of
+  // its erase block is not erased, so programming corrupts the data.
+  const uint32_t num_bytes_stored = 5000;
+  memcpy(emulator_.data(), server_.resource.data(), num_bytes_stored);
+  memset(emulator_.data() + num_bytes_stored, 0x00, 4096);
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      num_bytes_stored,
+                                      nullptr,
+                                      nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_INTEGRITY);
+  EXPECT_NE(emulator_.statistics().num_program_violations, 0u);
+}
+
+TEST_F(DownloadTest, RejectsTooLargeResource) {
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_SETTINGS,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_TOO_LARGE);
+  EXPECT_EQ(emulator_.statistics().num_bytes_programmed, 0u);
+}
+
+TEST_F(DownloadTest, Abort) {
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  while (download_.num_bytes_stored < 8192) {
+    APP_Timer_Tasks(&timer_wheel_);
+    server_.step();
+    APP_Download_Tasks(&download_);
+    APP_FlashRaw_Tasks(&flash_raw_);
+    emulator_.advanceToNextCompletion();
+  }
+  APP_Download_Abort(&download_);
+  EXPECT_FALSE(server_.isActive());
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_ABORTED);
+}
+
+TEST_F(DownloadTest, DownloadsIntoFile) {
+  const char* path = "/mnt/sst25_drive/resource.bin";
+  g_files[path] = vector<uint8_t>(100000, 0xaa);
+  ASSERT_TRUE(APP_Download_ToFile(&download_,
+                                  "https://example.com/resource",
+                                  path,
+                                  false,
+                                  nullptr,
+                                  nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  EXPECT_EQ(g_files[path], server_.resource);
+}
+
+TEST_F(DownloadTest, ResumesFile) {
+  const char* path = "/mnt/sst25_drive/resource.bin";
+  g_files[path] = vector<uint8_t>(server_.resource.begin(),
+                                  server_.resource.begin() + 12345);
+  const uint32_t expected_crc = crc(server_.resource);
+  ASSERT_TRUE(APP_Download_ToFile(&download_,
+                                  "https://example.com/resource",
+                                  path,
+                                  true,
+                                  &expected_crc,
+                                  nullptr));
+  runUntilDone();
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({12345}));
+  EXPECT_EQ(g_files[path], server_.resource);
+}
+
+// Network is slower than programming, but faster than programming and
+// erasing together. Pages are written while the next one is received, so
+// the download takes noticeably less than receiving and storing one after
+// another. Erase of the block is longer than it takes to fill both pages,
+// so network still has to wait for it.
+TEST_F(DownloadTest, LimitsRate) {
+  const uint32_t max_rate = 16 * 1024;
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  APP_Download_SetMaxRate(&download_, max_rate);
+  runUntilDone();
+  ASSERT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  EXPECT_EQ(regionContent(APP_FLASH_RAW_REGION_FILE_SYSTEM, kResourceSize),
+            server_.resource);
+  // NOTE: The first network buffer is allowed on top of the limit.
+  const uint32_t throughput = APP_Download_Throughput(&download_);
+  EXPECT_LE(throughput, max_rate * 102 / 100);
+  EXPECT_GT(throughput, max_rate * 9 / 10);
+  // Limit only applies to the download it was set for.
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  EXPECT_EQ(download_.max_rate, 0u);
+  APP_Download_Abort(&download_);
+  runUntilDone();
+}
+
+TEST_F(DownloadTest, OverlapsNetworkAndFlash) {
+  server_.resource = makeResource(256 * 1024);
+  runUntilDone();
+  emulator_.clearStatistics();
+  const uint64_t start_time = emulator_.time();
+  ASSERT_TRUE(APP_Download_ToFlashRaw(&download_,
+                                      "https://example.com/resource",
+                                      APP_FLASH_RAW_REGION_FILE_SYSTEM,
+                                      0,
+                                      nullptr,
+                                      nullptr));
+  runUntilDone();
+  ASSERT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_NONE);
+  const uint64_t network_time =
+      server_.chunk_time_ns * server_.resource.size() /
+      HTTPS_CLIENT_NETWORK_BUFFER_SIZE;
+  const uint64_t flash_time = emulator_.statistics().busy_time_ns;
+  const uint64_t total_time = emulator_.time() - start_time;
+  const uint32_t throughput = APP_Download_Throughput(&download_);
+  printf("Network %.1f ms, flash %.1f ms, total %.1f ms\n",
+         network_time / 1e6, flash_time / 1e6, total_time / 1e6);
+  printf("Throughput %u bytes/s, throttled %d%% of time, %u times\n",
+         throughput,
+         APP_Download_ThrottledPercent(&download_),
+         download_.num_throttles);
+  // NOTE: Verification read is included in the flash time.
+  EXPECT_LT(total_time, (network_time + flash_time) * 85 / 100);
+  EXPECT_GT(throughput,
+            server_.resource.size() * 1000000000ull / (network_time * 2));
+}
+
+}  // namespace NixieTracker
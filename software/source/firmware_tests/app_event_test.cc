@@ -0,0 +1,177 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <vector>
+
+extern "C" {
+#include "app_event.h"
+}
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+struct ReceivedEvent {
+  AppEventType type;
+  void* source;
+
+  bool operator==(const ReceivedEvent& other) const {
+    return type == other.type && source == other.source;
+  }
+};
+
+void recordEventCallback(const AppEvent* event, void* user_data) {
+  vector<ReceivedEvent>* events = static_cast<vector<ReceivedEvent>*>(user_data);
+  events->push_back({event->type, event->source});
+}
+
+void copyEventCallback(const AppEvent* event, void* user_data) {
+  static_cast<vector<AppEvent>*>(user_data)->push_back(*event);
+}
+
+}  // namespace
+
+TEST(AppEvent, Empty) {
+  AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  EXPECT_FALSE(APP_Event_HasPending(&app_event_bus));
+  APP_Event_Tasks(&app_event_bus);
+  EXPECT_FALSE(APP_Event_HasPending(&app_event_bus));
+}
+
+TEST(AppEvent, DeliveredInOrderToMatchingSubscribers) {
+  AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  vector<ReceivedEvent> rtc_events, all_events;
+  ASSERT_TRUE(APP_Event_Subscribe(&app_event_bus,
+                                  APP_EVENT_MASK(APP_EVENT_RTC_DONE),
+                                  recordEventCallback,
+                                  &rtc_events));
+  ASSERT_TRUE(APP_Event_Subscribe(&app_event_bus,
+                                  APP_EVENT_MASK(APP_EVENT_RTC_DONE) |
+                                  APP_EVENT_MASK(APP_EVENT_NIXIE_DONE),
+                                  recordEventCallback,
+                                  &all_events));
+  int source_a, source_b;
+  EXPECT_TRUE(APP_Event_Post(&app_event_bus, APP_EVENT_NIXIE_DONE, &source_a));
+  EXPECT_TRUE(APP_Event_Post(&app_event_bus, APP_EVENT_RTC_DONE, &source_b));
+  EXPECT_TRUE(APP_Event_Post(&app_event_bus,
+                             APP_EVENT_SHIFT_REGISTER_DONE,
+                             &source_a));
+  // Nothing is delivered until the bus tasks are run.
+  EXPECT_TRUE(all_events.empty());
+  EXPECT_TRUE(APP_Event_HasPending(&app_event_bus));
+  APP_Event_Tasks(&app_event_bus);
+  EXPECT_FALSE(APP_Event_HasPending(&app_event_bus));
+  EXPECT_EQ(rtc_events, (vector<ReceivedEvent>{
+                            {APP_EVENT_RTC_DONE, &source_b}}));
+  EXPECT_EQ(all_events, (vector<ReceivedEvent>{
+                            {APP_EVENT_NIXIE_DONE, &source_a},
+                            {APP_EVENT_RTC_DONE, &source_b}}));
+}
+
+TEST(AppEvent, FullQueueCoalescesEvents) {
+  AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  vector<ReceivedEvent> events;
+  APP_Event_Subscribe(&app_event_bus,
+                      APP_EVENT_MASK(APP_EVENT_FLASH_DONE) |
+                      APP_EVENT_MASK(APP_EVENT_RTC_DONE),
+                      recordEventCallback,
+                      &events);
+  for (int i = 0; i < APP_CONFIG_EVENT_QUEUE_SIZE; ++i) {
+    EXPECT_TRUE(APP_Event_Post(&app_event_bus, APP_EVENT_FLASH_DONE, NULL));
+  }
+  // Events which do not fit are coalesced by type, keeping the latest one.
+  int source_a, source_b;
+  EXPECT_FALSE(APP_Event_Post(&app_event_bus, APP_EVENT_RTC_DONE, &source_a));
+  EXPECT_FALSE(APP_Event_Post(&app_event_bus, APP_EVENT_FLASH_DONE, NULL));
+  EXPECT_FALSE(APP_Event_Post(&app_event_bus, APP_EVENT_RTC_DONE, &source_b));
+  EXPECT_EQ(app_event_bus.num_coalesced, 3);
+  APP_Event_Tasks(&app_event_bus);
+  EXPECT_FALSE(APP_Event_HasPending(&app_event_bus));
+  ASSERT_EQ(events.size(), size_t(APP_CONFIG_EVENT_QUEUE_SIZE + 2));
+  EXPECT_EQ(events[APP_CONFIG_EVENT_QUEUE_SIZE],
+            (ReceivedEvent{APP_EVENT_FLASH_DONE, NULL}));
+  EXPECT_EQ(events[APP_CONFIG_EVENT_QUEUE_SIZE + 1],
+            (ReceivedEvent{APP_EVENT_RTC_DONE, &source_b}));
+  // Queue is usable again after it was drained.
+  EXPECT_TRUE(APP_Event_Post(&app_event_bus, APP_EVENT_FLASH_DONE, NULL));
+  APP_Event_Tasks(&app_event_bus);
+  EXPECT_EQ(events.size(), size_t(APP_CONFIG_EVENT_QUEUE_SIZE + 3));
+}
+
+TEST(AppEvent, OverflowedEventIsNotMissedBySequence) {
+  AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  vector<AppEvent> events;
+  APP_Event_Subscribe(&app_event_bus,
+                      APP_EVENT_MASK(APP_EVENT_SHIFT_REGISTER_DONE),
+                      copyEventCallback,
+                      &events);
+  for (int i = 0; i < APP_CONFIG_EVENT_QUEUE_SIZE; ++i) {
+    APP_Event_Post(&app_event_bus, APP_EVENT_NIXIE_DONE, NULL);
+  }
+  // Consumer starts waiting for the operation when the queue is already full.
+  const uint32_t sequence = APP_Event_NextSequence(&app_event_bus);
+  APP_Event_Post(&app_event_bus, APP_EVENT_SHIFT_REGISTER_DONE, NULL);
+  APP_Event_Tasks(&app_event_bus);
+  ASSERT_EQ(events.size(), size_t(1));
+  EXPECT_TRUE(APP_Event_IsPostedSince(&events[0], sequence));
+}
+
+TEST(AppEvent, TooManySubscribers) {
+  AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  vector<ReceivedEvent> events;
+  for (int i = 0; i < APP_CONFIG_NUM_EVENT_SUBSCRIBERS; ++i) {
+    EXPECT_TRUE(APP_Event_Subscribe(&app_event_bus,
+                                    APP_EVENT_MASK(APP_EVENT_FLASH_DONE),
+                                    recordEventCallback,
+                                    &events));
+  }
+  EXPECT_FALSE(APP_Event_Subscribe(&app_event_bus,
+                                   APP_EVENT_MASK(APP_EVENT_FLASH_DONE),
+                                   recordEventCallback,
+                                   &events));
+}
+
+TEST(AppEvent, PostedSince) {
+  AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  // Make sure wrap around of the sequence is handled.
+  app_event_bus.next_sequence = 0xfffffffe;
+  APP_Event_Post(&app_event_bus, APP_EVENT_RTC_DONE, NULL);
+  const uint32_t sequence = APP_Event_NextSequence(&app_event_bus);
+  APP_Event_Post(&app_event_bus, APP_EVENT_RTC_DONE, NULL);
+  APP_Event_Post(&app_event_bus, APP_EVENT_RTC_DONE, NULL);
+  EXPECT_FALSE(APP_Event_IsPostedSince(&app_event_bus.queue[0], sequence));
+  EXPECT_TRUE(APP_Event_IsPostedSince(&app_event_bus.queue[1], sequence));
+  EXPECT_TRUE(APP_Event_IsPostedSince(&app_event_bus.queue[2], sequence));
+  EXPECT_EQ(app_event_bus.queue[2].sequence, 0);
+}
+
+}  // namespace NixieTracker
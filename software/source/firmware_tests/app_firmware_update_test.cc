@@ -0,0 +1,576 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sst25_emulator.h"
+
+extern "C" {
+#include "app_download.h"
+#include "app_event.h"
+#include "app_firmware_update.h"
+#include "app_flash_raw.h"
+#include "app_https_client.h"
+#include "app_timer.h"
+#include "crypto/crypto.h"
+}
+
+namespace NixieTracker {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+SST25Emulator* g_emulator = nullptr;
+
+// Server which replies to the requests of the download module, serving one
+// image.
+class FakeServer {
+ public:
+  FakeServer()
+      : chunk_time_ns(2560 * 1000),
+        is_active_(false),
+        position_(0),
+        end_position_(0) {
+    memset(&callbacks_, 0, sizeof(callbacks_));
+  }
+
+  void request(uint32_t range_begin, const AppHttpsClientCallbacks* callbacks) {
+    range_begins.push_back(range_begin);
+    callbacks_ = *callbacks;
+    const uint32_t size = image.size();
+    char headers[256];
+    if (range_begin != 0) {
+      snprintf(headers, sizeof(headers),
+               "HTTP/1.1 206 Partial Content\r\n"
+               "Content-Range: bytes %u-%u/%u\r\n"
+               "Content-Length: %u\r\n"
+               "\r\n",
+               range_begin, size - 1, size, size - range_begin);
+    } else {
+      snprintf(headers, sizeof(headers),
+               "HTTP/1.1 200 OK\r\n"
+               "Content-Length: %u\r\n"
+               "\r\n",
+               size);
+    }
+    response_.assign(headers, headers + strlen(headers));
+    const size_t num_header_bytes = response_.size();
+    response_.insert(response_.end(), image.begin() + range_begin, image.end());
+    position_ = 0;
+    end_position_ = response_.size();
+    if (!drop_after.empty()) {
+      end_position_ = std::min(end_position_,
+                               num_header_bytes + drop_after.front());
+      drop_after.erase(drop_after.begin());
+    }
+    is_active_ = true;
+  }
+
+  // Deliver the next buffer to the receiver, if it is ready for it.
+  //
+  // Returns false if nothing was delivered.
+  bool step() {
+    if (!is_active_) {
+      return false;
+    }
+    if (callbacks_.is_ready != nullptr &&
+        !callbacks_.is_ready(callbacks_.user_data)) {
+      return false;
+    }
+    const size_t num_bytes = std::min<size_t>(
+        HTTPS_CLIENT_NETWORK_BUFFER_SIZE, end_position_ - position_);
+    if (num_bytes != 0) {
+      g_emulator->advanceTime(chunk_time_ns * num_bytes /
+                              HTTPS_CLIENT_NETWORK_BUFFER_SIZE);
+      callbacks_.buffer_received(&response_[position_],
+                                 num_bytes,
+                                 callbacks_.user_data);
+      position_ += num_bytes;
+    }
+    if (position_ == response_.size()) {
+      is_active_ = false;
+      callbacks_.request_handled(callbacks_.user_data);
+    } else if (position_ == end_position_) {
+      abort();
+    }
+    return true;
+  }
+
+  void abort() {
+    if (!is_active_) {
+      return;
+    }
+    is_active_ = false;
+    callbacks_.error(callbacks_.user_data);
+  }
+
+  // Connection is gone together with the device, nobody is notified.
+  void disconnect() {
+    is_active_ = false;
+  }
+
+  bool isActive() const {
+    return is_active_;
+  }
+
+  vector<uint8_t> image;
+  // Time it takes the network to deliver the full buffer.
+  uint64_t chunk_time_ns;
+  // Number of body bytes after which every following request is dropped.
+  vector<size_t> drop_after;
+  // Range of every received request.
+  vector<uint32_t> range_begins;
+
+ private:
+  AppHttpsClientCallbacks callbacks_;
+  bool is_active_;
+  vector<uint8_t> response_;
+  size_t position_;
+  size_t end_position_;
+};
+
+FakeServer* g_server = nullptr;
+
+}  // namespace
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+// System timer follows time of the emulated flash, in microseconds.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  if (NixieTracker::g_emulator == nullptr) {
+    return 0;
+  }
+  return NixieTracker::g_emulator->time() / 1000;
+}
+
+bool APP_HTTPS_Client_RequestRange(
+    AppHTTPSClientData* /*app_https_client_data*/,
+    const char /*url*/[MAX_URL],
+    uint32_t range_begin,
+    const AppHttpsClientCallbacks* callbacks) {
+  NixieTracker::g_server->request(range_begin, callbacks);
+  return true;
+}
+
+bool APP_HTTPS_Client_IsBusy(AppHTTPSClientData* /*app_https_client_data*/) {
+  return NixieTracker::g_server->isActive();
+}
+
+void APP_HTTPS_Client_Abort(AppHTTPSClientData* /*app_https_client_data*/) {
+  NixieTracker::g_server->abort();
+}
+
+// Image only goes to the raw flash, file system is never touched.
+SYS_FS_HANDLE SYS_FS_FileOpen(const char* /*fname*/,
+                              SYS_FS_FILE_OPEN_ATTRIBUTES /*attributes*/) {
+  return SYS_FS_HANDLE_INVALID;
+}
+
+size_t SYS_FS_FileRead(SYS_FS_HANDLE /*handle*/,
+                       void* /*buf*/,
+                       size_t /*nbyte*/) {
+  return 0;
+}
+
+size_t SYS_FS_FileWrite(SYS_FS_HANDLE /*handle*/,
+                        const void* /*buf*/,
+                        size_t /*nbyte*/) {
+  return 0;
+}
+
+int32_t SYS_FS_FileSize(SYS_FS_HANDLE /*handle*/) {
+  return 0;
+}
+
+SYS_FS_RESULT SYS_FS_FileClose(SYS_FS_HANDLE /*handle*/) {
+  return SYS_FS_RES_SUCCESS;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+namespace {
+
+const char* kImageURL = "https://example.com/firmware.bin";
+const uint32_t kImageSize = 300 * 1024;
+
+typedef vector<uint8_t> Hash;
+
+Hash sha256(const vector<uint8_t>& data) {
+  CRYPT_SHA256_CTX context;
+  Hash hash(APP_FIRMWARE_UPDATE_HASH_SIZE);
+  CRYPT_SHA256_Initialize(&context);
+  CRYPT_SHA256_DataAdd(&context, data.data(), data.size());
+  CRYPT_SHA256_Finalize(&context, hash.data());
+  return hash;
+}
+
+class FirmwareUpdateTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(emulator_.open());
+    emulator_.activate();
+    g_emulator = &emulator_;
+    g_server = &server_;
+    server_.image = makeImage(kImageSize, 12345);
+    num_done_events_ = 0;
+    boot();
+  }
+
+  void TearDown() override {
+    g_server = nullptr;
+    g_emulator = nullptr;
+    emulator_.deactivate();
+  }
+
+  // Initialize all the modules the way it happens after reset, and wait for
+  // the state to be loaded.
+  void boot() {
+    APP_Timer_Initialize(&timer_wheel_);
+    APP_Event_Initialize(&event_bus_);
+    APP_Event_Subscribe(&event_bus_,
+                        APP_EVENT_MASK(APP_EVENT_FIRMWARE_UPDATE_DONE),
+                        doneCallback,
+                        this);
+    APP_FlashRaw_Initialize(&flash_raw_, &timer_wheel_);
+    APP_Download_Initialize(&download_,
+                            nullptr,
+                            &flash_raw_,
+                            &timer_wheel_,
+                            &event_bus_);
+    APP_FirmwareUpdate_Initialize(&firmware_update_,
+                                  &flash_raw_,
+                                  &download_,
+                                  &event_bus_);
+    runUntilIdle();
+  }
+
+  // Power is lost: commands which are submitted to the flash finish, but
+  // nothing else happens.
+  void powerLoss() {
+    server_.disconnect();
+    emulator_.runUntilIdle();
+  }
+
+  static vector<uint8_t> makeImage(size_t size, uint32_t seed) {
+    vector<uint8_t> image(size);
+    uint32_t state = seed;
+    for (size_t i = 0; i < size; ++i) {
+      state = state * 1103515245 + 12345;
+      image[i] = state >> 16;
+    }
+    return image;
+  }
+
+  static void doneCallback(const AppEvent* /*event*/, void* user_data) {
+    ++static_cast<FirmwareUpdateTest*>(user_data)->num_done_events_;
+  }
+
+  bool isBusy() {
+    return APP_FirmwareUpdate_IsBusy(&firmware_update_) ||
+           APP_Download_IsBusy(&download_) ||
+           APP_FlashRaw_IsBusy(&flash_raw_);
+  }
+
+  // Run the main loop until the predicate is true.
+  //
+  // Time advances while the network delivers data, and skips to the next
+  // completion of the flash command when nothing else can happen.
+  template <typename Predicate>
+  bool runUntil(Predicate predicate) {
+    for (int i = 0; i < 10000000; ++i) {
+      APP_Timer_Tasks(&timer_wheel_);
+      APP_Event_Tasks(&event_bus_);
+      const bool is_delivered = server_.step();
+      if (APP_Download_IsRunnable(&download_)) {
+        APP_Download_Tasks(&download_);
+      }
+      if (APP_FirmwareUpdate_IsRunnable(&firmware_update_)) {
+        APP_FirmwareUpdate_Tasks(&firmware_update_);
+      }
+      if (APP_FlashRaw_IsRunnable(&flash_raw_)) {
+        APP_FlashRaw_Tasks(&flash_raw_);
+      }
+      if (predicate()) {
+        return true;
+      }
+      if (!is_delivered) {
+        if (emulator_.isBusy()) {
+          emulator_.advanceToNextCompletion();
+        } else {
+          emulator_.advanceTime(100 * 1000);
+        }
+      }
+    }
+    return false;
+  }
+
+  void runUntilIdle() {
+    APP_Event_Tasks(&event_bus_);
+    EXPECT_TRUE(runUntil([this] { return !isBusy(); }))
+        << "Firmware update did not finish";
+    APP_Event_Tasks(&event_bus_);
+  }
+
+  bool start(const Hash& hash) {
+    return APP_FirmwareUpdate_Start(&firmware_update_,
+                                    kImageURL,
+                                    hash.data());
+  }
+
+  vector<uint8_t> stagedImage(size_t size) {
+    const uint8_t* data = emulator_.data() +
+        flash_raw_.region_address[APP_FLASH_RAW_REGION_FIRMWARE];
+    return vector<uint8_t>(data, data + size);
+  }
+
+  SST25Emulator emulator_;
+  FakeServer server_;
+  AppTimerWheel timer_wheel_;
+  AppEventBus event_bus_;
+  AppFlashRawData flash_raw_;
+  AppDownloadData download_;
+  AppFirmwareUpdateData firmware_update_;
+  int num_done_events_;
+};
+
+}  // namespace
+
+TEST(FirmwareUpdateHashTest, MatchesKnownVector) {
+  const char* text = "abc";
+  const Hash hash = sha256(vector<uint8_t>(text, text + 3));
+  const Hash expected = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+    0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+    0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+  };
+  EXPECT_EQ(hash, expected);
+}
+
+TEST_F(FirmwareUpdateTest, StartsWithoutImage) {
+  EXPECT_EQ(firmware_update_.state, APP_FIRMWARE_UPDATE_STATE_IDLE);
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_NONE);
+  EXPECT_EQ(firmware_update_.num_records_loaded, 0u);
+  EXPECT_FALSE(APP_FirmwareUpdate_Apply(&firmware_update_));
+}
+
+TEST_F(FirmwareUpdateTest, StagesImage) {
+  const Hash hash = sha256(server_.image);
+  ASSERT_TRUE(start(hash));
+  EXPECT_FALSE(start(hash));
+  runUntilIdle();
+  EXPECT_EQ(APP_FirmwareUpdate_Error(&firmware_update_),
+            APP_FIRMWARE_UPDATE_ERROR_NONE);
+  EXPECT_EQ(num_done_events_, 1);
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  EXPECT_EQ(firmware_update_.image_size, kImageSize);
+  EXPECT_EQ(stagedImage(kImageSize), server_.image);
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({0}));
+  EXPECT_EQ(firmware_update_.num_checkpoints,
+            kImageSize / APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+  // State survives the reset.
+  boot();
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  EXPECT_EQ(firmware_update_.image_size, kImageSize);
+  EXPECT_EQ(Hash(firmware_update_.hash,
+                 firmware_update_.hash + APP_FIRMWARE_UPDATE_HASH_SIZE),
+            hash);
+  EXPECT_STREQ(firmware_update_.url, kImageURL);
+}
+
+TEST_F(FirmwareUpdateTest, ResumesAfterDroppedConnection) {
+  server_.drop_after = {50000, 100000};
+  ASSERT_TRUE(start(sha256(server_.image)));
+  runUntilIdle();
+  EXPECT_EQ(APP_FirmwareUpdate_Error(&firmware_update_),
+            APP_FIRMWARE_UPDATE_ERROR_NONE);
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({0, 50000, 150000}));
+  EXPECT_EQ(stagedImage(kImageSize), server_.image);
+}
+
+TEST_F(FirmwareUpdateTest, ResumesAfterReboot) {
+  const Hash hash = sha256(server_.image);
+  ASSERT_TRUE(start(hash));
+  // Lose power once the second checkpoint is written and some data past it
+  // is stored.
+  const uint32_t checkpoint =
+      2 * APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL;
+  ASSERT_TRUE(runUntil([this, checkpoint] {
+    return firmware_update_.num_records_written == 3 &&
+           download_.num_bytes_stored > checkpoint + 10000;
+  }));
+  powerLoss();
+  boot();
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_DOWNLOADING);
+  EXPECT_EQ(firmware_update_.num_bytes_stored, checkpoint);
+  EXPECT_EQ(firmware_update_.num_records_loaded, 3u);
+  // Same image continues from the checkpoint, stored part is read back to
+  // restore the hash.
+  ASSERT_TRUE(start(hash));
+  runUntilIdle();
+  EXPECT_EQ(APP_FirmwareUpdate_Error(&firmware_update_),
+            APP_FIRMWARE_UPDATE_ERROR_NONE);
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  EXPECT_EQ(server_.range_begins, vector<uint32_t>({0, checkpoint}));
+  EXPECT_EQ(stagedImage(kImageSize), server_.image);
+  // Data stored past the checkpoint is erased before it is written again.
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+}
+
+TEST_F(FirmwareUpdateTest, DoesNotResumeOtherImage) {
+  ASSERT_TRUE(start(sha256(server_.image)));
+  ASSERT_TRUE(runUntil([this] {
+    return firmware_update_.num_checkpoints == 1 &&
+           !firmware_update_.is_dirty && !firmware_update_.is_writing;
+  }));
+  powerLoss();
+  boot();
+  ASSERT_EQ(firmware_update_.num_bytes_stored,
+            APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL);
+  server_.image = makeImage(kImageSize, 1);
+  ASSERT_TRUE(start(sha256(server_.image)));
+  runUntilIdle();
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  EXPECT_EQ(server_.range_begins.back(), 0u);
+  EXPECT_EQ(stagedImage(kImageSize), server_.image);
+}
+
+TEST_F(FirmwareUpdateTest, RejectsHashMismatch) {
+  Hash hash = sha256(server_.image);
+  hash[0] ^= 1;
+  ASSERT_TRUE(start(hash));
+  runUntilIdle();
+  EXPECT_EQ(APP_FirmwareUpdate_Error(&firmware_update_),
+            APP_FIRMWARE_UPDATE_ERROR_HASH);
+  EXPECT_EQ(num_done_events_, 1);
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_NONE);
+  EXPECT_FALSE(APP_FirmwareUpdate_Apply(&firmware_update_));
+  boot();
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_NONE);
+}
+
+TEST_F(FirmwareUpdateTest, KeepsCheckpointOnAbort) {
+  ASSERT_TRUE(start(sha256(server_.image)));
+  ASSERT_TRUE(runUntil([this] {
+    return download_.num_bytes_stored >
+           APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL + 20000;
+  }));
+  APP_FirmwareUpdate_Abort(&firmware_update_);
+  runUntilIdle();
+  EXPECT_EQ(APP_FirmwareUpdate_Error(&firmware_update_),
+            APP_FIRMWARE_UPDATE_ERROR_DOWNLOAD);
+  EXPECT_EQ(APP_Download_Error(&download_), APP_DOWNLOAD_ERROR_ABORTED);
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_DOWNLOADING);
+  // Progress is rounded down to the erase block.
+  EXPECT_EQ(firmware_update_.num_bytes_stored % 4096, 0u);
+  EXPECT_GT(firmware_update_.num_bytes_stored,
+            APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL);
+  boot();
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_DOWNLOADING);
+  EXPECT_GT(firmware_update_.num_bytes_stored,
+            APP_CONFIG_FIRMWARE_UPDATE_CHECKPOINT_INTERVAL);
+}
+
+TEST_F(FirmwareUpdateTest, HandsOverToBootloader) {
+  const Hash hash = sha256(server_.image);
+  ASSERT_TRUE(start(hash));
+  runUntilIdle();
+  ASSERT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  ASSERT_TRUE(APP_FirmwareUpdate_Apply(&firmware_update_));
+  EXPECT_FALSE(APP_FirmwareUpdate_Apply(&firmware_update_));
+  runUntilIdle();
+  EXPECT_EQ(APP_FirmwareUpdate_Error(&firmware_update_),
+            APP_FIRMWARE_UPDATE_ERROR_NONE);
+  EXPECT_EQ(num_done_events_, 2);
+  // This is what the bootloader sees.
+  boot();
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_APPLY);
+  EXPECT_EQ(firmware_update_.image_size, kImageSize);
+  EXPECT_EQ(Hash(firmware_update_.hash,
+                 firmware_update_.hash + APP_FIRMWARE_UPDATE_HASH_SIZE),
+            sha256(stagedImage(firmware_update_.image_size)));
+}
+
+TEST_F(FirmwareUpdateTest, LogRollsOverStateBlocks) {
+  server_.image = makeImage(1024, 1);
+  const Hash hash = sha256(server_.image);
+  const uint32_t num_slots = APP_CONFIG_FLASH_FIRMWARE_STATE_NUM_BLOCKS *
+                             4096 / APP_FIRMWARE_UPDATE_RECORD_SIZE;
+  uint32_t num_records = 0;
+  // Every update writes downloading and staged records, with reboots in
+  // between to continue the log after the last record.
+  for (int i = 0; num_records < num_slots * 2; ++i) {
+    ASSERT_TRUE(start(hash));
+    runUntilIdle();
+    ASSERT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+    num_records += 2;
+    if (i % 5 == 4) {
+      boot();
+      ASSERT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+      ASSERT_EQ(firmware_update_.sequence, num_records);
+    }
+  }
+  boot();
+  EXPECT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  EXPECT_EQ(firmware_update_.sequence, num_records);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+}
+
+TEST_F(FirmwareUpdateTest, BoundsRateAndMemory) {
+  const uint64_t start_time = emulator_.time();
+  ASSERT_TRUE(start(sha256(server_.image)));
+  runUntilIdle();
+  ASSERT_EQ(firmware_update_.status, APP_FIRMWARE_UPDATE_STATUS_STAGED);
+  const uint32_t throughput = APP_Download_Throughput(&download_);
+  const size_t memory = sizeof(firmware_update_) + sizeof(download_);
+  printf("Image of %u bytes staged in %.1f ms, %u bytes/s, "
+         "%u bytes of RAM\n",
+         kImageSize,
+         (emulator_.time() - start_time) / 1e6,
+         throughput,
+         static_cast<unsigned>(memory));
+  // NOTE: The first network buffer is allowed on top of the limit.
+  EXPECT_LE(throughput, APP_CONFIG_FIRMWARE_UPDATE_MAX_RATE * 102 / 100);
+  EXPECT_GT(throughput, APP_CONFIG_FIRMWARE_UPDATE_MAX_RATE * 9 / 10);
+  // Everything is static, RAM does not depend on the image size.
+  EXPECT_LT(memory, 4096u);
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,426 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "sst25_emulator.h"
+
+extern "C" {
+#include "app_event.h"
+#include "app_flash_cache.h"
+}
+
+DEFINE_int32(flash_cache_benchmark_kb, 64,
+             "Size of the file written by the cache benchmark");
+DEFINE_string(flash_cache_benchmark_image, "",
+              "Image file of the flash which is kept after the benchmark");
+
+namespace NixieTracker {
+
+namespace {
+
+SST25Emulator* g_emulator = nullptr;
+
+}  // namespace
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+// System timer follows time of the emulated flash, in microseconds.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  if (NixieTracker::g_emulator == nullptr) {
+    return 0;
+  }
+  return NixieTracker::g_emulator->time() / 1000;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+const uint32_t kSectorSize = APP_FLASH_CACHE_LINE_SIZE;
+const uint32_t kEraseBlockSize = 4096;
+const uint32_t kSectorsPerEraseBlock = kEraseBlockSize / kSectorSize;
+const AppFlashCacheDriverHandle kDriverHandle = 1;
+// Time the file system spends between media tasks while it waits.
+const uint64_t kMediaLoopNs = 10 * 1000;
+
+vector<uint8_t> makeSector(uint32_t seed) {
+  vector<uint8_t> sector(kSectorSize);
+  for (uint32_t i = 0; i < kSectorSize; ++i) {
+    sector[i] = (seed * 131 + i * 7) & 0xff;
+  }
+  return sector;
+}
+
+class FlashCacheTest : public ::testing::Test {
+ protected:
+  enum RequestType {
+    REQUEST_READ,
+    REQUEST_WRITE,
+  };
+
+  void SetUp() override {
+    ASSERT_TRUE(emulator_.open());
+    emulator_.activate();
+    g_emulator = &emulator_;
+    APP_Event_Initialize(&event_bus_);
+    APP_Event_Subscribe(&event_bus_,
+                        APP_EVENT_MASK(APP_EVENT_FLASH_DONE),
+                        flashDoneCallback,
+                        this);
+    APP_FlashCache_Initialize(&cache_, &event_bus_);
+    APP_FlashCache_MediaEventHandlerSet(
+        kDriverHandle,
+        reinterpret_cast<const void*>(mediaEventHandler),
+        reinterpret_cast<uintptr_t>(this));
+    num_flash_done_events_ = 0;
+  }
+
+  void TearDown() override {
+    g_emulator = nullptr;
+    emulator_.deactivate();
+  }
+
+  static void flashDoneCallback(const AppEvent* /*event*/, void* user_data) {
+    ++static_cast<FlashCacheTest*>(user_data)->num_flash_done_events_;
+  }
+
+  static void mediaEventHandler(
+      SYS_FS_MEDIA_BLOCK_EVENT event,
+      SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE command_handle,
+      uintptr_t context) {
+    FlashCacheTest* test = reinterpret_cast<FlashCacheTest*>(context);
+    EXPECT_EQ(command_handle, test->pending_handle_);
+    test->has_media_event_ = true;
+    test->media_event_ = event;
+  }
+
+  // Perform request the way the media manager does it while the file system
+  // is blocked on it: submit and keep calling media tasks until the event
+  // arrives. Block size of the emulated flash is a byte.
+  bool transfer(RequestType type,
+                uint32_t address,
+                uint8_t* buffer,
+                uint32_t num_bytes) {
+    AppFlashCacheCommandHandle handle;
+    has_media_event_ = false;
+    switch (type) {
+      case REQUEST_READ:
+        APP_FlashCache_MediaRead(kDriverHandle, &handle,
+                                 buffer, address, num_bytes);
+        break;
+      case REQUEST_WRITE:
+        APP_FlashCache_MediaWrite(kDriverHandle, &handle,
+                                  buffer, address, num_bytes);
+        break;
+    }
+    if (handle == SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE_INVALID) {
+      return false;
+    }
+    pending_handle_ = handle;
+    for (int i = 0; i < 100000; ++i) {
+      APP_FlashCache_MediaTasks(0);
+      if (has_media_event_) {
+        EXPECT_NE(APP_FlashCache_MediaCommandStatus(kDriverHandle, handle),
+                  SYS_FS_MEDIA_COMMAND_IN_PROGRESS);
+        return media_event_ == SYS_FS_MEDIA_EVENT_BLOCK_COMMAND_COMPLETE;
+      }
+      EXPECT_NE(APP_FlashCache_MediaCommandStatus(kDriverHandle, handle),
+                SYS_FS_MEDIA_COMMAND_COMPLETED);
+      emulator_.advanceTime(kMediaLoopNs);
+    }
+    ADD_FAILURE() << "Request did not finish";
+    return false;
+  }
+
+  bool readSector(uint32_t sector, vector<uint8_t>* data) {
+    data->resize(kSectorSize);
+    return transfer(REQUEST_READ, sector * kSectorSize,
+                    data->data(), kSectorSize);
+  }
+
+  bool writeSector(uint32_t sector, vector<uint8_t> data) {
+    return transfer(REQUEST_WRITE, sector * kSectorSize,
+                    data.data(), kSectorSize);
+  }
+
+  // Run the main loop for the given time, sleeping until deadlines of the
+  // cache when it has nothing to do.
+  void runMainLoop(uint64_t duration_ms) {
+    const uint64_t end_time = emulator_.time() + duration_ms * 1000000;
+    for (int i = 0; i < 100000 && emulator_.time() < end_time; ++i) {
+      APP_Event_Tasks(&event_bus_);
+      uint64_t next_deadline = UINT64_MAX;
+      if (APP_FlashCache_IsRunnable(&cache_, &next_deadline)) {
+        APP_FlashCache_Tasks(&cache_);
+        emulator_.advanceToNextCompletion();
+        continue;
+      }
+      uint64_t next_time = end_time;
+      if (next_deadline != UINT64_MAX) {
+        next_time = std::min(next_time, next_deadline * 1000);
+      }
+      emulator_.advanceTime(std::max<uint64_t>(next_time - emulator_.time(),
+                                               kMediaLoopNs));
+    }
+    APP_Event_Tasks(&event_bus_);
+  }
+
+  // Run until dirty lines are written by the idle flush.
+  void runUntilFlushed() {
+    runMainLoop(APP_CONFIG_FLASH_CACHE_FLUSH_DELAY + 1000);
+    EXPECT_FALSE(APP_FlashCache_IsDirty(&cache_));
+    EXPECT_FALSE(APP_FlashCache_IsBusy(&cache_));
+  }
+
+  const uint8_t* flashSector(uint32_t sector) const {
+    return emulator_.data() + sector * kSectorSize;
+  }
+
+  SST25Emulator emulator_;
+  AppEventBus event_bus_;
+  AppFlashCacheData cache_;
+  int num_flash_done_events_;
+
+  SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE pending_handle_;
+  bool has_media_event_;
+  SYS_FS_MEDIA_BLOCK_EVENT media_event_;
+};
+
+}  // namespace
+
+TEST_F(FlashCacheTest, ReadHit) {
+  const vector<uint8_t> data = makeSector(10);
+  memcpy(emulator_.data() + 10 * kSectorSize, data.data(), kSectorSize);
+  vector<uint8_t> read_data;
+  EXPECT_TRUE(readSector(10, &read_data));
+  EXPECT_EQ(read_data, data);
+  EXPECT_EQ(emulator_.statistics().num_bytes_read, kSectorSize);
+  read_data.clear();
+  EXPECT_TRUE(readSector(10, &read_data));
+  EXPECT_EQ(read_data, data);
+  EXPECT_EQ(emulator_.statistics().num_bytes_read, kSectorSize);
+  EXPECT_EQ(cache_.num_read_hits, 1u);
+  EXPECT_EQ(cache_.num_read_misses, 1u);
+  EXPECT_EQ(APP_FlashCache_ReadHitRate(&cache_), 50);
+}
+
+TEST_F(FlashCacheTest, ReadAfterWrite) {
+  const vector<uint8_t> data = makeSector(3);
+  EXPECT_TRUE(writeSector(3, data));
+  EXPECT_TRUE(APP_FlashCache_IsDirty(&cache_));
+  // Nothing is written to the flash until it is idle for a while.
+  EXPECT_EQ(emulator_.statistics().num_commands, 0u);
+  vector<uint8_t> read_data;
+  EXPECT_TRUE(readSector(3, &read_data));
+  EXPECT_EQ(read_data, data);
+  // Partial read goes to the flash, and sees cached data.
+  uint8_t bytes[100];
+  EXPECT_TRUE(transfer(REQUEST_READ, 3 * kSectorSize + 460,
+                       bytes, sizeof(bytes)));
+  EXPECT_EQ(memcmp(bytes, data.data() + 460, 52), 0);
+  EXPECT_EQ(bytes[52], 0xff);
+  runUntilFlushed();
+  EXPECT_EQ(memcmp(flashSector(3), data.data(), kSectorSize), 0);
+  EXPECT_EQ(emulator_.statistics().num_erases, 1u);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+}
+
+TEST_F(FlashCacheTest, WritesAreCoalesced) {
+  // Whole erase block, sector by sector, some of them twice, plus a sector
+  // of another block.
+  for (uint32_t i = 0; i < kSectorsPerEraseBlock; ++i) {
+    EXPECT_TRUE(writeSector(2 * kSectorsPerEraseBlock + i, makeSector(i)));
+  }
+  EXPECT_TRUE(writeSector(2 * kSectorsPerEraseBlock, makeSector(100)));
+  EXPECT_TRUE(writeSector(2 * kSectorsPerEraseBlock + 1, makeSector(101)));
+  EXPECT_TRUE(writeSector(5 * kSectorsPerEraseBlock + 3, makeSector(5)));
+  runUntilFlushed();
+  EXPECT_EQ(emulator_.statistics().num_erases, 2u);
+  EXPECT_EQ(emulator_.eraseCount(2), 1u);
+  EXPECT_EQ(emulator_.eraseCount(5), 1u);
+  EXPECT_EQ(cache_.num_flushes, 2u);
+  EXPECT_EQ(cache_.num_lines_flushed, kSectorsPerEraseBlock + 1);
+  EXPECT_EQ(memcmp(flashSector(2 * kSectorsPerEraseBlock),
+                   makeSector(100).data(), kSectorSize), 0);
+  EXPECT_EQ(memcmp(flashSector(2 * kSectorsPerEraseBlock + 2),
+                   makeSector(2).data(), kSectorSize), 0);
+  EXPECT_EQ(memcmp(flashSector(5 * kSectorsPerEraseBlock + 3),
+                   makeSector(5).data(), kSectorSize), 0);
+  // Rest of the erase block is kept.
+  EXPECT_EQ(flashSector(5 * kSectorsPerEraseBlock + 2)[0], 0xff);
+}
+
+TEST_F(FlashCacheTest, FlushOnDemand) {
+  EXPECT_TRUE(writeSector(7, makeSector(7)));
+  APP_FlashCache_Flush(&cache_);
+  // Much shorter than the idle delay.
+  runMainLoop(100);
+  EXPECT_FALSE(APP_FlashCache_IsDirty(&cache_));
+  EXPECT_EQ(num_flash_done_events_, 1);
+  EXPECT_EQ(memcmp(flashSector(7), makeSector(7).data(), kSectorSize), 0);
+}
+
+TEST_F(FlashCacheTest, FlushFailure) {
+  EXPECT_TRUE(writeSector(7, makeSector(7)));
+  emulator_.setNumFailingCommands(2);
+  APP_FlashCache_Flush(&cache_);
+  runMainLoop(100);
+  // Requester learns about the failure, data is kept.
+  EXPECT_EQ(num_flash_done_events_, 1);
+  EXPECT_TRUE(APP_FlashCache_IsDirty(&cache_));
+  EXPECT_EQ(cache_.num_errors, 1u);
+  // Flush is attempted again after a while.
+  runMainLoop(APP_CONFIG_FLASH_CACHE_FLUSH_DELAY + 1000);
+  EXPECT_TRUE(APP_FlashCache_IsDirty(&cache_));
+  EXPECT_EQ(cache_.num_errors, 2u);
+  runUntilFlushed();
+  EXPECT_EQ(memcmp(flashSector(7), makeSector(7).data(), kSectorSize), 0);
+}
+
+TEST_F(FlashCacheTest, Invalidate) {
+  EXPECT_TRUE(writeSector(7, makeSector(7)));
+  APP_FlashCache_Invalidate(&cache_);
+  EXPECT_FALSE(APP_FlashCache_IsDirty(&cache_));
+  vector<uint8_t> read_data;
+  EXPECT_TRUE(readSector(7, &read_data));
+  EXPECT_EQ(read_data, vector<uint8_t>(kSectorSize, 0xff));
+}
+
+// Random reads and writes over a few erase blocks, more sectors than there
+// are lines in the cache, compared against a plain copy of the data.
+TEST_F(FlashCacheTest, RandomAccess) {
+  const uint32_t num_sectors = 8 * kSectorsPerEraseBlock;
+  vector<vector<uint8_t>> expected(num_sectors,
+                                   vector<uint8_t>(kSectorSize, 0xff));
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<uint32_t> random_sector(0, num_sectors - 1);
+  std::uniform_int_distribution<int> random_action(0, 9);
+  for (int i = 0; i < 2000; ++i) {
+    const uint32_t sector = random_sector(rng);
+    const int action = random_action(rng);
+    if (action < 5) {
+      vector<uint8_t> read_data;
+      ASSERT_TRUE(readSector(sector, &read_data));
+      ASSERT_EQ(read_data, expected[sector]) << "Sector " << sector;
+    } else if (action < 9) {
+      expected[sector] = makeSector(i);
+      ASSERT_TRUE(writeSector(sector, expected[sector]));
+    } else {
+      runMainLoop(APP_CONFIG_FLASH_CACHE_FLUSH_DELAY / 2);
+    }
+  }
+  runUntilFlushed();
+  for (uint32_t sector = 0; sector < num_sectors; ++sector) {
+    EXPECT_EQ(memcmp(flashSector(sector), expected[sector].data(),
+                     kSectorSize), 0) << "Sector " << sector;
+  }
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+  EXPECT_EQ(cache_.num_errors, 0u);
+}
+
+// Append to a file the way FAT does it when the file is synced after every
+// sector: data sector is written, then FAT sector and directory entry are
+// read and written back. Compares flash traffic with the cache and with
+// the driver being used directly, as it was before the cache.
+TEST_F(FlashCacheTest, BenchmarkFileAppend) {
+  if (!FLAGS_flash_cache_benchmark_image.empty()) {
+    ASSERT_TRUE(emulator_.open(FLAGS_flash_cache_benchmark_image));
+    emulator_.eraseAll();
+  }
+  const uint32_t kFATSector = 1;
+  const uint32_t kDirectorySector = 13;
+  const uint32_t kFirstDataSector = 45;
+  const uint32_t num_data_sectors =
+      FLAGS_flash_cache_benchmark_kb * 1024 / kSectorSize;
+  const vector<uint8_t> data = makeSector(1);
+
+  // Direct use of the driver, every sector write erases its block.
+  uint64_t start_time = emulator_.time();
+  for (uint32_t i = 0; i < num_data_sectors; ++i) {
+    const uint32_t sectors[] = {kFirstDataSector + i,
+                                kFATSector,
+                                kDirectorySector};
+    for (uint32_t sector : sectors) {
+      emulator_.submitEraseWrite(data.data(), sector * kSectorSize,
+                                 kSectorSize);
+      emulator_.runUntilIdle();
+    }
+  }
+  const double direct_time_s = (emulator_.time() - start_time) / 1e9;
+  const uint32_t direct_erases = emulator_.statistics().num_erases;
+  const uint32_t direct_max_erases = emulator_.maxEraseCount();
+
+  emulator_.clearStatistics();
+  emulator_.eraseAll();
+  vector<uint32_t> base_erase_counts(emulator_.numEraseBlocks());
+  for (uint32_t block = 0; block < base_erase_counts.size(); ++block) {
+    base_erase_counts[block] = emulator_.eraseCount(block);
+  }
+  start_time = emulator_.time();
+  vector<uint8_t> sector_data;
+  for (uint32_t i = 0; i < num_data_sectors; ++i) {
+    ASSERT_TRUE(writeSector(kFirstDataSector + i, data));
+    ASSERT_TRUE(readSector(kFATSector, &sector_data));
+    ASSERT_TRUE(writeSector(kFATSector, data));
+    ASSERT_TRUE(readSector(kDirectorySector, &sector_data));
+    ASSERT_TRUE(writeSector(kDirectorySector, data));
+  }
+  const double cached_time_s = (emulator_.time() - start_time) / 1e9;
+  runUntilFlushed();
+  const uint32_t cached_erases = emulator_.statistics().num_erases;
+  uint32_t cached_max_erases = 0;
+  for (uint32_t block = 0; block < base_erase_counts.size(); ++block) {
+    cached_max_erases = std::max(
+        cached_max_erases,
+        emulator_.eraseCount(block) - base_erase_counts[block]);
+  }
+
+  const double num_kb = num_data_sectors * kSectorSize / 1024.0;
+  LOG(INFO) << "Direct: " << num_kb / direct_time_s << " KB/s, "
+            << direct_erases << " erases, "
+            << direct_max_erases << " erases of the most worn block.";
+  LOG(INFO) << "Cached: " << num_kb / cached_time_s << " KB/s, "
+            << cached_erases << " erases, "
+            << cached_max_erases << " erases of the most worn block, "
+            << APP_FlashCache_ReadHitRate(&cache_) << "% read hit rate.";
+  EXPECT_LT(cached_erases * 4, direct_erases);
+  EXPECT_LT(cached_max_erases * 4, direct_max_erases);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,269 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <cstring>
+#include <vector>
+
+#include "sst25_emulator.h"
+
+extern "C" {
+#include "app_flash_raw.h"
+#include "app_timer.h"
+}
+
+namespace NixieTracker {
+
+namespace {
+
+SST25Emulator* g_emulator = nullptr;
+
+}  // namespace
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+// System timer follows time of the emulated flash, in microseconds.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  if (NixieTracker::g_emulator == nullptr) {
+    return 0;
+  }
+  return NixieTracker::g_emulator->time() / 1000;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+const uint32_t kEraseBlockSize = 4096;
+
+// Callback which records success of every finished operation.
+void recordCompletionCallback(bool success, void* user_data) {
+  static_cast<vector<bool>*>(user_data)->push_back(success);
+}
+
+class FlashRawTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(emulator_.open());
+    emulator_.activate();
+    g_emulator = &emulator_;
+    APP_Timer_Initialize(&timer_wheel_);
+    APP_FlashRaw_Initialize(&flash_raw_, &timer_wheel_);
+  }
+
+  void TearDown() override {
+    g_emulator = nullptr;
+    emulator_.deactivate();
+  }
+
+  // Run the main loop until there is nothing to do, advancing time to the
+  // next event when the module waits.
+  void runUntilIdle() {
+    for (int i = 0; i < 10000; ++i) {
+      APP_Timer_Tasks(&timer_wheel_);
+      if (APP_FlashRaw_IsRunnable(&flash_raw_)) {
+        APP_FlashRaw_Tasks(&flash_raw_);
+        // Module polls the driver while command is in progress, skip the
+        // time until it is over.
+        emulator_.advanceToNextCompletion();
+        continue;
+      }
+      if (flash_raw_.state == APP_FLASH_RAW_STATE_OPEN) {
+        emulator_.advanceTime(1000 * 1000);
+      } else {
+        return;
+      }
+    }
+    ADD_FAILURE() << "Raw flash did not become idle";
+  }
+
+  uint32_t regionAddress(AppFlashRawRegion region) const {
+    return flash_raw_.region_address[region];
+  }
+
+  SST25Emulator emulator_;
+  AppTimerWheel timer_wheel_;
+  AppFlashRawData flash_raw_;
+};
+
+}  // namespace
+
+TEST_F(FlashRawTest, RegionsLayout) {
+  emulator_.setNumFailingOpens(3);
+  runUntilIdle();
+  ASSERT_TRUE(APP_FlashRaw_IsReady(&flash_raw_));
+  const uint32_t size = emulator_.geometry().size;
+  const uint32_t firmware_size =
+      APP_CONFIG_FLASH_FIRMWARE_NUM_BLOCKS * kEraseBlockSize;
+  const uint32_t firmware_state_size =
+      APP_CONFIG_FLASH_FIRMWARE_STATE_NUM_BLOCKS * kEraseBlockSize;
+  const uint32_t history_size =
+      APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS * kEraseBlockSize;
+  const uint32_t settings_size =
+      APP_CONFIG_FLASH_SETTINGS_NUM_BLOCKS * kEraseBlockSize;
+  const uint32_t file_system_size = size - firmware_size -
+                                    firmware_state_size - history_size -
+                                    settings_size;
+  EXPECT_EQ(regionAddress(APP_FLASH_RAW_REGION_FILE_SYSTEM), 0u);
+  EXPECT_EQ(APP_FlashRaw_RegionSize(&flash_raw_,
+                                    APP_FLASH_RAW_REGION_FILE_SYSTEM),
+            file_system_size);
+  EXPECT_EQ(regionAddress(APP_FLASH_RAW_REGION_FIRMWARE), file_system_size);
+  EXPECT_EQ(APP_FlashRaw_RegionSize(&flash_raw_,
+                                    APP_FLASH_RAW_REGION_FIRMWARE),
+            firmware_size);
+  EXPECT_EQ(regionAddress(APP_FLASH_RAW_REGION_FIRMWARE_STATE),
+            file_system_size + firmware_size);
+  EXPECT_EQ(APP_FlashRaw_RegionSize(&flash_raw_,
+                                    APP_FLASH_RAW_REGION_FIRMWARE_STATE),
+            firmware_state_size);
+  EXPECT_EQ(regionAddress(APP_FLASH_RAW_REGION_HISTORY),
+            size - history_size - settings_size);
+  EXPECT_EQ(APP_FlashRaw_RegionSize(&flash_raw_,
+                                    APP_FLASH_RAW_REGION_HISTORY),
+            history_size);
+  EXPECT_EQ(regionAddress(APP_FLASH_RAW_REGION_SETTINGS),
+            size - settings_size);
+  EXPECT_EQ(APP_FlashRaw_RegionSize(&flash_raw_,
+                                    APP_FLASH_RAW_REGION_SETTINGS),
+            settings_size);
+}
+
+TEST_F(FlashRawTest, WriteAndRead) {
+  vector<uint8_t> data(256), read_data(256, 0);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i * 7;
+  }
+  vector<bool> results;
+  // Operations are queued before the driver is opened.
+  EXPECT_TRUE(APP_FlashRaw_Erase(&flash_raw_, APP_FLASH_RAW_REGION_HISTORY,
+                                 kEraseBlockSize, kEraseBlockSize,
+                                 recordCompletionCallback, &results));
+  EXPECT_TRUE(APP_FlashRaw_Write(&flash_raw_, APP_FLASH_RAW_REGION_HISTORY,
+                                 kEraseBlockSize + 100,
+                                 data.data(), data.size(),
+                                 recordCompletionCallback, &results));
+  EXPECT_TRUE(APP_FlashRaw_Read(&flash_raw_, APP_FLASH_RAW_REGION_HISTORY,
+                                kEraseBlockSize + 100,
+                                read_data.data(), read_data.size(),
+                                recordCompletionCallback, &results));
+  runUntilIdle();
+  EXPECT_EQ(results, vector<bool>({true, true, true}));
+  EXPECT_EQ(read_data, data);
+  const uint32_t address =
+      regionAddress(APP_FLASH_RAW_REGION_HISTORY) + kEraseBlockSize;
+  EXPECT_EQ(memcmp(emulator_.data() + address + 100, data.data(),
+                   data.size()), 0);
+  EXPECT_EQ(emulator_.eraseCount(address / kEraseBlockSize), 1u);
+  EXPECT_EQ(emulator_.statistics().num_erases, 1u);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+  EXPECT_EQ(flash_raw_.num_bytes_written, data.size());
+  EXPECT_EQ(flash_raw_.num_bytes_read, read_data.size());
+}
+
+TEST_F(FlashRawTest, ProgramOnlyClearsBits) {
+  runUntilIdle();
+  const uint8_t zeros[4] = {0x00, 0x0f, 0xf0, 0x55};
+  const uint8_t ones[4] = {0xff, 0xff, 0x0f, 0xaa};
+  vector<bool> results;
+  APP_FlashRaw_Write(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS, 0,
+                     zeros, sizeof(zeros),
+                     recordCompletionCallback, &results);
+  APP_FlashRaw_Write(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS, 0,
+                     ones, sizeof(ones),
+                     recordCompletionCallback, &results);
+  runUntilIdle();
+  EXPECT_EQ(results, vector<bool>({true, true}));
+  const uint8_t* data =
+      emulator_.data() + regionAddress(APP_FLASH_RAW_REGION_SETTINGS);
+  EXPECT_EQ(data[0], 0x00);
+  EXPECT_EQ(data[1], 0x0f);
+  EXPECT_EQ(data[2], 0x00);
+  EXPECT_EQ(data[3], 0x00);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 1u);
+  // Strict flash refuses to program over data which is not erased.
+  emulator_.setStrictProgramming(true);
+  APP_FlashRaw_Write(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS, 0,
+                     ones, sizeof(ones),
+                     recordCompletionCallback, &results);
+  runUntilIdle();
+  EXPECT_EQ(results, vector<bool>({true, true, false}));
+  EXPECT_EQ(flash_raw_.num_errors, 1u);
+}
+
+TEST_F(FlashRawTest, Errors) {
+  runUntilIdle();
+  uint8_t buffer[16];
+  vector<bool> results;
+  const uint32_t settings_size =
+      APP_FlashRaw_RegionSize(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS);
+  // Outside of the region.
+  APP_FlashRaw_Read(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS,
+                    settings_size - 8, buffer, sizeof(buffer),
+                    recordCompletionCallback, &results);
+  // Not aligned to the erase block.
+  APP_FlashRaw_Erase(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS,
+                     100, kEraseBlockSize,
+                     recordCompletionCallback, &results);
+  // Flash reports an error.
+  emulator_.setNumFailingCommands(1);
+  APP_FlashRaw_Read(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS,
+                    0, buffer, sizeof(buffer),
+                    recordCompletionCallback, &results);
+  // Following operations are not affected.
+  APP_FlashRaw_Read(&flash_raw_, APP_FLASH_RAW_REGION_SETTINGS,
+                    0, buffer, sizeof(buffer),
+                    recordCompletionCallback, &results);
+  runUntilIdle();
+  EXPECT_EQ(results, vector<bool>({false, false, false, true}));
+  EXPECT_EQ(flash_raw_.num_errors, 3u);
+  EXPECT_FALSE(APP_FlashRaw_IsError(&flash_raw_));
+}
+
+TEST_F(FlashRawTest, Timing) {
+  runUntilIdle();
+  vector<uint8_t> data(kEraseBlockSize, 0x5a);
+  const SST25Emulator::Timing& timing = emulator_.timing();
+  const uint64_t start_time = emulator_.time();
+  APP_FlashRaw_Erase(&flash_raw_, APP_FLASH_RAW_REGION_HISTORY,
+                     0, kEraseBlockSize, nullptr, nullptr);
+  APP_FlashRaw_Write(&flash_raw_, APP_FLASH_RAW_REGION_HISTORY,
+                     0, data.data(), data.size(), nullptr, nullptr);
+  runUntilIdle();
+  EXPECT_EQ(emulator_.time() - start_time,
+            2 * timing.command_latency_ns +
+            timing.erase_block_ns +
+            kEraseBlockSize * timing.program_byte_ns);
+}
+
+}  // namespace NixieTracker
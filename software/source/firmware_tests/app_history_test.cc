@@ -0,0 +1,585 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "app_event.h"
+#include "app_flash_raw.h"
+#include "app_history.h"
+#include "app_timer.h"
+}
+
+DEFINE_int32(history_benchmark_days, 365,
+             "Number of days of samples to be recorded by the benchmark");
+
+namespace {
+
+// Current time of the system timer, in milliseconds.
+uint64_t g_system_count = 0;
+
+}  // namespace
+
+extern "C" {
+
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return g_system_count;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+const uint32_t kEraseBlockSize = 4096;
+const uint32_t kRegionSize =
+    APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS * kEraseBlockSize;
+
+// Seconds since 2000-01-01 of some moment in 2017.
+const uint32_t kStartTime = 548000000;
+
+// History region of the raw flash, kept in memory.
+//
+// Operations are queued and are completed by run(), like the real module
+// does it from its tasks routine. Programming only clears bits, the same way
+// as it happens with the NOR flash.
+class FakeFlash {
+ public:
+  struct Operation {
+    AppFlashRawOperationType type;
+    uint32_t offset;
+    uint32_t num_bytes;
+    uint8_t* buffer;
+    AppFlashRawCallback callback;
+    void* user_data;
+  };
+
+  FakeFlash()
+      : data(kRegionSize, 0xff),
+        num_block_erases(APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS, 0),
+        num_writes(0),
+        num_bytes_read(0),
+        power_loss_after_bytes(-1) {
+  }
+
+  // Complete all queued operations.
+  void run() {
+    while (!queue.empty()) {
+      const Operation op = queue.front();
+      queue.pop_front();
+      switch (op.type) {
+        case APP_FLASH_RAW_OPERATION_READ:
+          memcpy(op.buffer, &data[op.offset], op.num_bytes);
+          num_bytes_read += op.num_bytes;
+          break;
+        case APP_FLASH_RAW_OPERATION_WRITE: {
+          uint32_t num_bytes = op.num_bytes;
+          if (power_loss_after_bytes >= 0) {
+            num_bytes = std::min(num_bytes, (uint32_t)power_loss_after_bytes);
+            power_loss_after_bytes = -1;
+            is_power_lost = true;
+          }
+          for (uint32_t i = 0; i < num_bytes; ++i) {
+            data[op.offset + i] &= op.buffer[i];
+          }
+          ++num_writes;
+          break;
+        }
+        case APP_FLASH_RAW_OPERATION_ERASE:
+          memset(&data[op.offset], 0xff, op.num_bytes);
+          for (uint32_t i = 0; i < op.num_bytes / kEraseBlockSize; ++i) {
+            ++num_block_erases[op.offset / kEraseBlockSize + i];
+          }
+          break;
+      }
+      if (is_power_lost) {
+        // Nothing is reported back, device is off.
+        queue.clear();
+        return;
+      }
+      if (op.callback != nullptr) {
+        op.callback(true, op.user_data);
+      }
+    }
+  }
+
+  bool queue_operation(AppFlashRawOperationType type,
+                       AppFlashRawRegion region,
+                       uint32_t offset,
+                       const uint8_t* buffer,
+                       uint32_t num_bytes,
+                       AppFlashRawCallback callback,
+                       void* user_data) {
+    EXPECT_EQ(region, APP_FLASH_RAW_REGION_HISTORY);
+    EXPECT_LE(offset + num_bytes, kRegionSize);
+    if (queue.size() == APP_FLASH_RAW_QUEUE_SIZE) {
+      return false;
+    }
+    queue.push_back({type, offset, num_bytes, const_cast<uint8_t*>(buffer),
+                     callback, user_data});
+    return true;
+  }
+
+  vector<uint8_t> data;
+  vector<int> num_block_erases;
+  int num_writes;
+  uint64_t num_bytes_read;
+  // Number of bytes the next write programs before the power is lost, -1 if
+  // the power stays on.
+  int power_loss_after_bytes;
+  bool is_power_lost = false;
+  std::deque<Operation> queue;
+};
+
+FakeFlash* g_flash = nullptr;
+
+}  // namespace
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+bool APP_FlashRaw_IsReady(AppFlashRawData* /*app_flash_raw_data*/) {
+  return true;
+}
+
+bool APP_FlashRaw_IsError(AppFlashRawData* /*app_flash_raw_data*/) {
+  return false;
+}
+
+uint32_t APP_FlashRaw_RegionSize(AppFlashRawData* /*app_flash_raw_data*/,
+                                 AppFlashRawRegion region) {
+  return (region == APP_FLASH_RAW_REGION_HISTORY)
+             ? NixieTracker::kRegionSize : 0;
+}
+
+bool APP_FlashRaw_Read(AppFlashRawData* /*app_flash_raw_data*/,
+                       AppFlashRawRegion region,
+                       uint32_t offset,
+                       uint8_t* buffer,
+                       uint32_t num_bytes,
+                       AppFlashRawCallback callback,
+                       void* user_data) {
+  return NixieTracker::g_flash->queue_operation(
+      APP_FLASH_RAW_OPERATION_READ, region, offset, buffer, num_bytes,
+      callback, user_data);
+}
+
+bool APP_FlashRaw_Write(AppFlashRawData* /*app_flash_raw_data*/,
+                        AppFlashRawRegion region,
+                        uint32_t offset,
+                        const uint8_t* buffer,
+                        uint32_t num_bytes,
+                        AppFlashRawCallback callback,
+                        void* user_data) {
+  return NixieTracker::g_flash->queue_operation(
+      APP_FLASH_RAW_OPERATION_WRITE, region, offset, buffer, num_bytes,
+      callback, user_data);
+}
+
+bool APP_FlashRaw_Erase(AppFlashRawData* /*app_flash_raw_data*/,
+                        AppFlashRawRegion region,
+                        uint32_t offset,
+                        uint32_t num_bytes,
+                        AppFlashRawCallback callback,
+                        void* user_data) {
+  return NixieTracker::g_flash->queue_operation(
+      APP_FLASH_RAW_OPERATION_ERASE, region, offset, nullptr, num_bytes,
+      callback, user_data);
+}
+
+}  // extern "C"
+
+// Samples are compared and printed by the test expectations.
+bool operator==(const AppHistorySample& a, const AppHistorySample& b) {
+  return a.timestamp == b.timestamp && a.value == b.value;
+}
+
+std::ostream& operator<<(std::ostream& os, const AppHistorySample& sample) {
+  return os << "(" << sample.timestamp << ", " << sample.value << ")";
+}
+
+namespace NixieTracker {
+
+namespace {
+
+class AppHistoryTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    g_system_count = 0;
+    g_flash = &flash_;
+    boot();
+  }
+
+  void TearDown() override {
+    g_flash = nullptr;
+  }
+
+  // Start from scratch as if the device was reset, flash content is kept.
+  void boot() {
+    flash_.queue.clear();
+    flash_.is_power_lost = false;
+    memset(&flash_raw_, 0, sizeof(flash_raw_));
+    flash_raw_.read_block_size = 1;
+    flash_raw_.write_block_size = 1;
+    flash_raw_.erase_block_size = kEraseBlockSize;
+    APP_Timer_Initialize(&timer_wheel_);
+    APP_Event_Initialize(&event_bus_);
+    APP_History_Initialize(&history_, &flash_raw_, &timer_wheel_, &event_bus_);
+    run();
+    ASSERT_TRUE(APP_History_IsLoaded(&history_));
+  }
+
+  // Run tasks until there is nothing to be done.
+  void run() {
+    for (int i = 0; i < 100000; ++i) {
+      APP_Timer_Tasks(&timer_wheel_);
+      APP_Event_Tasks(&event_bus_);
+      APP_History_Tasks(&history_);
+      flash_.run();
+      if (flash_.queue.empty() && !APP_History_IsRunnable(&history_)) {
+        return;
+      }
+    }
+    FAIL() << "History did not become idle";
+  }
+
+  void advanceTimeMs(uint64_t time_ms) {
+    g_system_count += time_ms;
+    run();
+  }
+
+  void record(uint32_t timestamp, int32_t value) {
+    EXPECT_TRUE(APP_History_Record(&history_, timestamp, value));
+    run();
+  }
+
+  void flush() {
+    APP_History_Flush(&history_);
+    run();
+    EXPECT_FALSE(APP_History_IsDirty(&history_));
+  }
+
+  vector<AppHistorySample> query(uint32_t from, uint32_t to) {
+    vector<AppHistorySample> samples;
+    AppHistoryQuery query;
+    APP_History_QueryBegin(&history_, &query, from, to);
+    for (int i = 0; i < 100000; ++i) {
+      AppHistorySample sample;
+      while (APP_History_QueryNext(&query, &sample)) {
+        samples.push_back(sample);
+      }
+      if (APP_History_QueryIsFinished(&query)) {
+        EXPECT_FALSE(query.is_error);
+        return samples;
+      }
+      APP_History_QueryFetch(&query);
+      flash_.run();
+    }
+    ADD_FAILURE() << "Query did not finish";
+    return samples;
+  }
+
+  vector<AppHistorySample> queryAll() {
+    return query(0, UINT32_MAX);
+  }
+
+  FakeFlash flash_;
+  AppFlashRawData flash_raw_;
+  AppTimerWheel timer_wheel_;
+  AppEventBus event_bus_;
+  AppHistoryData history_;
+};
+
+}  // namespace
+
+TEST_F(AppHistoryTest, Empty) {
+  EXPECT_EQ(history_.active_sector, -1);
+  EXPECT_TRUE(queryAll().empty());
+  EXPECT_FALSE(APP_History_IsDirty(&history_));
+}
+
+TEST_F(AppHistoryTest, RecordAndQuery) {
+  vector<AppHistorySample> expected;
+  uint32_t timestamp = kStartTime;
+  for (int i = 0; i < 100; ++i) {
+    // Mix of small and large differences of both signs.
+    timestamp += 30 + (uint32_t)(i % 7) * 100000;
+    const AppHistorySample sample = {timestamp,
+                                     (i % 3 == 0) ? -i * 1000 : i};
+    expected.push_back(sample);
+    record(sample.timestamp, sample.value);
+  }
+  // Samples are available before they are programmed.
+  EXPECT_TRUE(APP_History_IsDirty(&history_));
+  EXPECT_EQ(queryAll(), expected);
+  flush();
+  EXPECT_EQ(queryAll(), expected);
+  EXPECT_EQ(history_.num_samples, 100);
+  EXPECT_EQ(history_.num_erases, 1);
+}
+
+TEST_F(AppHistoryTest, ExtremeValues) {
+  const vector<AppHistorySample> expected = {
+      {1, INT32_MIN},
+      {2, INT32_MAX},
+      {3, 0},
+      {UINT32_MAX - 1, INT32_MIN},
+      {UINT32_MAX, INT32_MAX},
+  };
+  for (const AppHistorySample& sample : expected) {
+    record(sample.timestamp, sample.value);
+  }
+  flush();
+  boot();
+  EXPECT_EQ(queryAll(), expected);
+}
+
+TEST_F(AppHistoryTest, RepeatedValues) {
+  const uint32_t heartbeat = APP_CONFIG_HISTORY_HEARTBEAT_INTERVAL;
+  record(kStartTime, 10);
+  // Same value, not stored until heartbeat interval passes.
+  record(kStartTime + 30, 10);
+  record(kStartTime + heartbeat - 1, 10);
+  record(kStartTime + heartbeat, 10);
+  // Changed value is stored right away.
+  record(kStartTime + heartbeat + 30, 11);
+  // Samples which go back in time are dropped.
+  record(kStartTime + heartbeat + 30, 12);
+  record(kStartTime, 13);
+  const vector<AppHistorySample> expected = {
+      {kStartTime, 10},
+      {kStartTime + heartbeat, 10},
+      {kStartTime + heartbeat + 30, 11},
+  };
+  EXPECT_EQ(queryAll(), expected);
+  EXPECT_EQ(history_.num_samples_dropped, 2);
+}
+
+TEST_F(AppHistoryTest, FlushInterval) {
+  record(kStartTime, 1);
+  EXPECT_TRUE(APP_History_IsDirty(&history_));
+  EXPECT_EQ(flash_.num_writes, 0);
+  advanceTimeMs(APP_CONFIG_HISTORY_FLUSH_INTERVAL * 1000 - 1);
+  EXPECT_EQ(flash_.num_writes, 0);
+  advanceTimeMs(1);
+  EXPECT_EQ(flash_.num_writes, 1);
+  EXPECT_FALSE(APP_History_IsDirty(&history_));
+  // Interval starts again with the next sample.
+  record(kStartTime + 60, 2);
+  advanceTimeMs(APP_CONFIG_HISTORY_FLUSH_INTERVAL * 1000);
+  EXPECT_EQ(flash_.num_writes, 2);
+  boot();
+  const vector<AppHistorySample> expected = {{kStartTime, 1},
+                                             {kStartTime + 60, 2}};
+  EXPECT_EQ(queryAll(), expected);
+}
+
+TEST_F(AppHistoryTest, ReloadAndContinue) {
+  vector<AppHistorySample> expected;
+  uint32_t timestamp = kStartTime;
+  for (int i = 0; i < 3000; ++i) {
+    timestamp += 60 + i % 50;
+    expected.push_back({timestamp, i});
+    record(timestamp, i);
+  }
+  flush();
+  boot();
+  EXPECT_EQ(history_.last.timestamp, timestamp);
+  EXPECT_EQ(queryAll(), expected);
+  // Samples are appended to the page which was loaded.
+  const int num_writes = flash_.num_writes;
+  for (int i = 0; i < 10; ++i) {
+    timestamp += 60;
+    expected.push_back({timestamp, -i});
+    record(timestamp, -i);
+  }
+  flush();
+  EXPECT_EQ(flash_.num_writes, num_writes + 1);
+  boot();
+  EXPECT_EQ(queryAll(), expected);
+}
+
+TEST_F(AppHistoryTest, WrapAround) {
+  vector<AppHistorySample> recorded;
+  uint32_t timestamp = kStartTime;
+  int32_t value = 0;
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> delta(-3, 3);
+  // Fill the region several times.
+  for (int i = 0; i < 200000; ++i) {
+    timestamp += 30;
+    value += 1 + delta(rng) * 1000;
+    recorded.push_back({timestamp, value});
+    record(timestamp, value);
+  }
+  flush();
+  boot();
+  const vector<AppHistorySample> samples = queryAll();
+  ASSERT_FALSE(samples.empty());
+  // The newest samples are kept, without gaps.
+  const size_t num_kept = samples.size();
+  EXPECT_LT(num_kept, recorded.size());
+  EXPECT_EQ(samples,
+            vector<AppHistorySample>(recorded.end() - num_kept,
+                                     recorded.end()));
+  // All but one sector are full of samples.
+  EXPECT_GT(num_kept * 3,
+            (APP_CONFIG_FLASH_HISTORY_NUM_BLOCKS - 1) * kEraseBlockSize);
+  // Wear is spread evenly.
+  const auto minmax = std::minmax_element(flash_.num_block_erases.begin(),
+                                          flash_.num_block_erases.end());
+  EXPECT_LE(*minmax.second - *minmax.first, 1);
+}
+
+TEST_F(AppHistoryTest, RangeQuery) {
+  vector<AppHistorySample> recorded;
+  uint32_t timestamp = kStartTime;
+  for (int i = 0; i < 20000; ++i) {
+    timestamp += 100;
+    recorded.push_back({timestamp, i});
+    record(timestamp, i);
+  }
+  flush();
+  const uint64_t num_bytes_read = flash_.num_bytes_read;
+  const uint32_t from = kStartTime + 1234567;
+  const uint32_t to = from + 24 * 60 * 60;
+  vector<AppHistorySample> expected;
+  for (const AppHistorySample& sample : recorded) {
+    if (sample.timestamp >= from && sample.timestamp <= to) {
+      expected.push_back(sample);
+    }
+  }
+  EXPECT_EQ(query(from, to), expected);
+  // Sectors outside of the range are not read.
+  EXPECT_LE(flash_.num_bytes_read - num_bytes_read, 2 * kEraseBlockSize);
+  EXPECT_TRUE(query(timestamp + 1, UINT32_MAX).empty());
+  EXPECT_TRUE(query(0, kStartTime).empty());
+  EXPECT_EQ(query(timestamp, timestamp),
+            vector<AppHistorySample>(1, recorded.back()));
+}
+
+TEST_F(AppHistoryTest, PowerLossDuringWrite) {
+  vector<AppHistorySample> expected;
+  uint32_t timestamp = kStartTime;
+  for (int i = 0; i < 20; ++i) {
+    timestamp += 1000;
+    expected.push_back({timestamp, i * 1000});
+    record(timestamp, i * 1000);
+  }
+  flush();
+  // Power is lost while programming the page with a new sample which has
+  // multi-byte differences, with any number of its bytes programmed.
+  for (int num_missing = 1; num_missing <= 6; ++num_missing) {
+    record(timestamp + 100000, 123456);
+    // Record is longer when it starts a page, as it is not a difference.
+    ASSERT_GE(history_.page_used - history_.page_programmed, 6u);
+    flash_.power_loss_after_bytes = history_.page_used - num_missing;
+    APP_History_Flush(&history_);
+    run();
+    boot();
+    EXPECT_EQ(queryAll(), expected) << num_missing << " bytes missing";
+  }
+  // Store continues to work.
+  timestamp += 100000;
+  expected.push_back({timestamp, 7});
+  record(timestamp, 7);
+  flush();
+  boot();
+  EXPECT_EQ(queryAll(), expected);
+}
+
+// Record a sample for every request the display makes, with the value
+// changing occasionally, and report how much of the flash it takes.
+TEST_F(AppHistoryTest, BenchmarkRecording) {
+  const uint32_t request_interval = 30;
+  const int num_days = FLAGS_history_benchmark_days;
+  std::mt19937 rng(1);
+  // Value changes about 50 times per day.
+  std::bernoulli_distribution is_changed(50.0 * request_interval / 86400);
+  std::uniform_int_distribution<int> delta(-3, 3);
+  uint32_t timestamp = kStartTime;
+  int32_t value = 1000;
+  double record_time_s = 0;
+  const int num_requests = num_days * 86400 / request_interval;
+  for (int i = 0; i < num_requests; ++i) {
+    timestamp += request_interval;
+    if (is_changed(rng)) {
+      value += delta(rng);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    record(timestamp, value);
+    // NOTE: Flush timer is not used, stepping the timer wheel through a year
+    // of milliseconds takes too long. Flushing at the same interval matches
+    // it closely enough.
+    if (timestamp % APP_CONFIG_HISTORY_FLUSH_INTERVAL < request_interval) {
+      APP_History_Flush(&history_);
+      run();
+    }
+    record_time_s += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+  flush();
+  int total_erases = 0;
+  int max_block_erases = 0;
+  for (int num_erases : flash_.num_block_erases) {
+    total_erases += num_erases;
+    max_block_erases = std::max(max_block_erases, num_erases);
+  }
+  const double bytes_per_sample =
+      (double)history_.num_bytes_encoded / history_.num_samples;
+  const double bytes_per_day = (double)history_.num_bytes_encoded / num_days;
+  LOG(INFO) << "Recorded " << num_requests << " requests over " << num_days
+            << " days, " << history_.num_samples << " samples stored, "
+            << bytes_per_sample << " bytes per sample.";
+  LOG(INFO) << "Host recording rate: "
+            << (uint64_t)(num_requests / record_time_s)
+            << " samples per second.";
+  LOG(INFO) << "Flash usage: " << bytes_per_day << " bytes per day, "
+            << (double)flash_.num_writes / num_days << " page writes per day, "
+            << (double)total_erases / num_days << " erases per day, "
+            << max_block_erases << " erases of the most worn block.";
+  LOG(INFO) << "Region of " << kRegionSize << " bytes holds "
+            << (int)((kRegionSize - kEraseBlockSize) / bytes_per_day)
+            << " days of history.";
+  // NOR flash handles at least 100000 erase cycles, make sure the history
+  // does not wear it out within a lifetime of the device.
+  EXPECT_LT((double)max_block_erases / num_days * 365 * 20, 100000);
+  const vector<AppHistorySample> samples = queryAll();
+  ASSERT_FALSE(samples.empty());
+  EXPECT_EQ(samples.back().timestamp, history_.last.timestamp);
+}
+
+}  // namespace NixieTracker
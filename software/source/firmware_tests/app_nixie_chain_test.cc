@@ -0,0 +1,229 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+// Tests of the display which is made of two chained boards. Compiled with
+// non-default number of tubes and shift registers, see CMakeLists.txt.
+
+#include "test/test.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "app_https_client.h"
+#include "app_event.h"
+#include "app_nixie.h"
+#include "app_rtc.h"
+#include "app_shift_register.h"
+#include "app_timer.h"
+#include "util_string.h"
+}
+
+extern "C" {
+
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return 0;
+}
+
+bool APP_Network_hasUsableInterface(void) {
+  return true;
+}
+
+bool APP_HTTPS_Client_Request(AppHTTPSClientData* app_https_client_data,
+                              const char /*url*/[MAX_URL],
+                              const AppHttpsClientCallbacks* callbacks) {
+  app_https_client_data->callbacks = *callbacks;
+  return true;
+}
+
+bool APP_HTTPS_Client_IsBusy(AppHTTPSClientData* /*app_https_client_data*/) {
+  return false;
+}
+
+void APP_ShiftRegister_SendData(
+    AppShiftRegisterData* /*app_shift_register_data*/,
+    const uint8_t* /*data*/,
+    size_t /*num_bytes*/) {
+}
+
+bool APP_ShiftRegister_IsBusy(
+    AppShiftRegisterData* /*app_shift_register_data*/) {
+  return false;
+}
+
+// Snapshot is never restored in these tests, so the read never finishes.
+bool RTC_MCP7940N_ReadSRAM(RTC_MCP7940N* /*rtc*/,
+                           uint8_t /*offset*/,
+                           uint8_t* /*data*/,
+                           uint8_t /*num_bytes*/,
+                           RTC_MCP7940N_CompletionCallback /*callback*/,
+                           void* /*user_data*/) {
+  return true;
+}
+
+bool RTC_MCP7940N_WriteSRAM(RTC_MCP7940N* /*rtc*/,
+                            uint8_t /*offset*/,
+                            const uint8_t* /*data*/,
+                            uint8_t /*num_bytes*/,
+                            RTC_MCP7940N_CompletionCallback /*callback*/,
+                            void* /*user_data*/) {
+  return true;
+}
+
+bool APP_RTC_TimestampGet(AppRTCData* /*app_rtc_data*/, uint32_t* seconds) {
+  *seconds = 0;
+  return false;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+class AppNixieChainTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    APP_Timer_Initialize(&app_timer_wheel_);
+    APP_Event_Initialize(&app_event_bus_);
+    APP_Nixie_Initialize(&app_nixie_data_,
+                         &app_https_client_data_,
+                         &app_shift_register_data_,
+                         &app_rtc_data_,
+                         &app_timer_wheel_,
+                         &app_event_bus_);
+  }
+
+  void receiveData(const vector<string>& data_chunks) {
+    app_nixie_data_.state = APP_NIXIE_STATE_BEGIN_HTTP_REQUEST;
+    while (app_nixie_data_.state != APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE) {
+      APP_Nixie_Tasks(&app_nixie_data_);
+    }
+    const AppHttpsClientCallbacks& callbacks =
+        app_https_client_data_.callbacks;
+    for (const string& chunk : data_chunks) {
+      callbacks.buffer_received(reinterpret_cast<const uint8_t*>(chunk.data()),
+                                chunk.size(),
+                                callbacks.user_data);
+    }
+    callbacks.request_handled(callbacks.user_data);
+    while (APP_Nixie_IsBusy(&app_nixie_data_)) {
+      APP_Nixie_Tasks(&app_nixie_data_);
+    }
+  }
+
+  void displayAndWait(const char* value) {
+    char display_value[MAX_NIXIE_TUBES + 1];
+    safe_strncpy(display_value, value, sizeof(display_value));
+    std::reverse(display_value, display_value + MAX_NIXIE_TUBES);
+    EXPECT_TRUE(APP_Nixie_Display(&app_nixie_data_, display_value));
+    while (APP_Nixie_IsBusy(&app_nixie_data_)) {
+      APP_Nixie_Tasks(&app_nixie_data_);
+    }
+  }
+
+  string displayValueAsString() {
+    return APP_Nixie_DisplayValueToString(app_nixie_data_.display_value,
+                                          app_nixie_data_.num_nixies,
+                                          display_string_);
+  }
+
+  bool isBitLatched(int shift_byte, int shift_bit) {
+    const int num_byte = app_nixie_data_.num_shift_registers - shift_byte - 1;
+    return (app_nixie_data_.latched_shift_state[num_byte] >> shift_bit) & 1;
+  }
+
+  AppTimerWheel app_timer_wheel_;
+  AppEventBus app_event_bus_;
+  AppHTTPSClientData app_https_client_data_ = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data_ = {(AppShiftRegisterState)0};
+  AppRTCData app_rtc_data_;
+  AppNixieData app_nixie_data_ = {NULL};
+  char display_string_[MAX_NIXIE_TUBES + 1];
+};
+
+}  // namespace
+
+TEST_F(AppNixieChainTest, WiringCoversAllBoards) {
+  ASSERT_EQ(MAX_NIXIE_TUBES, 8);
+  EXPECT_EQ(app_nixie_data_.num_nixies, 8);
+  EXPECT_EQ(app_nixie_data_.num_shift_registers, 12);
+  // Tubes of the second board are wired the same way as the first board,
+  // just to the next shift registers in the chain.
+  for (int tube = 0; tube < 4; ++tube) {
+    for (int cathode = 2; cathode <= 11; ++cathode) {
+      const NixieCathodeBit& first =
+          app_nixie_data_.cathode_mapping[tube][cathode];
+      const NixieCathodeBit& second =
+          app_nixie_data_.cathode_mapping[tube + 4][cathode];
+      EXPECT_EQ(second.byte, first.byte + 6);
+      EXPECT_EQ(second.bit, first.bit);
+    }
+  }
+}
+
+TEST_F(AppNixieChainTest, ParsesValueForAllTubes) {
+  receiveData({">Open Tasks (12345678)<"});
+  EXPECT_TRUE(app_nixie_data_.is_value_parsed);
+  EXPECT_EQ(displayValueAsString(), "12345678");
+}
+
+TEST_F(AppNixieChainTest, ParsesShortValue) {
+  receiveData({">Open Tasks (123)<"});
+  EXPECT_TRUE(app_nixie_data_.is_value_parsed);
+  EXPECT_EQ(displayValueAsString(), "00000123");
+}
+
+TEST_F(AppNixieChainTest, DisplayValueToString) {
+  const char value[MAX_NIXIE_TUBES] = {'4', '3', '2', '1'};
+  EXPECT_EQ(string(APP_Nixie_DisplayValueToString(value, 8, display_string_)),
+            "____1234");
+  EXPECT_EQ(string(APP_Nixie_DisplayValueToString(value, 4, display_string_)),
+            "1234");
+}
+
+TEST_F(AppNixieChainTest, DisplayDrivesBothBoards) {
+  displayAndWait("12345678");
+  // Most significant digit is on the J2 tube of the first board, where '1' is
+  // wired to the bit 5 of the register 2.
+  EXPECT_TRUE(isBitLatched(2, 5));
+  // The same tube of the second board shows '5', which is wired to the bit 7
+  // of the register 2 of that board.
+  EXPECT_TRUE(isBitLatched(6 + 2, 7));
+  int num_bits_set = 0;
+  for (int i = 0; i < NUM_NIXIE_SHIFT_REGISTERS; ++i) {
+    for (int bit = 0; bit < 8; ++bit) {
+      num_bits_set += (app_nixie_data_.latched_shift_state[i] >> bit) & 1;
+    }
+  }
+  EXPECT_EQ(num_bits_set, 8);
+}
+
+}  // namespace NixieTracker
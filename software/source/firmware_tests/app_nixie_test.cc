@@ -27,12 +27,61 @@
 
 extern "C" {
 #include "app_https_client.h"
+#include "app_event.h"
 #include "app_nixie.h"
+#include "app_rtc.h"
 #include "app_shift_register.h"
+#include "app_supervisor.h"
+#include "app_timer.h"
+#include "util_string.h"
 }
 
+namespace {
+
+// Number of times data was sent to the shift registers.
+int g_num_shift_register_transmissions = 0;
+
+// Current time of the system timer.
+uint64_t g_system_count = 0;
+
+// Whether HTTP(S) client is used by someone else.
+bool g_is_https_client_busy = false;
+
+// Content of the RTC SRAM.
+uint8_t g_rtc_sram[MCP7940N_SRAM_SIZE] = {0};
+
+// SRAM read which was queued and not finished yet.
+struct PendingSRAMRead {
+  uint8_t offset;
+  uint8_t* data;
+  uint8_t num_bytes;
+  RTC_MCP7940N_CompletionCallback callback;
+  void* user_data;
+} g_pending_sram_read = {0};
+
+// Time reported by the RTC, in seconds since 2000-01-01.
+const uint32_t kRTCTimestamp = 561234567;
+
+}  // namespace
+
 extern "C" {
 
+volatile uint32_t WDTCONSET = 0;
+volatile uint32_t RCON = 0;
+volatile uint32_t RCONCLR = 0;
+
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return g_system_count;
+}
+
+bool APP_Network_hasUsableInterface(void) {
+  return true;
+}
+
 bool APP_HTTPS_Client_Request(AppHTTPSClientData* app_https_client_data,
                               const char /*url*/[MAX_URL],
                               const AppHttpsClientCallbacks* callbacks) {
@@ -41,13 +90,39 @@ bool APP_HTTPS_Client_Request(AppHTTPSClientData* app_https_client_data,
 }
 
 bool APP_HTTPS_Client_IsBusy(AppHTTPSClientData* /*app_https_client_data*/) {
-  return false;
+  return g_is_https_client_busy;
 }
 
 void APP_ShiftRegister_SendData(
     AppShiftRegisterData* /*app_shift_register_data*/,
-    uint8_t* /*data*/,
+    const uint8_t* /*data*/,
     size_t /*num_bytes*/) {
+  ++g_num_shift_register_transmissions;
+}
+
+bool RTC_MCP7940N_ReadSRAM(RTC_MCP7940N* /*rtc*/,
+                           uint8_t offset,
+                           uint8_t* data,
+                           uint8_t num_bytes,
+                           RTC_MCP7940N_CompletionCallback callback,
+                           void* user_data) {
+  g_pending_sram_read = {offset, data, num_bytes, callback, user_data};
+  return true;
+}
+
+bool RTC_MCP7940N_WriteSRAM(RTC_MCP7940N* /*rtc*/,
+                            uint8_t offset,
+                            const uint8_t* data,
+                            uint8_t num_bytes,
+                            RTC_MCP7940N_CompletionCallback /*callback*/,
+                            void* /*user_data*/) {
+  memcpy(g_rtc_sram + offset, data, num_bytes);
+  return true;
+}
+
+bool APP_RTC_TimestampGet(AppRTCData* /*app_rtc_data*/, uint32_t* seconds) {
+  *seconds = kRTCTimestamp;
+  return true;
 }
 
 bool APP_ShiftRegister_IsBusy(
@@ -64,6 +139,36 @@ using std::string;
 
 namespace {
 
+// Timers are never expired in these tests, so single wheel is shared by all
+// of them.
+AppTimerWheel* testTimerWheel() {
+  static AppTimerWheel app_timer_wheel;
+  APP_Timer_Initialize(&app_timer_wheel);
+  return &app_timer_wheel;
+}
+
+AppRTCData* testRTC() {
+  static AppRTCData app_rtc_data;
+  return &app_rtc_data;
+}
+
+// Finish SRAM read which was queued by the nixie module.
+void finishPendingSRAMRead() {
+  PendingSRAMRead read = g_pending_sram_read;
+  ASSERT_NE(read.callback, nullptr);
+  g_pending_sram_read = {0};
+  memcpy(read.data, g_rtc_sram + read.offset, read.num_bytes);
+  read.callback(NULL, true, read.user_data);
+}
+
+// Nixie module subscribes to the bus on initialization, so bus is re-initialized
+// for every test to keep room for the subscriber.
+AppEventBus* testEventBus() {
+  static AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  return &app_event_bus;
+}
+
 class FragmentedSender {
  public:
   explicit FragmentedSender(const AppHttpsClientCallbacks& callbacks)
@@ -89,7 +194,10 @@ void pokeAppNixieWithReceivedData(AppNixieData* app_nixie_data,
   AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
   APP_Nixie_Initialize(app_nixie_data,
                        &app_https_client_data,
-                       &app_shift_register_data);
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
   app_nixie_data->state = APP_NIXIE_STATE_BEGIN_HTTP_REQUEST;
   // Make sure state machine is ready for data.
   while (app_nixie_data->state != APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE) {
@@ -106,6 +214,22 @@ void pokeAppNixieWithReceivedData(AppNixieData* app_nixie_data,
   }
 }
 
+// Display given value and run state machine until it becomes idle.
+//
+// Returns number of state machine iterations it took.
+int displayAndWait(AppNixieData* app_nixie_data, const char* value) {
+  char display_value[MAX_NIXIE_TUBES + 1];
+  safe_strncpy(display_value, value, sizeof(display_value));
+  std::reverse(display_value, display_value + MAX_NIXIE_TUBES);
+  EXPECT_TRUE(APP_Nixie_Display(app_nixie_data, display_value));
+  int num_iterations = 0;
+  while (APP_Nixie_IsBusy(app_nixie_data)) {
+    APP_Nixie_Tasks(app_nixie_data);
+    ++num_iterations;
+  }
+  return num_iterations;
+}
+
 string displayValueAsString(const AppNixieData& app_nixie_data) {
   return string(app_nixie_data.display_value, app_nixie_data.num_nixies);
 }
@@ -117,6 +241,14 @@ void expectDisplayValue(const AppNixieData& app_nixie_data,
   EXPECT_EQ(actual_value, expected_value);
 }
 
+int nixieState(void* user_data) {
+  return static_cast<AppNixieData*>(user_data)->state;
+}
+
+uint32_t nixieStateBudget(void* /*user_data*/, int state) {
+  return APP_Nixie_StateBudget(static_cast<AppNixieState>(state));
+}
+
 }  // namespace
 
 TEST(AppNixie, CyclicBufferRefill) {
@@ -305,4 +437,359 @@ TEST(AppNixie, MultipleBuffersWithValueAndPartialTokenInHugePrefix) {
   expectDisplayValue(app_nixie_data, "0123");
 }
 
+TEST(AppNixie, StateMachineIterations) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  // Request value from the server.
+  app_nixie_data.state = APP_NIXIE_STATE_BEGIN_HTTP_REQUEST;
+  int num_request_iterations = 0;
+  while (app_nixie_data.state != APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE) {
+    APP_Nixie_Tasks(&app_nixie_data);
+    ++num_request_iterations;
+  }
+  // Receive the response and show the value.
+  FragmentedSender sender(app_https_client_data.callbacks);
+  sender.sendData({">Open Tasks (1234)<"});
+  int num_response_iterations = 0;
+  while (APP_Nixie_IsBusy(&app_nixie_data)) {
+    APP_Nixie_Tasks(&app_nixie_data);
+    ++num_response_iterations;
+  }
+  expectDisplayValue(app_nixie_data, "1234");
+  // Display value.
+  const int num_display_iterations = displayAndWait(&app_nixie_data, "4321");
+  LOG(INFO) << "Iterations to send request: " << num_request_iterations
+            << ", to handle response: " << num_response_iterations
+            << ", to display value: " << num_display_iterations;
+  EXPECT_EQ(num_request_iterations, 1);
+  EXPECT_EQ(num_response_iterations, 1);
+  EXPECT_EQ(num_display_iterations, 1);
+}
+
+TEST(AppNixie, FrameDiffingSuppressesUnchangedFrames) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  g_num_shift_register_transmissions = 0;
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  // Initialization clears the registers.
+  EXPECT_EQ(g_num_shift_register_transmissions, 1);
+  displayAndWait(&app_nixie_data, "1234");
+  EXPECT_EQ(g_num_shift_register_transmissions, 2);
+  displayAndWait(&app_nixie_data, "1234");
+  displayAndWait(&app_nixie_data, "1234");
+  EXPECT_EQ(g_num_shift_register_transmissions, 2);
+  displayAndWait(&app_nixie_data, "4321");
+  EXPECT_EQ(g_num_shift_register_transmissions, 3);
+  uint32_t num_frames_sent, num_frames_suppressed;
+  APP_Nixie_FrameStatisticsGet(&app_nixie_data,
+                               &num_frames_sent,
+                               &num_frames_suppressed);
+  EXPECT_EQ(num_frames_sent, 3);
+  EXPECT_EQ(num_frames_suppressed, 2);
+}
+
+TEST(AppNixie, FrameDiffingForcedRefresh) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  g_num_shift_register_transmissions = 0;
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  displayAndWait(&app_nixie_data, "1234");
+  EXPECT_EQ(g_num_shift_register_transmissions, 2);
+  EXPECT_TRUE(APP_Nixie_Refresh(&app_nixie_data));
+  while (APP_Nixie_IsBusy(&app_nixie_data)) {
+    APP_Nixie_Tasks(&app_nixie_data);
+  }
+  EXPECT_EQ(g_num_shift_register_transmissions, 3);
+  // Refresh is only forced once.
+  displayAndWait(&app_nixie_data, "1234");
+  EXPECT_EQ(g_num_shift_register_transmissions, 3);
+  APP_Nixie_FrameStatisticsReset(&app_nixie_data);
+  uint32_t num_frames_sent, num_frames_suppressed;
+  APP_Nixie_FrameStatisticsGet(&app_nixie_data,
+                               &num_frames_sent,
+                               &num_frames_suppressed);
+  EXPECT_EQ(num_frames_sent, 0);
+  EXPECT_EQ(num_frames_suppressed, 0);
+}
+
+TEST(AppNixie, FrameDiffingLatchedStateInvalidate) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  g_num_shift_register_transmissions = 0;
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  displayAndWait(&app_nixie_data, "1234");
+  EXPECT_EQ(g_num_shift_register_transmissions, 2);
+  // Registers were overwritten behind the display's back, so the same value
+  // is to be sent again.
+  APP_Nixie_LatchedStateInvalidate(&app_nixie_data);
+  displayAndWait(&app_nixie_data, "1234");
+  EXPECT_EQ(g_num_shift_register_transmissions, 3);
+  displayAndWait(&app_nixie_data, "1234");
+  EXPECT_EQ(g_num_shift_register_transmissions, 3);
+}
+
+TEST(AppNixie, PlayerStreamsFramesOnDeadlines) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  g_num_shift_register_transmissions = 0;
+  g_system_count = 1000;
+  // 10 frames at 100 fps, which is 10 system timer counts per frame.
+  EXPECT_TRUE(APP_Nixie_PlayerStartCathodeCleanup(&app_nixie_data, 1, 100));
+  EXPECT_FALSE(APP_Nixie_PlayerStartCathodeCleanup(&app_nixie_data, 1, 100));
+  for (int frame = 0; frame < 10; ++frame) {
+    APP_Nixie_PlayerTasks(&app_nixie_data);
+    EXPECT_EQ(g_num_shift_register_transmissions, frame + 1);
+    // Nothing happens until the deadline of the next frame.
+    g_system_count += 9;
+    APP_Nixie_PlayerTasks(&app_nixie_data);
+    EXPECT_EQ(g_num_shift_register_transmissions, frame + 1);
+    g_system_count += 1;
+  }
+  EXPECT_TRUE(APP_Nixie_PlayerIsActive(&app_nixie_data));
+  // Frame of the displayed value is restored.
+  APP_Nixie_PlayerTasks(&app_nixie_data);
+  EXPECT_FALSE(APP_Nixie_PlayerIsActive(&app_nixie_data));
+  EXPECT_EQ(g_num_shift_register_transmissions, 11);
+  uint32_t num_frames_played, num_missed_deadlines;
+  APP_Nixie_PlayerStatisticsGet(&app_nixie_data,
+                                &num_frames_played,
+                                &num_missed_deadlines);
+  EXPECT_EQ(num_frames_played, 10);
+  EXPECT_EQ(num_missed_deadlines, 0);
+}
+
+TEST(AppNixie, PlayerCountsMissedDeadlines) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  g_system_count = 0;
+  EXPECT_TRUE(APP_Nixie_PlayerStartCathodeCleanup(&app_nixie_data, 2, 200));
+  // Polling 3 times slower than the frame rate.
+  while (APP_Nixie_PlayerIsActive(&app_nixie_data)) {
+    APP_Nixie_PlayerTasks(&app_nixie_data);
+    g_system_count += 15;
+  }
+  uint32_t num_frames_played, num_missed_deadlines;
+  APP_Nixie_PlayerStatisticsGet(&app_nixie_data,
+                                &num_frames_played,
+                                &num_missed_deadlines);
+  EXPECT_EQ(num_frames_played + num_missed_deadlines, 20);
+  EXPECT_EQ(num_frames_played, 8);
+}
+
+TEST(AppNixie, PlayerRollEndsWithNewValue) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  displayAndWait(&app_nixie_data, "1234");
+  uint8_t frame_1234[NUM_NIXIE_SHIFT_REGISTERS];
+  memcpy(frame_1234, app_nixie_data.latched_shift_state, sizeof(frame_1234));
+  displayAndWait(&app_nixie_data, "0000");
+  const char value[MAX_NIXIE_TUBES] = {'4', '3', '2', '1'};
+  g_system_count = 0;
+  EXPECT_TRUE(APP_Nixie_PlayerStartRoll(&app_nixie_data, value, 50));
+  while (APP_Nixie_PlayerIsActive(&app_nixie_data)) {
+    APP_Nixie_PlayerTasks(&app_nixie_data);
+    g_system_count += 1;
+  }
+  expectDisplayValue(app_nixie_data, "1234");
+  EXPECT_EQ(memcmp(app_nixie_data.latched_shift_state,
+                   frame_1234,
+                   sizeof(frame_1234)), 0);
+  uint32_t num_frames_played, num_missed_deadlines;
+  APP_Nixie_PlayerStatisticsGet(&app_nixie_data,
+                                &num_frames_played,
+                                &num_missed_deadlines);
+  // Least significant digit makes 4 steps and one extra revolution.
+  EXPECT_EQ(num_frames_played, 15);
+  EXPECT_EQ(num_missed_deadlines, 0);
+}
+
+TEST(AppNixie, ResponseETag) {
+  AppNixieData app_nixie_data = {NULL};
+  pokeAppNixieWithReceivedData(
+      &app_nixie_data,
+      {"HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nET",
+       "ag: \"5a1b-2c\"\r\n\r\n",
+       ">Open Tasks (1234)<"});
+  EXPECT_STREQ(app_nixie_data.response_etag, "\"5a1b-2c\"");
+  EXPECT_STREQ(app_nixie_data.display_value_etag, "\"5a1b-2c\"");
+  expectDisplayValue(app_nixie_data, "1234");
+}
+
+TEST(AppNixie, ResponseETagInBodyIsIgnored) {
+  AppNixieData app_nixie_data = {NULL};
+  pokeAppNixieWithReceivedData(
+      &app_nixie_data,
+      {"HTTP/1.1 200 OK\r\n\r\nETag: \"x\"\r\n>Open Tasks (1234)<"});
+  EXPECT_STREQ(app_nixie_data.response_etag, "");
+  expectDisplayValue(app_nixie_data, "1234");
+}
+
+TEST(AppNixie, SnapshotRestoredAtBoot) {
+  memset(g_rtc_sram, 0, sizeof(g_rtc_sram));
+  // Receive value, which also stores the snapshot.
+  {
+    AppNixieData app_nixie_data = {NULL};
+    pokeAppNixieWithReceivedData(
+        &app_nixie_data,
+        {"HTTP/1.1 200 OK\r\nETag: W/\"42\"\r\n\r\n",
+         ">Open Tasks (321)<"});
+    EXPECT_FALSE(app_nixie_data.is_display_value_stale);
+    EXPECT_EQ(app_nixie_data.display_value_timestamp, kRTCTimestamp);
+  }
+  // Power cycle.
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  g_num_shift_register_transmissions = 0;
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  finishPendingSRAMRead();
+  while (APP_Nixie_IsBusy(&app_nixie_data)) {
+    APP_Nixie_Tasks(&app_nixie_data);
+  }
+  expectDisplayValue(app_nixie_data, "0321");
+  EXPECT_EQ(g_num_shift_register_transmissions, 2);
+  EXPECT_TRUE(app_nixie_data.is_display_value_stale);
+  EXPECT_EQ(app_nixie_data.display_value_timestamp, kRTCTimestamp);
+  EXPECT_STREQ(app_nixie_data.display_value_etag, "W/\"42\"");
+}
+
+TEST(AppNixie, SnapshotInvalid) {
+  memset(g_rtc_sram, 0, sizeof(g_rtc_sram));
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  finishPendingSRAMRead();
+  EXPECT_FALSE(APP_Nixie_IsBusy(&app_nixie_data));
+  EXPECT_FALSE(app_nixie_data.is_display_value_stale);
+}
+
+TEST(AppNixie, SnapshotCorrupted) {
+  {
+    AppNixieData app_nixie_data = {NULL};
+    pokeAppNixieWithReceivedData(&app_nixie_data, {">Open Tasks (1234)<"});
+  }
+  g_rtc_sram[7] ^= 0x01;
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  finishPendingSRAMRead();
+  EXPECT_FALSE(APP_Nixie_IsBusy(&app_nixie_data));
+  EXPECT_FALSE(app_nixie_data.is_display_value_stale);
+}
+
+TEST(AppNixie, SnapshotAfterFreshValue) {
+  {
+    AppNixieData app_nixie_data = {NULL};
+    pokeAppNixieWithReceivedData(&app_nixie_data, {">Open Tasks (1111)<"});
+  }
+  // Server replies before the RTC does.
+  AppNixieData app_nixie_data = {NULL};
+  pokeAppNixieWithReceivedData(&app_nixie_data, {">Open Tasks (2222)<"});
+  while (APP_Nixie_IsBusy(&app_nixie_data)) {
+    APP_Nixie_Tasks(&app_nixie_data);
+  }
+  finishPendingSRAMRead();
+  EXPECT_FALSE(APP_Nixie_IsBusy(&app_nixie_data));
+  EXPECT_FALSE(app_nixie_data.is_display_value_stale);
+  expectDisplayValue(app_nixie_data, "2222");
+}
+
+TEST(AppNixie, SupervisorToleratesLongHTTPSClientUse) {
+  AppNixieData app_nixie_data = {NULL};
+  AppHTTPSClientData app_https_client_data = {(AppHTTPSClientIPMode)0};
+  AppShiftRegisterData app_shift_register_data = {(AppShiftRegisterState)0};
+  APP_Nixie_Initialize(&app_nixie_data,
+                       &app_https_client_data,
+                       &app_shift_register_data,
+                       testRTC(),
+                       testTimerWheel(),
+                       testEventBus());
+  finishPendingSRAMRead();
+  // Same registration as in app.c, without recovery.
+  AppSupervisorData supervisor;
+  APP_Supervisor_Initialize(&supervisor);
+  APP_Supervisor_Register(&supervisor, "nixie",
+                          nixieState, nixieStateBudget,
+                          NULL,
+                          &app_nixie_data);
+  // Client is held by a download for much longer than any of the budgets.
+  g_is_https_client_busy = true;
+  app_nixie_data.state = APP_NIXIE_STATE_BEGIN_HTTP_REQUEST;
+  for (int i = 0; i < 10 * 60 * 1000; ++i) {
+    g_system_count += 1;
+    APP_Nixie_Tasks(&app_nixie_data);
+    APP_Supervisor_Tasks(&supervisor);
+  }
+  g_is_https_client_busy = false;
+  EXPECT_EQ(app_nixie_data.state, APP_NIXIE_STATE_WAIT_HTTPS_CLIENT);
+  EXPECT_EQ(supervisor.num_stalls, 0);
+  EXPECT_TRUE(supervisor.is_watchdog_fed);
+  // Request is sent as soon as the client is released.
+  APP_Nixie_Tasks(&app_nixie_data);
+  EXPECT_EQ(app_nixie_data.state, APP_NIXIE_STATE_WAIT_HTTPS_RESPONSE);
+}
+
 }  // namespace NixieTracker
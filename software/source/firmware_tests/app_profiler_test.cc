@@ -0,0 +1,114 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+extern "C" {
+#include "app_profiler.h"
+#include "app_scheduler.h"
+}
+
+namespace {
+
+// Current value of the core timer.
+uint32_t g_core_timer = 0;
+
+}  // namespace
+
+extern "C" {
+
+uint32_t _CP0_GET_COUNT(void) {
+  return g_core_timer;
+}
+
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return 0;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+namespace {
+
+// Task which takes given number of core timer ticks.
+void slowTaskTasks(void* user_data) {
+  g_core_timer += *static_cast<uint32_t*>(user_data);
+}
+
+}  // namespace
+
+TEST(AppProfiler, HistogramBucket) {
+  EXPECT_EQ(APP_Profiler_HistogramBucket(0), 0);
+  EXPECT_EQ(APP_Profiler_HistogramBucket(1), 1);
+  EXPECT_EQ(APP_Profiler_HistogramBucket(2), 2);
+  EXPECT_EQ(APP_Profiler_HistogramBucket(3), 2);
+  EXPECT_EQ(APP_Profiler_HistogramBucket(4), 3);
+  EXPECT_EQ(APP_Profiler_HistogramBucket(1023), 10);
+  EXPECT_EQ(APP_Profiler_HistogramBucket(1024), 11);
+  EXPECT_EQ(APP_Profiler_HistogramBucket(UINT32_MAX),
+            PROFILER_NUM_HISTOGRAM_BUCKETS - 1);
+}
+
+TEST(AppProfiler, StatisticsAccount) {
+  AppProfilerStatistics statistics;
+  APP_Profiler_StatisticsReset(&statistics);
+  APP_Profiler_StatisticsAccount(&statistics, 100);
+  APP_Profiler_StatisticsAccount(&statistics, 120);
+  APP_Profiler_StatisticsAccount(&statistics, 5000);
+  EXPECT_EQ(statistics.num_calls, 3);
+  EXPECT_EQ(statistics.total_cycles, 5220);
+  EXPECT_EQ(statistics.max_cycles, 5000);
+  EXPECT_EQ(statistics.histogram[7], 2);
+  EXPECT_EQ(statistics.histogram[13], 1);
+  APP_Profiler_StatisticsReset(&statistics);
+  EXPECT_EQ(statistics.num_calls, 0);
+  EXPECT_EQ(statistics.max_cycles, 0);
+  EXPECT_EQ(statistics.histogram[7], 0);
+}
+
+TEST(AppProfiler, SchedulerTasksAreMeasured) {
+  AppSchedulerData scheduler;
+  APP_Scheduler_Initialize(&scheduler);
+  uint32_t fast_task_ticks = 10, slow_task_ticks = 1000;
+  APP_Scheduler_Register(&scheduler, "fast",
+                         slowTaskTasks, NULL, &fast_task_ticks);
+  APP_Scheduler_Register(&scheduler, "slow",
+                         slowTaskTasks, NULL, &slow_task_ticks);
+  for (int i = 0; i < 4; ++i) {
+    APP_Scheduler_Tasks(&scheduler);
+  }
+  const AppProfilerStatistics& fast_profile = scheduler.tasks[0].profile;
+  const AppProfilerStatistics& slow_profile = scheduler.tasks[1].profile;
+  EXPECT_EQ(fast_profile.num_calls, 4);
+  EXPECT_EQ(fast_profile.max_cycles, 10 * PROFILER_CYCLES_PER_TICK);
+  EXPECT_EQ(slow_profile.num_calls, 4);
+  EXPECT_EQ(slow_profile.total_cycles, 4 * 1000 * PROFILER_CYCLES_PER_TICK);
+  APP_Scheduler_StatisticsReset(&scheduler);
+  EXPECT_EQ(scheduler.tasks[1].profile.num_calls, 0);
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,321 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <chrono>
+#include <vector>
+
+extern "C" {
+#include "app_scheduler.h"
+}
+
+DEFINE_int32(scheduler_benchmark_passes, 200000,
+             "Number of main loop passes to simulate in the benchmark");
+
+namespace {
+
+// Current time of the system timer.
+uint64_t g_system_count = 0;
+
+}  // namespace
+
+extern "C" {
+
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return g_system_count;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+////////////////////////////////////////////////////////////////////////////////
+// Simple tasks for checking the dispatch logic.
+
+struct CountingTask {
+  bool is_runnable = false;
+  uint64_t deadline = APP_SCHEDULER_NO_DEADLINE;
+  int num_calls = 0;
+};
+
+void countingTaskTasks(void* user_data) {
+  ++static_cast<CountingTask*>(user_data)->num_calls;
+}
+
+bool countingTaskIsRunnable(void* user_data, uint64_t* next_deadline) {
+  const CountingTask* task = static_cast<CountingTask*>(user_data);
+  *next_deadline = task->deadline;
+  return task->is_runnable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Simulated module for the main loop benchmark.
+//
+// Mimics a polling state machine: every invocation pays for checking its
+// state, even if it turns out there is nothing to do. Work is triggered by
+// events delivered from "interrupts" and takes a number of passes to handle,
+// or by the time for the modules which poll something periodically.
+
+// Number of volatile operations it takes to check module state.
+const int kPollCost = 64;
+
+struct SimulatedModule {
+  // Configuration.
+  const char* name;
+  // Event is delivered every event_period passes, 0 means never.
+  int event_period;
+  // Number of passes it takes to handle the event.
+  int event_work;
+  // Interval of periodic tasks in system timer counts, 0 means none.
+  uint64_t poll_interval;
+
+  // Runtime state.
+  bool is_event_pending;
+  int remaining_work;
+  uint64_t next_poll_time;
+  int num_work_done;
+};
+
+void simulatedModuleTasks(void* user_data) {
+  SimulatedModule* module = static_cast<SimulatedModule*>(user_data);
+  volatile int state = 0;
+  for (int i = 0; i < kPollCost; ++i) {
+    state = state + i;
+  }
+  if (module->is_event_pending) {
+    module->is_event_pending = false;
+    module->remaining_work = module->event_work;
+  }
+  if (module->remaining_work > 0) {
+    --module->remaining_work;
+    ++module->num_work_done;
+  }
+  if (module->poll_interval != 0 &&
+      g_system_count >= module->next_poll_time) {
+    module->next_poll_time = g_system_count + module->poll_interval;
+    ++module->num_work_done;
+  }
+}
+
+bool simulatedModuleIsRunnable(void* user_data, uint64_t* next_deadline) {
+  const SimulatedModule* module = static_cast<SimulatedModule*>(user_data);
+  if (module->poll_interval != 0) {
+    *next_deadline = module->next_poll_time;
+  }
+  return module->is_event_pending || module->remaining_work > 0;
+}
+
+// Modules of the firmware, with a rough estimate of how often they've got
+// something to do when the device is showing a value. One pass is 10us.
+vector<SimulatedModule> firmwareModules() {
+  return {
+    // Polls connection status.
+    {"network", 0, 0, 50000},
+    // Rarely used.
+    {"usb_hid", 100000, 1, 0},
+    // I2C transfer of a command.
+    {"rtc", 20000, 20, 0},
+    // Only busy during mount.
+    {"flash", 0, 0, 0},
+    // Request every 5 seconds, waiting for the response.
+    {"https_client", 50000, 2000, 0},
+    // Animation at 50 fps.
+    {"nixie_player", 0, 0, 20000},
+    // Frame transmission.
+    {"shift_register", 2000, 115, 0},
+    // Periodic fetch once a second.
+    {"nixie", 0, 0, 1000000},
+    // Console commands.
+    {"command", 50000, 5, 0},
+  };
+}
+
+struct SimulationResult {
+  int num_dispatches = 0;
+  int num_work_done = 0;
+  double time_ns = 0.0;
+};
+
+// Simulate given number of main loop passes.
+//
+// If use_scheduler is false, all modules are invoked on every pass, which is
+// how the main loop used to work.
+SimulationResult simulateMainLoop(vector<SimulatedModule> modules,
+                                  bool use_scheduler,
+                                  int num_passes) {
+  AppSchedulerData scheduler;
+  APP_Scheduler_Initialize(&scheduler);
+  for (SimulatedModule& module : modules) {
+    module.is_event_pending = false;
+    module.remaining_work = 0;
+    module.next_poll_time = 0;
+    module.num_work_done = 0;
+    EXPECT_TRUE(APP_Scheduler_Register(&scheduler,
+                                       module.name,
+                                       simulatedModuleTasks,
+                                       simulatedModuleIsRunnable,
+                                       &module));
+  }
+  SimulationResult result;
+  g_system_count = 0;
+  auto start_time = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < num_passes; ++pass) {
+    for (SimulatedModule& module : modules) {
+      if (module.event_period != 0 && pass % module.event_period == 0) {
+        module.is_event_pending = true;
+      }
+    }
+    if (use_scheduler) {
+      APP_Scheduler_Tasks(&scheduler);
+    } else {
+      for (SimulatedModule& module : modules) {
+        simulatedModuleTasks(&module);
+      }
+    }
+    g_system_count += 10;
+  }
+  auto end_time = std::chrono::steady_clock::now();
+  result.time_ns =
+      std::chrono::duration<double, std::nano>(end_time - start_time).count();
+  if (use_scheduler) {
+    for (size_t i = 0; i < scheduler.num_tasks; ++i) {
+      result.num_dispatches += scheduler.tasks[i].num_dispatches;
+    }
+  } else {
+    result.num_dispatches = num_passes * modules.size();
+  }
+  for (const SimulatedModule& module : modules) {
+    result.num_work_done += module.num_work_done;
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(AppScheduler, TaskWithoutPredicateIsAlwaysDispatched) {
+  AppSchedulerData scheduler;
+  APP_Scheduler_Initialize(&scheduler);
+  CountingTask task;
+  APP_Scheduler_Register(&scheduler, "task", countingTaskTasks, NULL, &task);
+  for (int i = 0; i < 3; ++i) {
+    APP_Scheduler_Tasks(&scheduler);
+  }
+  EXPECT_EQ(task.num_calls, 3);
+  EXPECT_FALSE(APP_Scheduler_IsIdle(&scheduler));
+}
+
+TEST(AppScheduler, IdleTaskIsSkipped) {
+  AppSchedulerData scheduler;
+  APP_Scheduler_Initialize(&scheduler);
+  CountingTask idle_task, busy_task;
+  busy_task.is_runnable = true;
+  APP_Scheduler_Register(&scheduler, "idle",
+                         countingTaskTasks, countingTaskIsRunnable,
+                         &idle_task);
+  APP_Scheduler_Register(&scheduler, "busy",
+                         countingTaskTasks, countingTaskIsRunnable,
+                         &busy_task);
+  APP_Scheduler_Tasks(&scheduler);
+  EXPECT_EQ(idle_task.num_calls, 0);
+  EXPECT_EQ(busy_task.num_calls, 1);
+  EXPECT_FALSE(APP_Scheduler_IsIdle(&scheduler));
+  // Once busy task is done, whole loop becomes idle.
+  busy_task.is_runnable = false;
+  APP_Scheduler_Tasks(&scheduler);
+  EXPECT_EQ(busy_task.num_calls, 1);
+  EXPECT_TRUE(APP_Scheduler_IsIdle(&scheduler));
+  EXPECT_EQ(APP_Scheduler_NextDeadline(&scheduler), APP_SCHEDULER_NO_DEADLINE);
+  EXPECT_EQ(scheduler.tasks[0].num_skips, 2);
+  EXPECT_EQ(scheduler.num_passes, 2);
+  EXPECT_EQ(scheduler.num_idle_passes, 1);
+}
+
+TEST(AppScheduler, TaskIsDispatchedOnDeadline) {
+  AppSchedulerData scheduler;
+  APP_Scheduler_Initialize(&scheduler);
+  CountingTask early_task, late_task;
+  early_task.deadline = 100;
+  late_task.deadline = 200;
+  APP_Scheduler_Register(&scheduler, "late",
+                         countingTaskTasks, countingTaskIsRunnable,
+                         &late_task);
+  APP_Scheduler_Register(&scheduler, "early",
+                         countingTaskTasks, countingTaskIsRunnable,
+                         &early_task);
+  g_system_count = 99;
+  APP_Scheduler_Tasks(&scheduler);
+  EXPECT_EQ(early_task.num_calls, 0);
+  EXPECT_EQ(APP_Scheduler_NextDeadline(&scheduler), 100);
+  g_system_count = 100;
+  APP_Scheduler_Tasks(&scheduler);
+  EXPECT_EQ(early_task.num_calls, 1);
+  EXPECT_EQ(late_task.num_calls, 0);
+  EXPECT_EQ(APP_Scheduler_NextDeadline(&scheduler), 200);
+}
+
+TEST(AppScheduler, RegisterFailsWhenFull) {
+  AppSchedulerData scheduler;
+  APP_Scheduler_Initialize(&scheduler);
+  CountingTask task;
+  for (int i = 0; i < MAX_SCHEDULER_TASKS; ++i) {
+    EXPECT_TRUE(APP_Scheduler_Register(&scheduler, "task",
+                                       countingTaskTasks, NULL, &task));
+  }
+  EXPECT_FALSE(APP_Scheduler_Register(&scheduler, "task",
+                                      countingTaskTasks, NULL, &task));
+}
+
+TEST(AppScheduler, BenchmarkMainLoop) {
+  const vector<SimulatedModule> modules = firmwareModules();
+  const int num_passes = FLAGS_scheduler_benchmark_passes;
+  const SimulationResult naive = simulateMainLoop(modules, false, num_passes);
+  const SimulationResult scheduled =
+      simulateMainLoop(modules, true, num_passes);
+  // Skipping idle modules must not lose any work.
+  EXPECT_EQ(scheduled.num_work_done, naive.num_work_done);
+  EXPECT_LT(scheduled.num_dispatches, naive.num_dispatches / 4);
+  LOG(INFO) << num_passes << " passes, " << modules.size() << " modules, "
+            << naive.num_work_done << " units of work.";
+  LOG(INFO) << "Naive loop: " << naive.num_dispatches << " dispatches, "
+            << naive.time_ns / num_passes << " ns per pass.";
+  LOG(INFO) << "Scheduled loop: " << scheduled.num_dispatches
+            << " dispatches, "
+            << scheduled.time_ns / num_passes << " ns per pass.";
+  LOG(INFO) << "Saved " << naive.num_dispatches - scheduled.num_dispatches
+            << " dispatches ("
+            << 100.0 * (naive.num_dispatches - scheduled.num_dispatches) /
+               naive.num_dispatches
+            << "%), "
+            << (naive.time_ns - scheduled.time_ns) / num_passes
+            << " ns per pass.";
+}
+
+}  // namespace NixieTracker
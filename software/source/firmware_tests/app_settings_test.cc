@@ -0,0 +1,351 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sst25_emulator.h"
+
+extern "C" {
+#include "app_event.h"
+#include "app_flash_raw.h"
+#include "app_settings.h"
+#include "app_timer.h"
+}
+
+namespace NixieTracker {
+
+namespace {
+
+SST25Emulator* g_emulator = nullptr;
+
+}  // namespace
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+// System timer follows time of the emulated flash, in microseconds.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  if (NixieTracker::g_emulator == nullptr) {
+    return 0;
+  }
+  return NixieTracker::g_emulator->time() / 1000;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const uint32_t kEraseBlockSize = 4096;
+const int kNumSectors = APP_CONFIG_FLASH_SETTINGS_NUM_BLOCKS;
+
+// Size of the record of the given value in the log.
+uint32_t recordSize(const string& value) {
+  return value.size() + 4;
+}
+
+class SettingsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(emulator_.open());
+    emulator_.activate();
+    g_emulator = &emulator_;
+    boot();
+  }
+
+  void TearDown() override {
+    g_emulator = nullptr;
+    emulator_.deactivate();
+  }
+
+  // Initialize modules the way it happens at boot, and load settings.
+  void boot() {
+    APP_Timer_Initialize(&timer_wheel_);
+    APP_Event_Initialize(&event_bus_);
+    APP_FlashRaw_Initialize(&flash_raw_, &timer_wheel_);
+    APP_Settings_Initialize(&settings_, &flash_raw_, &event_bus_);
+    runUntilIdle();
+    ASSERT_TRUE(APP_Settings_IsLoaded(&settings_));
+  }
+
+  // Cut the power: commands which are not finished yet are lost, and
+  // the flash content is kept as is.
+  void powerLossAndBoot() {
+    const uint32_t size = emulator_.geometry().size;
+    const vector<uint8_t> image(emulator_.data(), emulator_.data() + size);
+    ASSERT_TRUE(emulator_.open());
+    memcpy(emulator_.data(), image.data(), size);
+    boot();
+  }
+
+  // Single iteration of the main loop.
+  //
+  // Returns false if nothing was runnable.
+  bool runTasks() {
+    APP_Timer_Tasks(&timer_wheel_);
+    APP_Event_Tasks(&event_bus_);
+    bool is_runnable = false;
+    if (APP_FlashRaw_IsRunnable(&flash_raw_)) {
+      APP_FlashRaw_Tasks(&flash_raw_);
+      is_runnable = true;
+    }
+    if (APP_Settings_IsRunnable(&settings_)) {
+      APP_Settings_Tasks(&settings_);
+      is_runnable = true;
+    }
+    return is_runnable;
+  }
+
+  // Advance time to the next event the modules might be waiting for.
+  //
+  // Returns false if there is no such event.
+  bool advanceTime() {
+    // Raw flash polls the driver while command is in progress, skip the time
+    // until it is over.
+    if (emulator_.isBusy()) {
+      emulator_.advanceToNextCompletion();
+      return true;
+    }
+    if (flash_raw_.state == APP_FLASH_RAW_STATE_OPEN) {
+      emulator_.advanceTime(1000 * 1000);
+      return true;
+    }
+    return false;
+  }
+
+  void runUntilIdle() {
+    for (int i = 0; i < 100000; ++i) {
+      if (!runTasks() && !advanceTime()) {
+        return;
+      }
+      advanceTime();
+    }
+    ADD_FAILURE() << "Settings did not become idle";
+  }
+
+  // Run the main loop until settings reach the given state, without letting
+  // the flash finish commands which were submitted on the way there.
+  void runUntilState(AppSettingsState state) {
+    for (int i = 0; i < 100000; ++i) {
+      const bool is_runnable = runTasks();
+      if (settings_.state == state) {
+        return;
+      }
+      if (!advanceTime() && !is_runnable) {
+        break;
+      }
+    }
+    ADD_FAILURE() << "Settings did not reach state " << state;
+  }
+
+  void set(AppSettingsKey key, const string& value) {
+    ASSERT_TRUE(APP_Settings_Set(&settings_, key, value.c_str()));
+    runUntilIdle();
+    EXPECT_FALSE(APP_Settings_IsDirty(&settings_));
+  }
+
+  string get(AppSettingsKey key) {
+    return APP_Settings_Get(&settings_, key);
+  }
+
+  uint8_t* sectorData(int sector) {
+    return emulator_.data() +
+           flash_raw_.region_address[APP_FLASH_RAW_REGION_SETTINGS] +
+           sector * kEraseBlockSize;
+  }
+
+  uint32_t sectorEraseCount(int sector) {
+    return emulator_.eraseCount(
+        flash_raw_.region_address[APP_FLASH_RAW_REGION_SETTINGS] /
+            kEraseBlockSize +
+        sector);
+  }
+
+  SST25Emulator emulator_;
+  AppTimerWheel timer_wheel_;
+  AppEventBus event_bus_;
+  AppFlashRawData flash_raw_;
+  AppSettingsData settings_;
+};
+
+}  // namespace
+
+TEST_F(SettingsTest, EmptyStore) {
+  EXPECT_FALSE(APP_Settings_IsError(&settings_));
+  EXPECT_EQ(settings_.active_sector, -1);
+  EXPECT_EQ(settings_.num_records_loaded, 0u);
+  for (int key = 0; key < APP_SETTINGS_NUM_KEYS; ++key) {
+    EXPECT_EQ(get(static_cast<AppSettingsKey>(key)), "");
+  }
+  // Nothing is written until some value is set.
+  EXPECT_EQ(emulator_.statistics().num_erases, 0u);
+  EXPECT_EQ(emulator_.statistics().num_bytes_programmed, 0u);
+  // The first value starts the log in the first sector.
+  set(APP_SETTINGS_KEY_NIXIE_INTERVAL, "60");
+  EXPECT_EQ(settings_.active_sector, 0);
+  EXPECT_EQ(settings_.num_compactions, 1u);
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.active_sector, 0);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_INTERVAL), "60");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_URL), "");
+}
+
+TEST_F(SettingsTest, AppendAcrossPageBoundary) {
+  set(APP_SETTINGS_KEY_NIXIE_INTERVAL, "60");
+  const uint32_t first_tail = settings_.tail_offset;
+  // Two long values don't fit into the same page, the second one goes to the
+  // beginning of the next page.
+  const string url = "https://example.com/" + string(100, 'u');
+  const string token = "Open Tasks " + string(112, 't');
+  ASSERT_LE(first_tail % APP_SETTINGS_PAGE_SIZE + recordSize(url),
+            APP_SETTINGS_PAGE_SIZE);
+  ASSERT_GT(first_tail % APP_SETTINGS_PAGE_SIZE + recordSize(url) +
+                recordSize(token),
+            APP_SETTINGS_PAGE_SIZE);
+  set(APP_SETTINGS_KEY_NIXIE_URL, url);
+  EXPECT_EQ(settings_.tail_offset, first_tail + recordSize(url));
+  set(APP_SETTINGS_KEY_NIXIE_TOKEN, token);
+  const uint32_t second_page =
+      first_tail - first_tail % APP_SETTINGS_PAGE_SIZE +
+      APP_SETTINGS_PAGE_SIZE;
+  EXPECT_EQ(settings_.tail_offset, second_page + recordSize(token));
+  // Appends stay in the same sector.
+  EXPECT_EQ(settings_.num_appends, 2u);
+  EXPECT_EQ(settings_.num_compactions, 1u);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.num_records_loaded, 3u);
+  EXPECT_EQ(settings_.tail_offset, second_page + recordSize(token));
+  EXPECT_FALSE(settings_.is_compaction_needed);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_INTERVAL), "60");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_URL), url);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_TOKEN), token);
+  // Log continues after the loaded tail.
+  set(APP_SETTINGS_KEY_NIXIE_INTERVAL, "30");
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.num_records_loaded, 4u);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_INTERVAL), "30");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_TOKEN), token);
+}
+
+TEST_F(SettingsTest, DamagedTailRecord) {
+  set(APP_SETTINGS_KEY_NIXIE_URL, "https://example.com/");
+  set(APP_SETTINGS_KEY_NIXIE_INTERVAL, "60");
+  set(APP_SETTINGS_KEY_NIXIE_INTERVAL, "30");
+  const int sector = settings_.active_sector;
+  // Power was lost while the last record was programmed, some of its bits
+  // are still set.
+  uint8_t* tail = sectorData(sector) + settings_.tail_offset;
+  tail[-1] = 0xff;
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.active_sector, sector);
+  EXPECT_TRUE(settings_.is_compaction_needed);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_URL), "https://example.com/");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_INTERVAL), "60");
+  // Nothing is appended after the damaged record, the next change moves the
+  // values to a new sector.
+  set(APP_SETTINGS_KEY_NIXIE_TOKEN, "Open Tasks");
+  EXPECT_EQ(settings_.active_sector, (sector + 1) % kNumSectors);
+  EXPECT_FALSE(settings_.is_compaction_needed);
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.active_sector, (sector + 1) % kNumSectors);
+  EXPECT_FALSE(settings_.is_compaction_needed);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_URL), "https://example.com/");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_INTERVAL), "60");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_TOKEN), "Open Tasks");
+}
+
+TEST_F(SettingsTest, PowerLossDuringCompaction) {
+  set(APP_SETTINGS_KEY_NIXIE_URL, "https://example.com/");
+  set(APP_SETTINGS_KEY_NIXIE_INTERVAL, "60");
+  const int sector = settings_.active_sector;
+  const uint32_t sequence = settings_.active_sequence;
+  // Values are written to the next sector, but its header is not.
+  APP_Settings_Compact(&settings_);
+  runUntilState(APP_SETTINGS_STATE_WAIT_COMPACT_COMMIT);
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.active_sector, sector);
+  EXPECT_EQ(settings_.active_sequence, sequence);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_URL), "https://example.com/");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_INTERVAL), "60");
+  // Incomplete sector is erased and written again by the next compaction.
+  emulator_.clearStatistics();
+  APP_Settings_Compact(&settings_);
+  runUntilIdle();
+  EXPECT_EQ(settings_.num_compactions, 1u);
+  EXPECT_EQ(emulator_.statistics().num_erases, 1u);
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.active_sector, (sector + 1) % kNumSectors);
+  EXPECT_EQ(settings_.active_sequence, sequence + 1);
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_URL), "https://example.com/");
+  EXPECT_EQ(get(APP_SETTINGS_KEY_NIXIE_INTERVAL), "60");
+}
+
+TEST_F(SettingsTest, SectorRotation) {
+  // Every value takes a page, so sector is filled after a few changes.
+  const uint32_t num_pages = kEraseBlockSize / APP_SETTINGS_PAGE_SIZE;
+  const int num_rounds = 3;
+  const int num_changes = num_rounds * kNumSectors * num_pages;
+  string value;
+  for (int i = 0; i < num_changes; ++i) {
+    value = std::to_string(i) + string(APP_SETTINGS_MAX_VALUE, 'v');
+    value.resize(APP_SETTINGS_MAX_VALUE);
+    set(static_cast<AppSettingsKey>(i % APP_SETTINGS_NUM_KEYS), value);
+  }
+  EXPECT_EQ(emulator_.statistics().num_program_violations, 0u);
+  // Sectors are used in a ring, so they wear equally.
+  EXPECT_GE(settings_.num_compactions, uint32_t(num_rounds * kNumSectors));
+  uint32_t min_erase_count = sectorEraseCount(0);
+  uint32_t max_erase_count = sectorEraseCount(0);
+  for (int sector = 1; sector < kNumSectors; ++sector) {
+    min_erase_count = std::min(min_erase_count, sectorEraseCount(sector));
+    max_erase_count = std::max(max_erase_count, sectorEraseCount(sector));
+  }
+  EXPECT_GE(min_erase_count, uint32_t(num_rounds));
+  EXPECT_LE(max_erase_count - min_erase_count, 1u);
+  // The most recent sector wins at boot, with the most recent values.
+  const int sector = settings_.active_sector;
+  const uint32_t sequence = settings_.active_sequence;
+  powerLossAndBoot();
+  EXPECT_EQ(settings_.active_sector, sector);
+  EXPECT_EQ(settings_.active_sequence, sequence);
+  EXPECT_EQ(get(static_cast<AppSettingsKey>((num_changes - 1) %
+                                            APP_SETTINGS_NUM_KEYS)),
+            value);
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,207 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#include "gpio_recorder.h"
+
+extern "C" {
+#include "app_event.h"
+#include "app_shift_register.h"
+}
+
+DEFINE_string(shift_register_vcd, "",
+              "Write waveform of a single frame transmission to the given "
+              "VCD file");
+DEFINE_int32(loop_iteration_ns, 10000,
+             "Simulated duration of a single main loop iteration");
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+AppEventBus* testEventBus() {
+  static AppEventBus app_event_bus;
+  APP_Event_Initialize(&app_event_bus);
+  return &app_event_bus;
+}
+
+void countEventCallback(const AppEvent* /*event*/, void* user_data) {
+  ++*static_cast<int*>(user_data);
+}
+
+// Send given data and run state machine until transmission is over.
+//
+// If recorder is given, simulated time is advanced by one main loop
+// iteration prior to every state machine iteration.
+//
+// Returns number of state machine iterations it took.
+int sendDataAndWait(AppShiftRegisterData* app_shift_register_data,
+                    vector<uint8_t> data,
+                    GPIOWaveformRecorder* recorder = nullptr) {
+  APP_ShiftRegister_SendData(app_shift_register_data, data.data(), data.size());
+  int num_iterations = 0;
+  while (APP_ShiftRegister_IsBusy(app_shift_register_data)) {
+    if (recorder != nullptr) {
+      recorder->advanceTime(FLAGS_loop_iteration_ns);
+    }
+    APP_ShiftRegister_Tasks(app_shift_register_data);
+    ++num_iterations;
+  }
+  return num_iterations;
+}
+
+}  // namespace
+
+TEST(AppShiftRegister, TransmissionFinishes) {
+  AppShiftRegisterData app_shift_register_data;
+  APP_ShiftRegister_Initialize(&app_shift_register_data, testEventBus());
+  EXPECT_FALSE(APP_ShiftRegister_IsBusy(&app_shift_register_data));
+  EXPECT_GT(sendDataAndWait(&app_shift_register_data, {0x12, 0x34}), 0);
+  EXPECT_FALSE(APP_ShiftRegister_IsBusy(&app_shift_register_data));
+}
+
+TEST(AppShiftRegister, CompletionEventIsPosted) {
+  AppEventBus* app_event_bus = testEventBus();
+  int num_events = 0;
+  APP_Event_Subscribe(app_event_bus,
+                      APP_EVENT_MASK(APP_EVENT_SHIFT_REGISTER_DONE),
+                      countEventCallback,
+                      &num_events);
+  AppShiftRegisterData app_shift_register_data;
+  APP_ShiftRegister_Initialize(&app_shift_register_data, app_event_bus);
+  const uint8_t data[] = {0x12};
+  APP_ShiftRegister_SendData(&app_shift_register_data, data, sizeof(data));
+  while (APP_ShiftRegister_IsBusy(&app_shift_register_data)) {
+    EXPECT_FALSE(APP_Event_HasPending(app_event_bus));
+    APP_ShiftRegister_Tasks(&app_shift_register_data);
+  }
+  EXPECT_TRUE(APP_Event_HasPending(app_event_bus));
+  APP_Event_Tasks(app_event_bus);
+  EXPECT_EQ(num_events, 1);
+  EXPECT_FALSE(APP_Event_HasPending(app_event_bus));
+}
+
+TEST(AppShiftRegister, DataIsClippedToChainLength) {
+  AppShiftRegisterData app_shift_register_data;
+  APP_ShiftRegister_Initialize(&app_shift_register_data, testEventBus());
+  vector<uint8_t> data(SHIFT_REGISTER_MAX_DATA * 2, 0xff);
+  APP_ShiftRegister_SendData(&app_shift_register_data, data.data(), data.size());
+  EXPECT_EQ(app_shift_register_data._private.send.num_bytes,
+            SHIFT_REGISTER_MAX_DATA);
+}
+
+TEST(AppShiftRegister, TransferTimePerChainLength) {
+  AppShiftRegisterData app_shift_register_data;
+  APP_ShiftRegister_Initialize(&app_shift_register_data, testEventBus());
+  const int num_repetitions = 1000;
+  int previous_num_iterations = 0, num_iterations_per_byte = 0;
+  for (int num_bytes = 1; num_bytes <= SHIFT_REGISTER_MAX_DATA; ++num_bytes) {
+    const vector<uint8_t> data(num_bytes, 0xa5);
+    int num_iterations = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_repetitions; ++i) {
+      num_iterations = sendDataAndWait(&app_shift_register_data, data);
+    }
+    auto end_time = std::chrono::steady_clock::now();
+    const double time_per_frame_ns =
+        std::chrono::duration<double, std::nano>(end_time - start_time).count() /
+        num_repetitions;
+    LOG(INFO) << "Chain of " << num_bytes << " register(s): "
+              << num_iterations << " iterations, "
+              << time_per_frame_ns << " ns per frame.";
+    // Transfer time is expected to grow linearly with the chain length.
+    if (num_bytes > 2) {
+      EXPECT_EQ(num_iterations - previous_num_iterations,
+                num_iterations_per_byte);
+    }
+    num_iterations_per_byte = num_iterations - previous_num_iterations;
+    previous_num_iterations = num_iterations;
+  }
+}
+
+TEST(AppShiftRegister, LatchedFrameMatchesRequested) {
+  GPIOWaveformRecorder recorder;
+  recorder.activate();
+  AppShiftRegisterData app_shift_register_data;
+  APP_ShiftRegister_Initialize(&app_shift_register_data, testEventBus());
+  const vector<uint8_t> data = {0x01, 0x80, 0xa5, 0x5a, 0xff, 0x00};
+  sendDataAndWait(&app_shift_register_data, data, &recorder);
+  // NOTE: Registers are wired via inverter.
+  ShiftRegisterChainDecoder decoder(data.size(), true);
+  const vector<vector<uint8_t>> frames = decoder.decode(recorder.edges());
+  ASSERT_EQ(frames.size(), 1);
+  EXPECT_EQ(frames[0], data);
+  if (!FLAGS_shift_register_vcd.empty()) {
+    std::ofstream stream(FLAGS_shift_register_vcd);
+    recorder.writeVCD(&stream);
+  }
+}
+
+TEST(AppShiftRegister, LatchedFramesSequence) {
+  GPIOWaveformRecorder recorder;
+  recorder.activate();
+  AppShiftRegisterData app_shift_register_data;
+  APP_ShiftRegister_Initialize(&app_shift_register_data, testEventBus());
+  const vector<vector<uint8_t>> data = {{0x12, 0x34, 0x56},
+                                        {0x00, 0x00, 0x00},
+                                        {0xfe, 0xdc, 0xba}};
+  for (const vector<uint8_t>& frame : data) {
+    sendDataAndWait(&app_shift_register_data, frame, &recorder);
+  }
+  ShiftRegisterChainDecoder decoder(3, true);
+  EXPECT_EQ(decoder.decode(recorder.edges()), data);
+}
+
+TEST(AppShiftRegister, EdgesPerFrame) {
+  GPIOWaveformRecorder recorder;
+  recorder.activate();
+  AppShiftRegisterData app_shift_register_data;
+  APP_ShiftRegister_Initialize(&app_shift_register_data, testEventBus());
+  for (int num_bytes = 1; num_bytes <= SHIFT_REGISTER_MAX_DATA; ++num_bytes) {
+    // Alternating bits is the worst case for the data line.
+    const vector<uint8_t> data(num_bytes, 0x55);
+    recorder.clear();
+    const uint64_t start_time = recorder.time();
+    const int num_iterations =
+        sendDataAndWait(&app_shift_register_data, data, &recorder);
+    const uint64_t frame_time_ns = recorder.time() - start_time;
+    const int num_srck_edges = recorder.numEdges(STUB_GPIO_PIN_SHIFT_SRCK);
+    LOG(INFO) << "Chain of " << num_bytes << " register(s): "
+              << recorder.edges().size() << " edges ("
+              << num_srck_edges << " SRCK, "
+              << recorder.numEdges(STUB_GPIO_PIN_SHIFT_DATA) << " DATA), "
+              << num_iterations << " iterations, "
+              << frame_time_ns / 1000.0 << " us per frame.";
+    // Every bit is one pulse of the shift clock.
+    EXPECT_EQ(num_srck_edges, num_bytes * 8 * 2);
+    EXPECT_EQ(recorder.numEdges(STUB_GPIO_PIN_SHIFT_RCK), 2);
+  }
+}
+
+}  // namespace NixieTracker
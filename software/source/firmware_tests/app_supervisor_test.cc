@@ -0,0 +1,228 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+extern "C" {
+#include "app_supervisor.h"
+#include "xc.h"
+}
+
+namespace {
+
+// Current time of the system timer.
+uint64_t g_system_count = 0;
+
+}  // namespace
+
+extern "C" {
+
+volatile uint32_t WDTCONSET = 0;
+volatile uint32_t RCON = 0;
+volatile uint32_t RCONCLR = 0;
+
+// Use different from millisecond resolution, to catch conversion issues.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 10000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return g_system_count;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+namespace {
+
+// Simulated module, state 0 is the idle one.
+struct TestModule {
+  int state = 0;
+  int num_recovers = 0;
+};
+
+int testModuleState(void* user_data) {
+  return static_cast<TestModule*>(user_data)->state;
+}
+
+uint32_t testModuleBudget(void* /*user_data*/, int state) {
+  return (state == 0) ? APP_SUPERVISOR_NO_BUDGET : 1000;
+}
+
+void testModuleRecover(void* user_data) {
+  TestModule* module = static_cast<TestModule*>(user_data);
+  module->state = 0;
+  ++module->num_recovers;
+}
+
+// Run supervisor tasks for the given time, returns number of times the
+// watchdog was fed.
+int runForMs(AppSupervisorData* supervisor, uint64_t num_ms) {
+  int num_feeds = 0;
+  for (uint64_t i = 0; i < num_ms; ++i) {
+    g_system_count += 10;
+    WDTCONSET = 0;
+    APP_Supervisor_Tasks(supervisor);
+    if (WDTCONSET & _WDTCON_WDTCLR_MASK) {
+      ++num_feeds;
+    }
+  }
+  return num_feeds;
+}
+
+void initializeSupervisor(AppSupervisorData* supervisor) {
+  g_system_count = 0;
+  RCON = 0;
+  WDTCONSET = 0;
+  APP_Supervisor_Initialize(supervisor);
+}
+
+}  // namespace
+
+TEST(AppSupervisor, WatchdogIsEnabled) {
+  AppSupervisorData supervisor;
+  initializeSupervisor(&supervisor);
+  EXPECT_TRUE(WDTCONSET & _WDTCON_ON_MASK);
+  EXPECT_FALSE(supervisor.is_watchdog_reset);
+}
+
+TEST(AppSupervisor, WatchdogResetIsDetected) {
+  AppSupervisorData supervisor;
+  RCON = _RCON_WDTO_MASK;
+  RCONCLR = 0;
+  APP_Supervisor_Initialize(&supervisor);
+  EXPECT_TRUE(supervisor.is_watchdog_reset);
+  EXPECT_EQ(RCONCLR, _RCON_WDTO_MASK);
+}
+
+TEST(AppSupervisor, ProgressingModuleFeedsWatchdog) {
+  AppSupervisorData supervisor;
+  initializeSupervisor(&supervisor);
+  TestModule module;
+  ASSERT_TRUE(APP_Supervisor_Register(&supervisor, "test",
+                                      testModuleState, testModuleBudget,
+                                      testModuleRecover,
+                                      &module));
+  int num_feeds = 0;
+  // Module changes its state more often than the budget.
+  for (int i = 0; i < 20; ++i) {
+    module.state = 1 + (i % 2);
+    num_feeds += runForMs(&supervisor, 500);
+  }
+  // Module in a state without budget is never stalled.
+  module.state = 0;
+  num_feeds += runForMs(&supervisor, 10000);
+  EXPECT_EQ(supervisor.num_stalls, 0);
+  EXPECT_EQ(module.num_recovers, 0);
+  // Watchdog is fed on every check.
+  EXPECT_EQ(num_feeds, 20000 / APP_CONFIG_SUPERVISOR_CHECK_INTERVAL);
+}
+
+TEST(AppSupervisor, StallIsRecovered) {
+  AppSupervisorData supervisor;
+  initializeSupervisor(&supervisor);
+  TestModule module;
+  APP_Supervisor_Register(&supervisor, "test",
+                          testModuleState, testModuleBudget,
+                          testModuleRecover,
+                          &module);
+  module.state = 1;
+  const int num_feeds = runForMs(&supervisor, 1000);
+  EXPECT_EQ(module.num_recovers, 0);
+  EXPECT_EQ(runForMs(&supervisor, 1000) + num_feeds,
+            2000 / APP_CONFIG_SUPERVISOR_CHECK_INTERVAL);
+  EXPECT_EQ(module.num_recovers, 1);
+  EXPECT_EQ(module.state, 0);
+  ASSERT_EQ(supervisor.num_stalls, 1);
+  const AppSupervisorStall* stall = APP_Supervisor_StallGet(&supervisor, 0);
+  ASSERT_NE(stall, nullptr);
+  EXPECT_STREQ(stall->name, "test");
+  EXPECT_EQ(stall->state, 1);
+  EXPECT_GT(stall->duration_ms, 1000);
+  EXPECT_LE(stall->duration_ms, 1000 + APP_CONFIG_SUPERVISOR_CHECK_INTERVAL);
+  EXPECT_TRUE(stall->is_recovered);
+  EXPECT_EQ(APP_Supervisor_StallGet(&supervisor, 1), nullptr);
+}
+
+TEST(AppSupervisor, StallWithoutRecoveryStarvesWatchdog) {
+  AppSupervisorData supervisor;
+  initializeSupervisor(&supervisor);
+  TestModule module;
+  APP_Supervisor_Register(&supervisor, "test",
+                          testModuleState, testModuleBudget,
+                          NULL,
+                          &module);
+  module.state = 1;
+  runForMs(&supervisor, 1200);
+  EXPECT_FALSE(supervisor.is_watchdog_fed);
+  EXPECT_EQ(runForMs(&supervisor, 5000), 0);
+  // Stall is only reported once.
+  EXPECT_EQ(supervisor.num_stalls, 1);
+  EXPECT_FALSE(APP_Supervisor_StallGet(&supervisor, 0)->is_recovered);
+  // Module is unstuck, feeding is resumed.
+  module.state = 2;
+  EXPECT_GT(runForMs(&supervisor, 500), 0);
+  EXPECT_TRUE(supervisor.is_watchdog_fed);
+}
+
+TEST(AppSupervisor, StallHistoryKeepsMostRecent) {
+  AppSupervisorData supervisor;
+  initializeSupervisor(&supervisor);
+  TestModule module;
+  APP_Supervisor_Register(&supervisor, "test",
+                          testModuleState, testModuleBudget,
+                          testModuleRecover,
+                          &module);
+  const int num_stalls = APP_CONFIG_NUM_SUPERVISOR_STALLS + 3;
+  for (int i = 0; i < num_stalls; ++i) {
+    module.state = i + 1;
+    runForMs(&supervisor, 1200);
+  }
+  EXPECT_EQ(supervisor.num_stalls, num_stalls);
+  for (int i = 0; i < APP_CONFIG_NUM_SUPERVISOR_STALLS; ++i) {
+    const AppSupervisorStall* stall = APP_Supervisor_StallGet(&supervisor, i);
+    ASSERT_NE(stall, nullptr);
+    EXPECT_EQ(stall->state, num_stalls - i);
+  }
+  EXPECT_EQ(APP_Supervisor_StallGet(&supervisor,
+                                    APP_CONFIG_NUM_SUPERVISOR_STALLS),
+            nullptr);
+}
+
+TEST(AppSupervisor, TooManyModules) {
+  AppSupervisorData supervisor;
+  initializeSupervisor(&supervisor);
+  TestModule module;
+  for (int i = 0; i < APP_CONFIG_NUM_SUPERVISOR_MODULES; ++i) {
+    EXPECT_TRUE(APP_Supervisor_Register(&supervisor, "test",
+                                        testModuleState, testModuleBudget,
+                                        testModuleRecover,
+                                        &module));
+  }
+  EXPECT_FALSE(APP_Supervisor_Register(&supervisor, "test",
+                                       testModuleState, testModuleBudget,
+                                       testModuleRecover,
+                                       &module));
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,225 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <cstdlib>
+
+#include "mcp7940n_simulator.h"
+
+extern "C" {
+#include "app_event.h"
+#include "app_rtc.h"
+#include "app_time_sync.h"
+#include "app_timer.h"
+}
+
+namespace {
+
+// Simulated time is owned by the RTC model, system timer and SNTP follow it.
+NixieTracker::MCP7940NSimulator* g_simulator = nullptr;
+
+// SNTP time at the beginning of the simulation: 2017-06-15 12:00:00 UTC.
+const uint32_t kSNTPStartTime = 1497528000;
+
+uint64_t simulatedTimeMs() {
+  return g_simulator->time() / 1000000;
+}
+
+}  // namespace
+
+extern "C" {
+
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 1000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return simulatedTimeMs();
+}
+
+uint32_t TCPIP_SNTP_UTCSecondsGet(void) {
+  return kSNTPStartTime + simulatedTimeMs() / 1000;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+namespace {
+
+// Timing of 400 kHz bus, same as in the RTC driver tests.
+const uint64_t kI2CLatencyNS = 25000;
+const uint64_t kI2CByteTimeNS = 22500;
+
+// Simulated duration of a single main loop iteration.
+const uint64_t kLoopIterationNS = 10000;
+
+// Fast crystal, gains 2 seconds in a bit more than a day.
+const int32_t kCrystalErrorPPB = 20000;
+
+RTC_MCP7940N_DateTime makeDateTime(int year, int month, int day,
+                                   int day_of_week,
+                                   int hours, int minutes, int seconds) {
+  RTC_MCP7940N_DateTime date_time;
+  date_time.year = year - 2000;
+  date_time.month = month;
+  date_time.day = day;
+  date_time.day_of_week = day_of_week;
+  date_time.hours = hours;
+  date_time.minutes = minutes;
+  date_time.seconds = seconds;
+  return date_time;
+}
+
+class AppTimeSyncTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    g_simulator = &simulator_;
+    simulator_.activate();
+    simulator_.setTransferTiming(kI2CLatencyNS, kI2CByteTimeNS);
+    simulator_.setCrystalError(kCrystalErrorPPB);
+    APP_Event_Initialize(&app_event_bus_);
+    APP_Timer_Initialize(&app_timer_wheel_);
+    APP_RTC_Initialize(&app_rtc_data_, &app_event_bus_);
+    APP_TimeSync_Initialize(&app_time_sync_data_,
+                            &app_rtc_data_,
+                            &app_timer_wheel_);
+  }
+
+  void TearDown() override {
+    simulator_.deactivate();
+    g_simulator = nullptr;
+  }
+
+  // Run RTC driver until the queued communication is over.
+  void runRTCUntilIdle() {
+    RTC_MCP7940N* rtc = &app_rtc_data_.rtc_handle;
+    for (int i = 0; i < 10000 && RTC_MCP7940N_IsBusy(rtc); ++i) {
+      RTC_MCP7940N_Tasks(rtc);
+      simulator_.advanceTime(kLoopIterationNS);
+    }
+    EXPECT_FALSE(RTC_MCP7940N_IsBusy(rtc));
+  }
+
+  // Set RTC date and time and start its oscillator.
+  void coldStart(const RTC_MCP7940N_DateTime& date_time) {
+    RTC_MCP7940N_Batch batch;
+    RTC_MCP7940N_BatchInitialize(&batch);
+    RTC_MCP7940N_BatchSetDateAndTime(&batch, &date_time);
+    RTC_MCP7940N_BatchEnableOscillator(&batch, true);
+    EXPECT_TRUE(RTC_MCP7940N_WriteBatch(&app_rtc_data_.rtc_handle,
+                                        &batch,
+                                        nullptr, nullptr));
+    runRTCUntilIdle();
+  }
+
+  // Run time synchronization until it is done with the comparison and the
+  // correction.
+  void runSync() {
+    APP_TimeSync_Request(&app_time_sync_data_);
+    for (int i = 0;
+         i < 10000 && app_time_sync_data_.state != APP_TIME_SYNC_STATE_IDLE;
+         ++i) {
+      APP_TimeSync_Tasks(&app_time_sync_data_);
+      RTC_MCP7940N_Tasks(&app_rtc_data_.rtc_handle);
+      simulator_.advanceTime(kLoopIterationNS);
+    }
+    EXPECT_EQ(app_time_sync_data_.state, APP_TIME_SYNC_STATE_IDLE);
+  }
+
+  // Wait for the currently scheduled interval and synchronize again.
+  //
+  // Timer wheel is not used here, so months of the simulated time do not
+  // take millions of ticks.
+  void waitAndSync() {
+    simulator_.advanceTime(app_time_sync_data_.interval * 1000000000ull);
+    runSync();
+  }
+
+  // Drift of the RTC in parts per billion with the current calibration trim.
+  int32_t residualErrorPPB() {
+    const uint8_t calibration =
+        simulator_.registerValue(MCP7940N_REG_ADDR_CALIB);
+    return kCrystalErrorPPB + RTC_MCP7940N_CalibrationToPPB(calibration);
+  }
+
+  MCP7940NSimulator simulator_;
+  AppEventBus app_event_bus_;
+  AppTimerWheel app_timer_wheel_;
+  AppRTCData app_rtc_data_;
+  AppTimeSyncData app_time_sync_data_;
+};
+
+}  // namespace
+
+TEST_F(AppTimeSyncTest, StepsRTCToSNTPTime) {
+  // RTC is a minute ahead.
+  coldStart(makeDateTime(2017, 6, 15, 4, 12, 1, 0));
+  runSync();
+  ASSERT_EQ(app_time_sync_data_.num_corrections, 1);
+  const AppTimeSyncCorrection* correction =
+      APP_TimeSync_CorrectionGet(&app_time_sync_data_, 0);
+  EXPECT_EQ(correction->offset, 60);
+  EXPECT_EQ(correction->drift_ppb, 0);
+  EXPECT_EQ(app_time_sync_data_.interval, APP_CONFIG_TIME_SYNC_MIN_INTERVAL);
+  EXPECT_EQ(simulator_.registerValue(MCP7940N_REG_ADDR_HOURS), 0x12);
+  EXPECT_EQ(simulator_.registerValue(MCP7940N_REG_ADDR_MINUNTES), 0x00);
+  // Small offset does not need a step, only the interval grows.
+  waitAndSync();
+  EXPECT_EQ(app_time_sync_data_.num_corrections, 1);
+  EXPECT_EQ(app_time_sync_data_.interval,
+            2 * APP_CONFIG_TIME_SYNC_MIN_INTERVAL);
+}
+
+TEST_F(AppTimeSyncTest, CalibrationConverges) {
+  coldStart(makeDateTime(2017, 6, 15, 4, 12, 0, 0));
+  runSync();
+  EXPECT_EQ(app_time_sync_data_.num_corrections, 0);
+  // Simulate a couple of months of synchronization.
+  const uint64_t end_time_ns = 60ull * 24 * 3600 * 1000000000ull;
+  int num_drift_corrections = 0;
+  while (simulator_.time() < end_time_ns) {
+    const int num_corrections = app_time_sync_data_.num_corrections;
+    waitAndSync();
+    if (app_time_sync_data_.num_corrections == num_corrections) {
+      continue;
+    }
+    const AppTimeSyncCorrection* correction =
+        APP_TimeSync_CorrectionGet(&app_time_sync_data_, 0);
+    // RTC runs fast before it converges, so it is only ever ahead.
+    EXPECT_GT(correction->offset, 0);
+    EXPECT_GT(correction->drift_ppb, 0);
+    ++num_drift_corrections;
+  }
+  EXPECT_GE(num_drift_corrections, 2);
+  // Fast crystal is slowed down by the trim.
+  const uint8_t calibration =
+      simulator_.registerValue(MCP7940N_REG_ADDR_CALIB);
+  EXPECT_EQ(calibration, app_time_sync_data_.calibration);
+  EXPECT_FALSE(calibration & MCP7940N_FLAG_CALIB_SIGN);
+  EXPECT_LE(abs(residualErrorPPB()), 2 * RTC_MCP7940N_CALIBRATION_STEP_PPB);
+  // Once converged, comparisons happen as rarely as possible.
+  EXPECT_EQ(app_time_sync_data_.interval, APP_CONFIG_TIME_SYNC_MAX_INTERVAL);
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,261 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "app_timer.h"
+}
+
+namespace {
+
+// Current time of the system timer.
+uint64_t g_system_count = 0;
+
+}  // namespace
+
+extern "C" {
+
+// Use different from millisecond resolution, to catch conversion issues.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void) {
+  return 10000;
+}
+
+uint64_t SYS_TMR_SystemCountGet(void) {
+  return g_system_count;
+}
+
+}  // extern "C"
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+struct ExpirationRecord {
+  int num_expirations = 0;
+  uint64_t expired_at_ms = 0;
+};
+
+void recordExpiration(void* user_data) {
+  ExpirationRecord* record = static_cast<ExpirationRecord*>(user_data);
+  ++record->num_expirations;
+  record->expired_at_ms = g_system_count / 10;
+}
+
+void setTimeMs(uint64_t time_ms) {
+  g_system_count = time_ms * 10;
+}
+
+// Timer which re-starts itself from the callback with zero timeout, and
+// optionally cancels another timer.
+struct RestartingTimer {
+  AppTimerWheel* wheel = nullptr;
+  AppTimer timer;
+  ExpirationRecord record;
+  AppTimer* timer_to_cancel = nullptr;
+};
+
+void restartExpired(void* user_data) {
+  RestartingTimer* restarting = static_cast<RestartingTimer*>(user_data);
+  recordExpiration(&restarting->record);
+  APP_Timer_Start(restarting->wheel, &restarting->timer, 0);
+  if (restarting->timer_to_cancel != nullptr) {
+    APP_Timer_Cancel(restarting->wheel, restarting->timer_to_cancel);
+  }
+}
+
+// Advance time millisecond by millisecond, running timer tasks.
+void advanceTimeMs(AppTimerWheel* wheel, uint64_t num_ms) {
+  for (uint64_t i = 0; i < num_ms; ++i) {
+    g_system_count += 10;
+    APP_Timer_Tasks(wheel);
+  }
+}
+
+}  // namespace
+
+TEST(AppTimer, ExpiresOnTime) {
+  AppTimerWheel wheel;
+  // Cover all levels of the wheel, and timeout which is beyond them.
+  const vector<uint32_t> timeouts = {1, 63, 64, 65, 1000, 4095, 4096, 4097,
+                                     100000, 262143, 262144, 300000};
+  for (uint32_t timeout : timeouts) {
+    setTimeMs(12345);
+    APP_Timer_Initialize(&wheel);
+    ExpirationRecord record;
+    AppTimer timer;
+    APP_Timer_Setup(&timer, recordExpiration, &record);
+    APP_Timer_Start(&wheel, &timer, timeout);
+    EXPECT_TRUE(APP_Timer_IsArmed(&timer));
+    advanceTimeMs(&wheel, timeout - 1);
+    EXPECT_EQ(record.num_expirations, 0) << "Timeout " << timeout;
+    EXPECT_FALSE(APP_Timer_IsExpired(&timer));
+    advanceTimeMs(&wheel, 1);
+    EXPECT_EQ(record.num_expirations, 1) << "Timeout " << timeout;
+    EXPECT_EQ(record.expired_at_ms, 12345 + timeout);
+    EXPECT_TRUE(APP_Timer_IsExpired(&timer));
+    EXPECT_FALSE(APP_Timer_IsArmed(&timer));
+    EXPECT_EQ(wheel.num_armed, 0);
+  }
+}
+
+TEST(AppTimer, Cancel) {
+  setTimeMs(0);
+  AppTimerWheel wheel;
+  APP_Timer_Initialize(&wheel);
+  ExpirationRecord records[3];
+  AppTimer timers[3];
+  // Timers share the same slot, so cancelling one of them checks that the
+  // slot list stays consistent.
+  for (int i = 0; i < 3; ++i) {
+    APP_Timer_Setup(&timers[i], recordExpiration, &records[i]);
+    APP_Timer_Start(&wheel, &timers[i], 10);
+  }
+  APP_Timer_Cancel(&wheel, &timers[1]);
+  APP_Timer_Cancel(&wheel, &timers[1]);
+  EXPECT_EQ(wheel.num_armed, 2);
+  advanceTimeMs(&wheel, 10);
+  EXPECT_EQ(records[0].num_expirations, 1);
+  EXPECT_EQ(records[1].num_expirations, 0);
+  EXPECT_EQ(records[2].num_expirations, 1);
+}
+
+TEST(AppTimer, Restart) {
+  setTimeMs(0);
+  AppTimerWheel wheel;
+  APP_Timer_Initialize(&wheel);
+  ExpirationRecord record;
+  AppTimer timer;
+  APP_Timer_Setup(&timer, recordExpiration, &record);
+  APP_Timer_Start(&wheel, &timer, 5000);
+  advanceTimeMs(&wheel, 4000);
+  // Restarting timer which was moved to the lower level of the wheel.
+  APP_Timer_Start(&wheel, &timer, 100);
+  advanceTimeMs(&wheel, 2000);
+  EXPECT_EQ(record.num_expirations, 1);
+  EXPECT_EQ(record.expired_at_ms, 4100);
+}
+
+TEST(AppTimer, RestartFromCallback) {
+  setTimeMs(0);
+  AppTimerWheel wheel;
+  APP_Timer_Initialize(&wheel);
+  RestartingTimer restarting;
+  restarting.wheel = &wheel;
+  APP_Timer_Setup(&restarting.timer, restartExpired, &restarting);
+  APP_Timer_Start(&wheel, &restarting.timer, 5);
+  // Zero timeout from the callback means the next tick, not the current one.
+  advanceTimeMs(&wheel, 10);
+  EXPECT_EQ(restarting.record.num_expirations, 6);
+  EXPECT_EQ(restarting.record.expired_at_ms, 10);
+  EXPECT_TRUE(APP_Timer_IsArmed(&restarting.timer));
+  // Stalled main loop catches up without getting stuck on the timer.
+  setTimeMs(100);
+  APP_Timer_Tasks(&wheel);
+  EXPECT_GT(restarting.record.num_expirations, 6);
+  EXPECT_TRUE(APP_Timer_IsArmed(&restarting.timer));
+  EXPECT_EQ(wheel.num_armed, 1);
+}
+
+TEST(AppTimer, CancelFromCallback) {
+  setTimeMs(0);
+  AppTimerWheel wheel;
+  APP_Timer_Initialize(&wheel);
+  ExpirationRecord record;
+  AppTimer timer;
+  RestartingTimer restarting;
+  restarting.wheel = &wheel;
+  restarting.timer_to_cancel = &timer;
+  // Both timers expire at the same tick, the one which was started last is
+  // handled first and cancels the other one.
+  APP_Timer_Setup(&timer, recordExpiration, &record);
+  APP_Timer_Start(&wheel, &timer, 10);
+  APP_Timer_Setup(&restarting.timer, restartExpired, &restarting);
+  APP_Timer_Start(&wheel, &restarting.timer, 10);
+  advanceTimeMs(&wheel, 10);
+  EXPECT_EQ(restarting.record.num_expirations, 1);
+  EXPECT_EQ(record.num_expirations, 0);
+  EXPECT_FALSE(APP_Timer_IsArmed(&timer));
+  EXPECT_EQ(wheel.num_armed, 1);
+}
+
+TEST(AppTimer, NextExpiry) {
+  setTimeMs(1000);
+  AppTimerWheel wheel;
+  APP_Timer_Initialize(&wheel);
+  EXPECT_EQ(APP_Timer_NextExpiry(&wheel), UINT64_MAX);
+  AppTimer timer;
+  APP_Timer_Setup(&timer, NULL, NULL);
+  APP_Timer_Start(&wheel, &timer, 10);
+  EXPECT_EQ(APP_Timer_NextExpiry(&wheel), 1010 * 10);
+  // Long timers wake the loop up earlier, to move them between wheel levels,
+  // but never later than they expire.
+  APP_Timer_Start(&wheel, &timer, 10000);
+  const uint64_t next_expiry = APP_Timer_NextExpiry(&wheel);
+  EXPECT_GT(next_expiry, 1000 * 10);
+  EXPECT_LE(next_expiry, 11000 * 10);
+}
+
+TEST(AppTimer, RandomTimers) {
+  std::mt19937 random_generator(123);
+  std::uniform_int_distribution<uint32_t> timeout_distribution(0, 20000);
+  setTimeMs(0);
+  AppTimerWheel wheel;
+  APP_Timer_Initialize(&wheel);
+  const int num_timers = 500;
+  vector<AppTimer> timers(num_timers);
+  vector<ExpirationRecord> records(num_timers);
+  vector<uint64_t> expected_expiration_ms(num_timers);
+  uint64_t time_ms = 0;
+  for (int i = 0; i < num_timers; ++i) {
+    const uint32_t timeout = timeout_distribution(random_generator);
+    APP_Timer_Setup(&timers[i], recordExpiration, &records[i]);
+    APP_Timer_Start(&wheel, &timers[i], timeout);
+    expected_expiration_ms[i] = time_ms + timeout;
+    // Let time advance in between of starting timers.
+    if (i % 10 == 0) {
+      advanceTimeMs(&wheel, 1);
+      ++time_ms;
+    }
+  }
+  // Jump over multiple milliseconds at once, as if the main loop was stalled.
+  const int time_step_ms = 7;
+  while (wheel.num_armed != 0) {
+    time_ms += time_step_ms;
+    setTimeMs(time_ms);
+    APP_Timer_Tasks(&wheel);
+    ASSERT_LT(time_ms, 30000);
+  }
+  for (int i = 0; i < num_timers; ++i) {
+    EXPECT_EQ(records[i].num_expirations, 1);
+    EXPECT_GE(records[i].expired_at_ms, expected_expiration_ms[i]);
+    EXPECT_LT(records[i].expired_at_ms,
+              expected_expiration_ms[i] + time_step_ms);
+  }
+}
+
+}  // namespace NixieTracker
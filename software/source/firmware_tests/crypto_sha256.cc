@@ -0,0 +1,164 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+// Plain SHA-256 (FIPS 180-4) behind the Harmony crypto API, so firmware code
+// which hashes data can be tested on the host.
+
+#include "crypto/crypto.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+struct Sha256State {
+  uint32_t h[8];
+  uint64_t num_bytes;
+  uint8_t block[64];
+  uint32_t block_len;
+};
+
+static_assert(sizeof(Sha256State) <= sizeof(CRYPT_SHA256_CTX),
+              "SHA-256 state does not fit the context");
+
+const uint32_t kRoundConstants[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+uint32_t rotr(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+Sha256State* state(CRYPT_SHA256_CTX* sha256) {
+  return reinterpret_cast<Sha256State*>(sha256->holder);
+}
+
+void transform(Sha256State* s, const uint8_t* block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; ++i) {
+    w[i] = (uint32_t(block[i * 4]) << 24) |
+           (uint32_t(block[i * 4 + 1]) << 16) |
+           (uint32_t(block[i * 4 + 2]) << 8) |
+           uint32_t(block[i * 4 + 3]);
+  }
+  for (int i = 16; i < 64; ++i) {
+    const uint32_t s0 =
+        rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    const uint32_t s1 =
+        rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = s->h[0], b = s->h[1], c = s->h[2], d = s->h[3];
+  uint32_t e = s->h[4], f = s->h[5], g = s->h[6], h = s->h[7];
+  for (int i = 0; i < 64; ++i) {
+    const uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+    const uint32_t ch = (e & f) ^ (~e & g);
+    const uint32_t t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+    const uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+    const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    const uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  s->h[0] += a;
+  s->h[1] += b;
+  s->h[2] += c;
+  s->h[3] += d;
+  s->h[4] += e;
+  s->h[5] += f;
+  s->h[6] += g;
+  s->h[7] += h;
+}
+
+}  // namespace
+
+extern "C" {
+
+int CRYPT_SHA256_Initialize(CRYPT_SHA256_CTX* sha256) {
+  static const uint32_t kInitialHash[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  Sha256State* s = state(sha256);
+  memcpy(s->h, kInitialHash, sizeof(s->h));
+  s->num_bytes = 0;
+  s->block_len = 0;
+  return 0;
+}
+
+int CRYPT_SHA256_DataAdd(CRYPT_SHA256_CTX* sha256,
+                         const unsigned char* input,
+                         unsigned int sz) {
+  Sha256State* s = state(sha256);
+  s->num_bytes += sz;
+  while (sz != 0) {
+    const uint32_t num_copy_bytes =
+        std::min<uint32_t>(sz, sizeof(s->block) - s->block_len);
+    memcpy(s->block + s->block_len, input, num_copy_bytes);
+    s->block_len += num_copy_bytes;
+    input += num_copy_bytes;
+    sz -= num_copy_bytes;
+    if (s->block_len == sizeof(s->block)) {
+      transform(s, s->block);
+      s->block_len = 0;
+    }
+  }
+  return 0;
+}
+
+int CRYPT_SHA256_Finalize(CRYPT_SHA256_CTX* sha256, unsigned char* digest) {
+  Sha256State* s = state(sha256);
+  const uint64_t num_bits = s->num_bytes * 8;
+  uint8_t padding[72] = {0x80};
+  const uint32_t num_padding_bytes =
+      (s->block_len < 56) ? 56 - s->block_len : 120 - s->block_len;
+  for (int i = 0; i < 8; ++i) {
+    padding[num_padding_bytes + i] = uint8_t(num_bits >> (56 - i * 8));
+  }
+  CRYPT_SHA256_DataAdd(sha256, padding, num_padding_bytes + 8);
+  for (int i = 0; i < 8; ++i) {
+    digest[i * 4] = uint8_t(s->h[i] >> 24);
+    digest[i * 4 + 1] = uint8_t(s->h[i] >> 16);
+    digest[i * 4 + 2] = uint8_t(s->h[i] >> 8);
+    digest[i * 4 + 3] = uint8_t(s->h[i]);
+  }
+  return CRYPT_SHA256_Initialize(sha256);
+}
+
+}  // extern "C"
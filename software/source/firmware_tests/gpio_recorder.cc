@@ -0,0 +1,205 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "gpio_recorder.h"
+
+#include <cassert>
+#include <deque>
+
+namespace NixieTracker {
+
+using std::deque;
+using std::vector;
+
+namespace {
+
+GPIOWaveformRecorder* g_active_recorder = nullptr;
+
+}  // namespace
+
+GPIOWaveformRecorder::GPIOWaveformRecorder()
+    : time_ns_(0) {
+  for (int i = 0; i < STUB_GPIO_NUM_PINS; ++i) {
+    levels_[i] = initial_levels_[i] = 0;
+  }
+}
+
+GPIOWaveformRecorder::~GPIOWaveformRecorder() {
+  deactivate();
+}
+
+void GPIOWaveformRecorder::activate() {
+  g_active_recorder = this;
+}
+
+void GPIOWaveformRecorder::deactivate() {
+  if (g_active_recorder == this) {
+    g_active_recorder = nullptr;
+  }
+}
+
+uint64_t GPIOWaveformRecorder::time() const {
+  return time_ns_;
+}
+
+void GPIOWaveformRecorder::advanceTime(uint64_t time_ns) {
+  time_ns_ += time_ns;
+}
+
+void GPIOWaveformRecorder::clear() {
+  edges_.clear();
+  for (int i = 0; i < STUB_GPIO_NUM_PINS; ++i) {
+    initial_levels_[i] = levels_[i];
+  }
+}
+
+void GPIOWaveformRecorder::write(StubGPIOPin pin, int value) {
+  assert(pin >= 0 && pin < STUB_GPIO_NUM_PINS);
+  value = value ? 1 : 0;
+  if (levels_[pin] == value) {
+    return;
+  }
+  levels_[pin] = value;
+  edges_.push_back({time_ns_, pin, value});
+}
+
+const vector<GPIOWaveformRecorder::Edge>& GPIOWaveformRecorder::edges() const {
+  return edges_;
+}
+
+int GPIOWaveformRecorder::numEdges(StubGPIOPin pin) const {
+  int num_edges = 0;
+  for (const Edge& edge : edges_) {
+    if (edge.pin == pin) {
+      ++num_edges;
+    }
+  }
+  return num_edges;
+}
+
+void GPIOWaveformRecorder::writeVCD(std::ostream* stream) const {
+  std::ostream& out = *stream;
+  out << "$timescale 1ns $end\n";
+  out << "$scope module nixie_tracker $end\n";
+  for (int i = 0; i < STUB_GPIO_NUM_PINS; ++i) {
+    out << "$var wire 1 " << static_cast<char>('!' + i) << " "
+        << pinName(static_cast<StubGPIOPin>(i)) << " $end\n";
+  }
+  out << "$upscope $end\n";
+  out << "$enddefinitions $end\n";
+  out << "#0\n";
+  out << "$dumpvars\n";
+  for (int i = 0; i < STUB_GPIO_NUM_PINS; ++i) {
+    out << initial_levels_[i] << static_cast<char>('!' + i) << "\n";
+  }
+  out << "$end\n";
+  uint64_t current_time = 0;
+  for (const Edge& edge : edges_) {
+    if (edge.time_ns != current_time) {
+      current_time = edge.time_ns;
+      out << "#" << current_time << "\n";
+    }
+    out << edge.value << static_cast<char>('!' + edge.pin) << "\n";
+  }
+}
+
+const char* GPIOWaveformRecorder::pinName(StubGPIOPin pin) {
+  switch (pin) {
+    case STUB_GPIO_PIN_SHIFT_DATA: return "SHIFT_DATA";
+    case STUB_GPIO_PIN_SHIFT_EN: return "SHIFT_EN";
+    case STUB_GPIO_PIN_SHIFT_RCK: return "SHIFT_RCK";
+    case STUB_GPIO_PIN_SHIFT_SRCK: return "SHIFT_SRCK";
+    case STUB_GPIO_NUM_PINS: break;
+  }
+  return "UNKNOWN";
+}
+
+ShiftRegisterChainDecoder::ShiftRegisterChainDecoder(int num_registers,
+                                                     bool is_inverted)
+    : num_registers_(num_registers),
+      is_inverted_(is_inverted) {
+}
+
+vector<vector<uint8_t>> ShiftRegisterChainDecoder::decode(
+    const vector<GPIOWaveformRecorder::Edge>& edges) const {
+  const int inactive_level = is_inverted_ ? 1 : 0;
+  const int num_bits = num_registers_ * 8;
+  vector<vector<uint8_t>> frames;
+  // Bits in the order they were shifted into the chain.
+  deque<int> shifted_bits;
+  int data_level = inactive_level;
+  for (const GPIOWaveformRecorder::Edge& edge : edges) {
+    const bool is_rising_edge = (edge.value != inactive_level);
+    switch (edge.pin) {
+      case STUB_GPIO_PIN_SHIFT_DATA:
+        data_level = edge.value;
+        break;
+      case STUB_GPIO_PIN_SHIFT_SRCK:
+        if (is_rising_edge) {
+          shifted_bits.push_back(data_level != inactive_level);
+          if (static_cast<int>(shifted_bits.size()) > num_bits) {
+            shifted_bits.pop_front();
+          }
+        }
+        break;
+      case STUB_GPIO_PIN_SHIFT_RCK:
+        if (is_rising_edge) {
+          vector<uint8_t> frame(num_registers_, 0);
+          // Registers which did not receive any data yet are considered to be
+          // zeroed.
+          const int num_shifted_bits = shifted_bits.size();
+          const int offset = num_bits - num_shifted_bits;
+          for (int i = 0; i < num_shifted_bits; ++i) {
+            const int bit = offset + i;
+            if (shifted_bits[i]) {
+              frame[bit / 8] |= (1 << (7 - bit % 8));
+            }
+          }
+          frames.push_back(frame);
+        }
+        break;
+      case STUB_GPIO_PIN_SHIFT_EN:
+      case STUB_GPIO_NUM_PINS:
+        break;
+    }
+  }
+  return frames;
+}
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+void StubGPIO_Write(StubGPIOPin pin, int value) {
+  if (NixieTracker::g_active_recorder != nullptr) {
+    NixieTracker::g_active_recorder->write(pin, value);
+  }
+}
+
+void StubGPIO_Nop(void) {
+  if (NixieTracker::g_active_recorder != nullptr) {
+    NixieTracker::g_active_recorder->advanceTime(
+        NixieTracker::GPIOWaveformRecorder::kCycleTimeNS);
+  }
+}
+
+}  // extern "C"
@@ -0,0 +1,106 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _GPIO_RECORDER_H
+#define _GPIO_RECORDER_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "system_definitions.h"
+
+namespace NixieTracker {
+
+// Records timestamped waveform of the simulated GPIO pins.
+//
+// Firmware code accesses pins via macros from the system_definitions.h stub,
+// which are routed to the currently active recorder. Time is simulated: the
+// test advances it explicitly (for example, once per main loop iteration),
+// and every Nop() advances it by a single CPU cycle.
+class GPIOWaveformRecorder {
+ public:
+  struct Edge {
+    // Time of the edge, in nanoseconds.
+    uint64_t time_ns;
+    StubGPIOPin pin;
+    int value;
+  };
+
+  // Duration of a single CPU cycle, for the 80MHz system clock.
+  static const uint64_t kCycleTimeNS = 12;
+
+  GPIOWaveformRecorder();
+  ~GPIOWaveformRecorder();
+
+  // Make this recorder a receiver of all GPIO writes.
+  void activate();
+  void deactivate();
+
+  // Simulated time.
+  uint64_t time() const;
+  void advanceTime(uint64_t time_ns);
+
+  // Forget all recorded edges. Pin levels and time are preserved.
+  void clear();
+
+  // Write new value to the pin. Only actual level changes are recorded.
+  void write(StubGPIOPin pin, int value);
+
+  const std::vector<Edge>& edges() const;
+  int numEdges(StubGPIOPin pin) const;
+
+  // Write recorded waveform in the Value Change Dump format.
+  void writeVCD(std::ostream* stream) const;
+
+  static const char* pinName(StubGPIOPin pin);
+
+ protected:
+  uint64_t time_ns_;
+  int levels_[STUB_GPIO_NUM_PINS];
+  // Levels at the moment of the first recorded edge.
+  int initial_levels_[STUB_GPIO_NUM_PINS];
+  std::vector<Edge> edges_;
+};
+
+// Decoder of the recorded waveform, which simulates daisy-chain of the
+// TPIC6B595 shift registers: data is sampled on the rising edge of SRCK and
+// copied to the storage register on the rising edge of RCK.
+class ShiftRegisterChainDecoder {
+ public:
+  // When is_inverted is truth the pins are connected to the registers via an
+  // inverter.
+  ShiftRegisterChainDecoder(int num_registers, bool is_inverted);
+
+  // Get all frames which were latched by the registers, in the order of
+  // registers receiving data (first byte is the one which was shifted first).
+  std::vector<std::vector<uint8_t>> decode(
+      const std::vector<GPIOWaveformRecorder::Edge>& edges) const;
+
+ protected:
+  int num_registers_;
+  bool is_inverted_;
+};
+
+}  // namespace NixieTracker
+
+#endif  // _GPIO_RECORDER_H
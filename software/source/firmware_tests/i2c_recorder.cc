@@ -0,0 +1,230 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "i2c_recorder.h"
+
+#include <cstring>
+
+namespace NixieTracker {
+
+using std::vector;
+
+namespace {
+
+I2CTransactionRecorder* g_active_recorder = nullptr;
+
+}  // namespace
+
+I2CTransactionRecorder::I2CTransactionRecorder()
+    : time_ns_(0),
+      latency_ns_(0),
+      byte_time_ns_(0),
+      num_status_polls_(0) {
+  memset(registers_, 0, sizeof(registers_));
+}
+
+I2CTransactionRecorder::~I2CTransactionRecorder() {
+  deactivate();
+}
+
+void I2CTransactionRecorder::activate() {
+  g_active_recorder = this;
+}
+
+void I2CTransactionRecorder::deactivate() {
+  if (g_active_recorder == this) {
+    g_active_recorder = nullptr;
+  }
+}
+
+uint8_t I2CTransactionRecorder::registerValue(uint8_t register_address) const {
+  return registers_[register_address];
+}
+
+void I2CTransactionRecorder::setRegisterValue(uint8_t register_address,
+                                              uint8_t value) {
+  registers_[register_address] = value;
+}
+
+uint64_t I2CTransactionRecorder::time() const {
+  return time_ns_;
+}
+
+void I2CTransactionRecorder::advanceTime(uint64_t time_ns) {
+  time_ns_ += time_ns;
+}
+
+void I2CTransactionRecorder::setTransferTiming(uint64_t latency_ns,
+                                               uint64_t byte_time_ns) {
+  latency_ns_ = latency_ns;
+  byte_time_ns_ = byte_time_ns;
+}
+
+void I2CTransactionRecorder::clear() {
+  transactions_.clear();
+  num_status_polls_ = 0;
+}
+
+const vector<I2CTransactionRecorder::Transaction>&
+I2CTransactionRecorder::transactions() const {
+  return transactions_;
+}
+
+int I2CTransactionRecorder::numTransactions() const {
+  return transactions_.size();
+}
+
+size_t I2CTransactionRecorder::numBytesTransmitted() const {
+  size_t num_bytes = 0;
+  for (const Transaction& transaction : transactions_) {
+    num_bytes += transaction.transmitted.size();
+  }
+  return num_bytes;
+}
+
+size_t I2CTransactionRecorder::numBytesReceived() const {
+  size_t num_bytes = 0;
+  for (const Transaction& transaction : transactions_) {
+    num_bytes += transaction.num_received;
+  }
+  return num_bytes;
+}
+
+int I2CTransactionRecorder::numStatusPolls() const {
+  return num_status_polls_;
+}
+
+DRV_I2C_BUFFER_HANDLE I2CTransactionRecorder::transmitThenReceive(
+    uint16_t address,
+    const uint8_t* write_buffer,
+    size_t write_size,
+    uint8_t* read_buffer,
+    size_t read_size) {
+  Transaction transaction;
+  transaction.address = address;
+  transaction.transmitted.assign(write_buffer, write_buffer + write_size);
+  transaction.num_received = read_size;
+  transaction.end_time_ns =
+      time_ns_ + latency_ns_ + (write_size + read_size) * byte_time_ns_;
+  transaction.is_failed = !isResponding();
+  transactions_.push_back(transaction);
+  if (transaction.is_failed) {
+    return transactions_.size();
+  }
+  // Simulate the device.
+  uint8_t register_pointer = 0;
+  if (write_size != 0) {
+    register_pointer = write_buffer[0];
+    for (size_t i = 1; i < write_size; ++i) {
+      writeRegister(register_pointer, write_buffer[i]);
+      register_pointer = nextRegisterAddress(register_pointer);
+    }
+  }
+  for (size_t i = 0; i < read_size; ++i) {
+    read_buffer[i] = readRegister(register_pointer);
+    register_pointer = nextRegisterAddress(register_pointer);
+  }
+  // Handle is never NULL, which is an invalid handle for the driver.
+  return transactions_.size();
+}
+
+DRV_I2C_BUFFER_EVENT I2CTransactionRecorder::transferStatus(
+    DRV_I2C_BUFFER_HANDLE buffer_handle) {
+  ++num_status_polls_;
+  if (buffer_handle == 0 || buffer_handle > transactions_.size()) {
+    return DRV_I2C_BUFFER_EVENT_ERROR;
+  }
+  const Transaction& transaction = transactions_[buffer_handle - 1];
+  if (time_ns_ < transaction.end_time_ns) {
+    return DRV_I2C_BUFFER_EVENT_PENDING;
+  }
+  if (transaction.is_failed) {
+    return DRV_I2C_BUFFER_EVENT_ERROR;
+  }
+  return DRV_I2C_BUFFER_EVENT_COMPLETE;
+}
+
+bool I2CTransactionRecorder::isResponding() const {
+  return true;
+}
+
+uint8_t I2CTransactionRecorder::readRegister(uint8_t register_address) {
+  return registers_[register_address];
+}
+
+void I2CTransactionRecorder::writeRegister(uint8_t register_address,
+                                           uint8_t value) {
+  registers_[register_address] = value;
+}
+
+uint8_t I2CTransactionRecorder::nextRegisterAddress(
+    uint8_t register_address) const {
+  return register_address + 1;
+}
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+DRV_HANDLE DRV_I2C_Open(const SYS_MODULE_INDEX /*index*/,
+                        const DRV_IO_INTENT /*io_intent*/) {
+  return 1;
+}
+
+DRV_I2C_BUFFER_HANDLE DRV_I2C_Transmit(DRV_HANDLE /*handle*/,
+                                       uint16_t address,
+                                       void* buffer,
+                                       size_t size,
+                                       void* /*context*/) {
+  if (NixieTracker::g_active_recorder == nullptr) {
+    return 0;
+  }
+  return NixieTracker::g_active_recorder->transmitThenReceive(
+      address, static_cast<const uint8_t*>(buffer), size, nullptr, 0);
+}
+
+DRV_I2C_BUFFER_HANDLE DRV_I2C_TransmitThenReceive(DRV_HANDLE /*handle*/,
+                                                  uint16_t address,
+                                                  void* write_buffer,
+                                                  size_t write_size,
+                                                  void* read_buffer,
+                                                  size_t read_size,
+                                                  void* /*context*/) {
+  if (NixieTracker::g_active_recorder == nullptr) {
+    return 0;
+  }
+  return NixieTracker::g_active_recorder->transmitThenReceive(
+      address,
+      static_cast<const uint8_t*>(write_buffer), write_size,
+      static_cast<uint8_t*>(read_buffer), read_size);
+}
+
+DRV_I2C_BUFFER_EVENT DRV_I2C_TransferStatusGet(
+    DRV_HANDLE /*handle*/,
+    DRV_I2C_BUFFER_HANDLE buffer_handle) {
+  if (NixieTracker::g_active_recorder == nullptr) {
+    return DRV_I2C_BUFFER_EVENT_ERROR;
+  }
+  return NixieTracker::g_active_recorder->transferStatus(buffer_handle);
+}
+
+}  // extern "C"
@@ -0,0 +1,119 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _I2C_RECORDER_H
+#define _I2C_RECORDER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "system_definitions.h"
+
+namespace NixieTracker {
+
+// Records I2C transactions issued via the driver API from the
+// system_definitions.h stub, which are routed to the currently active
+// recorder.
+//
+// The bus has a single device behind it, which is simulated as a flat file
+// of 256 registers with auto-incremented register pointer: first transmitted
+// byte sets the pointer, following bytes are written to the registers, and
+// received bytes are read from the registers. This is how MCP7940N behaves.
+// Subclasses simulate specific devices by overriding register access.
+//
+// Time is simulated: the test advances it explicitly (for example, once per
+// main loop iteration). Device registers are accessed when transfer is
+// submitted, but the transfer is only reported as complete once its
+// duration has passed. By default transfers take no time.
+class I2CTransactionRecorder {
+ public:
+  struct Transaction {
+    // Device address, as passed to the driver.
+    uint16_t address;
+    // Bytes which were sent to the device, including register address.
+    std::vector<uint8_t> transmitted;
+    // Number of bytes which were received from the device.
+    size_t num_received;
+    // Time at which transfer is over, in nanoseconds.
+    uint64_t end_time_ns;
+    // Device did not acknowledge the transfer.
+    bool is_failed;
+  };
+
+  I2CTransactionRecorder();
+  virtual ~I2CTransactionRecorder();
+
+  // Make this recorder a receiver of all I2C transfers.
+  void activate();
+  void deactivate();
+
+  uint8_t registerValue(uint8_t register_address) const;
+  void setRegisterValue(uint8_t register_address, uint8_t value);
+
+  // Simulated time.
+  uint64_t time() const;
+  virtual void advanceTime(uint64_t time_ns);
+
+  // Duration of a transfer is latency_ns plus byte_time_ns for every byte
+  // sent or received, excluding the device address.
+  void setTransferTiming(uint64_t latency_ns, uint64_t byte_time_ns);
+
+  // Forget all recorded transactions and statistics. Register values and
+  // time are preserved.
+  void clear();
+
+  const std::vector<Transaction>& transactions() const;
+  int numTransactions() const;
+
+  // Statistics of the recorded transactions.
+  size_t numBytesTransmitted() const;
+  size_t numBytesReceived() const;
+  // Number of times status of a transfer was queried by the driver.
+  int numStatusPolls() const;
+
+  // Driver API.
+  DRV_I2C_BUFFER_HANDLE transmitThenReceive(uint16_t address,
+                                            const uint8_t* write_buffer,
+                                            size_t write_size,
+                                            uint8_t* read_buffer,
+                                            size_t read_size);
+  DRV_I2C_BUFFER_EVENT transferStatus(DRV_I2C_BUFFER_HANDLE buffer_handle);
+
+ protected:
+  // Device simulation.
+  virtual bool isResponding() const;
+  virtual uint8_t readRegister(uint8_t register_address);
+  virtual void writeRegister(uint8_t register_address, uint8_t value);
+  // Address of the register which follows the given one in a burst transfer.
+  virtual uint8_t nextRegisterAddress(uint8_t register_address) const;
+
+  uint8_t registers_[256];
+  std::vector<Transaction> transactions_;
+  uint64_t time_ns_;
+  uint64_t latency_ns_;
+  uint64_t byte_time_ns_;
+  int num_status_polls_;
+};
+
+}  // namespace NixieTracker
+
+#endif  // _I2C_RECORDER_H
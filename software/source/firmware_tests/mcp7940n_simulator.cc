@@ -0,0 +1,292 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "mcp7940n_simulator.h"
+
+#include <cstring>
+
+extern "C" {
+#include "rtc_mcp7940n.h"
+}
+
+namespace NixieTracker {
+
+namespace {
+
+// Registers of the chip which are not described in the driver.
+const uint8_t kRegisterPowerDownTimestamp = 0x18;
+const uint8_t kRegisterPowerUpTimestamp = 0x1c;
+const uint8_t kLastRTCCRegister = 0x1f;
+const uint8_t kFlagPowerFail = 0x10;
+const uint8_t kFlag12HourFormat = 0x40;
+const uint8_t kMaskWeekDay = 0x07;
+const uint8_t kMaskMonth = 0x1f;
+
+// Every trim step adds or removes 2 clock cycles once per minute.
+const double kTrimStepPPB = 2.0 / (32768.0 * 60.0) * 1e9;
+
+int bcdToInt(uint8_t bcd) {
+  return (bcd >> 4) * 10 + (bcd & 0x0f);
+}
+
+uint8_t intToBCD(int value) {
+  return ((value / 10) << 4) | (value % 10);
+}
+
+int daysInMonth(int month, int year) {
+  static const int kDaysInMonth[] = {31, 28, 31, 30, 31, 30,
+                                     31, 31, 30, 31, 30, 31};
+  if (month == 2 && year % 4 == 0) {
+    return 29;
+  }
+  return kDaysInMonth[month - 1];
+}
+
+}  // namespace
+
+MCP7940NSimulator::MCP7940NSimulator()
+    : is_powered_(true),
+      crystal_error_ppb_(0),
+      oscillator_time_ns_(0.0) {
+  // Reset value of the weekday is 1.
+  registers_[MCP7940N_REG_ADDR_DAY_OF_WEEK] = 0x01;
+  registers_[MCP7940N_REG_ADDR_DATE] = 0x01;
+  registers_[MCP7940N_REG_ADDR_MONTH] = 0x01;
+  updateStatusBits();
+}
+
+void MCP7940NSimulator::advanceTime(uint64_t time_ns) {
+  I2CTransactionRecorder::advanceTime(time_ns);
+  if (!isOscillatorRunning()) {
+    return;
+  }
+  oscillator_time_ns_ += time_ns * (1.0 + oscillatorErrorPPB() * 1e-9);
+  while (oscillator_time_ns_ >= 1e9) {
+    oscillator_time_ns_ -= 1e9;
+    tickSecond();
+  }
+}
+
+void MCP7940NSimulator::setCrystalError(int32_t error_ppb) {
+  crystal_error_ppb_ = error_ppb;
+}
+
+void MCP7940NSimulator::powerDown() {
+  if (!is_powered_) {
+    return;
+  }
+  is_powered_ = false;
+  if (registers_[MCP7940N_REG_ADDR_DAY_OF_WEEK] &
+      MCP7940N_FLAG_BATTERY_ENABLE) {
+    registers_[MCP7940N_REG_ADDR_DAY_OF_WEEK] |= kFlagPowerFail;
+    storeTimestamp(kRegisterPowerDownTimestamp);
+    return;
+  }
+  // Nothing keeps the content, SRAM is filled with garbage.
+  memset(registers_, 0, kLastRTCCRegister + 1);
+  memset(registers_ + MCP7940N_SRAM_ADDR, 0xa5, MCP7940N_SRAM_SIZE);
+  registers_[MCP7940N_REG_ADDR_DAY_OF_WEEK] = 0x01;
+  registers_[MCP7940N_REG_ADDR_DATE] = 0x01;
+  registers_[MCP7940N_REG_ADDR_MONTH] = 0x01;
+  oscillator_time_ns_ = 0.0;
+  updateStatusBits();
+}
+
+void MCP7940NSimulator::powerUp() {
+  if (is_powered_) {
+    return;
+  }
+  is_powered_ = true;
+  if (registers_[MCP7940N_REG_ADDR_DAY_OF_WEEK] & kFlagPowerFail) {
+    storeTimestamp(kRegisterPowerUpTimestamp);
+  }
+  updateStatusBits();
+}
+
+bool MCP7940NSimulator::isPowered() const {
+  return is_powered_;
+}
+
+bool MCP7940NSimulator::isOscillatorRunning() const {
+  if ((registers_[MCP7940N_REG_ADDR_SECONDS] &
+       MCP7940N_FLAG_START_OSCILLATOR) == 0) {
+    return false;
+  }
+  return is_powered_ ||
+         (registers_[MCP7940N_REG_ADDR_DAY_OF_WEEK] &
+          MCP7940N_FLAG_BATTERY_ENABLE) != 0;
+}
+
+bool MCP7940NSimulator::isResponding() const {
+  return is_powered_;
+}
+
+uint8_t MCP7940NSimulator::readRegister(uint8_t register_address) {
+  if (register_address >= MCP7940N_SRAM_ADDR + MCP7940N_SRAM_SIZE) {
+    // Unimplemented address.
+    return 0;
+  }
+  return registers_[register_address];
+}
+
+void MCP7940NSimulator::writeRegister(uint8_t register_address,
+                                      uint8_t value) {
+  if (register_address >= MCP7940N_SRAM_ADDR) {
+    if (register_address < MCP7940N_SRAM_ADDR + MCP7940N_SRAM_SIZE) {
+      registers_[register_address] = value;
+    }
+    return;
+  }
+  switch (register_address) {
+    case MCP7940N_REG_ADDR_SECONDS:
+      // Writing seconds resets the prescaler.
+      oscillator_time_ns_ = 0.0;
+      registers_[register_address] = value;
+      break;
+    case MCP7940N_REG_ADDR_DAY_OF_WEEK: {
+      const uint8_t previous_value = registers_[register_address];
+      // OSCRUN is read-only, PWRFAIL can only be cleared.
+      uint8_t new_value = value & ~(MCP7940N_FLAG_OSC_ON | kFlagPowerFail);
+      if (value & previous_value & kFlagPowerFail) {
+        new_value |= kFlagPowerFail;
+      } else if (previous_value & kFlagPowerFail) {
+        // Clearing PWRFAIL clears the time stamps.
+        memset(registers_ + kRegisterPowerDownTimestamp,
+               0,
+               kLastRTCCRegister - kRegisterPowerDownTimestamp + 1);
+      }
+      registers_[register_address] = new_value;
+      break;
+    }
+    case MCP7940N_REG_ADDR_MONTH:
+      // Leap year bit is read-only.
+      registers_[register_address] = value & kMaskMonth;
+      break;
+    case MCP7940N_REG_ADDR_UNLOCK_ID:
+      // There is no EEPROM in MCP7940N.
+      break;
+    default:
+      if (register_address >= kRegisterPowerDownTimestamp) {
+        // Time stamps are read-only.
+        break;
+      }
+      registers_[register_address] = value;
+      break;
+  }
+  updateStatusBits();
+}
+
+uint8_t MCP7940NSimulator::nextRegisterAddress(
+    uint8_t register_address) const {
+  if (register_address == kLastRTCCRegister) {
+    return MCP7940N_REG_ADDR_SECONDS;
+  }
+  if (register_address == MCP7940N_SRAM_ADDR + MCP7940N_SRAM_SIZE - 1) {
+    return MCP7940N_SRAM_ADDR;
+  }
+  return register_address + 1;
+}
+
+void MCP7940NSimulator::tickSecond() {
+  uint8_t* registers = registers_;
+  const uint8_t seconds_flags =
+      registers[MCP7940N_REG_ADDR_SECONDS] & MCP7940N_FLAG_START_OSCILLATOR;
+  int seconds = bcdToInt(registers[MCP7940N_REG_ADDR_SECONDS] & 0x7f) + 1;
+  int minutes = bcdToInt(registers[MCP7940N_REG_ADDR_MINUNTES] & 0x7f);
+  int hours = bcdToInt(registers[MCP7940N_REG_ADDR_HOURS] & 0x3f);
+  int week_day = registers[MCP7940N_REG_ADDR_DAY_OF_WEEK] & kMaskWeekDay;
+  int day = bcdToInt(registers[MCP7940N_REG_ADDR_DATE] & 0x3f);
+  int month = bcdToInt(registers[MCP7940N_REG_ADDR_MONTH] & kMaskMonth);
+  int year = bcdToInt(registers[MCP7940N_REG_ADDR_YEAR]);
+  if (seconds == 60) {
+    seconds = 0;
+    ++minutes;
+  }
+  if (minutes == 60) {
+    minutes = 0;
+    ++hours;
+  }
+  if (hours == 24) {
+    hours = 0;
+    ++day;
+    week_day = (week_day % 7) + 1;
+  }
+  if (month < 1 || month > 12) {
+    // Chip does not validate the values, keep counting days of January.
+    month = 1;
+  }
+  if (day > daysInMonth(month, year)) {
+    day = 1;
+    ++month;
+  }
+  if (month == 13) {
+    month = 1;
+    year = (year + 1) % 100;
+  }
+  registers[MCP7940N_REG_ADDR_SECONDS] = seconds_flags | intToBCD(seconds);
+  registers[MCP7940N_REG_ADDR_MINUNTES] = intToBCD(minutes);
+  registers[MCP7940N_REG_ADDR_HOURS] =
+      (registers[MCP7940N_REG_ADDR_HOURS] & kFlag12HourFormat) |
+      intToBCD(hours);
+  registers[MCP7940N_REG_ADDR_DAY_OF_WEEK] =
+      (registers[MCP7940N_REG_ADDR_DAY_OF_WEEK] & ~kMaskWeekDay) | week_day;
+  registers[MCP7940N_REG_ADDR_DATE] = intToBCD(day);
+  registers[MCP7940N_REG_ADDR_MONTH] = intToBCD(month);
+  registers[MCP7940N_REG_ADDR_YEAR] = intToBCD(year);
+  updateStatusBits();
+}
+
+void MCP7940NSimulator::updateStatusBits() {
+  uint8_t* week_day = &registers_[MCP7940N_REG_ADDR_DAY_OF_WEEK];
+  if (isOscillatorRunning()) {
+    *week_day |= MCP7940N_FLAG_OSC_ON;
+  } else {
+    *week_day &= ~MCP7940N_FLAG_OSC_ON;
+  }
+  uint8_t* month = &registers_[MCP7940N_REG_ADDR_MONTH];
+  const int year = bcdToInt(registers_[MCP7940N_REG_ADDR_YEAR]);
+  if (year % 4 == 0) {
+    *month |= MCP7940N_FLAG_LEAP;
+  } else {
+    *month &= ~MCP7940N_FLAG_LEAP;
+  }
+}
+
+void MCP7940NSimulator::storeTimestamp(uint8_t register_address) {
+  const uint8_t* registers = registers_;
+  registers_[register_address + 0] = registers[MCP7940N_REG_ADDR_MINUNTES];
+  registers_[register_address + 1] = registers[MCP7940N_REG_ADDR_HOURS];
+  registers_[register_address + 2] = registers[MCP7940N_REG_ADDR_DATE];
+  registers_[register_address + 3] =
+      ((registers[MCP7940N_REG_ADDR_DAY_OF_WEEK] & kMaskWeekDay) << 5) |
+      (registers[MCP7940N_REG_ADDR_MONTH] & kMaskMonth);
+}
+
+double MCP7940NSimulator::oscillatorErrorPPB() const {
+  const uint8_t calibration = registers_[MCP7940N_REG_ADDR_CALIB];
+  const double trim_ppb =
+      (calibration & MCP7940N_MASK_CALIB_TRIM) * kTrimStepPPB;
+  return crystal_error_ppb_ +
+         ((calibration & MCP7940N_FLAG_CALIB_SIGN) ? trim_ppb : -trim_ppb);
+}
+
+}  // namespace NixieTracker
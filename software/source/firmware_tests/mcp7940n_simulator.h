@@ -0,0 +1,89 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _MCP7940N_SIMULATOR_H
+#define _MCP7940N_SIMULATOR_H
+
+#include <cstdint>
+
+#include "i2c_recorder.h"
+
+namespace NixieTracker {
+
+// Model of the MCP7940N RTC behind the I2C bus.
+//
+// Covers the time keeping registers, which are advancing in BCD with the
+// simulated time while the oscillator is started, calibration trim of the
+// oscillator, status bits (OSCRUN, PWRFAIL, VBATEN, LPYR), power-fail time
+// stamps and the battery-backed SRAM. The register pointer wraps within the
+// RTCC and SRAM blocks, same as the chip does.
+//
+// NOTE: Only 24 hour format is simulated, alarms and MFP output are stored
+// but have no effect.
+class MCP7940NSimulator : public I2CTransactionRecorder {
+ public:
+  MCP7940NSimulator();
+
+  void advanceTime(uint64_t time_ns) override;
+
+  // Frequency error of the crystal in parts per billion, positive error
+  // makes the clock run fast.
+  void setCrystalError(int32_t error_ppb);
+
+  // Main power supply of the chip.
+  //
+  // While the main power is off the chip does not respond on the bus, and
+  // time keeps running only if the battery backup is enabled. Otherwise all
+  // registers are reset and SRAM content is lost.
+  void powerDown();
+  void powerUp();
+  bool isPowered() const;
+
+  // Whether oscillator is running and time is advancing.
+  bool isOscillatorRunning() const;
+
+ protected:
+  bool isResponding() const override;
+  uint8_t readRegister(uint8_t register_address) override;
+  void writeRegister(uint8_t register_address, uint8_t value) override;
+  uint8_t nextRegisterAddress(uint8_t register_address) const override;
+
+  // Advance time keeping registers by a single second.
+  void tickSecond();
+  // Update read-only status bits from the current state.
+  void updateStatusBits();
+  // Store current time in the time stamp registers at the given address.
+  void storeTimestamp(uint8_t register_address);
+  // Correction of the oscillator frequency in parts per billion, including
+  // the crystal error and the calibration trim.
+  double oscillatorErrorPPB() const;
+
+  bool is_powered_;
+  int32_t crystal_error_ppb_;
+  // Time counted by the oscillator which did not add up to a whole second
+  // yet, in nanoseconds.
+  double oscillator_time_ns_;
+};
+
+}  // namespace NixieTracker
+
+#endif  // _MCP7940N_SIMULATOR_H
@@ -0,0 +1,610 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "i2c_recorder.h"
+#include "mcp7940n_simulator.h"
+
+extern "C" {
+#include "rtc_mcp7940n.h"
+}
+
+DEFINE_int32(rtc_loop_iteration_ns, 10000,
+             "Simulated duration of a single main loop iteration");
+
+namespace NixieTracker {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// Run driver tasks until it's done with communication.
+void runUntilIdle(RTC_MCP7940N* rtc) {
+  for (int i = 0; i < 100 && RTC_MCP7940N_IsBusy(rtc); ++i) {
+    RTC_MCP7940N_Tasks(rtc);
+  }
+  EXPECT_FALSE(RTC_MCP7940N_IsBusy(rtc));
+}
+
+RTC_MCP7940N_DateTime makeDateTime(int year, int month, int day,
+                                   int day_of_week,
+                                   int hours, int minutes, int seconds) {
+  RTC_MCP7940N_DateTime date_time;
+  date_time.year = year - 2000;
+  date_time.month = month;
+  date_time.day = day;
+  date_time.day_of_week = day_of_week;
+  date_time.hours = hours;
+  date_time.minutes = minutes;
+  date_time.seconds = seconds;
+  return date_time;
+}
+
+// Callback which records success of every finished operation.
+void recordCompletionCallback(RTC_MCP7940N* /*rtc*/,
+                              bool success,
+                              void* user_data) {
+  static_cast<vector<bool>*>(user_data)->push_back(success);
+}
+
+class RTCMCP7940NTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    recorder_.activate();
+    EXPECT_TRUE(RTC_MCP7940N_Initialize(&rtc_, DRV_I2C_INDEX_0));
+  }
+
+  void TearDown() override {
+    recorder_.deactivate();
+  }
+
+  // Last transaction is expected to be a write of the given bytes.
+  void expectLastWrite(const vector<uint8_t>& expected_bytes) {
+    ASSERT_GT(recorder_.numTransactions(), 0);
+    const I2CTransactionRecorder::Transaction& transaction =
+        recorder_.transactions().back();
+    EXPECT_EQ(transaction.transmitted, expected_bytes);
+    EXPECT_EQ(transaction.num_received, 0u);
+  }
+
+  I2CTransactionRecorder recorder_;
+  RTC_MCP7940N rtc_;
+};
+
+}  // namespace
+
+TEST_F(RTCMCP7940NTest, ReadDateAndTime) {
+  const uint8_t registers[] = {0x80 | 0x59, 0x30, 0x23,
+                               MCP7940N_FLAG_BATTERY_ENABLE | 0x03,
+                               0x29, 0x20 | 0x11, 0x12};
+  for (int i = 0; i < sizeof(registers); ++i) {
+    recorder_.setRegisterValue(i, registers[i]);
+  }
+  RTC_MCP7940N_DateTime date_time;
+  RTC_MCP7940N_ReadDateAndTime(&rtc_, &date_time, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), 1);
+  EXPECT_EQ(date_time.seconds, 59);
+  EXPECT_EQ(date_time.minutes, 30);
+  EXPECT_EQ(date_time.hours, 23);
+  EXPECT_EQ(date_time.day_of_week, 3);
+  EXPECT_EQ(date_time.day, 29);
+  EXPECT_EQ(date_time.month, 11);
+  EXPECT_EQ(date_time.year, 12);
+}
+
+TEST_F(RTCMCP7940NTest, WriteDateAndTime) {
+  // Oscillator is running and battery is enabled, those are to be preserved.
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_SECONDS,
+                             MCP7940N_FLAG_START_OSCILLATOR | 0x12);
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_DAY_OF_WEEK,
+                             MCP7940N_FLAG_BATTERY_ENABLE | 0x01);
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_MONTH, 0x11);
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_CONTROL, 0x43);
+  const RTC_MCP7940N_DateTime date_time =
+      makeDateTime(2017, 1, 31, 2, 14, 5, 9);
+  RTC_MCP7940N_WriteDateAndTime(&rtc_, &date_time, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  // Single burst read followed by a burst write of time keeping registers.
+  EXPECT_EQ(recorder_.numTransactions(), 2);
+  expectLastWrite({MCP7940N_REG_ADDR_SECONDS,
+                   MCP7940N_FLAG_START_OSCILLATOR | 0x09, 0x05, 0x14,
+                   MCP7940N_FLAG_BATTERY_ENABLE | 0x02,
+                   0x31, 0x01, 0x17});
+  EXPECT_EQ(recorder_.registerValue(MCP7940N_REG_ADDR_CONTROL), 0x43);
+}
+
+TEST_F(RTCMCP7940NTest, EnableOscillator) {
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_SECONDS, 0x42);
+  RTC_MCP7940N_EnableOscillator(&rtc_, true, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), 2);
+  expectLastWrite({MCP7940N_REG_ADDR_SECONDS,
+                   MCP7940N_FLAG_START_OSCILLATOR | 0x42});
+  RTC_MCP7940N_EnableOscillator(&rtc_, false, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), 4);
+  expectLastWrite({MCP7940N_REG_ADDR_SECONDS, 0x42});
+}
+
+TEST_F(RTCMCP7940NTest, EnableBatteryBackup) {
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_DAY_OF_WEEK, 0x05);
+  RTC_MCP7940N_EnableBatteryBackup(&rtc_, true, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), 2);
+  // Time keeping registers are not written back.
+  expectLastWrite({MCP7940N_REG_ADDR_DAY_OF_WEEK,
+                   MCP7940N_FLAG_BATTERY_ENABLE | 0x05});
+  bool enabled = false;
+  RTC_MCP7940N_BatteryBackupStatus(&rtc_, &enabled, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_TRUE(enabled);
+}
+
+TEST_F(RTCMCP7940NTest, ColdStartBatch) {
+  RTC_MCP7940N_Batch batch;
+  RTC_MCP7940N_BatchInitialize(&batch);
+  const RTC_MCP7940N_DateTime date_time =
+      makeDateTime(2018, 12, 1, 6, 0, 0, 30);
+  RTC_MCP7940N_BatchSetDateAndTime(&batch, &date_time);
+  RTC_MCP7940N_BatchEnableOscillator(&batch, true);
+  RTC_MCP7940N_BatchEnableBatteryBackup(&batch, true);
+  RTC_MCP7940N_WriteBatch(&rtc_, &batch, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  // Used to be six transactions when done as separate operations.
+  EXPECT_EQ(recorder_.numTransactions(), 2);
+  expectLastWrite({MCP7940N_REG_ADDR_SECONDS,
+                   MCP7940N_FLAG_START_OSCILLATOR | 0x30, 0x00, 0x00,
+                   MCP7940N_FLAG_BATTERY_ENABLE | 0x06,
+                   0x01, 0x12, 0x18});
+  bool enabled = false;
+  RTC_MCP7940N_OscillatorStatus(&rtc_, &enabled, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_TRUE(enabled);
+}
+
+TEST_F(RTCMCP7940NTest, BatchSetBits) {
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_CONTROL,
+                             MCP7940N_FLAG_OUT_PIN | MCP7940N_FLAG_MFP_32KHZ);
+  RTC_MCP7940N_Batch batch;
+  RTC_MCP7940N_BatchInitialize(&batch);
+  RTC_MCP7940N_BatchSetBits(&batch,
+                            MCP7940N_REG_ADDR_CONTROL,
+                            MCP7940N_FLAG_SQWE | MCP7940N_MASK_MFP_RATE,
+                            MCP7940N_FLAG_SQWE | MCP7940N_FLAG_MFP_1HZ);
+  RTC_MCP7940N_WriteBatch(&rtc_, &batch, nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), 2);
+  expectLastWrite({MCP7940N_REG_ADDR_CONTROL,
+                   MCP7940N_FLAG_OUT_PIN | MCP7940N_FLAG_SQWE});
+}
+
+TEST_F(RTCMCP7940NTest, EmptyBatch) {
+  RTC_MCP7940N_Batch batch;
+  RTC_MCP7940N_BatchInitialize(&batch);
+  RTC_MCP7940N_WriteBatch(&rtc_, &batch, nullptr, nullptr);
+  EXPECT_FALSE(RTC_MCP7940N_IsBusy(&rtc_));
+  EXPECT_EQ(recorder_.numTransactions(), 0);
+}
+
+TEST_F(RTCMCP7940NTest, QueueBackToBack) {
+  vector<bool> record;
+  RTC_MCP7940N_DateTime date_time;
+  bool oscillator_enabled = true, battery_enabled = true;
+  EXPECT_TRUE(RTC_MCP7940N_ReadDateAndTime(
+      &rtc_, &date_time, recordCompletionCallback, &record));
+  EXPECT_TRUE(RTC_MCP7940N_OscillatorStatus(
+      &rtc_, &oscillator_enabled, recordCompletionCallback, &record));
+  EXPECT_TRUE(RTC_MCP7940N_BatteryBackupStatus(
+      &rtc_, &battery_enabled, recordCompletionCallback, &record));
+  // Only the first operation is started.
+  EXPECT_TRUE(RTC_MCP7940N_IsBusy(&rtc_));
+  EXPECT_EQ(recorder_.numTransactions(), 1);
+  // Every pass finishes an operation and starts the next one right away.
+  RTC_MCP7940N_Tasks(&rtc_);
+  EXPECT_EQ(record.size(), 1u);
+  EXPECT_EQ(recorder_.numTransactions(), 2);
+  RTC_MCP7940N_Tasks(&rtc_);
+  EXPECT_EQ(record.size(), 2u);
+  EXPECT_EQ(recorder_.numTransactions(), 3);
+  RTC_MCP7940N_Tasks(&rtc_);
+  EXPECT_EQ(record.size(), 3u);
+  EXPECT_FALSE(RTC_MCP7940N_IsBusy(&rtc_));
+  EXPECT_EQ(record, vector<bool>({true, true, true}));
+  EXPECT_FALSE(oscillator_enabled);
+  EXPECT_FALSE(battery_enabled);
+}
+
+TEST_F(RTCMCP7940NTest, QueueFull) {
+  uint8_t values[RTC_MCP7940N_QUEUE_SIZE + 1];
+  for (int i = 0; i < RTC_MCP7940N_QUEUE_SIZE; ++i) {
+    EXPECT_TRUE(RTC_MCP7940N_ReadRegister(&rtc_, i, &values[i],
+                                          nullptr, nullptr));
+  }
+  EXPECT_TRUE(RTC_MCP7940N_IsQueueFull(&rtc_));
+  EXPECT_FALSE(RTC_MCP7940N_ReadRegister(
+      &rtc_, 0, &values[RTC_MCP7940N_QUEUE_SIZE], nullptr, nullptr));
+  RTC_MCP7940N_Tasks(&rtc_);
+  EXPECT_FALSE(RTC_MCP7940N_IsQueueFull(&rtc_));
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), RTC_MCP7940N_QUEUE_SIZE);
+}
+
+TEST_F(RTCMCP7940NTest, QueueFromCallback) {
+  struct Chain {
+    uint8_t value;
+    int num_finished;
+  } chain = {0, 0};
+  recorder_.setRegisterValue(MCP7940N_REG_ADDR_CONTROL, 0x42);
+  RTC_MCP7940N_CompletionCallback callback =
+      [](RTC_MCP7940N* rtc, bool success, void* user_data) {
+        Chain* chain = static_cast<Chain*>(user_data);
+        if (++chain->num_finished == 1) {
+          RTC_MCP7940N_WriteRegister(rtc, MCP7940N_REG_ADDR_CALIB,
+                                     chain->value + 1, nullptr, nullptr);
+        }
+      };
+  RTC_MCP7940N_ReadRegister(&rtc_, MCP7940N_REG_ADDR_CONTROL, &chain.value,
+                            callback, &chain);
+  RTC_MCP7940N_Tasks(&rtc_);
+  // Write which was queued from the callback is already on the bus.
+  EXPECT_EQ(recorder_.numTransactions(), 2);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(chain.num_finished, 1);
+  EXPECT_EQ(recorder_.registerValue(MCP7940N_REG_ADDR_CALIB), 0x43);
+}
+
+TEST_F(RTCMCP7940NTest, WriteSRAM) {
+  const uint8_t data[] = {0x01, 0x02, 0x03};
+  RTC_MCP7940N_WriteSRAM(&rtc_, 4, data, sizeof(data), nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), 1);
+  expectLastWrite({MCP7940N_SRAM_ADDR + 4, 0x01, 0x02, 0x03});
+}
+
+TEST_F(RTCMCP7940NTest, ReadSRAM) {
+  for (int i = 0; i < MCP7940N_SRAM_SIZE; ++i) {
+    recorder_.setRegisterValue(MCP7940N_SRAM_ADDR + i, 0x80 | i);
+  }
+  uint8_t data[MCP7940N_SRAM_SIZE];
+  RTC_MCP7940N_ReadSRAM(&rtc_, 0, data, sizeof(data), nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  EXPECT_EQ(recorder_.numTransactions(), 1);
+  for (int i = 0; i < MCP7940N_SRAM_SIZE; ++i) {
+    EXPECT_EQ(data[i], 0x80 | i);
+  }
+  // Time keeping registers are not touched.
+  EXPECT_EQ(recorder_.transactions().back().transmitted,
+            vector<uint8_t>({MCP7940N_SRAM_ADDR}));
+}
+
+TEST_F(RTCMCP7940NTest, WholeSRAMRoundTrip) {
+  uint8_t data[MCP7940N_SRAM_SIZE];
+  for (int i = 0; i < MCP7940N_SRAM_SIZE; ++i) {
+    data[i] = 0xff - i;
+  }
+  RTC_MCP7940N_WriteSRAM(&rtc_, 0, data, sizeof(data), nullptr, nullptr);
+  // Data is copied on submission.
+  memset(data, 0, sizeof(data));
+  uint8_t read_data[MCP7940N_SRAM_SIZE];
+  RTC_MCP7940N_ReadSRAM(&rtc_, 0, read_data, sizeof(read_data),
+                        nullptr, nullptr);
+  runUntilIdle(&rtc_);
+  for (int i = 0; i < MCP7940N_SRAM_SIZE; ++i) {
+    EXPECT_EQ(read_data[i], 0xff - i);
+  }
+  EXPECT_EQ(recorder_.registerValue(MCP7940N_REG_ADDR_SECONDS), 0);
+}
+
+TEST(RTC_MCP7940N_CalibrationFromPPB, Basic) {
+  EXPECT_EQ(RTC_MCP7940N_CalibrationFromPPB(0), 0x00);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationFromPPB(400), 0x00);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationFromPPB(1017), 0x81);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationFromPPB(1500), 0x81);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationFromPPB(-2034), 0x02);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationFromPPB(1000000), 0xff);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationFromPPB(-1000000), 0x7f);
+}
+
+TEST(RTC_MCP7940N_CalibrationToPPB, Basic) {
+  EXPECT_EQ(RTC_MCP7940N_CalibrationToPPB(0x00), 0);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationToPPB(0x80), 0);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationToPPB(0x81), 1017);
+  EXPECT_EQ(RTC_MCP7940N_CalibrationToPPB(0x02), -2034);
+  for (int trim = -127; trim <= 127; ++trim) {
+    const int32_t ppb = trim * RTC_MCP7940N_CALIBRATION_STEP_PPB;
+    EXPECT_EQ(RTC_MCP7940N_CalibrationToPPB(
+                  RTC_MCP7940N_CalibrationFromPPB(ppb)), ppb);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tests against the model of the chip.
+
+namespace {
+
+// Timing of 400 kHz bus: start condition and address byte, followed by 9 bit
+// times for every byte.
+const uint64_t kI2CLatencyNS = 25000;
+const uint64_t kI2CByteTimeNS = 22500;
+
+class RTCMCP7940NSimulatorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    simulator_.activate();
+    simulator_.setTransferTiming(kI2CLatencyNS, kI2CByteTimeNS);
+    EXPECT_TRUE(RTC_MCP7940N_Initialize(&rtc_, DRV_I2C_INDEX_0));
+  }
+
+  void TearDown() override {
+    simulator_.deactivate();
+  }
+
+  // Run driver tasks until it's done with communication, advancing simulated
+  // time by a main loop iteration every time.
+  //
+  // Returns number of main loop iterations it took.
+  int runUntilIdle() {
+    int num_iterations = 0;
+    while (RTC_MCP7940N_IsBusy(&rtc_) && num_iterations < 10000) {
+      RTC_MCP7940N_Tasks(&rtc_);
+      simulator_.advanceTime(FLAGS_rtc_loop_iteration_ns);
+      ++num_iterations;
+    }
+    EXPECT_FALSE(RTC_MCP7940N_IsBusy(&rtc_));
+    return num_iterations;
+  }
+
+  // Set date and time, start oscillator and enable battery backup.
+  void coldStart(const RTC_MCP7940N_DateTime& date_time) {
+    RTC_MCP7940N_Batch batch;
+    RTC_MCP7940N_BatchInitialize(&batch);
+    RTC_MCP7940N_BatchSetDateAndTime(&batch, &date_time);
+    RTC_MCP7940N_BatchEnableOscillator(&batch, true);
+    RTC_MCP7940N_BatchEnableBatteryBackup(&batch, true);
+    EXPECT_TRUE(RTC_MCP7940N_WriteBatch(&rtc_, &batch, nullptr, nullptr));
+    runUntilIdle();
+  }
+
+  // Returns false if RTC did not reply.
+  bool readDateTime(RTC_MCP7940N_DateTime* date_time) {
+    vector<bool> completions;
+    RTC_MCP7940N_ReadDateAndTime(&rtc_, date_time,
+                                 recordCompletionCallback, &completions);
+    runUntilIdle();
+    return completions.size() == 1 && completions[0];
+  }
+
+  void advanceSeconds(uint64_t seconds) {
+    simulator_.advanceTime(seconds * 1000000000ull);
+  }
+
+  MCP7940NSimulator simulator_;
+  RTC_MCP7940N rtc_;
+};
+
+void expectDateTime(const RTC_MCP7940N_DateTime& actual,
+                    const RTC_MCP7940N_DateTime& expected) {
+  EXPECT_EQ(actual.year, expected.year);
+  EXPECT_EQ(actual.month, expected.month);
+  EXPECT_EQ(actual.day, expected.day);
+  EXPECT_EQ(actual.day_of_week, expected.day_of_week);
+  EXPECT_EQ(actual.hours, expected.hours);
+  EXPECT_EQ(actual.minutes, expected.minutes);
+  EXPECT_EQ(actual.seconds, expected.seconds);
+}
+
+}  // namespace
+
+TEST_F(RTCMCP7940NSimulatorTest, TimeAdvances) {
+  coldStart(makeDateTime(2016, 2, 28, 7, 23, 59, 58));
+  RTC_MCP7940N_DateTime date_time;
+  advanceSeconds(2);
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2016, 2, 29, 1, 0, 0, 0));
+  EXPECT_TRUE(simulator_.registerValue(MCP7940N_REG_ADDR_MONTH) &
+              MCP7940N_FLAG_LEAP);
+  advanceSeconds(24 * 3600 + 3661);
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2016, 3, 1, 2, 1, 1, 1));
+  // Year wrap.
+  coldStart(makeDateTime(2099, 12, 31, 4, 23, 59, 59));
+  advanceSeconds(1);
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2000, 1, 1, 5, 0, 0, 0));
+}
+
+TEST_F(RTCMCP7940NSimulatorTest, OscillatorStopped) {
+  const RTC_MCP7940N_DateTime start_date_time =
+      makeDateTime(2017, 6, 15, 4, 12, 0, 0);
+  RTC_MCP7940N_WriteDateAndTime(&rtc_, &start_date_time, nullptr, nullptr);
+  runUntilIdle();
+  advanceSeconds(10);
+  bool is_running = true;
+  RTC_MCP7940N_OscillatorStatus(&rtc_, &is_running, nullptr, nullptr);
+  runUntilIdle();
+  EXPECT_FALSE(is_running);
+  RTC_MCP7940N_DateTime date_time;
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, start_date_time);
+  RTC_MCP7940N_EnableOscillator(&rtc_, true, nullptr, nullptr);
+  runUntilIdle();
+  advanceSeconds(10);
+  RTC_MCP7940N_OscillatorStatus(&rtc_, &is_running, nullptr, nullptr);
+  runUntilIdle();
+  EXPECT_TRUE(is_running);
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2017, 6, 15, 4, 12, 0, 10));
+}
+
+TEST_F(RTCMCP7940NSimulatorTest, BatteryBackup) {
+  coldStart(makeDateTime(2017, 6, 15, 4, 12, 0, 0));
+  const uint8_t sram_data[] = {0xde, 0xad, 0xbe, 0xef};
+  RTC_MCP7940N_WriteSRAM(&rtc_, 0, sram_data, sizeof(sram_data),
+                         nullptr, nullptr);
+  runUntilIdle();
+  simulator_.powerDown();
+  advanceSeconds(90);
+  // Chip does not respond while it runs from the battery.
+  RTC_MCP7940N_DateTime date_time;
+  EXPECT_FALSE(readDateTime(&date_time));
+  simulator_.powerUp();
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2017, 6, 15, 4, 12, 1, 30));
+  EXPECT_TRUE(simulator_.registerValue(MCP7940N_REG_ADDR_DAY_OF_WEEK) &
+              0x10);
+  uint8_t read_data[sizeof(sram_data)];
+  RTC_MCP7940N_ReadSRAM(&rtc_, 0, read_data, sizeof(read_data),
+                        nullptr, nullptr);
+  runUntilIdle();
+  EXPECT_EQ(vector<uint8_t>(read_data, read_data + sizeof(read_data)),
+            vector<uint8_t>(sram_data, sram_data + sizeof(sram_data)));
+}
+
+TEST_F(RTCMCP7940NSimulatorTest, NoBatteryBackup) {
+  coldStart(makeDateTime(2017, 6, 15, 4, 12, 0, 0));
+  RTC_MCP7940N_EnableBatteryBackup(&rtc_, false, nullptr, nullptr);
+  runUntilIdle();
+  const uint8_t sram_data[] = {0xde, 0xad, 0xbe, 0xef};
+  RTC_MCP7940N_WriteSRAM(&rtc_, 0, sram_data, sizeof(sram_data),
+                         nullptr, nullptr);
+  runUntilIdle();
+  simulator_.powerDown();
+  advanceSeconds(90);
+  simulator_.powerUp();
+  EXPECT_FALSE(simulator_.isOscillatorRunning());
+  RTC_MCP7940N_DateTime date_time;
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2000, 1, 1, 1, 0, 0, 0));
+  EXPECT_NE(simulator_.registerValue(MCP7940N_SRAM_ADDR), 0xde);
+}
+
+TEST_F(RTCMCP7940NSimulatorTest, CalibrationTrim) {
+  // 20 ppm fast crystal gains 2 seconds in a bit more than a day.
+  simulator_.setCrystalError(20000);
+  coldStart(makeDateTime(2017, 1, 1, 7, 0, 0, 0));
+  advanceSeconds(100000);
+  RTC_MCP7940N_DateTime date_time;
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2017, 1, 2, 1, 3, 46, 42));
+  // Trim compensates for the error down to a single step.
+  coldStart(makeDateTime(2017, 1, 1, 7, 0, 0, 0));
+  RTC_MCP7940N_WriteRegister(&rtc_,
+                             MCP7940N_REG_ADDR_CALIB,
+                             RTC_MCP7940N_CalibrationFromPPB(-20000),
+                             nullptr, nullptr);
+  runUntilIdle();
+  // Trim steps are ~1 ppm, so leave half a second for the residual error.
+  simulator_.advanceTime(100000500000000ull);
+  ASSERT_TRUE(readDateTime(&date_time));
+  expectDateTime(date_time, makeDateTime(2017, 1, 2, 1, 3, 46, 40));
+}
+
+TEST_F(RTCMCP7940NSimulatorTest, TransferLatency) {
+  RTC_MCP7940N_DateTime date_time;
+  RTC_MCP7940N_ReadDateAndTime(&rtc_, &date_time, nullptr, nullptr);
+  // Transfer of 1 + 7 bytes takes 205 us, so the driver keeps polling.
+  const int num_iterations = runUntilIdle();
+  EXPECT_GT(num_iterations,
+            (kI2CLatencyNS + 8 * kI2CByteTimeNS) /
+            FLAGS_rtc_loop_iteration_ns);
+  EXPECT_EQ(simulator_.numTransactions(), 1);
+  EXPECT_GE(simulator_.numStatusPolls(), num_iterations - 1);
+}
+
+TEST_F(RTCMCP7940NSimulatorTest, BenchmarkOperations) {
+  struct Operation {
+    string name;
+    std::function<void()> submit;
+    int expected_num_transactions;
+  };
+  RTC_MCP7940N_DateTime date_time = makeDateTime(2017, 6, 15, 4, 12, 0, 0);
+  RTC_MCP7940N_Batch cold_start_batch;
+  RTC_MCP7940N_BatchInitialize(&cold_start_batch);
+  RTC_MCP7940N_BatchSetDateAndTime(&cold_start_batch, &date_time);
+  RTC_MCP7940N_BatchEnableOscillator(&cold_start_batch, true);
+  RTC_MCP7940N_BatchEnableBatteryBackup(&cold_start_batch, true);
+  uint8_t register_value;
+  bool status;
+  uint8_t sram[MCP7940N_SRAM_SIZE] = {0};
+  const vector<Operation> operations = {
+      {"ReadDateAndTime",
+       [&] { RTC_MCP7940N_ReadDateAndTime(&rtc_, &date_time,
+                                          nullptr, nullptr); },
+       1},
+      {"WriteDateAndTime",
+       [&] { RTC_MCP7940N_WriteDateAndTime(&rtc_, &date_time,
+                                           nullptr, nullptr); },
+       2},
+      {"ColdStartBatch",
+       [&] { RTC_MCP7940N_WriteBatch(&rtc_, &cold_start_batch,
+                                     nullptr, nullptr); },
+       2},
+      {"EnableOscillator",
+       [&] { RTC_MCP7940N_EnableOscillator(&rtc_, true, nullptr, nullptr); },
+       2},
+      {"OscillatorStatus",
+       [&] { RTC_MCP7940N_OscillatorStatus(&rtc_, &status,
+                                           nullptr, nullptr); },
+       1},
+      {"ReadRegister",
+       [&] { RTC_MCP7940N_ReadRegister(&rtc_, MCP7940N_REG_ADDR_CALIB,
+                                       &register_value, nullptr, nullptr); },
+       1},
+      {"WriteRegister",
+       [&] { RTC_MCP7940N_WriteRegister(&rtc_, MCP7940N_REG_ADDR_CALIB, 0,
+                                        nullptr, nullptr); },
+       1},
+      {"ReadSRAM",
+       [&] { RTC_MCP7940N_ReadSRAM(&rtc_, 0, sram, sizeof(sram),
+                                   nullptr, nullptr); },
+       1},
+      {"WriteSRAM",
+       [&] { RTC_MCP7940N_WriteSRAM(&rtc_, 0, sram, sizeof(sram),
+                                    nullptr, nullptr); },
+       1},
+  };
+  for (const Operation& operation : operations) {
+    simulator_.clear();
+    const uint64_t start_time = simulator_.time();
+    operation.submit();
+    const int num_iterations = runUntilIdle();
+    const uint64_t time_ns = simulator_.time() - start_time;
+    EXPECT_EQ(simulator_.numTransactions(),
+              operation.expected_num_transactions) << operation.name;
+    LOG(INFO) << operation.name << ": "
+              << simulator_.numTransactions() << " transaction(s), "
+              << simulator_.numBytesTransmitted() << " byte(s) sent, "
+              << simulator_.numBytesReceived() << " byte(s) received, "
+              << num_iterations << " iterations, "
+              << simulator_.numStatusPolls() << " status polls, "
+              << time_ns / 1000.0 << " us.";
+  }
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,560 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "sst25_emulator.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace NixieTracker {
+
+using std::string;
+
+namespace {
+
+SST25Emulator* g_active_emulator = nullptr;
+
+const uint8_t kErasedByte = 0xff;
+
+}  // namespace
+
+SST25Emulator::Geometry SST25Emulator::defaultGeometry() {
+  Geometry geometry;
+  geometry.size = 2 * 1024 * 1024;
+  geometry.read_block_size = 1;
+  geometry.write_block_size = 1;
+  geometry.erase_block_size = 4096;
+  return geometry;
+}
+
+SST25Emulator::Timing SST25Emulator::defaultTiming() {
+  Timing timing;
+  // Command and address bytes.
+  timing.command_latency_ns = 4 * 400;
+  timing.read_byte_ns = 400;
+  // Word is programmed in 10 us.
+  timing.program_byte_ns = 5000;
+  timing.erase_block_ns = 25 * 1000 * 1000;
+  return timing;
+}
+
+SST25Emulator::SST25Emulator()
+    : geometry_(defaultGeometry()),
+      timing_(defaultTiming()),
+      fd_(-1),
+      data_(nullptr),
+      is_strict_programming_(false),
+      num_failing_opens_(0),
+      num_failing_commands_(0),
+      time_ns_(0),
+      head_end_time_ns_(0),
+      next_handle_(1) {
+  clearStatistics();
+}
+
+SST25Emulator::~SST25Emulator() {
+  deactivate();
+  close();
+}
+
+void SST25Emulator::setGeometry(const Geometry& geometry) {
+  geometry_ = geometry;
+}
+
+const SST25Emulator::Geometry& SST25Emulator::geometry() const {
+  return geometry_;
+}
+
+void SST25Emulator::setTiming(const Timing& timing) {
+  timing_ = timing;
+}
+
+const SST25Emulator::Timing& SST25Emulator::timing() const {
+  return timing_;
+}
+
+bool SST25Emulator::open(const string& image_path) {
+  close();
+  if (image_path.empty()) {
+    char temp_path[] = "/tmp/sst25_image_XXXXXX";
+    fd_ = mkstemp(temp_path);
+    if (fd_ != -1) {
+      unlink(temp_path);
+    }
+  } else {
+    fd_ = ::open(image_path.c_str(), O_RDWR | O_CREAT, 0644);
+  }
+  if (fd_ == -1) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) != 0 ||
+      ftruncate(fd_, geometry_.size) != 0) {
+    close();
+    return false;
+  }
+  void* data = mmap(nullptr, geometry_.size,
+                    PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd_, 0);
+  if (data == MAP_FAILED) {
+    close();
+    return false;
+  }
+  data_ = static_cast<uint8_t*>(data);
+  const uint32_t old_size = std::min<uint64_t>(file_stat.st_size,
+                                               geometry_.size);
+  memset(data_ + old_size, kErasedByte, geometry_.size - old_size);
+  erase_counts_.assign(numEraseBlocks(), 0);
+  return true;
+}
+
+void SST25Emulator::close() {
+  if (data_ != nullptr) {
+    munmap(data_, geometry_.size);
+    data_ = nullptr;
+  }
+  if (fd_ != -1) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  queue_.clear();
+}
+
+bool SST25Emulator::isOpen() const {
+  return data_ != nullptr;
+}
+
+void SST25Emulator::activate() {
+  g_active_emulator = this;
+}
+
+void SST25Emulator::deactivate() {
+  if (g_active_emulator == this) {
+    g_active_emulator = nullptr;
+  }
+}
+
+void SST25Emulator::setStrictProgramming(bool is_strict) {
+  is_strict_programming_ = is_strict;
+}
+
+void SST25Emulator::setNumFailingOpens(int num_failing_opens) {
+  num_failing_opens_ = num_failing_opens;
+}
+
+void SST25Emulator::setNumFailingCommands(int num_failing_commands) {
+  num_failing_commands_ = num_failing_commands;
+}
+
+uint8_t* SST25Emulator::data() {
+  return data_;
+}
+
+const uint8_t* SST25Emulator::data() const {
+  return data_;
+}
+
+void SST25Emulator::eraseAll() {
+  memset(data_, kErasedByte, geometry_.size);
+}
+
+uint64_t SST25Emulator::time() const {
+  return time_ns_;
+}
+
+void SST25Emulator::advanceTime(uint64_t time_ns) {
+  time_ns_ += time_ns;
+  finishCommands();
+}
+
+void SST25Emulator::advanceToNextCompletion() {
+  if (queue_.empty()) {
+    return;
+  }
+  time_ns_ = std::max(time_ns_, head_end_time_ns_);
+  finishCommands();
+}
+
+void SST25Emulator::runUntilIdle() {
+  while (!queue_.empty()) {
+    advanceToNextCompletion();
+  }
+}
+
+bool SST25Emulator::isBusy() const {
+  return !queue_.empty();
+}
+
+const SST25Emulator::Statistics& SST25Emulator::statistics() const {
+  return statistics_;
+}
+
+void SST25Emulator::clearStatistics() {
+  memset(&statistics_, 0, sizeof(statistics_));
+}
+
+uint32_t SST25Emulator::numEraseBlocks() const {
+  return geometry_.size / geometry_.erase_block_size;
+}
+
+uint32_t SST25Emulator::eraseCount(uint32_t erase_block) const {
+  return erase_counts_[erase_block];
+}
+
+uint32_t SST25Emulator::maxEraseCount() const {
+  if (erase_counts_.empty()) {
+    return 0;
+  }
+  return *std::max_element(erase_counts_.begin(), erase_counts_.end());
+}
+
+uint64_t SST25Emulator::totalEraseCount() const {
+  uint64_t total = 0;
+  for (uint32_t count : erase_counts_) {
+    total += count;
+  }
+  return total;
+}
+
+DRV_HANDLE SST25Emulator::driverOpen() {
+  if (!isOpen()) {
+    return DRV_HANDLE_INVALID;
+  }
+  if (num_failing_opens_ > 0) {
+    --num_failing_opens_;
+    return DRV_HANDLE_INVALID;
+  }
+  return 1;
+}
+
+SYS_FS_MEDIA_GEOMETRY* SST25Emulator::driverGeometry() {
+  const uint32_t block_sizes[] = {geometry_.read_block_size,
+                                  geometry_.write_block_size,
+                                  geometry_.erase_block_size};
+  for (int i = 0; i < 3; ++i) {
+    geometry_table_[i].blockSize = block_sizes[i];
+    geometry_table_[i].numBlocks = geometry_.size / block_sizes[i];
+  }
+  media_geometry_.mediaProperty = 0;
+  media_geometry_.numReadRegions = 1;
+  media_geometry_.numWriteRegions = 1;
+  media_geometry_.numEraseRegions = 1;
+  media_geometry_.geometryTable = geometry_table_;
+  return &media_geometry_;
+}
+
+DRV_SST25_BLOCK_COMMAND_HANDLE SST25Emulator::submitRead(
+    uint8_t* buffer,
+    uint32_t block_start,
+    uint32_t num_blocks) {
+  Command command;
+  command.type = COMMAND_READ;
+  command.target_buffer = buffer;
+  command.source_buffer = nullptr;
+  command.address = block_start * geometry_.read_block_size;
+  command.num_bytes = num_blocks * geometry_.read_block_size;
+  command.duration_ns = timing_.command_latency_ns +
+                        command.num_bytes * timing_.read_byte_ns;
+  return submit(command);
+}
+
+DRV_SST25_BLOCK_COMMAND_HANDLE SST25Emulator::submitWrite(
+    const uint8_t* buffer,
+    uint32_t block_start,
+    uint32_t num_blocks) {
+  Command command;
+  command.type = COMMAND_WRITE;
+  command.target_buffer = nullptr;
+  command.source_buffer = buffer;
+  command.address = block_start * geometry_.write_block_size;
+  command.num_bytes = num_blocks * geometry_.write_block_size;
+  command.duration_ns = timing_.command_latency_ns +
+                        command.num_bytes * timing_.program_byte_ns;
+  return submit(command);
+}
+
+DRV_SST25_BLOCK_COMMAND_HANDLE SST25Emulator::submitErase(
+    uint32_t block_start,
+    uint32_t num_blocks) {
+  Command command;
+  command.type = COMMAND_ERASE;
+  command.target_buffer = nullptr;
+  command.source_buffer = nullptr;
+  command.address = block_start * geometry_.erase_block_size;
+  command.num_bytes = num_blocks * geometry_.erase_block_size;
+  command.duration_ns = timing_.command_latency_ns +
+                        num_blocks * timing_.erase_block_ns;
+  return submit(command);
+}
+
+DRV_SST25_BLOCK_COMMAND_HANDLE SST25Emulator::submitEraseWrite(
+    const uint8_t* buffer,
+    uint32_t block_start,
+    uint32_t num_blocks) {
+  Command command;
+  command.type = COMMAND_ERASE_WRITE;
+  command.target_buffer = nullptr;
+  command.source_buffer = buffer;
+  command.address = block_start * geometry_.write_block_size;
+  command.num_bytes = num_blocks * geometry_.write_block_size;
+  // Driver reads the erase blocks which are only partially written, erases
+  // them and programs them as a whole.
+  const uint32_t erase_block_size = geometry_.erase_block_size;
+  const uint32_t first_block = command.address / erase_block_size;
+  const uint32_t last_block =
+      (command.address + command.num_bytes - 1) / erase_block_size;
+  command.duration_ns = timing_.command_latency_ns;
+  for (uint32_t block = first_block; block <= last_block; ++block) {
+    const uint32_t block_address = block * erase_block_size;
+    if (command.address > block_address ||
+        command.address + command.num_bytes <
+            block_address + erase_block_size) {
+      command.duration_ns += erase_block_size * timing_.read_byte_ns;
+    }
+    command.duration_ns += timing_.erase_block_ns +
+                           erase_block_size * timing_.program_byte_ns;
+  }
+  return submit(command);
+}
+
+DRV_SST25_COMMAND_STATUS SST25Emulator::commandStatus(
+    DRV_SST25_BLOCK_COMMAND_HANDLE command_handle) const {
+  if (!queue_.empty()) {
+    if (queue_.front().handle == command_handle) {
+      return DRV_SST25_COMMAND_IN_PROGRESS;
+    }
+    for (const Command& command : queue_) {
+      if (command.handle == command_handle) {
+        return DRV_SST25_COMMAND_QUEUED;
+      }
+    }
+  }
+  auto it = finished_commands_.find(command_handle);
+  if (it == finished_commands_.end()) {
+    return DRV_SST25_COMMAND_ERROR_UNKNOWN;
+  }
+  return it->second;
+}
+
+DRV_SST25_BLOCK_COMMAND_HANDLE SST25Emulator::submit(const Command& command) {
+  if (!isOpen() ||
+      command.num_bytes == 0 ||
+      command.address >= geometry_.size ||
+      command.num_bytes > geometry_.size - command.address) {
+    return DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  }
+  Command queued_command = command;
+  queued_command.handle = next_handle_++;
+  queued_command.is_failing = (num_failing_commands_ > 0);
+  if (num_failing_commands_ > 0) {
+    --num_failing_commands_;
+  }
+  if (queue_.empty()) {
+    head_end_time_ns_ = time_ns_ + queued_command.duration_ns;
+  }
+  queue_.push_back(queued_command);
+  ++statistics_.num_commands;
+  statistics_.busy_time_ns += queued_command.duration_ns;
+  return queued_command.handle;
+}
+
+bool SST25Emulator::perform(const Command& command) {
+  if (command.is_failing) {
+    return false;
+  }
+  switch (command.type) {
+    case COMMAND_READ:
+      memcpy(command.target_buffer, data_ + command.address,
+             command.num_bytes);
+      statistics_.num_bytes_read += command.num_bytes;
+      return true;
+    case COMMAND_WRITE:
+      return program(command.address, command.source_buffer,
+                     command.num_bytes);
+    case COMMAND_ERASE: {
+      const uint32_t first_block = command.address /
+                                   geometry_.erase_block_size;
+      const uint32_t num_blocks = command.num_bytes /
+                                  geometry_.erase_block_size;
+      for (uint32_t i = 0; i < num_blocks; ++i) {
+        erase(first_block + i);
+      }
+      return true;
+    }
+    case COMMAND_ERASE_WRITE: {
+      const uint32_t erase_block_size = geometry_.erase_block_size;
+      const uint32_t first_block = command.address / erase_block_size;
+      const uint32_t last_block =
+          (command.address + command.num_bytes - 1) / erase_block_size;
+      std::vector<uint8_t> block_data(erase_block_size);
+      for (uint32_t block = first_block; block <= last_block; ++block) {
+        const uint32_t block_address = block * erase_block_size;
+        memcpy(block_data.data(), data_ + block_address, erase_block_size);
+        const uint32_t begin = std::max(block_address, command.address);
+        const uint32_t end = std::min(block_address + erase_block_size,
+                                      command.address + command.num_bytes);
+        memcpy(block_data.data() + (begin - block_address),
+               command.source_buffer + (begin - command.address),
+               end - begin);
+        erase(block);
+        program(block_address, block_data.data(), erase_block_size);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SST25Emulator::program(uint32_t address,
+                            const uint8_t* buffer,
+                            uint32_t num_bytes) {
+  uint8_t* data = data_ + address;
+  bool has_violation = false;
+  for (uint32_t i = 0; i < num_bytes; ++i) {
+    if ((buffer[i] & ~data[i]) != 0) {
+      has_violation = true;
+      break;
+    }
+  }
+  if (has_violation) {
+    ++statistics_.num_program_violations;
+    if (is_strict_programming_) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < num_bytes; ++i) {
+    data[i] &= buffer[i];
+  }
+  statistics_.num_bytes_programmed += num_bytes;
+  return true;
+}
+
+void SST25Emulator::erase(uint32_t erase_block) {
+  memset(data_ + erase_block * geometry_.erase_block_size,
+         kErasedByte,
+         geometry_.erase_block_size);
+  ++erase_counts_[erase_block];
+  ++statistics_.num_erases;
+}
+
+void SST25Emulator::finishCommands() {
+  while (!queue_.empty() && time_ns_ >= head_end_time_ns_) {
+    const Command command = queue_.front();
+    queue_.pop_front();
+    finished_commands_[command.handle] =
+        perform(command) ? DRV_SST25_COMMAND_COMPLETED
+                         : DRV_SST25_COMMAND_ERROR_UNKNOWN;
+    if (!queue_.empty()) {
+      head_end_time_ns_ += queue_.front().duration_ns;
+    }
+  }
+}
+
+}  // namespace NixieTracker
+
+extern "C" {
+
+DRV_HANDLE DRV_SST25_Open(const SYS_MODULE_INDEX /*index*/,
+                          const DRV_IO_INTENT /*io_intent*/) {
+  if (NixieTracker::g_active_emulator == nullptr) {
+    return DRV_HANDLE_INVALID;
+  }
+  return NixieTracker::g_active_emulator->driverOpen();
+}
+
+SYS_FS_MEDIA_GEOMETRY* DRV_SST25_GeometryGet(const DRV_HANDLE /*handle*/) {
+  if (NixieTracker::g_active_emulator == nullptr) {
+    return nullptr;
+  }
+  return NixieTracker::g_active_emulator->driverGeometry();
+}
+
+void DRV_SST25_BlockRead(const DRV_HANDLE /*handle*/,
+                         DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                         uint8_t* target_buffer,
+                         uint32_t block_start,
+                         uint32_t num_blocks) {
+  *command_handle = DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  if (NixieTracker::g_active_emulator == nullptr) {
+    return;
+  }
+  *command_handle = NixieTracker::g_active_emulator->submitRead(
+      target_buffer, block_start, num_blocks);
+}
+
+void DRV_SST25_BlockWrite(const DRV_HANDLE /*handle*/,
+                          DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                          uint8_t* source_buffer,
+                          uint32_t block_start,
+                          uint32_t num_blocks) {
+  *command_handle = DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  if (NixieTracker::g_active_emulator == nullptr) {
+    return;
+  }
+  *command_handle = NixieTracker::g_active_emulator->submitWrite(
+      source_buffer, block_start, num_blocks);
+}
+
+void DRV_SST25_BlockErase(const DRV_HANDLE /*handle*/,
+                          DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                          uint32_t block_start,
+                          uint32_t num_blocks) {
+  *command_handle = DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  if (NixieTracker::g_active_emulator == nullptr) {
+    return;
+  }
+  *command_handle = NixieTracker::g_active_emulator->submitErase(
+      block_start, num_blocks);
+}
+
+void DRV_SST25_BlockEraseWrite(const DRV_HANDLE /*handle*/,
+                               DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                               uint8_t* source_buffer,
+                               uint32_t block_start,
+                               uint32_t num_blocks) {
+  *command_handle = DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID;
+  if (NixieTracker::g_active_emulator == nullptr) {
+    return;
+  }
+  *command_handle = NixieTracker::g_active_emulator->submitEraseWrite(
+      source_buffer, block_start, num_blocks);
+}
+
+DRV_SST25_COMMAND_STATUS DRV_SST25_CommandStatus(
+    const DRV_HANDLE /*handle*/,
+    const DRV_SST25_BLOCK_COMMAND_HANDLE command_handle) {
+  if (NixieTracker::g_active_emulator == nullptr) {
+    return DRV_SST25_COMMAND_ERROR_UNKNOWN;
+  }
+  return NixieTracker::g_active_emulator->commandStatus(command_handle);
+}
+
+void DRV_SST25_Tasks(SYS_MODULE_OBJ /*object*/) {
+}
+
+}  // extern "C"
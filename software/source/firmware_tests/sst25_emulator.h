@@ -0,0 +1,211 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _SST25_EMULATOR_H
+#define _SST25_EMULATOR_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "system_definitions.h"
+
+namespace NixieTracker {
+
+// Emulation of the SST25 serial flash behind the driver API from the
+// system_definitions.h stub. Driver calls are routed to the currently active
+// emulator.
+//
+// Content of the flash lives in an image file which is memory-mapped, so it
+// can be kept between runs and inspected. Flash semantic is followed:
+// erase sets all bits of an erase block, programming only clears bits, so
+// programming over data which was not erased ANDs it with the old content.
+// Such programming is counted as a violation, and can be made to fail.
+//
+// Time is simulated: the test advances it explicitly. Commands are performed
+// one after another in the order they were submitted, every command takes
+// time according to the timing configuration. Flash content is only
+// accessed once the command is over, so buffers are to stay valid until
+// then, same as with the real driver.
+class SST25Emulator {
+ public:
+  struct Geometry {
+    uint32_t size;
+    uint32_t read_block_size;
+    uint32_t write_block_size;
+    uint32_t erase_block_size;
+  };
+
+  struct Timing {
+    // Time from the command submission to the first byte of the transfer.
+    uint64_t command_latency_ns;
+    uint64_t read_byte_ns;
+    uint64_t program_byte_ns;
+    uint64_t erase_block_ns;
+  };
+
+  // Statistics since the last clearStatistics().
+  struct Statistics {
+    uint64_t num_bytes_read;
+    uint64_t num_bytes_programmed;
+    uint32_t num_erases;
+    uint32_t num_commands;
+    // Programming which needed some bit to go from 0 to 1.
+    uint32_t num_program_violations;
+    // Time during which the flash was busy with commands.
+    uint64_t busy_time_ns;
+  };
+
+  // Geometry and timing of SST25VF016B: 2 MB with 4 KB erase blocks,
+  // byte addressable, read over 20 MHz SPI and word programming.
+  static Geometry defaultGeometry();
+  static Timing defaultTiming();
+
+  SST25Emulator();
+  ~SST25Emulator();
+
+  // Geometry is only to be changed before the image is opened.
+  void setGeometry(const Geometry& geometry);
+  const Geometry& geometry() const;
+
+  void setTiming(const Timing& timing);
+  const Timing& timing() const;
+
+  // Open image of the flash, creating it if needed. The file is resized to
+  // the size of the flash, newly added space is erased.
+  //
+  // If the path is empty, an anonymous temporary file is used.
+  bool open(const std::string& image_path = "");
+  void close();
+  bool isOpen() const;
+
+  // Make this emulator a receiver of all SST25 driver calls.
+  void activate();
+  void deactivate();
+
+  // Commands programming over not erased data fail, instead of ANDing it.
+  void setStrictProgramming(bool is_strict);
+
+  // Number of the following driver open attempts which fail, the way it
+  // happens while the driver is not initialized yet.
+  void setNumFailingOpens(int num_failing_opens);
+
+  // Number of the following commands which fail, without touching the
+  // flash content.
+  void setNumFailingCommands(int num_failing_commands);
+
+  // Direct access to the flash content, bypassing the timing.
+  uint8_t* data();
+  const uint8_t* data() const;
+  void eraseAll();
+
+  // Simulated time.
+  uint64_t time() const;
+  void advanceTime(uint64_t time_ns);
+  // Advance time until the command which is currently performed is over.
+  // Does nothing if no commands are queued.
+  void advanceToNextCompletion();
+  void runUntilIdle();
+  bool isBusy() const;
+
+  const Statistics& statistics() const;
+  void clearStatistics();
+
+  // Wear of the flash.
+  uint32_t numEraseBlocks() const;
+  uint32_t eraseCount(uint32_t erase_block) const;
+  uint32_t maxEraseCount() const;
+  uint64_t totalEraseCount() const;
+
+  // Driver API.
+  DRV_HANDLE driverOpen();
+  SYS_FS_MEDIA_GEOMETRY* driverGeometry();
+  DRV_SST25_BLOCK_COMMAND_HANDLE submitRead(uint8_t* buffer,
+                                            uint32_t block_start,
+                                            uint32_t num_blocks);
+  DRV_SST25_BLOCK_COMMAND_HANDLE submitWrite(const uint8_t* buffer,
+                                             uint32_t block_start,
+                                             uint32_t num_blocks);
+  DRV_SST25_BLOCK_COMMAND_HANDLE submitErase(uint32_t block_start,
+                                             uint32_t num_blocks);
+  DRV_SST25_BLOCK_COMMAND_HANDLE submitEraseWrite(const uint8_t* buffer,
+                                                  uint32_t block_start,
+                                                  uint32_t num_blocks);
+  DRV_SST25_COMMAND_STATUS commandStatus(
+      DRV_SST25_BLOCK_COMMAND_HANDLE command_handle) const;
+
+ protected:
+  enum CommandType {
+    COMMAND_READ,
+    COMMAND_WRITE,
+    COMMAND_ERASE,
+    COMMAND_ERASE_WRITE,
+  };
+
+  struct Command {
+    CommandType type;
+    DRV_SST25_BLOCK_COMMAND_HANDLE handle;
+    uint8_t* target_buffer;
+    const uint8_t* source_buffer;
+    // Range of the command in bytes.
+    uint32_t address;
+    uint32_t num_bytes;
+    uint64_t duration_ns;
+    bool is_failing;
+  };
+
+  DRV_SST25_BLOCK_COMMAND_HANDLE submit(const Command& command);
+  // Perform the command on the flash content, returns false if it failed.
+  bool perform(const Command& command);
+  bool program(uint32_t address, const uint8_t* buffer, uint32_t num_bytes);
+  void erase(uint32_t erase_block);
+  // Finish all commands which are over by the current time.
+  void finishCommands();
+
+  Geometry geometry_;
+  Timing timing_;
+  SYS_FS_MEDIA_REGION_GEOMETRY geometry_table_[3];
+  SYS_FS_MEDIA_GEOMETRY media_geometry_;
+
+  int fd_;
+  uint8_t* data_;
+  bool is_strict_programming_;
+  int num_failing_opens_;
+  int num_failing_commands_;
+
+  uint64_t time_ns_;
+  // Time at which the command at the head of the queue is over.
+  uint64_t head_end_time_ns_;
+  std::deque<Command> queue_;
+  DRV_SST25_BLOCK_COMMAND_HANDLE next_handle_;
+  std::unordered_map<DRV_SST25_BLOCK_COMMAND_HANDLE,
+                     DRV_SST25_COMMAND_STATUS> finished_commands_;
+
+  Statistics statistics_;
+  std::vector<uint32_t> erase_counts_;
+};
+
+}  // namespace NixieTracker
+
+#endif  // _SST25_EMULATOR_H
@@ -0,0 +1,50 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _CRYPTO_CRYPTO_STUB_H
+#define _CRYPTO_CRYPTO_STUB_H
+
+// Subset of the Harmony crypto API, implemented in crypto_sha256.cc.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  int holder[32];
+} CRYPT_SHA256_CTX;
+
+enum {
+  CRYPT_SHA256_DIGEST_SIZE = 32,
+};
+
+int CRYPT_SHA256_Initialize(CRYPT_SHA256_CTX* sha256);
+int CRYPT_SHA256_DataAdd(CRYPT_SHA256_CTX* sha256,
+                         const unsigned char* input,
+                         unsigned int sz);
+int CRYPT_SHA256_Finalize(CRYPT_SHA256_CTX* sha256, unsigned char* digest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _CRYPTO_CRYPTO_STUB_H
@@ -0,0 +1,37 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#ifndef _DRIVER_WIFI_MRF24W_DRV_WIFI_CONFIG_DATA_STUB_H
+#define _DRIVER_WIFI_MRF24W_DRV_WIFI_CONFIG_DATA_STUB_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint8_t networkType;
+  uint8_t ssid[32];
+  uint8_t ssidLen;
+  uint8_t securityMode;
+  uint8_t securityKey[64];
+  uint8_t securityKeyLen;
+} DRV_WIFI_CONFIG_DATA;
+
+#endif  // _DRIVER_WIFI_MRF24W_DRV_WIFI_CONFIG_DATA_STUB_H
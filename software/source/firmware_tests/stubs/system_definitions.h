@@ -24,13 +24,198 @@
 #define _SYS_DEFINITIONS_STUB_H_
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "system/common/sys_module.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 enum SysErrorType {
   SYS_ERROR_DEBUG,
 };
 
+// GPIO pins which are simulated by the tests.
+typedef enum StubGPIOPin {
+  STUB_GPIO_PIN_SHIFT_DATA,
+  STUB_GPIO_PIN_SHIFT_EN,
+  STUB_GPIO_PIN_SHIFT_RCK,
+  STUB_GPIO_PIN_SHIFT_SRCK,
+
+  STUB_GPIO_NUM_PINS,
+} StubGPIOPin;
+
+// Implemented by GPIO recorder, see gpio_recorder.h.
+void StubGPIO_Write(StubGPIOPin pin, int value);
+void StubGPIO_Nop(void);
+
+#define Nop() StubGPIO_Nop()
+
+// Shift register pins.
+#define SHIFT_DATA_On() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_DATA, 1)
+#define SHIFT_DATA_Off() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_DATA, 0)
+#define SHIFT_DATA_StateSet(value) \
+  StubGPIO_Write(STUB_GPIO_PIN_SHIFT_DATA, (value))
+#define SHIFT_EN_On() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_EN, 1)
+#define SHIFT_EN_Off() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_EN, 0)
+#define SHIFT_RCK_On() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_RCK, 1)
+#define SHIFT_RCK_Off() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_RCK, 0)
+#define SHIFT_SRCK_On() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_SRCK, 1)
+#define SHIFT_SRCK_Off() StubGPIO_Write(STUB_GPIO_PIN_SHIFT_SRCK, 0)
+
+// Command processor console, only used as an opaque handle by the tests.
+typedef struct SYS_CMD_DEVICE_NODE SYS_CMD_DEVICE_NODE;
+
+// Interrupts are not simulated, so there is nothing to disable.
+typedef uint32_t SYS_INT_PROCESSOR_STATUS;
+
+#define SYS_INT_StatusGetAndDisable() ((SYS_INT_PROCESSOR_STATUS)0)
+#define SYS_INT_StatusRestore(status) ((void)(status))
+
+// I2C driver API, implemented by I2C recorder, see i2c_recorder.h.
+typedef uintptr_t DRV_HANDLE;
+#define DRV_HANDLE_INVALID ((DRV_HANDLE)-1)
+
+typedef enum DRV_IO_INTENT {
+  DRV_IO_INTENT_READWRITE = 3,
+} DRV_IO_INTENT;
+
+typedef uintptr_t DRV_I2C_BUFFER_HANDLE;
+
+typedef enum DRV_I2C_BUFFER_EVENT {
+  DRV_I2C_BUFFER_EVENT_PENDING,
+  DRV_I2C_BUFFER_EVENT_COMPLETE,
+  DRV_I2C_BUFFER_EVENT_ERROR,
+} DRV_I2C_BUFFER_EVENT;
+
+#define DRV_I2C_INDEX_0 0
+
+DRV_HANDLE DRV_I2C_Open(const SYS_MODULE_INDEX index,
+                        const DRV_IO_INTENT io_intent);
+DRV_I2C_BUFFER_HANDLE DRV_I2C_Transmit(DRV_HANDLE handle,
+                                       uint16_t address,
+                                       void* buffer,
+                                       size_t size,
+                                       void* context);
+DRV_I2C_BUFFER_HANDLE DRV_I2C_TransmitThenReceive(DRV_HANDLE handle,
+                                                  uint16_t address,
+                                                  void* write_buffer,
+                                                  size_t write_size,
+                                                  void* read_buffer,
+                                                  size_t read_size,
+                                                  void* context);
+DRV_I2C_BUFFER_EVENT DRV_I2C_TransferStatusGet(
+    DRV_HANDLE handle,
+    DRV_I2C_BUFFER_HANDLE buffer_handle);
+
+// Module object of a driver, only used as an opaque value by the tests.
+typedef uintptr_t SYS_MODULE_OBJ;
+
+// File system media types, used by the SST25 driver and media functions.
+typedef struct SYS_FS_MEDIA_REGION_GEOMETRY {
+  uint32_t blockSize;
+  uint32_t numBlocks;
+} SYS_FS_MEDIA_REGION_GEOMETRY;
+
+typedef struct SYS_FS_MEDIA_GEOMETRY {
+  uint32_t mediaProperty;
+  uint32_t numReadRegions;
+  uint32_t numWriteRegions;
+  uint32_t numEraseRegions;
+  SYS_FS_MEDIA_REGION_GEOMETRY* geometryTable;
+} SYS_FS_MEDIA_GEOMETRY;
+
+typedef uintptr_t SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE;
+#define SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE_INVALID \
+  ((SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE)-1)
+
+typedef enum SYS_FS_MEDIA_BLOCK_EVENT {
+  SYS_FS_MEDIA_EVENT_BLOCK_COMMAND_COMPLETE,
+  SYS_FS_MEDIA_EVENT_BLOCK_COMMAND_ERROR,
+} SYS_FS_MEDIA_BLOCK_EVENT;
+
+typedef void (*SYS_FS_MEDIA_EVENT_HANDLER)(
+    SYS_FS_MEDIA_BLOCK_EVENT event,
+    SYS_FS_MEDIA_BLOCK_COMMAND_HANDLE command_handle,
+    uintptr_t context);
+
+typedef enum SYS_FS_MEDIA_COMMAND_STATUS {
+  SYS_FS_MEDIA_COMMAND_UNKNOWN = -1,
+  SYS_FS_MEDIA_COMMAND_COMPLETED = 0,
+  SYS_FS_MEDIA_COMMAND_QUEUED = 1,
+  SYS_FS_MEDIA_COMMAND_IN_PROGRESS = 2,
+} SYS_FS_MEDIA_COMMAND_STATUS;
+
+// SST25 driver API, implemented by SST25 emulator, see sst25_emulator.h.
+typedef uintptr_t DRV_SST25_BLOCK_COMMAND_HANDLE;
+#define DRV_SST25_BLOCK_COMMAND_HANDLE_INVALID \
+  ((DRV_SST25_BLOCK_COMMAND_HANDLE)-1)
+
+typedef enum DRV_SST25_COMMAND_STATUS {
+  DRV_SST25_COMMAND_COMPLETED,
+  DRV_SST25_COMMAND_QUEUED,
+  DRV_SST25_COMMAND_IN_PROGRESS,
+  DRV_SST25_COMMAND_ERROR_UNKNOWN,
+} DRV_SST25_COMMAND_STATUS;
+
+#define DRV_SST25_INDEX_0 0
+
+DRV_HANDLE DRV_SST25_Open(const SYS_MODULE_INDEX index,
+                          const DRV_IO_INTENT io_intent);
+SYS_FS_MEDIA_GEOMETRY* DRV_SST25_GeometryGet(const DRV_HANDLE handle);
+void DRV_SST25_BlockRead(const DRV_HANDLE handle,
+                         DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                         uint8_t* target_buffer,
+                         uint32_t block_start,
+                         uint32_t num_blocks);
+void DRV_SST25_BlockWrite(const DRV_HANDLE handle,
+                          DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                          uint8_t* source_buffer,
+                          uint32_t block_start,
+                          uint32_t num_blocks);
+void DRV_SST25_BlockErase(const DRV_HANDLE handle,
+                          DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                          uint32_t block_start,
+                          uint32_t num_blocks);
+void DRV_SST25_BlockEraseWrite(const DRV_HANDLE handle,
+                               DRV_SST25_BLOCK_COMMAND_HANDLE* command_handle,
+                               uint8_t* source_buffer,
+                               uint32_t block_start,
+                               uint32_t num_blocks);
+DRV_SST25_COMMAND_STATUS DRV_SST25_CommandStatus(
+    const DRV_HANDLE handle,
+    const DRV_SST25_BLOCK_COMMAND_HANDLE command_handle);
+void DRV_SST25_Tasks(SYS_MODULE_OBJ object);
+
+// File system API, implemented by the tests which need it.
+typedef uintptr_t SYS_FS_HANDLE;
+#define SYS_FS_HANDLE_INVALID ((SYS_FS_HANDLE)-1)
+
+typedef enum SYS_FS_RESULT {
+  SYS_FS_RES_SUCCESS = 0,
+  SYS_FS_RES_FAILURE = -1,
+} SYS_FS_RESULT;
+
+typedef enum SYS_FS_FILE_OPEN_ATTRIBUTES {
+  SYS_FS_FILE_OPEN_READ = 0,
+  SYS_FS_FILE_OPEN_WRITE,
+  SYS_FS_FILE_OPEN_APPEND,
+} SYS_FS_FILE_OPEN_ATTRIBUTES;
+
+SYS_FS_HANDLE SYS_FS_FileOpen(const char* fname,
+                              SYS_FS_FILE_OPEN_ATTRIBUTES attributes);
+size_t SYS_FS_FileRead(SYS_FS_HANDLE handle, void* buf, size_t nbyte);
+size_t SYS_FS_FileWrite(SYS_FS_HANDLE handle, const void* buf, size_t nbyte);
+int32_t SYS_FS_FileSize(SYS_FS_HANDLE handle);
+SYS_FS_RESULT SYS_FS_FileClose(SYS_FS_HANDLE handle);
+
+// System timer API, implemented by the tests which need it.
+uint32_t SYS_TMR_SystemCountFrequencyGet(void);
+uint64_t SYS_TMR_SystemCountGet(void);
+
 #if 0
 #  define SYS_DEBUG_PRINT(severity, format, ...) printf(format, ##__VA_ARGS__)
 #  define SYS_DEBUG_MESSAGE(severity, message)   printf("%s\n", message)
@@ -51,4 +236,8 @@ enum SysErrorType {
 #  define SYS_MESSAGE(message)
 #endif
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,61 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <cstring>
+
+extern "C" {
+#include "util_crc.h"
+}
+
+namespace NixieTracker {
+
+TEST(crc16_ccitt_update, Basic) {
+  const char* data = "123456789";
+  EXPECT_EQ(crc16_ccitt_update(CRC16_CCITT_INIT, data, strlen(data)), 0x29b1);
+  EXPECT_EQ(crc16_ccitt_update(CRC16_CCITT_INIT, data, 0), CRC16_CCITT_INIT);
+}
+
+TEST(crc16_ccitt_update, Chunked) {
+  const char* data = "123456789";
+  uint16_t crc = CRC16_CCITT_INIT;
+  crc = crc16_ccitt_update(crc, data, 4);
+  crc = crc16_ccitt_update(crc, data + 4, 5);
+  EXPECT_EQ(crc, 0x29b1);
+}
+
+TEST(crc32_update, Basic) {
+  const char* data = "123456789";
+  EXPECT_EQ(crc32_update(CRC32_INIT, data, strlen(data)), 0xcbf43926u);
+  EXPECT_EQ(crc32_update(CRC32_INIT, data, 0), 0u);
+}
+
+TEST(crc32_update, Chunked) {
+  const char* data = "123456789";
+  uint32_t crc = CRC32_INIT;
+  crc = crc32_update(crc, data, 4);
+  crc = crc32_update(crc, data + 4, 5);
+  EXPECT_EQ(crc, 0xcbf43926u);
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,152 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <cstring>
+
+extern "C" {
+#include "util_fat.h"
+}
+
+namespace NixieTracker {
+
+namespace {
+
+uint32_t uint16Decode(const uint8_t* data) {
+  return data[0] | (data[1] << 8);
+}
+
+uint32_t uint32Decode(const uint8_t* data) {
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+// Mount the volume the same way FatFs does it, using nothing but the boot
+// sector, and check it agrees with the layout.
+void verifyVolume(const FatVolume& volume) {
+  uint8_t boot[FAT_SECTOR_SIZE];
+  fat_volume_system_sector(&volume, 0, boot);
+  ASSERT_EQ(boot[510], 0x55);
+  ASSERT_EQ(boot[511], 0xaa);
+  ASSERT_EQ(memcmp(boot + 54, "FAT", 3), 0);
+  ASSERT_EQ(uint16Decode(boot + 11), FAT_SECTOR_SIZE);
+  const uint32_t sectors_per_cluster = boot[13];
+  ASSERT_NE(sectors_per_cluster, 0);
+  ASSERT_EQ(sectors_per_cluster & (sectors_per_cluster - 1), 0);
+  const uint32_t num_reserved_sectors = uint16Decode(boot + 14);
+  ASSERT_NE(num_reserved_sectors, 0);
+  const uint32_t num_fats = boot[16];
+  const uint32_t num_root_entries = uint16Decode(boot + 17);
+  ASSERT_EQ(num_root_entries % (FAT_SECTOR_SIZE / 32), 0);
+  uint32_t num_sectors = uint16Decode(boot + 19);
+  if (num_sectors == 0) {
+    num_sectors = uint32Decode(boot + 32);
+  }
+  const uint32_t sectors_per_fat = uint16Decode(boot + 22);
+  ASSERT_NE(sectors_per_fat, 0);
+  const uint32_t num_system_sectors = num_reserved_sectors +
+                                      num_fats * sectors_per_fat +
+                                      num_root_entries * 32 / FAT_SECTOR_SIZE;
+  ASSERT_LT(num_system_sectors, num_sectors);
+  const uint32_t num_clusters =
+      (num_sectors - num_system_sectors) / sectors_per_cluster;
+  ASSERT_LT(num_clusters, 65525u);
+  const int fat_bits = (num_clusters < 4085) ? 12 : 16;
+  // Table covers all the clusters.
+  const uint32_t num_entries = num_clusters + 2;
+  const uint32_t fat_size = (fat_bits == 12)
+                                ? num_entries * 3 / 2 + (num_entries & 1)
+                                : num_entries * 2;
+  EXPECT_GE(sectors_per_fat * FAT_SECTOR_SIZE, fat_size);
+  // Layout agrees with what readers see.
+  EXPECT_EQ(num_sectors, volume.num_sectors);
+  EXPECT_EQ(num_clusters, volume.num_clusters);
+  EXPECT_EQ(fat_bits, volume.fat_bits);
+  EXPECT_EQ(num_system_sectors, fat_volume_num_system_sectors(&volume));
+  EXPECT_EQ(memcmp(boot + 54, (fat_bits == 12) ? "FAT12   " : "FAT16   ", 8),
+            0);
+}
+
+}  // namespace
+
+TEST(fat_volume_layout, SerialFlash) {
+  // Two megabytes flash with reserved blocks at the end.
+  FatVolume volume;
+  ASSERT_TRUE(fat_volume_layout(4096 - 36 * 8, 0x12345678, &volume));
+  EXPECT_EQ(volume.fat_bits, 12);
+  EXPECT_EQ(volume.sectors_per_cluster, 1);
+  EXPECT_EQ(volume.num_fats, 1);
+  EXPECT_EQ(volume.sectors_per_fat, 12);
+  EXPECT_EQ(volume.num_clusters, 3763);
+  EXPECT_EQ(fat_volume_num_system_sectors(&volume), 45);
+  verifyVolume(volume);
+}
+
+TEST(fat_volume_layout, Sizes) {
+  for (uint32_t num_sectors = 64; num_sectors < 300000;
+       num_sectors += 1 + num_sectors / 64) {
+    FatVolume volume;
+    ASSERT_TRUE(fat_volume_layout(num_sectors, 1, &volume)) << num_sectors;
+    verifyVolume(volume);
+  }
+}
+
+TEST(fat_volume_layout, TypeBoundary) {
+  // Volumes around the number of clusters which switches FAT12 to FAT16.
+  for (uint32_t num_sectors = 4085; num_sectors < 4200; ++num_sectors) {
+    FatVolume volume;
+    ASSERT_TRUE(fat_volume_layout(num_sectors, 1, &volume)) << num_sectors;
+    verifyVolume(volume);
+  }
+}
+
+TEST(fat_volume_layout, Unsupported) {
+  FatVolume volume;
+  EXPECT_FALSE(fat_volume_layout(0, 1, &volume));
+  EXPECT_FALSE(fat_volume_layout(33, 1, &volume));
+  // Does not fit FAT16 even with the biggest cluster.
+  EXPECT_FALSE(fat_volume_layout(128 * 70000, 1, &volume));
+}
+
+TEST(fat_volume_system_sector, Content) {
+  FatVolume volume;
+  ASSERT_TRUE(fat_volume_layout(3824, 0xdeadbeef, &volume));
+  uint8_t data[FAT_SECTOR_SIZE];
+  fat_volume_system_sector(&volume, 0, data);
+  EXPECT_EQ(uint32Decode(data + 39), 0xdeadbeef);
+  EXPECT_EQ(data[21], 0xf0);
+  // Reserved entries of the table, the rest is free.
+  fat_volume_system_sector(&volume, 1, data);
+  EXPECT_EQ(data[0], 0xf0);
+  EXPECT_EQ(data[1], 0xff);
+  EXPECT_EQ(data[2], 0xff);
+  EXPECT_EQ(data[3], 0x00);
+  for (uint32_t sector = 2; sector < fat_volume_num_system_sectors(&volume);
+       ++sector) {
+    fat_volume_system_sector(&volume, sector, data);
+    for (int i = 0; i < FAT_SECTOR_SIZE; ++i) {
+      ASSERT_EQ(data[i], 0) << "sector " << sector << " byte " << i;
+    }
+  }
+}
+
+}  // namespace NixieTracker
@@ -0,0 +1,167 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "util_http.h"
+}
+
+namespace NixieTracker {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+void collectLineCallback(const char* line, size_t line_len, void* user_data) {
+  static_cast<vector<string>*>(user_data)->push_back(string(line, line_len));
+}
+
+// Feed the response in chunks of the given size, returns the body.
+string feedResponse(HttpResponseScanner* scanner,
+                    const string& response,
+                    size_t chunk_size,
+                    vector<string>* lines) {
+  string body;
+  for (size_t i = 0; i < response.size(); i += chunk_size) {
+    const size_t num_bytes = std::min(chunk_size, response.size() - i);
+    const uint8_t* chunk =
+        reinterpret_cast<const uint8_t*>(response.data()) + i;
+    const size_t num_header_bytes = http_response_scanner_feed(
+        scanner, chunk, num_bytes, collectLineCallback, lines);
+    body.append(reinterpret_cast<const char*>(chunk) + num_header_bytes,
+                num_bytes - num_header_bytes);
+  }
+  return body;
+}
+
+}  // namespace
+
+TEST(http_response_scanner_feed, Chunked) {
+  const string response = "HTTP/1.1 200 OK\r\n"
+                          "Content-Length: 5\r\n"
+                          "\r\n"
+                          "Hello";
+  for (size_t chunk_size = 1; chunk_size <= response.size(); ++chunk_size) {
+    HttpResponseScanner scanner;
+    http_response_scanner_reset(&scanner);
+    vector<string> lines;
+    EXPECT_EQ(feedResponse(&scanner, response, chunk_size, &lines), "Hello");
+    EXPECT_EQ(lines, vector<string>({"HTTP/1.1 200 OK",
+                                     "Content-Length: 5"}));
+    EXPECT_TRUE(scanner.is_body);
+  }
+}
+
+TEST(http_response_scanner_feed, LongLine) {
+  const string response = "HTTP/1.1 200 OK\r\n"
+                          "X-Long: " + string(HTTP_MAX_HEADER_LINE, 'x') +
+                          "\r\n"
+                          "ETag: \"1\"\n"
+                          "\n"
+                          "\r\n";
+  HttpResponseScanner scanner;
+  http_response_scanner_reset(&scanner);
+  vector<string> lines;
+  EXPECT_EQ(feedResponse(&scanner, response, 7, &lines), "\r\n");
+  EXPECT_EQ(lines, vector<string>({"HTTP/1.1 200 OK", "ETag: \"1\""}));
+}
+
+TEST(http_parse_status_line, Basic) {
+  int status_code = 0;
+  const char* line = "HTTP/1.1 206 Partial Content";
+  EXPECT_TRUE(http_parse_status_line(line, strlen(line), &status_code));
+  EXPECT_EQ(status_code, 206);
+  line = "HTTP/1.0 404";
+  EXPECT_TRUE(http_parse_status_line(line, strlen(line), &status_code));
+  EXPECT_EQ(status_code, 404);
+  line = "HTTP/1.1 20 OK";
+  EXPECT_FALSE(http_parse_status_line(line, strlen(line), &status_code));
+  line = "HTTP/1.1 2000 OK";
+  EXPECT_FALSE(http_parse_status_line(line, strlen(line), &status_code));
+  line = "ICY 200 OK";
+  EXPECT_FALSE(http_parse_status_line(line, strlen(line), &status_code));
+}
+
+TEST(http_header_value, Basic) {
+  size_t value_len;
+  const char* line = "Content-Length:  1234 ";
+  const char* value =
+      http_header_value(line, strlen(line), "content-length", &value_len);
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(string(value, value_len), "1234");
+  line = "content-length:";
+  value = http_header_value(line, strlen(line), "content-length", &value_len);
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(value_len, 0);
+  line = "Content-Type: text/plain";
+  EXPECT_EQ(http_header_value(line, strlen(line), "content-length",
+                              &value_len),
+            nullptr);
+  line = "Content-Lengthy: 1";
+  EXPECT_EQ(http_header_value(line, strlen(line), "content-length",
+                              &value_len),
+            nullptr);
+}
+
+TEST(http_parse_uint32, Basic) {
+  uint32_t value;
+  EXPECT_TRUE(http_parse_uint32("4294967295", 10, &value));
+  EXPECT_EQ(value, 4294967295u);
+  EXPECT_TRUE(http_parse_uint32("0", 1, &value));
+  EXPECT_EQ(value, 0u);
+  EXPECT_FALSE(http_parse_uint32("4294967296", 10, &value));
+  EXPECT_FALSE(http_parse_uint32("12a", 3, &value));
+  EXPECT_FALSE(http_parse_uint32("", 0, &value));
+}
+
+TEST(http_parse_content_range, Basic) {
+  uint32_t first, last, total;
+  const char* value = "bytes 1024-2047/4096";
+  EXPECT_TRUE(http_parse_content_range(value, strlen(value),
+                                       &first, &last, &total));
+  EXPECT_EQ(first, 1024u);
+  EXPECT_EQ(last, 2047u);
+  EXPECT_EQ(total, 4096u);
+  value = "bytes 0-99/*";
+  EXPECT_TRUE(http_parse_content_range(value, strlen(value),
+                                       &first, &last, &total));
+  EXPECT_EQ(first, 0u);
+  EXPECT_EQ(last, 99u);
+  EXPECT_EQ(total, 0u);
+  value = "bytes */4096";
+  EXPECT_FALSE(http_parse_content_range(value, strlen(value),
+                                        &first, &last, &total));
+  value = "bytes 10-5/4096";
+  EXPECT_FALSE(http_parse_content_range(value, strlen(value),
+                                        &first, &last, &total));
+  value = "bytes 0-4096/4096";
+  EXPECT_FALSE(http_parse_content_range(value, strlen(value),
+                                        &first, &last, &total));
+}
+
+}  // namespace NixieTracker
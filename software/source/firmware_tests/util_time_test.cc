@@ -0,0 +1,126 @@
+// Copyright (c) 2017, Sergey Sharybin
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//
+// Author: Sergey Sharybin (sergey.vfx@gmail.com)
+
+#include "test/test.h"
+
+extern "C" {
+#include "util_time.h"
+}
+
+namespace NixieTracker {
+
+namespace {
+
+CalendarTime makeCalendarTime(int year, int month, int day,
+                              int hours, int minutes, int seconds) {
+  CalendarTime calendar_time;
+  calendar_time.year = year;
+  calendar_time.month = month;
+  calendar_time.day = day;
+  calendar_time.day_of_week = 1;
+  calendar_time.hours = hours;
+  calendar_time.minutes = minutes;
+  calendar_time.seconds = seconds;
+  return calendar_time;
+}
+
+}  // namespace
+
+TEST(is_leap_year, Basic) {
+  EXPECT_TRUE(is_leap_year(2000));
+  EXPECT_FALSE(is_leap_year(2001));
+  EXPECT_TRUE(is_leap_year(2004));
+  EXPECT_FALSE(is_leap_year(2100));
+  EXPECT_TRUE(is_leap_year(2400));
+}
+
+TEST(days_in_month, Basic) {
+  EXPECT_EQ(days_in_month(2017, 1), 31);
+  EXPECT_EQ(days_in_month(2017, 2), 28);
+  EXPECT_EQ(days_in_month(2016, 2), 29);
+  EXPECT_EQ(days_in_month(2017, 4), 30);
+  EXPECT_EQ(days_in_month(2017, 12), 31);
+}
+
+TEST(calendar_time_is_valid, Basic) {
+  CalendarTime calendar_time = makeCalendarTime(2017, 2, 28, 23, 59, 59);
+  EXPECT_TRUE(calendar_time_is_valid(&calendar_time));
+  calendar_time = makeCalendarTime(2017, 2, 29, 0, 0, 0);
+  EXPECT_FALSE(calendar_time_is_valid(&calendar_time));
+  calendar_time = makeCalendarTime(2016, 2, 29, 0, 0, 0);
+  EXPECT_TRUE(calendar_time_is_valid(&calendar_time));
+  calendar_time = makeCalendarTime(2017, 13, 1, 0, 0, 0);
+  EXPECT_FALSE(calendar_time_is_valid(&calendar_time));
+  calendar_time = makeCalendarTime(2017, 1, 1, 24, 0, 0);
+  EXPECT_FALSE(calendar_time_is_valid(&calendar_time));
+  calendar_time = makeCalendarTime(1999, 12, 31, 0, 0, 0);
+  EXPECT_FALSE(calendar_time_is_valid(&calendar_time));
+}
+
+TEST(calendar_time_to_seconds, Basic) {
+  CalendarTime calendar_time = makeCalendarTime(2000, 1, 1, 0, 0, 0);
+  EXPECT_EQ(calendar_time_to_seconds(&calendar_time), 0u);
+  calendar_time = makeCalendarTime(2000, 1, 2, 1, 2, 3);
+  EXPECT_EQ(calendar_time_to_seconds(&calendar_time), 86400u + 3723u);
+  calendar_time = makeCalendarTime(2001, 1, 1, 0, 0, 0);
+  EXPECT_EQ(calendar_time_to_seconds(&calendar_time), 366u * 86400u);
+  // 2017-03-01 00:00:00 UTC is 1488326400 in Unix time, and 2000-01-01 is
+  // 946684800.
+  calendar_time = makeCalendarTime(2017, 3, 1, 0, 0, 0);
+  EXPECT_EQ(calendar_time_to_seconds(&calendar_time),
+            1488326400u - 946684800u);
+}
+
+TEST(calendar_time_from_seconds, Basic) {
+  CalendarTime calendar_time;
+  calendar_time_from_seconds(0, &calendar_time);
+  EXPECT_EQ(calendar_time.year, 2000);
+  EXPECT_EQ(calendar_time.month, 1);
+  EXPECT_EQ(calendar_time.day, 1);
+  // 2000-01-01 was Saturday.
+  EXPECT_EQ(calendar_time.day_of_week, 6);
+  EXPECT_EQ(calendar_time.hours, 0);
+  EXPECT_EQ(calendar_time.minutes, 0);
+  EXPECT_EQ(calendar_time.seconds, 0);
+  // Leap day.
+  calendar_time_from_seconds(1330473600u - 946684800u + 3723u, &calendar_time);
+  EXPECT_EQ(calendar_time.year, 2012);
+  EXPECT_EQ(calendar_time.month, 2);
+  EXPECT_EQ(calendar_time.day, 29);
+  EXPECT_EQ(calendar_time.day_of_week, 3);
+  EXPECT_EQ(calendar_time.hours, 1);
+  EXPECT_EQ(calendar_time.minutes, 2);
+  EXPECT_EQ(calendar_time.seconds, 3);
+}
+
+TEST(calendar_time_from_seconds, RoundTrip) {
+  for (uint32_t seconds = 0;
+       seconds < 200u * 365u * 86400u;
+       seconds += 86400u * 7u + 3601u) {
+    CalendarTime calendar_time;
+    calendar_time_from_seconds(seconds, &calendar_time);
+    EXPECT_TRUE(calendar_time_is_valid(&calendar_time));
+    EXPECT_EQ(calendar_time_to_seconds(&calendar_time), seconds);
+  }
+}
+
+}  // namespace NixieTracker